@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""
+Per-stage input latency of AmtPtpDeviceUsbUm from an exported trace.
+
+Record with the AmtPtpDeviceInputLatency profile of AmtPtpDevice.wprp:
+
+    wpr -start AmtPtpDevice.wprp!AmtPtpDeviceInputLatency
+    wpr -stop input.etl
+    tracerpt input.etl -of CSV -o input.csv
+
+or export the InputDiagnosticsEvent rows from WPA as CSV. Columns are found
+by field name, so the column order and any extra columns do not matter. Only
+the Python standard library is used.
+
+Stages, from the QPC stamps of each frame:
+
+    transport  interrupt pipe completion -> parse start
+    parse      parse start -> PTP report composed
+    complete   report composed -> PTP read request completed
+    total      interrupt pipe completion -> PTP read request completed
+
+Frames parked in the report ring have no compose/complete stamps and only
+count towards transport and inter-arrival.
+"""
+
+import argparse
+import csv
+import math
+import sys
+
+STAMPS = ("TransportCompleted", "ParseStarted", "ReportComposed", "RequestCompleted")
+STAGES = (
+    ("transport", "TransportCompleted", "ParseStarted"),
+    ("parse", "ParseStarted", "ReportComposed"),
+    ("complete", "ReportComposed", "RequestCompleted"),
+    ("total", "TransportCompleted", "RequestCompleted"),
+)
+SUBTYPE = "StageLatency"
+
+
+def parse_int(text):
+    text = text.strip().strip('"').replace(",", "")
+    if not text:
+        return None
+    try:
+        return int(text, 0)
+    except ValueError:
+        return None
+
+
+def read_frames(path, frequency):
+    frames = []
+    with open(path, newline="", encoding="utf-8-sig", errors="replace") as f:
+        reader = csv.reader(f)
+        columns = None
+        for row in reader:
+            names = [cell.strip().strip('"') for cell in row]
+            # tracerpt and WPA both put a header row first, pick it up by name
+            if columns is None or "TransportCompleted" in names:
+                if "TransportCompleted" in names:
+                    columns = {name: i for i, name in enumerate(names)}
+                continue
+
+            def field(name):
+                i = columns.get(name)
+                return row[i] if i is not None and i < len(row) else ""
+
+            if "Subtype" in columns and field("Subtype").strip().strip('"') != SUBTYPE:
+                continue
+
+            frame = {name: parse_int(field(name)) or 0 for name in STAMPS}
+            if frame["TransportCompleted"] == 0:
+                continue
+
+            frame["Frequency"] = frequency or parse_int(field("PerformanceFrequency")) or 0
+            frame["Device"] = "%04x:%04x" % (
+                parse_int(field("idVendor")) or 0,
+                parse_int(field("idProduct")) or 0,
+            )
+            for name in ("ContactCount", "ParkedFrames", "PendingReads"):
+                frame[name] = parse_int(field(name)) or 0
+            frames.append(frame)
+
+    if columns is None:
+        sys.exit("%s: no TransportCompleted column, is this an InputDiagnosticsEvent export?" % path)
+    return frames
+
+
+def to_us(ticks, frequency):
+    return ticks * 1e6 / frequency
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    k = (len(values) - 1) * p / 100.0
+    lo = math.floor(k)
+    hi = math.ceil(k)
+    return values[lo] + (values[hi] - values[lo]) * (k - lo)
+
+
+def summary(name, values):
+    values = sorted(values)
+    n = len(values)
+    mean = sum(values) / n
+    stdev = math.sqrt(sum((v - mean) ** 2 for v in values) / n)
+    print("  %-13s n=%-7d min=%9.1f p50=%9.1f p90=%9.1f p99=%9.1f max=%9.1f mean=%9.1f jitter(sd)=%8.1f us" % (
+        name, n, values[0], percentile(values, 50), percentile(values, 90),
+        percentile(values, 99), values[-1], mean, stdev))
+
+
+def histogram(values, width):
+    # Power of two buckets in microseconds, from <1 us up
+    buckets = {}
+    for v in values:
+        b = 0 if v < 1 else int(math.log2(v)) + 1
+        buckets[b] = buckets.get(b, 0) + 1
+
+    peak = max(buckets.values())
+    for b in range(min(buckets), max(buckets) + 1):
+        count = buckets.get(b, 0)
+        lo = 0 if b == 0 else 1 << (b - 1)
+        label = "%d-%d" % (lo, 1 << b)
+        bar = "#" * (count * width // peak) if count else ""
+        print("    %14s us %8d %s" % (label, count, bar))
+
+
+def distribution(name, values):
+    counts = {}
+    for v in values:
+        counts[v] = counts.get(v, 0) + 1
+    print("  %-13s %s" % (name, "  ".join("%d:%d" % (k, counts[k]) for k in sorted(counts))))
+
+
+def report(device, frames, width):
+    frames.sort(key=lambda frame: frame["TransportCompleted"])
+    frequency = frames[0]["Frequency"]
+    if frequency <= 0:
+        sys.exit("%s: no PerformanceFrequency in the trace, pass --frequency" % device)
+
+    delivered = [f for f in frames if f["RequestCompleted"]]
+    print("device %s: %d frames, %d delivered, %d parked or dropped, QPC %d Hz" % (
+        device, len(frames), len(delivered), len(frames) - len(delivered), frequency))
+
+    stages = []
+    for name, start, end in STAGES:
+        values = [to_us(f[end] - f[start], frequency) for f in frames if f[start] and f[end]]
+        if values:
+            stages.append((name, values))
+            summary(name, values)
+
+    arrivals = [to_us(b["TransportCompleted"] - a["TransportCompleted"], frequency)
+                for a, b in zip(frames, frames[1:])]
+    if arrivals:
+        summary("inter-arrival", arrivals)
+
+    distribution("contacts", [f["ContactCount"] for f in frames])
+    distribution("parked", [f["ParkedFrames"] for f in frames])
+    distribution("pending", [f["PendingReads"] for f in frames])
+
+    for name, values in stages + [("inter-arrival", arrivals)]:
+        if values:
+            print("  %s histogram" % name)
+            histogram(values, width)
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0].strip())
+    parser.add_argument("csv", nargs="+", help="CSV export of InputDiagnosticsEvent")
+    parser.add_argument("--frequency", type=int, default=0,
+                        help="QPC ticks per second, overrides PerformanceFrequency")
+    parser.add_argument("--width", type=int, default=50, help="histogram bar width")
+    args = parser.parse_args()
+
+    frames = []
+    for path in args.csv:
+        frames.extend(read_frames(path, args.frequency))
+    if not frames:
+        sys.exit("no StageLatency events found")
+
+    devices = {}
+    for frame in frames:
+        devices.setdefault(frame["Device"], []).append(frame)
+    for device in sorted(devices):
+        report(device, devices[device], args.width)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,21 @@
+﻿using System.Runtime.InteropServices;
+
+namespace AmtPtpDevice.Settings.DataObjects
+{
+    // Input path counters of the driver, in the order of AmtPtpPerfCounters.h
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct PtpPerfCountersReport
+    {
+        public const int LatencyBuckets = 16;
+
+        public byte ReportId;
+        public uint FramesIn;
+        public uint ReportsOut;
+        public uint NoRequestDrops;
+        public uint Malformed;
+        public uint Resets;
+        public uint SplitMerges;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = LatencyBuckets)]
+        public uint[] Latency;
+    }
+}
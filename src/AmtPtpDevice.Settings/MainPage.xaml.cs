@@ -23,6 +23,8 @@ namespace AmtPtpDevice.Settings
         private bool m_isInitialDataPresented = false;
         private UsbHidDeviceAccessSubscription m_inputDevice;
         private UsbHidDeviceAccessSubscription m_battery;
+        private UsbHidDeviceAccessSubscription m_counters;
+        private DispatcherTimer m_countersTimer;
 
         public MainPage()
         {
@@ -57,17 +59,85 @@ namespace AmtPtpDevice.Settings
         {
             m_inputDevice = new UsbHidDeviceAccessSubscription(HidDevice.GetDeviceSelector(0xff00, 0x0001, 0x05ac, 0x0265));
             m_battery = new UsbHidDeviceAccessSubscription(HidDevice.GetDeviceSelector(0xff00, 0x0014, 0x05ac, 0x0265));
+            m_counters = new UsbHidDeviceAccessSubscription(HidDevice.GetDeviceSelector(0xff00, 0x0002, 0x05ac, 0x0265));
 
             m_inputDevice.TargetDeviceAvailable += OnInputDeviceAvailable;
             m_inputDevice.TargetDeviceLost += OnInputDeviceLost;
             m_battery.TargetDeviceAvailable += OnBatteryAvailable;
+            m_counters.TargetDeviceAvailable += OnCountersAvailable;
+            m_counters.TargetDeviceLost += OnCountersLost;
+
+            m_countersTimer = new DispatcherTimer { Interval = TimeSpan.FromSeconds(1) };
+            m_countersTimer.Tick += OnCountersTimerTick;
+        }
+
+        private async void OnCountersAvailable(object sender, EventArgs e)
+        {
+            await Dispatcher.RunAsync(CoreDispatcherPriority.Normal, () => m_countersTimer.Start());
+        }
+
+        private async void OnCountersLost(object sender, EventArgs e)
+        {
+            await Dispatcher.RunAsync(CoreDispatcherPriority.Normal, () =>
+            {
+                m_countersTimer.Stop();
+                m_perfStatus.Text = "";
+            });
+        }
+
+        private async void OnCountersTimerTick(object sender, object e)
+        {
+            IBuffer cData;
+            try
+            {
+                var cReport = await m_counters.Device.GetFeatureReportAsync(0x0a);
+                cData = cReport.Data;
+            }
+            catch (Exception)
+            {
+                // Older drivers do not have the report, the device may also be going away
+                m_countersTimer.Stop();
+                return;
+            }
+
+            var ptr = Marshal.AllocHGlobal((int) cData.Length);
+            Marshal.Copy(cData.ToArray(), 0, ptr, (int) cData.Length);
+            var counters = Marshal.PtrToStructure<PtpPerfCountersReport>(ptr);
+            Marshal.FreeHGlobal(ptr);
+
+            // Median of the log2 latency buckets, reported as the bucket's upper bound
+            ulong total = 0, seen = 0;
+            int median = 0;
+            foreach (var count in counters.Latency) total += count;
+            for (; median < PtpPerfCountersReport.LatencyBuckets - 1; median++)
+            {
+                seen += counters.Latency[median];
+                if (seen * 2 >= total) break;
+            }
+
+            m_perfStatus.Text = $"{counters.FramesIn} frames in, {counters.ReportsOut} reports out, " +
+                $"{counters.NoRequestDrops} dropped, {counters.Malformed} malformed, {counters.Resets} resets, " +
+                $"{counters.SplitMerges} merged. " +
+                (total > 0 ? $"Median latency under {1 << median} us." : "");
         }
 
         private async void OnBatteryAvailable(object sender, EventArgs e)
         {
-            var bReport = await m_battery.Device.GetInputReportAsync(0x90);
-            var ptr = Marshal.AllocHGlobal((int) bReport.Data.Length);
-            Marshal.Copy(bReport.Data.ToArray(), 0, ptr, (int) bReport.Data.Length);
+            IBuffer bData;
+            try
+            {
+                // The HID filter answers with the last battery frame as a feature report
+                var fReport = await m_battery.Device.GetFeatureReportAsync(0x90);
+                bData = fReport.Data;
+            }
+            catch (Exception)
+            {
+                var bReport = await m_battery.Device.GetInputReportAsync(0x90);
+                bData = bReport.Data;
+            }
+
+            var ptr = Marshal.AllocHGlobal((int) bData.Length);
+            Marshal.Copy(bData.ToArray(), 0, ptr, (int) bData.Length);
 
             var battReport = Marshal.PtrToStructure<Mt2BatteryStatusReport>(ptr);
             await Dispatcher.RunAsync(CoreDispatcherPriority.Normal, () =>
@@ -41,6 +41,10 @@ typedef struct _SPI_TRACKPAD_PACKET
 	SPI_TRACKPAD_FINGER Fingers[SPI_TRACKPAD_MAX_FINGERS];
 } SPI_TRACKPAD_PACKET, *PSPI_TRACKPAD_PACKET;
 
+static_assert(sizeof(SPI_TRACKPAD_FINGER) == AMTPTP_SPI_FINGER_SIZE, "Unexpected SPI_TRACKPAD_FINGER size");
+static_assert(FIELD_OFFSET(SPI_TRACKPAD_PACKET, Fingers) == AMTPTP_SPI_HEADER_SIZE, "Unexpected SPI_TRACKPAD_PACKET header size");
+static_assert(FIELD_OFFSET(SPI_TRACKPAD_PACKET, NumOfFingers) == AMTPTP_SPI_FINGER_COUNT_OFFSET, "Unexpected SPI_TRACKPAD_PACKET layout");
+
 typedef struct _SPI_SET_FEATURE {
 	UINT8 BusLocation;
 	UINT8 Status;
@@ -48,24 +52,3 @@ typedef struct _SPI_SET_FEATURE {
 
 #define HID_REPORTID_MOUSE  2
 #define HID_XFER_PACKET_SIZE 255
-
-static const SPI_TRACKPAD_INFO SpiTrackpadConfigTable[] = 
-{
-	/* MacBookPro11,1 / MacBookPro12,1 */
-	{ 0x05ac, 0x0272, -4750, 5280, -150, 6730 },
-	{ 0x05ac, 0x0273, -4750, 5280, -150, 6730 },
-	/* MacBook9 */
-	{ 0x05ac, 0x0275, -5087, 5579, -128, 6089 },
-	/* MacBookPro14,1 / MacBookPro14,2 */
-	{ 0x05ac, 0x0276, -6243, 6749, -170, 7685 },
-	{ 0x05ac, 0x0277, -6243, 6749, -170, 7685 },
-	/* MacBookPro14,3 */
-	{ 0x05ac, 0x0278, -7456, 7976, -163, 9283 },
-	/* MacBook10 */
-	{ 0x05ac, 0x0279, -5087, 5579, -128, 6089 },
-	/* MacBookAir7,2 fallback */
-	{ 0x05ac, 0x0290, -5087, 5579, -128, 6089 },
-	{ 0x05ac, 0x0291, -5087, 5579, -128, 6089 },
-	/* Terminator */
-	{ 0 }
-};
@@ -78,46 +78,44 @@ AmtPtpDeviceSpiKmCreateDevice(
 		pDeviceContext->SpiDevice = Device;
 
 		//
-		// Create a list of buffers
+		// Create power-on recovery timer
 		//
-		Status = WdfLookasideListCreate(
-			WDF_NO_OBJECT_ATTRIBUTES,
-			REPORT_BUFFER_SIZE,
-			NonPagedPoolNx,
-			WDF_NO_OBJECT_ATTRIBUTES,
-			PTP_LIST_POOL_TAG,
-			&pDeviceContext->HidReadBufferLookaside
-		);
-
+		WDF_TIMER_CONFIG_INIT(&TimerConfig, AmtPtpPowerRecoveryTimerCallback);
+		TimerConfig.AutomaticSerialization = TRUE;
+		WDF_OBJECT_ATTRIBUTES_INIT(&TimerAttributes);
+		TimerAttributes.ParentObject = Device;
+		TimerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+		Status = WdfTimerCreate(&TimerConfig, &TimerAttributes, &pDeviceContext->PowerOnRecoveryTimer);
 		if (!NT_SUCCESS(Status)) {
 			TraceEvents(
 				TRACE_LEVEL_ERROR,
 				TRACE_DRIVER,
-				"%!FUNC! WdfLookasideListCreate failed with %!STATUS!",
+				"%!FUNC! WdfTimerCreate failed with %!STATUS!",
 				Status
 			);
 			goto exit;
 		}
 
 		//
-		// Create power-on recovery timer
+		// Create the input lock
 		//
-		WDF_TIMER_CONFIG_INIT(&TimerConfig, AmtPtpPowerRecoveryTimerCallback);
-		TimerConfig.AutomaticSerialization = TRUE;
-		WDF_OBJECT_ATTRIBUTES_INIT(&TimerAttributes);
-		TimerAttributes.ParentObject = Device;
-		TimerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
-		Status = WdfTimerCreate(&TimerConfig, &TimerAttributes, &pDeviceContext->PowerOnRecoveryTimer);
+		Status = WdfSpinLockCreate(WDF_NO_OBJECT_ATTRIBUTES, &pDeviceContext->InputLock);
 		if (!NT_SUCCESS(Status)) {
 			TraceEvents(
 				TRACE_LEVEL_ERROR,
 				TRACE_DRIVER,
-				"%!FUNC! WdfTimerCreate failed with %!STATUS!",
+				"%!FUNC! WdfSpinLockCreate failed with %!STATUS!",
 				Status
 			);
 			goto exit;
 		}
 
+		AmtPtpReportRingInitialize(
+			&pDeviceContext->ReportRing,
+			AMTPTP_REPORT_RING_DEFAULT_DEPTH,
+			AmtPtpRingOverflowCoalesce
+		);
+
 		//
 		// Retrieve IO target.
 		//
@@ -128,6 +126,20 @@ AmtPtpDeviceSpiKmCreateDevice(
 			goto exit;
 		}
 
+		//
+		// Create the pool of recycled SPI reads
+		//
+		Status = AmtPtpSpiInputCreateReadPool(Device, SPI_READ_POOL_DEFAULT_SIZE);
+		if (!NT_SUCCESS(Status)) {
+			TraceEvents(
+				TRACE_LEVEL_ERROR,
+				TRACE_DRIVER,
+				"%!FUNC! AmtPtpSpiInputCreateReadPool failed with %!STATUS!",
+				Status
+			);
+			goto exit;
+		}
+
 		//
 		// Reset power status.
 		//
@@ -176,8 +188,6 @@ AmtPtpEvtDevicePrepareHardware(
 	WDF_MEMORY_DESCRIPTOR HidAttributeMemoryDescriptor;
 	HID_DEVICE_ATTRIBUTES DeviceAttributes;
 	
-	const SPI_TRACKPAD_INFO* pTrackpadInfo;
-	BOOLEAN DeviceFound = FALSE;
 
 	WDFKEY ParamRegistryKey;
 	DECLARE_CONST_UNICODE_STRING(DesiredReportTypeKey, L"DesiredReportType");
@@ -240,30 +250,38 @@ AmtPtpEvtDevicePrepareHardware(
 	pDeviceContext->HidProductID = DeviceAttributes.ProductID;
 	pDeviceContext->HidVersionNumber = DeviceAttributes.VersionNumber;
 
-	// Find proper metadata in HID registry
-	for (pTrackpadInfo = SpiTrackpadConfigTable; pTrackpadInfo->VendorId; ++pTrackpadInfo)
-	{
-		if (pTrackpadInfo->VendorId == DeviceAttributes.VendorID &&
-			pTrackpadInfo->ProductId == DeviceAttributes.ProductID)
-		{
-			pDeviceContext->TrackpadInfo.ProductId = pTrackpadInfo->ProductId;
-			pDeviceContext->TrackpadInfo.VendorId = pTrackpadInfo->VendorId;
-			pDeviceContext->TrackpadInfo.XMin = pTrackpadInfo->XMin;
-			pDeviceContext->TrackpadInfo.XMax = pTrackpadInfo->XMax;
-			pDeviceContext->TrackpadInfo.YMin = pTrackpadInfo->YMin;
-			pDeviceContext->TrackpadInfo.YMax = pTrackpadInfo->YMax;
-
-			DeviceFound = TRUE;
-			break;
-		}
-	}
+	// Find proper metadata in device registry
+	pDeviceContext->DeviceModel = AmtPtpDeviceRegistryLookup(
+		AmtPtpBusSpi,
+		DeviceAttributes.VendorID,
+		DeviceAttributes.ProductID
+	);
 
-	if (!DeviceFound)
+	if (pDeviceContext->DeviceModel == NULL)
 	{
 		Status = STATUS_NOT_FOUND;
 		goto exit;
 	}
 
+	// Decoder metadata
+	AmtPtpDeviceRegistryInitDecoderConfig(
+		pDeviceContext->DeviceModel,
+		0,
+		&pDeviceContext->DecoderConfig
+	);
+
+	// SPI only reports slot indices, contacts are matched by position
+	AmtPtpContactTrackerInitialize(&pDeviceContext->ContactTracker, &pDeviceContext->DecoderConfig);
+
+	// SPI frames carry no timestamp, ScanTime follows the host clock
+	AmtPtpScanClockInitialize(&pDeviceContext->ScanClock, 0);
+
+	AmtPtpErrorBudgetInitialize(&pDeviceContext->ErrorBudget, AMTPTP_ERROR_BUDGET_DEFAULT_WINDOW,
+		AMTPTP_ERROR_BUDGET_DEFAULT_LIMIT);
+
+	AmtPtpResumeInitialize(&pDeviceContext->Resume);
+	AmtPtpTraceRingInitialize(&pDeviceContext->TraceRing);
+
 	// Check the desired report type.
 	Status = WdfDriverOpenParametersRegistryKey(
 		WdfDeviceGetDriver(Device),
@@ -338,8 +356,9 @@ AmtPtpEvtDeviceD0Entry(
 	// We will configure the device in Self Managed IO init / restart routine
 	pDeviceContext->DeviceStatus = D0ActiveAndUnconfigured;
 
-	// Set time
-	KeQueryPerformanceCounter(&pDeviceContext->LastReportTime);
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	AmtPtpResumeBegin(&pDeviceContext->Resume, KeQueryInterruptTime());
+	WdfSpinLockRelease(pDeviceContext->InputLock);
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -370,6 +389,57 @@ AmtPtpEvtDeviceD0Exit(
 	pDeviceContext = DeviceGetContext(Device);
 	pDeviceContext->DeviceStatus = D3;
 
+	// No more attempts to enable the trackpad
+	WdfTimerStop(pDeviceContext->PowerOnRecoveryTimer, TRUE);
+
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Read pool: %d allocated, %d issued, %d exhausted",
+		pDeviceContext->ReadPoolAllocations,
+		pDeviceContext->ReadPoolIssued,
+		pDeviceContext->ReadPoolExhausted
+	);
+
+	// Contacts don't survive the power transition
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Contact tracker: %d lift-offs, %d dropped",
+		pDeviceContext->ContactTracker.LiftOffs,
+		pDeviceContext->ContactTracker.Dropped
+	);
+	AmtPtpContactTrackerReset(&pDeviceContext->ContactTracker);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Scan clock: %d resyncs",
+		pDeviceContext->ScanClock.Resyncs
+	);
+	AmtPtpScanClockReset(&pDeviceContext->ScanClock);
+	AmtPtpReportRingFlush(&pDeviceContext->ReportRing);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Malformed frames: %d dropped, %d resets, %llu ms input lost",
+		pDeviceContext->ErrorBudget.Dropped,
+		pDeviceContext->ErrorBudget.Resets,
+		pDeviceContext->ErrorBudget.LostTime / 10000
+	);
+	AmtPtpErrorBudgetReset(&pDeviceContext->ErrorBudget);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Resume: configured %llu us, reads %llu us, first report %llu us (worst %llu us), %d retries",
+		AmtPtpResumeElapsed(&pDeviceContext->Resume, AmtPtpResumeConfigured) / 10,
+		AmtPtpResumeElapsed(&pDeviceContext->Resume, AmtPtpResumeReadsStarted) / 10,
+		AmtPtpResumeElapsed(&pDeviceContext->Resume, AmtPtpResumeFirstReport) / 10,
+		pDeviceContext->Resume.MaxFirstReport / 10,
+		pDeviceContext->Resume.Retries
+	);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
 	// Cancel all outstanding requests
 	while (NT_SUCCESS(Status)) {
 		Status = WdfIoQueueRetrieveNextRequest(
@@ -394,38 +464,64 @@ AmtPtpEvtDeviceD0Exit(
 	return Status;
 }
 
+//
+// Enables the trackpad and starts reading for the PTP requests that queued up
+// meanwhile. If the trackpad does not take it, the recovery timer tries again
+// on the resume backoff.
+//
+static
 NTSTATUS
-AmtPtpEvtDeviceSelfManagedIoInitOrRestart(
+AmtPtpSpiResumeConfigure(
 	_In_ WDFDEVICE Device
 )
 {
-	NTSTATUS Status = STATUS_SUCCESS;
+	NTSTATUS Status;
 	PDEVICE_CONTEXT pDeviceContext;
+	ULONG RetryDelay = 0;
 
-	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 	pDeviceContext = DeviceGetContext(Device);
-	
+
 	Status = AmtPtpSpiSetState(Device, TRUE);
-	if (!NT_SUCCESS(Status))
-	{
-		// In this case, we will retry after 5 seconds. Block any incoming requests.
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "%!FUNC! AmtPtpSpiSetState failed with %!STATUS!. Retry after 5 seconds", Status);
-		Status = STATUS_SUCCESS;
-		WdfTimerStart(pDeviceContext->PowerOnRecoveryTimer, WDF_REL_TIMEOUT_IN_SEC(5));
-		goto exit;
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	if (NT_SUCCESS(Status)) {
+		AmtPtpResumeMark(&pDeviceContext->Resume, AmtPtpResumeConfigured, KeQueryInterruptTime());
+	} else {
+		RetryDelay = AmtPtpResumeNextRetry(&pDeviceContext->Resume);
 	}
-	else
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
+	if (!NT_SUCCESS(Status))
 	{
-		// Set time and status
-		pDeviceContext->DeviceStatus = D0ActiveAndConfigured;
-		KeQueryPerformanceCounter(&pDeviceContext->LastReportTime);
+		// Block any incoming requests until then
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "%!FUNC! AmtPtpSpiSetState failed with %!STATUS!. Retry after %d ms", Status, RetryDelay);
+		WdfTimerStart(pDeviceContext->PowerOnRecoveryTimer, WDF_REL_TIMEOUT_IN_MS(RetryDelay));
+		return Status;
 	}
 
-exit:
-	TraceEvents(TRACE_LEVEL_INFORMATION,TRACE_DRIVER, "%!FUNC! Exit, Status = %!STATUS!", Status);
+	pDeviceContext->DeviceStatus = D0ActiveAndConfigured;
+	AmtPtpSpiInputIssueRequest(Device);
+
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	AmtPtpResumeMark(&pDeviceContext->Resume, AmtPtpResumeReadsStarted, KeQueryInterruptTime());
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
 	return Status;
 }
 
+NTSTATUS
+AmtPtpEvtDeviceSelfManagedIoInitOrRestart(
+	_In_ WDFDEVICE Device
+)
+{
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
+
+	// A trackpad that is not ready yet is retried from the recovery timer
+	AmtPtpSpiResumeConfigure(Device);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,TRACE_DRIVER, "%!FUNC! Exit, Status = %!STATUS!", STATUS_SUCCESS);
+	return STATUS_SUCCESS;
+}
+
 PCHAR
 DbgDevicePowerString(
 	_In_ WDF_POWER_DEVICE_STATE Type
@@ -543,20 +639,12 @@ void AmtPtpPowerRecoveryTimerCallback(
 )
 {
 	WDFDEVICE Device;
-	PDEVICE_CONTEXT pDeviceContext;
 	NTSTATUS Status = STATUS_SUCCESS;
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 	Device = WdfTimerGetParentObject(Timer);
-	pDeviceContext = DeviceGetContext(Device);
 
-	Status = AmtPtpSpiSetState(Device, TRUE);
-	if (NT_SUCCESS(Status))
-	{
-		// Triage request and set status
-		AmtPtpSpiInputIssueRequest(Device);
-		pDeviceContext->DeviceStatus = D0ActiveAndConfigured;
-	}
+	Status = AmtPtpSpiResumeConfigure(Device);
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Exit, Status = %!STATUS!", Status);
 }
@@ -18,24 +18,9 @@ Environment:
 
 EXTERN_C_START
 
-typedef struct _SPI_TRACKPAD_INFO {
-	USHORT VendorId;
-	USHORT ProductId;
-	SHORT XMin;
-	SHORT XMax;
-	SHORT YMin;
-	SHORT YMax;
-} SPI_TRACKPAD_INFO, *PSPI_TRACKPAD_INFO;
-
-// Stupid Microsoft only assigns a UCHAR for touch ID
-// we could have a better approach
-typedef struct _PTP_AAPL_MAPPING {
-	SHORT OriginalX;
-	SHORT OriginalY;
-	INT8 ContactID;
-} PTP_AAPL_MAPPING, *PPTP_AAPL_MAPPING;
-
-#define MAPPING_MAX 10
+// SPI reads are created once and recycled
+#define SPI_READ_POOL_MAX_SIZE 8
+#define SPI_READ_POOL_DEFAULT_SIZE 4
 
 typedef enum _REPORT_TYPE {
 	PrecisionTouchpad = 0,
@@ -66,7 +51,8 @@ typedef struct _DEVICE_CONTEXT
 	USHORT HidVendorID;
 	USHORT HidProductID;
 	USHORT HidVersionNumber;
-	SPI_TRACKPAD_INFO TrackpadInfo;
+	const AMTPTP_DEVICE_MODEL* DeviceModel;
+	AMTPTP_DECODER_CONFIG DecoderConfig;
 	REPORT_TYPE ReportType;
 
 	// Windows PTP context
@@ -75,11 +61,33 @@ typedef struct _DEVICE_CONTEXT
 	BOOLEAN PtpReportButton;
 
 	// Timer
-	LARGE_INTEGER LastReportTime;
 	WDFTIMER PowerOnRecoveryTimer;
 
-	// List of buffers
-	WDFLOOKASIDE HidReadBufferLookaside;
+	// Recycled SPI reads, free list guarded by ReadPoolLock
+	WDFSPINLOCK ReadPoolLock;
+	WDFREQUEST ReadPoolFreeList[SPI_READ_POOL_MAX_SIZE];
+	ULONG ReadPoolSize;
+	ULONG ReadPoolFreeCount;
+	ULONG ReadPoolDeferred;
+
+	// Read pool statistics
+	ULONG ReadPoolAllocations;
+	ULONG ReadPoolIssued;
+	ULONG ReadPoolExhausted;
+
+	// PTP contact IDs, scan time, the rest of hybrid scans and malformed
+	// frames, guarded by InputLock
+	WDFSPINLOCK InputLock;
+	AMTPTP_CONTACT_TRACKER ContactTracker;
+	AMTPTP_SCAN_CLOCK ScanClock;
+	AMTPTP_REPORT_RING ReportRing;
+	AMTPTP_ERROR_BUDGET ErrorBudget;
+
+	// Resume phases since D0 entry, guarded by InputLock
+	AMTPTP_RESUME Resume;
+
+	// Outline of the last frames, dumped to the trace when input goes wrong
+	AMTPTP_TRACE_RING TraceRing;
 
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
@@ -19,6 +19,16 @@ Environment:
 #include <initguid.h>
 #include <hidport.h>
 
+#include <AmtPtpDecoder.h>
+#include <AmtPtpReportRing.h>
+#include <AmtPtpContactTracker.h>
+#include <AmtPtpScanClock.h>
+#include <AmtPtpErrorBudget.h>
+#include <AmtPtpResume.h>
+#include <AmtPtpDeviceRegistry.h>
+#include <AmtPtpHidReportLayout.h>
+#include <AmtPtpTraceRing.h>
+
 #include "device.h"
 #include "queue.h"
 #include "trace.h"
@@ -6,19 +6,21 @@
 #ifndef __AAPL_HID_DESCRIPTOR_H__
 #define __AAPL_HID_DESCRIPTOR_H__
 
-HID_REPORT_DESCRIPTOR AmtPtpSpiFamily1ReportDescriptor[] = {
-	AAPL_SPI_SERIES1_PTP_TLC,
+static_assert(RTL_NUMBER_OF_FIELD(PTP_REPORT, Contacts) == AMTPTP_HID_PTP_CONTACTS, "Descriptor disagrees on PTP_REPORT contacts");
+
+static const HID_REPORT_DESCRIPTOR AmtPtpSpiFamily1ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_SPI_PTP_CONTACT_ID, AMTPTP_GEOMETRY_SPI_FAMILY1),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtpSpiFamily1TouchscreenReportDescriptor[] = {
-	AAPL_SPI_SERIES1_TOUCHSCREEN_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtpSpiFamily1TouchscreenReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_SCREEN, AAPL_SPI_PTP_CONTACT_ID, AMTPTP_GEOMETRY_SPI_FAMILY1),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
 };
 
-CONST HID_DESCRIPTOR AmtPtpSpiFamily1DefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtpSpiFamily1DefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -30,19 +32,19 @@ CONST HID_DESCRIPTOR AmtPtpSpiFamily1DefaultHidDescriptor = {
 	}
 };
 
-HID_REPORT_DESCRIPTOR AmtPtpSpiFamily2ReportDescriptor[] = {
-	AAPL_SPI_SERIES2_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtpSpiFamily2ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_SPI_PTP_CONTACT_ID, AMTPTP_GEOMETRY_SPI_FAMILY2),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtpSpiFamily2TouchscreenReportDescriptor[] = {
-	AAPL_SPI_SERIES2_TOUCHSCREEN_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtpSpiFamily2TouchscreenReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_SCREEN, AAPL_SPI_PTP_CONTACT_ID, AMTPTP_GEOMETRY_SPI_FAMILY2),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
 };
 
-CONST HID_DESCRIPTOR AmtPtpSpiFamily2DefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtpSpiFamily2DefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -54,19 +56,19 @@ CONST HID_DESCRIPTOR AmtPtpSpiFamily2DefaultHidDescriptor = {
 	}
 };
 
-HID_REPORT_DESCRIPTOR AmtPtpSpiFamily3aReportDescriptor[] = {
-	AAPL_SPI_SERIES3_13_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtpSpiFamily3aReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_SPI_PTP_CONTACT_ID, AMTPTP_GEOMETRY_SPI_FAMILY3A),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtpSpiFamily3aTouchscreenReportDescriptor[] = {
-	AAPL_SPI_SERIES3_13_TOUCHSCREEN_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtpSpiFamily3aTouchscreenReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_SCREEN, AAPL_SPI_PTP_CONTACT_ID, AMTPTP_GEOMETRY_SPI_FAMILY3A),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
 };
 
-CONST HID_DESCRIPTOR AmtPtpSpiFamily3aDefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtpSpiFamily3aDefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -78,19 +80,19 @@ CONST HID_DESCRIPTOR AmtPtpSpiFamily3aDefaultHidDescriptor = {
 	}
 };
 
-HID_REPORT_DESCRIPTOR AmtPtpSpiFamily3bReportDescriptor[] = {
-	AAPL_SPI_SERIES3_15_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtpSpiFamily3bReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_SPI_PTP_CONTACT_ID, AMTPTP_GEOMETRY_SPI_FAMILY3B),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtpSpiFamily3bTouchscreenReportDescriptor[] = {
-	AAPL_SPI_SERIES3_15_TOUCHSCREEN_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtpSpiFamily3bTouchscreenReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_SCREEN, AAPL_SPI_PTP_CONTACT_ID, AMTPTP_GEOMETRY_SPI_FAMILY3B),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
 };
 
-CONST HID_DESCRIPTOR AmtPtpSpiFamily3bDefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtpSpiFamily3bDefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -102,6 +104,16 @@ CONST HID_DESCRIPTOR AmtPtpSpiFamily3bDefaultHidDescriptor = {
 	}
 };
 
+// Reports as this driver fills them, checked against the descriptor before it is handed out
+static const AMTPTP_HID_REPORT_SIZE AmtPtpReportSizes[] = {
+	{ AmtPtpHidReportInput,		REPORTID_MULTITOUCH,	sizeof(PTP_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_DEVICE_CAPS,	sizeof(PTP_DEVICE_CAPS_FEATURE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PTPHQA,		sizeof(PTP_DEVICE_HQA_CERTIFICATION_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_REPORTMODE,	sizeof(PTP_DEVICE_INPUT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_FUNCSWITCH,	sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_UMAPP_CONF,	sizeof(PTP_USERMODEAPP_CONF_REPORT) },
+};
+
 #endif
 
 _IRQL_requires_(PASSIVE_LEVEL)
@@ -144,14 +156,10 @@ AmtPtpGetHidDescriptor(
 	}
 
 	// Get HID descriptor from registry
-	switch (pDeviceContext->HidProductID)
+	switch (pDeviceContext->DeviceModel->Descriptor)
 	{
-		// MacBook 9, 10
-		case 0x0275:
-		case 0x0279:
-		// MacBookAir7,2 also use this fallback
-		case 0x0290:
-		case 0x0291:
+		// MacBook 9, 10, MacBookAir7,2 also use this fallback
+		case AmtPtpReportDescriptorSpiFamily1:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
@@ -180,8 +188,7 @@ AmtPtpGetHidDescriptor(
 			break;
 		}
 		// MacBookPro 11, 12 (13-inch). 15-inch is USB trackpad
-		case 0x0272:
-		case 0x0273:
+		case AmtPtpReportDescriptorSpiFamily2:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
@@ -210,8 +217,7 @@ AmtPtpGetHidDescriptor(
 			break;
 		}
 		// MacBookPro 13, 14 (13-inch)
-		case 0x0276:
-		case 0x0277:
+		case AmtPtpReportDescriptorSpiFamily3a:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
@@ -240,7 +246,7 @@ AmtPtpGetHidDescriptor(
 			break;
 		}
 		// MacBookPro 13, 14 (15-inch)
-		case 0x0278:
+		case AmtPtpReportDescriptorSpiFamily3b:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
@@ -373,6 +379,8 @@ AmtPtpGetReportDescriptor(
 	WDFMEMORY RequestMemory;
 	PDEVICE_CONTEXT pDeviceContext;
 	PVOID Descriptor = NULL;
+	AMTPTP_HID_LAYOUT_RESULT LayoutResult;
+	AMTPTP_HID_REPORT_SIZE LayoutMismatch = { 0 };
 
 	PAGED_CODE();
 
@@ -400,14 +408,10 @@ AmtPtpGetReportDescriptor(
 		goto exit;
 	}
 
-	switch (pDeviceContext->HidProductID)
+	switch (pDeviceContext->DeviceModel->Descriptor)
 	{
-		// MacBook 9, 10
-		case 0x0275:
-		case 0x0279:
-		// MacBookAir7,2 also use this fallback
-		case 0x0290:
-		case 0x0291:
+		// MacBook 9, 10, MacBookAir7,2 also use this fallback
+		case AmtPtpReportDescriptorSpiFamily1:
 		{
 			if (pDeviceContext->ReportType == PrecisionTouchpad)
 			{
@@ -422,8 +426,7 @@ AmtPtpGetReportDescriptor(
 			break;
 		}
 		// MacBookPro 11, 12 (13-inch)
-		case 0x0272:
-		case 0x0273:
+		case AmtPtpReportDescriptorSpiFamily2:
 		{
 			if (pDeviceContext->ReportType == PrecisionTouchpad)
 			{
@@ -438,8 +441,7 @@ AmtPtpGetReportDescriptor(
 			break;
 		}
 		// MacBookPro 13, 14 (13-inch)
-		case 0x0276:
-		case 0x0277:
+		case AmtPtpReportDescriptorSpiFamily3a:
 		{
 			if (pDeviceContext->ReportType == PrecisionTouchpad)
 			{
@@ -454,7 +456,7 @@ AmtPtpGetReportDescriptor(
 			break;
 		}
 		// MacBookPro 13, 14 (15-inch)
-		case 0x0278:
+		case AmtPtpReportDescriptorSpiFamily3b:
 		{
 			if (pDeviceContext->ReportType == PrecisionTouchpad)
 			{
@@ -496,6 +498,29 @@ AmtPtpGetReportDescriptor(
 		return Status;
 	}
 
+	// hidclass sizes reports from the descriptor, a mismatch would misread every report
+	LayoutResult = AmtPtpHidVerifyReportSizes(
+		(const UCHAR*) Descriptor,
+		(ULONG) CopiedSize,
+		AmtPtpReportSizes,
+		RTL_NUMBER_OF(AmtPtpReportSizes),
+		&LayoutMismatch
+	);
+
+	if (LayoutResult != AmtPtpHidLayoutOk)
+	{
+		Status = STATUS_INVALID_DEVICE_STATE;
+		TraceEvents(
+			TRACE_LEVEL_ERROR,
+			TRACE_DRIVER,
+			"%!FUNC! HID report descriptor does not match the driver (%d), report %d declares %d bytes",
+			LayoutResult,
+			LayoutMismatch.ReportId,
+			LayoutMismatch.Size
+		);
+		return Status;
+	}
+
 	Status = WdfMemoryCopyFromBuffer(
 		RequestMemory,
 		0,
@@ -642,7 +667,7 @@ AmtPtpReportFeatures(
 
 			PPTP_DEVICE_CAPS_FEATURE_REPORT capsReport = (PPTP_DEVICE_CAPS_FEATURE_REPORT) pHidPacket->reportBuffer;
 
-			capsReport->MaximumContactPoints = PTP_MAX_CONTACT_POINTS;
+			capsReport->MaximumContactPoints = PTP_MAX_HYBRID_CONTACT_POINTS;
 			capsReport->ButtonType = PTP_BUTTON_TYPE_CLICK_PAD;
 			capsReport->ReportID = REPORTID_DEVICE_CAPS;
 
@@ -37,3 +37,14 @@
 
 #define BEGIN_COLLECTION 0xa1
 #define END_COLLECTION   0xc0
+
+// PTP_CONTACT after tip switch and confidence: 3-bit id, 3 bits of padding
+#define AAPL_SPI_PTP_CONTACT_ID() \
+	REPORT_COUNT, 0x01, /* Report Count: 1 */ \
+	REPORT_SIZE, 0x03, /* Report Size: 3 */ \
+	LOGICAL_MAXIMUM, 0x03, /* Logical Maximum: 3 */ \
+	USAGE, 0x51, /* Usage: Contact Identifier */ \
+	INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+	REPORT_SIZE, 0x01, /* Report Size: 1 */ \
+	REPORT_COUNT, 0x03, /* Report Count: 3 */ \
+	INPUT, 0x03 /* Input: (Const, Var, Abs) */
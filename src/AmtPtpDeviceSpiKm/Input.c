@@ -1,6 +1,264 @@
 #include "driver.h"
 #include "Input.tmh"
 
+NTSTATUS
+AmtPtpSpiInputCreateReadPool(
+	WDFDEVICE Device,
+	ULONG PoolSize
+)
+{
+	NTSTATUS Status;
+	PDEVICE_CONTEXT pDeviceContext;
+	WDF_OBJECT_ATTRIBUTES Attributes;
+	WDFREQUEST SpiHidReadRequest;
+	PWORKER_REQUEST_CONTEXT RequestContext;
+	ULONG Index;
+
+	pDeviceContext = DeviceGetContext(Device);
+
+	if (PoolSize == 0 || PoolSize > SPI_READ_POOL_MAX_SIZE) {
+		PoolSize = SPI_READ_POOL_DEFAULT_SIZE;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&Attributes);
+	Attributes.ParentObject = Device;
+
+	Status = WdfSpinLockCreate(
+		&Attributes,
+		&pDeviceContext->ReadPoolLock
+	);
+
+	if (!NT_SUCCESS(Status))
+	{
+		TraceEvents(
+			TRACE_LEVEL_ERROR,
+			TRACE_DEVICE,
+			"%!FUNC! WdfSpinLockCreate fails, status = %!STATUS!",
+			Status
+		);
+
+		return Status;
+	}
+
+	// Requests and buffers are parented to the device, they go away with it
+	for (Index = 0; Index < PoolSize; Index++)
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&Attributes, WORKER_REQUEST_CONTEXT);
+		Attributes.ParentObject = Device;
+
+		Status = WdfRequestCreate(
+			&Attributes,
+			pDeviceContext->SpiTrackpadIoTarget,
+			&SpiHidReadRequest
+		);
+
+		if (!NT_SUCCESS(Status))
+		{
+			TraceEvents(
+				TRACE_LEVEL_ERROR,
+				TRACE_DEVICE,
+				"%!FUNC! WdfRequestCreate fails, status = %!STATUS!",
+				Status
+			);
+
+			return Status;
+		}
+
+		RequestContext = WorkerRequestGetContext(SpiHidReadRequest);
+		RequestContext->DeviceContext = pDeviceContext;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&Attributes);
+		Attributes.ParentObject = SpiHidReadRequest;
+
+		Status = WdfMemoryCreate(
+			&Attributes,
+			NonPagedPoolNx,
+			PTP_LIST_POOL_TAG,
+			REPORT_BUFFER_SIZE,
+			&RequestContext->RequestMemory,
+			NULL
+		);
+
+		if (!NT_SUCCESS(Status))
+		{
+			TraceEvents(
+				TRACE_LEVEL_ERROR,
+				TRACE_DEVICE,
+				"%!FUNC! WdfMemoryCreate fails, status = %!STATUS!",
+				Status
+			);
+
+			WdfObjectDelete(SpiHidReadRequest);
+			return Status;
+		}
+
+		pDeviceContext->ReadPoolFreeList[Index] = SpiHidReadRequest;
+		pDeviceContext->ReadPoolAllocations++;
+	}
+
+	pDeviceContext->ReadPoolSize = PoolSize;
+	pDeviceContext->ReadPoolFreeCount = PoolSize;
+	return STATUS_SUCCESS;
+}
+
+static
+WDFREQUEST
+AmtPtpSpiInputAcquireRead(
+	PDEVICE_CONTEXT pDeviceContext
+)
+{
+	WDFREQUEST SpiHidReadRequest = NULL;
+
+	WdfSpinLockAcquire(pDeviceContext->ReadPoolLock);
+
+	if (pDeviceContext->ReadPoolFreeCount > 0)
+	{
+		pDeviceContext->ReadPoolFreeCount--;
+		SpiHidReadRequest = pDeviceContext->ReadPoolFreeList[pDeviceContext->ReadPoolFreeCount];
+		pDeviceContext->ReadPoolIssued++;
+	}
+	else
+	{
+		// Issue it as soon as a read comes back
+		pDeviceContext->ReadPoolDeferred++;
+		pDeviceContext->ReadPoolExhausted++;
+	}
+
+	WdfSpinLockRelease(pDeviceContext->ReadPoolLock);
+	return SpiHidReadRequest;
+}
+
+// Returns TRUE if a deferred read should be issued now
+static
+BOOLEAN
+AmtPtpSpiInputReleaseRead(
+	PDEVICE_CONTEXT pDeviceContext,
+	WDFREQUEST SpiHidReadRequest
+)
+{
+	BOOLEAN IssueDeferred = FALSE;
+
+	WdfSpinLockAcquire(pDeviceContext->ReadPoolLock);
+
+	pDeviceContext->ReadPoolFreeList[pDeviceContext->ReadPoolFreeCount] = SpiHidReadRequest;
+	pDeviceContext->ReadPoolFreeCount++;
+
+	if (pDeviceContext->ReadPoolDeferred > 0)
+	{
+		pDeviceContext->ReadPoolDeferred--;
+		IssueDeferred = TRUE;
+	}
+
+	WdfSpinLockRelease(pDeviceContext->ReadPoolLock);
+	return IssueDeferred;
+}
+
+//
+// Writes the next report of Frame into a PTP request, without completing it.
+// The caller holds InputLock, so a parked frame leaves the ring only once
+// written.
+//
+static
+NTSTATUS
+AmtPtpSpiInputWriteReadReport(
+	WDFREQUEST PtpRequest,
+	const AMTPTP_DECODED_FRAME* Frame
+)
+{
+	NTSTATUS Status;
+	PTP_REPORT PtpReport;
+	WDFMEMORY PtpRequestMemory;
+
+	// Write report
+	AMTPTP_COMPOSE_REPORT(Frame, &PtpReport);
+
+	Status = WdfRequestRetrieveOutputMemory(
+		PtpRequest,
+		&PtpRequestMemory
+	);
+
+	if (!NT_SUCCESS(Status))
+	{
+		TraceEvents(
+			TRACE_LEVEL_ERROR,
+			TRACE_DRIVER,
+			"%!FUNC! WdfRequestRetrieveOutputBuffer failed with %!STATUS!",
+			Status
+		);
+
+		return Status;
+	}
+
+	Status = WdfMemoryCopyFromBuffer(
+		PtpRequestMemory,
+		0,
+		(PVOID) &PtpReport,
+		sizeof(PTP_REPORT)
+	);
+
+	if (!NT_SUCCESS(Status))
+	{
+		TraceEvents(
+			TRACE_LEVEL_ERROR,
+			TRACE_DRIVER,
+			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
+			Status
+		);
+
+		return Status;
+	}
+
+	// Set information
+	WdfRequestSetInformation(
+		PtpRequest,
+		sizeof(PTP_REPORT)
+	);
+
+	return Status;
+}
+
+//
+// Hands parked frames to PTP requests that are already pending, oldest
+// first. A frame that finds frames parked is parked behind them, so the rest
+// of a hybrid scan reaches hidclass before anything that came in after it.
+//
+static
+VOID
+AmtPtpSpiInputServeParked(
+	PDEVICE_CONTEXT pDeviceContext
+)
+{
+	NTSTATUS Status;
+	WDFREQUEST PtpRequest;
+	AMTPTP_DECODED_FRAME Frame;
+
+	for (;;) {
+		WdfSpinLockAcquire(pDeviceContext->InputLock);
+		if (AmtPtpReportRingCount(&pDeviceContext->ReportRing) == 0 ||
+			!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(pDeviceContext->HidQueue, &PtpRequest))) {
+			WdfSpinLockRelease(pDeviceContext->InputLock);
+			return;
+		}
+
+		AmtPtpReportRingPeek(&pDeviceContext->ReportRing, &Frame);
+		Status = AmtPtpSpiInputWriteReadReport(PtpRequest, &Frame);
+		if (NT_SUCCESS(Status)) {
+			AmtPtpReportRingAdvance(&pDeviceContext->ReportRing, PTP_MAX_CONTACT_POINTS);
+		}
+		WdfSpinLockRelease(pDeviceContext->InputLock);
+
+		WdfRequestComplete(
+			PtpRequest,
+			Status
+		);
+
+		if (NT_SUCCESS(Status)) {
+			AmtPtpTraceRingRecord(&pDeviceContext->TraceRing, AmtPtpTraceReportOut, Frame.ContactCount, Frame.ScanTime,
+				KeQueryInterruptTime());
+		}
+	}
+}
+
 VOID
 AmtPtpSpiInputRoutineWorker(
 	WDFDEVICE Device,
@@ -9,12 +267,36 @@ AmtPtpSpiInputRoutineWorker(
 {
 	NTSTATUS Status;
 	PDEVICE_CONTEXT pDeviceContext;
+	AMTPTP_DECODED_FRAME Frame;
 	pDeviceContext = DeviceGetContext(Device);
 
+	// Serve a parked frame first, it needs no SPI read. It stays parked until
+	// it made it into the request.
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	if (AmtPtpReportRingPeek(&pDeviceContext->ReportRing, &Frame)) {
+		Status = AmtPtpSpiInputWriteReadReport(PtpRequest, &Frame);
+		if (NT_SUCCESS(Status)) {
+			AmtPtpReportRingAdvance(&pDeviceContext->ReportRing, PTP_MAX_CONTACT_POINTS);
+		}
+		WdfSpinLockRelease(pDeviceContext->InputLock);
+
+		WdfRequestComplete(
+			PtpRequest,
+			Status
+		);
+
+		if (NT_SUCCESS(Status)) {
+			AmtPtpTraceRingRecord(&pDeviceContext->TraceRing, AmtPtpTraceReportOut, Frame.ContactCount, Frame.ScanTime,
+				KeQueryInterruptTime());
+		}
+		return;
+	}
+
 	Status = WdfRequestForwardToIoQueue(
 		PtpRequest,
 		pDeviceContext->HidQueue
 	);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
 
 	if (!NT_SUCCESS(Status)) {
 		TraceEvents(
@@ -42,37 +324,34 @@ AmtPtpSpiInputIssueRequest(
 {
 	NTSTATUS Status;
 	PDEVICE_CONTEXT pDeviceContext;
-	WDF_OBJECT_ATTRIBUTES Attributes;
+	WDF_REQUEST_REUSE_PARAMS ReuseParams;
 	BOOLEAN RequestStatus = FALSE;
 	WDFREQUEST SpiHidReadRequest;
-	WDFMEMORY SpiHidReadOutputMemory;
 	PWORKER_REQUEST_CONTEXT RequestContext;
 	pDeviceContext = DeviceGetContext(Device);
 
-	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&Attributes, WORKER_REQUEST_CONTEXT);
-	Attributes.ParentObject = Device;
-
-	Status = WdfRequestCreate(
-		&Attributes,
-		pDeviceContext->SpiTrackpadIoTarget,
-		&SpiHidReadRequest
-	);
-
-	if (!NT_SUCCESS(Status))
+	SpiHidReadRequest = AmtPtpSpiInputAcquireRead(pDeviceContext);
+	if (SpiHidReadRequest == NULL)
 	{
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
+		TraceHot(
+			TRACE_LEVEL_VERBOSE,
 			TRACE_DEVICE,
-			"%!FUNC! WdfRequestCreate fails, status = %!STATUS!",
-			Status
+			"%!FUNC! All %d SPI reads are in flight",
+			pDeviceContext->ReadPoolSize
 		);
 
 		return;
 	}
 
-	Status = WdfMemoryCreateFromLookaside(
-		pDeviceContext->HidReadBufferLookaside,
-		&SpiHidReadOutputMemory
+	WDF_REQUEST_REUSE_PARAMS_INIT(
+		&ReuseParams,
+		WDF_REQUEST_REUSE_NO_FLAGS,
+		STATUS_SUCCESS
+	);
+
+	Status = WdfRequestReuse(
+		SpiHidReadRequest,
+		&ReuseParams
 	);
 
 	if (!NT_SUCCESS(Status))
@@ -80,27 +359,23 @@ AmtPtpSpiInputIssueRequest(
 		TraceEvents(
 			TRACE_LEVEL_INFORMATION,
 			TRACE_DEVICE,
-			"%!FUNC! WdfMemoryCreateFromLookaside fails, status = %!STATUS!",
+			"%!FUNC! WdfRequestReuse fails, status = %!STATUS!",
 			Status
 		);
 
-		WdfObjectDelete(SpiHidReadRequest);
+		AmtPtpSpiInputReleaseRead(pDeviceContext, SpiHidReadRequest);
 		return;
 	}
 
-	// Assign context information
-	RequestContext = WorkerRequestGetContext(SpiHidReadRequest);
-	RequestContext->DeviceContext = pDeviceContext;
-	RequestContext->RequestMemory = SpiHidReadOutputMemory;
-
 	// Invoke HID read request to the device.
+	RequestContext = WorkerRequestGetContext(SpiHidReadRequest);
 	Status = WdfIoTargetFormatRequestForInternalIoctl(
 		pDeviceContext->SpiTrackpadIoTarget,
 		SpiHidReadRequest,
 		IOCTL_HID_READ_REPORT,
 		NULL,
 		0,
-		SpiHidReadOutputMemory,
+		RequestContext->RequestMemory,
 		0
 	);
 
@@ -113,14 +388,7 @@ AmtPtpSpiInputIssueRequest(
 			Status
 		);
 
-		if (SpiHidReadOutputMemory != NULL) {
-			WdfObjectDelete(SpiHidReadOutputMemory);
-		}
-
-		if (SpiHidReadRequest != NULL) {
-			WdfObjectDelete(SpiHidReadRequest);
-		}
-
+		AmtPtpSpiInputReleaseRead(pDeviceContext, SpiHidReadRequest);
 		return;
 	}
 
@@ -144,13 +412,34 @@ AmtPtpSpiInputIssueRequest(
 			"%!FUNC! AmtPtpSpiInputRoutineWorker request failed to sent"
 		);
 
-		if (SpiHidReadOutputMemory != NULL) {
-			WdfObjectDelete(SpiHidReadOutputMemory);
-		}
+		AmtPtpSpiInputReleaseRead(pDeviceContext, SpiHidReadRequest);
+	}
+}
 
-		if (SpiHidReadRequest != NULL) {
-			WdfObjectDelete(SpiHidReadRequest);
-		}
+//
+// Writes the frames leading up to an input error to the trace, oldest first.
+//
+static
+VOID
+AmtPtpSpiInputDumpTraceRing(
+	PDEVICE_CONTEXT pDeviceContext
+)
+{
+	AMTPTP_TRACE_CURSOR Cursor;
+	AMTPTP_TRACE_RECORD Record;
+
+	AmtPtpTraceRingBegin(&pDeviceContext->TraceRing, &Cursor);
+	while (AmtPtpTraceRingNext(&pDeviceContext->TraceRing, &Cursor, &Record)) {
+		TraceEvents(
+			TRACE_LEVEL_WARNING,
+			TRACE_HID_INPUT,
+			"%!FUNC! #%d %llu us %s %d %d",
+			Record.Sequence,
+			Record.Time / 10,
+			AmtPtpTraceEventName(Record.Event),
+			Record.Arg0,
+			Record.Arg1
+		);
 	}
 }
 
@@ -170,11 +459,12 @@ AmtPtpRequestCompletionRoutine(
 	PSPI_TRACKPAD_PACKET pSpiTrackpadPacket;
 
 	WDFREQUEST PtpRequest;
-	PTP_REPORT PtpReport;
-	WDFMEMORY PtpRequestMemory;
-
-	LARGE_INTEGER CurrentCounter;
-	LONGLONG CounterDelta;
+	AMTPTP_DECODED_FRAME Frame;
+	AMTPTP_FRAME_CHECK FrameCheck;
+	AMTPTP_FRAME_VERDICT Verdict;
+	AMTPTP_RING_PUSH_RESULT PushResult;
+	ULONG ParkedFrames;
+	ULONGLONG HostTime;
 
 	UNREFERENCED_PARAMETER(Target);
 
@@ -182,15 +472,13 @@ AmtPtpRequestCompletionRoutine(
 	RequestContext = (PWORKER_REQUEST_CONTEXT) Context;
 	pDeviceContext = RequestContext->DeviceContext;
 
-	// Read report and fulfill PTP request.
-	// If no report is found, just exit.
-	Status = WdfIoQueueRetrieveNextRequest(pDeviceContext->HidQueue, &PtpRequest);
-	if (!NT_SUCCESS(Status)) {
+	// Reads cancelled on the way out of D0 carry no frame
+	if (!NT_SUCCESS(Params->IoStatus.Status)) {
 		TraceEvents(
-			TRACE_LEVEL_ERROR,
+			TRACE_LEVEL_INFORMATION,
 			TRACE_DRIVER,
-			"%!FUNC! WdfIoQueueRetrieveNextRequest failed with %!STATUS!",
-			Status
+			"%!FUNC! SPI read failed with %!STATUS!",
+			Params->IoStatus.Status
 		);
 
 		goto cleanup;
@@ -198,124 +486,127 @@ AmtPtpRequestCompletionRoutine(
 
 	SpiRequestLength = (LONG) WdfRequestGetInformation(SpiRequest);
 	pSpiTrackpadPacket = (PSPI_TRACKPAD_PACKET) WdfMemoryGetBuffer(Params->Parameters.Ioctl.Output.Buffer, NULL);
-
-	// Safe measurement for buffer overrun and device state reset
-	if (SpiRequestLength < 46) {
+	HostTime = KeQueryInterruptTime();
+
+	// Safe measurement for buffer overrun. A short frame is skipped and the
+	// PTP request keeps waiting, the trackpad is only re-enabled once short
+	// frames keep coming.
+	FrameCheck = (SpiRequestLength < 0) ? AmtPtpFrameCorrupt : AmtPtpDecodeFrameSalvage(&pDeviceContext->DecoderConfig,
+		(const UCHAR*) pSpiTrackpadPacket, (SIZE_T) SpiRequestLength, &Frame);
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	Verdict = AmtPtpErrorBudgetRecord(&pDeviceContext->ErrorBudget, FrameCheck, HostTime);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
+	AmtPtpTraceRingRecord(&pDeviceContext->TraceRing,
+		(Verdict == AmtPtpFrameDeliver) ? AmtPtpTraceFrameIn : AmtPtpTraceFrameRejected, (ULONG) SpiRequestLength,
+		(Verdict == AmtPtpFrameDeliver) ? (ULONG) FrameCheck : (ULONG) Verdict, HostTime);
+
+	if (Verdict == AmtPtpFrameReset) {
 		TraceEvents(
 			TRACE_LEVEL_ERROR,
 			TRACE_DRIVER,
-			"%!FUNC! Input too small: %d < 46. Attempt to re-enable the device.",
-			SpiRequestLength
-		);
-
-		Status = STATUS_DEVICE_DATA_ERROR;
-		goto exit;
-	}
-
-	// Get Counter
-	KeQueryPerformanceCounter(
-		&CurrentCounter
-	);
-
-	CounterDelta = (CurrentCounter.QuadPart - pDeviceContext->LastReportTime.QuadPart) / 100;
-	pDeviceContext->LastReportTime.QuadPart = CurrentCounter.QuadPart;
-
-	// Write report
-	PtpReport.ReportID = REPORTID_MULTITOUCH;
-	PtpReport.ContactCount = pSpiTrackpadPacket->NumOfFingers;
-	PtpReport.IsButtonClicked = pSpiTrackpadPacket->ClickOccurred;
-
-	UINT8 AdjustedCount = (pSpiTrackpadPacket->NumOfFingers > 5) ? 5 : pSpiTrackpadPacket->NumOfFingers;
-	for (UINT8 Count = 0; Count < AdjustedCount; Count++)
-	{
-		PtpReport.Contacts[Count].ContactID = Count;
-		PtpReport.Contacts[Count].X = ((pSpiTrackpadPacket->Fingers[Count].X - pDeviceContext->TrackpadInfo.XMin) > 0) ? 
-			(USHORT)(pSpiTrackpadPacket->Fingers[Count].X - pDeviceContext->TrackpadInfo.XMin) : 0;
-		PtpReport.Contacts[Count].Y = ((pDeviceContext->TrackpadInfo.YMax - pSpiTrackpadPacket->Fingers[Count].Y) > 0) ? 
-			(USHORT)(pDeviceContext->TrackpadInfo.YMax - pSpiTrackpadPacket->Fingers[Count].Y) : 0;
-		PtpReport.Contacts[Count].TipSwitch = (pSpiTrackpadPacket->Fingers[Count].Pressure > 0) ? 1 : 0;
-
-		// $S = \pi * (Touch_{Major} * Touch_{Minor}) / 4$
-		// $S = \pi * r^2$
-		// $r^2 = (Touch_{Major} * Touch_{Minor}) / 4$
-		// Using i386 in 2018 is evil
-		PtpReport.Contacts[Count].Confidence = (pSpiTrackpadPacket->Fingers[Count].TouchMajor < 2500 &&
-			pSpiTrackpadPacket->Fingers[Count].TouchMinor < 2500) ? 1 : 0;
-
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_HID_INPUT,
-			"%!FUNC! PTP Contact %d OX %d, OY %d, X %d, Y %d",
-			Count,
-			pSpiTrackpadPacket->Fingers[Count].OriginalX,
-			pSpiTrackpadPacket->Fingers[Count].OriginalY,
-			pSpiTrackpadPacket->Fingers[Count].X,
-			pSpiTrackpadPacket->Fingers[Count].Y
+			"%!FUNC! Input too small: %d < %d. Attempt to re-enable the device.",
+			SpiRequestLength,
+			AMTPTP_SPI_HEADER_SIZE
 		);
-	}
+		AmtPtpSpiInputDumpTraceRing(pDeviceContext);
 
-	if (CounterDelta >= 0xFF)
-	{
-		PtpReport.ScanTime = 0xFF;
-	}
-	else
-	{
-		PtpReport.ScanTime = (USHORT) CounterDelta;
+		// The recovery timer re-enables the trackpad at passive level and issues the next read
+		pDeviceContext->DeviceStatus = D0ActiveAndUnconfigured;
+		AmtPtpSpiInputReleaseRead(pDeviceContext, SpiRequest);
+		WdfTimerStart(pDeviceContext->PowerOnRecoveryTimer, WDF_REL_TIMEOUT_IN_MS(10));
+		return;
 	}
 
-	Status = WdfRequestRetrieveOutputMemory(
-		PtpRequest,
-		&PtpRequestMemory
-	);
-
-	if (!NT_SUCCESS(Status))
-	{
+	if (Verdict == AmtPtpFrameDrop) {
 		TraceEvents(
-			TRACE_LEVEL_ERROR,
+			TRACE_LEVEL_WARNING,
 			TRACE_DRIVER,
-			"%!FUNC! WdfRequestRetrieveOutputBuffer failed with %!STATUS!",
-			Status
+			"%!FUNC! Input too small: %d < %d. Frame dropped.",
+			SpiRequestLength,
+			AMTPTP_SPI_HEADER_SIZE
 		);
 
-		goto exit;
+		// Read again for the PTP request this frame was meant for
+		if (AmtPtpSpiInputReleaseRead(pDeviceContext, SpiRequest)) {
+			AmtPtpSpiInputIssueRequest(pDeviceContext->SpiDevice);
+		}
+		if (pDeviceContext->DeviceStatus == D0ActiveAndConfigured) {
+			AmtPtpSpiInputIssueRequest(pDeviceContext->SpiDevice);
+		}
+		return;
 	}
 
-	Status = WdfMemoryCopyFromBuffer(
-		PtpRequestMemory,
-		0,
-		(PVOID) &PtpReport,
-		sizeof(PTP_REPORT)
-	);
+	// Contacts go to the trace for one frame in AMTPTP_TRACE_SAMPLE_INTERVAL
+	if (AmtPtpTraceRingSample(&pDeviceContext->TraceRing)) {
+		for (UCHAR Count = 0; Count < Frame.ContactCount && Count < PTP_MAX_CONTACT_POINTS; Count++)
+		{
+			TraceHot(
+				TRACE_LEVEL_VERBOSE,
+				TRACE_HID_INPUT,
+				"%!FUNC! PTP Contact %d OX %d, OY %d, X %d, Y %d",
+				Count,
+				pSpiTrackpadPacket->Fingers[Count].OriginalX,
+				pSpiTrackpadPacket->Fingers[Count].OriginalY,
+				pSpiTrackpadPacket->Fingers[Count].X,
+				pSpiTrackpadPacket->Fingers[Count].Y
+			);
+		}
+	}
 
-	if (!NT_SUCCESS(Status))
-	{
-		TraceEvents(
-			TRACE_LEVEL_ERROR,
-			TRACE_DRIVER,
-			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
-			Status
-		);
+	// Keep contact IDs stable and fulfill a pending PTP request. If none is
+	// pending, or part of an earlier scan is still parked, the frame is parked
+	// and waits in line for the next one.
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	AmtPtpResumeMark(&pDeviceContext->Resume, AmtPtpResumeFirstReport, HostTime);
+	AmtPtpScanClockUpdate(&pDeviceContext->ScanClock, &Frame, HostTime);
+	AmtPtpContactTrackerUpdate(&pDeviceContext->ContactTracker, &Frame, PTP_MAX_HYBRID_CONTACT_POINTS);
+	if (AmtPtpReportRingCount(&pDeviceContext->ReportRing) != 0 ||
+		!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(pDeviceContext->HidQueue, &PtpRequest))) {
+		PushResult = AmtPtpReportRingPush(&pDeviceContext->ReportRing, &Frame);
+		ParkedFrames = AmtPtpReportRingCount(&pDeviceContext->ReportRing);
+		WdfSpinLockRelease(pDeviceContext->InputLock);
+
+		AmtPtpTraceRingRecord(&pDeviceContext->TraceRing,
+			(PushResult == AmtPtpRingPushDroppedOldest) ? AmtPtpTraceFrameDropped : AmtPtpTraceFrameParked,
+			Frame.ContactCount, ParkedFrames, HostTime);
+		if (PushResult == AmtPtpRingPushDroppedOldest) {
+			TraceHot(
+				TRACE_LEVEL_WARNING,
+				TRACE_DRIVER,
+				"%!FUNC! Report ring full, oldest frame dropped (%d total)",
+				pDeviceContext->ReportRing.Dropped
+			);
+		}
 
-		goto exit;
+		AmtPtpSpiInputServeParked(pDeviceContext);
+		goto cleanup;
 	}
 
-	// Set information
-	WdfRequestSetInformation(
-		PtpRequest,
-		sizeof(PTP_REPORT)
-	);
+	// The rest of a hybrid scan goes out with the next requests. A frame that
+	// did not make it into the request is parked whole for the next one.
+	Status = AmtPtpSpiInputWriteReadReport(PtpRequest, &Frame);
+	if (!NT_SUCCESS(Status)) {
+		AmtPtpReportRingPush(&pDeviceContext->ReportRing, &Frame);
+	} else if (Frame.ContactCount > PTP_MAX_CONTACT_POINTS) {
+		AmtPtpReportRingPushRemainder(&pDeviceContext->ReportRing, &Frame, PTP_MAX_CONTACT_POINTS);
+	}
+	WdfSpinLockRelease(pDeviceContext->InputLock);
 
-exit:
 	WdfRequestComplete(
 		PtpRequest,
 		Status
 	);
 
+	if (NT_SUCCESS(Status)) {
+		AmtPtpTraceRingRecord(&pDeviceContext->TraceRing, AmtPtpTraceReportOut, Frame.ContactCount, Frame.ScanTime, HostTime);
+	}
+	AmtPtpSpiInputServeParked(pDeviceContext);
+
 cleanup:
-	// Clean up
+	// Hand the read back to the pool
 	pSpiTrackpadPacket = NULL;
-	WdfObjectDelete(SpiRequest);
-	if (RequestContext->RequestMemory != NULL) {
-		WdfObjectDelete(RequestContext->RequestMemory);
+	if (AmtPtpSpiInputReleaseRead(pDeviceContext, SpiRequest)) {
+		AmtPtpSpiInputIssueRequest(pDeviceContext->SpiDevice);
 	}
 }
@@ -2,6 +2,12 @@
 
 EVT_WDF_REQUEST_COMPLETION_ROUTINE AmtPtpRequestCompletionRoutine;
 
+NTSTATUS
+AmtPtpSpiInputCreateReadPool(
+	WDFDEVICE Device,
+	ULONG PoolSize
+);
+
 VOID
 AmtPtpSpiInputRoutineWorker(
 	WDFDEVICE Device,
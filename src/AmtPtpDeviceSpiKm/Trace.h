@@ -51,6 +51,29 @@ Environment:
 #define WPP_RECORDER_FLAGS_LEVEL_ARGS(flags, lvl) WPP_RECORDER_LEVEL_FLAGS_ARGS(lvl, flags)
 #define WPP_RECORDER_FLAGS_LEVEL_FILTER(flags, lvl) WPP_RECORDER_LEVEL_FLAGS_FILTER(lvl, flags)
 
+//
+// Per-frame call sites use TraceHot. One below AMTPTP_HOT_TRACE_LEVEL is
+// compiled out by a constant level check, so a release build neither formats
+// it nor logs it to the in-flight recorder, whatever the session asks for.
+//
+#ifndef AMTPTP_HOT_TRACE_LEVEL
+#if DBG
+#define AMTPTP_HOT_TRACE_LEVEL TRACE_LEVEL_VERBOSE
+#else
+#define AMTPTP_HOT_TRACE_LEVEL TRACE_LEVEL_WARNING
+#endif
+#endif
+
+#define WPP_HOTLEVEL_FLAGS_LOGGER(lvl, flags) \
+    WPP_LEVEL_LOGGER(flags)
+
+#define WPP_HOTLEVEL_FLAGS_ENABLED(lvl, flags) \
+    ((lvl) <= AMTPTP_HOT_TRACE_LEVEL && WPP_LEVEL_FLAGS_ENABLED(lvl, flags))
+
+#define WPP_RECORDER_HOTLEVEL_FLAGS_ARGS(lvl, flags) WPP_RECORDER_LEVEL_FLAGS_ARGS(lvl, flags)
+#define WPP_RECORDER_HOTLEVEL_FLAGS_FILTER(lvl, flags) \
+    ((lvl) <= AMTPTP_HOT_TRACE_LEVEL && WPP_RECORDER_LEVEL_FLAGS_FILTER(lvl, flags))
+
 //
 // This comment block is scanned by the trace preprocessor to define our
 // Trace function.
@@ -58,5 +81,6 @@ Environment:
 // begin_wpp config
 // FUNC Trace{FLAGS=TRACE_DRIVER}(LEVEL, MSG, ...);
 // FUNC TraceEvents(LEVEL, FLAGS, MSG, ...);
+// FUNC TraceHot(HOTLEVEL, FLAGS, MSG, ...);
 // end_wpp
 //
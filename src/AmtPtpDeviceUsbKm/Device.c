@@ -23,18 +23,20 @@ Environment:
 #endif
 
 _IRQL_requires_(PASSIVE_LEVEL)
-static const struct BCM5974_CONFIG*
+static const AMTPTP_DEVICE_MODEL*
 AmtPtpGetDeviceConfig(
 	_In_ USB_DEVICE_DESCRIPTOR deviceInfo
 )
 {
-	USHORT id = deviceInfo.idProduct;
-	const struct BCM5974_CONFIG* cfg;
+	const AMTPTP_DEVICE_MODEL* model = AmtPtpDeviceRegistryLookup(
+		AmtPtpBusUsb,
+		deviceInfo.idVendor,
+		deviceInfo.idProduct
+	);
 
-	for (cfg = Bcm5974ConfigTable; cfg->identification; ++cfg) {
-		if (cfg->identification == id) {
-			return cfg;
-		}
+	if (model != NULL &&
+		(model->Descriptor == AmtPtpReportDescriptorT2 || model->Descriptor == AmtPtpReportDescriptorT2Small)) {
+		return model;
 	}
 
 	// Generic fallback
@@ -44,7 +46,35 @@ AmtPtpGetDeviceConfig(
 		"%!FUNC! Selected a generic fallback configuration"
 	);
 
-	return &Bcm5974ConfigTable[0];
+	return AmtPtpDeviceRegistryGetModel(AmtPtpModelT2);
+}
+
+_IRQL_requires_(PASSIVE_LEVEL)
+static VOID
+AmtPtpInitDecoderConfig(
+	_In_ PDEVICE_CONTEXT DeviceContext
+)
+{
+	const AMTPTP_DEVICE_MODEL* model = DeviceContext->DeviceInfo;
+	PAMTPTP_DECODER_CONFIG decoderConfig = &DeviceContext->DecoderConfig;
+
+	// T2 finger records follow a 16-bit pad and start with a 16-bit origin word.
+	// Read from the end of the header, abs_x lines up with the common layout.
+	AmtPtpDeviceRegistryInitDecoderConfig(model,
+		AMTPTP_DECODER_FLAG_CONTACT_ID_FROM_SLOT | AMTPTP_DECODER_FLAG_TIP_FROM_TOUCH_AREA,
+		decoderConfig);
+
+	// Slot ids are not stable, the tracker matches contacts by position instead
+	AmtPtpContactTrackerInitialize(&DeviceContext->ContactTracker, decoderConfig);
+	AmtPtpContactTrackerSetFuzz(&DeviceContext->ContactTracker,
+		AMTPTP_FUZZ_FROM_SNRATIO(model->X.Min, model->X.Max, model->X.SnRatio),
+		AMTPTP_FUZZ_FROM_SNRATIO(model->Y.Min, model->Y.Max, model->Y.SnRatio));
+
+	// T2 headers have no usable timestamp, ScanTime follows the host clock
+	AmtPtpScanClockInitialize(&DeviceContext->ScanClock, 0);
+
+	AmtPtpErrorBudgetInitialize(&DeviceContext->ErrorBudget,
+		AMTPTP_ERROR_BUDGET_DEFAULT_WINDOW, AMTPTP_ERROR_BUDGET_DEFAULT_LIMIT);
 }
 
 NTSTATUS
@@ -105,6 +135,19 @@ Return Value:
         //
 		deviceContext->PtpReportButton = TRUE;
 		deviceContext->PtpReportTouch = TRUE;
+		AmtPtpReportRingInitialize(
+			&deviceContext->ReportRing,
+			AMTPTP_REPORT_RING_DEFAULT_DEPTH,
+			AmtPtpRingOverflowCoalesce
+		);
+
+        //
+        // The lock makes the report ring and InputQueue one unit.
+        //
+        status = WdfSpinLockCreate(WDF_NO_OBJECT_ATTRIBUTES, &deviceContext->InputLock);
+        if (!NT_SUCCESS(status)) {
+            return status;
+        }
 
         //
         // Create a device interface so that applications can find and talk
@@ -196,7 +239,7 @@ Return Value:
 		&pDeviceContext->DeviceDescriptor
 	);
 
-	// Get correct configuration from conf store
+	// Get correct configuration from device registry
 	pDeviceContext->DeviceInfo = AmtPtpGetDeviceConfig(pDeviceContext->DeviceDescriptor);
 	if (pDeviceContext->DeviceInfo == NULL) {
 		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE,
@@ -205,6 +248,8 @@ Return Value:
 		return status;
 	}
 
+	AmtPtpInitDecoderConfig(pDeviceContext);
+
 	//
 	// Retrieve USBD version information, port driver capabilites and device
 	// capabilites such as speed, power, etc.
@@ -315,9 +360,6 @@ AmtPtpEvtDeviceD0Entry(
 		}
 	}
 
-	// Get current time counter
-	KeQueryPerformanceCounter(&pDeviceContext->LastReportTime);
-
 	//
 	// Since continuous reader is configured for this interrupt-pipe, we must explicitly start
 	// the I/O target to get the framework to post read requests.
@@ -385,6 +427,47 @@ AmtPtpEvtDeviceD0Exit(
 		WdfIoTargetCancelSentIo
 	);
 
+	// Parked frames are stale once the device leaves D0
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Report ring: %d parked, %d dropped, %d coalesced, high watermark %d",
+		AmtPtpReportRingCount(&pDeviceContext->ReportRing),
+		pDeviceContext->ReportRing.Dropped,
+		pDeviceContext->ReportRing.Coalesced,
+		pDeviceContext->ReportRing.HighWatermark
+	);
+	AmtPtpReportRingFlush(&pDeviceContext->ReportRing);
+
+	// Contacts don't survive the power transition either
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Contact tracker: %d lift-offs, %d dropped",
+		pDeviceContext->ContactTracker.LiftOffs,
+		pDeviceContext->ContactTracker.Dropped
+	);
+	AmtPtpContactTrackerReset(&pDeviceContext->ContactTracker);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Scan clock: %d resyncs",
+		pDeviceContext->ScanClock.Resyncs
+	);
+	AmtPtpScanClockReset(&pDeviceContext->ScanClock);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Malformed frames: %d salvaged, %d dropped, %d over budget, %llu ms input lost",
+		pDeviceContext->ErrorBudget.Salvaged,
+		pDeviceContext->ErrorBudget.Dropped,
+		pDeviceContext->ErrorBudget.Resets,
+		pDeviceContext->ErrorBudget.LostTime / 10000
+	);
+	AmtPtpErrorBudgetReset(&pDeviceContext->ErrorBudget);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
 	// Cancel Wellspring mode.
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -522,7 +605,7 @@ AmtPtpSetWellspringMode(
 
 	// Type 3 does not need a mode switch.
 	// However, turn mode on or off as requested.
-	if (DeviceContext->DeviceInfo->tp_type == TYPE3) {
+	if (DeviceContext->DeviceInfo->ModeSwitch.Length == 0) {
 		DeviceContext->IsWellspringModeOn = IsWellspringModeOn;
 		return STATUS_SUCCESS;
 	}
@@ -531,7 +614,7 @@ AmtPtpSetWellspringMode(
 		WDF_NO_OBJECT_ATTRIBUTES,
 		PagedPool,
 		POOL_TAG_PTP_CONTROL,
-		DeviceContext->DeviceInfo->um_size,
+		DeviceContext->DeviceInfo->ModeSwitch.Length,
 		&bufHandle,
 		&buffer
 	);
@@ -542,13 +625,13 @@ AmtPtpSetWellspringMode(
 
 	RtlZeroMemory(
 		buffer,
-		DeviceContext->DeviceInfo->um_size
+		DeviceContext->DeviceInfo->ModeSwitch.Length
 	);
 
 	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
 		&memoryDescriptor,
 		buffer,
-		sizeof(DeviceContext->DeviceInfo->um_size)
+		DeviceContext->DeviceInfo->ModeSwitch.Length
 	);
 
 	WDF_USB_CONTROL_SETUP_PACKET_INIT(
@@ -556,8 +639,8 @@ AmtPtpSetWellspringMode(
 		BmRequestDeviceToHost,
 		BmRequestToInterface,
 		BCM5974_WELLSPRING_MODE_READ_REQUEST_ID,
-		(USHORT) DeviceContext->DeviceInfo->um_req_val,
-		(USHORT) DeviceContext->DeviceInfo->um_req_idx
+		DeviceContext->DeviceInfo->ModeSwitch.Value,
+		DeviceContext->DeviceInfo->ModeSwitch.Index
 	);
 
 	// Set stuffs right
@@ -573,23 +656,23 @@ AmtPtpSetWellspringMode(
 	);
 
 	// Behavior mismatch: Actual device does not transfer bytes as expected (in length)
-	// So we do not check um_size as a temporary workaround.
+	// So we do not check the message length as a temporary workaround.
 	if (!NT_SUCCESS(status)) {
 		TraceEvents(
 			TRACE_LEVEL_ERROR,
 			TRACE_DEVICE,
-			"%!FUNC! WdfUsbTargetDeviceSendControlTransferSynchronously (Read) failed with %!STATUS!, cbTransferred = %llu, um_size = %d",
+			"%!FUNC! WdfUsbTargetDeviceSendControlTransferSynchronously (Read) failed with %!STATUS!, cbTransferred = %llu, Length = %d",
 			status,
 			cbTransferred,
-			DeviceContext->DeviceInfo->um_size
+			DeviceContext->DeviceInfo->ModeSwitch.Length
 		);
 		goto cleanup;
 	}
 
 	// Apply the mode switch
-	buffer[DeviceContext->DeviceInfo->um_switch_idx] = IsWellspringModeOn ?
-		(unsigned char)DeviceContext->DeviceInfo->um_switch_on :
-		(unsigned char)DeviceContext->DeviceInfo->um_switch_off;
+	buffer[DeviceContext->DeviceInfo->ModeSwitch.SwitchOffset] = IsWellspringModeOn ?
+		(unsigned char)DeviceContext->DeviceInfo->ModeSwitch.On :
+		(unsigned char)DeviceContext->DeviceInfo->ModeSwitch.Off;
 
 	// Write configuration
 	WDF_USB_CONTROL_SETUP_PACKET_INIT(
@@ -597,8 +680,8 @@ AmtPtpSetWellspringMode(
 		BmRequestHostToDevice,
 		BmRequestToInterface,
 		BCM5974_WELLSPRING_MODE_WRITE_REQUEST_ID,
-		(USHORT)DeviceContext->DeviceInfo->um_req_val,
-		(USHORT)DeviceContext->DeviceInfo->um_req_idx
+		DeviceContext->DeviceInfo->ModeSwitch.Value,
+		DeviceContext->DeviceInfo->ModeSwitch.Index
 	);
 
 	// Set stuffs right
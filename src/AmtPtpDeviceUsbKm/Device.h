@@ -29,11 +29,13 @@ typedef struct _DEVICE_CONTEXT
 	WDFUSBPIPE InterruptPipe;
 	WDFUSBINTERFACE UsbInterface;
 	WDFQUEUE InputQueue;
+	WDFSPINLOCK InputLock;
 	USB_DEVICE_DESCRIPTOR DeviceDescriptor;
 	ULONG UsbDeviceTraits;
 
 	// Device Config
-	const struct BCM5974_CONFIG* DeviceInfo;
+	const AMTPTP_DEVICE_MODEL* DeviceInfo;
+	AMTPTP_DECODER_CONFIG DecoderConfig;
 	BOOLEAN IsWellspringModeOn;
 
 	// PTP Status
@@ -41,8 +43,13 @@ typedef struct _DEVICE_CONTEXT
 	BOOLEAN PtpReportTouch;
 	BOOLEAN PtpReportButton;
 
-	// Timer
-	LARGE_INTEGER LastReportTime;
+	// Frames that arrived while no read was pending, guarded by InputLock
+	AMTPTP_REPORT_RING ReportRing;
+
+	// PTP contact IDs, scan time and malformed frames, guarded by InputLock
+	AMTPTP_CONTACT_TRACKER ContactTracker;
+	AMTPTP_SCAN_CLOCK ScanClock;
+	AMTPTP_ERROR_BUDGET ErrorBudget;
 
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
@@ -98,6 +105,18 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 EVT_WDF_USB_READER_COMPLETION_ROUTINE AmtPtpEvtUsbInterruptPipeReadComplete;
 EVT_WDF_USB_READERS_FAILED AmtPtpEvtUsbInterruptReadersFailed;
 
+NTSTATUS
+AmtPtpWriteReadReport(
+	_In_ WDFREQUEST Request,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+);
+
+NTSTATUS
+AmtPtpCompleteReadReportRequest(
+	_In_ WDFREQUEST Request,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+);
+
 //
 // Debug utilities
 //
@@ -21,6 +21,14 @@ Environment:
 #include <wdfusb.h>
 #include <initguid.h>
 
+#include <AmtPtpDecoder.h>
+#include <AmtPtpReportRing.h>
+#include <AmtPtpContactTracker.h>
+#include <AmtPtpScanClock.h>
+#include <AmtPtpErrorBudget.h>
+#include <AmtPtpDeviceRegistry.h>
+#include <AmtPtpHidReportLayout.h>
+
 #include "device.h"
 #include "queue.h"
 #include "trace.h"
@@ -4,12 +4,19 @@
 #ifndef _AAPL_HID_DESCRIPTOR_H_
 #define _AAPL_HID_DESCRIPTOR_H_
 
-HID_REPORT_DESCRIPTOR AmtPtpT2ReportDescriptor[] = {
-	AAPL_WELLSPRING_T2_PTP_TLC,
+static_assert(RTL_NUMBER_OF_FIELD(PTP_REPORT, Contacts) == AMTPTP_HID_PTP_CONTACTS, "Descriptor disagrees on PTP_REPORT contacts");
+
+static const HID_REPORT_DESCRIPTOR AmtPtpT2ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_T2),
+	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
+};
+
+static const HID_REPORT_DESCRIPTOR AmtPtpT2SmallReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_T2_SMALL),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
 };
 
-CONST HID_DESCRIPTOR AmtPtpT2DefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtpT2DefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -21,8 +28,67 @@ CONST HID_DESCRIPTOR AmtPtpT2DefaultHidDescriptor = {
 	},
 };
 
+static const HID_DESCRIPTOR AmtPtpT2SmallDefaultHidDescriptor = {
+	0x09,   // bLength
+	0x21,   // bDescriptorType
+	0x0100, // bcdHID
+	0x00,   // bCountryCode
+	0x01,   // bNumDescriptors
+	{
+		0x22,                                    // bDescriptorType
+		sizeof(AmtPtpT2SmallReportDescriptor)    // bDescriptorLength
+	},
+};
+
+// Reports as this driver fills them, checked against the descriptor before it is handed out
+static const AMTPTP_HID_REPORT_SIZE AmtPtpReportSizes[] = {
+	{ AmtPtpHidReportInput,		REPORTID_MULTITOUCH,	sizeof(PTP_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_DEVICE_CAPS,	sizeof(PTP_DEVICE_CAPS_FEATURE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PTPHQA,		sizeof(PTP_DEVICE_HQA_CERTIFICATION_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_REPORTMODE,	sizeof(PTP_DEVICE_INPUT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_FUNCSWITCH,	sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) },
+};
+
 #endif
 
+//
+// Picks the HID descriptor and report descriptor of the device's family,
+// T2 is the generic fallback.
+//
+static VOID
+AmtPtpSelectHidDescriptor(
+	_In_ PDEVICE_CONTEXT pContext,
+	_Out_ const HID_DESCRIPTOR** ppHidDescriptor,
+	_Out_ const HID_REPORT_DESCRIPTOR** ppReportDescriptor
+)
+{
+	switch (pContext->DeviceInfo->Descriptor) {
+		case AmtPtpReportDescriptorT2Small:
+		{
+			*ppHidDescriptor = &AmtPtpT2SmallDefaultHidDescriptor;
+			*ppReportDescriptor = AmtPtpT2SmallReportDescriptor;
+			break;
+		}
+		case AmtPtpReportDescriptorT2:
+		{
+			*ppHidDescriptor = &AmtPtpT2DefaultHidDescriptor;
+			*ppReportDescriptor = AmtPtpT2ReportDescriptor;
+			break;
+		}
+		default:
+		{
+			TraceEvents(
+				TRACE_LEVEL_WARNING, TRACE_DRIVER,
+				"%!FUNC! Device HID registry is not found, use a generic fallback"
+			);
+
+			*ppHidDescriptor = &AmtPtpT2DefaultHidDescriptor;
+			*ppReportDescriptor = AmtPtpT2ReportDescriptor;
+			break;
+		}
+	}
+}
+
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 AmtPtpGetHidDescriptor(
@@ -34,6 +100,8 @@ AmtPtpGetHidDescriptor(
 	PDEVICE_CONTEXT pContext = DeviceGetContext(Device);
 	size_t szCopy = 0;
 	WDFMEMORY requestMemory;
+	const HID_DESCRIPTOR* pHidDescriptor = NULL;
+	const HID_REPORT_DESCRIPTOR* pReportDescriptor = NULL;
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
@@ -54,60 +122,26 @@ AmtPtpGetHidDescriptor(
 		goto exit;
 	}
 
-	switch (pContext->DeviceDescriptor.idProduct) {
-		case USB_DEVICE_ID_APPLE_T2_7A:
-		case USB_DEVICE_ID_APPLE_T2_7B:
-		case USB_DEVICE_ID_APPLE_T2_7C:
-		case USB_DEVICE_ID_APPLE_T2_7D:
-		{
-			szCopy = AmtPtpT2DefaultHidDescriptor.bLength;
-			status = WdfMemoryCopyFromBuffer(
-				requestMemory,
-				0,
-				(PVOID) &AmtPtpT2DefaultHidDescriptor,
-				szCopy
-			);
-
-			if (!NT_SUCCESS(status)) {
-				TraceEvents(
-					TRACE_LEVEL_ERROR, TRACE_DRIVER,
-					"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
-					status
-				);
-				goto exit;
-			}
+	AmtPtpSelectHidDescriptor(pContext, &pHidDescriptor, &pReportDescriptor);
 
-			WdfRequestSetInformation(Request,szCopy);
-			break;
-		}
-		default:
-		{
-			TraceEvents(
-				TRACE_LEVEL_WARNING, TRACE_DRIVER,
-				"%!FUNC! Device HID registry is not found, use a generic fallback"
-			);
-
-			szCopy = AmtPtpT2DefaultHidDescriptor.bLength;
-			status = WdfMemoryCopyFromBuffer(
-				requestMemory,
-				0,
-				(PVOID)&AmtPtpT2DefaultHidDescriptor,
-				szCopy
-			);
+	szCopy = pHidDescriptor->bLength;
+	status = WdfMemoryCopyFromBuffer(
+		requestMemory,
+		0,
+		(PVOID) pHidDescriptor,
+		szCopy
+	);
 
-			if (!NT_SUCCESS(status)) {
-				TraceEvents(
-					TRACE_LEVEL_ERROR, TRACE_DRIVER,
-					"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
-					status
-				);
-				goto exit;
-			}
+	if (!NT_SUCCESS(status)) {
+		TraceEvents(
+			TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
+			status
+		);
+		goto exit;
+	}
 
-			WdfRequestSetInformation(Request, szCopy);
-			break;
-		}
-	};
+	WdfRequestSetInformation(Request, szCopy);
 
 exit:
 	TraceEvents(
@@ -177,6 +211,10 @@ AmtPtpGetReportDescriptor(
 	PDEVICE_CONTEXT pContext = DeviceGetContext(Device);
 	size_t szCopy = 0;
 	WDFMEMORY requestMemory;
+	const HID_DESCRIPTOR* pHidDescriptor = NULL;
+	const HID_REPORT_DESCRIPTOR* pReportDescriptor = NULL;
+	AMTPTP_HID_LAYOUT_RESULT layoutResult;
+	AMTPTP_HID_REPORT_SIZE layoutMismatch = { 0 };
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
@@ -197,84 +235,60 @@ AmtPtpGetReportDescriptor(
 		goto exit;
 	}
 
-	switch (pContext->DeviceDescriptor.idProduct) {
-		case USB_DEVICE_ID_APPLE_T2_7A:
-		case USB_DEVICE_ID_APPLE_T2_7B:
-		case USB_DEVICE_ID_APPLE_T2_7C:
-		case USB_DEVICE_ID_APPLE_T2_7D:
-		{
-
-			szCopy = AmtPtpT2DefaultHidDescriptor.DescriptorList[0].wReportLength;
-			if (szCopy == 0) {
-
-				status = STATUS_INVALID_DEVICE_STATE;
-				TraceEvents(
-					TRACE_LEVEL_ERROR, TRACE_DRIVER,
-					"%!FUNC! Device HID report length is zero"
-				);
-				goto exit;
-			}
-
-			status = WdfMemoryCopyFromBuffer(
-				requestMemory,
-				0,
-				(PVOID) &AmtPtpT2ReportDescriptor,
-				szCopy
-			);
+	AmtPtpSelectHidDescriptor(pContext, &pHidDescriptor, &pReportDescriptor);
 
-			if (!NT_SUCCESS(status)) {
+	szCopy = pHidDescriptor->DescriptorList[0].wReportLength;
+	if (szCopy == 0) {
 
-				TraceEvents(
-					TRACE_LEVEL_ERROR, TRACE_DRIVER,
-					"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
-					status
-				);
-				goto exit;
-			}
+		status = STATUS_INVALID_DEVICE_STATE;
+		TraceEvents(
+			TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! Device HID report length is zero"
+		);
+		goto exit;
+	}
 
-			WdfRequestSetInformation(Request, szCopy);
-			break;
-		}
-		default:
-		{
-			TraceEvents(
-				TRACE_LEVEL_WARNING, TRACE_DRIVER,
-				"%!FUNC! Device HID registry is not found, use a generic fallback"
-			);
-			
-			szCopy = AmtPtpT2DefaultHidDescriptor.DescriptorList[0].wReportLength;
-			if (szCopy == 0) {
+	// hidclass sizes reports from the descriptor, a mismatch would misread every report
+	layoutResult = AmtPtpHidVerifyReportSizes(
+		pReportDescriptor,
+		(ULONG) szCopy,
+		AmtPtpReportSizes,
+		RTL_NUMBER_OF(AmtPtpReportSizes),
+		&layoutMismatch
+	);
 
-				status = STATUS_INVALID_DEVICE_STATE;
-				TraceEvents(
-					TRACE_LEVEL_ERROR, TRACE_DRIVER,
-					"%!FUNC! Device HID report length is zero"
-				);
-				goto exit;
-			}
+	if (layoutResult != AmtPtpHidLayoutOk) {
 
-			status = WdfMemoryCopyFromBuffer(
-				requestMemory,
-				0,
-				(PVOID)&AmtPtpT2ReportDescriptor,
-				szCopy
-			);
+		status = STATUS_INVALID_DEVICE_STATE;
+		TraceEvents(
+			TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! HID report descriptor does not match the driver (%d), report %d declares %d bytes",
+			layoutResult,
+			layoutMismatch.ReportId,
+			layoutMismatch.Size
+		);
+		goto exit;
+	}
 
-			if (!NT_SUCCESS(status)) {
+	status = WdfMemoryCopyFromBuffer(
+		requestMemory,
+		0,
+		(PVOID) pReportDescriptor,
+		szCopy
+	);
 
-				TraceEvents(
-					TRACE_LEVEL_ERROR, TRACE_DRIVER,
-					"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
-					status
-				);
-				goto exit;
-			}
+	if (!NT_SUCCESS(status)) {
 
-			WdfRequestSetInformation(Request, szCopy);
-			break;
-		}
+		TraceEvents(
+			TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
+			status
+		);
+		goto exit;
 	}
 
+	WdfRequestSetInformation(Request, szCopy);
+
 exit:
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
@@ -344,7 +358,7 @@ AmtPtpReportFeatures(
 			}
 
 			PPTP_DEVICE_CAPS_FEATURE_REPORT capsReport = (PPTP_DEVICE_CAPS_FEATURE_REPORT) pHidPacket->reportBuffer;
-			capsReport->MaximumContactPoints = PTP_MAX_CONTACT_POINTS;
+			capsReport->MaximumContactPoints = PTP_MAX_HYBRID_CONTACT_POINTS;
 			capsReport->ButtonType = PTP_BUTTON_TYPE_CLICK_PAD;
 			capsReport->ReportID = REPORTID_DEVICE_CAPS;
 
@@ -3,14 +3,6 @@
 #include "Driver.h"
 #include "Interrupt.tmh"
 
-// Helper function for numberic operation
-static inline INT AmtRawToInteger(
-	_In_ USHORT x
-)
-{
-	return (signed short)x;
-}
-
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 AmtPtpConfigContReaderForInterruptEndPoint(
@@ -19,7 +11,7 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 {
 	WDF_USB_CONTINUOUS_READER_CONFIG contReaderConfig;
 	NTSTATUS status;
-	size_t transferLength = 0;
+	size_t transferLength = DeviceContext->DeviceInfo->TransferLength;
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -27,25 +19,6 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 		"%!FUNC! Entry"
 	);
 
-	switch (DeviceContext->DeviceInfo->tp_type)
-	{
-	case TYPE1:
-		transferLength = HEADER_TYPE1 + FSIZE_TYPE1 * MAX_FINGERS;
-		break;
-	case TYPE2:
-		transferLength = HEADER_TYPE2 + FSIZE_TYPE2 * MAX_FINGERS;
-		break;
-	case TYPE3:
-		transferLength = HEADER_TYPE3 + FSIZE_TYPE3 * MAX_FINGERS;
-		break;
-	case TYPE4:
-		transferLength = HEADER_TYPE4 + FSIZE_TYPE4 * MAX_FINGERS;
-		break;
-	case TYPE5:
-		transferLength = HEADER_TYPE5 + FSIZE_TYPE5 * MAX_FINGERS;
-		break;
-	}
-
 	if (transferLength <= 0) {
 		status = STATUS_UNKNOWN_REVISION;
 		goto exit;
@@ -86,6 +59,40 @@ exit:
 	return STATUS_SUCCESS;
 }
 
+//
+// Hands parked reports to reads hidclass left pending, oldest first. A frame
+// that finds reports parked is parked behind them, so the rest of a hybrid
+// scan reaches hidclass before anything that came in after it.
+//
+static VOID
+AmtPtpServeParkedReports(
+	_In_ PDEVICE_CONTEXT DeviceContext
+)
+{
+	NTSTATUS Status;
+	WDFREQUEST Request;
+	AMTPTP_DECODED_FRAME Frame;
+
+	for (;;) {
+		WdfSpinLockAcquire(DeviceContext->InputLock);
+		if (AmtPtpReportRingCount(&DeviceContext->ReportRing) == 0 ||
+			!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(DeviceContext->InputQueue, &Request))) {
+			WdfSpinLockRelease(DeviceContext->InputLock);
+			return;
+		}
+
+		// The frame stays parked until it made it into the request
+		AmtPtpReportRingPeek(&DeviceContext->ReportRing, &Frame);
+		Status = AmtPtpWriteReadReport(Request, &Frame);
+		if (NT_SUCCESS(Status)) {
+			AmtPtpReportRingAdvance(&DeviceContext->ReportRing, PTP_MAX_CONTACT_POINTS);
+		}
+
+		WdfSpinLockRelease(DeviceContext->InputLock);
+		WdfRequestComplete(Request, Status);
+	}
+}
+
 VOID
 AmtPtpEvtUsbInterruptPipeReadComplete(
 	_In_ WDFUSBPIPE  Pipe,
@@ -97,30 +104,16 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 	UNREFERENCED_PARAMETER(Pipe);
 
 	PDEVICE_CONTEXT pDeviceContext = Context;
-	size_t headerSize = (unsigned int)pDeviceContext->DeviceInfo->tp_header;
-	size_t fingerprintSize = (unsigned int)pDeviceContext->DeviceInfo->tp_fsize;
-	size_t raw_n, i;
-	USHORT x = 0, y = 0;
 	UCHAR* TouchBuffer = NULL;
-	const struct TRACKPAD_FINGER* f = NULL;
 
-	LONGLONG PerfCounterDelta;
-	LARGE_INTEGER CurrentPerfCounter;
 	NTSTATUS Status;
-	PTP_REPORT PtpReport;
+	AMTPTP_DECODED_FRAME Frame;
+	AMTPTP_FRAME_CHECK FrameCheck;
+	AMTPTP_FRAME_VERDICT Verdict;
+	AMTPTP_RING_PUSH_RESULT PushResult;
+	ULONGLONG HostTime;
 
 	WDFREQUEST Request;
-	WDFMEMORY  RequestMemory;
-
-	if (NumBytesTransferred < headerSize || (NumBytesTransferred - headerSize) % fingerprintSize != 0) {
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_DRIVER,
-			"%!FUNC! Malformed input received. Length = %llu",
-			NumBytesTransferred
-		);
-		return;
-	}
 
 	// Retrieve packet
 	TouchBuffer = WdfMemoryGetBuffer(
@@ -136,96 +129,111 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 		return;
 	}
 
-	// Retrieve next PTP touchpad request.
-	Status = WdfIoQueueRetrieveNextRequest(
-		pDeviceContext->InputQueue,
-		&Request
-	);
-
-	if (!NT_SUCCESS(Status)) {
+	// Salvage what is complete, skip the rest. There is no mode to restore on
+	// T2, so a spent budget only shows up in the trace.
+	HostTime = KeQueryInterruptTime();
+	FrameCheck = AmtPtpDecodeFrameSalvage(&pDeviceContext->DecoderConfig, TouchBuffer, NumBytesTransferred, &Frame);
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	Verdict = AmtPtpErrorBudgetRecord(&pDeviceContext->ErrorBudget, FrameCheck, HostTime);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+	if (Verdict != AmtPtpFrameDeliver) {
 		TraceEvents(
-			TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
-			"%!FUNC! No pending PTP request. Disposed"
+			TRACE_LEVEL_INFORMATION,
+			TRACE_DRIVER,
+			"%!FUNC! Malformed input received. Length = %llu, over budget = %d",
+			NumBytesTransferred,
+			Verdict == AmtPtpFrameReset
 		);
 		return;
 	}
 
-	Status = WdfRequestRetrieveOutputMemory(
-		Request,
-		&RequestMemory
-	);
+	if (!pDeviceContext->PtpReportTouch) {
+		Frame.ContactCount = 0;
+	}
 
-	if (!NT_SUCCESS(Status)) {
-		TraceEvents(
-			TRACE_LEVEL_ERROR, TRACE_DRIVER,
-			"%!FUNC! WdfRequestRetrieveOutputMemory failed with %!STATUS!",
-			Status
+	if (!pDeviceContext->PtpReportButton) {
+		Frame.IsButtonClicked = FALSE;
+	} else if (Frame.IsButtonClicked) {
+		TraceHot(
+			TRACE_LEVEL_INFORMATION, TRACE_INPUT,
+			"%!FUNC!: Trackpad button clicked"
 		);
-		return;
 	}
 
-	// Prepare report
-	Status = STATUS_SUCCESS;
-
-	RtlZeroMemory(&PtpReport, sizeof(PTP_REPORT));
-	PtpReport.ReportID = REPORTID_MULTITOUCH;
-	PtpReport.IsButtonClicked = 0;
-	raw_n = (NumBytesTransferred - headerSize) / fingerprintSize;
-	UCHAR* f_base = TouchBuffer + headerSize + pDeviceContext->DeviceInfo->tp_delta;
-
-	// Scan time is in 100us
-	KeQueryPerformanceCounter(&CurrentPerfCounter);
-	PerfCounterDelta = (CurrentPerfCounter.QuadPart - pDeviceContext->LastReportTime.QuadPart) / 100;
-	if (PerfCounterDelta > 0xFF) {
-		PerfCounterDelta = 0xFF;
+	// Retrieve next PTP touchpad request, or park the frame until one arrives.
+	// While reports are parked the frame queues up behind them.
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	AmtPtpScanClockUpdate(&pDeviceContext->ScanClock, &Frame, HostTime);
+	AmtPtpContactTrackerUpdate(&pDeviceContext->ContactTracker, &Frame, PTP_MAX_HYBRID_CONTACT_POINTS);
+	Status = STATUS_NO_MORE_ENTRIES;
+	if (AmtPtpReportRingCount(&pDeviceContext->ReportRing) == 0) {
+		Status = WdfIoQueueRetrieveNextRequest(
+			pDeviceContext->InputQueue,
+			&Request
+		);
 	}
 
-	PtpReport.ScanTime = (USHORT) PerfCounterDelta;
-
-	if (pDeviceContext->PtpReportTouch) {
-		if (raw_n >= PTP_MAX_CONTACT_POINTS) raw_n = PTP_MAX_CONTACT_POINTS;
-		if (raw_n * fingerprintSize < (NumBytesTransferred - headerSize)) {
-			TraceEvents(
-				TRACE_LEVEL_ERROR, TRACE_DRIVER,
-				"%!FUNC! Buffer may have a problem"
+	if (!NT_SUCCESS(Status)) {
+		PushResult = AmtPtpReportRingPush(&pDeviceContext->ReportRing, &Frame);
+		WdfSpinLockRelease(pDeviceContext->InputLock);
+
+		if (PushResult == AmtPtpRingPushDroppedOldest) {
+			TraceHot(
+				TRACE_LEVEL_WARNING, TRACE_DRIVER,
+				"%!FUNC! Report ring full, oldest frame dropped (%d total)",
+				pDeviceContext->ReportRing.Dropped
+			);
+		} else {
+			TraceHot(
+				TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+				"%!FUNC! No pending PTP request. Frame parked (%d)",
+				PushResult
 			);
-			WdfRequestComplete(Request, STATUS_DATA_ERROR);
-			return;
 		}
 
-		PtpReport.ContactCount = (UCHAR) raw_n;
-
-		for (i = 0; i < raw_n; i++) {
-			f = (const struct TRACKPAD_FINGER*) (f_base + i * fingerprintSize);
-			
-			// Translate X and Y
-			x = (AmtRawToInteger(f->abs_x) - pDeviceContext->DeviceInfo->x.min) > 0 ? 
-				((USHORT)(AmtRawToInteger(f->abs_x) - pDeviceContext->DeviceInfo->x.min)) : 0;
-			y = (pDeviceContext->DeviceInfo->y.max - AmtRawToInteger(f->abs_y)) > 0 ? 
-				((USHORT)(pDeviceContext->DeviceInfo->y.max - AmtRawToInteger(f->abs_y))) : 0;
-
-			// Defuzz functions remain the same
-			// TODO: Implement defuzz later
-			PtpReport.Contacts[i].ContactID = (UCHAR) i;
-			PtpReport.Contacts[i].X = x;
-			PtpReport.Contacts[i].Y = y;
-			PtpReport.Contacts[i].TipSwitch = (AmtRawToInteger(f->touch_major) << 1) >= 200 || (AmtRawToInteger(f->touch_minor) << 1) >= 150;
-			PtpReport.Contacts[i].Confidence = (AmtRawToInteger(f->touch_minor) << 1) > 0;
-		}
+		AmtPtpServeParkedReports(pDeviceContext);
+		return;
 	}
 
-	if (pDeviceContext->PtpReportButton) {
-		// Handles trackpad button input here.
-		if (TouchBuffer[pDeviceContext->DeviceInfo->tp_button]) {
-			PtpReport.IsButtonClicked = TRUE;
-			TraceEvents(
-				TRACE_LEVEL_INFORMATION, TRACE_INPUT,
-				"%!FUNC!: Trackpad button clicked"
-			);
-		}
+	// The rest of a hybrid scan goes out with the next reads
+	if (Frame.ContactCount > PTP_MAX_CONTACT_POINTS) {
+		AmtPtpReportRingPushRemainder(&pDeviceContext->ReportRing, &Frame, PTP_MAX_CONTACT_POINTS);
+	}
+
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+	AmtPtpCompleteReadReportRequest(Request, &Frame);
+	AmtPtpServeParkedReports(pDeviceContext);
+}
+
+//
+// Writes the next report of Frame into a read request, without completing it.
+//
+NTSTATUS
+AmtPtpWriteReadReport(
+	_In_ WDFREQUEST Request,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+)
+{
+	NTSTATUS Status;
+	PTP_REPORT PtpReport;
+	WDFMEMORY  RequestMemory;
+
+	Status = WdfRequestRetrieveOutputMemory(
+		Request,
+		&RequestMemory
+	);
+
+	if (!NT_SUCCESS(Status)) {
+		TraceEvents(
+			TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! WdfRequestRetrieveOutputMemory failed with %!STATUS!",
+			Status
+		);
+		return Status;
 	}
 
 	// Compose final report and write it back
+	AMTPTP_COMPOSE_REPORT(Frame, &PtpReport);
 	Status = WdfMemoryCopyFromBuffer(
 		RequestMemory,
 		0,
@@ -239,14 +247,27 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
 			Status
 		);
-		return;
+		return Status;
 	}
 
 	// Set result
 	WdfRequestSetInformation(Request, sizeof(PTP_REPORT));
+	return Status;
+}
+
+NTSTATUS
+AmtPtpCompleteReadReportRequest(
+	_In_ WDFREQUEST Request,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+)
+{
+	NTSTATUS Status;
+
+	Status = AmtPtpWriteReadReport(Request, Frame);
 
 	// Set completion flag
 	WdfRequestComplete(Request, Status);
+	return Status;
 }
 
 BOOLEAN
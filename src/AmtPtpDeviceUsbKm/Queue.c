@@ -191,14 +191,30 @@ AmtPtpDispatchReadReportRequests(
 
 	NTSTATUS status;
 	PDEVICE_CONTEXT pDevContext;
+	AMTPTP_DECODED_FRAME frame;
 
 	status = STATUS_SUCCESS;
 	pDevContext = DeviceGetContext(Device);
 
+	// Serve a parked frame first, so nothing goes out of order
+	WdfSpinLockAcquire(pDevContext->InputLock);
+	if (AmtPtpReportRingPeek(&pDevContext->ReportRing, &frame)) {
+		// The frame stays parked until it made it into the request, the
+		// caller completes the request with status
+		status = AmtPtpWriteReadReport(Request, &frame);
+		if (NT_SUCCESS(status)) {
+			AmtPtpReportRingAdvance(&pDevContext->ReportRing, PTP_MAX_CONTACT_POINTS);
+		}
+
+		WdfSpinLockRelease(pDevContext->InputLock);
+		goto exit;
+	}
+
 	status = WdfRequestForwardToIoQueue(
 		Request,
 		pDevContext->InputQueue
 	);
+	WdfSpinLockRelease(pDevContext->InputLock);
 
 	if (!NT_SUCCESS(status)) {
 		TraceEvents(
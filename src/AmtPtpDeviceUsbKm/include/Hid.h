@@ -5,9 +5,7 @@
 
 #include <AppleDefinition.h>
 #include <hid/HidCommon.h>
-
-// Device family metadata
-#include <metadata/WellspringT2.h>
+#include <AmtPtpHidDescriptor.h>
 
 typedef UCHAR HID_REPORT_DESCRIPTOR, *PHID_REPORT_DESCRIPTOR;
 
@@ -88,6 +86,8 @@ typedef UCHAR HID_REPORT_DESCRIPTOR, *PHID_REPORT_DESCRIPTOR;
 	0x24, 0x8b, 0xc4, 0x43, 0xa5, 0xe5, 0x24, 0xc2
 
 #define PTP_MAX_CONTACT_POINTS 5
+// Scans with more contacts go out as several reports (hybrid mode)
+#define PTP_MAX_HYBRID_CONTACT_POINTS 16
 #define PTP_BUTTON_TYPE_CLICK_PAD 0
 #define PTP_BUTTON_TYPE_PRESSURE_PAD 1
 
@@ -117,7 +117,6 @@ typedef struct _PTP_DEVICE_INPUT_MODE_REPORT {
 #pragma pack(1)
 typedef struct _PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT {
 	UCHAR ReportID;
-	UCHAR DeviceMode;
 	UCHAR ButtonReport : 1;
 	UCHAR SurfaceReport : 1;
 	UCHAR Padding : 6;
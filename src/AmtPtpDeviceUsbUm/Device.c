@@ -4,21 +4,95 @@
 #include "device.tmh"
 
 _IRQL_requires_(PASSIVE_LEVEL)
-static const struct BCM5974_CONFIG*
-AmtPtpGetDeviceConfig(
-	_In_ USB_DEVICE_DESCRIPTOR deviceInfo
+static VOID
+AmtPtpInitDecoderConfig(
+	_In_ PDEVICE_CONTEXT DeviceContext
+)
+{
+	const AMTPTP_DEVICE_MODEL *model = DeviceContext->DeviceInfo;
+	PAMTPTP_DECODER_CONFIG decoderConfig = &DeviceContext->DecoderConfig;
+
+	// Wellspring devices report the finger block offset in byte 2
+	AmtPtpDeviceRegistryInitDecoderConfig(
+		model,
+		(model->Format == AmtPtpFrameFormatWellspring) ? AMTPTP_DECODER_FLAG_FINGER_OFFSET_IN_FRAME : 0,
+		decoderConfig
+	);
+
+	AmtPtpContactTrackerInitialize(
+		&DeviceContext->ContactTracker,
+		decoderConfig
+	);
+
+	AmtPtpContactTrackerSetFuzz(
+		&DeviceContext->ContactTracker,
+		AMTPTP_FUZZ_FROM_SNRATIO(model->X.Min, model->X.Max, model->X.SnRatio),
+		AMTPTP_FUZZ_FROM_SNRATIO(model->Y.Min, model->Y.Max, model->Y.SnRatio)
+	);
+
+	AmtPtpScanClockInitialize(
+		&DeviceContext->ScanClock,
+		(model->Format == AmtPtpFrameFormatMt2) ? AMTPTP_MT2_TIMESTAMP_MASK : AMTPTP_WELLSPRING_TIMESTAMP_MASK
+	);
+
+	AmtPtpErrorBudgetInitialize(
+		&DeviceContext->ErrorBudget,
+		AMTPTP_ERROR_BUDGET_DEFAULT_WINDOW,
+		AMTPTP_ERROR_BUDGET_DEFAULT_LIMIT
+	);
+}
+
+//
+// The control transfer request and the memory over the mode block are kept
+// for the life of the device, PrepareHardware only creates them once.
+//
+_IRQL_requires_(PASSIVE_LEVEL)
+static NTSTATUS
+AmtPtpInitModeEngine(
+	_In_ WDFDEVICE Device,
+	_In_ PDEVICE_CONTEXT DeviceContext
 )
 {
-	USHORT id = deviceInfo.idProduct;
-	const struct BCM5974_CONFIG *cfg;
+	WDF_OBJECT_ATTRIBUTES	attributes;
+	NTSTATUS				status = STATUS_SUCCESS;
+
+	if (!AmtPtpModeEngineInitialize(&DeviceContext->ModeEngine, &DeviceContext->DeviceInfo->ModeSwitch)) {
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	// Type 3 does not need a mode switch
+	if (DeviceContext->DeviceInfo->ModeSwitch.Length == 0) {
+		return STATUS_SUCCESS;
+	}
 
-	for (cfg = Bcm5974ConfigTable; cfg->ansi; ++cfg) {
-		if (cfg->ansi == id || cfg->iso == id || cfg->jis == id) {
-			return cfg;
+	if (DeviceContext->ModeRequest == NULL) {
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Device;
+
+		status = WdfRequestCreate(
+			&attributes,
+			WdfUsbTargetDeviceGetIoTarget(DeviceContext->UsbDevice),
+			&DeviceContext->ModeRequest
+		);
+
+		if (!NT_SUCCESS(status)) {
+			return status;
 		}
 	}
 
-	return NULL;
+	if (DeviceContext->ModeMemory == NULL) {
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = Device;
+
+		status = WdfMemoryCreatePreallocated(
+			&attributes,
+			DeviceContext->ModeEngine.Block,
+			DeviceContext->DeviceInfo->ModeSwitch.Length,
+			&DeviceContext->ModeMemory
+		);
+	}
+
+	return status;
 }
 
 _IRQL_requires_(PASSIVE_LEVEL)
@@ -31,6 +105,8 @@ AmtPtpCreateDevice(
 	WDF_PNPPOWER_EVENT_CALLBACKS		pnpPowerCallbacks;
 	WDF_DEVICE_PNP_CAPABILITIES         pnpCaps;
 	WDF_OBJECT_ATTRIBUTES				deviceAttributes;
+	WDF_TIMER_CONFIG					timerConfig;
+	WDF_OBJECT_ATTRIBUTES				timerAttributes;
 	PDEVICE_CONTEXT						deviceContext;
 	WDFDEVICE							device;
 	NTSTATUS							status;
@@ -55,6 +131,7 @@ AmtPtpCreateDevice(
 
 	// Create WDF device object
 	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&deviceAttributes, DEVICE_CONTEXT);
+	deviceAttributes.EvtCleanupCallback = AmtPtpEvtDeviceCleanup;
 
 	status = WdfDeviceCreate(
 		&DeviceInit, 
@@ -91,6 +168,85 @@ AmtPtpCreateDevice(
 		&pnpCaps
 	);
 
+	//
+	// Input frames are parked in the report ring when hidclass is slow to
+	// send the next read. The lock makes the ring and InputQueue one unit.
+	//
+	status = WdfSpinLockCreate(
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&deviceContext->InputLock
+	);
+
+	if (!NT_SUCCESS(status)) {
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! WdfSpinLockCreate failed with Status code %!STATUS!", status);
+		return status;
+	}
+
+	AmtPtpReportRingInitialize(
+		&deviceContext->ReportRing,
+		AMTPTP_REPORT_RING_DEFAULT_DEPTH,
+		AmtPtpRingOverflowCoalesce
+	);
+
+	QueryPerformanceFrequency(&deviceContext->PerformanceFrequency);
+	AmtPtpPerfCountersInitialize(&deviceContext->PerfCounters);
+	AmtPtpTraceRingInitialize(&deviceContext->TraceRing);
+
+	//
+	// Mode transitions are requested from the interrupt pipe completion, the
+	// HID queue and the power callbacks.
+	//
+	status = WdfSpinLockCreate(
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&deviceContext->ModeLock
+	);
+
+	if (!NT_SUCCESS(status)) {
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! WdfSpinLockCreate failed with Status code %!STATUS!", status);
+		return status;
+	}
+
+	deviceContext->ModeIdleEvent = CreateEvent(
+		NULL,
+		FALSE,
+		FALSE,
+		NULL
+	);
+
+	if (deviceContext->ModeIdleEvent == NULL) {
+		status = HRESULT_FROM_WIN32(GetLastError());
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! CreateEvent failed with Status code %!STATUS!", status);
+		return status;
+	}
+
+	//
+	// A mode switch that fails after D0 entry is retried on a short backoff
+	//
+	AmtPtpResumeInitialize(&deviceContext->Resume);
+
+	WDF_TIMER_CONFIG_INIT(
+		&timerConfig,
+		AmtPtpResumeTimerCallback
+	);
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+	timerAttributes.ParentObject = device;
+
+	status = WdfTimerCreate(
+		&timerConfig,
+		&timerAttributes,
+		&deviceContext->ResumeTimer
+	);
+
+	if (!NT_SUCCESS(status)) {
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER,
+			"%!FUNC! WdfTimerCreate failed with Status code %!STATUS!", status);
+		return status;
+	}
+
 	//
 	// Create a device interface so that applications can find and talk
 	// to us.
@@ -169,8 +325,12 @@ AmtPtpEvtDevicePrepareHardware(
 	);
 
 	if (NT_SUCCESS(status)) {
-		// Get correct configuration from conf store
-		pDeviceContext->DeviceInfo = AmtPtpGetDeviceConfig(pDeviceContext->DeviceDescriptor);
+		// Get correct configuration from device registry
+		pDeviceContext->DeviceInfo = AmtPtpDeviceRegistryLookup(
+			AmtPtpBusUsb,
+			pDeviceContext->DeviceDescriptor.idVendor,
+			pDeviceContext->DeviceDescriptor.idProduct
+		);
 		if (pDeviceContext->DeviceInfo == NULL) {
 			status = STATUS_INVALID_DEVICE_STATE;
 			TraceEvents(
@@ -188,6 +348,14 @@ AmtPtpEvtDevicePrepareHardware(
 			);
 			return status;
 		}
+
+		AmtPtpInitDecoderConfig(pDeviceContext);
+
+		status = AmtPtpInitModeEngine(Device, pDeviceContext);
+		if (!NT_SUCCESS(status)) {
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! AmtPtpInitModeEngine failed with %!STATUS!", status);
+			return status;
+		}
 	}
 
 	//
@@ -252,71 +420,54 @@ AmtPtpEvtDevicePrepareHardware(
 	return status;
 }
 
-_IRQL_requires_(PASSIVE_LEVEL)
-NTSTATUS
-AmtPtpGetWellspringMode(
+//
+// Reads and writes of the mode block go to the same wValue and wIndex, only
+// the direction and the request differ.
+//
+static VOID
+AmtPtpInitModeSetupPacket(
 	_In_  PDEVICE_CONTEXT DeviceContext,
-	_Out_ BOOL* IsWellspringModeOn
+	_In_  AMTPTP_MODE_STEP Step,
+	_Out_ PWDF_USB_CONTROL_SETUP_PACKET SetupPacket
 )
 {
+	WDF_USB_CONTROL_SETUP_PACKET_INIT(
+		SetupPacket,
+		(Step == AmtPtpModeStepRead) ? BmRequestDeviceToHost : BmRequestHostToDevice,
+		BmRequestToInterface,
+		(Step == AmtPtpModeStepRead) ? BCM5974_WELLSPRING_MODE_READ_REQUEST_ID : BCM5974_WELLSPRING_MODE_WRITE_REQUEST_ID,
+		DeviceContext->DeviceInfo->ModeSwitch.Value,
+		DeviceContext->DeviceInfo->ModeSwitch.Index
+	);
 
+	// Set stuffs right
+	SetupPacket->Packet.bm.Request.Type = BmRequestClass;
+}
+
+_IRQL_requires_(PASSIVE_LEVEL)
+static NTSTATUS
+AmtPtpSendModeTransferSynchronously(
+	_In_ PDEVICE_CONTEXT DeviceContext,
+	_In_ AMTPTP_MODE_STEP Step
+)
+{
 	NTSTATUS						status;
 	WDF_USB_CONTROL_SETUP_PACKET	setupPacket;
 	WDF_MEMORY_DESCRIPTOR			memoryDescriptor;
-	ULONG							cbTransferred;
-	WDFMEMORY						bufHandle = NULL;
-	unsigned char*					buffer;
-
-	status = STATUS_SUCCESS;
-
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_DRIVER,
-		"%!FUNC! Entry"
-	);
+	ULONG							cbTransferred = 0;
 
-	// Type 3 does not need a mode switch.
-	if (DeviceContext->DeviceInfo->tp_type == TYPE3) {
-		*IsWellspringModeOn = TRUE;
-		return STATUS_SUCCESS;
-	}
-
-	status = WdfMemoryCreate(
-		WDF_NO_OBJECT_ATTRIBUTES,
-		PagedPool,
-		POOL_TAG_PTP_CONTROL,
-		DeviceContext->DeviceInfo->um_size,
-		&bufHandle,
-		&buffer
-	);
-
-	if (!NT_SUCCESS(status)) {
-		goto cleanup;
-	}
-
-	RtlZeroMemory(
-		buffer,
-		DeviceContext->DeviceInfo->um_size
+	AmtPtpInitModeSetupPacket(
+		DeviceContext,
+		Step,
+		&setupPacket
 	);
 
-	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+	WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(
 		&memoryDescriptor,
-		buffer,
-		sizeof(DeviceContext->DeviceInfo->um_size)
+		DeviceContext->ModeMemory,
+		NULL
 	);
 
-	WDF_USB_CONTROL_SETUP_PACKET_INIT(
-		&setupPacket,
-		BmRequestDeviceToHost,
-		BmRequestToInterface,
-		BCM5974_WELLSPRING_MODE_READ_REQUEST_ID,
-		(USHORT)DeviceContext->DeviceInfo->um_req_val,
-		(USHORT)DeviceContext->DeviceInfo->um_req_idx
-	);
-
-	// Set stuffs right
-	setupPacket.Packet.bm.Request.Type = BmRequestClass;
-
 	status = WdfUsbTargetDeviceSendControlTransferSynchronously(
 		DeviceContext->UsbDevice,
 		WDF_NO_HANDLE,
@@ -327,174 +478,327 @@ AmtPtpGetWellspringMode(
 	);
 
 	// Behavior mismatch: Actual device does not transfer bytes as expected (in length)
-	// So we do not check um_size as a temporary workaround.
+	// So we do not check the message length as a temporary workaround.
 	if (!NT_SUCCESS(status)) {
 		TraceEvents(
 			TRACE_LEVEL_ERROR,
 			TRACE_DEVICE,
-			"%!FUNC! WdfUsbTargetDeviceSendControlTransferSynchronously (Read) failed with %!STATUS!, cbTransferred = %llu, um_size = %d",
+			"%!FUNC! WdfUsbTargetDeviceSendControlTransferSynchronously (%s) failed with %!STATUS!, cbTransferred = %llu, Length = %d",
+			(Step == AmtPtpModeStepRead) ? "Read" : "Write",
 			status,
 			cbTransferred,
-			DeviceContext->DeviceInfo->um_size
+			DeviceContext->DeviceInfo->ModeSwitch.Length
 		);
-		goto cleanup;
 	}
 
-	// Check mode switch
-	unsigned char wellspringBit = buffer[DeviceContext->DeviceInfo->um_switch_idx];
-	*IsWellspringModeOn = wellspringBit == DeviceContext->DeviceInfo->um_switch_on ? TRUE : FALSE;
+	return status;
+}
 
-cleanup:
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_DRIVER,
-		"%!FUNC! Exit"
-	);
+//
+// Runs once the engine has nothing more to send. Records that the device is
+// configured, or schedules another attempt if it did not take Wellspring mode.
+//
+static VOID
+AmtPtpModeSettled(
+	_In_ PDEVICE_CONTEXT DeviceContext
+)
+{
+	BOOLEAN		configured;
+	BOOLEAN		retry;
+	ULONG		delay = 0;
+	ULONGLONG	hostTime = 0;
+
+	WdfSpinLockAcquire(DeviceContext->ModeLock);
+	configured = (DeviceContext->ModeEngine.Known == AmtPtpModeWellspring);
+	retry = !configured && DeviceContext->ModeEngine.InFlight == AmtPtpModeStepNone &&
+		DeviceContext->ModeEngine.Target == AmtPtpModeWellspring;
+	WdfSpinLockRelease(DeviceContext->ModeLock);
+
+	if (!configured && !retry) {
+		return;
+	}
 
-	WdfObjectDelete(bufHandle);
-	return status;
+	QueryUnbiasedInterruptTime(&hostTime);
+	WdfSpinLockAcquire(DeviceContext->InputLock);
+	if (configured) {
+		AmtPtpResumeMark(&DeviceContext->Resume, AmtPtpResumeConfigured, hostTime);
+	} else {
+		delay = AmtPtpResumeNextRetry(&DeviceContext->Resume);
+	}
+	WdfSpinLockRelease(DeviceContext->InputLock);
 
+	if (retry) {
+		TraceEvents(
+			TRACE_LEVEL_WARNING,
+			TRACE_DEVICE,
+			"%!FUNC! Wellspring mode not set, retry in %d ms",
+			delay
+		);
+
+		WdfTimerStart(
+			DeviceContext->ResumeTimer,
+			WDF_REL_TIMEOUT_IN_MS(delay)
+		);
+	}
 }
 
-_IRQL_requires_(PASSIVE_LEVEL)
-NTSTATUS
-AmtPtpSetWellspringMode(
+//
+// Sends Step on ModeRequest and returns, the completion routine reports it to
+// the engine and sends whatever comes next. A transfer that cannot be sent is
+// reported as failed right away. Once nothing is left to send, the outcome goes
+// to AmtPtpModeSettled. If AmtPtpSetWellspringMode took the engine over
+// meanwhile, it is woken up instead.
+//
+static VOID
+AmtPtpSendModeTransfer(
 	_In_ PDEVICE_CONTEXT DeviceContext,
-	_In_ BOOL IsWellspringModeOn
+	_In_ AMTPTP_MODE_STEP Step
 )
 {
-
 	NTSTATUS						status;
 	WDF_USB_CONTROL_SETUP_PACKET	setupPacket;
-	WDF_MEMORY_DESCRIPTOR			memoryDescriptor;
-	ULONG							cbTransferred;
-	WDFMEMORY						bufHandle = NULL;
-	unsigned char*					buffer;
+	WDF_REQUEST_REUSE_PARAMS		reuseParams;
+	BOOLEAN							handOver;
 
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION, 
-		TRACE_DRIVER, 
-		"%!FUNC! Entry"
-	);
+	while (Step != AmtPtpModeStepNone) {
 
-	// Type 3 does not need a mode switch.
-	// However, turn mode on or off as requested.
-	if (DeviceContext->DeviceInfo->tp_type == TYPE3) {
-		DeviceContext->IsWellspringModeOn = IsWellspringModeOn;
-		return STATUS_SUCCESS;
-	}
+		AmtPtpInitModeSetupPacket(
+			DeviceContext,
+			Step,
+			&setupPacket
+		);
 
-	status = WdfMemoryCreate(
-		WDF_NO_OBJECT_ATTRIBUTES, 
-		PagedPool, 
-		POOL_TAG_PTP_CONTROL, 
-		DeviceContext->DeviceInfo->um_size, 
-		&bufHandle, 
-		&buffer
-	);
+		status = WdfUsbTargetDeviceFormatRequestForControlTransfer(
+			DeviceContext->UsbDevice,
+			DeviceContext->ModeRequest,
+			&setupPacket,
+			DeviceContext->ModeMemory,
+			NULL
+		);
 
-	if (!NT_SUCCESS(status)) {
-		goto cleanup;
-	}
+		if (NT_SUCCESS(status)) {
+			WdfRequestSetCompletionRoutine(
+				DeviceContext->ModeRequest,
+				AmtPtpModeTransferComplete,
+				DeviceContext
+			);
 
-	RtlZeroMemory(
-		buffer, 
-		DeviceContext->DeviceInfo->um_size
-	);
+			if (WdfRequestSend(
+				DeviceContext->ModeRequest,
+				WdfUsbTargetDeviceGetIoTarget(DeviceContext->UsbDevice),
+				WDF_NO_SEND_OPTIONS)) {
+				return;
+			}
 
-	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
-		&memoryDescriptor, 
-		buffer, 
-		sizeof(DeviceContext->DeviceInfo->um_size)
-	);
+			status = WdfRequestGetStatus(DeviceContext->ModeRequest);
+		}
 
-	WDF_USB_CONTROL_SETUP_PACKET_INIT(
-		&setupPacket, 
-		BmRequestDeviceToHost, 
-		BmRequestToInterface,
-		BCM5974_WELLSPRING_MODE_READ_REQUEST_ID,
-		(USHORT) DeviceContext->DeviceInfo->um_req_val, 
-		(USHORT) DeviceContext->DeviceInfo->um_req_idx
-	);
+		TraceEvents(
+			TRACE_LEVEL_ERROR,
+			TRACE_DEVICE,
+			"%!FUNC! Sending mode transfer (%s) failed with %!STATUS!",
+			(Step == AmtPtpModeStepRead) ? "Read" : "Write",
+			status
+		);
 
-	// Set stuffs right
-	setupPacket.Packet.bm.Request.Type = BmRequestClass;
+		WDF_REQUEST_REUSE_PARAMS_INIT(
+			&reuseParams,
+			WDF_REQUEST_REUSE_NO_FLAGS,
+			STATUS_SUCCESS
+		);
+		WdfRequestReuse(DeviceContext->ModeRequest, &reuseParams);
 
-	status = WdfUsbTargetDeviceSendControlTransferSynchronously(
-		DeviceContext->UsbDevice, 
-		WDF_NO_HANDLE, 
-		NULL, 
-		&setupPacket, 
-		&memoryDescriptor, 
-		&cbTransferred
-	);
+		WdfSpinLockAcquire(DeviceContext->ModeLock);
+		Step = AmtPtpModeEngineComplete(&DeviceContext->ModeEngine, FALSE);
+		DeviceContext->IsWellspringModeOn = (DeviceContext->ModeEngine.Known == AmtPtpModeWellspring);
+		handOver = DeviceContext->ModeSynchronous;
+		WdfSpinLockRelease(DeviceContext->ModeLock);
+
+		if (handOver) {
+			SetEvent(DeviceContext->ModeIdleEvent);
+			return;
+		}
+	}
+
+	AmtPtpModeSettled(DeviceContext);
+}
+
+VOID
+AmtPtpModeTransferComplete(
+	_In_ WDFREQUEST Request,
+	_In_ WDFIOTARGET Target,
+	_In_ PWDF_REQUEST_COMPLETION_PARAMS Params,
+	_In_ WDFCONTEXT Context
+)
+{
+	PDEVICE_CONTEXT				pDeviceContext = (PDEVICE_CONTEXT) Context;
+	NTSTATUS					status = Params->IoStatus.Status;
+	WDF_REQUEST_REUSE_PARAMS	reuseParams;
+	AMTPTP_MODE_STEP			step;
+	BOOLEAN						handOver;
+
+	UNREFERENCED_PARAMETER(Target);
 
 	// Behavior mismatch: Actual device does not transfer bytes as expected (in length)
-	// So we do not check um_size as a temporary workaround.
+	// So we do not check the message length as a temporary workaround.
 	if (!NT_SUCCESS(status)) {
 		TraceEvents(
-			TRACE_LEVEL_ERROR, 
-			TRACE_DEVICE, 
-			"%!FUNC! WdfUsbTargetDeviceSendControlTransferSynchronously (Read) failed with %!STATUS!, cbTransferred = %llu, um_size = %d", 
-			status,
-			cbTransferred,
-			DeviceContext->DeviceInfo->um_size
+			TRACE_LEVEL_ERROR,
+			TRACE_DEVICE,
+			"%!FUNC! Mode transfer failed with %!STATUS!",
+			status
 		);
-		goto cleanup;
 	}
 
-	// Apply the mode switch
-	buffer[DeviceContext->DeviceInfo->um_switch_idx] = IsWellspringModeOn ?
-		(unsigned char) DeviceContext->DeviceInfo->um_switch_on : 
-		(unsigned char) DeviceContext->DeviceInfo->um_switch_off;
-
-	// Write configuration
-	WDF_USB_CONTROL_SETUP_PACKET_INIT(
-		&setupPacket, 
-		BmRequestHostToDevice, 
-		BmRequestToInterface,
-		BCM5974_WELLSPRING_MODE_WRITE_REQUEST_ID,
-		(USHORT) DeviceContext->DeviceInfo->um_req_val, 
-		(USHORT) DeviceContext->DeviceInfo->um_req_idx
+	WDF_REQUEST_REUSE_PARAMS_INIT(
+		&reuseParams,
+		WDF_REQUEST_REUSE_NO_FLAGS,
+		STATUS_SUCCESS
 	);
+	WdfRequestReuse(Request, &reuseParams);
+
+	WdfSpinLockAcquire(pDeviceContext->ModeLock);
+	step = AmtPtpModeEngineComplete(&pDeviceContext->ModeEngine, NT_SUCCESS(status));
+	handOver = pDeviceContext->ModeSynchronous;
+	if (handOver && step != AmtPtpModeStepNone) {
+		// Never sent, the synchronous switch starts over from what the device confirmed
+		step = AmtPtpModeEngineComplete(&pDeviceContext->ModeEngine, FALSE);
+	}
+	pDeviceContext->IsWellspringModeOn = (pDeviceContext->ModeEngine.Known == AmtPtpModeWellspring);
+	WdfSpinLockRelease(pDeviceContext->ModeLock);
 
-	// Set stuffs right
-	setupPacket.Packet.bm.Request.Type = BmRequestClass;
+	if (handOver) {
+		SetEvent(pDeviceContext->ModeIdleEvent);
+		return;
+	}
 
-	status = WdfUsbTargetDeviceSendControlTransferSynchronously(
-		DeviceContext->UsbDevice, 
-		WDF_NO_HANDLE, 
-		NULL, 
-		&setupPacket, 
-		&memoryDescriptor, 
-		&cbTransferred
+	AmtPtpSendModeTransfer(pDeviceContext, step);
+}
+
+//
+// Leaving D0 needs the device back in mouse mode before it returns, so the
+// transfers are sent synchronously. An asynchronous transfer still in flight
+// is cancelled and waited for first, the engine only has one at a time.
+//
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+AmtPtpSetWellspringMode(
+	_In_ PDEVICE_CONTEXT DeviceContext,
+	_In_ BOOL IsWellspringModeOn
+)
+{
+
+	NTSTATUS						status = STATUS_SUCCESS;
+	AMTPTP_MODE_STEP				step;
+	BOOLEAN							inFlight;
+
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION, 
+		TRACE_DRIVER, 
+		"%!FUNC! Entry"
 	);
 
-	if (!NT_SUCCESS(status)) {
+	WdfSpinLockAcquire(DeviceContext->ModeLock);
+	DeviceContext->ModeSynchronous = TRUE;
+	inFlight = (DeviceContext->ModeEngine.InFlight != AmtPtpModeStepNone);
+	WdfSpinLockRelease(DeviceContext->ModeLock);
+
+	if (inFlight) {
 		TraceEvents(
-			TRACE_LEVEL_ERROR, 
-			TRACE_DEVICE, 
-			"%!FUNC! WdfUsbTargetDeviceSendControlTransferSynchronously (Write) failed with %!STATUS!", 
-			status
+			TRACE_LEVEL_INFORMATION,
+			TRACE_DRIVER,
+			"%!FUNC! Waiting for the mode transfer in flight"
+		);
+
+		WdfRequestCancelSentRequest(DeviceContext->ModeRequest);
+		WaitForSingleObject(
+			DeviceContext->ModeIdleEvent,
+			INFINITE
 		);
-		goto cleanup;
 	}
 
-	// Set status
-	DeviceContext->IsWellspringModeOn = IsWellspringModeOn;
+	WdfSpinLockAcquire(DeviceContext->ModeLock);
+	step = AmtPtpModeEngineRequest(
+		&DeviceContext->ModeEngine,
+		IsWellspringModeOn ? AmtPtpModeWellspring : AmtPtpModeMouse
+	);
+	WdfSpinLockRelease(DeviceContext->ModeLock);
+
+	while (step != AmtPtpModeStepNone) {
+		status = AmtPtpSendModeTransferSynchronously(
+			DeviceContext,
+			step
+		);
+
+		WdfSpinLockAcquire(DeviceContext->ModeLock);
+		step = AmtPtpModeEngineComplete(&DeviceContext->ModeEngine, NT_SUCCESS(status));
+		WdfSpinLockRelease(DeviceContext->ModeLock);
+	}
+
+	WdfSpinLockAcquire(DeviceContext->ModeLock);
+	DeviceContext->IsWellspringModeOn = (DeviceContext->ModeEngine.Known == AmtPtpModeWellspring);
+	DeviceContext->ModeSynchronous = FALSE;
+	WdfSpinLockRelease(DeviceContext->ModeLock);
 
-cleanup:
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
 		TRACE_DRIVER,
 		"%!FUNC! Exit"
 	);
 
-	WdfObjectDelete(bufHandle);
 	return status;
 
 }
 
+VOID
+AmtPtpRequestWellspringMode(
+	_In_ PDEVICE_CONTEXT DeviceContext,
+	_In_ BOOL IsWellspringModeOn
+)
+{
+	AMTPTP_MODE_STEP step;
+
+	WdfSpinLockAcquire(DeviceContext->ModeLock);
+	if (DeviceContext->ModeSynchronous) {
+		WdfSpinLockRelease(DeviceContext->ModeLock);
+		return;
+	}
+	step = AmtPtpModeEngineRequest(
+		&DeviceContext->ModeEngine,
+		IsWellspringModeOn ? AmtPtpModeWellspring : AmtPtpModeMouse
+	);
+	// Type 3 has nothing to send, the engine takes the mode as confirmed right away
+	DeviceContext->IsWellspringModeOn = (DeviceContext->ModeEngine.Known == AmtPtpModeWellspring);
+	WdfSpinLockRelease(DeviceContext->ModeLock);
+
+	AmtPtpSendModeTransfer(DeviceContext, step);
+}
+
+VOID
+AmtPtpResumeTimerCallback(
+	_In_ WDFTIMER Timer
+)
+{
+	PDEVICE_CONTEXT		pDeviceContext = DeviceGetContext(WdfTimerGetParentObject(Timer));
+	AMTPTP_MODE_STEP	step = AmtPtpModeStepNone;
+
+	// Leaving D0 moves the target back to mouse mode, nothing to retry then
+	WdfSpinLockAcquire(pDeviceContext->ModeLock);
+	if (pDeviceContext->ModeSynchronous) {
+		WdfSpinLockRelease(pDeviceContext->ModeLock);
+		return;
+	}
+	if (pDeviceContext->ModeEngine.Target == AmtPtpModeWellspring) {
+		step = AmtPtpModeEngineRequest(
+			&pDeviceContext->ModeEngine,
+			AmtPtpModeWellspring
+		);
+	}
+	WdfSpinLockRelease(pDeviceContext->ModeLock);
+
+	AmtPtpSendModeTransfer(pDeviceContext, step);
+}
+
 NTSTATUS
 AmtPtpEvtDeviceD0Entry(
 	_In_ WDFDEVICE Device,
@@ -504,10 +808,16 @@ AmtPtpEvtDeviceD0Entry(
 	PDEVICE_CONTEXT         pDeviceContext;
 	NTSTATUS                status;
 	BOOLEAN                 isTargetStarted;
+	ULONGLONG               hostTime = 0;
 
 	pDeviceContext = DeviceGetContext(Device);
 	isTargetStarted = FALSE;
 
+	QueryUnbiasedInterruptTime(&hostTime);
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	AmtPtpResumeBegin(&pDeviceContext->Resume, hostTime);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, 
 		TRACE_DRIVER, 
@@ -515,28 +825,10 @@ AmtPtpEvtDeviceD0Entry(
 		DbgDevicePowerString(PreviousState)
 	);
 
-	// Check wellspring mode
-	if (pDeviceContext->IsButtonReportOn || pDeviceContext->IsWellspringModeOn) {
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_DRIVER,
-			"%!FUNC! <--AmtPtpDeviceEvtDeviceD0Entry - Start Wellspring Mode"
-		);
-
-		status = AmtPtpSetWellspringMode(
-			pDeviceContext,
-			TRUE
-		);
-
-		if (!NT_SUCCESS(status)) {
-			TraceEvents(
-				TRACE_LEVEL_WARNING,
-				TRACE_DRIVER,
-				"%!FUNC! <--AmtPtpDeviceEvtDeviceD0Entry - Start Wellspring Mode failed with %!STATUS!",
-				status
-			);
-		}
-	}
+	// The device may have lost its mode while it was away
+	WdfSpinLockAcquire(pDeviceContext->ModeLock);
+	AmtPtpModeEngineInvalidate(&pDeviceContext->ModeEngine);
+	WdfSpinLockRelease(pDeviceContext->ModeLock);
 
 	//
 	// Since continuous reader is configured for this interrupt-pipe, we must explicitly start
@@ -555,6 +847,26 @@ AmtPtpEvtDeviceD0Entry(
 
 	isTargetStarted = TRUE;
 
+	QueryUnbiasedInterruptTime(&hostTime);
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	AmtPtpResumeMark(&pDeviceContext->Resume, AmtPtpResumeReadsStarted, hostTime);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
+	// The mode switch goes out alongside the reads instead of ahead of them.
+	// Frames that come in before it lands fail to decode and are dropped.
+	if (pDeviceContext->IsButtonReportOn || pDeviceContext->IsWellspringModeOn) {
+		TraceEvents(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_DRIVER,
+			"%!FUNC! <--AmtPtpDeviceEvtDeviceD0Entry - Start Wellspring Mode"
+		);
+
+		AmtPtpRequestWellspringMode(
+			pDeviceContext,
+			TRUE
+		);
+	}
+
 End:
 
 	if (!NT_SUCCESS(status)) {
@@ -606,6 +918,47 @@ AmtPtpEvtDeviceD0Exit(
 		WdfIoTargetCancelSentIo
 	);
 
+	// Parked frames are stale once the device leaves D0
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Report ring: %d parked, %d dropped, %d coalesced, high watermark %d",
+		AmtPtpReportRingCount(&pDeviceContext->ReportRing),
+		pDeviceContext->ReportRing.Dropped,
+		pDeviceContext->ReportRing.Coalesced,
+		pDeviceContext->ReportRing.HighWatermark
+	);
+	AmtPtpReportRingFlush(&pDeviceContext->ReportRing);
+
+	// Contacts don't survive the power transition either
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Contact tracker: %d lift-offs, %d dropped",
+		pDeviceContext->ContactTracker.LiftOffs,
+		pDeviceContext->ContactTracker.Dropped
+	);
+	AmtPtpContactTrackerReset(&pDeviceContext->ContactTracker);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Scan clock: %d resyncs",
+		pDeviceContext->ScanClock.Resyncs
+	);
+	AmtPtpScanClockReset(&pDeviceContext->ScanClock);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Malformed frames: %d salvaged, %d dropped, %d resets, %llu ms input lost",
+		pDeviceContext->ErrorBudget.Salvaged,
+		pDeviceContext->ErrorBudget.Dropped,
+		pDeviceContext->ErrorBudget.Resets,
+		pDeviceContext->ErrorBudget.LostTime / 10000
+	);
+	AmtPtpErrorBudgetReset(&pDeviceContext->ErrorBudget);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
 	// Cancel Wellspring mode.
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -627,6 +980,37 @@ AmtPtpEvtDeviceD0Exit(
 		);
 	}
 
+	WdfSpinLockAcquire(pDeviceContext->ModeLock);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Mode engine: %d transfers, %d skipped, %d coalesced, %d failures",
+		pDeviceContext->ModeEngine.Transfers,
+		pDeviceContext->ModeEngine.Skipped,
+		pDeviceContext->ModeEngine.Coalesced,
+		pDeviceContext->ModeEngine.Failures
+	);
+	WdfSpinLockRelease(pDeviceContext->ModeLock);
+
+	// Mouse mode is the target now, a pending retry has nothing left to do
+	WdfTimerStop(
+		pDeviceContext->ResumeTimer,
+		TRUE
+	);
+
+	WdfSpinLockAcquire(pDeviceContext->InputLock);
+	TraceEvents(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_DRIVER,
+		"%!FUNC! Resume: reads %llu us, configured %llu us, first report %llu us (worst %llu us), %d retries",
+		AmtPtpResumeElapsed(&pDeviceContext->Resume, AmtPtpResumeReadsStarted) / 10,
+		AmtPtpResumeElapsed(&pDeviceContext->Resume, AmtPtpResumeConfigured) / 10,
+		AmtPtpResumeElapsed(&pDeviceContext->Resume, AmtPtpResumeFirstReport) / 10,
+		pDeviceContext->Resume.MaxFirstReport / 10,
+		pDeviceContext->Resume.Retries
+	);
+	WdfSpinLockRelease(pDeviceContext->InputLock);
+
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, 
 		TRACE_DRIVER, 
@@ -636,6 +1020,19 @@ AmtPtpEvtDeviceD0Exit(
 	return status;
 }
 
+VOID
+AmtPtpEvtDeviceCleanup(
+	_In_ WDFOBJECT Object
+)
+{
+	PDEVICE_CONTEXT pDeviceContext = DeviceGetContext(Object);
+
+	if (pDeviceContext->ModeIdleEvent != NULL) {
+		CloseHandle(pDeviceContext->ModeIdleEvent);
+		pDeviceContext->ModeIdleEvent = NULL;
+	}
+}
+
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 SelectInterruptInterface(
@@ -750,48 +1147,37 @@ DbgDevicePowerString(
 	}
 }
 
-_IRQL_requires_(PASSIVE_LEVEL)
-NTSTATUS
+//
+// Called from the interrupt pipe completion on malformed input. The reset is
+// sent asynchronously so input keeps flowing, and further resets requested
+// before it finishes are folded into it.
+//
+VOID
 AmtPtpEmergResetDevice(
 	_In_ PDEVICE_CONTEXT DeviceContext
 )
 {
+	AMTPTP_MODE_STEP step;
+	ULONG coalesced;
 
-	NTSTATUS status;
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_DRIVER,
-		"%!FUNC! Entry");
-
-	status = AmtPtpSetWellspringMode(
-		DeviceContext, 
-		FALSE);
-
-	if (!NT_SUCCESS(status)) {
-		TraceEvents(
-			TRACE_LEVEL_ERROR, 
-			TRACE_DEVICE, 
-			"%!FUNC! AmtPtpSetWellspringMode failed with %!STATUS!", 
-			status);
+	WdfSpinLockAcquire(DeviceContext->ModeLock);
+	if (DeviceContext->ModeSynchronous) {
+		WdfSpinLockRelease(DeviceContext->ModeLock);
+		return;
 	}
+	step = AmtPtpModeEngineReset(&DeviceContext->ModeEngine);
+	coalesced = DeviceContext->ModeEngine.Coalesced;
+	WdfSpinLockRelease(DeviceContext->ModeLock);
 
-	status = AmtPtpSetWellspringMode(
-		DeviceContext,
-		TRUE);
-
-	if (!NT_SUCCESS(status)) {
+	if (step == AmtPtpModeStepNone) {
 		TraceEvents(
-			TRACE_LEVEL_ERROR,
-			TRACE_DEVICE,
-			"%!FUNC! AmtPtpSetWellspringMode failed with %!STATUS!",
-			status);
+			TRACE_LEVEL_INFORMATION,
+			TRACE_DRIVER,
+			"%!FUNC! Reset already underway, %d coalesced",
+			coalesced
+		);
+		return;
 	}
 
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION, 
-		TRACE_DRIVER, 
-		"%!FUNC! Exit");
-
-	return status;
-
+	AmtPtpSendModeTransfer(DeviceContext, step);
 }
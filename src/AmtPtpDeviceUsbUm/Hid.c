@@ -16,7 +16,7 @@ AmtPtpGetHidDescriptor(
 	PDEVICE_CONTEXT pContext = DeviceGetContext(Device);
 	size_t			szHidDescriptor = 0;
 	WDFMEMORY       RequestMemory;
-	PHID_DESCRIPTOR pSelectedHidDescriptor = NULL;
+	const HID_DESCRIPTOR* pSelectedHidDescriptor = NULL;
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, 
@@ -39,10 +39,8 @@ AmtPtpGetHidDescriptor(
 		return status;
 	}
 
-	switch (pContext->DeviceDescriptor.idProduct) {
-		case USB_DEVICE_ID_APPLE_WELLSPRING3_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING3_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING3_JIS:
+	switch (pContext->DeviceInfo->Descriptor) {
+		case AmtPtpReportDescriptorWellspring3:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
@@ -54,29 +52,19 @@ AmtPtpGetHidDescriptor(
 			pSelectedHidDescriptor = &AmtPtp3DefaultHidDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_WELLSPRING5_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5A_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5A_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5A_JIS:
+		case AmtPtpReportDescriptorWellspring5:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
 				TRACE_DRIVER,
-				"%!FUNC! Request HID Report Descriptor for MacBook Family, Wellspring 5/5A Series"
+				"%!FUNC! Request HID Report Descriptor for MacBook Family, Wellspring 5 Series"
 			);
 
 			szHidDescriptor = AmtPtp5DefaultHidDescriptor.bLength;
 			pSelectedHidDescriptor = &AmtPtp5DefaultHidDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_WELLSPRING6_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6A_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6A_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6A_JIS:
+		case AmtPtpReportDescriptorWellspring6:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
@@ -88,29 +76,19 @@ AmtPtpGetHidDescriptor(
 			pSelectedHidDescriptor = &AmtPtp6DefaultHidDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_WELLSPRING7_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7A_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7A_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7A_JIS:
+		case AmtPtpReportDescriptorWellspring7a:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
 				TRACE_DRIVER,
-				"%!FUNC! Request HID Report Descriptor for MacBook Family, Wellspring 7/7A Series"
+				"%!FUNC! Request HID Report Descriptor for MacBook Family, Wellspring 5A/7/7A Series"
 			);
 
 			szHidDescriptor = AmtPtp7aDefaultHidDescriptor.bLength;
 			pSelectedHidDescriptor = &AmtPtp7aDefaultHidDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_WELLSPRING8_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING8_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING8_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING9_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING9_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING9_ISO:
+		case AmtPtpReportDescriptorWellspring8:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
@@ -122,7 +100,19 @@ AmtPtpGetHidDescriptor(
 			pSelectedHidDescriptor = &AmtPtp8DefaultHidDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_MAGICTRACKPAD2:
+		case AmtPtpReportDescriptorWellspring9:
+		{
+			TraceEvents(
+				TRACE_LEVEL_INFORMATION,
+				TRACE_DRIVER,
+				"%!FUNC! Request HID Report Descriptor for MacBook Family, Wellspring 9 Series"
+			);
+
+			szHidDescriptor = AmtPtp9DefaultHidDescriptor.bLength;
+			pSelectedHidDescriptor = &AmtPtp9DefaultHidDescriptor;
+			break;
+		}
+		case AmtPtpReportDescriptorMagicTrackpad2:
 		{
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION,
@@ -254,7 +244,9 @@ AmtPtpGetReportDescriptor(
 	PDEVICE_CONTEXT        pContext = DeviceGetContext(Device);
 	size_t			       szHidDescriptor = 0;
 	WDFMEMORY              RequestMemory;
-	PHID_REPORT_DESCRIPTOR pSelectedHidDescriptor = NULL;
+	const HID_REPORT_DESCRIPTOR* pSelectedHidDescriptor = NULL;
+	AMTPTP_HID_LAYOUT_RESULT layoutResult;
+	AMTPTP_HID_REPORT_SIZE layoutMismatch = { 0 };
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION, 
@@ -277,60 +269,44 @@ AmtPtpGetReportDescriptor(
 		goto exit;
 	}
 
-	switch (pContext->DeviceDescriptor.idProduct) {
-		case USB_DEVICE_ID_APPLE_WELLSPRING3_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING3_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING3_JIS:
+	switch (pContext->DeviceInfo->Descriptor) {
+		case AmtPtpReportDescriptorWellspring3:
 		{
 			szHidDescriptor = AmtPtp3DefaultHidDescriptor.DescriptorList[0].wReportLength;
 			pSelectedHidDescriptor = AmtPtp3ReportDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_WELLSPRING5_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5A_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5A_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING5A_JIS:
+		case AmtPtpReportDescriptorWellspring5:
 		{
 			szHidDescriptor = AmtPtp5DefaultHidDescriptor.DescriptorList[0].wReportLength;
 			pSelectedHidDescriptor = AmtPtp5ReportDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_WELLSPRING6_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6A_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6A_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING6A_JIS:
+		case AmtPtpReportDescriptorWellspring6:
 		{
 			szHidDescriptor = AmtPtp6DefaultHidDescriptor.DescriptorList[0].wReportLength;
 			pSelectedHidDescriptor = AmtPtp6ReportDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_WELLSPRING7_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7A_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7A_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING7A_JIS:
+		case AmtPtpReportDescriptorWellspring7a:
 		{
 			szHidDescriptor = AmtPtp7aDefaultHidDescriptor.DescriptorList[0].wReportLength;
 			pSelectedHidDescriptor = AmtPtp7aReportDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_WELLSPRING8_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING8_ISO:
-		case USB_DEVICE_ID_APPLE_WELLSPRING8_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING9_JIS:
-		case USB_DEVICE_ID_APPLE_WELLSPRING9_ANSI:
-		case USB_DEVICE_ID_APPLE_WELLSPRING9_ISO:
+		case AmtPtpReportDescriptorWellspring8:
 		{
 			szHidDescriptor = AmtPtp8DefaultHidDescriptor.DescriptorList[0].wReportLength;
 			pSelectedHidDescriptor = AmtPtp8ReportDescriptor;
 			break;
 		}
-		case USB_DEVICE_ID_APPLE_MAGICTRACKPAD2:
+		case AmtPtpReportDescriptorWellspring9:
+		{
+			szHidDescriptor = AmtPtp9DefaultHidDescriptor.DescriptorList[0].wReportLength;
+			pSelectedHidDescriptor = AmtPtp9ReportDescriptor;
+			break;
+		}
+		case AmtPtpReportDescriptorMagicTrackpad2:
 		{
 			szHidDescriptor = AmtPtpMt2DefaultHidDescriptor.DescriptorList[0].wReportLength;
 			pSelectedHidDescriptor = AmtPtpMt2ReportDescriptor;
@@ -339,6 +315,28 @@ AmtPtpGetReportDescriptor(
 	}
 
 	if (pSelectedHidDescriptor != NULL && szHidDescriptor > 0) {
+		// hidclass sizes reports from the descriptor, a mismatch would misread every report
+		layoutResult = AmtPtpHidVerifyReportSizes(
+			pSelectedHidDescriptor,
+			(ULONG) szHidDescriptor,
+			AmtPtpReportSizes,
+			RTL_NUMBER_OF(AmtPtpReportSizes),
+			&layoutMismatch
+		);
+
+		if (layoutResult != AmtPtpHidLayoutOk) {
+			TraceEvents(
+				TRACE_LEVEL_ERROR,
+				TRACE_DRIVER,
+				"%!FUNC! HID report descriptor does not match the driver (%d), report %d declares %d bytes",
+				layoutResult,
+				layoutMismatch.ReportId,
+				layoutMismatch.Size
+			);
+			status = STATUS_INVALID_DEVICE_STATE;
+			goto exit;
+		}
+
 		status = WdfMemoryCopyFromBuffer(
 			RequestMemory,
 			0,
@@ -769,7 +767,7 @@ AmtPtpReportFeatures(
 
 			PPTP_DEVICE_CAPS_FEATURE_REPORT capsReport = (PPTP_DEVICE_CAPS_FEATURE_REPORT) packet.reportBuffer;
 
-			capsReport->MaximumContactPoints = PTP_MAX_CONTACT_POINTS;
+			capsReport->MaximumContactPoints = PTP_MAX_HYBRID_CONTACT_POINTS;
 			capsReport->ButtonType = PTP_BUTTON_TYPE_CLICK_PAD;
 			capsReport->ReportID = REPORTID_DEVICE_CAPS;
 
@@ -873,6 +871,51 @@ AmtPtpReportFeatures(
 			);
 			break;
 		}
+		case REPORTID_PERF_COUNTERS:
+		{
+			TraceEvents(
+				TRACE_LEVEL_INFORMATION,
+				TRACE_DRIVER,
+				"%!FUNC! Report REPORTID_PERF_COUNTERS is requested"
+			);
+
+			// Size sanity check
+			reportSize = sizeof(PTP_PERF_COUNTERS_REPORT);
+			if (packet.reportBufferLen < reportSize) {
+				status = STATUS_INVALID_BUFFER_SIZE;
+				TraceEvents(
+					TRACE_LEVEL_ERROR,
+					TRACE_DRIVER,
+					"%!FUNC! Report buffer is too small."
+				);
+				goto exit;
+			}
+
+			PPTP_PERF_COUNTERS_REPORT countersReport = (PPTP_PERF_COUNTERS_REPORT)packet.reportBuffer;
+			ULONG counters[AMTPTP_PERF_COUNTER_COUNT];
+
+			// Read as they are, the input path keeps counting meanwhile. The
+			// report is packed, so the values are staged aligned first.
+			AmtPtpPerfCountersSnapshot(
+				&deviceContext->PerfCounters,
+				counters
+			);
+
+			countersReport->ReportID = REPORTID_PERF_COUNTERS;
+			RtlCopyMemory(countersReport->Counters, counters, sizeof(counters));
+
+			TraceEvents(
+				TRACE_LEVEL_INFORMATION,
+				TRACE_DRIVER,
+				"%!FUNC! Report REPORTID_PERF_COUNTERS is fulfilled"
+			);
+
+			WdfRequestSetInformation(
+				Request,
+				reportSize
+			);
+			break;
+		}
 		default:
 			TraceEvents(
 				TRACE_LEVEL_INFORMATION, 
@@ -942,25 +985,8 @@ AmtPtpSetFeatures(
 
 			PPTP_DEVICE_INPUT_MODE_REPORT devInputMode = (PPTP_DEVICE_INPUT_MODE_REPORT) packet.reportBuffer;
 
-			// Get current WellSpring mode
-			BOOL bWellspringMode = FALSE;
-			status = AmtPtpGetWellspringMode(
-				deviceContext,
-				&bWellspringMode
-			);
-
-			if (!NT_SUCCESS(status)) {
-
-				TraceEvents(
-					TRACE_LEVEL_ERROR,
-					TRACE_DRIVER,
-					"%!FUNC! -> AmtPtpGetWellspringMode failed with status %!STATUS!",
-					status
-				);
-				goto exit;
-
-			}
-
+			// The mode block transfers go out asynchronously, a request for the
+			// mode the device is already in sends nothing
 			switch (devInputMode->Mode)
 			{
 				case PTP_COLLECTION_MOUSE:
@@ -972,25 +998,10 @@ AmtPtpSetFeatures(
 						"%!FUNC! Report REPORTID_REPORTMODE requested Mouse Input"
 					);
 
-					if (bWellspringMode) {
-
-						status = AmtPtpSetWellspringMode(
-							deviceContext,
-							FALSE
-						);
-
-						if (!NT_SUCCESS(status)) {
-							TraceEvents(
-								TRACE_LEVEL_ERROR,
-								TRACE_DRIVER,
-								"%!FUNC! -> AmtPtpSetWellspringMode failed with status %!STATUS!",
-								status
-							);
-							goto exit;
-						}
-
-					}
-				
+					AmtPtpRequestWellspringMode(
+						deviceContext,
+						FALSE
+					);
 					break;
 
 				}
@@ -1003,25 +1014,10 @@ AmtPtpSetFeatures(
 						"%!FUNC! Report REPORTID_REPORTMODE requested Windows PTP Input"
 					);
 
-					if (!bWellspringMode) {
-						
-						status = AmtPtpSetWellspringMode(
-							deviceContext,
-							TRUE
-						);
-
-						if (!NT_SUCCESS(status)) {
-							TraceEvents(
-								TRACE_LEVEL_ERROR,
-								TRACE_DRIVER,
-								"%!FUNC! -> AmtPtpSetWellspringMode failed with status %!STATUS!",
-								status
-							);
-							goto exit;
-						}
-
-					}
-
+					AmtPtpRequestWellspringMode(
+						deviceContext,
+						TRUE
+					);
 					break;
 
 				}
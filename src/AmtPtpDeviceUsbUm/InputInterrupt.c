@@ -12,7 +12,7 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 
 	WDF_USB_CONTINUOUS_READER_CONFIG contReaderConfig;
 	NTSTATUS status;
-	size_t transferLength = 0;
+	size_t transferLength = DeviceContext->DeviceInfo->TransferLength;
 
 	TraceEvents(
 		TRACE_LEVEL_INFORMATION,
@@ -20,25 +20,6 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 		"%!FUNC! Entry"
 	);
 
-	switch (DeviceContext->DeviceInfo->tp_type)
-	{
-		case TYPE1:
-			transferLength = HEADER_TYPE1 + FSIZE_TYPE1 * MAX_FINGERS;
-			break;
-		case TYPE2:
-			transferLength = HEADER_TYPE2 + FSIZE_TYPE2 * MAX_FINGERS;
-			break;
-		case TYPE3:
-			transferLength = HEADER_TYPE3 + FSIZE_TYPE3 * MAX_FINGERS;
-			break;
-		case TYPE4:
-			transferLength = HEADER_TYPE4 + FSIZE_TYPE4 * MAX_FINGERS;
-			break;
-		case TYPE5:
-			transferLength = HEADER_TYPE5 + FSIZE_TYPE5 * MAX_FINGERS;
-			break;
-	}
-
 	if (transferLength <= 0) {
 		status = STATUS_UNKNOWN_REVISION;
 		return status;
@@ -94,120 +75,56 @@ AmtPtpEvtUsbInterruptPipeReadComplete(
 	PDEVICE_CONTEXT pDeviceContext = Context;
 	UCHAR*			pBuffer = NULL;
 	NTSTATUS        status;
+	AMTPTP_INPUT_STAMPS stamps = { 0 };
 
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_DRIVER,
-		"%!FUNC! Entry"
-	);
+	// Latency is measured from here, before anything else runs
+	QueryPerformanceCounter(&stamps.TransportCompleted);
+	stamps.Traced = AMTPTP_INPUT_LATENCY_ENABLED();
 
 	device = WdfObjectContextGetObject(pDeviceContext);
-	size_t headerSize = (unsigned int) pDeviceContext->DeviceInfo->tp_header;
-	size_t fingerprintSize = (unsigned int) pDeviceContext->DeviceInfo->tp_fsize;
 
-	if (NumBytesTransferred < headerSize || (NumBytesTransferred - headerSize) % fingerprintSize != 0) {
+	if (!pDeviceContext->IsWellspringModeOn) {
 
 		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
+			TRACE_LEVEL_WARNING,
 			TRACE_DRIVER,
-			"%!FUNC! Malformed input received. Length = %llu. Attempt to reset device.",
-			NumBytesTransferred
+			"%!FUNC! Routine is called without enabling Wellspring mode"
 		);
 
-		status = AmtPtpEmergResetDevice(pDeviceContext);
-		if (!NT_SUCCESS(status)) {
-
-			TraceEvents(
-				TRACE_LEVEL_INFORMATION,
-				TRACE_DRIVER,
-				"%!FUNC! AmtPtpEmergResetDevice failed with %!STATUS!",
-				status
-			);
-
-		}
-
 		return;
 	}
 
-	if (!pDeviceContext->IsWellspringModeOn) {
-
+	// TYPE1 is the only format not handled by the decoder
+	if (pDeviceContext->DeviceInfo->Type == AmtPtpTrackpadType1) {
 		TraceEvents(
 			TRACE_LEVEL_WARNING,
 			TRACE_DRIVER,
-			"%!FUNC! Routine is called without enabling Wellspring mode"
+			"%!FUNC! Mode not yet supported"
 		);
-
 		return;
 	}
 
-	// Dispatch USB Interrupt routine by device family
-	switch (pDeviceContext->DeviceInfo->tp_type) {
-		case TYPE1:
-		{
-			TraceEvents(
-				TRACE_LEVEL_WARNING,
-				TRACE_DRIVER,
-				"%!FUNC! Mode not yet supported"
-			);
-			break;
-		}
-		// Universal routine handler
-		case TYPE2:
-		case TYPE3:
-		case TYPE4:
-		{
-			pBuffer = WdfMemoryGetBuffer(
-				Buffer,
-				NULL
-			);
-
-			status = AmtPtpServiceTouchInputInterrupt(
-				pDeviceContext,
-				pBuffer,
-				NumBytesTransferred
-			);
+	pBuffer = WdfMemoryGetBuffer(
+		Buffer,
+		NULL
+	);
 
-			if (!NT_SUCCESS(status)) {
-				TraceEvents(
-					TRACE_LEVEL_WARNING,
-					TRACE_DRIVER,
-					"%!FUNC! AmtPtpServiceTouchInputInterrupt failed with %!STATUS!",
-					status
-				);
-			}
-			break;
-		}
-		// Magic Trackpad 2
-		case TYPE5:
-		{
-			pBuffer = WdfMemoryGetBuffer(
-				Buffer,
-				NULL
-			);
-			status = AmtPtpServiceTouchInputInterruptType5(
-				pDeviceContext,
-				pBuffer,
-				NumBytesTransferred
-			);
+	status = AmtPtpServiceTouchInputInterrupt(
+		pDeviceContext,
+		pBuffer,
+		NumBytesTransferred,
+		&stamps
+	);
 
-			if (!NT_SUCCESS(status)) {
-				TraceEvents(
-					TRACE_LEVEL_WARNING,
-					TRACE_DRIVER,
-					"%!FUNC! AmtPtpServiceTouchInputInterrupt5 failed with %!STATUS!",
-					status
-				);
-			}
-			break;
-		}
+	if (!NT_SUCCESS(status)) {
+		TraceEvents(
+			TRACE_LEVEL_WARNING,
+			TRACE_DRIVER,
+			"%!FUNC! AmtPtpServiceTouchInputInterrupt failed with %!STATUS!",
+			status
+		);
 	}
 
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_DRIVER,
-		"%!FUNC! Exit"
-	);
-
 }
 
 _IRQL_requires_(PASSIVE_LEVEL)
@@ -225,349 +142,461 @@ AmtPtpEvtUsbInterruptReadersFailed(
 	return TRUE;
 }
 
+//
+// Writes the frames leading up to an input error to the trace, oldest first.
+//
+static VOID
+AmtPtpDumpTraceRing(
+	_In_ PDEVICE_CONTEXT DeviceContext
+)
+{
+	AMTPTP_TRACE_CURSOR Cursor;
+	AMTPTP_TRACE_RECORD Record;
+
+	AmtPtpTraceRingBegin(&DeviceContext->TraceRing, &Cursor);
+	while (AmtPtpTraceRingNext(&DeviceContext->TraceRing, &Cursor, &Record)) {
+		TraceEvents(
+			TRACE_LEVEL_WARNING,
+			TRACE_INPUT,
+			"%!FUNC! #%d %llu us %s %d %d",
+			Record.Sequence,
+			Record.Time / 10,
+			AmtPtpTraceEventName(Record.Event),
+			Record.Arg0,
+			Record.Arg1
+		);
+	}
+}
+
+//
+// One event per stamped frame. ParkedFrames is the report ring depth when the
+// frame left the lock, PendingReads the hidclass reads still waiting after it.
+//
+static VOID
+AmtPtpTraceInputStages(
+	_In_ PDEVICE_CONTEXT DeviceContext,
+	_In_ const AMTPTP_INPUT_STAMPS* Stamps,
+	_In_ UCHAR ContactCount,
+	_In_ ULONG ParkedFrames
+)
+{
+	ULONG PendingReads = 0;
+
+	WdfIoQueueGetState(
+		DeviceContext->InputQueue,
+		&PendingReads,
+		NULL
+	);
+
+	TraceLoggingWrite(
+		g_hAmtPtpDeviceTraceProvider,
+		EVENT_INPUT_DIAGNOSTICS,
+		TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+		TraceLoggingKeyword(AMTPTP_TRACE_KEYWORD_INPUT_LATENCY),
+		TraceLoggingString(EVENT_INPUT_DIAG_SUBTYPE_STAGE_LATENCY, EVENT_DRIVER_FUNC_SUBTYPE),
+		TraceLoggingUInt16(DeviceContext->DeviceDescriptor.idProduct, "idProduct"),
+		TraceLoggingUInt16(DeviceContext->DeviceDescriptor.idVendor, "idVendor"),
+		TraceLoggingInt64(Stamps->TransportCompleted.QuadPart, "TransportCompleted"),
+		TraceLoggingInt64(Stamps->ParseStarted.QuadPart, "ParseStarted"),
+		TraceLoggingInt64(Stamps->ReportComposed.QuadPart, "ReportComposed"),
+		TraceLoggingInt64(Stamps->RequestCompleted.QuadPart, "RequestCompleted"),
+		TraceLoggingInt64(DeviceContext->PerformanceFrequency.QuadPart, "PerformanceFrequency"),
+		TraceLoggingUInt8(ContactCount, "ContactCount"),
+		TraceLoggingUInt32(ParkedFrames, "ParkedFrames"),
+		TraceLoggingUInt32(PendingReads, "PendingReads")
+	);
+}
+
+//
+// Hands parked reports to reads hidclass left pending, oldest first. A frame
+// that finds reports parked is parked behind them, so the rest of a hybrid
+// scan reaches hidclass before anything that came in after it.
+//
+static VOID
+AmtPtpServeParkedReports(
+	_In_ PDEVICE_CONTEXT DeviceContext
+)
+{
+	NTSTATUS Status;
+	WDFREQUEST Request;
+	AMTPTP_DECODED_FRAME Frame;
+	ULONGLONG HostTime = 0;
+
+	for (;;) {
+		WdfSpinLockAcquire(DeviceContext->InputLock);
+
+		if (AmtPtpReportRingCount(&DeviceContext->ReportRing) == 0 ||
+			!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(DeviceContext->InputQueue, &Request))) {
+			WdfSpinLockRelease(DeviceContext->InputLock);
+			return;
+		}
+
+		// The frame stays parked until it made it into the request
+		AmtPtpReportRingPeek(
+			&DeviceContext->ReportRing,
+			&Frame
+		);
+
+		Status = AmtPtpWriteReadReport(
+			Request,
+			&Frame
+		);
+
+		if (NT_SUCCESS(Status)) {
+			AmtPtpReportRingAdvance(
+				&DeviceContext->ReportRing,
+				PTP_MAX_CONTACT_POINTS
+			);
+		}
+
+		WdfSpinLockRelease(DeviceContext->InputLock);
+
+		WdfRequestComplete(
+			Request,
+			Status
+		);
+
+		if (NT_SUCCESS(Status)) {
+			QueryUnbiasedInterruptTime(&HostTime);
+			AmtPtpTraceRingRecord(
+				&DeviceContext->TraceRing,
+				AmtPtpTraceReportOut,
+				Frame.ContactCount,
+				Frame.ScanTime,
+				HostTime
+			);
+			AMTPTP_PERF_COUNT(&DeviceContext->PerfCounters, ReportsOut);
+		}
+	}
+}
+
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 AmtPtpServiceTouchInputInterrupt(
 	_In_ PDEVICE_CONTEXT DeviceContext,
 	_In_ UCHAR* Buffer,
-	_In_ size_t NumBytesTransferred
+	_In_ size_t NumBytesTransferred,
+	_Inout_ PAMTPTP_INPUT_STAMPS Stamps
 )
 {
 	NTSTATUS Status;
 	WDFREQUEST Request;
-	WDFMEMORY  RequestMemory;
-	PTP_REPORT PtpReport;
-
-	const struct TRACKPAD_FINGER *f;
+	AMTPTP_DECODED_FRAME Frame;
+	AMTPTP_FRAME_CHECK FrameCheck;
+	AMTPTP_FRAME_VERDICT Verdict;
+	BOOLEAN FirstReport;
+	AMTPTP_RING_PUSH_RESULT PushResult;
+	ULONGLONG HostTime = 0;
+	UCHAR ContactCount = 0;
+	ULONG ParkedFrames = 0;
+
+	// Sample host time first, it backs up the device clock
+	QueryUnbiasedInterruptTime(&HostTime);
+
+	AMTPTP_PERF_COUNT(&DeviceContext->PerfCounters, FramesIn);
+
+	if (Stamps->Traced) {
+		QueryPerformanceCounter(&Stamps->ParseStarted);
+	}
 
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_DRIVER,
-		"%!FUNC! Entry"
+	FrameCheck = AmtPtpDecodeFrameSalvage(
+		&DeviceContext->DecoderConfig,
+		Buffer,
+		NumBytesTransferred,
+		&Frame
 	);
 
-	size_t raw_n, i = 0;
-	size_t headerSize = (unsigned int) DeviceContext->DeviceInfo->tp_header;
-	size_t fingerprintSize = (unsigned int) DeviceContext->DeviceInfo->tp_fsize;
-	USHORT x = 0, y = 0;
-
-	Status = STATUS_SUCCESS;
-	PtpReport.ReportID = REPORTID_MULTITOUCH;
-	PtpReport.IsButtonClicked = 0;
-
-	// Retrieve next PTP touchpad request.
-	Status = WdfIoQueueRetrieveNextRequest(
-		DeviceContext->InputQueue,
-		&Request
+	WdfSpinLockAcquire(DeviceContext->InputLock);
+	Verdict = AmtPtpErrorBudgetRecord(
+		&DeviceContext->ErrorBudget,
+		FrameCheck,
+		HostTime
+	);
+	FirstReport = (Verdict == AmtPtpFrameDeliver) && AmtPtpResumeMark(
+		&DeviceContext->Resume,
+		AmtPtpResumeFirstReport,
+		HostTime
+	);
+	WdfSpinLockRelease(DeviceContext->InputLock);
+
+	AmtPtpTraceRingRecord(
+		&DeviceContext->TraceRing,
+		(Verdict == AmtPtpFrameDeliver) ? AmtPtpTraceFrameIn : AmtPtpTraceFrameRejected,
+		(ULONG) NumBytesTransferred,
+		(Verdict == AmtPtpFrameDeliver) ? (ULONG) FrameCheck : (ULONG) Verdict,
+		HostTime
 	);
 
-	if (!NT_SUCCESS(Status)) {
+	if (FirstReport) {
 		TraceEvents(
 			TRACE_LEVEL_INFORMATION,
 			TRACE_DRIVER,
-			"%!FUNC! No pending PTP request. Interrupt disposed"
+			"%!FUNC! First report %llu us after D0 entry",
+			DeviceContext->Resume.LastFirstReport / 10
 		);
-		goto exit;
 	}
 
-	// Scan time is in 100us
-	// MS Timestamp is reported in bytes 4-7, maybe use that?
-	PtpReport.ScanTime = (USHORT) ((ULONG) *(Buffer + 0x4) * 10);
-
-	// Allocate output memory.
-	Status = WdfRequestRetrieveOutputMemory(
-		Request,
-		&RequestMemory
-	);
-
-	if (!NT_SUCCESS(Status)) {
+	// An isolated bad frame is skipped, the pending read waits for the next one
+	if (Verdict != AmtPtpFrameDeliver) {
+		AMTPTP_PERF_COUNT(&DeviceContext->PerfCounters, Malformed);
 		TraceEvents(
-			TRACE_LEVEL_ERROR,
+			TRACE_LEVEL_WARNING,
 			TRACE_DRIVER,
-			"%!FUNC! WdfRequestRetrieveOutputMemory failed with %!STATUS!",
-			Status
+			"%!FUNC! Malformed input received. Length = %llu.%s",
+			NumBytesTransferred,
+			(Verdict == AmtPtpFrameReset) ? " Attempt to reset device." : ""
 		);
+
+		if (Verdict == AmtPtpFrameReset) {
+			AMTPTP_PERF_COUNT(&DeviceContext->PerfCounters, Resets);
+			AmtPtpDumpTraceRing(DeviceContext);
+			AmtPtpEmergResetDevice(DeviceContext);
+		}
+
+		Status = STATUS_DEVICE_DATA_ERROR;
 		goto exit;
 	}
 
-	// Type 2 touchpad surface report
-	if (DeviceContext->IsSurfaceReportOn) {
-		// Handles trackpad surface report here.
-		raw_n = (NumBytesTransferred - headerSize) / fingerprintSize;
-		if (raw_n >= PTP_MAX_CONTACT_POINTS) raw_n = PTP_MAX_CONTACT_POINTS;
-		PtpReport.ContactCount = (UCHAR) raw_n;
+	// Honor the selective reporting switches from the host
+	if (!DeviceContext->IsSurfaceReportOn) {
+		Frame.ContactCount = 0;
+	}
+
+	if (!DeviceContext->IsButtonReportOn) {
+		Frame.IsButtonClicked = FALSE;
+	}
 
-#ifdef INPUT_CONTENT_TRACE
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_DRIVER,
-			"%!FUNC! with %llu points.",
-			raw_n
+	ContactCount = Frame.ContactCount;
+
+	// Contacts go to the trace for one frame in AMTPTP_TRACE_SAMPLE_INTERVAL
+	if (AmtPtpTraceRingSample(&DeviceContext->TraceRing)) {
+		TraceHot(
+			TRACE_LEVEL_VERBOSE,
+			TRACE_INPUT,
+			"%!FUNC! with %d points.",
+			Frame.ContactCount
 		);
-#endif
-
-		// Fingers
-		for (i = 0; i < raw_n; i++) {
-
-			UCHAR *f_base = Buffer + Buffer[2];
-			f = (const struct TRACKPAD_FINGER*) (f_base + i * fingerprintSize);
-
-			// Translate X and Y
-			x = (AmtRawToInteger(f->abs_x) - DeviceContext->DeviceInfo->x.min) > 0 ? 
-				((USHORT)(AmtRawToInteger(f->abs_x) - DeviceContext->DeviceInfo->x.min)) : 0;
-			y = (DeviceContext->DeviceInfo->y.max - AmtRawToInteger(f->abs_y)) > 0 ? 
-				((USHORT)(DeviceContext->DeviceInfo->y.max - AmtRawToInteger(f->abs_y))) : 0;
-
-			// Defuzz functions remain the same
-			// TODO: Implement defuzz later
-			PtpReport.Contacts[i].ContactID = f->id;
-			PtpReport.Contacts[i].X = x;
-			PtpReport.Contacts[i].Y = y;
-			PtpReport.Contacts[i].TipSwitch = (f->state & 0x4) && !(f->state & 0x2);
-			PtpReport.Contacts[i].Confidence = (f->finger != 6 && f->finger != 7);
-
-#ifdef INPUT_CONTENT_TRACE
-			TraceEvents(
-				TRACE_LEVEL_INFORMATION,
+
+		for (UCHAR i = 0; i < Frame.ContactCount; i++) {
+			TraceHot(
+				TRACE_LEVEL_VERBOSE,
 				TRACE_INPUT,
-				"%!FUNC!: Point %llu, X = %d, Y = %d, TipSwitch = %d, Confidence = %d, tMajor = %d, tMinor = %d, origin = %d, PTP Origin = %d",
+				"%!FUNC!: Point %d, X = %d, Y = %d, TipSwitch = %d, Confidence = %d, tMajor = %d, tMinor = %d, id = %d",
 				i,
-				PtpReport.Contacts[i].X,
-				PtpReport.Contacts[i].Y,
-				PtpReport.Contacts[i].TipSwitch,
-				PtpReport.Contacts[i].Confidence,
-				AmtRawToInteger(f->touch_major) << 1,
-				AmtRawToInteger(f->touch_minor) << 1,
-				AmtRawToInteger(f->origin),
-				(UCHAR) i
+				Frame.Contacts[i].X,
+				Frame.Contacts[i].Y,
+				Frame.Contacts[i].TipSwitch,
+				Frame.Contacts[i].Confidence,
+				Frame.Contacts[i].TouchMajor,
+				Frame.Contacts[i].TouchMinor,
+				Frame.Contacts[i].ContactID
 			);
-#endif
 		}
 	}
 
-	// Type 2 touchpad contains integrated trackpad buttons
-	if (DeviceContext->IsButtonReportOn) {
-		// Handles trackpad button input here.
-		if (Buffer[DeviceContext->DeviceInfo->tp_button]) {
-			PtpReport.IsButtonClicked = TRUE;
-		}
-	}
+	// Retrieve next PTP touchpad request, or park the frame until one arrives.
+	// While reports are parked the frame queues up behind them.
+	WdfSpinLockAcquire(DeviceContext->InputLock);
 
-	// Compose final report and write it back
-	Status = WdfMemoryCopyFromBuffer(
-		RequestMemory,
-		0,
-		(PVOID) &PtpReport,
-		sizeof(PTP_REPORT)
+	AmtPtpScanClockUpdate(
+		&DeviceContext->ScanClock,
+		&Frame,
+		HostTime
 	);
 
+	AmtPtpContactTrackerUpdate(
+		&DeviceContext->ContactTracker,
+		&Frame,
+		PTP_MAX_HYBRID_CONTACT_POINTS
+	);
+
+	Status = STATUS_NO_MORE_ENTRIES;
+	if (AmtPtpReportRingCount(&DeviceContext->ReportRing) == 0) {
+		Status = WdfIoQueueRetrieveNextRequest(
+			DeviceContext->InputQueue,
+			&Request
+		);
+	}
+
 	if (!NT_SUCCESS(Status)) {
-		TraceEvents(
-			TRACE_LEVEL_ERROR,
-			TRACE_DRIVER,
-			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
-			Status
+		PushResult = AmtPtpReportRingPush(
+			&DeviceContext->ReportRing,
+			&Frame
+		);
+		ParkedFrames = AmtPtpReportRingCount(&DeviceContext->ReportRing);
+		WdfSpinLockRelease(DeviceContext->InputLock);
+
+		AmtPtpTraceRingRecord(
+			&DeviceContext->TraceRing,
+			(PushResult == AmtPtpRingPushDroppedOldest) ? AmtPtpTraceFrameDropped : AmtPtpTraceFrameParked,
+			ContactCount,
+			ParkedFrames,
+			HostTime
 		);
+
+		if (PushResult == AmtPtpRingPushDroppedOldest) {
+			AMTPTP_PERF_COUNT(&DeviceContext->PerfCounters, NoRequestDrops);
+			TraceHot(
+				TRACE_LEVEL_WARNING,
+				TRACE_DRIVER,
+				"%!FUNC! Report ring full, oldest frame dropped (%d total)",
+				DeviceContext->ReportRing.Dropped
+			);
+		} else {
+			TraceHot(
+				TRACE_LEVEL_INFORMATION,
+				TRACE_DRIVER,
+				"%!FUNC! No pending PTP request. Frame parked (%d)",
+				PushResult
+			);
+		}
+
+		AmtPtpServeParkedReports(DeviceContext);
+		Status = STATUS_SUCCESS;
 		goto exit;
 	}
 
-	// Set result
-	WdfRequestSetInformation(
-		Request,
-		sizeof(PTP_REPORT)
-	);
+	// The rest of a hybrid scan goes out with the next reads
+	if (Frame.ContactCount > PTP_MAX_CONTACT_POINTS) {
+		AmtPtpReportRingPushRemainder(
+			&DeviceContext->ReportRing,
+			&Frame,
+			PTP_MAX_CONTACT_POINTS
+		);
+	}
 
-	// Set completion flag
-	WdfRequestComplete(
+	ParkedFrames = AmtPtpReportRingCount(&DeviceContext->ReportRing);
+	WdfSpinLockRelease(DeviceContext->InputLock);
+
+	Status = AmtPtpCompleteReadReportRequest(
 		Request,
-		Status
+		&Frame,
+		Stamps
 	);
 
+	if (NT_SUCCESS(Status)) {
+		AmtPtpTraceRingRecord(
+			&DeviceContext->TraceRing,
+			AmtPtpTraceReportOut,
+			ContactCount,
+			Frame.ScanTime,
+			HostTime
+		);
+		AMTPTP_PERF_COUNT(&DeviceContext->PerfCounters, ReportsOut);
+		AmtPtpPerfCountersRecordLatency(
+			&DeviceContext->PerfCounters,
+			Stamps->RequestCompleted.QuadPart - Stamps->TransportCompleted.QuadPart,
+			DeviceContext->PerformanceFrequency.QuadPart
+		);
+	}
+
+	if (ParkedFrames != 0) {
+		AmtPtpServeParkedReports(DeviceContext);
+	}
+
 exit:
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_DRIVER,
-		"%!FUNC! Exit"
-	);
+	if (Stamps->Traced) {
+		AmtPtpTraceInputStages(
+			DeviceContext,
+			Stamps,
+			ContactCount,
+			ParkedFrames
+		);
+	}
+
 	return Status;
 
 }
 
+//
+// Writes the next report of Frame into a read request, without completing it.
+//
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
-AmtPtpServiceTouchInputInterruptType5(
-	_In_ PDEVICE_CONTEXT DeviceContext,
-	_In_ UCHAR* Buffer,
-	_In_ size_t NumBytesTransferred
+AmtPtpWriteReadReport(
+	_In_ WDFREQUEST Request,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
 )
 {
-	NTSTATUS   Status;
-	WDFREQUEST Request;
+	NTSTATUS Status;
 	WDFMEMORY  RequestMemory;
 	PTP_REPORT PtpReport;
-	UINT32 timestamp;
-
-	const struct TRACKPAD_FINGER_TYPE5* f;
-	const struct TRACKPAD_REPORT_TYPE5* report;
-
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION, 
-		TRACE_DRIVER, 
-		"%!FUNC! Entry"
-	);
-
-	Status = STATUS_SUCCESS;
-	PtpReport.ReportID = REPORTID_MULTITOUCH;
-	PtpReport.IsButtonClicked = 0;
-
-	INT x, y = 0;
-	size_t raw_n, i = 0;
-
-	Status = WdfIoQueueRetrieveNextRequest(
-		DeviceContext->InputQueue,
-		&Request
-	);
-
-	if (!NT_SUCCESS(Status)) {
-		TraceEvents(
-			TRACE_LEVEL_INFORMATION, 
-			TRACE_DRIVER, 
-			"%!FUNC! No pending PTP request. Interrupt disposed"
-		);
-		goto exit;
-	}
 
+	// Allocate output memory.
 	Status = WdfRequestRetrieveOutputMemory(
-		Request, 
+		Request,
 		&RequestMemory
 	);
-	if (!NT_SUCCESS(Status)) {
-		TraceEvents(
-			TRACE_LEVEL_ERROR, 
-			TRACE_DRIVER, 
-			"%!FUNC! WdfRequestRetrieveOutputBuffer failed with %!STATUS!", 
-			Status
-		);
-		goto exit;
-	}
-
-	report = (const struct TRACKPAD_REPORT_TYPE5*)Buffer;
 
-	// MT reports timestamps in milliseconds
-	timestamp = report->timestampLow | (report->timestampHigh << 5);
-
-	// 1 MS = 10 * 100us
-	PtpReport.ScanTime = (USHORT) (timestamp * 10);
-
-	// Type 5 finger report
-	if (DeviceContext->IsSurfaceReportOn) {
-		raw_n = (NumBytesTransferred - sizeof(struct TRACKPAD_REPORT_TYPE5)) / sizeof(struct TRACKPAD_FINGER_TYPE5);
-		if (raw_n >= PTP_MAX_CONTACT_POINTS) raw_n = PTP_MAX_CONTACT_POINTS;
-		PtpReport.ContactCount = (UCHAR)raw_n;
-
-#ifdef INPUT_CONTENT_TRACE
+	if (!NT_SUCCESS(Status)) {
 		TraceEvents(
-			TRACE_LEVEL_INFORMATION,
+			TRACE_LEVEL_ERROR,
 			TRACE_DRIVER,
-			"%!FUNC! with %llu points.",
-			raw_n
+			"%!FUNC! WdfRequestRetrieveOutputMemory failed with %!STATUS!",
+			Status
 		);
-#endif
-
-		// Fingers to array
-		for (i = 0; i < raw_n; i++) {
-			f = &report->fingers[i];
-
-			USHORT tmp_x = f->coords & 0x1fff;
-			USHORT tmp_y = (f->coords >> 13) & 0x1fff;
-			UCHAR finger = (f->coords >> 26) & 0x7;
-			UCHAR state = (f->coords >> 29) & 0x7;
-
-			x = (SHORT) (tmp_x << 3) >> 3;
-			y = -(SHORT) (tmp_y << 3) >> 3;
-
-			x = (x - DeviceContext->DeviceInfo->x.min) > 0 ? (x - DeviceContext->DeviceInfo->x.min) : 0;
-			y = (y - DeviceContext->DeviceInfo->y.min) > 0 ? (y - DeviceContext->DeviceInfo->y.min) : 0;
-
-			PtpReport.Contacts[i].ContactID = f->id;
-			PtpReport.Contacts[i].X = (USHORT) x;
-			PtpReport.Contacts[i].Y = (USHORT) y;
-			// 0x1 = Transition between states
-			// 0x2 = Floating finger?
-			// 0x4 = Valid/Has contacted the touchpad at some point in gesture?
-			// I've gotten 0x6 if I press on the trackpad and then keep my finger close
-			// Note: These values come from my MBP9,2. This logic should work there too
-			PtpReport.Contacts[i].TipSwitch = (state & 0x4) && !(state & 0x2);
-
-			// 1 = thumb, 2 = index, etc etc
-			// 6 = palm on MT2, 7 = palm on my MBP9,2?
-			PtpReport.Contacts[i].Confidence = finger != 6;
-
-#ifdef INPUT_CONTENT_TRACE
-			TraceEvents(
-				TRACE_LEVEL_INFORMATION,
-				TRACE_INPUT,
-				"%!FUNC!: Point %llu, X = %d, Y = %d, TipSwitch = %d, Confidence = %d, tMajor = %d, tMinor = %d, origin = %d",
-				i,
-				PtpReport.Contacts[i].X,
-				PtpReport.Contacts[i].Y,
-				PtpReport.Contacts[i].TipSwitch,
-				PtpReport.Contacts[i].Confidence,
-				AmtRawToInteger(f_type5->touchMajor) << 1,
-				AmtRawToInteger(f_type5->touchMinor) << 1,
-				f_type5->id
-			);
-#endif
-		}
+		return Status;
 	}
 
-	// Button
-	PtpReport.IsButtonClicked = report->button;
+	AMTPTP_COMPOSE_REPORT(Frame, &PtpReport);
 
-	// Write output
+	// Compose final report and write it back
 	Status = WdfMemoryCopyFromBuffer(
-		RequestMemory, 
-		0, 
-		(PVOID) &PtpReport, 
+		RequestMemory,
+		0,
+		(PVOID) &PtpReport,
 		sizeof(PTP_REPORT)
 	);
 
 	if (!NT_SUCCESS(Status)) {
 		TraceEvents(
-			TRACE_LEVEL_ERROR, 
-			TRACE_DRIVER, 
-			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!", 
+			TRACE_LEVEL_ERROR,
+			TRACE_DRIVER,
+			"%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!",
 			Status
 		);
-		goto exit;
+		return Status;
 	}
 
 	// Set result
 	WdfRequestSetInformation(
-		Request, 
+		Request,
 		sizeof(PTP_REPORT)
 	);
 
+	return Status;
+
+}
+
+_IRQL_requires_(PASSIVE_LEVEL)
+NTSTATUS
+AmtPtpCompleteReadReportRequest(
+	_In_ WDFREQUEST Request,
+	_In_ const AMTPTP_DECODED_FRAME* Frame,
+	_Inout_opt_ PAMTPTP_INPUT_STAMPS Stamps
+)
+{
+	NTSTATUS Status;
+
+	Status = AmtPtpWriteReadReport(
+		Request,
+		Frame
+	);
+
+	if (NT_SUCCESS(Status) && NULL != Stamps && Stamps->Traced) {
+		QueryPerformanceCounter(&Stamps->ReportComposed);
+	}
+
 	// Set completion flag
 	WdfRequestComplete(
-		Request, 
+		Request,
 		Status
 	);
 
-exit:
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION, 
-		TRACE_DRIVER, 
-		"%!FUNC! Exit"
-	);
-	return Status;
+	if (NULL != Stamps) {
+		QueryPerformanceCounter(&Stamps->RequestCompleted);
+	}
 
-}
+	return Status;
 
-// Helper function for numberic operation
-static inline INT AmtRawToInteger(
-	_In_ USHORT x
-)
-{
-	return (signed short) x;
 }
@@ -129,16 +129,19 @@ AmtPtpDeviceEvtIoDeviceControl(
 	WDFDEVICE device = WdfIoQueueGetDevice(Queue);
 	BOOLEAN requestPending = FALSE;
 
-	TraceEvents(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_QUEUE,
-		"%!FUNC!: Queue 0x%p, Request 0x%p OutputBufferLength %d InputBufferLength %d IoControlCode %d",
-		Queue, 
-		Request, 
-		(int) OutputBufferLength, 
-		(int) InputBufferLength, 
-		IoControlCode
-	);
+	// Reads come once per frame, AmtPtpDispatchReadReportRequests traces them
+	if (IoControlCode != IOCTL_HID_READ_REPORT) {
+		TraceEvents(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_QUEUE,
+			"%!FUNC!: Queue 0x%p, Request 0x%p OutputBufferLength %d InputBufferLength %d IoControlCode %d",
+			Queue, 
+			Request, 
+			(int) OutputBufferLength, 
+			(int) InputBufferLength, 
+			IoControlCode
+		);
+	}
 
 	switch (IoControlCode)
 	{
@@ -267,15 +270,59 @@ AmtPtpDispatchReadReportRequests(
 
 	NTSTATUS status;
 	PDEVICE_CONTEXT devContext;
+	AMTPTP_DECODED_FRAME frame;
+	ULONGLONG hostTime = 0;
 
 	status = STATUS_SUCCESS;
 	devContext = DeviceGetContext(Device);
 
+	// Serve a parked frame first, so nothing goes out of order
+	WdfSpinLockAcquire(devContext->InputLock);
+
+	if (AmtPtpReportRingPeek(&devContext->ReportRing, &frame)) {
+		// The frame stays parked until it made it into the request
+		status = AmtPtpWriteReadReport(
+			Request, 
+			&frame
+		);
+
+		if (NT_SUCCESS(status)) {
+			AmtPtpReportRingAdvance(
+				&devContext->ReportRing,
+				PTP_MAX_CONTACT_POINTS
+			);
+		}
+
+		WdfSpinLockRelease(devContext->InputLock);
+
+		TraceHot(
+			TRACE_LEVEL_INFORMATION, 
+			TRACE_DRIVER,
+			"%!FUNC! A report has been served from the report ring"
+		);
+
+		// The caller completes the request with status
+		if (NT_SUCCESS(status)) {
+			QueryUnbiasedInterruptTime(&hostTime);
+			AmtPtpTraceRingRecord(
+				&devContext->TraceRing,
+				AmtPtpTraceReportOut,
+				frame.ContactCount,
+				frame.ScanTime,
+				hostTime
+			);
+			AMTPTP_PERF_COUNT(&devContext->PerfCounters, ReportsOut);
+		}
+
+		return status;
+	}
+
 	status = WdfRequestForwardToIoQueue(
 		Request, 
 		devContext->InputQueue
 	);
-	
+
+	WdfSpinLockRelease(devContext->InputLock);
 
 	if (!NT_SUCCESS(status)) {
 		TraceEvents(
@@ -286,7 +333,7 @@ AmtPtpDispatchReadReportRequests(
 		);
 		return status;
 	} else {
-		TraceEvents(
+		TraceHot(
 			TRACE_LEVEL_INFORMATION, 
 			TRACE_DRIVER,
 			"%!FUNC! A report has been forwarded to input queue"
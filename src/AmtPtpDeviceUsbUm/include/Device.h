@@ -9,10 +9,12 @@ typedef struct _DEVICE_CONTEXT
 	WDFUSBPIPE                  InterruptPipe;
 	WDFUSBINTERFACE             UsbInterface;
 	WDFQUEUE                    InputQueue;
+	WDFSPINLOCK                 InputLock;
 
 	USB_DEVICE_DESCRIPTOR       DeviceDescriptor;
 
-	const struct BCM5974_CONFIG *DeviceInfo;
+	const AMTPTP_DEVICE_MODEL  *DeviceInfo;
+	AMTPTP_DECODER_CONFIG       DecoderConfig;
 
 	ULONG                       UsbDeviceTraits;
 
@@ -24,6 +26,41 @@ typedef struct _DEVICE_CONTEXT
 	BOOL                        IsSurfaceReportOn;
 	BOOL                        IsButtonReportOn;
 
+	// Frames that arrived while no read was pending, guarded by InputLock
+	AMTPTP_REPORT_RING          ReportRing;
+
+	// PTP contact IDs, scan time and malformed frames, guarded by InputLock
+	AMTPTP_CONTACT_TRACKER      ContactTracker;
+	AMTPTP_SCAN_CLOCK           ScanClock;
+	AMTPTP_ERROR_BUDGET         ErrorBudget;
+
+	// Resume phases since D0 entry, guarded by InputLock. ResumeTimer retries
+	// the mode switch when the device does not take it.
+	AMTPTP_RESUME               Resume;
+	WDFTIMER                    ResumeTimer;
+
+	// Wellspring mode transitions, guarded by ModeLock. ModeRequest carries
+	// the control transfers the engine asks for, ModeMemory wraps its block.
+	WDFSPINLOCK                 ModeLock;
+	AMTPTP_MODE_ENGINE          ModeEngine;
+	WDFREQUEST                  ModeRequest;
+	WDFMEMORY                   ModeMemory;
+
+	// Set while AmtPtpSetWellspringMode owns the engine. The asynchronous
+	// transfers stop and the last one to complete signals ModeIdleEvent.
+	BOOLEAN                     ModeSynchronous;
+	HANDLE                      ModeIdleEvent;
+
+	// QPC ticks per second for the input latency events and counters
+	LARGE_INTEGER               PerformanceFrequency;
+
+	// Input path counters, updated without a lock and read by the
+	// REPORTID_PERF_COUNTERS feature report
+	AMTPTP_PERF_COUNTERS        PerfCounters;
+
+	// Outline of the last frames, dumped to the trace when input goes wrong
+	AMTPTP_TRACE_RING           TraceRing;
+
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
 //
@@ -38,6 +75,21 @@ WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_CONTEXT, DeviceGetContext)
 //
 #define POOL_TAG_PTP_CONTROL 'PTPC'
 
+//
+// QPC stamps of one input frame. Transport and request completion feed the
+// latency counters and are always taken, the stages in between only while a
+// trace session enables AMTPTP_TRACE_KEYWORD_INPUT_LATENCY (Traced). Stages a
+// frame does not reach (e.g. it is parked in the report ring) stay zero.
+//
+typedef struct _AMTPTP_INPUT_STAMPS
+{
+	LARGE_INTEGER               TransportCompleted;
+	LARGE_INTEGER               ParseStarted;
+	LARGE_INTEGER               ReportComposed;
+	LARGE_INTEGER               RequestCompleted;
+	BOOLEAN                     Traced;
+} AMTPTP_INPUT_STAMPS, *PAMTPTP_INPUT_STAMPS;
+
 //
 // Function to initialize the device's queues and callbacks
 //
@@ -54,6 +106,7 @@ AmtPtpCreateDevice(
 EVT_WDF_DEVICE_PREPARE_HARDWARE AmtPtpEvtDevicePrepareHardware;
 EVT_WDF_DEVICE_D0_ENTRY AmtPtpEvtDeviceD0Entry;
 EVT_WDF_DEVICE_D0_EXIT AmtPtpEvtDeviceD0Exit;
+EVT_WDF_OBJECT_CONTEXT_CLEANUP AmtPtpEvtDeviceCleanup;
 
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
@@ -61,13 +114,6 @@ AmtPtpConfigContReaderForInterruptEndPoint(
 	_In_ PDEVICE_CONTEXT DeviceContext
 );
 
-_IRQL_requires_(PASSIVE_LEVEL)
-NTSTATUS
-AmtPtpGetWellspringMode(
-	_In_  PDEVICE_CONTEXT DeviceContext,
-	_Out_ BOOL* IsWellspringModeOn
-);
-
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
 SelectInterruptInterface(
@@ -81,6 +127,15 @@ AmtPtpSetWellspringMode(
 	_In_ BOOL IsWellspringModeOn
 );
 
+VOID
+AmtPtpRequestWellspringMode(
+	_In_ PDEVICE_CONTEXT DeviceContext,
+	_In_ BOOL IsWellspringModeOn
+);
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE AmtPtpModeTransferComplete;
+EVT_WDF_TIMER AmtPtpResumeTimerCallback;
+
 _IRQL_requires_(PASSIVE_LEVEL)
 PCHAR
 DbgDevicePowerString(
@@ -109,19 +164,26 @@ NTSTATUS
 AmtPtpServiceTouchInputInterrupt(
 	_In_ PDEVICE_CONTEXT DeviceContext,
 	_In_ UCHAR* Buffer,
-	_In_ size_t NumBytesTransferred
+	_In_ size_t NumBytesTransferred,
+	_Inout_ PAMTPTP_INPUT_STAMPS Stamps
 );
 
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
-AmtPtpServiceTouchInputInterruptType5(
-	_In_ PDEVICE_CONTEXT DeviceContext,
-	_In_ UCHAR* Buffer,
-	_In_ size_t NumBytesTransferred
+AmtPtpWriteReadReport(
+	_In_ WDFREQUEST Request,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
 );
 
 _IRQL_requires_(PASSIVE_LEVEL)
 NTSTATUS
+AmtPtpCompleteReadReportRequest(
+	_In_ WDFREQUEST Request,
+	_In_ const AMTPTP_DECODED_FRAME* Frame,
+	_Inout_opt_ PAMTPTP_INPUT_STAMPS Stamps
+);
+
+VOID
 AmtPtpEmergResetDevice(
 	_In_ PDEVICE_CONTEXT DeviceContext
 );
@@ -190,9 +252,4 @@ RequestGetHidXferPacketToWriteToDevice(
 	_Out_ HID_XFER_PACKET  *Packet
 );
 
-// Helper function for numberic operation
-static inline INT AmtRawToInteger(
-	_In_ USHORT x
-);
-
 EXTERN_C_END
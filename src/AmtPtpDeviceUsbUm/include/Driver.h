@@ -12,6 +12,17 @@
 #include <ModernTrace.h>
 #include <Trace.h>
 
+#include <AmtPtpDecoder.h>
+#include <AmtPtpReportRing.h>
+#include <AmtPtpContactTracker.h>
+#include <AmtPtpScanClock.h>
+#include <AmtPtpDeviceRegistry.h>
+#include <AmtPtpHidReportLayout.h>
+#include <AmtPtpModeEngine.h>
+#include <AmtPtpErrorBudget.h>
+#include <AmtPtpResume.h>
+#include <AmtPtpPerfCounters.h>
+#include <AmtPtpTraceRing.h>
 #include <AppleDefinition.h>
 #include <Hid.h>
 #include <Device.h>
@@ -5,14 +5,7 @@
 
 #include <AppleDefinition.h>
 #include <HidCommon.h>
-
-// Device family metadata
-#include "DeviceFamily/Wellspring3.h"
-#include "DeviceFamily/Wellspring5.h"
-#include "DeviceFamily/Wellspring6.h"
-#include "DeviceFamily/Wellspring7A.h"
-#include "DeviceFamily/Wellspring8.h"
-#include "DeviceFamily/WellspringMt2.h"
+#include <AmtPtpHidDescriptor.h>
 
 typedef UCHAR HID_REPORT_DESCRIPTOR, *PHID_REPORT_DESCRIPTOR;
 
@@ -94,6 +87,8 @@ typedef UCHAR HID_REPORT_DESCRIPTOR, *PHID_REPORT_DESCRIPTOR;
 	0x24, 0x8b, 0xc4, 0x43, 0xa5, 0xe5, 0x24, 0xc2
 
 #define PTP_MAX_CONTACT_POINTS 5
+// Scans with more contacts go out as several reports (hybrid mode)
+#define PTP_MAX_HYBRID_CONTACT_POINTS 16
 #define PTP_BUTTON_TYPE_CLICK_PAD 0
 #define PTP_BUTTON_TYPE_PRESSURE_PAD 1
 
@@ -167,3 +162,10 @@ typedef struct _PTP_USERMODEAPP_CONF_REPORT {
 	UCHAR		SingleContactSizeQualificationLevel;
 	UCHAR		MultipleContactSizeQualificationLevel;
 } PTP_USERMODEAPP_CONF_REPORT, *PPTP_USERMODEAPP_CONF_REPORT;
+
+#pragma pack(1)
+typedef struct _PTP_PERF_COUNTERS_REPORT {
+	UCHAR		ReportID;
+	ULONG		Counters[AMTPTP_PERF_COUNTER_COUNT];
+} PTP_PERF_COUNTERS_REPORT, *PPTP_PERF_COUNTERS_REPORT;
+#pragma pack()
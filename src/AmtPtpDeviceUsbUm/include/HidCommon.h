@@ -7,6 +7,7 @@
 #define REPORTID_FUNCSWITCH 0x06
 #define REPORTID_DEVICE_CAPS 0x07
 #define REPORTID_UMAPP_CONF  0x09
+#define REPORTID_PERF_COUNTERS 0x0a
 
 #define BUTTON_SWITCH 0x57
 #define SURFACE_SWITCH 0x58
@@ -37,3 +38,14 @@
 
 #define BEGIN_COLLECTION 0xa1
 #define END_COLLECTION   0xc0
+
+// PTP_CONTACT after tip switch and confidence: 6 bits of padding, 32-bit id
+#define AAPL_PTP_CONTACT_ID() \
+	REPORT_SIZE, 0x01, /* Report Size: 1 */ \
+	REPORT_COUNT, 0x06, /* Report Count: 6 */ \
+	INPUT, 0x03, /* Input: (Const, Var, Abs) */ \
+	REPORT_COUNT, 0x01, /* Report Count: 1 */ \
+	REPORT_SIZE, 0x20, /* Report Size: 0x20 (4 bytes) */ \
+	LOGICAL_MAXIMUM_3, 0xff, 0xff, 0xff, 0xff, /* Logical Maximum: 0xffffffff */ \
+	USAGE, 0x51, /* Usage: Contact Identifier */ \
+	INPUT, 0x02 /* Input: (Data, Var, Abs) */
@@ -26,3 +26,16 @@ EXTERN_C_END
 #define EVENT_DRIVER_FUNC_SUBTYPE_CRITFAIL	"CriticalFailure"
 #define EVENT_DEVICE_ID_SUBTYPE_NOTFOUND	"DeviceNotFoundInRegistry"
 #define EVENT_DEVICE_ID_SUBTYPE_HIDREG_NOTFOUND		"DeviceDescriptorNotFoundInRegistry"
+#define EVENT_INPUT_DIAG_SUBTYPE_STAGE_LATENCY		"StageLatency"
+
+//
+// Per-frame events are only written to sessions asking for this keyword,
+// es/analyze-input-latency.py reads them back from a CSV export
+//
+#define AMTPTP_TRACE_KEYWORD_INPUT_LATENCY	0x1
+
+#define AMTPTP_INPUT_LATENCY_ENABLED() TraceLoggingProviderEnabled( \
+	g_hAmtPtpDeviceTraceProvider, \
+	WINEVENT_LEVEL_VERBOSE, \
+	AMTPTP_TRACE_KEYWORD_INPUT_LATENCY \
+)
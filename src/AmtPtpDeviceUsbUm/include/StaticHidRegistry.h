@@ -3,43 +3,58 @@
 #ifndef _AAPL_HID_DESCRIPTOR_H_
 #define _AAPL_HID_DESCRIPTOR_H_
 
-HID_REPORT_DESCRIPTOR AmtPtp3ReportDescriptor[] = {
-	AAPL_WELLSPRING_3_PTP_TLC,
+static_assert(RTL_NUMBER_OF_FIELD(PTP_REPORT, Contacts) == AMTPTP_HID_PTP_CONTACTS, "Descriptor disagrees on PTP_REPORT contacts");
+
+static const HID_REPORT_DESCRIPTOR AmtPtp3ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_WELLSPRING3),
+	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
+	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC,
+	AMTPTP_HID_PERF_COUNTERS_TLC
+};
+
+static const HID_REPORT_DESCRIPTOR AmtPtp5ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_WELLSPRING5),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
-	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
+	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC,
+	AMTPTP_HID_PERF_COUNTERS_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtp5ReportDescriptor[] = {
-	AAPL_WELLSPRING_5_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtp6ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_WELLSPRING6),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
-	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
+	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC,
+	AMTPTP_HID_PERF_COUNTERS_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtp6ReportDescriptor[] = {
-	AAPL_WELLSPRING_6_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtp7aReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_WELLSPRING7A),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
-	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
+	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC,
+	AMTPTP_HID_PERF_COUNTERS_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtp7aReportDescriptor[] = {
-	AAPL_WELLSPRING_7A_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtp8ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_WELLSPRING8),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
-	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
+	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC,
+	AMTPTP_HID_PERF_COUNTERS_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtp8ReportDescriptor[] = {
-	AAPL_WELLSPRING_8_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtp9ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_WELLSPRING9),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
-	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
+	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC,
+	AMTPTP_HID_PERF_COUNTERS_TLC
 };
 
-HID_REPORT_DESCRIPTOR AmtPtpMt2ReportDescriptor[] = {
-	AAPL_MAGIC_TRACKPAD2_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR AmtPtpMt2ReportDescriptor[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_MAGIC_TRACKPAD2),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
-	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC
+	AAPL_PTP_USERMODE_CONFIGURATION_APP_TLC,
+	AMTPTP_HID_PERF_COUNTERS_TLC
 };
 
-HID_DESCRIPTOR AmtPtp3DefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtp3DefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -51,7 +66,7 @@ HID_DESCRIPTOR AmtPtp3DefaultHidDescriptor = {
 	},
 };
 
-HID_DESCRIPTOR AmtPtp5DefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtp5DefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -63,7 +78,7 @@ HID_DESCRIPTOR AmtPtp5DefaultHidDescriptor = {
 	},
 };
 
-HID_DESCRIPTOR AmtPtp6DefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtp6DefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -75,7 +90,7 @@ HID_DESCRIPTOR AmtPtp6DefaultHidDescriptor = {
 	},
 };
 
-HID_DESCRIPTOR AmtPtp7aDefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtp7aDefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -87,7 +102,7 @@ HID_DESCRIPTOR AmtPtp7aDefaultHidDescriptor = {
 	},
 };
 
-HID_DESCRIPTOR AmtPtp8DefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtp8DefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -99,7 +114,19 @@ HID_DESCRIPTOR AmtPtp8DefaultHidDescriptor = {
 	},
 };
 
-HID_DESCRIPTOR AmtPtpMt2DefaultHidDescriptor = {
+static const HID_DESCRIPTOR AmtPtp9DefaultHidDescriptor = {
+	0x09,   // bLength
+	0x21,   // bDescriptorType
+	0x0100, // bcdHID
+	0x00,   // bCountryCode
+	0x01,   // bNumDescriptors
+	{
+		0x22,                               // bDescriptorType
+		sizeof(AmtPtp9ReportDescriptor)    // bDescriptorLength
+	},
+};
+
+static const HID_DESCRIPTOR AmtPtpMt2DefaultHidDescriptor = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
@@ -111,4 +138,15 @@ HID_DESCRIPTOR AmtPtpMt2DefaultHidDescriptor = {
 	},
 };
 
+// Reports as this driver fills them, checked against the descriptor before it is handed out
+static const AMTPTP_HID_REPORT_SIZE AmtPtpReportSizes[] = {
+	{ AmtPtpHidReportInput,		REPORTID_MULTITOUCH,	sizeof(PTP_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_DEVICE_CAPS,	sizeof(PTP_DEVICE_CAPS_FEATURE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PTPHQA,		sizeof(PTP_DEVICE_HQA_CERTIFICATION_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_REPORTMODE,	sizeof(PTP_DEVICE_INPUT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_FUNCSWITCH,	sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_UMAPP_CONF,	sizeof(PTP_USERMODEAPP_CONF_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PERF_COUNTERS,	sizeof(PTP_PERF_COUNTERS_REPORT) },
+};
+
 #endif
@@ -37,6 +37,29 @@ DEFINE_GUID(GUID_DEVINTERFACE_AmtPtpDevice,
 #define WPP_LEVEL_FLAGS_ENABLED(lvl, flags) \
            (WPP_LEVEL_ENABLED(flags) && WPP_CONTROL(WPP_BIT_ ## flags).Level >= lvl)
 
+//
+// Per-frame call sites use TraceHot. One below AMTPTP_HOT_TRACE_LEVEL is
+// compiled out by a constant level check, so a release build neither formats
+// it nor logs it to the in-flight recorder, whatever the session asks for.
+//
+#ifndef AMTPTP_HOT_TRACE_LEVEL
+#if DBG
+#define AMTPTP_HOT_TRACE_LEVEL TRACE_LEVEL_VERBOSE
+#else
+#define AMTPTP_HOT_TRACE_LEVEL TRACE_LEVEL_WARNING
+#endif
+#endif
+
+#define WPP_HOTLEVEL_FLAGS_LOGGER(lvl, flags) \
+    WPP_LEVEL_LOGGER(flags)
+
+#define WPP_HOTLEVEL_FLAGS_ENABLED(lvl, flags) \
+    ((lvl) <= AMTPTP_HOT_TRACE_LEVEL && WPP_LEVEL_FLAGS_ENABLED(lvl, flags))
+
+#define WPP_RECORDER_HOTLEVEL_FLAGS_ARGS(lvl, flags) WPP_RECORDER_LEVEL_FLAGS_ARGS(lvl, flags)
+#define WPP_RECORDER_HOTLEVEL_FLAGS_FILTER(lvl, flags) \
+    ((lvl) <= AMTPTP_HOT_TRACE_LEVEL && WPP_RECORDER_LEVEL_FLAGS_FILTER(lvl, flags))
+
 //
 // This comment block is scanned by the trace preprocessor to define our
 // Trace function.
@@ -44,5 +67,6 @@ DEFINE_GUID(GUID_DEVINTERFACE_AmtPtpDevice,
 // begin_wpp config
 // FUNC Trace{FLAG=MYDRIVER_ALL_INFO}(LEVEL, MSG, ...);
 // FUNC TraceEvents(LEVEL, FLAGS, MSG, ...);
+// FUNC TraceHot(HOTLEVEL, FLAGS, MSG, ...);
 // end_wpp
 //
\ No newline at end of file
@@ -55,13 +55,26 @@ PtpFilterCreateDevice(
         goto exit;
     }
 
-    // Initialize read buffer
-    status = WdfLookasideListCreate(WDF_NO_OBJECT_ATTRIBUTES, REPORT_BUFFER_SIZE,
-        NonPagedPoolNx, WDF_NO_OBJECT_ATTRIBUTES, PTP_LIST_POOL_TAG,
-        &deviceContext->HidReadBufferLookaside
-    );
+    // Initialize the report ring for frames that arrive without a pending read
+    status = WdfSpinLockCreate(WDF_NO_OBJECT_ATTRIBUTES, &deviceContext->InputLock);
     if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "WdfLookasideListCreate failed: %!STATUS!", status);
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "WdfSpinLockCreate failed: %!STATUS!", status);
+        goto exit;
+    }
+
+    AmtPtpReportRingInitialize(&deviceContext->ReportRing, AMTPTP_REPORT_RING_DEFAULT_DEPTH, AmtPtpRingOverflowCoalesce);
+    AmtPtpSplitFrameInitialize(&deviceContext->SplitFrame, PTP_SPLIT_FRAME_TIMEOUT);
+    AmtPtpResumeInitialize(&deviceContext->Resume);
+    AmtPtpStatusCacheInitialize(&deviceContext->StatusCache);
+    AmtPtpPerfCountersInitialize(&deviceContext->PerfCounters);
+    AmtPtpTraceRingInitialize(&deviceContext->TraceRing);
+    KeQueryPerformanceCounter(&deviceContext->PerformanceFrequency);
+
+    // Initialize transport read pool
+    status = PtpFilterInputCreateReadPool(device, PTP_READ_POOL_DEFAULT_SIZE);
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "PtpFilterInputCreateReadPool failed: %!STATUS!", status);
+        goto exit;
     }
 
     // Initialize HID recovery timer
@@ -88,6 +101,7 @@ PtpFilterCreateDevice(
     deviceContext->VendorID = 0;
     deviceContext->ProductID = 0;
     deviceContext->VersionNumber = 0;
+    deviceContext->DeviceModel = NULL;
     deviceContext->DeviceConfigured = FALSE;
 
     // Initialize IO queue
@@ -110,6 +124,7 @@ PtpFilterPrepareHardware(
 {
     PDEVICE_CONTEXT deviceContext;
     NTSTATUS status = STATUS_SUCCESS;
+    const AMTPTP_DEVICE_MODEL* model;
     
     // We don't need to retrieve resources since this works as a filter now
     UNREFERENCED_PARAMETER(ResourceList);
@@ -123,8 +138,21 @@ PtpFilterPrepareHardware(
     deviceContext->VendorID = 0;
     deviceContext->ProductID = 0;
     deviceContext->VersionNumber = 0;
+    deviceContext->DeviceModel = NULL;
     deviceContext->DeviceConfigured = FALSE;
 
+    // Both transports deliver report 0x31, USB only prefixes it with a mouse report
+    // that the packet parser strips. Decode both with the Bluetooth layout.
+    // Tracked contacts outlive mode switches, so this is done once per start.
+    model = AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Bluetooth);
+    AmtPtpDeviceRegistryInitDecoderConfig(model, 0, &deviceContext->DecoderConfig);
+    AmtPtpContactTrackerInitialize(&deviceContext->ContactTracker, &deviceContext->DecoderConfig);
+    AmtPtpContactTrackerSetFuzz(&deviceContext->ContactTracker,
+        AMTPTP_FUZZ_FROM_SNRATIO(model->X.Min, model->X.Max, model->X.SnRatio),
+        AMTPTP_FUZZ_FROM_SNRATIO(model->Y.Min, model->Y.Max, model->Y.SnRatio));
+    AmtPtpScanClockInitialize(&deviceContext->ScanClock, AMTPTP_MT2_TIMESTAMP_MASK);
+    AmtPtpErrorBudgetInitialize(&deviceContext->ErrorBudget, AMTPTP_ERROR_BUDGET_DEFAULT_WINDOW, AMTPTP_ERROR_BUDGET_DEFAULT_LIMIT);
+
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Exit, Status = %!STATUS!", status);
     return status;
 }
@@ -135,13 +163,18 @@ PtpFilterDeviceD0Entry(
     _In_ WDF_POWER_DEVICE_STATE PreviousState
 )
 {
+    PDEVICE_CONTEXT deviceContext;
     NTSTATUS status = STATUS_SUCCESS;
 
     PAGED_CODE();
-    UNREFERENCED_PARAMETER(Device);
     UNREFERENCED_PARAMETER(PreviousState);
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Entry");
 
+    deviceContext = PtpFilterGetContext(Device);
+    WdfSpinLockAcquire(deviceContext->InputLock);
+    AmtPtpResumeBegin(&deviceContext->Resume, KeQueryInterruptTime());
+    WdfSpinLockRelease(deviceContext->InputLock);
+
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Exit, Status = %!STATUS!", status);
     return status;
 }
@@ -164,6 +197,38 @@ PtpFilterDeviceD0Exit(
 
     // Reset device state
     deviceContext->DeviceConfigured = FALSE;
+    WdfTimerStop(deviceContext->HidTransportRecoveryTimer, TRUE);
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Read pool: %d allocated, %d issued",
+        deviceContext->ReadPoolAllocations, deviceContext->ReadPoolIssued);
+
+    // Parked frames are stale once the device leaves D0
+    WdfSpinLockAcquire(deviceContext->InputLock);
+    deviceContext->RecoveryPending = FALSE;
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Report ring: %d parked, %d dropped, %d coalesced",
+        AmtPtpReportRingCount(&deviceContext->ReportRing), deviceContext->ReportRing.Dropped, deviceContext->ReportRing.Coalesced);
+    AmtPtpReportRingFlush(&deviceContext->ReportRing);
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Contact tracker: %d lift-offs, %d dropped",
+        deviceContext->ContactTracker.LiftOffs, deviceContext->ContactTracker.Dropped);
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Scan clock: %d resyncs", deviceContext->ScanClock.Resyncs);
+    AmtPtpScanClockReset(&deviceContext->ScanClock);
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Malformed frames: %d salvaged, %d dropped, %d resets, %llu ms input lost",
+        deviceContext->ErrorBudget.Salvaged, deviceContext->ErrorBudget.Dropped, deviceContext->ErrorBudget.Resets,
+        deviceContext->ErrorBudget.LostTime / 10000);
+    AmtPtpErrorBudgetReset(&deviceContext->ErrorBudget);
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Resume: configured %llu us, reads %llu us, first report %llu us (worst %llu us), %d retries",
+        AmtPtpResumeElapsed(&deviceContext->Resume, AmtPtpResumeConfigured) / 10,
+        AmtPtpResumeElapsed(&deviceContext->Resume, AmtPtpResumeReadsStarted) / 10,
+        AmtPtpResumeElapsed(&deviceContext->Resume, AmtPtpResumeFirstReport) / 10,
+        deviceContext->Resume.MaxFirstReport / 10, deviceContext->Resume.Retries);
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Status frames: %d battery, %d power-down, %d mouse, %d unknown, %d truncated",
+        deviceContext->StatusCache.Battery, deviceContext->StatusCache.PowerDowns, deviceContext->StatusCache.MouseFrames,
+        deviceContext->StatusCache.Unknowns, deviceContext->StatusCache.Truncated);
+    WdfSpinLockRelease(deviceContext->InputLock);
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Split frames: %d joined, %d orphaned, %d expired, %d abandoned, %d overflowed",
+        deviceContext->SplitFrame.Completed, deviceContext->SplitFrame.Orphaned, deviceContext->SplitFrame.Expired,
+        deviceContext->SplitFrame.Abandoned, deviceContext->SplitFrame.Overflowed);
+    AmtPtpSplitFrameReset(&deviceContext->SplitFrame);
 
     // Cancelling all outstanding requests
     while (NT_SUCCESS(status)) {
@@ -181,6 +246,32 @@ PtpFilterDeviceD0Exit(
     return STATUS_SUCCESS;
 }
 
+//
+// The device is back in multi-touch mode: reads go out right away instead of
+// waiting for the next read from hidclass.
+//
+static
+VOID
+PtpFilterStartInput(
+    _In_ WDFDEVICE Device
+)
+{
+    PDEVICE_CONTEXT deviceContext;
+
+    deviceContext = PtpFilterGetContext(Device);
+    deviceContext->DeviceConfigured = TRUE;
+
+    WdfSpinLockAcquire(deviceContext->InputLock);
+    AmtPtpResumeMark(&deviceContext->Resume, AmtPtpResumeConfigured, KeQueryInterruptTime());
+    WdfSpinLockRelease(deviceContext->InputLock);
+
+    PtpFilterInputIssueTransportRequest(Device);
+
+    WdfSpinLockAcquire(deviceContext->InputLock);
+    AmtPtpResumeMark(&deviceContext->Resume, AmtPtpResumeReadsStarted, KeQueryInterruptTime());
+    WdfSpinLockRelease(deviceContext->InputLock);
+}
+
 NTSTATUS
 PtpFilterSelfManagedIoInit(
     _In_ WDFDEVICE Device
@@ -221,20 +312,25 @@ PtpFilterSelfManagedIoInit(
     deviceContext->VendorID = deviceAttributes.VendorID;
     deviceContext->ProductID = deviceAttributes.ProductID;
     deviceContext->VersionNumber = deviceAttributes.VersionNumber;
+    deviceContext->DeviceModel = AmtPtpDeviceRegistryLookup(
+        (deviceContext->VendorID == AMTPTP_VID_APPLE_BT) ? AmtPtpBusBluetooth : AmtPtpBusUsb,
+        deviceContext->VendorID, deviceContext->ProductID);
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Device %x:%x, Version 0x%x", deviceContext->VendorID,
         deviceContext->ProductID, deviceContext->VersionNumber);
 
     status = PtpFilterConfigureMultiTouch(Device);
     if (!NT_SUCCESS(status)) {
-        // If this failed, we will retry after 2 seconds (and pretend nothing happens)
+        // If this failed, we will retry shortly (and pretend nothing happens).
+        // An unsupported device never takes the mode, so there is nothing to retry.
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! PtpFilterConfigureMultiTouch failed, Status = %!STATUS!", status);
+        if (status != STATUS_NOT_SUPPORTED) {
+            PtpFilterScheduleRecovery(deviceContext);
+        }
         status = STATUS_SUCCESS;
-        WdfTimerStart(deviceContext->HidTransportRecoveryTimer, WDF_REL_TIMEOUT_IN_SEC(2));
         goto exit;
     }
 
-    // Set device state
-    deviceContext->DeviceConfigured = TRUE;
+    PtpFilterStartInput(Device);
 
 exit:
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Exit, Status = %!STATUS!", status);
@@ -258,20 +354,22 @@ PtpFilterSelfManagedIoRestart(
         status = PtpFilterConfigureMultiTouch(Device);
         if (!NT_SUCCESS(status)) {
             TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! PtpFilterConfigureMultiTouch failed, Status = %!STATUS!", status);
-            // If this failed, we will retry after 2 seconds (and pretend nothing happens)
+            // If this failed, we will retry shortly (and pretend nothing happens).
+            // An unsupported device never takes the mode, so there is nothing to retry.
+            if (status != STATUS_NOT_SUPPORTED) {
+                PtpFilterScheduleRecovery(deviceContext);
+            }
             status = STATUS_SUCCESS;
-            WdfTimerStart(deviceContext->HidTransportRecoveryTimer, WDF_REL_TIMEOUT_IN_SEC(2));
             goto exit;
         }
+
+        PtpFilterStartInput(Device);
     }
     else {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! HID detour should already complete here");
         status = STATUS_INVALID_STATE_TRANSITION;
     }
 
-    // Set device state
-    deviceContext->DeviceConfigured = TRUE;
-
 exit:
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "%!FUNC! Exit, Status = %!STATUS!", status);
     return status;
@@ -299,12 +397,12 @@ PtpFilterConfigureMultiTouch(
     
     // Check if this device is supported for configuration.
     // So far in this prototype, we support Magic Trackpad 2 in USB (05AC:0265) or Bluetooth mode (004c:0265)
-    if (deviceContext->VendorID != HID_VID_APPLE_USB && deviceContext->VendorID != HID_VID_APPLE_BT) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! Vendor not supported: 0x%x", deviceContext->VendorID);
+    if (deviceContext->DeviceModel == NULL) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! Device not supported: %x:%x", deviceContext->VendorID, deviceContext->ProductID);
         status = STATUS_NOT_SUPPORTED;
         goto exit;
     }
-    if (deviceContext->ProductID != HID_PID_MAGIC_TRACKPAD_2) {
+    if (deviceContext->DeviceModel->Descriptor != AmtPtpReportDescriptorMagicTrackpad2) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! Product not supported: 0x%x", deviceContext->ProductID);
         status = STATUS_NOT_SUPPORTED;
         goto exit;
@@ -313,19 +411,7 @@ PtpFilterConfigureMultiTouch(
     RtlZeroMemory(hidPacketBuffer, sizeof(hidPacketBuffer));
     pHidPacket = (PHID_XFER_PACKET) &hidPacketBuffer;
 
-    if (deviceContext->VendorID == HID_VID_APPLE_USB) {
-        deviceContext->InputFingerSize = FSIZE_TYPE5;
-        deviceContext->InputHeaderSize = HOFFSET_TYPE_USB_5;
-        deviceContext->InputFingerDelta = FDELTA_TYPE5;
-        deviceContext->InputButtonDelta = BOFFSET_TYPE5;
-
-        deviceContext->X.snratio = 250;
-        deviceContext->X.min = -3678;
-        deviceContext->X.max = 3934;
-        deviceContext->Y.snratio = 250;
-        deviceContext->Y.min = -2479;
-        deviceContext->Y.max = 2586;
-
+    if (deviceContext->DeviceModel->Bus == AmtPtpBusUsb) {
         pHidPacket->reportId = 0x02;
         pHidPacket->reportBufferLen = 0x04;
         pHidPacket->reportBuffer = (PUCHAR)pHidPacket + sizeof(HID_XFER_PACKET);
@@ -334,19 +420,7 @@ PtpFilterConfigureMultiTouch(
         pHidPacket->reportBuffer[2] = 0x00;
         pHidPacket->reportBuffer[3] = 0x00;
     }
-    else if (deviceContext->VendorID == HID_VID_APPLE_BT) {
-        deviceContext->InputFingerSize = FSIZE_TYPE5;
-        deviceContext->InputHeaderSize = HOFFSET_TYPE_BTH_5;
-        deviceContext->InputFingerDelta = FDELTA_TYPE5;
-        deviceContext->InputButtonDelta = BOFFSET_TYPE5;
-
-        deviceContext->X.snratio = 250;
-        deviceContext->X.min = -3678;
-        deviceContext->X.max = 3934;
-        deviceContext->Y.snratio = 250;
-        deviceContext->Y.min = -2479;
-        deviceContext->Y.max = 2586;
-
+    else if (deviceContext->DeviceModel->Bus == AmtPtpBusBluetooth) {
         pHidPacket->reportId = 0xF1;
         pHidPacket->reportBufferLen = 0x03;
         pHidPacket->reportBuffer = (PUCHAR)pHidPacket + sizeof(HID_XFER_PACKET);
@@ -361,6 +435,9 @@ PtpFilterConfigureMultiTouch(
         goto exit;
     }
 
+    // Contacts tracked before the mode switch are gone
+    PtpFilterInputLiftContacts(deviceContext);
+
     // Init a request entity.
     // Because we bypassed HIDCLASS driver, there's a few things that we need to manually take care of.
     status = WdfRequestCreate(WDF_NO_OBJECT_ATTRIBUTES, deviceContext->HidIoTarget, &configRequest);
@@ -422,16 +499,36 @@ PtpFilterRecoveryTimerCallback(
 {
     WDFDEVICE device;
     PDEVICE_CONTEXT deviceContext;
-    NTSTATUS status;
 
     device = WdfTimerGetParentObject(Timer);
     deviceContext = PtpFilterGetContext(device);
 
-    // We will try to reinitialize the device
-    status = PtpFilterSelfManagedIoRestart(device);
-    if (NT_SUCCESS(status)) {
-        // If succeeded, proceed to reissue the request.
-        // Otherwise it will retry the process after a few seconds.
-        PtpFilterInputIssueTransportRequest(device);
+    WdfSpinLockAcquire(deviceContext->InputLock);
+    deviceContext->RecoveryPending = FALSE;
+    WdfSpinLockRelease(deviceContext->InputLock);
+
+    // We will try to reinitialize the device. Reads are reissued once it is
+    // configured, otherwise the next attempt is scheduled on the backoff.
+    PtpFilterSelfManagedIoRestart(device);
+}
+
+VOID
+PtpFilterScheduleRecovery(
+    _In_ PDEVICE_CONTEXT deviceContext
+)
+{
+    ULONG delay;
+
+    // Status frames and bad frames keep asking while reads go on, one attempt answers them all
+    WdfSpinLockAcquire(deviceContext->InputLock);
+    if (deviceContext->RecoveryPending) {
+        WdfSpinLockRelease(deviceContext->InputLock);
+        return;
     }
+    deviceContext->RecoveryPending = TRUE;
+    delay = AmtPtpResumeNextRetry(&deviceContext->Resume);
+    WdfSpinLockRelease(deviceContext->InputLock);
+
+    TraceEvents(TRACE_LEVEL_WARNING, TRACE_DEVICE, "%!FUNC! Recovery in %d ms", delay);
+    WdfTimerStart(deviceContext->HidTransportRecoveryTimer, WDF_REL_TIMEOUT_IN_MS(delay));
 }
@@ -43,10 +43,13 @@ PtpFilterDiagnosticsInputIssueRequest(
 		return;
 	}
 
-	status = WdfMemoryCreateFromLookaside(deviceContext->HidReadBufferLookaside, &hidReadOutputMemory);
+	// The buffer goes away with the request
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = hidReadRequest;
+	status = WdfMemoryCreate(&attributes, NonPagedPoolNx, PTP_LIST_POOL_TAG, REPORT_BUFFER_SIZE, &hidReadOutputMemory, NULL);
 	if (!NT_SUCCESS(status))
 	{
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! WdfMemoryCreateFromLookaside fails, status = %!STATUS!", status);
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! WdfMemoryCreate fails, status = %!STATUS!", status);
 		WdfObjectDelete(hidReadRequest);
 		WdfTimerStart(deviceContext->HidTransportRecoveryTimer, WDF_REL_TIMEOUT_IN_US(200));
 		return;
@@ -64,15 +67,7 @@ PtpFilterDiagnosticsInputIssueRequest(
 	if (!NT_SUCCESS(status))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! WdfIoTargetFormatRequestForInternalIoctl fails, status = %!STATUS!", status);
-
-		if (hidReadOutputMemory != NULL) {
-			WdfObjectDelete(hidReadOutputMemory);
-		}
-
-		if (hidReadRequest != NULL) {
-			WdfObjectDelete(hidReadRequest);
-		}
-
+		WdfObjectDelete(hidReadRequest);
 		return;
 	}
 
@@ -92,14 +87,7 @@ PtpFilterDiagnosticsInputIssueRequest(
 	{
 		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! AmtPtpSpiInputRoutineWorker request failed to sent");
 		WdfTimerStart(deviceContext->HidTransportRecoveryTimer, WDF_REL_TIMEOUT_IN_US(50));
-
-		if (hidReadOutputMemory != NULL) {
-			WdfObjectDelete(hidReadOutputMemory);
-		}
-
-		if (hidReadRequest != NULL) {
-			WdfObjectDelete(hidReadRequest);
-		}
+		WdfObjectDelete(hidReadRequest);
 	}
 }
 
@@ -128,14 +116,11 @@ PtpFilterDiagnosticsRequestCompletionRoutine(
 		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "Request received with size %d", responseLength);
 	}
 
-	// Cleanup
+	// Cleanup, the buffer is a child of the request
 	WdfObjectDelete(Request);
-	if (requestContext->RequestMemory != NULL) {
-		WdfObjectDelete(requestContext->RequestMemory);
-	}
 
 	// Issue next request
-	PtpFilterDiagnosticsInputIssueRequest(requestContext->DeviceContext->Device);
+	PtpFilterDiagnosticsInputIssueRequest(deviceContext->Device);
 }
 
 PCHAR
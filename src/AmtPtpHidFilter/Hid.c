@@ -3,6 +3,19 @@
 #include <Driver.h>
 #include "Hid.tmh"
 
+static_assert(RTL_NUMBER_OF_FIELD(PTP_REPORT, Contacts) == AMTPTP_HID_PTP_CONTACTS, "Descriptor disagrees on PTP_REPORT contacts");
+
+// Reports as this driver fills them, checked against the descriptor before it is handed out
+static const AMTPTP_HID_REPORT_SIZE PtpFilterReportSizes[] = {
+	{ AmtPtpHidReportInput,		REPORTID_MULTITOUCH,	sizeof(PTP_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_DEVICE_CAPS,	sizeof(PTP_DEVICE_CAPS_FEATURE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PTPHQA,		sizeof(PTP_DEVICE_HQA_CERTIFICATION_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_REPORTMODE,	sizeof(PTP_DEVICE_INPUT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_FUNCSWITCH,	sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_BATTERY,		sizeof(PTP_DEVICE_BATTERY_FEATURE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PERF_COUNTERS,	sizeof(PTP_PERF_COUNTERS_REPORT) },
+};
+
 NTSTATUS
 PtpFilterGetHidDescriptor(
 	_In_ WDFDEVICE Device,
@@ -14,7 +27,7 @@ PtpFilterGetHidDescriptor(
 	PDEVICE_CONTEXT deviceContext;
 	size_t			hidDescriptorSize = 0;
 	WDFMEMORY       requestMemory;
-	PHID_DESCRIPTOR pSelectedHidDescriptor = NULL;
+	const HID_DESCRIPTOR* pSelectedHidDescriptor = NULL;
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Entry");
 	deviceContext = PtpFilterGetContext(Device);
@@ -25,8 +38,8 @@ PtpFilterGetHidDescriptor(
 		goto exit;
 	}
 
-	switch (deviceContext->ProductID) {
-		case HID_PID_MAGIC_TRACKPAD_2:
+	switch (deviceContext->DeviceModel != NULL ? deviceContext->DeviceModel->Descriptor : AmtPtpReportDescriptorNone) {
+		case AmtPtpReportDescriptorMagicTrackpad2:
 		{
 			TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Request HID Report Descriptor for Apple Magic Trackpad 2 Family");
 			hidDescriptorSize = PtpDefaultHidDescriptorMagicTrackpad2.bLength;
@@ -99,7 +112,9 @@ PtpFilterGetReportDescriptor(
 	PDEVICE_CONTEXT        deviceContext;
 	size_t			       hidDescriptorSize = 0;
 	WDFMEMORY              requestMemory;
-	PHID_REPORT_DESCRIPTOR selectedHidDescriptor = NULL;
+	const HID_REPORT_DESCRIPTOR* selectedHidDescriptor = NULL;
+	AMTPTP_HID_LAYOUT_RESULT layoutResult;
+	AMTPTP_HID_REPORT_SIZE layoutMismatch = { 0 };
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Entry");
 	deviceContext = PtpFilterGetContext(Device);
@@ -110,8 +125,8 @@ PtpFilterGetReportDescriptor(
 		goto exit;
 	}
 
-	switch (deviceContext->ProductID) {
-		case HID_PID_MAGIC_TRACKPAD_2:
+	switch (deviceContext->DeviceModel != NULL ? deviceContext->DeviceModel->Descriptor : AmtPtpReportDescriptorNone) {
+		case AmtPtpReportDescriptorMagicTrackpad2:
 		{
 			hidDescriptorSize = PtpDefaultHidDescriptorMagicTrackpad2.DescriptorList[0].wReportLength;
 			selectedHidDescriptor = PtpReportDescriptorMagicTrackpad2;
@@ -120,6 +135,16 @@ PtpFilterGetReportDescriptor(
 	}
 
 	if (selectedHidDescriptor != NULL && hidDescriptorSize > 0) {
+		// hidclass sizes reports from the descriptor, a mismatch would misread every report
+		layoutResult = AmtPtpHidVerifyReportSizes(selectedHidDescriptor, (ULONG)hidDescriptorSize,
+			PtpFilterReportSizes, RTL_NUMBER_OF(PtpFilterReportSizes), &layoutMismatch);
+		if (layoutResult != AmtPtpHidLayoutOk) {
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_HID, "%!FUNC! HID report descriptor does not match the driver (%d), report %d declares %d bytes",
+				layoutResult, layoutMismatch.ReportId, layoutMismatch.Size);
+			status = STATUS_INVALID_DEVICE_STATE;
+			goto exit;
+		}
+
 		status = WdfMemoryCopyFromBuffer(requestMemory, 0, (PVOID)selectedHidDescriptor, hidDescriptorSize);
 		if (!NT_SUCCESS(status)) {
 			TraceEvents(TRACE_LEVEL_ERROR, TRACE_HID, "%!FUNC! WdfMemoryCopyFromBuffer failed with %!STATUS!", status);
@@ -219,7 +244,7 @@ PtpFilterGetHidFeatures(
 		}
 
 		PPTP_DEVICE_CAPS_FEATURE_REPORT capsReport = (PPTP_DEVICE_CAPS_FEATURE_REPORT)hidContent->reportBuffer;
-		capsReport->MaximumContactPoints = PTP_MAX_CONTACT_POINTS;
+		capsReport->MaximumContactPoints = PTP_MAX_HYBRID_CONTACT_POINTS;
 		capsReport->ButtonType = PTP_BUTTON_TYPE_CLICK_PAD;
 		capsReport->ReportID = REPORTID_DEVICE_CAPS;
 
@@ -248,6 +273,59 @@ PtpFilterGetHidFeatures(
 		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Report REPORTID_PTPHQA is fulfilled");
 		break;
 	}
+	case REPORTID_BATTERY:
+	{
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Report REPORTID_BATTERY is requested");
+
+		// Size sanity check
+		reportSize = sizeof(PTP_DEVICE_BATTERY_FEATURE_REPORT);
+		if (hidContent->reportBufferLen < reportSize) {
+			status = STATUS_INVALID_BUFFER_SIZE;
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_HID, "%!FUNC! Report buffer is too small");
+			goto exit;
+		}
+
+		// The level comes from the last status frame, there is none until the device sends one
+		PPTP_DEVICE_BATTERY_FEATURE_REPORT batteryReport = (PPTP_DEVICE_BATTERY_FEATURE_REPORT)hidContent->reportBuffer;
+		WdfSpinLockAcquire(deviceContext->InputLock);
+		if (!deviceContext->StatusCache.BatteryValid) {
+			WdfSpinLockRelease(deviceContext->InputLock);
+			status = STATUS_DEVICE_NOT_READY;
+			TraceEvents(TRACE_LEVEL_WARNING, TRACE_HID, "%!FUNC! No battery status received yet");
+			goto exit;
+		}
+		batteryReport->BatteryFlags = deviceContext->StatusCache.BatteryFlags;
+		batteryReport->ChargeStatus = deviceContext->StatusCache.BatteryLevel;
+		WdfSpinLockRelease(deviceContext->InputLock);
+		batteryReport->ReportID = REPORTID_BATTERY;
+
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Report REPORTID_BATTERY has charge status %d", batteryReport->ChargeStatus);
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Report REPORTID_BATTERY is fulfilled");
+		break;
+	}
+	case REPORTID_PERF_COUNTERS:
+	{
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Report REPORTID_PERF_COUNTERS is requested");
+
+		// Size sanity check
+		reportSize = sizeof(PTP_PERF_COUNTERS_REPORT);
+		if (hidContent->reportBufferLen < reportSize) {
+			status = STATUS_INVALID_BUFFER_SIZE;
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_HID, "%!FUNC! Report buffer is too small");
+			goto exit;
+		}
+
+		// Read as they are, the input path keeps counting meanwhile. The report
+		// is packed, so the values are staged aligned first.
+		PPTP_PERF_COUNTERS_REPORT countersReport = (PPTP_PERF_COUNTERS_REPORT)hidContent->reportBuffer;
+		ULONG counters[AMTPTP_PERF_COUNTER_COUNT];
+		AmtPtpPerfCountersSnapshot(&deviceContext->PerfCounters, counters);
+		countersReport->ReportID = REPORTID_PERF_COUNTERS;
+		RtlCopyMemory(countersReport->Counters, counters, sizeof(counters));
+
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Report REPORTID_PERF_COUNTERS is fulfilled");
+		break;
+	}
 	default:
 	{
 		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_HID, "%!FUNC! Unsupported type %d is requested", hidContent->reportId);
@@ -10,6 +10,36 @@
 #define STATUS_PTP_EXIT 3               // Exit Driver
 #define STATUS_PTP_QUEUE 4              // Requeue worker
 
+static
+NTSTATUS
+PtpFilterInputWriteReadReport(
+	_In_ WDFREQUEST ptpRequest,
+	_In_ const AMTPTP_DECODED_FRAME* frame
+);
+
+static
+NTSTATUS
+PtpFilterInputCompleteReadReport(
+	_In_ PDEVICE_CONTEXT deviceContext,
+	_In_ WDFREQUEST ptpRequest,
+	_In_ NTSTATUS writeStatus,
+	_In_ const AMTPTP_DECODED_FRAME* frame,
+	_In_ LONGLONG transferTime
+);
+
+static
+NTSTATUS
+PtpFilterInputServeParked(
+	_In_ PDEVICE_CONTEXT deviceContext
+);
+
+static
+VOID
+PtpFilterInputRetireReads(
+	_In_ PDEVICE_CONTEXT deviceContext,
+	_In_ WDFREQUEST hidReadRequest
+);
+
 VOID
 PtpFilterInputProcessRequest(
 	_In_ WDFDEVICE Device,
@@ -18,13 +48,37 @@ PtpFilterInputProcessRequest(
 {
 	NTSTATUS status;
 	PDEVICE_CONTEXT deviceContext;
+	AMTPTP_DECODED_FRAME frame;
 
 	deviceContext = PtpFilterGetContext(Device);
-	status = WdfRequestForwardToIoQueue(Request, deviceContext->HidReadQueue);
-	if (!NT_SUCCESS(status)) {
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfRequestForwardToIoQueue fails, status = %!STATUS!", status);
-		WdfRequestComplete(Request, status);
-		return;
+
+	// Serve a frame that arrived while no read was pending first, so nothing goes out of order.
+	// It stays parked until it made it into the request.
+	WdfSpinLockAcquire(deviceContext->InputLock);
+	if (AmtPtpReportRingPeek(&deviceContext->ReportRing, &frame)) {
+		status = PtpFilterInputWriteReadReport(Request, &frame);
+		if (NT_SUCCESS(status)) {
+			AmtPtpReportRingAdvance(&deviceContext->ReportRing, PTP_MAX_CONTACT_POINTS);
+		}
+		WdfSpinLockRelease(deviceContext->InputLock);
+		status = PtpFilterInputCompleteReadReport(deviceContext, Request, status, &frame, 0);
+		if (status == STATUS_PTP_EXIT) {
+			WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedNoRestart);
+			return;
+		}
+		else if (status == STATUS_PTP_RESTART) {
+			WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedAttemptRestart);
+			return;
+		}
+	}
+	else {
+		status = WdfRequestForwardToIoQueue(Request, deviceContext->HidReadQueue);
+		WdfSpinLockRelease(deviceContext->InputLock);
+		if (!NT_SUCCESS(status)) {
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfRequestForwardToIoQueue fails, status = %!STATUS!", status);
+			WdfRequestComplete(Request, status);
+			return;
+		}
 	}
 
 	// Only issue request when fully configured.
@@ -40,12 +94,15 @@ PtpFilterWorkItemCallback(
 )
 {
 	WDFDEVICE Device = WdfWorkItemGetParentObject(WorkItem);
-	PtpFilterInputIssueTransportRequest(Device);
+	if (PtpFilterGetContext(Device)->DeviceConfigured == TRUE) {
+		PtpFilterInputIssueTransportRequest(Device);
+	}
 }
 
-VOID
-PtpFilterInputIssueTransportRequest(
-	_In_ WDFDEVICE Device
+NTSTATUS
+PtpFilterInputCreateReadPool(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG PoolSize
 )
 {
 	NTSTATUS status;
@@ -53,72 +110,222 @@ PtpFilterInputIssueTransportRequest(
 
 	WDF_OBJECT_ATTRIBUTES attributes;
 	WDFREQUEST hidReadRequest;
-	WDFMEMORY hidReadOutputMemory;
 	PWORKER_REQUEST_CONTEXT requestContext;
-	BOOLEAN requestStatus = FALSE;
+	ULONG i;
 
 	deviceContext = PtpFilterGetContext(Device);
+	if (PoolSize == 0 || PoolSize > PTP_READ_POOL_MAX_SIZE) {
+		PoolSize = PTP_READ_POOL_DEFAULT_SIZE;
+	}
 
-	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, WORKER_REQUEST_CONTEXT);
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
 	attributes.ParentObject = Device;
-	status = WdfRequestCreate(&attributes, deviceContext->HidIoTarget, &hidReadRequest);
+	status = WdfSpinLockCreate(&attributes, &deviceContext->ReadPoolLock);
 	if (!NT_SUCCESS(status)) {
-		// This can fail for Bluetooth devices. We will set up a 3 second timer for retry triage.
-		// Typically this should not fail for USB transport.
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! WdfRequestCreate fails, status = %!STATUS!", status);
-		deviceContext->DeviceConfigured = FALSE;
-		WdfTimerStart(deviceContext->HidTransportRecoveryTimer, WDF_REL_TIMEOUT_IN_SEC(3));
-		return;
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfSpinLockCreate fails, status = %!STATUS!", status);
+		return status;
 	}
 
-	status = WdfMemoryCreateFromLookaside(deviceContext->HidReadBufferLookaside, &hidReadOutputMemory);
-	if (!NT_SUCCESS(status)) {
-		// tbh if you fail here, something seriously went wrong...request a restart.
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! WdfMemoryCreateFromLookaside fails, status = %!STATUS!", status);
-		WdfObjectDelete(hidReadRequest);
-		WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedAttemptRestart);
-		return;
+	// Requests and buffers are parented to the device, they go away with it
+	for (i = 0; i < PoolSize; i++) {
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, WORKER_REQUEST_CONTEXT);
+		attributes.ParentObject = Device;
+		status = WdfRequestCreate(&attributes, WdfDeviceGetIoTarget(Device), &hidReadRequest);
+		if (!NT_SUCCESS(status)) {
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfRequestCreate fails, status = %!STATUS!", status);
+			return status;
+		}
+
+		requestContext = WorkerRequestGetContext(hidReadRequest);
+		requestContext->DeviceContext = deviceContext;
+
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = hidReadRequest;
+		status = WdfMemoryCreate(&attributes, NonPagedPoolNx, PTP_LIST_POOL_TAG, REPORT_BUFFER_SIZE,
+			&requestContext->RequestMemory, NULL);
+		if (!NT_SUCCESS(status)) {
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfMemoryCreate fails, status = %!STATUS!", status);
+			WdfObjectDelete(hidReadRequest);
+			return status;
+		}
+
+		deviceContext->ReadPoolFreeList[i] = hidReadRequest;
+		deviceContext->ReadPoolAllocations++;
 	}
 
-	// Assign context information
-	// And format HID read request.
-	requestContext = WorkerRequestGetContext(hidReadRequest);
-	requestContext->DeviceContext = deviceContext;
-	requestContext->RequestMemory = hidReadOutputMemory;
-	status = WdfIoTargetFormatRequestForInternalIoctl(deviceContext->HidIoTarget, hidReadRequest,
-		IOCTL_HID_READ_REPORT, NULL, 0, hidReadOutputMemory, 0);
-	if (!NT_SUCCESS(status)) {
-		// tbh if you fail here, something seriously went wrong...request a restart.
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! WdfIoTargetFormatRequestForInternalIoctl fails, status = %!STATUS!", status);
+	deviceContext->ReadPoolSize = PoolSize;
+	deviceContext->ReadPoolFreeCount = PoolSize;
+	return STATUS_SUCCESS;
+}
+
+//
+// Keeps every pooled read in flight. Reads carry a sequence number so that
+// PtpFilterInputRetireReads can hand frames to the parser in issue order,
+// however their completion routines race each other.
+//
+VOID
+PtpFilterInputIssueTransportRequest(
+	_In_ WDFDEVICE Device
+)
+{
+	NTSTATUS status;
+	PDEVICE_CONTEXT deviceContext;
+
+	WDF_REQUEST_REUSE_PARAMS reuseParams;
+	WDFREQUEST hidReadRequest;
+	PWORKER_REQUEST_CONTEXT requestContext;
+	BOOLEAN requestStatus = FALSE;
+
+	deviceContext = PtpFilterGetContext(Device);
 
-		if (hidReadOutputMemory != NULL) {
-			WdfObjectDelete(hidReadOutputMemory);
+	for (;;) {
+		WdfSpinLockAcquire(deviceContext->ReadPoolLock);
+		if (deviceContext->ReadPoolFreeCount == 0) {
+			WdfSpinLockRelease(deviceContext->ReadPoolLock);
+			break;
 		}
 
-		if (hidReadRequest != NULL) {
-			WdfObjectDelete(hidReadRequest);
+		deviceContext->ReadPoolFreeCount--;
+		hidReadRequest = deviceContext->ReadPoolFreeList[deviceContext->ReadPoolFreeCount];
+		requestContext = WorkerRequestGetContext(hidReadRequest);
+		requestContext->Sequence = deviceContext->ReadPoolSendSequence++;
+		requestContext->Completed = FALSE;
+		requestContext->Sent = FALSE;
+		deviceContext->ReadPoolInFlight[requestContext->Sequence % PTP_READ_POOL_MAX_SIZE] = hidReadRequest;
+		deviceContext->ReadPoolIssued++;
+		WdfSpinLockRelease(deviceContext->ReadPoolLock);
+
+		// Recycle the request and format HID read request.
+		WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+		status = WdfRequestReuse(hidReadRequest, &reuseParams);
+		if (NT_SUCCESS(status)) {
+			status = WdfIoTargetFormatRequestForInternalIoctl(deviceContext->HidIoTarget, hidReadRequest,
+				IOCTL_HID_READ_REPORT, NULL, 0, requestContext->RequestMemory, 0);
 		}
 
-		WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedAttemptRestart);
-		return;
+		if (!NT_SUCCESS(status)) {
+			// tbh if you fail here, something seriously went wrong...request a restart.
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! Formatting transport read fails, status = %!STATUS!", status);
+			deviceContext->DeviceConfigured = FALSE;
+			PtpFilterInputRetireReads(deviceContext, hidReadRequest);
+			WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedAttemptRestart);
+			return;
+		}
+
+		// Set callback
+		WdfRequestSetCompletionRoutine(hidReadRequest, PtpFilterInputRequestCompletionCallback, requestContext);
+
+		requestContext->Sent = TRUE;
+		requestStatus = WdfRequestSend(hidReadRequest, deviceContext->HidIoTarget, NULL);
+		if (!requestStatus) {
+			requestContext->Sent = FALSE;
+			// Retry shortly, in case this is a transportation issue.
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! PtpFilterInputIssueTransportRequest request failed to sent");
+			deviceContext->DeviceConfigured = FALSE;
+			PtpFilterScheduleRecovery(deviceContext);
+			PtpFilterInputRetireReads(deviceContext, hidReadRequest);
+			return;
+		}
+	}
+}
+
+//
+// Writes the next report of frame into a PTP read, without completing it. The
+// caller holds InputLock, so a parked frame leaves the ring only once written.
+//
+static
+NTSTATUS
+PtpFilterInputWriteReadReport(
+	_In_ WDFREQUEST ptpRequest,
+	_In_ const AMTPTP_DECODED_FRAME* frame
+)
+{
+	NTSTATUS status;
+	WDFMEMORY  ptpRequestMemory;
+	PTP_REPORT* ptpOutputReport;
+	size_t memorySize;
+
+	status = WdfRequestRetrieveOutputMemory(ptpRequest, &ptpRequestMemory);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfRequestRetrieveOutputBuffer failed with %!STATUS!", status);
+		return status;
 	}
 
-	// Set callback
-	WdfRequestSetCompletionRoutine(hidReadRequest, PtpFilterInputRequestCompletionCallback, requestContext);
+	ptpOutputReport = WdfMemoryGetBuffer(ptpRequestMemory, &memorySize);
+	if (memorySize != sizeof(PTP_REPORT)) {
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfMemoryGetBuffer failed with incorrect size!");
+		return STATUS_INVALID_BUFFER_SIZE;
+	}
 
-	requestStatus = WdfRequestSend(hidReadRequest, deviceContext->HidIoTarget, NULL);
-	if (!requestStatus) {
-		// Retry after 3 seconds, in case this is a transportation issue.
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_DEVICE, "%!FUNC! PtpFilterInputIssueTransportRequest request failed to sent");
-		deviceContext->DeviceConfigured = FALSE;
-		WdfTimerStart(deviceContext->HidTransportRecoveryTimer, WDF_REL_TIMEOUT_IN_SEC(3));
+	// The Microsoft spec says reject any input larger than 25mm. This is not ideal
+	// for Magic Trackpad 2 - the decoder only treats palms as unconfident.
+	AMTPTP_COMPOSE_REPORT(frame, ptpOutputReport);
+
+	WdfRequestSetInformation(ptpRequest, sizeof(PTP_REPORT));
+	return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+PtpFilterInputCompleteReadReport(
+	_In_ PDEVICE_CONTEXT deviceContext,
+	_In_ WDFREQUEST ptpRequest,
+	_In_ NTSTATUS writeStatus,
+	_In_ const AMTPTP_DECODED_FRAME* frame,
+	_In_ LONGLONG transferTime
+)
+{
+	WdfRequestComplete(ptpRequest, writeStatus);
+	if (writeStatus == STATUS_INVALID_BUFFER_SIZE) {
+		return STATUS_PTP_EXIT;
+	}
+	else if (!NT_SUCCESS(writeStatus)) {
+		return STATUS_PTP_RESTART;
+	}
+
+	AmtPtpTraceRingRecord(&deviceContext->TraceRing, AmtPtpTraceReportOut, frame->ContactCount, frame->ScanTime, KeQueryInterruptTime());
 
-		if (hidReadOutputMemory != NULL) {
-			WdfObjectDelete(hidReadOutputMemory);
+	// Frames served from the report ring have no transfer time, their wait is on hidclass
+	AMTPTP_PERF_COUNT(&deviceContext->PerfCounters, ReportsOut);
+	if (transferTime != 0) {
+		AmtPtpPerfCountersRecordLatency(&deviceContext->PerfCounters,
+			KeQueryPerformanceCounter(NULL).QuadPart - transferTime, deviceContext->PerformanceFrequency.QuadPart);
+	}
+	return STATUS_PTP_GOOD;
+}
+
+//
+// Hands parked frames to reads that are already pending, oldest first. The
+// rest of a hybrid scan is parked while another read may be waiting.
+//
+static
+NTSTATUS
+PtpFilterInputServeParked(
+	_In_ PDEVICE_CONTEXT deviceContext
+)
+{
+	NTSTATUS status;
+	WDFREQUEST ptpRequest;
+	AMTPTP_DECODED_FRAME frame;
+
+	for (;;) {
+		WdfSpinLockAcquire(deviceContext->InputLock);
+		if (AmtPtpReportRingCount(&deviceContext->ReportRing) == 0 ||
+			!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(deviceContext->HidReadQueue, &ptpRequest))) {
+			WdfSpinLockRelease(deviceContext->InputLock);
+			return STATUS_PTP_GOOD;
+		}
+		AmtPtpReportRingPeek(&deviceContext->ReportRing, &frame);
+		status = PtpFilterInputWriteReadReport(ptpRequest, &frame);
+		if (NT_SUCCESS(status)) {
+			AmtPtpReportRingAdvance(&deviceContext->ReportRing, PTP_MAX_CONTACT_POINTS);
 		}
+		WdfSpinLockRelease(deviceContext->InputLock);
 
-		if (hidReadRequest != NULL) {
-			WdfObjectDelete(hidReadRequest);
+		status = PtpFilterInputCompleteReadReport(deviceContext, ptpRequest, status, &frame, 0);
+		if (status != STATUS_PTP_GOOD) {
+			return status;
 		}
 	}
 }
@@ -133,172 +340,435 @@ PtpFilterParseTouchPacket(
 	NTSTATUS status;
 
 	WDFREQUEST ptpRequest;
-	WDFMEMORY  ptpRequestMemory;
-	PTP_REPORT* ptpOutputReport;
-	PTP_CONTACT* ptpContact;
+	AMTPTP_DECODED_FRAME frame;
+	AMTPTP_FRAME_CHECK frameCheck;
+	AMTPTP_FRAME_VERDICT verdict;
+	AMTPTP_RING_PUSH_RESULT pushResult;
+	ULONG parkedFrames;
+	ULONGLONG hostTime = KeQueryInterruptTime();
+
+	AMTPTP_PERF_COUNT(&deviceContext->PerfCounters, FramesIn);
+
+	// Pre-flight check: the response size should be sane. Skip isolated bad frames,
+	// enter multitouch mode again once they keep coming.
+	frameCheck = AmtPtpDecodeFrameSalvage(&deviceContext->DecoderConfig, buffer, bufferLength, &frame);
+	WdfSpinLockAcquire(deviceContext->InputLock);
+	verdict = AmtPtpErrorBudgetRecord(&deviceContext->ErrorBudget, frameCheck, hostTime);
+	WdfSpinLockRelease(deviceContext->InputLock);
+	AmtPtpTraceRingRecord(&deviceContext->TraceRing,
+		(verdict == AmtPtpFrameDeliver) ? AmtPtpTraceFrameIn : AmtPtpTraceFrameRejected, (ULONG)bufferLength,
+		(verdict == AmtPtpFrameDeliver) ? (ULONG)frameCheck : (ULONG)verdict, hostTime);
+	if (verdict != AmtPtpFrameDeliver) {
+		AMTPTP_PERF_COUNT(&deviceContext->PerfCounters, Malformed);
+		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! Malformed input received. Length = %llu", bufferLength);
+		return (verdict == AmtPtpFrameReset) ? STATUS_PTP_SET_MODE : STATUS_PTP_QUEUE;
+	}
 
-	const TRACKPAD_REPORT_MT2* report;
-	const TRACKPAD_FINGER_MT2* f;
-	size_t raw_n;
-	size_t memorySize;
-	INT x, y = 0;
+	// Contacts go to the trace for one frame in AMTPTP_TRACE_SAMPLE_INTERVAL
+	if (AmtPtpTraceRingSample(&deviceContext->TraceRing)) {
+		TraceHot(
+			TRACE_LEVEL_VERBOSE,
+			TRACE_INPUT,
+			"%!FUNC!: New report at %d ms with %d fingers =========",
+			frame.DeviceTime,
+			frame.ContactCount
+		);
 
-	// Pre-flight check: the response size should be sane
-	if (bufferLength < sizeof(TRACKPAD_REPORT_MT2) || (bufferLength - sizeof(TRACKPAD_REPORT_MT2)) % sizeof(TRACKPAD_FINGER_MT2) != 0) {
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! Malformed input received. Length = %llu", bufferLength);
-		return STATUS_PTP_GOOD;
+		for (UCHAR i = 0; i < frame.ContactCount && i < PTP_MAX_CONTACT_POINTS; i++) {
+			TraceHot(
+				TRACE_LEVEL_VERBOSE,
+				TRACE_INPUT,
+				"%!FUNC!: Point %d, X = %d, Y = %d, Pres: %d, TipSwitch = %d, Confidence = %d, tMajor = %d, tMinor = %d, id = %d, finger = %d",
+				i,
+				frame.Contacts[i].X,
+				frame.Contacts[i].Y,
+				frame.Contacts[i].Pressure,
+				frame.Contacts[i].TipSwitch,
+				frame.Contacts[i].Confidence,
+				frame.Contacts[i].TouchMajor,
+				frame.Contacts[i].TouchMinor,
+				frame.Contacts[i].ContactID,
+				frame.Contacts[i].Finger
+			);
+		}
 	}
 
-	report = (const TRACKPAD_REPORT_MT2*)buffer;
+	// Fulfill a PTP request. If none is pending, or frames parked earlier still
+	// wait for one, park the frame behind them.
+	WdfSpinLockAcquire(deviceContext->InputLock);
+	AmtPtpResumeMark(&deviceContext->Resume, AmtPtpResumeFirstReport, hostTime);
+	AmtPtpScanClockUpdate(&deviceContext->ScanClock, &frame, hostTime);
+	AmtPtpContactTrackerUpdate(&deviceContext->ContactTracker, &frame, PTP_MAX_HYBRID_CONTACT_POINTS);
+	if (AmtPtpReportRingCount(&deviceContext->ReportRing) != 0 ||
+		!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(deviceContext->HidReadQueue, &ptpRequest))) {
+		pushResult = AmtPtpReportRingPush(&deviceContext->ReportRing, &frame);
+		parkedFrames = AmtPtpReportRingCount(&deviceContext->ReportRing);
+		WdfSpinLockRelease(deviceContext->InputLock);
+		AmtPtpTraceRingRecord(&deviceContext->TraceRing,
+			(pushResult == AmtPtpRingPushDroppedOldest) ? AmtPtpTraceFrameDropped : AmtPtpTraceFrameParked,
+			frame.ContactCount, parkedFrames, hostTime);
+		if (pushResult == AmtPtpRingPushDroppedOldest) {
+			AMTPTP_PERF_COUNT(&deviceContext->PerfCounters, NoRequestDrops);
+			TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! Report ring full, oldest frame dropped (%d total)",
+				deviceContext->ReportRing.Dropped);
+		}
+		return PtpFilterInputServeParked(deviceContext);
+	}
 
-	// Read report and fulfill PTP request. If no report is found, just exit.
-	status = WdfIoQueueRetrieveNextRequest(deviceContext->HidReadQueue, &ptpRequest);
+	// The rest of a hybrid scan goes out with the next reads. A frame that did
+	// not make it into the read is parked whole for the next one.
+	status = PtpFilterInputWriteReadReport(ptpRequest, &frame);
 	if (!NT_SUCCESS(status)) {
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfIoQueueRetrieveNextRequest failed with %!STATUS!", status);
-		return STATUS_PTP_GOOD;
+		AmtPtpReportRingPush(&deviceContext->ReportRing, &frame);
+	}
+	else if (frame.ContactCount > PTP_MAX_CONTACT_POINTS) {
+		AmtPtpReportRingPushRemainder(&deviceContext->ReportRing, &frame, PTP_MAX_CONTACT_POINTS);
 	}
 
-	status = WdfRequestRetrieveOutputMemory(ptpRequest, &ptpRequestMemory);
-	if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfRequestRetrieveOutputBuffer failed with %!STATUS!", status);
-		return STATUS_PTP_RESTART;
+	WdfSpinLockRelease(deviceContext->InputLock);
+	status = PtpFilterInputCompleteReadReport(deviceContext, ptpRequest, status, &frame,
+		deviceContext->InputTransferTime);
+	if (status != STATUS_PTP_GOOD) {
+		return status;
 	}
+	return PtpFilterInputServeParked(deviceContext);
+}
 
-	ptpOutputReport = WdfMemoryGetBuffer(ptpRequestMemory, &memorySize);
-	if (memorySize != sizeof(PTP_REPORT)) {
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! WdfMemoryGetBuffer failed with incorrect size!");
-		return STATUS_PTP_EXIT;
+//
+// Contacts still down in hidclass are lifted before the device starts over,
+// otherwise they stay stuck until the same ids show up again.
+//
+VOID
+PtpFilterInputLiftContacts(
+	_In_ PDEVICE_CONTEXT deviceContext
+)
+{
+	NTSTATUS status;
+	WDFREQUEST ptpRequest;
+	AMTPTP_DECODED_FRAME frame;
+
+	WdfSpinLockAcquire(deviceContext->InputLock);
+	AmtPtpContactTrackerLiftAll(&deviceContext->ContactTracker, &frame, PTP_MAX_HYBRID_CONTACT_POINTS);
+	if (frame.ContactCount == 0) {
+		WdfSpinLockRelease(deviceContext->InputLock);
+		return;
 	}
 
-	// Report header
-	ptpOutputReport->ReportID = REPORTID_MULTITOUCH;
-	ptpOutputReport->IsButtonClicked = report->clicks;
-	ptpOutputReport->ScanTime = (report->timestampLow | (report->timestampHigh << 5)) * 10;
-
-	// Report fingers
-	raw_n = (bufferLength - sizeof(TRACKPAD_REPORT_MT2)) / sizeof(TRACKPAD_FINGER_MT2);
-	if (raw_n >= PTP_MAX_CONTACT_POINTS) raw_n = PTP_MAX_CONTACT_POINTS;
-	ptpOutputReport->ContactCount = (UCHAR)raw_n;
-
-	TraceEvents(
-		TRACE_LEVEL_VERBOSE,
-		TRACE_INPUT,
-		"%!FUNC!: New report at %d ms with %d fingers =========",
-		ptpOutputReport->ScanTime / 10,
-		(UCHAR) raw_n
-	);
-
-	for (size_t i = 0; i < raw_n; i++) {
-		f = &report->fingers[i];
-		ptpContact = &ptpOutputReport->Contacts[i];
-
-		USHORT tmp_x = f->coords & 0x1fff;
-		USHORT tmp_y = (f->coords >> 13) & 0x1fff;
-		UCHAR finger = (f->coords >> 26) & 0x7;
-		UCHAR state = (f->coords >> 29) & 0x7;
-
-		x = (SHORT)(tmp_x << 3) >> 3;
-		y = -(SHORT)(tmp_y << 3) >> 3;
-
-		x = (x - deviceContext->X.min) > 0 ? (x - deviceContext->X.min) : 0;
-		y = (y - deviceContext->Y.min) > 0 ? (y - deviceContext->Y.min) : 0;
-
-		ptpContact->ContactID = f->id;
-		ptpContact->X = (USHORT)x;
-		ptpContact->Y = (USHORT)y;
-		ptpContact->TipSwitch = (state & 0x4) != 0 && (state & 0x2) == 0;
-		// The Microsoft spec says reject any input larger than 25mm. This is not ideal
-		// for Magic Trackpad 2 - so we raised the threshold a bit higher.
-		// Or maybe I used the wrong unit? IDK
-		ptpContact->Confidence = finger != 6;
-		
-		TraceEvents(
-			TRACE_LEVEL_VERBOSE,
-			TRACE_INPUT,
-			"%!FUNC!: Point %llu, X = %d, Y = %d, Pres: %d, Size: %d, TipSwitch = %d, Confidence = %d, tMajor = %d, tMinor = %d, id = %d, finger = %d, state = %d",
-			i,
-			ptpContact->X,
-			ptpContact->Y,
-			f->pressure,
-			f->size,
-			ptpContact->TipSwitch,
-			ptpContact->Confidence,
-			f->touchMajor,
-			f->touchMinor,
-			f->id,
-			finger,
-			state
-		);
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Lifting %d contacts", frame.ContactCount);
+	AmtPtpScanClockUpdate(&deviceContext->ScanClock, &frame, KeQueryInterruptTime());
+	if (AmtPtpReportRingCount(&deviceContext->ReportRing) != 0 ||
+		!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(deviceContext->HidReadQueue, &ptpRequest))) {
+		AmtPtpReportRingPush(&deviceContext->ReportRing, &frame);
+		WdfSpinLockRelease(deviceContext->InputLock);
+		PtpFilterInputServeParked(deviceContext);
+		return;
 	}
 
-	WdfRequestSetInformation(ptpRequest, sizeof(PTP_REPORT));
-	WdfRequestComplete(ptpRequest, status);
-	return STATUS_PTP_GOOD;
+	status = PtpFilterInputWriteReadReport(ptpRequest, &frame);
+	if (!NT_SUCCESS(status)) {
+		AmtPtpReportRingPush(&deviceContext->ReportRing, &frame);
+	}
+	else if (frame.ContactCount > PTP_MAX_CONTACT_POINTS) {
+		AmtPtpReportRingPushRemainder(&deviceContext->ReportRing, &frame, PTP_MAX_CONTACT_POINTS);
+	}
+
+	WdfSpinLockRelease(deviceContext->InputLock);
+	status = PtpFilterInputCompleteReadReport(deviceContext, ptpRequest, status, &frame, 0);
+	if (status == STATUS_PTP_EXIT) {
+		WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedNoRestart);
+	}
+	else if (status == STATUS_PTP_RESTART) {
+		WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedAttemptRestart);
+	}
+	else {
+		PtpFilterInputServeParked(deviceContext);
+	}
 }
 
+//
+// Status frames share the pipe with touch frames. They are kept for the
+// feature reports and never hold up the next read.
+//
 static
 NTSTATUS
-PtpFilterParsePacket(
+PtpFilterRecordStatusPacket(
 	_In_ PUCHAR buffer,
 	_In_ SIZE_T bufferLength,
 	_In_ PDEVICE_CONTEXT deviceContext
 )
 {
-	size_t pkt1Size, pkt2Size;
-	NTSTATUS status;
+	AMTPTP_STATUS_ACTION action;
+
+	WdfSpinLockAcquire(deviceContext->InputLock);
+	action = AmtPtpStatusFrameRecord(&deviceContext->StatusCache, buffer, bufferLength);
+	WdfSpinLockRelease(deviceContext->InputLock);
+	AmtPtpTraceRingRecord(&deviceContext->TraceRing, AmtPtpTraceStatusFrame, buffer[0], (ULONG)bufferLength, KeQueryInterruptTime());
 
-	if (bufferLength == 0) {
+	if (action == AmtPtpStatusTruncated) {
+		TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! Status Packet %x too short, length = %d", buffer[0], (int)bufferLength);
 		return STATUS_PTP_QUEUE;
 	}
 
 	switch (buffer[0]) {
 	case 0x02:
-		if (bufferLength > sizeof(TRACKPAD_MOUSE_REPORT)) {
-			return PtpFilterParsePacket(buffer + sizeof(TRACKPAD_MOUSE_REPORT), bufferLength - sizeof(TRACKPAD_MOUSE_REPORT), deviceContext);
-		}
-		else {
-			TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Mouse Packet - Setting Wellspring mode");
-			return STATUS_PTP_SET_MODE;
-		}
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Mouse Packet - Setting Wellspring mode");
+		break;
 	case 0x13:
-		// Byte 2 = 0x83
-		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Powered down (0x%x 0x%x)", buffer[1], buffer[2]);
-		return STATUS_PTP_QUEUE; // Wait for next packet
-	case 0x31:
-		return PtpFilterParseTouchPacket(buffer, bufferLength, deviceContext);
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Powered down (0x%x 0x%x)",
+			deviceContext->StatusCache.PowerDown[0], deviceContext->StatusCache.PowerDown[1]);
+		break;
+	case 0x1C:
+		TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! Unknown Packet with bytes %x %x %x",
+			deviceContext->StatusCache.Unknown[0], deviceContext->StatusCache.Unknown[1], deviceContext->StatusCache.Unknown[2]);
+		break;
 	case 0x90:
-		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Battery Percentage = %d", buffer[2]);
-		return STATUS_PTP_SET_MODE; // Sometimes sent when the trackpad is powered on
-	case 0xF7:
-		pkt1Size = buffer[1];
-		pkt2Size = bufferLength - 2 - pkt1Size;
-		status = PtpFilterParsePacket(buffer + 2, pkt1Size, deviceContext);
-		if (status == STATUS_PTP_EXIT || status == STATUS_PTP_RESTART) {
-			return status;
-		}
-		return PtpFilterParsePacket(buffer + 2 + pkt1Size, pkt2Size, deviceContext);
-	case 0xFC:
-		// First part of split packet
-		// TODO: Combine with pt2 and parse
-		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Split Packet pt1");
-		return STATUS_PTP_QUEUE;
-	case 0xFE:
-		// Second part of split packet
-		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Split Packet pt2");
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_INPUT, "%!FUNC! Battery Percentage = %d", deviceContext->StatusCache.BatteryLevel);
+		break;
+	}
+
+	return (action == AmtPtpStatusRearm) ? STATUS_PTP_SET_MODE : STATUS_PTP_QUEUE;
+}
+
+static
+NTSTATUS
+PtpFilterParseSplitFirst(
+	_In_ PUCHAR buffer,
+	_In_ SIZE_T bufferLength,
+	_In_ PDEVICE_CONTEXT deviceContext
+)
+{
+	AMTPTP_SPLIT_RESULT splitResult;
+
+	// First part of split packet, keep it until pt2 shows up
+	splitResult = AmtPtpSplitFrameFirst(&deviceContext->SplitFrame, buffer + 1, bufferLength - 1, KeQueryInterruptTime());
+	if (splitResult != AmtPtpSplitPending) {
+		TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! Split Packet pt1 dropped (%d), length = %d", splitResult, (int)bufferLength);
+	}
+	return STATUS_PTP_QUEUE;
+}
+
+static
+NTSTATUS
+PtpFilterParseSplitSecond(
+	_In_ PUCHAR buffer,
+	_In_ SIZE_T bufferLength,
+	_In_ PDEVICE_CONTEXT deviceContext
+)
+{
+	AMTPTP_SPLIT_RESULT splitResult;
+	const UCHAR* splitBuffer;
+	SIZE_T splitLength;
+
+	splitResult = AmtPtpSplitFrameSecond(&deviceContext->SplitFrame, buffer + 1, bufferLength - 1, KeQueryInterruptTime(),
+		&splitBuffer, &splitLength);
+	if (splitResult != AmtPtpSplitComplete) {
+		TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! Split Packet pt2 dropped (%d), length = %d", splitResult, (int)bufferLength);
 		return STATUS_PTP_QUEUE;
+	}
 
-		// Unknown reports!
-	case 0x1C:
-		// This seemed to kind of happen randomly
-		// Only 4 bytes long
-		TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! Unknown Packet with bytes %x %x %x", buffer[1], buffer[2], buffer[3]);
-	default:
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! Invalid Report ID %x from MT2 with length %d!", buffer[0], (int)bufferLength);
-		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! First few bytes: %x %x %x %x", buffer[1], buffer[2], buffer[3], buffer[4]);
-		// Ignore and wait for next packet
+	// Only touch frames get split. Don't demultiplex, the staging buffer would be reused.
+	if (splitBuffer[0] != 0x31) {
+		TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! Split Packet with unexpected Report ID %x", splitBuffer[0]);
 		return STATUS_PTP_QUEUE;
-	};
+	}
+
+	AMTPTP_PERF_COUNT(&deviceContext->PerfCounters, SplitMerges);
+	return PtpFilterParseTouchPacket((PUCHAR)splitBuffer, splitLength, deviceContext);
+}
+
+typedef
+NTSTATUS
+PTP_FILTER_REPORT_HANDLER(
+	_In_ PUCHAR buffer,
+	_In_ SIZE_T bufferLength,
+	_In_ PDEVICE_CONTEXT deviceContext
+);
+
+// Reports the MT2 sends, indexed by report ID
+static PTP_FILTER_REPORT_HANDLER* const PtpFilterReportHandlers[256] = {
+	[0x31] = PtpFilterParseTouchPacket,
+	[0xFC] = PtpFilterParseSplitFirst,		// First part of split packet
+	[0xFE] = PtpFilterParseSplitSecond,		// Second part of split packet
+	[0x02] = PtpFilterRecordStatusPacket,	// Mouse mode
+	[0x90] = PtpFilterRecordStatusPacket,	// Battery, sometimes sent when the trackpad is powered on
+	[0x13] = PtpFilterRecordStatusPacket,	// Powered down, byte 2 = 0x83
+	[0x1C] = PtpFilterRecordStatusPacket,	// Unknown, seemed to kind of happen randomly
+};
+
+static
+NTSTATUS
+PtpFilterDispatchReport(
+	_In_ PUCHAR report,
+	_In_ SIZE_T reportLength,
+	_In_ PDEVICE_CONTEXT deviceContext
+)
+{
+	if (PtpFilterReportHandlers[report[0]] != NULL) {
+		return PtpFilterReportHandlers[report[0]](report, reportLength, deviceContext);
+	}
+
+	// Ignore and wait for next packet
+	TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! Invalid Report ID %x from MT2 with length %d!", report[0], (int)reportLength);
+	return STATUS_PTP_QUEUE;
+}
+
+//
+// Hands every report of a transfer to its handler. SET_MODE from any of them
+// is kept, EXIT and RESTART stop at once.
+//
+static
+NTSTATUS
+PtpFilterParsePacket(
+	_In_ PUCHAR buffer,
+	_In_ SIZE_T bufferLength,
+	_In_ PDEVICE_CONTEXT deviceContext
+)
+{
+	NTSTATUS status = STATUS_PTP_QUEUE;
+	NTSTATUS reportStatus;
+	AMTPTP_PACKET_DEMUX demux;
+	AMTPTP_DEMUX_RESULT demuxResult;
+	const UCHAR* report;
+	SIZE_T reportLength;
+
+	// Most transfers hold a single report. A BT touch frame does not even need
+	// a call into the demultiplexer.
+	if (bufferLength > 0 && buffer[0] != AMTPTP_DEMUX_MOUSE && buffer[0] != AMTPTP_DEMUX_COMBINED) {
+		return PtpFilterDispatchReport(buffer, bufferLength, deviceContext);
+	}
+	if (AmtPtpPacketDemuxSingle(buffer, bufferLength, &report, &reportLength)) {
+		return PtpFilterDispatchReport((PUCHAR)report, reportLength, deviceContext);
+	}
+
+	AmtPtpPacketDemuxBegin(&demux, buffer, bufferLength);
+	for (;;) {
+		demuxResult = AmtPtpPacketDemuxNext(&demux, &report, &reportLength);
+		if (demuxResult == AmtPtpDemuxDone) {
+			break;
+		}
+
+		if (demuxResult == AmtPtpDemuxMalformed) {
+			AMTPTP_PERF_COUNT(&deviceContext->PerfCounters, Malformed);
+			TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! Malformed combined packet dropped, length = %d", (int)bufferLength);
+			continue;
+		}
+
+		reportStatus = PtpFilterDispatchReport((PUCHAR)report, reportLength, deviceContext);
+		if (reportStatus == STATUS_PTP_EXIT || reportStatus == STATUS_PTP_RESTART) {
+			return reportStatus;
+		}
+		if (reportStatus == STATUS_PTP_SET_MODE || status == STATUS_PTP_QUEUE) {
+			status = reportStatus;
+		}
+	}
+
+	return status;
+}
+
+static
+VOID
+PtpFilterInputDumpTraceRing(
+	_In_ PDEVICE_CONTEXT deviceContext
+)
+{
+	AMTPTP_TRACE_CURSOR cursor;
+	AMTPTP_TRACE_RECORD record;
+
+	AmtPtpTraceRingBegin(&deviceContext->TraceRing, &cursor);
+	while (AmtPtpTraceRingNext(&deviceContext->TraceRing, &cursor, &record)) {
+		TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! #%d %llu us %s %d %d",
+			record.Sequence, record.Time / 10, AmtPtpTraceEventName(record.Event), record.Arg0, record.Arg1);
+	}
+}
+
+//
+// Marks hidReadRequest as done, then hands every completed read to the
+// parser in issue order and puts it back on the free list. Only one caller
+// retires at a time; a read that completes meanwhile is picked up by it.
+//
+static
+VOID
+PtpFilterInputRetireReads(
+	_In_ PDEVICE_CONTEXT deviceContext,
+	_In_ WDFREQUEST hidReadRequest
+)
+{
+	NTSTATUS status;
+	NTSTATUS readStatus;
+	WDFREQUEST retiredRequest;
+	PWORKER_REQUEST_CONTEXT requestContext;
+	BOOLEAN refill = TRUE;
+
+	size_t responseLength;
+	PUCHAR responseBuffer;
+
+	WdfSpinLockAcquire(deviceContext->ReadPoolLock);
+	WorkerRequestGetContext(hidReadRequest)->Completed = TRUE;
+	if (deviceContext->ReadPoolRetiring) {
+		WdfSpinLockRelease(deviceContext->ReadPoolLock);
+		return;
+	}
+
+	deviceContext->ReadPoolRetiring = TRUE;
+	for (;;) {
+		retiredRequest = deviceContext->ReadPoolInFlight[deviceContext->ReadPoolRetireSequence % PTP_READ_POOL_MAX_SIZE];
+		if (retiredRequest == NULL || !WorkerRequestGetContext(retiredRequest)->Completed) {
+			break;
+		}
+
+		deviceContext->ReadPoolInFlight[deviceContext->ReadPoolRetireSequence % PTP_READ_POOL_MAX_SIZE] = NULL;
+		deviceContext->ReadPoolRetireSequence++;
+		WdfSpinLockRelease(deviceContext->ReadPoolLock);
+
+		requestContext = WorkerRequestGetContext(retiredRequest);
+		readStatus = requestContext->Sent ? WdfRequestGetStatus(retiredRequest) : STATUS_UNSUCCESSFUL;
+		if (!NT_SUCCESS(readStatus)) {
+			// Let the recovery work item refill the pump rather than spin on a failing target
+			TraceEvents(TRACE_LEVEL_WARNING, TRACE_INPUT, "%!FUNC! Transport read failed with %!STATUS!", readStatus);
+			status = STATUS_PTP_QUEUE;
+			refill = FALSE;
+			if (deviceContext->DeviceConfigured == TRUE) {
+				WdfWorkItemEnqueue(deviceContext->HidTransportRecoveryWorkItem);
+			}
+		}
+		else {
+			responseLength = (size_t)(LONG)WdfRequestGetInformation(retiredRequest);
+			responseBuffer = WdfMemoryGetBuffer(requestContext->RequestMemory, NULL);
+			deviceContext->InputTransferTime = requestContext->CompletedTime;
+			status = PtpFilterParsePacket(responseBuffer, responseLength, deviceContext);
+		}
+
+		// The frames leading up to a reset or failure go to the trace
+		if (status == STATUS_PTP_EXIT || status == STATUS_PTP_RESTART || status == STATUS_PTP_SET_MODE) {
+			PtpFilterInputDumpTraceRing(deviceContext);
+		}
+
+		if (status == STATUS_PTP_EXIT) {
+			refill = FALSE;
+			WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedNoRestart);
+		}
+		else if (status == STATUS_PTP_RESTART) {
+			refill = FALSE;
+			WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedAttemptRestart);
+		}
+		else if (status == STATUS_PTP_SET_MODE) {
+			// Multi-touch mode is set again from the recovery timer, reads keep going meanwhile
+			AMTPTP_PERF_COUNT(&deviceContext->PerfCounters, Resets);
+			PtpFilterScheduleRecovery(deviceContext);
+		}
+
+		// The buffer has been consumed, the read can go back to the pool
+		WdfSpinLockAcquire(deviceContext->ReadPoolLock);
+		deviceContext->ReadPoolFreeList[deviceContext->ReadPoolFreeCount] = retiredRequest;
+		deviceContext->ReadPoolFreeCount++;
+	}
+	deviceContext->ReadPoolRetiring = FALSE;
+	WdfSpinLockRelease(deviceContext->ReadPoolLock);
+
+	// Keep the transport busy
+	if (refill && deviceContext->DeviceConfigured == TRUE) {
+		PtpFilterInputIssueTransportRequest(deviceContext->Device);
+	}
 }
 
 VOID
@@ -309,46 +779,22 @@ PtpFilterInputRequestCompletionCallback(
 	_In_ WDFCONTEXT Context
 )
 {
-	NTSTATUS status;
 	PWORKER_REQUEST_CONTEXT requestContext;
 	PDEVICE_CONTEXT deviceContext;
 
-	size_t responseLength;
-	PUCHAR responseBuffer;
-
 	UNREFERENCED_PARAMETER(Target);
-	
+	UNREFERENCED_PARAMETER(Params);
+
 	requestContext = (PWORKER_REQUEST_CONTEXT)Context;
 	deviceContext = requestContext->DeviceContext;
-	responseLength = (size_t)(LONG)WdfRequestGetInformation(Request);
-	responseBuffer = WdfMemoryGetBuffer(Params->Parameters.Ioctl.Output.Buffer, NULL);
+	requestContext->CompletedTime = KeQueryPerformanceCounter(NULL).QuadPart;
 
 	// Pre-flight check 0: Right now we only have Magic Trackpad 2 (BT and USB)
-	if (deviceContext->VendorID != HID_VID_APPLE_USB && deviceContext->VendorID != HID_VID_APPLE_BT) {
+	if (deviceContext->DeviceModel == NULL) {
 		TraceEvents(TRACE_LEVEL_ERROR, TRACE_INPUT, "%!FUNC! Unsupported device entered this routine");
+		deviceContext->DeviceConfigured = FALSE;
 		WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedNoRestart);
-		goto cleanup;
-	}
-
-	status = PtpFilterParsePacket(responseBuffer, responseLength, deviceContext);
-	if (status == STATUS_PTP_EXIT) {
-		WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedNoRestart);
-	}
-	else if (status == STATUS_PTP_RESTART) {
-		WdfDeviceSetFailed(deviceContext->Device, WdfDeviceFailedAttemptRestart);
-	}
-	else if (status == STATUS_PTP_QUEUE) {
-		WdfWorkItemEnqueue(deviceContext->HidTransportRecoveryWorkItem);
-	}
-	else if (status == STATUS_PTP_SET_MODE) {
-		WdfTimerStart(deviceContext->HidTransportRecoveryTimer, WDF_REL_TIMEOUT_IN_SEC(3));
 	}
 
-
-cleanup:
-	// Cleanup
-	WdfObjectDelete(Request);
-	if (requestContext->RequestMemory != NULL) {
-		WdfObjectDelete(requestContext->RequestMemory);
-	}
+	PtpFilterInputRetireReads(deviceContext, Request);
 }
@@ -11,16 +11,12 @@ DEFINE_GUID(GUID_DEVICEINTERFACE_AmtPtpHidFilter,
 // Definition
 #define HID_XFER_PACKET_SIZE 32
 
-#define HID_VID_APPLE_USB 0x05ac
-#define HID_VID_APPLE_BT  0x004c
-#define HID_PID_MAGIC_TRACKPAD_2 0x0265
+// Transport reads are created once and recycled
+#define PTP_READ_POOL_MAX_SIZE      8
+#define PTP_READ_POOL_DEFAULT_SIZE  4
 
-/* device-specific parameters */
-typedef struct _BCM5974_PARAM {
-    int snratio;		/* signal-to-noise ratio */
-    int min;			/* device minimum reading */
-    int max;			/* device maximum reading */
-} BCM5974_PARAM, *PBCM5974_PARAM;
+// Longest gap between the two halves of a split BT frame, in 100ns units
+#define PTP_SPLIT_FRAME_TIMEOUT     (50 * 10000)
 
 // Device Context
 typedef struct _DEVICE_CONTEXT
@@ -33,15 +29,53 @@ typedef struct _DEVICE_CONTEXT
     USHORT VendorID;
     USHORT ProductID;
     USHORT VersionNumber;
-    size_t InputHeaderSize;
-    size_t InputFingerSize;
-    size_t InputFingerDelta;
-    size_t InputButtonDelta;
-    BCM5974_PARAM X;
-    BCM5974_PARAM Y;
-
-    // List of buffers
-    WDFLOOKASIDE HidReadBufferLookaside;
+    const AMTPTP_DEVICE_MODEL* DeviceModel;
+    AMTPTP_DECODER_CONFIG DecoderConfig;
+
+    // Recycled transport reads, guarded by ReadPoolLock. All of them are
+    // kept in flight and retired in the order they were sent.
+    WDFSPINLOCK ReadPoolLock;
+    WDFREQUEST  ReadPoolFreeList[PTP_READ_POOL_MAX_SIZE];
+    WDFREQUEST  ReadPoolInFlight[PTP_READ_POOL_MAX_SIZE];
+    ULONG       ReadPoolSize;
+    ULONG       ReadPoolFreeCount;
+    ULONG       ReadPoolSendSequence;
+    ULONG       ReadPoolRetireSequence;
+    BOOLEAN     ReadPoolRetiring;
+
+    // Read pool statistics
+    ULONG       ReadPoolAllocations;
+    ULONG       ReadPoolIssued;
+
+    // Frames that arrived while no PTP read was pending, guarded by InputLock
+    WDFSPINLOCK        InputLock;
+    AMTPTP_REPORT_RING ReportRing;
+
+    // PTP contact IDs, scan time and malformed frames, guarded by InputLock
+    AMTPTP_CONTACT_TRACKER ContactTracker;
+    AMTPTP_SCAN_CLOCK      ScanClock;
+    AMTPTP_ERROR_BUDGET    ErrorBudget;
+
+    // Resume phases since D0 entry and the recovery backoff, guarded by InputLock
+    AMTPTP_RESUME          Resume;
+    BOOLEAN                RecoveryPending;
+
+    // Payloads of in-band status frames, guarded by InputLock
+    AMTPTP_STATUS_CACHE    StatusCache;
+
+    // First half of a split BT frame, only touched by the read retirer
+    AMTPTP_SPLIT_FRAME SplitFrame;
+
+    // QPC of the transfer being parsed, only touched by the read retirer
+    LONGLONG           InputTransferTime;
+
+    // Input path counters, updated without a lock and read by the
+    // REPORTID_PERF_COUNTERS feature report
+    LARGE_INTEGER        PerformanceFrequency;
+    AMTPTP_PERF_COUNTERS PerfCounters;
+
+    // Outline of the last frames, dumped to the trace when input goes wrong
+    AMTPTP_TRACE_RING    TraceRing;
 
     // System HID transport
     WDFIOTARGET HidIoTarget;
@@ -64,6 +98,10 @@ WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_CONTEXT, PtpFilterGetContext)
 typedef struct _WORKER_REQUEST_CONTEXT {
     PDEVICE_CONTEXT DeviceContext;
     WDFMEMORY RequestMemory;
+    ULONG Sequence;
+    BOOLEAN Sent;
+    BOOLEAN Completed;
+    LONGLONG CompletedTime;     // QPC, taken in the completion routine
 } WORKER_REQUEST_CONTEXT, * PWORKER_REQUEST_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(WORKER_REQUEST_CONTEXT, WorkerRequestGetContext)
@@ -92,4 +130,9 @@ PtpFilterRecoveryTimerCallback(
     WDFTIMER Timer
 );
 
+VOID
+PtpFilterScheduleRecovery(
+    _In_ PDEVICE_CONTEXT deviceContext
+);
+
 EXTERN_C_END
@@ -11,6 +11,20 @@
 
 #include "Trace.h"
 
+#include <AmtPtpDecoder.h>
+#include <AmtPtpReportRing.h>
+#include <AmtPtpContactTracker.h>
+#include <AmtPtpScanClock.h>
+#include <AmtPtpErrorBudget.h>
+#include <AmtPtpResume.h>
+#include <AmtPtpStatusFrame.h>
+#include <AmtPtpPerfCounters.h>
+#include <AmtPtpTraceRing.h>
+#include <AmtPtpPacketDemux.h>
+#include <AmtPtpDeviceRegistry.h>
+#include <AmtPtpSplitFrame.h>
+#include <AmtPtpHidReportLayout.h>
+
 EXTERN_C_START
 
 // Common entry points
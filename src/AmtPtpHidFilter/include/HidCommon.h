@@ -8,6 +8,8 @@
 #define REPORTID_FUNCSWITCH 0x06
 #define REPORTID_DEVICE_CAPS 0x07
 #define REPORTID_UMAPP_CONF  0x09
+#define REPORTID_PERF_COUNTERS 0x0a
+#define REPORTID_BATTERY 0x90
 
 #define BUTTON_SWITCH 0x57
 #define SURFACE_SWITCH 0x58
@@ -39,5 +41,13 @@
 #define BEGIN_COLLECTION 0xa1
 #define END_COLLECTION   0xc0
 
+// PTP_CONTACT after tip switch and confidence: 6-bit id
+#define AAPL_PTP_CONTACT_ID() \
+	LOGICAL_MAXIMUM, 0x0f, /* Logical Maximum: 0x0f */ \
+	USAGE, 0x51, /* Usage: Contact Identifier */ \
+	REPORT_SIZE, 0x06, /* Report Size: 6 */ \
+	REPORT_COUNT, 0x01, /* Report Count: 1 */ \
+	INPUT, 0x02 /* Input: (Data, Var, Abs) */
+
 #define DEVICE_VID 0x8910
 #define DEVICE_VERSION 0x100
\ No newline at end of file
@@ -30,6 +30,19 @@ typedef struct _PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT {
 	UCHAR Padding : 6;
 } PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT, * PPTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT;
 
+// MT2 battery Feature Report, same layout as the device's report 0x90
+typedef struct _PTP_DEVICE_BATTERY_FEATURE_REPORT {
+	UCHAR ReportID;
+	UCHAR BatteryFlags;
+	UCHAR ChargeStatus;
+} PTP_DEVICE_BATTERY_FEATURE_REPORT, * PPTP_DEVICE_BATTERY_FEATURE_REPORT;
+
+// Input path counters Feature Report, see AmtPtpPerfCounters.h
+typedef struct _PTP_PERF_COUNTERS_REPORT {
+	UCHAR ReportID;
+	ULONG Counters[AMTPTP_PERF_COUNTER_COUNT];
+} PTP_PERF_COUNTERS_REPORT, * PPTP_PERF_COUNTERS_REPORT;
+
 // PTP single finger
 typedef struct _PTP_CONTACT {
 	UCHAR		Confidence : 1;
@@ -1,6 +1,12 @@
 // Input.h: Input processing and device definitions
 #pragma once
 
+NTSTATUS
+PtpFilterInputCreateReadPool(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG PoolSize
+);
+
 VOID
 PtpFilterInputProcessRequest(
 	_In_ WDFDEVICE Device,
@@ -17,6 +23,11 @@ PtpFilterInputIssueTransportRequest(
 	_In_ WDFDEVICE Device
 );
 
+VOID
+PtpFilterInputLiftContacts(
+	_In_ PDEVICE_CONTEXT deviceContext
+);
+
 VOID
 PtpFilterInputRequestCompletionCallback(
 	_In_ WDFREQUEST Request,
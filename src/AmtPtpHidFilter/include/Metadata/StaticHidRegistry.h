@@ -5,19 +5,21 @@
 
 #include <HidCommon.h>
 #include <Metadata/WindowsHID.h>
-#include <Metadata/MagicTrackpad2.h>
+#include <AmtPtpHidDescriptor.h>
 
 typedef UCHAR HID_REPORT_DESCRIPTOR, *PHID_REPORT_DESCRIPTOR;
 
 #ifndef _STATIC_HID_REGISTRY_H_
 #define _STATIC_HID_REGISTRY_H_
 
-static HID_REPORT_DESCRIPTOR PtpReportDescriptorMagicTrackpad2[] = {
-	AAPL_MAGIC_TRACKPAD2_PTP_TLC,
+static const HID_REPORT_DESCRIPTOR PtpReportDescriptorMagicTrackpad2[] = {
+	AMTPTP_HID_PTP_TLC(AMTPTP_HID_TOUCH_PAD, AAPL_PTP_CONTACT_ID, AMTPTP_GEOMETRY_MAGIC_TRACKPAD2),
 	AAPL_PTP_WINDOWS_CONFIGURATION_TLC,
+	AAPL_MT2_BATTERY_TLC,
+	AMTPTP_HID_PERF_COUNTERS_TLC,
 };
 
-static HID_DESCRIPTOR PtpDefaultHidDescriptorMagicTrackpad2 = {
+static const HID_DESCRIPTOR PtpDefaultHidDescriptorMagicTrackpad2 = {
 	0x09,   // bLength
 	0x21,   // bDescriptorType
 	0x0100, // bcdHID
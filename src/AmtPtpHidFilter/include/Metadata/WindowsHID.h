@@ -4,6 +4,8 @@
 #define MAX_FINGERS 16
 
 #define PTP_MAX_CONTACT_POINTS 5
+// Scans with more contacts go out as several reports (hybrid mode)
+#define PTP_MAX_HYBRID_CONTACT_POINTS 16
 #define PTP_BUTTON_TYPE_CLICK_PAD 0
 #define PTP_BUTTON_TYPE_PRESSURE_PAD 1
 
@@ -26,6 +28,19 @@
 		FEATURE, 0x02, /* Feature: (Data, Var, Abs) */ \
 	END_COLLECTION
 
+#define AAPL_MT2_BATTERY_TLC \
+	USAGE_PAGE_1, 0x00, 0xff, /* Usage Page: Vendor defined */ \
+	USAGE, 0x14, /* Usage: Vendor Usage 0x14, as the device's battery collection */ \
+	BEGIN_COLLECTION, 0x01, /* Begin Collection: Application */ \
+		REPORT_ID, REPORTID_BATTERY, /* Report ID: Battery */ \
+		USAGE, 0x14, /* Usage: Vendor Usage 0x14 */ \
+		LOGICAL_MINIMUM, 0x00, /* Logical Minimum 0 */ \
+		LOGICAL_MAXIMUM_2, 0xff, 0x00, /* Logical Maximum 255 */ \
+		REPORT_SIZE, 0x08, /* Report Size: 8 */ \
+		REPORT_COUNT, 0x02, /* Report Count: 2 (flags, percentage) */ \
+		FEATURE, 0x02, /* Feature: (Data, Var, Abs) */ \
+	END_COLLECTION
+
 #define AAPL_PTP_WINDOWS_CONFIGURATION_TLC \
 	USAGE_PAGE, 0x0d, /* Usage Page: Digitizer */ \
 	USAGE, 0x0e, /* Usage: Configuration */ \
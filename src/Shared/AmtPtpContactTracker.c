@@ -0,0 +1,264 @@
+// AmtPtpContactTracker.c: Stable PTP contact IDs across frames
+
+#include <AmtPtpContactTracker.h>
+
+#define AMTPTP_TRACKER_NO_SLOT 0xFF
+
+VOID
+AmtPtpContactTrackerInitialize(
+	_Out_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_In_ const AMTPTP_DECODER_CONFIG* Config
+)
+{
+	LONG range;
+
+	RtlZeroMemory(Tracker, sizeof(AMTPTP_CONTACT_TRACKER));
+	Tracker->MatchByPosition = (Config->Flags & AMTPTP_DECODER_FLAG_CONTACT_ID_FROM_SLOT) ||
+		Config->Format == AmtPtpFrameFormatSpi;
+
+	// A finger does not travel more than an eighth of the surface between two frames
+	range = Config->XMax - Config->XMin;
+	if (Config->YMax - Config->YMin > range) range = Config->YMax - Config->YMin;
+	if (range <= 0) range = 8000;
+
+	Tracker->MatchDistance = (ULONGLONG) (range / 8) * (ULONGLONG) (range / 8);
+}
+
+VOID
+AmtPtpContactTrackerSetFuzz(
+	_Inout_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_In_ USHORT XFuzz,
+	_In_ USHORT YFuzz
+)
+{
+	Tracker->XFuzz = XFuzz;
+	Tracker->YFuzz = YFuzz;
+}
+
+// Same steps as input_defuzz_abs_event in Linux
+static __inline USHORT
+AmtPtpContactTrackerDefuzz(
+	_In_ USHORT Value,
+	_In_ USHORT Old,
+	_In_ USHORT Fuzz
+)
+{
+	LONG delta = (LONG) Value - Old;
+	if (delta < 0) delta = -delta;
+
+	if (Fuzz == 0) return Value;
+	if (delta < Fuzz / 2) return Old;
+	if (delta < Fuzz) return (USHORT) (((ULONG) Old * 3 + Value) / 4);
+	if (delta < Fuzz * 2) return (USHORT) (((ULONG) Old + Value) / 2);
+	return Value;
+}
+
+static UCHAR
+AmtPtpContactTrackerMatch(
+	_In_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_In_ const AMTPTP_DECODED_CONTACT* Contact
+)
+{
+	UCHAR best = AMTPTP_TRACKER_NO_SLOT;
+	ULONGLONG bestDistance = 0;
+	UCHAR i;
+
+	for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+		PAMTPTP_TRACKED_CONTACT slot = &Tracker->Contacts[i];
+		LONGLONG dx, dy;
+		ULONGLONG distance;
+
+		if (!slot->InUse || slot->Seen) {
+			continue;
+		}
+
+		if (!Tracker->MatchByPosition) {
+			// A lifted id that touches down again is a new contact
+			if (slot->Last.ContactID == Contact->ContactID &&
+				!(slot->Reported && !slot->Last.TipSwitch && Contact->TipSwitch)) {
+				return i;
+			}
+			continue;
+		}
+
+		dx = (LONGLONG) slot->Last.X - Contact->X;
+		dy = (LONGLONG) slot->Last.Y - Contact->Y;
+		distance = (ULONGLONG) (dx * dx + dy * dy);
+		if (distance <= Tracker->MatchDistance && (best == AMTPTP_TRACKER_NO_SLOT || distance < bestDistance)) {
+			best = i;
+			bestDistance = distance;
+		}
+	}
+
+	return best;
+}
+
+VOID
+AmtPtpContactTrackerUpdate(
+	_Inout_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_Inout_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ UCHAR MaxContacts
+)
+{
+	// Raw contacts plus the lift-offs of every tracked contact
+	AMTPTP_DECODED_CONTACT candidates[AMTPTP_DECODER_MAX_CONTACTS * 2];
+	UCHAR candidateSlot[AMTPTP_DECODER_MAX_CONTACTS * 2];
+	UCHAR candidateRank[AMTPTP_DECODER_MAX_CONTACTS * 2];
+	BOOLEAN candidateLift[AMTPTP_DECODER_MAX_CONTACTS * 2];
+	UCHAR rawSlot[AMTPTP_DECODER_MAX_CONTACTS];
+	UCHAR candidateCount = 0;
+	USHORT usedIds = 0;
+	UCHAR i, j;
+
+	if (MaxContacts > AMTPTP_DECODER_MAX_CONTACTS) MaxContacts = AMTPTP_DECODER_MAX_CONTACTS;
+
+	for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+		Tracker->Contacts[i].Seen = FALSE;
+	}
+
+	// Pair raw contacts with what was tracked in the previous frame
+	for (i = 0; i < Frame->ContactCount; i++) {
+		rawSlot[i] = AmtPtpContactTrackerMatch(Tracker, &Frame->Contacts[i]);
+		if (rawSlot[i] != AMTPTP_TRACKER_NO_SLOT) {
+			PAMTPTP_TRACKED_CONTACT slot = &Tracker->Contacts[rawSlot[i]];
+			slot->Seen = TRUE;
+			usedIds |= 1 << slot->Id;
+
+			// Last holds the defuzzed position reported for the previous frame
+			Frame->Contacts[i].X = AmtPtpContactTrackerDefuzz(Frame->Contacts[i].X, slot->Last.X, Tracker->XFuzz);
+			Frame->Contacts[i].Y = AmtPtpContactTrackerDefuzz(Frame->Contacts[i].Y, slot->Last.Y, Tracker->YFuzz);
+		}
+	}
+
+	// Retire vanished contacts. Hidclass saw them down, so tell it they are up.
+	// Such a contact keeps its slot until its lift-off went out.
+	for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+		PAMTPTP_TRACKED_CONTACT slot = &Tracker->Contacts[i];
+		if (!slot->InUse || slot->Seen) {
+			continue;
+		}
+
+		usedIds |= 1 << slot->Id;
+		if (slot->Reported && slot->Last.TipSwitch) {
+			candidates[candidateCount] = slot->Last;
+			candidates[candidateCount].ContactID = slot->Id;
+			candidates[candidateCount].TipSwitch = FALSE;
+			candidateSlot[candidateCount] = i;
+			candidateRank[candidateCount] = 4;
+			candidateLift[candidateCount] = TRUE;
+			candidateCount++;
+			continue;
+		}
+		slot->InUse = FALSE;
+	}
+
+	// Hand out IDs to new contacts, lowest free ID first
+	for (i = 0; i < Frame->ContactCount; i++) {
+		if (rawSlot[i] != AMTPTP_TRACKER_NO_SLOT) {
+			continue;
+		}
+
+		for (j = 0; j < AMTPTP_DECODER_MAX_CONTACTS && Tracker->Contacts[j].InUse; j++);
+		if (j == AMTPTP_DECODER_MAX_CONTACTS || usedIds == (1 << AMTPTP_TRACKER_MAX_IDS) - 1) {
+			// Out of IDs, try again on the next frame
+			continue;
+		}
+
+		RtlZeroMemory(&Tracker->Contacts[j], sizeof(AMTPTP_TRACKED_CONTACT));
+		Tracker->Contacts[j].InUse = TRUE;
+		Tracker->Contacts[j].Seen = TRUE;
+		while (usedIds & (1 << Tracker->Contacts[j].Id)) Tracker->Contacts[j].Id++;
+		usedIds |= 1 << Tracker->Contacts[j].Id;
+		rawSlot[i] = j;
+	}
+
+	// Rank: contacts hidclass is tracking, then tip-down, then confident
+	for (i = 0; i < Frame->ContactCount; i++) {
+		PAMTPTP_TRACKED_CONTACT slot;
+		if (rawSlot[i] == AMTPTP_TRACKER_NO_SLOT) {
+			Tracker->Dropped++;
+			continue;
+		}
+
+		slot = &Tracker->Contacts[rawSlot[i]];
+		candidates[candidateCount] = Frame->Contacts[i];
+		candidates[candidateCount].ContactID = slot->Id;
+		candidateSlot[candidateCount] = rawSlot[i];
+		candidateRank[candidateCount] = (UCHAR) (((slot->Reported && slot->Last.TipSwitch) ? 4 : 0) |
+			(Frame->Contacts[i].TipSwitch ? 2 : 0) | (Frame->Contacts[i].Confidence ? 1 : 0));
+		candidateLift[candidateCount] = FALSE;
+		candidateCount++;
+
+		slot->Last = Frame->Contacts[i];
+		slot->Reported = FALSE;
+	}
+
+	// Stable insertion sort by rank, the frame order breaks ties
+	for (i = 1; i < candidateCount; i++) {
+		AMTPTP_DECODED_CONTACT contact = candidates[i];
+		UCHAR contactSlot = candidateSlot[i], rank = candidateRank[i];
+		BOOLEAN lift = candidateLift[i];
+
+		for (j = i; j > 0 && candidateRank[j - 1] < rank; j--) {
+			candidates[j] = candidates[j - 1];
+			candidateSlot[j] = candidateSlot[j - 1];
+			candidateRank[j] = candidateRank[j - 1];
+			candidateLift[j] = candidateLift[j - 1];
+		}
+		candidates[j] = contact;
+		candidateSlot[j] = contactSlot;
+		candidateRank[j] = rank;
+		candidateLift[j] = lift;
+	}
+
+	// Contacts hidclass has down and the cap leaves out stay down for it, so
+	// a later update still lifts them
+	for (i = MaxContacts; i < candidateCount; i++) {
+		PAMTPTP_TRACKED_CONTACT slot = &Tracker->Contacts[candidateSlot[i]];
+
+		Tracker->Dropped++;
+		if ((candidateRank[i] & 4) && !candidateLift[i]) {
+			slot->Reported = TRUE;
+			slot->Last.TipSwitch = TRUE;
+		}
+	}
+	if (candidateCount > MaxContacts) {
+		candidateCount = MaxContacts;
+	}
+
+	for (i = 0; i < candidateCount; i++) {
+		if (candidateLift[i]) {
+			Tracker->Contacts[candidateSlot[i]].InUse = FALSE;
+			Tracker->LiftOffs++;
+		}
+		else {
+			Tracker->Contacts[candidateSlot[i]].Reported = TRUE;
+		}
+		Frame->Contacts[i] = candidates[i];
+	}
+	Frame->ContactCount = candidateCount;
+}
+
+VOID
+AmtPtpContactTrackerLiftAll(
+	_Inout_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_Out_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ UCHAR MaxContacts
+)
+{
+	// Nothing is seen in an empty frame, so every contact is retired
+	RtlZeroMemory(Frame, sizeof(AMTPTP_DECODED_FRAME));
+	AmtPtpContactTrackerUpdate(Tracker, Frame, MaxContacts);
+}
+
+VOID
+AmtPtpContactTrackerReset(
+	_Inout_ PAMTPTP_CONTACT_TRACKER Tracker
+)
+{
+	UCHAR i;
+
+	for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+		Tracker->Contacts[i].InUse = FALSE;
+	}
+}
@@ -0,0 +1,645 @@
+// AmtPtpDecoder.c: Transport independent touch frame decoding
+
+#include <AmtPtpDecoder.h>
+
+// Vector variants of AmtPtpUnpackMt2Fingers. Kernel mode on x64 may use the
+// XMM registers freely, but the upper YMM halves are only saved around
+// KeSaveExtendedProcessorState, so AVX2 is left to the UMDF driver.
+#if defined(_M_X64) || defined(__x86_64__)
+#define AMTPTP_UNPACK_SSE41
+#if !defined(_KERNEL_MODE)
+#define AMTPTP_UNPACK_AVX2
+#endif
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define AMTPTP_UNPACK_NEON
+#include <arm_neon.h>
+#endif
+
+// gcc and clang only emit instructions beyond the build target in functions
+// marked for them, MSVC emits any intrinsic
+#if defined(__GNUC__)
+#define AMTPTP_TARGET(Isa) __attribute__((target(Isa)))
+#else
+#define AMTPTP_TARGET(Isa)
+#endif
+
+// Helper function for numeric operation
+static __inline LONG
+AmtPtpClampToUShort(
+	_In_ LONG Value
+)
+{
+	if (Value < 0) return 0;
+	if (Value > 0xFFFF) return 0xFFFF;
+	return Value;
+}
+
+//
+// Wellspring decoding with the layout passed in separately from Config. The
+// specialized decoders below pass constants, so the compiler folds the stride
+// and offsets into the inlined copy.
+//
+static __forceinline AMTPTP_DECODE_RESULT
+AmtPtpDecodeWellspringLayout(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ SIZE_T HeaderSize,
+	_In_ SIZE_T FingerSize,
+	_In_ SIZE_T ButtonOffset
+)
+{
+	const UCHAR* f;
+	SIZE_T fingerOffset;
+	SIZE_T raw_n, i;
+
+	RtlZeroMemory(Frame, sizeof(AMTPTP_DECODED_FRAME));
+
+	if (Length < HeaderSize || FingerSize < AMTPTP_WELLSPRING_FINGER_MIN_SIZE ||
+		(Length - HeaderSize) % FingerSize != 0) {
+		return AmtPtpDecodeMalformed;
+	}
+
+	// MS Timestamp is reported in bytes 4-7, only the low byte is used
+	if (Length > AMTPTP_WELLSPRING_TIMESTAMP_OFFSET) {
+		Frame->DeviceTime = Buffer[AMTPTP_WELLSPRING_TIMESTAMP_OFFSET];
+		Frame->HasDeviceTime = TRUE;
+	}
+
+	if (ButtonOffset < Length && Buffer[ButtonOffset]) {
+		Frame->IsButtonClicked = TRUE;
+	}
+
+	// Some devices report where the finger block starts, others have it at a fixed offset
+	fingerOffset = (Config->Flags & AMTPTP_DECODER_FLAG_FINGER_OFFSET_IN_FRAME) && Length > 2 ?
+		Buffer[2] : Config->FingerOffset;
+
+	raw_n = (Length - HeaderSize) / FingerSize;
+	if (raw_n > AMTPTP_DECODER_MAX_CONTACTS) raw_n = AMTPTP_DECODER_MAX_CONTACTS;
+
+	// Never read a finger record past the end of the frame
+	while (raw_n > 0 && fingerOffset + (raw_n - 1) * FingerSize + AMTPTP_WELLSPRING_FINGER_MIN_SIZE > Length) {
+		raw_n--;
+	}
+
+	for (i = 0; i < raw_n; i++) {
+		PAMTPTP_DECODED_CONTACT contact = &Frame->Contacts[i];
+		SHORT touchMajor, touchMinor;
+
+		f = Buffer + fingerOffset + i * FingerSize;
+		touchMajor = (SHORT) AMTPTP_READ_LE16(f + AMTPTP_WELLSPRING_FINGER_TOUCH_MAJOR);
+		touchMinor = (SHORT) AMTPTP_READ_LE16(f + AMTPTP_WELLSPRING_FINGER_TOUCH_MINOR);
+
+		// Translate X and Y
+		contact->X = (USHORT) AmtPtpClampToUShort((SHORT) AMTPTP_READ_LE16(f + AMTPTP_WELLSPRING_FINGER_ABS_X) - Config->XMin);
+		contact->Y = (USHORT) AmtPtpClampToUShort(Config->YMax - (SHORT) AMTPTP_READ_LE16(f + AMTPTP_WELLSPRING_FINGER_ABS_Y));
+		contact->TouchMajor = (USHORT) AmtPtpClampToUShort(touchMajor * 2);
+		contact->TouchMinor = (USHORT) AmtPtpClampToUShort(touchMinor * 2);
+		contact->Pressure = AMTPTP_READ_LE16(f + AMTPTP_WELLSPRING_FINGER_PRESSURE);
+		contact->Finger = f[AMTPTP_WELLSPRING_FINGER_CLASS];
+		contact->ContactID = (Config->Flags & AMTPTP_DECODER_FLAG_CONTACT_ID_FROM_SLOT) ?
+			(UCHAR) i : f[AMTPTP_WELLSPRING_FINGER_ID];
+
+		if (Config->Flags & AMTPTP_DECODER_FLAG_TIP_FROM_TOUCH_AREA) {
+			contact->TipSwitch = (touchMajor * 2) >= 200 || (touchMinor * 2) >= 150;
+			contact->Confidence = (touchMinor * 2) > 0;
+		} else {
+			UCHAR state = f[AMTPTP_WELLSPRING_FINGER_STATE];
+			contact->TipSwitch = (state & 0x4) && !(state & 0x2);
+			contact->Confidence = (contact->Finger != 6 && contact->Finger != 7);
+		}
+	}
+
+	Frame->ContactCount = (UCHAR) raw_n;
+	return AmtPtpDecodeOk;
+}
+
+AMTPTP_DECODE_RESULT
+AmtPtpDecodeWellspringFrame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	return AmtPtpDecodeWellspringLayout(Config, Buffer, Length, Frame,
+		Config->HeaderSize, Config->FingerSize, Config->ButtonOffset);
+}
+
+#define AMTPTP_DEFINE_WELLSPRING_DECODER(Type) \
+	static AMTPTP_DECODE_RESULT \
+	AmtPtpDecodeWellspring##Type##Frame( \
+		_In_ const AMTPTP_DECODER_CONFIG* Config, \
+		_In_reads_bytes_(Length) const UCHAR* Buffer, \
+		_In_ SIZE_T Length, \
+		_Out_ PAMTPTP_DECODED_FRAME Frame \
+	) \
+	{ \
+		return AmtPtpDecodeWellspringLayout(Config, Buffer, Length, Frame, \
+			AMTPTP_WELLSPRING_##Type##_HEADER_SIZE, AMTPTP_WELLSPRING_##Type##_FINGER_SIZE, \
+			AMTPTP_WELLSPRING_##Type##_BUTTON); \
+	}
+
+AMTPTP_DEFINE_WELLSPRING_DECODER(TYPE2)
+AMTPTP_DEFINE_WELLSPRING_DECODER(TYPE3)
+AMTPTP_DEFINE_WELLSPRING_DECODER(TYPE4)
+
+static __forceinline VOID
+AmtPtpUnpackMt2Finger(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(AMTPTP_MT2_FINGER_SIZE) const UCHAR* Finger,
+	_In_ SIZE_T Slot,
+	_Inout_ PAMTPTP_MT2_FINGER_BATCH Batch
+)
+{
+	ULONG coords = AMTPTP_READ_LE32(Finger);
+
+	// Sign extend the 13 bit coordinates by shifting them to the top, Y axis is inverted
+	LONG x = (LONG) (coords << 19) >> 19;
+	LONG y = -((LONG) (coords << 6) >> 19);
+
+	Batch->X[Slot] = (USHORT) AmtPtpClampToUShort(x - Config->XMin);
+	Batch->Y[Slot] = (USHORT) AmtPtpClampToUShort(y - Config->YMin);
+	Batch->Finger[Slot] = (UCHAR) ((coords >> 26) & 0x7);
+	Batch->State[Slot] = (UCHAR) ((coords >> 29) & 0x7);
+}
+
+VOID
+AmtPtpUnpackMt2Fingers(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Count * AMTPTP_MT2_FINGER_SIZE) const UCHAR* Fingers,
+	_In_ SIZE_T Count,
+	_Out_ PAMTPTP_MT2_FINGER_BATCH Batch
+)
+{
+	SIZE_T i;
+
+	if (Count > AMTPTP_DECODER_MAX_CONTACTS) Count = AMTPTP_DECODER_MAX_CONTACTS;
+
+	for (i = 0; i < Count; i++) {
+		AmtPtpUnpackMt2Finger(Config, Fingers + i * AMTPTP_MT2_FINGER_SIZE, i, Batch);
+	}
+}
+
+#if defined(AMTPTP_UNPACK_SSE41)
+//
+// Unpacks fingers Slot to Slot + 3. The coords words sit at bytes 0, 9, 18
+// and 27 of the 36 record bytes, so two 16 byte loads cover them without
+// reading past the fourth record.
+//
+AMTPTP_TARGET("sse4.1")
+static __forceinline VOID
+AmtPtpUnpackMt2FingersSse41Step(
+	_In_reads_bytes_(4 * AMTPTP_MT2_FINGER_SIZE) const UCHAR* Fingers,
+	_In_ SIZE_T Slot,
+	_In_ __m128i XMin,
+	_In_ __m128i YMin,
+	_Inout_ PAMTPTP_MT2_FINGER_BATCH Batch
+)
+{
+	const __m128i pickLow = _mm_setr_epi8(0, 1, 2, 3, 9, 10, 11, 12, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i pickHigh = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 2, 3, 4, 5, 11, 12, 13, 14);
+	__m128i coords, x, y, finger, state, xy, classes;
+	ULONG packed;
+
+	coords = _mm_or_si128(
+		_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) Fingers), pickLow),
+		_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (Fingers + 16)), pickHigh));
+
+	x = _mm_sub_epi32(_mm_srai_epi32(_mm_slli_epi32(coords, 19), 19), XMin);
+	y = _mm_sub_epi32(_mm_sub_epi32(_mm_setzero_si128(), _mm_srai_epi32(_mm_slli_epi32(coords, 6), 19)), YMin);
+	finger = _mm_and_si128(_mm_srli_epi32(coords, 26), _mm_set1_epi32(0x7));
+	state = _mm_srli_epi32(coords, 29);
+
+	// Unsigned saturation is the clamp to 0 - 0xFFFF
+	xy = _mm_packus_epi32(x, y);
+	_mm_storel_epi64((__m128i*) &Batch->X[Slot], xy);
+	_mm_storel_epi64((__m128i*) &Batch->Y[Slot], _mm_srli_si128(xy, 8));
+
+	classes = _mm_packus_epi16(_mm_packus_epi32(finger, state), _mm_setzero_si128());
+	packed = (ULONG) _mm_cvtsi128_si32(classes);
+	RtlCopyMemory(&Batch->Finger[Slot], &packed, sizeof(packed));
+	packed = (ULONG) _mm_extract_epi32(classes, 1);
+	RtlCopyMemory(&Batch->State[Slot], &packed, sizeof(packed));
+}
+
+AMTPTP_TARGET("sse4.1")
+static VOID
+AmtPtpUnpackMt2FingersSse41(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Count * AMTPTP_MT2_FINGER_SIZE) const UCHAR* Fingers,
+	_In_ SIZE_T Count,
+	_Out_ PAMTPTP_MT2_FINGER_BATCH Batch
+)
+{
+	const __m128i xMin = _mm_set1_epi32(Config->XMin);
+	const __m128i yMin = _mm_set1_epi32(Config->YMin);
+	SIZE_T i;
+
+	if (Count > AMTPTP_DECODER_MAX_CONTACTS) Count = AMTPTP_DECODER_MAX_CONTACTS;
+
+	for (i = 0; i + 4 <= Count; i += 4) {
+		AmtPtpUnpackMt2FingersSse41Step(Fingers + i * AMTPTP_MT2_FINGER_SIZE, i, xMin, yMin, Batch);
+	}
+	for (; i < Count; i++) {
+		AmtPtpUnpackMt2Finger(Config, Fingers + i * AMTPTP_MT2_FINGER_SIZE, i, Batch);
+	}
+}
+
+static BOOLEAN
+AmtPtpCpuHasSse41(VOID)
+{
+#if defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 1);
+	return (info[2] & (1 << 19)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.1") != 0;
+#endif
+}
+#endif
+
+#if defined(AMTPTP_UNPACK_AVX2)
+// Eight fingers per step, one gather picks all the coords words
+AMTPTP_TARGET("avx2")
+static VOID
+AmtPtpUnpackMt2FingersAvx2(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Count * AMTPTP_MT2_FINGER_SIZE) const UCHAR* Fingers,
+	_In_ SIZE_T Count,
+	_Out_ PAMTPTP_MT2_FINGER_BATCH Batch
+)
+{
+	const __m256i offsets = _mm256_setr_epi32(0, 9, 18, 27, 36, 45, 54, 63);
+	const __m256i xMin = _mm256_set1_epi32(Config->XMin);
+	const __m256i yMin = _mm256_set1_epi32(Config->YMin);
+	__m256i coords, x, y, finger, state, xy, classes;
+	__m128i bytes;
+	SIZE_T i;
+
+	if (Count > AMTPTP_DECODER_MAX_CONTACTS) Count = AMTPTP_DECODER_MAX_CONTACTS;
+
+	for (i = 0; i + 8 <= Count; i += 8) {
+		coords = _mm256_i32gather_epi32((const int*) (Fingers + i * AMTPTP_MT2_FINGER_SIZE), offsets, 1);
+
+		x = _mm256_sub_epi32(_mm256_srai_epi32(_mm256_slli_epi32(coords, 19), 19), xMin);
+		y = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_setzero_si256(),
+			_mm256_srai_epi32(_mm256_slli_epi32(coords, 6), 19)), yMin);
+		finger = _mm256_and_si256(_mm256_srli_epi32(coords, 26), _mm256_set1_epi32(0x7));
+		state = _mm256_srli_epi32(coords, 29);
+
+		// Packing works per 128 bit lane, the permute puts X0-7 low and Y0-7 high
+		xy = _mm256_permute4x64_epi64(_mm256_packus_epi32(x, y), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i*) &Batch->X[i], _mm256_castsi256_si128(xy));
+		_mm_storeu_si128((__m128i*) &Batch->Y[i], _mm256_extracti128_si256(xy, 1));
+
+		classes = _mm256_permute4x64_epi64(_mm256_packus_epi32(finger, state), _MM_SHUFFLE(3, 1, 2, 0));
+		bytes = _mm_packus_epi16(_mm256_castsi256_si128(classes), _mm256_extracti128_si256(classes, 1));
+		_mm_storel_epi64((__m128i*) &Batch->Finger[i], bytes);
+		_mm_storel_epi64((__m128i*) &Batch->State[i], _mm_srli_si128(bytes, 8));
+	}
+	if (i + 4 <= Count) {
+		AmtPtpUnpackMt2FingersSse41Step(Fingers + i * AMTPTP_MT2_FINGER_SIZE, i,
+			_mm256_castsi256_si128(xMin), _mm256_castsi256_si128(yMin), Batch);
+		i += 4;
+	}
+	for (; i < Count; i++) {
+		AmtPtpUnpackMt2Finger(Config, Fingers + i * AMTPTP_MT2_FINGER_SIZE, i, Batch);
+	}
+}
+
+static BOOLEAN
+AmtPtpCpuHasAvx2(VOID)
+{
+#if defined(_MSC_VER)
+	int info[4];
+
+	// The OS has to save the YMM state as well
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6) {
+		return FALSE;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+#if defined(AMTPTP_UNPACK_NEON)
+// Four fingers per step, a two register table lookup picks the coords words
+static VOID
+AmtPtpUnpackMt2FingersNeon(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Count * AMTPTP_MT2_FINGER_SIZE) const UCHAR* Fingers,
+	_In_ SIZE_T Count,
+	_Out_ PAMTPTP_MT2_FINGER_BATCH Batch
+)
+{
+	static const UCHAR pickCoords[16] = { 0, 1, 2, 3, 9, 10, 11, 12, 18, 19, 20, 21, 27, 28, 29, 30 };
+	const uint8x16_t pick = vld1q_u8(pickCoords);
+	const int32x4_t xMin = vdupq_n_s32(Config->XMin);
+	const int32x4_t yMin = vdupq_n_s32(Config->YMin);
+	uint8x16x2_t bytes;
+	uint32x4_t coords;
+	int32x4_t x, y;
+	uint8x8_t classes;
+	ULONG packed;
+	SIZE_T i;
+
+	if (Count > AMTPTP_DECODER_MAX_CONTACTS) Count = AMTPTP_DECODER_MAX_CONTACTS;
+
+	for (i = 0; i + 4 <= Count; i += 4) {
+		bytes.val[0] = vld1q_u8(Fingers + i * AMTPTP_MT2_FINGER_SIZE);
+		bytes.val[1] = vld1q_u8(Fingers + i * AMTPTP_MT2_FINGER_SIZE + 16);
+		coords = vreinterpretq_u32_u8(vqtbl2q_u8(bytes, pick));
+
+		x = vsubq_s32(vshrq_n_s32(vshlq_n_s32(vreinterpretq_s32_u32(coords), 19), 19), xMin);
+		y = vsubq_s32(vnegq_s32(vshrq_n_s32(vshlq_n_s32(vreinterpretq_s32_u32(coords), 6), 19)), yMin);
+
+		// Unsigned saturation is the clamp to 0 - 0xFFFF
+		vst1_u16(&Batch->X[i], vqmovun_s32(x));
+		vst1_u16(&Batch->Y[i], vqmovun_s32(y));
+
+		classes = vmovn_u16(vcombine_u16(
+			vmovn_u32(vandq_u32(vshrq_n_u32(coords, 26), vdupq_n_u32(0x7))),
+			vmovn_u32(vshrq_n_u32(coords, 29))));
+		packed = vget_lane_u32(vreinterpret_u32_u8(classes), 0);
+		RtlCopyMemory(&Batch->Finger[i], &packed, sizeof(packed));
+		packed = vget_lane_u32(vreinterpret_u32_u8(classes), 1);
+		RtlCopyMemory(&Batch->State[i], &packed, sizeof(packed));
+	}
+	for (; i < Count; i++) {
+		AmtPtpUnpackMt2Finger(Config, Fingers + i * AMTPTP_MT2_FINGER_SIZE, i, Batch);
+	}
+}
+#endif
+
+PFN_AMTPTP_UNPACK_MT2_FINGERS
+AmtPtpGetUnpackMt2Fingers(
+	_In_ AMTPTP_UNPACK_ISA Isa
+)
+{
+	switch (Isa) {
+	case AmtPtpUnpackIsaScalar:
+		return AmtPtpUnpackMt2Fingers;
+#if defined(AMTPTP_UNPACK_SSE41)
+	case AmtPtpUnpackIsaSse41:
+		return AmtPtpCpuHasSse41() ? AmtPtpUnpackMt2FingersSse41 : NULL;
+#endif
+#if defined(AMTPTP_UNPACK_AVX2)
+	case AmtPtpUnpackIsaAvx2:
+		return AmtPtpCpuHasAvx2() ? AmtPtpUnpackMt2FingersAvx2 : NULL;
+#endif
+#if defined(AMTPTP_UNPACK_NEON)
+	case AmtPtpUnpackIsaNeon:
+		return AmtPtpUnpackMt2FingersNeon;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+static __forceinline AMTPTP_DECODE_RESULT
+AmtPtpDecodeMt2Layout(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ SIZE_T HeaderSize
+)
+{
+	AMTPTP_MT2_FINGER_BATCH batch;
+	const UCHAR* header;
+	const UCHAR* f;
+	ULONG timestamp;
+	SIZE_T raw_n, i;
+
+	RtlZeroMemory(Frame, sizeof(AMTPTP_DECODED_FRAME));
+
+	// The 4 byte report 0x31 header sits right before the fingers. Over USB it
+	// follows the 8 byte mouse report, so HeaderSize is either 4 or 12.
+	if (HeaderSize < AMTPTP_MT2_HEADER_SIZE || Length < HeaderSize ||
+		(Length - HeaderSize) % AMTPTP_MT2_FINGER_SIZE != 0) {
+		return AmtPtpDecodeMalformed;
+	}
+
+	header = Buffer + HeaderSize - AMTPTP_MT2_HEADER_SIZE;
+
+	// MT reports timestamps in milliseconds
+	timestamp = (header[1] >> 3) | ((ULONG) AMTPTP_READ_LE16(header + 2) << 5);
+	Frame->DeviceTime = timestamp & AMTPTP_MT2_TIMESTAMP_MASK;
+	Frame->HasDeviceTime = TRUE;
+	// Over USB the button comes from the mouse report, like the TYPE5 code
+	// and hid-magicmouse always took it. Bluetooth only has the clicks bit.
+	if (HeaderSize > AMTPTP_MT2_HEADER_SIZE) {
+		Frame->IsButtonClicked = Buffer[AMTPTP_MT2_USB_BUTTON] != 0;
+	} else {
+		Frame->IsButtonClicked = header[1] & 0x1;
+	}
+
+	raw_n = (Length - HeaderSize) / AMTPTP_MT2_FINGER_SIZE;
+	if (raw_n > AMTPTP_DECODER_MAX_CONTACTS) raw_n = AMTPTP_DECODER_MAX_CONTACTS;
+
+	if (Config->UnpackMt2Fingers != NULL) {
+		Config->UnpackMt2Fingers(Config, Buffer + HeaderSize, raw_n, &batch);
+	} else {
+		AmtPtpUnpackMt2Fingers(Config, Buffer + HeaderSize, raw_n, &batch);
+	}
+
+	for (i = 0; i < raw_n; i++) {
+		PAMTPTP_DECODED_CONTACT contact = &Frame->Contacts[i];
+		UCHAR state = batch.State[i];
+
+		f = Buffer + HeaderSize + i * AMTPTP_MT2_FINGER_SIZE;
+
+		contact->X = batch.X[i];
+		contact->Y = batch.Y[i];
+		contact->Finger = batch.Finger[i];
+		contact->TouchMajor = f[4];
+		contact->TouchMinor = f[5];
+		contact->Pressure = f[7];
+		contact->ContactID = (Config->Flags & AMTPTP_DECODER_FLAG_CONTACT_ID_FROM_SLOT) ?
+			(UCHAR) i : (f[8] & 0xF);
+
+		// 0x1 = Transition between states
+		// 0x2 = Floating finger?
+		// 0x4 = Valid/Has contacted the touchpad at some point in gesture?
+		contact->TipSwitch = (state & 0x4) && !(state & 0x2);
+
+		// 1 = thumb, 2 = index, etc etc
+		// 6 = palm on MT2
+		contact->Confidence = contact->Finger != 6;
+	}
+
+	Frame->ContactCount = (UCHAR) raw_n;
+	return AmtPtpDecodeOk;
+}
+
+AMTPTP_DECODE_RESULT
+AmtPtpDecodeMt2Frame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	return AmtPtpDecodeMt2Layout(Config, Buffer, Length, Frame, Config->HeaderSize);
+}
+
+// Bluetooth delivers report 0x31 bare, USB prefixes it with the mouse report
+static AMTPTP_DECODE_RESULT
+AmtPtpDecodeMt2BthFrame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	return AmtPtpDecodeMt2Layout(Config, Buffer, Length, Frame, AMTPTP_MT2_HEADER_SIZE);
+}
+
+static AMTPTP_DECODE_RESULT
+AmtPtpDecodeMt2UsbFrame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	return AmtPtpDecodeMt2Layout(Config, Buffer, Length, Frame, AMTPTP_MT2_USB_HEADER_SIZE);
+}
+
+AMTPTP_DECODE_RESULT
+AmtPtpDecodeSpiFrame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	const UCHAR* f;
+	SIZE_T raw_n, i;
+
+	RtlZeroMemory(Frame, sizeof(AMTPTP_DECODED_FRAME));
+
+	if (Length < AMTPTP_SPI_HEADER_SIZE) {
+		return AmtPtpDecodeMalformed;
+	}
+
+	Frame->IsButtonClicked = Buffer[AMTPTP_SPI_CLICK_OFFSET] != 0;
+
+	// Trust the reported count only as far as the frame goes
+	raw_n = Buffer[AMTPTP_SPI_FINGER_COUNT_OFFSET];
+	if (raw_n > AMTPTP_SPI_MAX_FINGERS) raw_n = AMTPTP_SPI_MAX_FINGERS;
+	if (raw_n > (Length - AMTPTP_SPI_HEADER_SIZE) / AMTPTP_SPI_FINGER_SIZE) {
+		raw_n = (Length - AMTPTP_SPI_HEADER_SIZE) / AMTPTP_SPI_FINGER_SIZE;
+	}
+
+	for (i = 0; i < raw_n; i++) {
+		PAMTPTP_DECODED_CONTACT contact = &Frame->Contacts[i];
+		SHORT touchMajor, touchMinor;
+
+		f = Buffer + AMTPTP_SPI_HEADER_SIZE + i * AMTPTP_SPI_FINGER_SIZE;
+		touchMajor = (SHORT) AMTPTP_READ_LE16(f + AMTPTP_SPI_FINGER_TOUCH_MAJOR);
+		touchMinor = (SHORT) AMTPTP_READ_LE16(f + AMTPTP_SPI_FINGER_TOUCH_MINOR);
+
+		contact->ContactID = (UCHAR) i;
+		contact->X = (USHORT) AmtPtpClampToUShort((SHORT) AMTPTP_READ_LE16(f + AMTPTP_SPI_FINGER_X) - Config->XMin);
+		contact->Y = (USHORT) AmtPtpClampToUShort(Config->YMax - (SHORT) AMTPTP_READ_LE16(f + AMTPTP_SPI_FINGER_Y));
+		contact->TouchMajor = (USHORT) AmtPtpClampToUShort(touchMajor);
+		contact->TouchMinor = (USHORT) AmtPtpClampToUShort(touchMinor);
+		contact->Pressure = (USHORT) AmtPtpClampToUShort((SHORT) AMTPTP_READ_LE16(f + AMTPTP_SPI_FINGER_PRESSURE));
+		contact->TipSwitch = contact->Pressure > 0;
+
+		// $S = \pi * (Touch_{Major} * Touch_{Minor}) / 4$
+		// $S = \pi * r^2$
+		// $r^2 = (Touch_{Major} * Touch_{Minor}) / 4$
+		contact->Confidence = (touchMajor < 2500 && touchMinor < 2500);
+	}
+
+	Frame->ContactCount = (UCHAR) raw_n;
+	return AmtPtpDecodeOk;
+}
+
+VOID
+AmtPtpDecoderSelect(
+	_Inout_ PAMTPTP_DECODER_CONFIG Config
+)
+{
+	AMTPTP_UNPACK_ISA isa;
+
+	Config->Decode = NULL;
+	Config->UnpackMt2Fingers = NULL;
+
+	switch (Config->Format) {
+	case AmtPtpFrameFormatWellspring:
+		if (Config->HeaderSize == AMTPTP_WELLSPRING_TYPE2_HEADER_SIZE &&
+			Config->FingerSize == AMTPTP_WELLSPRING_TYPE2_FINGER_SIZE &&
+			Config->ButtonOffset == AMTPTP_WELLSPRING_TYPE2_BUTTON) {
+			Config->Decode = AmtPtpDecodeWellspringTYPE2Frame;
+		} else if (Config->HeaderSize == AMTPTP_WELLSPRING_TYPE3_HEADER_SIZE &&
+			Config->FingerSize == AMTPTP_WELLSPRING_TYPE3_FINGER_SIZE &&
+			Config->ButtonOffset == AMTPTP_WELLSPRING_TYPE3_BUTTON) {
+			Config->Decode = AmtPtpDecodeWellspringTYPE3Frame;
+		} else if (Config->HeaderSize == AMTPTP_WELLSPRING_TYPE4_HEADER_SIZE &&
+			Config->FingerSize == AMTPTP_WELLSPRING_TYPE4_FINGER_SIZE &&
+			Config->ButtonOffset == AMTPTP_WELLSPRING_TYPE4_BUTTON) {
+			Config->Decode = AmtPtpDecodeWellspringTYPE4Frame;
+		} else {
+			Config->Decode = AmtPtpDecodeWellspringFrame;
+		}
+		break;
+	case AmtPtpFrameFormatMt2:
+		if (Config->HeaderSize == AMTPTP_MT2_HEADER_SIZE) {
+			Config->Decode = AmtPtpDecodeMt2BthFrame;
+		} else if (Config->HeaderSize == AMTPTP_MT2_USB_HEADER_SIZE) {
+			Config->Decode = AmtPtpDecodeMt2UsbFrame;
+		} else {
+			Config->Decode = AmtPtpDecodeMt2Frame;
+		}
+
+		// Widest variant first, the scalar one is always there
+		for (isa = AmtPtpUnpackIsaMax - 1; Config->UnpackMt2Fingers == NULL; isa--) {
+			Config->UnpackMt2Fingers = AmtPtpGetUnpackMt2Fingers(isa);
+		}
+		break;
+	case AmtPtpFrameFormatSpi:
+		Config->Decode = AmtPtpDecodeSpiFrame;
+		break;
+	default:
+		break;
+	}
+}
+
+AMTPTP_DECODE_RESULT
+AmtPtpDecodeFrame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	if (Config->Decode != NULL) {
+		return Config->Decode(Config, Buffer, Length, Frame);
+	}
+
+	switch (Config->Format) {
+	case AmtPtpFrameFormatWellspring:
+		return AmtPtpDecodeWellspringFrame(Config, Buffer, Length, Frame);
+	case AmtPtpFrameFormatMt2:
+		return AmtPtpDecodeMt2Frame(Config, Buffer, Length, Frame);
+	case AmtPtpFrameFormatSpi:
+		return AmtPtpDecodeSpiFrame(Config, Buffer, Length, Frame);
+	default:
+		RtlZeroMemory(Frame, sizeof(AMTPTP_DECODED_FRAME));
+		return AmtPtpDecodeUnsupported;
+	}
+}
@@ -0,0 +1,272 @@
+// AmtPtpDeviceRegistry.c: Every supported trackpad, described once
+
+#include <AmtPtpDeviceRegistry.h>
+
+/* bcm5974 frame layouts, le16-aligned */
+#define AMTPTP_LAYOUT(type, format, header, fsize, button)				\
+	.Type = (type),														\
+	.Format = (format),													\
+	.HeaderSize = (header),												\
+	.FingerOffset = (header),											\
+	.FingerSize = (fsize),												\
+	.ButtonOffset = (button),											\
+	.TransferLength = (header) + AMTPTP_DECODER_MAX_CONTACTS * (fsize)
+
+#define AMTPTP_LAYOUT_TYPE1	AMTPTP_LAYOUT(AmtPtpTrackpadType1, AmtPtpFrameFormatWellspring, 12 * sizeof(USHORT), 14 * sizeof(USHORT), 0)
+#define AMTPTP_LAYOUT_TYPE2	AMTPTP_LAYOUT(AmtPtpTrackpadType2, AmtPtpFrameFormatWellspring, AMTPTP_WELLSPRING_TYPE2_HEADER_SIZE, AMTPTP_WELLSPRING_TYPE2_FINGER_SIZE, AMTPTP_WELLSPRING_TYPE2_BUTTON)
+#define AMTPTP_LAYOUT_TYPE3	AMTPTP_LAYOUT(AmtPtpTrackpadType3, AmtPtpFrameFormatWellspring, AMTPTP_WELLSPRING_TYPE3_HEADER_SIZE, AMTPTP_WELLSPRING_TYPE3_FINGER_SIZE, AMTPTP_WELLSPRING_TYPE3_BUTTON)
+#define AMTPTP_LAYOUT_TYPE4	AMTPTP_LAYOUT(AmtPtpTrackpadType4, AmtPtpFrameFormatWellspring, AMTPTP_WELLSPRING_TYPE4_HEADER_SIZE, AMTPTP_WELLSPRING_TYPE4_FINGER_SIZE, AMTPTP_WELLSPRING_TYPE4_BUTTON)
+#define AMTPTP_LAYOUT_TYPE5	AMTPTP_LAYOUT(AmtPtpTrackpadType5, AmtPtpFrameFormatMt2, AMTPTP_MT2_USB_HEADER_SIZE, AMTPTP_MT2_FINGER_SIZE, AMTPTP_MT2_USB_BUTTON)
+#define AMTPTP_LAYOUT_BTH5	AMTPTP_LAYOUT(AmtPtpTrackpadType5, AmtPtpFrameFormatMt2, AMTPTP_MT2_HEADER_SIZE, AMTPTP_MT2_FINGER_SIZE, 1)
+#define AMTPTP_LAYOUT_SPI	AMTPTP_LAYOUT(AmtPtpTrackpadTypeNone, AmtPtpFrameFormatSpi, AMTPTP_SPI_HEADER_SIZE, AMTPTP_SPI_FINGER_SIZE, AMTPTP_SPI_CLICK_OFFSET)
+
+/* USB control message mode switch data */
+#define AMTPTP_MODE_SWITCH_TYPE1	{ 8, 0x300, 0, 0, 0x1, 0x8 }
+#define AMTPTP_MODE_SWITCH_TYPE2	{ 8, 0x300, 0, 0, 0x1, 0x8 }
+#define AMTPTP_MODE_SWITCH_TYPE4	{ 2, 0x302, 2, 1, 0x1, 0x0 }
+#define AMTPTP_MODE_SWITCH_TYPE5	{ 2, 0x302, 1, 1, 0x1, 0x0 }
+
+/* coordinate signal-to-noise ratio */
+#define SN_COORD	250
+
+#define AMTPTP_USB_AXES(xmin, xmax, ymin, ymax, width, height)	\
+	.X = { SN_COORD, (xmin), (xmax), (width) },					\
+	.Y = { SN_COORD, (ymin), (ymax), (height) }
+
+// SPI ranges come from the Linux applespi driver, which does not publish
+// signal-to-noise ratios. Positions are not defuzzed on SPI.
+#define AMTPTP_SPI_AXES(xmin, xmax, ymin, ymax, width, height)	\
+	.X = { 0, (xmin), (xmax), (width) },						\
+	.Y = { 0, (ymin), (ymax), (height) }
+
+#define AMTPTP_USB_MODEL(name, layout, modeSwitch, geometry, descriptor)	\
+	{																		\
+		.Name = (name),														\
+		.Bus = AmtPtpBusUsb,												\
+		layout,																\
+		.ModeSwitch = modeSwitch,											\
+		AMTPTP_GEOMETRY_APPLY(AMTPTP_USB_AXES, geometry),					\
+		.Descriptor = (descriptor)											\
+	}
+
+#define AMTPTP_SPI_MODEL(name, geometry, descriptor)			\
+	{															\
+		.Name = (name),											\
+		.Bus = AmtPtpBusSpi,									\
+		AMTPTP_LAYOUT_SPI,										\
+		AMTPTP_GEOMETRY_APPLY(AMTPTP_SPI_AXES, geometry),		\
+		.Descriptor = (descriptor)								\
+	}
+
+static const AMTPTP_DEVICE_MODEL AmtPtpDeviceModels[AmtPtpModelMax] = {
+	[AmtPtpModelWellspring] = AMTPTP_USB_MODEL("Wellspring",
+		AMTPTP_LAYOUT_TYPE1, AMTPTP_MODE_SWITCH_TYPE1, (-4824, 5342, -172, 5820, 0, 0),
+		AmtPtpReportDescriptorNone),
+	[AmtPtpModelWellspring2] = AMTPTP_USB_MODEL("Wellspring 2",
+		AMTPTP_LAYOUT_TYPE1, AMTPTP_MODE_SWITCH_TYPE1, (-4824, 4824, -172, 4290, 0, 0),
+		AmtPtpReportDescriptorNone),
+	[AmtPtpModelWellspring3] = AMTPTP_USB_MODEL("Wellspring 3",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, AMTPTP_GEOMETRY_WELLSPRING3,
+		AmtPtpReportDescriptorWellspring3),
+	[AmtPtpModelWellspring4] = AMTPTP_USB_MODEL("Wellspring 4",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, (-4620, 5140, -150, 6600, 0, 0),
+		AmtPtpReportDescriptorNone),
+	[AmtPtpModelWellspring4A] = AMTPTP_USB_MODEL("Wellspring 4A",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, (-4616, 5112, -142, 5234, 0, 0),
+		AmtPtpReportDescriptorNone),
+	[AmtPtpModelWellspring5] = AMTPTP_USB_MODEL("Wellspring 5",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, AMTPTP_GEOMETRY_WELLSPRING5,
+		AmtPtpReportDescriptorWellspring5),
+	[AmtPtpModelWellspring6] = AMTPTP_USB_MODEL("Wellspring 6",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, AMTPTP_GEOMETRY_WELLSPRING6,
+		AmtPtpReportDescriptorWellspring6),
+	/* Wellspring 5A reads like the 7 series, not like Wellspring 5 */
+	[AmtPtpModelWellspring5A] = AMTPTP_USB_MODEL("Wellspring 5A",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, AMTPTP_GEOMETRY_WELLSPRING7A,
+		AmtPtpReportDescriptorWellspring7a),
+	[AmtPtpModelWellspring6A] = AMTPTP_USB_MODEL("Wellspring 6A",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, AMTPTP_GEOMETRY_WELLSPRING6,
+		AmtPtpReportDescriptorWellspring6),
+	[AmtPtpModelWellspring7] = AMTPTP_USB_MODEL("Wellspring 7",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, AMTPTP_GEOMETRY_WELLSPRING7A,
+		AmtPtpReportDescriptorWellspring7a),
+	[AmtPtpModelWellspring7A] = AMTPTP_USB_MODEL("Wellspring 7A",
+		AMTPTP_LAYOUT_TYPE2, AMTPTP_MODE_SWITCH_TYPE2, AMTPTP_GEOMETRY_WELLSPRING7A,
+		AmtPtpReportDescriptorWellspring7a),
+	/* TYPE3 devices come up in Wellspring mode */
+	[AmtPtpModelWellspring8] = AMTPTP_USB_MODEL("Wellspring 8",
+		AMTPTP_LAYOUT_TYPE3, { 0 }, AMTPTP_GEOMETRY_WELLSPRING8,
+		AmtPtpReportDescriptorWellspring8),
+	[AmtPtpModelWellspring9] = AMTPTP_USB_MODEL("Wellspring 9",
+		AMTPTP_LAYOUT_TYPE4, AMTPTP_MODE_SWITCH_TYPE4, AMTPTP_GEOMETRY_WELLSPRING9,
+		AmtPtpReportDescriptorWellspring9),
+	[AmtPtpModelMagicTrackpad2Usb] = AMTPTP_USB_MODEL("Magic Trackpad 2",
+		AMTPTP_LAYOUT_TYPE5, AMTPTP_MODE_SWITCH_TYPE5, AMTPTP_GEOMETRY_MAGIC_TRACKPAD2,
+		AmtPtpReportDescriptorMagicTrackpad2),
+	[AmtPtpModelMagicTrackpad2Bluetooth] = {
+		.Name = "Magic Trackpad 2",
+		.Bus = AmtPtpBusBluetooth,
+		AMTPTP_LAYOUT_BTH5,
+		AMTPTP_GEOMETRY_APPLY(AMTPTP_USB_AXES, AMTPTP_GEOMETRY_MAGIC_TRACKPAD2),
+		.Descriptor = AmtPtpReportDescriptorMagicTrackpad2
+	},
+	// Oversampled - this is fine for a trackpad
+	[AmtPtpModelT2] = AMTPTP_USB_MODEL("T2",
+		AMTPTP_LAYOUT_TYPE4, AMTPTP_MODE_SWITCH_TYPE4, AMTPTP_GEOMETRY_T2,
+		AmtPtpReportDescriptorT2),
+	[AmtPtpModelT2Small] = AMTPTP_USB_MODEL("T2 13 inch",
+		AMTPTP_LAYOUT_TYPE4, AMTPTP_MODE_SWITCH_TYPE4, AMTPTP_GEOMETRY_T2_SMALL,
+		AmtPtpReportDescriptorT2Small),
+	[AmtPtpModelSpiFamily1] = AMTPTP_SPI_MODEL("SPI Family 1",
+		AMTPTP_GEOMETRY_SPI_FAMILY1, AmtPtpReportDescriptorSpiFamily1),
+	[AmtPtpModelSpiFamily2] = AMTPTP_SPI_MODEL("SPI Family 2",
+		AMTPTP_GEOMETRY_SPI_FAMILY2, AmtPtpReportDescriptorSpiFamily2),
+	[AmtPtpModelSpiFamily3a] = AMTPTP_SPI_MODEL("SPI Family 3a",
+		AMTPTP_GEOMETRY_SPI_FAMILY3A, AmtPtpReportDescriptorSpiFamily3a),
+	[AmtPtpModelSpiFamily3b] = AMTPTP_SPI_MODEL("SPI Family 3b",
+		AMTPTP_GEOMETRY_SPI_FAMILY3B, AmtPtpReportDescriptorSpiFamily3b),
+};
+
+#define AMTPTP_PRODUCT(pid, model) [(pid) - AMTPTP_PRODUCT_ID_BASE] = (model)
+
+/* product id to model, per bus */
+static const UCHAR AmtPtpProductModels[AmtPtpBusMax][AMTPTP_PRODUCT_ID_SPAN] = {
+	[AmtPtpBusUsb] = {
+		/* MacbookAir, aka wellspring */
+		AMTPTP_PRODUCT(0x0223, AmtPtpModelWellspring),
+		AMTPTP_PRODUCT(0x0224, AmtPtpModelWellspring),
+		AMTPTP_PRODUCT(0x0225, AmtPtpModelWellspring),
+		/* MacbookProPenryn, aka wellspring2 */
+		AMTPTP_PRODUCT(0x0230, AmtPtpModelWellspring2),
+		AMTPTP_PRODUCT(0x0231, AmtPtpModelWellspring2),
+		AMTPTP_PRODUCT(0x0232, AmtPtpModelWellspring2),
+		/* Macbook5,1 (unibody), aka wellspring3 */
+		AMTPTP_PRODUCT(0x0236, AmtPtpModelWellspring3),
+		AMTPTP_PRODUCT(0x0237, AmtPtpModelWellspring3),
+		AMTPTP_PRODUCT(0x0238, AmtPtpModelWellspring3),
+		/* MacbookAir3,2 (unibody), aka wellspring5 */
+		AMTPTP_PRODUCT(0x023f, AmtPtpModelWellspring4),
+		AMTPTP_PRODUCT(0x0240, AmtPtpModelWellspring4),
+		AMTPTP_PRODUCT(0x0241, AmtPtpModelWellspring4),
+		/* MacbookAir3,1 (unibody), aka wellspring4 */
+		AMTPTP_PRODUCT(0x0242, AmtPtpModelWellspring4A),
+		AMTPTP_PRODUCT(0x0243, AmtPtpModelWellspring4A),
+		AMTPTP_PRODUCT(0x0244, AmtPtpModelWellspring4A),
+		/* Macbook8 (unibody, March 2011) */
+		AMTPTP_PRODUCT(0x0245, AmtPtpModelWellspring5),
+		AMTPTP_PRODUCT(0x0246, AmtPtpModelWellspring5),
+		AMTPTP_PRODUCT(0x0247, AmtPtpModelWellspring5),
+		/* MacbookAir4,1 (unibody, July 2011) */
+		AMTPTP_PRODUCT(0x0249, AmtPtpModelWellspring6A),
+		AMTPTP_PRODUCT(0x024a, AmtPtpModelWellspring6A),
+		AMTPTP_PRODUCT(0x024b, AmtPtpModelWellspring6A),
+		/* MacbookAir4,2 (unibody, July 2011) */
+		AMTPTP_PRODUCT(0x024c, AmtPtpModelWellspring6),
+		AMTPTP_PRODUCT(0x024d, AmtPtpModelWellspring6),
+		AMTPTP_PRODUCT(0x024e, AmtPtpModelWellspring6),
+		/* Macbook8,2 (unibody) */
+		AMTPTP_PRODUCT(0x0252, AmtPtpModelWellspring5A),
+		AMTPTP_PRODUCT(0x0253, AmtPtpModelWellspring5A),
+		AMTPTP_PRODUCT(0x0254, AmtPtpModelWellspring5A),
+		/* MacbookPro10,2 (unibody, October 2012) */
+		AMTPTP_PRODUCT(0x0259, AmtPtpModelWellspring7A),
+		AMTPTP_PRODUCT(0x025a, AmtPtpModelWellspring7A),
+		AMTPTP_PRODUCT(0x025b, AmtPtpModelWellspring7A),
+		/* MacbookPro10,1 (unibody, June 2012) */
+		AMTPTP_PRODUCT(0x0262, AmtPtpModelWellspring7),
+		AMTPTP_PRODUCT(0x0263, AmtPtpModelWellspring7),
+		AMTPTP_PRODUCT(0x0264, AmtPtpModelWellspring7),
+		/* MagicTrackpad2 (2015) */
+		AMTPTP_PRODUCT(0x0265, AmtPtpModelMagicTrackpad2Usb),
+		/* MacbookPro12,1 (2015) */
+		AMTPTP_PRODUCT(0x0272, AmtPtpModelWellspring9),
+		AMTPTP_PRODUCT(0x0273, AmtPtpModelWellspring9),
+		AMTPTP_PRODUCT(0x0274, AmtPtpModelWellspring9),
+		/* Apple T2 USB trackpad, 13 inch */
+		AMTPTP_PRODUCT(0x027a, AmtPtpModelT2Small),
+		AMTPTP_PRODUCT(0x027b, AmtPtpModelT2Small),
+		/* Apple T2 USB trackpad, 15 inch */
+		AMTPTP_PRODUCT(0x027c, AmtPtpModelT2),
+		AMTPTP_PRODUCT(0x027d, AmtPtpModelT2),
+		/* MacbookAir6,2 (unibody, June 2013) */
+		AMTPTP_PRODUCT(0x0290, AmtPtpModelWellspring8),
+		AMTPTP_PRODUCT(0x0291, AmtPtpModelWellspring8),
+		AMTPTP_PRODUCT(0x0292, AmtPtpModelWellspring8),
+	},
+	[AmtPtpBusBluetooth] = {
+		AMTPTP_PRODUCT(0x0265, AmtPtpModelMagicTrackpad2Bluetooth),
+	},
+	[AmtPtpBusSpi] = {
+		/* MacBookPro11,1 / MacBookPro12,1 */
+		AMTPTP_PRODUCT(0x0272, AmtPtpModelSpiFamily2),
+		AMTPTP_PRODUCT(0x0273, AmtPtpModelSpiFamily2),
+		/* MacBook9 */
+		AMTPTP_PRODUCT(0x0275, AmtPtpModelSpiFamily1),
+		/* MacBookPro14,1 / MacBookPro14,2 */
+		AMTPTP_PRODUCT(0x0276, AmtPtpModelSpiFamily3a),
+		AMTPTP_PRODUCT(0x0277, AmtPtpModelSpiFamily3a),
+		/* MacBookPro14,3 */
+		AMTPTP_PRODUCT(0x0278, AmtPtpModelSpiFamily3b),
+		/* MacBook10 */
+		AMTPTP_PRODUCT(0x0279, AmtPtpModelSpiFamily1),
+		/* MacBookAir7,2 fallback */
+		AMTPTP_PRODUCT(0x0290, AmtPtpModelSpiFamily1),
+		AMTPTP_PRODUCT(0x0291, AmtPtpModelSpiFamily1),
+	},
+};
+
+static_assert(AmtPtpModelMax <= 0x100, "Model ids must fit the product table");
+static_assert(AMTPTP_MT2_USB_HEADER_SIZE + AMTPTP_DECODER_MAX_CONTACTS * AMTPTP_MT2_FINGER_SIZE <= 0xFFFF, "Transfer length overflow");
+
+const AMTPTP_DEVICE_MODEL*
+AmtPtpDeviceRegistryLookup(
+	_In_ AMTPTP_BUS Bus,
+	_In_ USHORT VendorId,
+	_In_ USHORT ProductId
+)
+{
+	USHORT expectedVendorId = (Bus == AmtPtpBusBluetooth) ? AMTPTP_VID_APPLE_BT : AMTPTP_VID_APPLE_USB;
+
+	if (Bus >= AmtPtpBusMax || VendorId != expectedVendorId ||
+		ProductId < AMTPTP_PRODUCT_ID_BASE || ProductId >= AMTPTP_PRODUCT_ID_BASE + AMTPTP_PRODUCT_ID_SPAN) {
+		return NULL;
+	}
+
+	return AmtPtpDeviceRegistryGetModel(
+		(AMTPTP_DEVICE_MODEL_ID) AmtPtpProductModels[Bus][ProductId - AMTPTP_PRODUCT_ID_BASE]);
+}
+
+const AMTPTP_DEVICE_MODEL*
+AmtPtpDeviceRegistryGetModel(
+	_In_ AMTPTP_DEVICE_MODEL_ID ModelId
+)
+{
+	if (ModelId <= AmtPtpModelUnknown || ModelId >= AmtPtpModelMax) {
+		return NULL;
+	}
+
+	return &AmtPtpDeviceModels[ModelId];
+}
+
+VOID
+AmtPtpDeviceRegistryInitDecoderConfig(
+	_In_ const AMTPTP_DEVICE_MODEL* Model,
+	_In_ ULONG Flags,
+	_Out_ PAMTPTP_DECODER_CONFIG Config
+)
+{
+	RtlZeroMemory(Config, sizeof(AMTPTP_DECODER_CONFIG));
+	Config->Format = Model->Format;
+	Config->Flags = Flags;
+	Config->HeaderSize = Model->HeaderSize;
+	Config->FingerOffset = Model->FingerOffset;
+	Config->FingerSize = Model->FingerSize;
+	Config->ButtonOffset = Model->ButtonOffset;
+	Config->XMin = Model->X.Min;
+	Config->XMax = Model->X.Max;
+	Config->YMin = Model->Y.Min;
+	Config->YMax = Model->Y.Max;
+
+	// Resolve the decoder once instead of looking at the layout on every frame
+	AmtPtpDecoderSelect(Config);
+}
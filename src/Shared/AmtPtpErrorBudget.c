@@ -0,0 +1,105 @@
+// AmtPtpErrorBudget.c: Malformed frame handling with a sliding error budget
+
+#include <AmtPtpErrorBudget.h>
+
+VOID
+AmtPtpErrorBudgetInitialize(
+	_Out_ PAMTPTP_ERROR_BUDGET Budget,
+	_In_ ULONGLONG Window,
+	_In_ ULONG Limit
+)
+{
+	RtlZeroMemory(Budget, sizeof(AMTPTP_ERROR_BUDGET));
+
+	if (Limit == 0) Limit = 1;
+	if (Limit > AMTPTP_ERROR_BUDGET_MAX_LIMIT) Limit = AMTPTP_ERROR_BUDGET_MAX_LIMIT;
+
+	Budget->Window = Window;
+	Budget->Limit = Limit;
+}
+
+AMTPTP_FRAME_CHECK
+AmtPtpDecodeFrameSalvage(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	SIZE_T Complete;
+
+	if (AmtPtpDecodeFrame(Config, Buffer, Length, Frame) == AmtPtpDecodeOk) {
+		return AmtPtpFrameIntact;
+	}
+
+	// SPI frames already decode with trailing data, there is nothing to cut
+	if (Config->Format == AmtPtpFrameFormatSpi || Config->FingerSize == 0 || Length <= Config->HeaderSize) {
+		return AmtPtpFrameCorrupt;
+	}
+
+	Complete = Config->HeaderSize + (Length - Config->HeaderSize) / Config->FingerSize * Config->FingerSize;
+	if (Complete == Length || AmtPtpDecodeFrame(Config, Buffer, Complete, Frame) != AmtPtpDecodeOk) {
+		return AmtPtpFrameCorrupt;
+	}
+
+	return AmtPtpFrameSalvaged;
+}
+
+AMTPTP_FRAME_VERDICT
+AmtPtpErrorBudgetRecord(
+	_Inout_ PAMTPTP_ERROR_BUDGET Budget,
+	_In_ AMTPTP_FRAME_CHECK Check,
+	_In_ ULONGLONG HostTime
+)
+{
+	if (Check != AmtPtpFrameCorrupt) {
+		if (Check == AmtPtpFrameSalvaged) {
+			Budget->Salvaged++;
+		}
+
+		if (Budget->Losing) {
+			Budget->LostTime += HostTime - Budget->LastDelivered;
+			Budget->Losing = FALSE;
+		}
+
+		Budget->Delivered = TRUE;
+		Budget->LastDelivered = HostTime;
+		return AmtPtpFrameDeliver;
+	}
+
+	// Input is lost from the last frame that made it through
+	if (!Budget->Losing) {
+		Budget->Losing = TRUE;
+		if (!Budget->Delivered) {
+			Budget->LastDelivered = HostTime;
+		}
+	}
+
+	Budget->Times[Budget->Head] = HostTime;
+	Budget->Head = (Budget->Head + 1) % Budget->Limit;
+	if (Budget->Count < Budget->Limit) {
+		Budget->Count++;
+	}
+
+	// The reset gets a fresh budget
+	if (Budget->Count == Budget->Limit && HostTime - Budget->Times[Budget->Head] <= Budget->Window) {
+		Budget->Count = 0;
+		Budget->Head = 0;
+		Budget->Resets++;
+		return AmtPtpFrameReset;
+	}
+
+	Budget->Dropped++;
+	return AmtPtpFrameDrop;
+}
+
+VOID
+AmtPtpErrorBudgetReset(
+	_Inout_ PAMTPTP_ERROR_BUDGET Budget
+)
+{
+	Budget->Count = 0;
+	Budget->Head = 0;
+	Budget->Delivered = FALSE;
+	Budget->Losing = FALSE;
+}
@@ -0,0 +1,188 @@
+// AmtPtpHidReportLayout.c: Report sizes declared by a HID report descriptor
+
+#include <AmtPtpHidReportLayout.h>
+
+/* item prefix fields, HID 1.11 section 6.2.2.2 */
+#define HID_ITEM_LONG			0xfe
+#define HID_ITEM_SIZE(b)		((b) & 0x03)
+#define HID_ITEM_TYPE(b)		(((b) >> 2) & 0x03)
+#define HID_ITEM_TAG(b)			((b) >> 4)
+
+#define HID_TYPE_MAIN			0
+#define HID_TYPE_GLOBAL			1
+
+#define HID_MAIN_INPUT			0x8
+#define HID_MAIN_OUTPUT			0x9
+#define HID_MAIN_COLLECTION		0xa
+#define HID_MAIN_FEATURE		0xb
+#define HID_MAIN_END_COLLECTION	0xc
+
+#define HID_GLOBAL_REPORT_SIZE	0x7
+#define HID_GLOBAL_REPORT_ID	0x8
+#define HID_GLOBAL_REPORT_COUNT	0x9
+#define HID_GLOBAL_PUSH			0xa
+#define HID_GLOBAL_POP			0xb
+
+/* hidclass reports are at most 64 KB */
+#define HID_MAX_REPORT_BITS		(0xffffULL * 8)
+
+typedef struct _HID_GLOBAL_STATE {
+	ULONG	ReportSize;
+	ULONG	ReportCount;
+	ULONG	ReportId;
+} HID_GLOBAL_STATE;
+
+static const UCHAR AmtPtpHidMainTag[] = {
+	HID_MAIN_INPUT,		/* AmtPtpHidReportInput */
+	HID_MAIN_OUTPUT,	/* AmtPtpHidReportOutput */
+	HID_MAIN_FEATURE	/* AmtPtpHidReportFeature */
+};
+
+AMTPTP_HID_LAYOUT_RESULT
+AmtPtpHidGetReportSize(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_ AMTPTP_HID_REPORT_TYPE Type,
+	_In_ UCHAR ReportId,
+	_Out_ PULONG Size
+)
+{
+	HID_GLOBAL_STATE Global = { 0 };
+	HID_GLOBAL_STATE Stack[AMTPTP_HID_GLOBAL_STACK_DEPTH];
+	ULONG StackDepth = 0;
+	ULONG CollectionDepth = 0;
+	ULONGLONG Bits = 0;
+	BOOLEAN Declared = FALSE;
+	BOOLEAN UsesReportIds = FALSE;
+	ULONG Offset = 0;
+
+	*Size = 0;
+
+	while (Offset < Length) {
+		UCHAR Prefix = Descriptor[Offset];
+		ULONG DataSize;
+		ULONG Data = 0;
+		ULONG i;
+
+		// Long items carry their size in the next byte and never affect the layout
+		if (Prefix == HID_ITEM_LONG) {
+			if (Length - Offset < 3) {
+				return AmtPtpHidLayoutTruncated;
+			}
+
+			DataSize = Descriptor[Offset + 1];
+			if (Length - Offset - 3 < DataSize) {
+				return AmtPtpHidLayoutTruncated;
+			}
+
+			Offset += 3 + DataSize;
+			continue;
+		}
+
+		DataSize = HID_ITEM_SIZE(Prefix) == 3 ? 4 : HID_ITEM_SIZE(Prefix);
+		if (Length - Offset - 1 < DataSize) {
+			return AmtPtpHidLayoutTruncated;
+		}
+
+		for (i = 0; i < DataSize; i++) {
+			Data |= (ULONG) Descriptor[Offset + 1 + i] << (i * 8);
+		}
+
+		Offset += 1 + DataSize;
+
+		if (HID_ITEM_TYPE(Prefix) == HID_TYPE_MAIN) {
+			switch (HID_ITEM_TAG(Prefix)) {
+			case HID_MAIN_COLLECTION:
+				CollectionDepth++;
+				break;
+			case HID_MAIN_END_COLLECTION:
+				if (CollectionDepth == 0) {
+					return AmtPtpHidLayoutUnbalanced;
+				}
+				CollectionDepth--;
+				break;
+			default:
+				if (HID_ITEM_TAG(Prefix) == AmtPtpHidMainTag[Type] && Global.ReportId == ReportId) {
+					Bits += (ULONGLONG) Global.ReportSize * Global.ReportCount;
+					if (Bits > HID_MAX_REPORT_BITS) {
+						return AmtPtpHidLayoutInvalidItem;
+					}
+					Declared = TRUE;
+				}
+				break;
+			}
+		}
+		else if (HID_ITEM_TYPE(Prefix) == HID_TYPE_GLOBAL) {
+			switch (HID_ITEM_TAG(Prefix)) {
+			case HID_GLOBAL_REPORT_SIZE:
+				Global.ReportSize = Data;
+				break;
+			case HID_GLOBAL_REPORT_COUNT:
+				Global.ReportCount = Data;
+				break;
+			case HID_GLOBAL_REPORT_ID:
+				if (Data == 0 || Data > 0xff) {
+					return AmtPtpHidLayoutInvalidItem;
+				}
+				Global.ReportId = Data;
+				UsesReportIds = TRUE;
+				break;
+			case HID_GLOBAL_PUSH:
+				if (StackDepth == AMTPTP_HID_GLOBAL_STACK_DEPTH) {
+					return AmtPtpHidLayoutUnbalanced;
+				}
+				Stack[StackDepth++] = Global;
+				break;
+			case HID_GLOBAL_POP:
+				if (StackDepth == 0) {
+					return AmtPtpHidLayoutUnbalanced;
+				}
+				Global = Stack[--StackDepth];
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	if (CollectionDepth != 0) {
+		return AmtPtpHidLayoutUnbalanced;
+	}
+
+	if (Declared) {
+		*Size = (ULONG) ((Bits + 7) / 8) + (UsesReportIds ? 1 : 0);
+	}
+
+	return AmtPtpHidLayoutOk;
+}
+
+AMTPTP_HID_LAYOUT_RESULT
+AmtPtpHidVerifyReportSizes(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_reads_(Count) const AMTPTP_HID_REPORT_SIZE* Expected,
+	_In_ ULONG Count,
+	_Out_opt_ AMTPTP_HID_REPORT_SIZE* Mismatch
+)
+{
+	AMTPTP_HID_LAYOUT_RESULT Result;
+	ULONG Size;
+	ULONG i;
+
+	for (i = 0; i < Count; i++) {
+		Result = AmtPtpHidGetReportSize(Descriptor, Length, Expected[i].Type, Expected[i].ReportId, &Size);
+		if (Result != AmtPtpHidLayoutOk) {
+			return Result;
+		}
+
+		if (Size != Expected[i].Size) {
+			if (Mismatch != NULL) {
+				*Mismatch = Expected[i];
+				Mismatch->Size = Size;
+			}
+			return AmtPtpHidLayoutMismatch;
+		}
+	}
+
+	return AmtPtpHidLayoutOk;
+}
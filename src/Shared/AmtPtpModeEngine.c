@@ -0,0 +1,141 @@
+// AmtPtpModeEngine.c: Wellspring mode transitions without blocking the caller
+
+#include <AmtPtpModeEngine.h>
+
+static AMTPTP_MODE_STEP
+AmtPtpModeEngineNext(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine
+)
+{
+	if (!Engine->ResetPending && (Engine->Target == Engine->Known || Engine->Target == AmtPtpModeUnknown)) {
+		Engine->Resetting = FALSE;
+		return AmtPtpModeStepNone;
+	}
+
+	// Writes patch one byte, the rest of the block has to come from the device
+	if (!Engine->BlockValid) {
+		Engine->InFlight = AmtPtpModeStepRead;
+		Engine->Transfers++;
+		return AmtPtpModeStepRead;
+	}
+
+	Engine->Writing = Engine->ResetPending ? AmtPtpModeMouse : Engine->Target;
+	Engine->ResetPending = FALSE;
+	Engine->Block[Engine->Switch.SwitchOffset] = (Engine->Writing == AmtPtpModeWellspring) ?
+		Engine->Switch.On : Engine->Switch.Off;
+
+	Engine->InFlight = AmtPtpModeStepWrite;
+	Engine->Transfers++;
+	return AmtPtpModeStepWrite;
+}
+
+BOOLEAN
+AmtPtpModeEngineInitialize(
+	_Out_ PAMTPTP_MODE_ENGINE Engine,
+	_In_ const AMTPTP_MODE_SWITCH* Switch
+)
+{
+	RtlZeroMemory(Engine, sizeof(AMTPTP_MODE_ENGINE));
+
+	if (Switch->Length > AMTPTP_MODE_BLOCK_MAX_SIZE || (Switch->Length != 0 && Switch->SwitchOffset >= Switch->Length)) {
+		return FALSE;
+	}
+
+	Engine->Switch = *Switch;
+	return TRUE;
+}
+
+AMTPTP_MODE_STEP
+AmtPtpModeEngineRequest(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine,
+	_In_ AMTPTP_MODE Mode
+)
+{
+	Engine->Target = Mode;
+
+	// Type 3 does not need a mode switch
+	if (Engine->Switch.Length == 0) {
+		Engine->Known = Mode;
+		Engine->Skipped++;
+		return AmtPtpModeStepNone;
+	}
+
+	if (Engine->InFlight != AmtPtpModeStepNone) {
+		return AmtPtpModeStepNone;
+	}
+
+	if (!Engine->ResetPending && Mode == Engine->Known) {
+		Engine->Skipped++;
+		return AmtPtpModeStepNone;
+	}
+
+	return AmtPtpModeEngineNext(Engine);
+}
+
+AMTPTP_MODE_STEP
+AmtPtpModeEngineReset(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine
+)
+{
+	if (Engine->Resetting) {
+		Engine->Coalesced++;
+		return AmtPtpModeStepNone;
+	}
+
+	Engine->Target = AmtPtpModeWellspring;
+	if (Engine->Switch.Length == 0) {
+		Engine->Known = AmtPtpModeWellspring;
+		return AmtPtpModeStepNone;
+	}
+
+	Engine->Resetting = TRUE;
+	Engine->ResetPending = TRUE;
+
+	if (Engine->InFlight != AmtPtpModeStepNone) {
+		return AmtPtpModeStepNone;
+	}
+
+	return AmtPtpModeEngineNext(Engine);
+}
+
+AMTPTP_MODE_STEP
+AmtPtpModeEngineComplete(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine,
+	_In_ BOOLEAN Success
+)
+{
+	AMTPTP_MODE_STEP Step = Engine->InFlight;
+
+	Engine->InFlight = AmtPtpModeStepNone;
+
+	if (!Success) {
+		Engine->Failures++;
+		Engine->Known = AmtPtpModeUnknown;
+		Engine->ResetPending = FALSE;
+		Engine->Resetting = FALSE;
+		if (Step == AmtPtpModeStepRead) {
+			Engine->BlockValid = FALSE;
+		}
+		return AmtPtpModeStepNone;
+	}
+
+	if (Step == AmtPtpModeStepRead) {
+		Engine->BlockValid = TRUE;
+		Engine->Known = (Engine->Block[Engine->Switch.SwitchOffset] == Engine->Switch.On) ?
+			AmtPtpModeWellspring : AmtPtpModeMouse;
+	}
+	else if (Step == AmtPtpModeStepWrite) {
+		Engine->Known = Engine->Writing;
+	}
+
+	return AmtPtpModeEngineNext(Engine);
+}
+
+VOID
+AmtPtpModeEngineInvalidate(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine
+)
+{
+	Engine->Known = AmtPtpModeUnknown;
+	Engine->BlockValid = FALSE;
+}
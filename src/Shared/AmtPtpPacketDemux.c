@@ -0,0 +1,118 @@
+// AmtPtpPacketDemux.c: Reports packed into one Magic Trackpad 2 transfer
+
+#include <AmtPtpPacketDemux.h>
+
+static VOID
+AmtPtpPacketDemuxPush(
+	_Inout_ PAMTPTP_PACKET_DEMUX Demux,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_ ULONG Depth
+)
+{
+	if (Length == 0) {
+		return;
+	}
+
+	Demux->Pending[Demux->Count].Buffer = Buffer;
+	Demux->Pending[Demux->Count].Length = Length;
+	Demux->Pending[Demux->Count].Depth = Depth;
+	Demux->Count++;
+}
+
+// Skips the mouse reports in front of a USB frame, each one is consumed as a whole
+static const UCHAR*
+AmtPtpPacketDemuxSkipMouse(
+	_In_reads_bytes_(*Length) const UCHAR* Buffer,
+	_Inout_ SIZE_T* Length
+)
+{
+	while (Buffer[0] == AMTPTP_DEMUX_MOUSE && *Length > AMTPTP_MT2_MOUSE_REPORT_SIZE) {
+		Buffer += AMTPTP_MT2_MOUSE_REPORT_SIZE;
+		*Length -= AMTPTP_MT2_MOUSE_REPORT_SIZE;
+	}
+
+	return Buffer;
+}
+
+BOOLEAN
+AmtPtpPacketDemuxSingle(
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ const UCHAR** Report,
+	_Out_ SIZE_T* ReportLength
+)
+{
+	*Report = NULL;
+	*ReportLength = 0;
+
+	if (Length == 0) {
+		return FALSE;
+	}
+
+	Buffer = AmtPtpPacketDemuxSkipMouse(Buffer, &Length);
+	if (Buffer[0] == AMTPTP_DEMUX_COMBINED) {
+		return FALSE;
+	}
+
+	*Report = Buffer;
+	*ReportLength = Length;
+	return TRUE;
+}
+
+VOID
+AmtPtpPacketDemuxBegin(
+	_Out_ PAMTPTP_PACKET_DEMUX Demux,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length
+)
+{
+	Demux->Count = 0;
+	Demux->Reports = 0;
+	Demux->Malformed = 0;
+	AmtPtpPacketDemuxPush(Demux, Buffer, Length, 0);
+}
+
+AMTPTP_DEMUX_RESULT
+AmtPtpPacketDemuxNext(
+	_Inout_ PAMTPTP_PACKET_DEMUX Demux,
+	_Out_ const UCHAR** Report,
+	_Out_ SIZE_T* Length
+)
+{
+	const UCHAR* Buffer;
+	SIZE_T Remaining;
+	SIZE_T FirstLength;
+	ULONG Depth;
+
+	*Report = NULL;
+	*Length = 0;
+
+	while (Demux->Count > 0) {
+		Demux->Count--;
+		Buffer = Demux->Pending[Demux->Count].Buffer;
+		Remaining = Demux->Pending[Demux->Count].Length;
+		Depth = Demux->Pending[Demux->Count].Depth;
+
+		Buffer = AmtPtpPacketDemuxSkipMouse(Buffer, &Remaining);
+		if (Buffer[0] != AMTPTP_DEMUX_COMBINED) {
+			Demux->Reports++;
+			*Report = Buffer;
+			*Length = Remaining;
+			return AmtPtpDemuxReport;
+		}
+
+		// 0xF7, length of the first report, first report, second report
+		if (Remaining < 2 || (SIZE_T) Buffer[1] > Remaining - 2 || Depth == AMTPTP_DEMUX_MAX_DEPTH) {
+			Demux->Malformed++;
+			return AmtPtpDemuxMalformed;
+		}
+
+		// The second part goes first so that the first part is handed out first
+		FirstLength = Buffer[1];
+		AmtPtpPacketDemuxPush(Demux, Buffer + 2 + FirstLength, Remaining - 2 - FirstLength, Depth + 1);
+		AmtPtpPacketDemuxPush(Demux, Buffer + 2, FirstLength, Depth + 1);
+	}
+
+	return AmtPtpDemuxDone;
+}
@@ -0,0 +1,52 @@
+// AmtPtpPerfCounters.c: Input path counters that are always on
+
+#include <AmtPtpPerfCounters.h>
+
+static_assert(sizeof(AMTPTP_PERF_COUNTERS) == AMTPTP_PERF_COUNTER_COUNT * sizeof(LONG), "Snapshot must cover every counter");
+
+VOID
+AmtPtpPerfCountersInitialize(
+	_Out_ PAMTPTP_PERF_COUNTERS Counters
+)
+{
+	RtlZeroMemory((PVOID) Counters, sizeof(AMTPTP_PERF_COUNTERS));
+}
+
+VOID
+AmtPtpPerfCountersRecordLatency(
+	_Inout_ PAMTPTP_PERF_COUNTERS Counters,
+	_In_ ULONGLONG Ticks,
+	_In_ ULONGLONG Frequency
+)
+{
+	ULONGLONG Microseconds;
+	ULONG Bucket = 0;
+
+	// A second or more only happens across a stall, it also keeps the product in range
+	if (Frequency == 0 || Ticks >= Frequency) {
+		Bucket = AMTPTP_PERF_LATENCY_BUCKETS - 1;
+	}
+	else {
+		Microseconds = Ticks * 1000000 / Frequency;
+		while (Microseconds != 0 && Bucket < AMTPTP_PERF_LATENCY_BUCKETS - 1) {
+			Microseconds >>= 1;
+			Bucket++;
+		}
+	}
+
+	InterlockedIncrement(&Counters->Latency[Bucket]);
+}
+
+VOID
+AmtPtpPerfCountersSnapshot(
+	_In_ const AMTPTP_PERF_COUNTERS* Counters,
+	_Out_writes_(AMTPTP_PERF_COUNTER_COUNT) ULONG* Values
+)
+{
+	const volatile LONG* Counter = &Counters->FramesIn;
+	ULONG i;
+
+	for (i = 0; i < AMTPTP_PERF_COUNTER_COUNT; i++) {
+		Values[i] = (ULONG) Counter[i];
+	}
+}
@@ -0,0 +1,186 @@
+// AmtPtpReportRing.c: Bounded backlog of decoded touch frames
+
+#include <AmtPtpReportRing.h>
+
+VOID
+AmtPtpReportRingInitialize(
+	_Out_ PAMTPTP_REPORT_RING Ring,
+	_In_ ULONG Depth,
+	_In_ AMTPTP_RING_OVERFLOW_POLICY Policy
+)
+{
+	RtlZeroMemory(Ring, sizeof(AMTPTP_REPORT_RING));
+
+	if (Depth == 0) Depth = 1;
+	if (Depth > AMTPTP_REPORT_RING_MAX_DEPTH) Depth = AMTPTP_REPORT_RING_MAX_DEPTH;
+	if (Policy >= AmtPtpRingOverflowMax) Policy = AmtPtpRingOverflowDropOldest;
+
+	// Keep slot selection continuous when the free running indices wrap
+	while (Depth & (Depth - 1)) Depth &= Depth - 1;
+
+	Ring->Depth = Depth;
+	Ring->Policy = Policy;
+}
+
+//
+// Folds Frame into Target so that Target describes the latest state of every
+// contact seen in either. Contacts only present in Target are kept, which
+// preserves a lift-off that hidclass has not seen yet. Returns FALSE when the
+// merge would lose information, leaving Target untouched.
+//
+static BOOLEAN
+AmtPtpReportRingCoalesce(
+	_Inout_ PAMTPTP_DECODED_FRAME Target,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+)
+{
+	AMTPTP_DECODED_FRAME merged;
+	UCHAR i, j;
+
+	// Part of a scan already went out as hybrid reports
+	if (Target->FirstContact != 0 || Frame->FirstContact != 0) {
+		return FALSE;
+	}
+
+	RtlCopyMemory(&merged, Target, sizeof(AMTPTP_DECODED_FRAME));
+
+	for (i = 0; i < Frame->ContactCount; i++) {
+		for (j = 0; j < merged.ContactCount; j++) {
+			if (merged.Contacts[j].ContactID == Frame->Contacts[i].ContactID) {
+				break;
+			}
+		}
+
+		if (j == merged.ContactCount) {
+			if (merged.ContactCount >= AMTPTP_DECODER_MAX_CONTACTS) {
+				return FALSE;
+			}
+			merged.ContactCount++;
+		} else if (!merged.Contacts[j].TipSwitch && Frame->Contacts[i].TipSwitch) {
+			// The ID was lifted and reused, overwriting it would hide the lift-off
+			return FALSE;
+		}
+
+		merged.Contacts[j] = Frame->Contacts[i];
+	}
+
+	merged.DeviceTime = Frame->DeviceTime;
+	merged.HasDeviceTime = Frame->HasDeviceTime;
+	merged.ScanTime = Frame->ScanTime;
+	merged.IsButtonClicked = Frame->IsButtonClicked;
+
+	RtlCopyMemory(Target, &merged, sizeof(AMTPTP_DECODED_FRAME));
+	return TRUE;
+}
+
+AMTPTP_RING_PUSH_RESULT
+AmtPtpReportRingPush(
+	_Inout_ PAMTPTP_REPORT_RING Ring,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+)
+{
+	AMTPTP_RING_PUSH_RESULT result = AmtPtpRingPushQueued;
+	ULONG count;
+
+	if (AmtPtpReportRingCount(Ring) >= Ring->Depth) {
+		if (Ring->Policy == AmtPtpRingOverflowCoalesce &&
+			AmtPtpReportRingCoalesce(&Ring->Slots[(Ring->Head - 1) % Ring->Depth], Frame)) {
+			Ring->Coalesced++;
+			return AmtPtpRingPushCoalesced;
+		}
+
+		// Make room by discarding the oldest frame
+		Ring->Tail++;
+		Ring->Dropped++;
+		result = AmtPtpRingPushDroppedOldest;
+	}
+
+	RtlCopyMemory(&Ring->Slots[Ring->Head % Ring->Depth], Frame, sizeof(AMTPTP_DECODED_FRAME));
+	Ring->Head++;
+
+	count = AmtPtpReportRingCount(Ring);
+	if (count > Ring->HighWatermark) {
+		Ring->HighWatermark = count;
+	}
+
+	return result;
+}
+
+//
+// Parks what is left of Frame after its first report went out. The caller
+// only takes a pending read for a frame while the ring is empty, so the
+// remainder ends up first in line. Hidclass may still hold more reads than
+// that; the caller hands parked reports to them before looking at the next
+// frame, and a frame that finds the ring busy is parked behind the remainder.
+//
+AMTPTP_RING_PUSH_RESULT
+AmtPtpReportRingPushRemainder(
+	_Inout_ PAMTPTP_REPORT_RING Ring,
+	_In_ const AMTPTP_DECODED_FRAME* Frame,
+	_In_ UCHAR ContactsPerReport
+)
+{
+	AMTPTP_DECODED_FRAME remainder;
+
+	RtlCopyMemory(&remainder, Frame, sizeof(AMTPTP_DECODED_FRAME));
+	remainder.FirstContact = Frame->FirstContact + ContactsPerReport;
+	return AmtPtpReportRingPush(Ring, &remainder);
+}
+
+BOOLEAN
+AmtPtpReportRingPeek(
+	_In_ const AMTPTP_REPORT_RING* Ring,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	if (AmtPtpReportRingCount(Ring) == 0) {
+		return FALSE;
+	}
+
+	RtlCopyMemory(Frame, &Ring->Slots[Ring->Tail % Ring->Depth], sizeof(AMTPTP_DECODED_FRAME));
+	return TRUE;
+}
+
+VOID
+AmtPtpReportRingAdvance(
+	_Inout_ PAMTPTP_REPORT_RING Ring,
+	_In_ UCHAR ContactsPerReport
+)
+{
+	PAMTPTP_DECODED_FRAME slot;
+
+	if (AmtPtpReportRingCount(Ring) == 0) {
+		return;
+	}
+
+	// Keep the scan until its last hybrid report is out
+	slot = &Ring->Slots[Ring->Tail % Ring->Depth];
+	if (ContactsPerReport != 0 && slot->ContactCount > slot->FirstContact + ContactsPerReport) {
+		slot->FirstContact += ContactsPerReport;
+	} else {
+		Ring->Tail++;
+	}
+}
+
+BOOLEAN
+AmtPtpReportRingPop(
+	_Inout_ PAMTPTP_REPORT_RING Ring,
+	_In_ UCHAR ContactsPerReport,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+)
+{
+	if (!AmtPtpReportRingPeek(Ring, Frame)) {
+		return FALSE;
+	}
+
+	AmtPtpReportRingAdvance(Ring, ContactsPerReport);
+	return TRUE;
+}
+
+VOID
+AmtPtpReportRingFlush(
+	_Inout_ PAMTPTP_REPORT_RING Ring
+)
+{
+	Ring->Tail = Ring->Head;
+}
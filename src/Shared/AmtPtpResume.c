@@ -0,0 +1,93 @@
+// AmtPtpResume.c: Resume phases and retry backoff after D0 entry
+
+#include <AmtPtpResume.h>
+
+#define AMTPTP_RESUME_REACHED(Phase)	(1u << (Phase))
+
+/* milliseconds, the last entry repeats */
+static const ULONG AmtPtpResumeBackoff[] = { 10, 50, 200, 500, 1000 };
+
+VOID
+AmtPtpResumeInitialize(
+	_Out_ PAMTPTP_RESUME Resume
+)
+{
+	RtlZeroMemory(Resume, sizeof(AMTPTP_RESUME));
+}
+
+VOID
+AmtPtpResumeBegin(
+	_Inout_ PAMTPTP_RESUME Resume,
+	_In_ ULONGLONG HostTime
+)
+{
+	RtlZeroMemory(Resume->Stamp, sizeof(Resume->Stamp));
+	Resume->Reached = AMTPTP_RESUME_REACHED(AmtPtpResumeEntered);
+	Resume->Stamp[AmtPtpResumeEntered] = HostTime;
+	Resume->Attempts = 0;
+	Resume->Resumes++;
+}
+
+BOOLEAN
+AmtPtpResumeMark(
+	_Inout_ PAMTPTP_RESUME Resume,
+	_In_ AMTPTP_RESUME_PHASE Phase,
+	_In_ ULONGLONG HostTime
+)
+{
+	if (Phase >= AmtPtpResumePhaseMax) {
+		return FALSE;
+	}
+
+	// Recoveries later in the session start from the shortest delay again
+	if (Phase == AmtPtpResumeConfigured) {
+		Resume->Attempts = 0;
+	}
+
+	if (Resume->Reached & AMTPTP_RESUME_REACHED(Phase)) {
+		return FALSE;
+	}
+
+	Resume->Reached |= AMTPTP_RESUME_REACHED(Phase);
+	Resume->Stamp[Phase] = HostTime;
+
+	if (Phase == AmtPtpResumeFirstReport) {
+		Resume->LastFirstReport = AmtPtpResumeElapsed(Resume, Phase);
+		if (Resume->LastFirstReport > Resume->MaxFirstReport) {
+			Resume->MaxFirstReport = Resume->LastFirstReport;
+		}
+	}
+
+	return TRUE;
+}
+
+ULONG
+AmtPtpResumeNextRetry(
+	_Inout_ PAMTPTP_RESUME Resume
+)
+{
+	ULONG Step = Resume->Attempts;
+	ULONG Last = sizeof(AmtPtpResumeBackoff) / sizeof(AmtPtpResumeBackoff[0]) - 1;
+
+	if (Step > Last) {
+		Step = Last;
+	}
+
+	Resume->Attempts++;
+	Resume->Retries++;
+	return AmtPtpResumeBackoff[Step];
+}
+
+ULONGLONG
+AmtPtpResumeElapsed(
+	_In_ const AMTPTP_RESUME* Resume,
+	_In_ AMTPTP_RESUME_PHASE Phase
+)
+{
+	if (Phase >= AmtPtpResumePhaseMax || !(Resume->Reached & AMTPTP_RESUME_REACHED(AmtPtpResumeEntered)) ||
+		!(Resume->Reached & AMTPTP_RESUME_REACHED(Phase))) {
+		return 0;
+	}
+
+	return Resume->Stamp[Phase] - Resume->Stamp[AmtPtpResumeEntered];
+}
@@ -0,0 +1,69 @@
+// AmtPtpScanClock.c: PTP ScanTime from device or host time
+
+#include <AmtPtpScanClock.h>
+
+VOID
+AmtPtpScanClockInitialize(
+	_Out_ PAMTPTP_SCAN_CLOCK Clock,
+	_In_ ULONG DeviceMask
+)
+{
+	RtlZeroMemory(Clock, sizeof(AMTPTP_SCAN_CLOCK));
+	Clock->DeviceMask = DeviceMask;
+}
+
+VOID
+AmtPtpScanClockUpdate(
+	_Inout_ PAMTPTP_SCAN_CLOCK Clock,
+	_Inout_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ ULONGLONG HostTime
+)
+{
+	ULONGLONG hostDelta = 0;
+	ULONGLONG deviceDelta;
+	ULONGLONG delta;
+
+	// Host time in ScanTime units, the host clock never goes backwards
+	if (Clock->HostSynced && HostTime > Clock->LastHostTime) {
+		hostDelta = (HostTime - Clock->LastHostTime) / 1000;
+	}
+	delta = hostDelta;
+
+	if (Clock->DeviceMask != 0 && Frame->HasDeviceTime) {
+		if (Clock->DeviceSynced) {
+			deviceDelta = (ULONGLONG) ((Frame->DeviceTime - Clock->LastDeviceTime) & Clock->DeviceMask) *
+				AMTPTP_SCAN_CLOCK_TICKS_PER_MS;
+
+			// Past one wrap of the device counter the difference is ambiguous
+			if (hostDelta + AMTPTP_SCAN_CLOCK_SLACK < (ULONGLONG) Clock->DeviceMask * AMTPTP_SCAN_CLOCK_TICKS_PER_MS &&
+				deviceDelta <= hostDelta + AMTPTP_SCAN_CLOCK_SLACK &&
+				hostDelta <= deviceDelta + AMTPTP_SCAN_CLOCK_SLACK) {
+				delta = deviceDelta;
+			} else {
+				Clock->Resyncs++;
+			}
+		}
+
+		Clock->LastDeviceTime = Frame->DeviceTime;
+		Clock->DeviceSynced = TRUE;
+	}
+
+	Clock->LastHostTime = HostTime;
+	Clock->HostSynced = TRUE;
+
+	// Wraps at 16 bits like hidclass expects
+	Clock->ScanTime = (USHORT) (Clock->ScanTime + (USHORT) delta);
+	Frame->ScanTime = Clock->ScanTime;
+}
+
+//
+// Called when the device leaves D0. Its clock may restart from anything, so
+// the next frame is timed by the host. ScanTime itself keeps counting.
+//
+VOID
+AmtPtpScanClockReset(
+	_Inout_ PAMTPTP_SCAN_CLOCK Clock
+)
+{
+	Clock->DeviceSynced = FALSE;
+}
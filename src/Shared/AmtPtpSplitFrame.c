@@ -0,0 +1,88 @@
+// AmtPtpSplitFrame.c: Reassembly of touch frames split across two reports
+
+#include <AmtPtpSplitFrame.h>
+
+VOID
+AmtPtpSplitFrameInitialize(
+	_Out_ PAMTPTP_SPLIT_FRAME Split,
+	_In_ ULONGLONG Timeout
+)
+{
+	RtlZeroMemory(Split, sizeof(AMTPTP_SPLIT_FRAME));
+	Split->Timeout = Timeout;
+}
+
+AMTPTP_SPLIT_RESULT
+AmtPtpSplitFrameFirst(
+	_Inout_ PAMTPTP_SPLIT_FRAME Split,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG Now
+)
+{
+	// The second half of the previous frame never came
+	if (Split->Length != 0) {
+		Split->Abandoned++;
+		Split->Length = 0;
+	}
+
+	// An empty first half can't be told apart from "nothing staged"
+	if (Length == 0 || Length >= AMTPTP_SPLIT_FRAME_MAX_SIZE) {
+		Split->Overflowed++;
+		return AmtPtpSplitOverflow;
+	}
+
+	RtlCopyMemory(Split->Buffer, Buffer, Length);
+	Split->Length = Length;
+	Split->FirstTime = Now;
+	return AmtPtpSplitPending;
+}
+
+AMTPTP_SPLIT_RESULT
+AmtPtpSplitFrameSecond(
+	_Inout_ PAMTPTP_SPLIT_FRAME Split,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG Now,
+	_Out_ const UCHAR** Frame,
+	_Out_ SIZE_T* FrameLength
+)
+{
+	SIZE_T firstLength = Split->Length;
+
+	*Frame = NULL;
+	*FrameLength = 0;
+
+	// Whatever happens below, the staged half is used up
+	Split->Length = 0;
+
+	if (firstLength == 0) {
+		Split->Orphaned++;
+		return AmtPtpSplitOrphan;
+	}
+
+	if (Now < Split->FirstTime || Now - Split->FirstTime > Split->Timeout) {
+		Split->Expired++;
+		return AmtPtpSplitExpired;
+	}
+
+	if (Length > AMTPTP_SPLIT_FRAME_MAX_SIZE - firstLength) {
+		Split->Overflowed++;
+		return AmtPtpSplitOverflow;
+	}
+
+	RtlCopyMemory(Split->Buffer + firstLength, Buffer, Length);
+	Split->Completed++;
+
+	*Frame = Split->Buffer;
+	*FrameLength = firstLength + Length;
+	return AmtPtpSplitComplete;
+}
+
+VOID
+AmtPtpSplitFrameReset(
+	_Inout_ PAMTPTP_SPLIT_FRAME Split
+)
+{
+	Split->Length = 0;
+}
@@ -0,0 +1,57 @@
+// AmtPtpStatusFrame.c: In-band status frames of the Magic Trackpad 2
+
+#include <AmtPtpStatusFrame.h>
+
+VOID
+AmtPtpStatusCacheInitialize(
+	_Out_ PAMTPTP_STATUS_CACHE Cache
+)
+{
+	RtlZeroMemory(Cache, sizeof(AMTPTP_STATUS_CACHE));
+}
+
+AMTPTP_STATUS_ACTION
+AmtPtpStatusFrameRecord(
+	_Inout_ PAMTPTP_STATUS_CACHE Cache,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length
+)
+{
+	if (Length == 0) {
+		return AmtPtpStatusNone;
+	}
+
+	switch (Buffer[0]) {
+	case AMTPTP_STATUS_MOUSE:
+		Cache->MouseFrames++;
+		return AmtPtpStatusRearm;
+	case AMTPTP_STATUS_POWER_DOWN:
+		if (Length < 1 + sizeof(Cache->PowerDown)) {
+			break;
+		}
+		RtlCopyMemory(Cache->PowerDown, Buffer + 1, sizeof(Cache->PowerDown));
+		Cache->PowerDowns++;
+		return AmtPtpStatusCached;
+	case AMTPTP_STATUS_UNKNOWN:
+		if (Length < 1 + sizeof(Cache->Unknown)) {
+			break;
+		}
+		RtlCopyMemory(Cache->Unknown, Buffer + 1, sizeof(Cache->Unknown));
+		Cache->Unknowns++;
+		return AmtPtpStatusCached;
+	case AMTPTP_STATUS_BATTERY:
+		if (Length < 3) {
+			break;
+		}
+		Cache->BatteryFlags = Buffer[1];
+		Cache->BatteryLevel = Buffer[2];
+		Cache->BatteryValid = TRUE;
+		Cache->Battery++;
+		return AmtPtpStatusRearm;
+	default:
+		return AmtPtpStatusNone;
+	}
+
+	Cache->Truncated++;
+	return AmtPtpStatusTruncated;
+}
@@ -0,0 +1,105 @@
+// AmtPtpTraceRing.c: Per-frame trace budget, sampling and an in-memory event ring
+
+#include <AmtPtpTraceRing.h>
+
+static_assert((AMTPTP_TRACE_RING_SIZE & (AMTPTP_TRACE_RING_SIZE - 1)) == 0, "Ring size must be a power of two");
+static_assert((AMTPTP_TRACE_SAMPLE_INTERVAL & (AMTPTP_TRACE_SAMPLE_INTERVAL - 1)) == 0, "Sample interval must be a power of two");
+
+static const char* AmtPtpTraceEventNames[AmtPtpTraceEventMax] = {
+	"FrameIn",
+	"FrameRejected",
+	"FrameParked",
+	"FrameDropped",
+	"ReportOut",
+	"StatusFrame",
+};
+
+VOID
+AmtPtpTraceRingInitialize(
+	_Out_ PAMTPTP_TRACE_RING Ring
+)
+{
+	RtlZeroMemory((PVOID) Ring, sizeof(AMTPTP_TRACE_RING));
+}
+
+VOID
+AmtPtpTraceRingRecord(
+	_Inout_ PAMTPTP_TRACE_RING Ring,
+	_In_ AMTPTP_TRACE_EVENT Event,
+	_In_ ULONG Arg0,
+	_In_ ULONG Arg1,
+	_In_ ULONGLONG Time
+)
+{
+	ULONG Slot = (ULONG) InterlockedIncrement(&Ring->Next) - 1;
+	PAMTPTP_TRACE_RECORD Record = &Ring->Records[Slot & (AMTPTP_TRACE_RING_SIZE - 1)];
+
+	// Readers skip the slot until the new sequence is published
+	InterlockedExchange(&Record->Sequence, 0);
+	Record->Event = (ULONG) Event;
+	Record->Arg0 = Arg0;
+	Record->Arg1 = Arg1;
+	Record->Time = Time;
+	InterlockedExchange(&Record->Sequence, (LONG) (Slot + 1));
+}
+
+BOOLEAN
+AmtPtpTraceRingSample(
+	_Inout_ PAMTPTP_TRACE_RING Ring
+)
+{
+	return ((Ring->SampleCountdown++) & (AMTPTP_TRACE_SAMPLE_INTERVAL - 1)) == 0;
+}
+
+VOID
+AmtPtpTraceRingBegin(
+	_In_ const AMTPTP_TRACE_RING* Ring,
+	_Out_ AMTPTP_TRACE_CURSOR* Cursor
+)
+{
+	Cursor->End = (ULONG) InterlockedCompareExchange((volatile LONG*) &Ring->Next, 0, 0);
+	Cursor->Position = (Cursor->End > AMTPTP_TRACE_RING_SIZE) ? Cursor->End - AMTPTP_TRACE_RING_SIZE : 0;
+}
+
+BOOLEAN
+AmtPtpTraceRingNext(
+	_In_ const AMTPTP_TRACE_RING* Ring,
+	_Inout_ AMTPTP_TRACE_CURSOR* Cursor,
+	_Out_ AMTPTP_TRACE_RECORD* Record
+)
+{
+	const AMTPTP_TRACE_RECORD* Slot;
+	LONG Sequence;
+
+	while (Cursor->Position != Cursor->End) {
+		Sequence = (LONG) (Cursor->Position + 1);
+		Slot = &Ring->Records[Cursor->Position & (AMTPTP_TRACE_RING_SIZE - 1)];
+		Cursor->Position++;
+
+		// Not written yet, being written or already reused by a newer frame
+		if (InterlockedCompareExchange((volatile LONG*) &Slot->Sequence, 0, 0) != Sequence) {
+			continue;
+		}
+
+		Record->Sequence = Sequence;
+		Record->Event = Slot->Event;
+		Record->Arg0 = Slot->Arg0;
+		Record->Arg1 = Slot->Arg1;
+		Record->Time = Slot->Time;
+
+		// A writer that took the slot meanwhile left a torn copy
+		if (InterlockedCompareExchange((volatile LONG*) &Slot->Sequence, 0, 0) == Sequence) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+const char*
+AmtPtpTraceEventName(
+	_In_ ULONG Event
+)
+{
+	return (Event < AmtPtpTraceEventMax) ? AmtPtpTraceEventNames[Event] : "Unknown";
+}
@@ -0,0 +1,93 @@
+// AmtPtpContactTracker.h: Stable PTP contact IDs across frames
+//
+// Raw frames carry up to 16 contacts. Their IDs are either the 4-bit device
+// id (Magic Trackpad 2, Wellspring) or just the slot index (SPI, and USB
+// devices decoded with AMTPTP_DECODER_FLAG_CONTACT_ID_FROM_SLOT). The PTP
+// report only has room for a few contacts, and Windows wants every contact to
+// keep its ID from touch-down to lift-off.
+//
+// AmtPtpContactTrackerUpdate rewrites a decoded frame in place:
+//   - Contacts are matched to the previous frame by device id. With slot ids
+//     they are matched to the nearest contact of the previous frame instead.
+//   - Each tracked contact keeps the PTP ID it was given at touch-down. An ID
+//     freed by a lift-off is not given out again in the same frame.
+//   - A reported contact that disappears without lifting gets a lift-off
+//     contact (TipSwitch = 0) at its last position.
+//   - When there are more contacts than MaxContacts, the ones already being
+//     reported go first, then tip-down ones, then confident ones. A contact
+//     hidclass has down that does not fit stays down for it and is lifted by
+//     a later update.
+//   - Positions of contacts seen in the previous frame are defuzzed the way
+//     the Linux input core does it: movement within half the fuzz is dropped,
+//     movement up to twice the fuzz is smoothed. Integer math only.
+//
+// The tracker does no locking. The caller serializes updates with the rest
+// of its input path.
+#pragma once
+
+#include <AmtPtpDecoder.h>
+
+// The report descriptors give the Contact Identifier a logical maximum of 15
+#define AMTPTP_TRACKER_MAX_IDS	16
+
+// Fuzz of an axis from its bcm5974 signal-to-noise ratio
+#define AMTPTP_FUZZ_FROM_SNRATIO(Min, Max, SnRatio) \
+	((USHORT) ((SnRatio) > 0 ? ((Max) - (Min)) / (SnRatio) : 0))
+
+typedef struct _AMTPTP_TRACKED_CONTACT {
+	AMTPTP_DECODED_CONTACT Last;	/* last raw state, ContactID is the device id */
+	UCHAR	Id;						/* PTP contact id */
+	BOOLEAN	InUse;
+	BOOLEAN	Reported;				/* hidclass has seen it */
+	BOOLEAN	Seen;					/* matched in the frame being processed */
+} AMTPTP_TRACKED_CONTACT, *PAMTPTP_TRACKED_CONTACT;
+
+typedef struct _AMTPTP_CONTACT_TRACKER {
+	BOOLEAN		MatchByPosition;	/* device ids are slot indices */
+	ULONGLONG	MatchDistance;		/* squared, largest jump still treated as the same contact */
+	USHORT		XFuzz;				/* 0 disables defuzz on the axis */
+	USHORT		YFuzz;
+
+	// Statistics, never reset by AmtPtpContactTrackerReset
+	ULONG	LiftOffs;				/* lift-offs synthesized for vanished contacts */
+	ULONG	Dropped;				/* contacts left out because of MaxContacts */
+
+	AMTPTP_TRACKED_CONTACT Contacts[AMTPTP_DECODER_MAX_CONTACTS];
+} AMTPTP_CONTACT_TRACKER, *PAMTPTP_CONTACT_TRACKER;
+
+VOID
+AmtPtpContactTrackerInitialize(
+	_Out_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_In_ const AMTPTP_DECODER_CONFIG* Config
+);
+
+VOID
+AmtPtpContactTrackerSetFuzz(
+	_Inout_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_In_ USHORT XFuzz,
+	_In_ USHORT YFuzz
+);
+
+VOID
+AmtPtpContactTrackerUpdate(
+	_Inout_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_Inout_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ UCHAR MaxContacts
+);
+
+//
+// Forgets every tracked contact. Frame gets a lift-off for each contact
+// hidclass still has down, the caller sends it before any new frame. The
+// lift-offs MaxContacts leaves out go out with the next call.
+//
+VOID
+AmtPtpContactTrackerLiftAll(
+	_Inout_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_Out_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ UCHAR MaxContacts
+);
+
+VOID
+AmtPtpContactTrackerReset(
+	_Inout_ PAMTPTP_CONTACT_TRACKER Tracker
+);
@@ -0,0 +1,247 @@
+// AmtPtpDecoder.h: Transport independent touch frame decoding
+//
+// The decoder turns a raw device frame into a list of contacts. It does not
+// know about PTP_REPORT, because each driver's report layout follows its own
+// report descriptor; AMTPTP_COMPOSE_REPORT copies a decoded frame into it.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+// Raw devices report up to 16 fingers, PTP_REPORT carries 5 of them
+#define AMTPTP_DECODER_MAX_CONTACTS 16
+
+/* Raw frame layouts understood by the decoder */
+typedef enum _AMTPTP_FRAME_FORMAT {
+	AmtPtpFrameFormatWellspring,	/* BCM5974 TYPE2 - TYPE4 (USB) */
+	AmtPtpFrameFormatMt2,			/* Magic Trackpad 2 report 0x31 (USB/BT, and TYPE5 after the mouse header) */
+	AmtPtpFrameFormatSpi,			/* SPI_TRACKPAD_PACKET */
+	AmtPtpFrameFormatMax
+} AMTPTP_FRAME_FORMAT;
+
+/* Decoder flags */
+#define AMTPTP_DECODER_FLAG_FINGER_OFFSET_IN_FRAME	0x1	/* Finger block offset is reported in frame byte 2 */
+#define AMTPTP_DECODER_FLAG_CONTACT_ID_FROM_SLOT	0x2	/* Use the slot index instead of the device contact id */
+#define AMTPTP_DECODER_FLAG_TIP_FROM_TOUCH_AREA		0x4	/* Derive tip switch and confidence from the touch ellipse */
+
+typedef struct _AMTPTP_DECODER_CONFIG AMTPTP_DECODER_CONFIG, *PAMTPTP_DECODER_CONFIG;
+typedef struct _AMTPTP_DECODED_FRAME AMTPTP_DECODED_FRAME, *PAMTPTP_DECODED_FRAME;
+typedef struct _AMTPTP_MT2_FINGER_BATCH AMTPTP_MT2_FINGER_BATCH, *PAMTPTP_MT2_FINGER_BATCH;
+
+typedef enum _AMTPTP_DECODE_RESULT {
+	AmtPtpDecodeOk,
+	AmtPtpDecodeMalformed,		/* Length does not match the frame layout */
+	AmtPtpDecodeUnsupported		/* Unknown frame format */
+} AMTPTP_DECODE_RESULT;
+
+typedef AMTPTP_DECODE_RESULT
+(*PFN_AMTPTP_DECODE_FRAME)(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+);
+
+/* Splits Count 9 byte Magic Trackpad 2 finger records, see AmtPtpUnpackMt2Fingers */
+typedef VOID
+(*PFN_AMTPTP_UNPACK_MT2_FINGERS)(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Count * 9) const UCHAR* Fingers,
+	_In_ SIZE_T Count,
+	_Out_ PAMTPTP_MT2_FINGER_BATCH Batch
+);
+
+/* Device metadata needed to decode a frame, filled once per device */
+struct _AMTPTP_DECODER_CONFIG {
+	PFN_AMTPTP_DECODE_FRAME Decode;	/* set by AmtPtpDecoderSelect */
+	PFN_AMTPTP_UNPACK_MT2_FINGERS UnpackMt2Fingers;	/* set by AmtPtpDecoderSelect */
+	AMTPTP_FRAME_FORMAT Format;
+	ULONG	Flags;
+	ULONG	HeaderSize;		/* bytes in header block */
+	ULONG	FingerOffset;	/* offset to first finger record */
+	ULONG	FingerSize;		/* bytes in single finger block */
+	ULONG	ButtonOffset;	/* offset to button data */
+	LONG	XMin;
+	LONG	XMax;
+	LONG	YMin;
+	LONG	YMax;
+};
+
+typedef struct _AMTPTP_DECODED_CONTACT {
+	USHORT	X;
+	USHORT	Y;
+	UCHAR	ContactID;
+	UCHAR	TipSwitch;
+	UCHAR	Confidence;
+	UCHAR	Finger;			/* device finger class, 6/7 = palm */
+	USHORT	TouchMajor;
+	USHORT	TouchMinor;
+	USHORT	Pressure;
+} AMTPTP_DECODED_CONTACT, *PAMTPTP_DECODED_CONTACT;
+
+struct _AMTPTP_DECODED_FRAME {
+	ULONG	DeviceTime;		/* raw device clock, see AMTPTP_*_TIMESTAMP_MASK */
+	BOOLEAN	HasDeviceTime;
+	USHORT	ScanTime;		/* 100us units, filled in by AmtPtpScanClockUpdate */
+	BOOLEAN	IsButtonClicked;
+	UCHAR	ContactCount;
+	UCHAR	FirstContact;	/* first contact of the next hybrid report, 0 for a new scan */
+	AMTPTP_DECODED_CONTACT Contacts[AMTPTP_DECODER_MAX_CONTACTS];
+};
+
+/* Wellspring (BCM5974) finger record, le16 fields */
+#define AMTPTP_WELLSPRING_FINGER_ID				0
+#define AMTPTP_WELLSPRING_FINGER_STATE			1
+#define AMTPTP_WELLSPRING_FINGER_CLASS			2
+#define AMTPTP_WELLSPRING_FINGER_ABS_X			4
+#define AMTPTP_WELLSPRING_FINGER_ABS_Y			6
+#define AMTPTP_WELLSPRING_FINGER_TOUCH_MAJOR	18
+#define AMTPTP_WELLSPRING_FINGER_TOUCH_MINOR	20
+#define AMTPTP_WELLSPRING_FINGER_PRESSURE		26
+#define AMTPTP_WELLSPRING_FINGER_MIN_SIZE		28
+
+/* Wellspring layouts with a specialized decoder: header, finger and button offsets */
+#define AMTPTP_WELLSPRING_TYPE2_HEADER_SIZE	28
+#define AMTPTP_WELLSPRING_TYPE2_FINGER_SIZE	28
+#define AMTPTP_WELLSPRING_TYPE2_BUTTON		15
+#define AMTPTP_WELLSPRING_TYPE3_HEADER_SIZE	36
+#define AMTPTP_WELLSPRING_TYPE3_FINGER_SIZE	28
+#define AMTPTP_WELLSPRING_TYPE3_BUTTON		23
+#define AMTPTP_WELLSPRING_TYPE4_HEADER_SIZE	46
+#define AMTPTP_WELLSPRING_TYPE4_FINGER_SIZE	30
+#define AMTPTP_WELLSPRING_TYPE4_BUTTON		31
+
+/* Wellspring frames carry the low byte of a millisecond counter in byte 4 */
+#define AMTPTP_WELLSPRING_TIMESTAMP_OFFSET	4
+#define AMTPTP_WELLSPRING_TIMESTAMP_MASK	0xFF
+
+/* Magic Trackpad 2 report 0x31 */
+#define AMTPTP_MT2_HEADER_SIZE	4
+#define AMTPTP_MT2_FINGER_SIZE	9
+#define AMTPTP_MT2_USB_HEADER_SIZE	12	/* mouse report + report 0x31 header */
+#define AMTPTP_MT2_USB_BUTTON	1	/* left button of the mouse report */
+#define AMTPTP_MT2_TIMESTAMP_MASK	0x1FFFFF	/* 21 bit millisecond counter */
+
+//
+// Magic Trackpad 2 finger records unpacked as a structure of arrays. The
+// packed 32-bit word (13-bit X, 13-bit Y, finger class, state) is split for
+// all fingers in one straight pass without per-finger branches. X and Y are
+// already translated and clamped.
+//
+struct _AMTPTP_MT2_FINGER_BATCH {
+	USHORT	X[AMTPTP_DECODER_MAX_CONTACTS];
+	USHORT	Y[AMTPTP_DECODER_MAX_CONTACTS];
+	UCHAR	Finger[AMTPTP_DECODER_MAX_CONTACTS];
+	UCHAR	State[AMTPTP_DECODER_MAX_CONTACTS];
+};
+
+/* Instruction sets AmtPtpUnpackMt2Fingers has a variant for */
+typedef enum _AMTPTP_UNPACK_ISA {
+	AmtPtpUnpackIsaScalar,	/* reference, always available */
+	AmtPtpUnpackIsaSse41,	/* x64, 4 fingers per step */
+	AmtPtpUnpackIsaAvx2,	/* x64 user mode, 8 fingers per step */
+	AmtPtpUnpackIsaNeon,	/* ARM64, 4 fingers per step */
+	AmtPtpUnpackIsaMax
+} AMTPTP_UNPACK_ISA;
+
+/* SPI_TRACKPAD_PACKET */
+#define AMTPTP_SPI_HEADER_SIZE			46
+#define AMTPTP_SPI_FINGER_SIZE			30
+#define AMTPTP_SPI_MAX_FINGERS			10
+#define AMTPTP_SPI_CLICK_OFFSET			1
+#define AMTPTP_SPI_FINGER_COUNT_OFFSET	30
+#define AMTPTP_SPI_FINGER_X				4
+#define AMTPTP_SPI_FINGER_Y				6
+#define AMTPTP_SPI_FINGER_TOUCH_MAJOR	18
+#define AMTPTP_SPI_FINGER_TOUCH_MINOR	20
+#define AMTPTP_SPI_FINGER_PRESSURE		26
+
+//
+// Picks the decoder for Config once the rest of it is filled in. Known
+// Wellspring and Magic Trackpad 2 layouts get a decoder with the header size,
+// stride and button offset compiled in; anything else uses the generic one.
+//
+VOID
+AmtPtpDecoderSelect(
+	_Inout_ PAMTPTP_DECODER_CONFIG Config
+);
+
+AMTPTP_DECODE_RESULT
+AmtPtpDecodeFrame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+);
+
+AMTPTP_DECODE_RESULT
+AmtPtpDecodeWellspringFrame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+);
+
+AMTPTP_DECODE_RESULT
+AmtPtpDecodeMt2Frame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+);
+
+//
+// The scalar unpack every vector variant has to match bit for bit. Decoding
+// goes through Config->UnpackMt2Fingers, the fastest variant the CPU runs.
+//
+VOID
+AmtPtpUnpackMt2Fingers(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Count * AMTPTP_MT2_FINGER_SIZE) const UCHAR* Fingers,
+	_In_ SIZE_T Count,
+	_Out_ PAMTPTP_MT2_FINGER_BATCH Batch
+);
+
+//
+// Returns the Isa variant of AmtPtpUnpackMt2Fingers, or NULL when it is not
+// built for this architecture or the CPU does not support it.
+//
+PFN_AMTPTP_UNPACK_MT2_FINGERS
+AmtPtpGetUnpackMt2Fingers(
+	_In_ AMTPTP_UNPACK_ISA Isa
+);
+
+AMTPTP_DECODE_RESULT
+AmtPtpDecodeSpiFrame(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+);
+
+//
+// Copies a decoded frame into a driver PTP_REPORT. PTP_CONTACT differs between
+// drivers, so this works on the field names rather than on a shared type.
+//
+// A frame with more contacts than the report holds goes out in hybrid mode:
+// one report per FirstContact step, all with the same ScanTime. Only the first
+// report carries the contact count, the following ones report 0.
+//
+#define AMTPTP_COMPOSE_REPORT(Frame, Report) \
+	do { \
+		UCHAR __first = (Frame)->FirstContact; \
+		UCHAR __count = (Frame)->ContactCount > __first ? (Frame)->ContactCount - __first : 0; \
+		if (__count > (UCHAR) (sizeof((Report)->Contacts) / sizeof((Report)->Contacts[0]))) \
+			__count = (UCHAR) (sizeof((Report)->Contacts) / sizeof((Report)->Contacts[0])); \
+		RtlZeroMemory((Report), sizeof(*(Report))); \
+		(Report)->ReportID = REPORTID_MULTITOUCH; \
+		(Report)->ScanTime = (Frame)->ScanTime; \
+		(Report)->ContactCount = __first == 0 ? (Frame)->ContactCount : 0; \
+		(Report)->IsButtonClicked = (Frame)->IsButtonClicked; \
+		for (UCHAR __i = 0; __i < __count; __i++) { \
+			(Report)->Contacts[__i].ContactID = (Frame)->Contacts[__first + __i].ContactID; \
+			(Report)->Contacts[__i].X = (Frame)->Contacts[__first + __i].X; \
+			(Report)->Contacts[__i].Y = (Frame)->Contacts[__first + __i].Y; \
+			(Report)->Contacts[__i].TipSwitch = (Frame)->Contacts[__first + __i].TipSwitch; \
+			(Report)->Contacts[__i].Confidence = (Frame)->Contacts[__first + __i].Confidence; \
+		} \
+	} while (0)
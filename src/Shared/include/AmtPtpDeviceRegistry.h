@@ -0,0 +1,164 @@
+// AmtPtpDeviceRegistry.h: Every supported trackpad, described once
+//
+// A device model carries what the drivers need to bring a trackpad up: the
+// raw frame layout in the terms AMTPTP_DECODER_CONFIG uses, the coordinate
+// ranges, the USB mode switch and the family of its PTP report descriptor.
+// Each descriptor family has one geometry record below, which both its models
+// and its descriptor (see AmtPtpHidDescriptor.h) are built from.
+//
+// Models are looked up by bus, vendor id and product id. Apple reuses product
+// ids across transports (0x0272 is a USB Wellspring 9 and an SPI MacBookPro12,1),
+// so the bus is part of the key. All Apple trackpads sit in 0x0200 - 0x02FF,
+// which the lookup indexes directly.
+#pragma once
+
+#include <AmtPtpDecoder.h>
+
+#define AMTPTP_VID_APPLE_USB	0x05ac
+#define AMTPTP_VID_APPLE_BT		0x004c
+
+#define AMTPTP_PRODUCT_ID_BASE	0x0200
+#define AMTPTP_PRODUCT_ID_SPAN	0x0100
+
+typedef enum _AMTPTP_BUS {
+	AmtPtpBusUsb,
+	AmtPtpBusBluetooth,
+	AmtPtpBusSpi,
+	AmtPtpBusMax
+} AMTPTP_BUS;
+
+/* bcm5974 trackpad header types */
+typedef enum _AMTPTP_TRACKPAD_TYPE {
+	AmtPtpTrackpadTypeNone,
+	AmtPtpTrackpadType1,	/* plain trackpad */
+	AmtPtpTrackpadType2,	/* button integrated in trackpad */
+	AmtPtpTrackpadType3,	/* additional header fields since June 2013 */
+	AmtPtpTrackpadType4,	/* additional header field for pressure data */
+	AmtPtpTrackpadType5		/* format for magic trackpad 2 */
+} AMTPTP_TRACKPAD_TYPE;
+
+/* PTP report descriptor families, each driver maps them to its own descriptors */
+typedef enum _AMTPTP_REPORT_DESCRIPTOR {
+	AmtPtpReportDescriptorNone,
+	AmtPtpReportDescriptorWellspring3,
+	AmtPtpReportDescriptorWellspring5,
+	AmtPtpReportDescriptorWellspring6,
+	AmtPtpReportDescriptorWellspring7a,
+	AmtPtpReportDescriptorWellspring8,
+	AmtPtpReportDescriptorWellspring9,
+	AmtPtpReportDescriptorMagicTrackpad2,
+	AmtPtpReportDescriptorT2,
+	AmtPtpReportDescriptorT2Small,
+	AmtPtpReportDescriptorSpiFamily1,
+	AmtPtpReportDescriptorSpiFamily2,
+	AmtPtpReportDescriptorSpiFamily3a,
+	AmtPtpReportDescriptorSpiFamily3b
+} AMTPTP_REPORT_DESCRIPTOR;
+
+typedef enum _AMTPTP_DEVICE_MODEL_ID {
+	AmtPtpModelUnknown,
+	AmtPtpModelWellspring,			/* MacbookAir */
+	AmtPtpModelWellspring2,			/* MacbookProPenryn */
+	AmtPtpModelWellspring3,			/* Macbook5,1 */
+	AmtPtpModelWellspring4,			/* MacbookAir3,2 */
+	AmtPtpModelWellspring4A,		/* MacbookAir3,1 */
+	AmtPtpModelWellspring5,			/* Macbook8 */
+	AmtPtpModelWellspring6,			/* MacbookAir4,2 */
+	AmtPtpModelWellspring5A,		/* Macbook8,2 */
+	AmtPtpModelWellspring6A,		/* MacbookAir4,1 */
+	AmtPtpModelWellspring7,			/* MacbookPro10,1 */
+	AmtPtpModelWellspring7A,		/* MacbookPro10,2 */
+	AmtPtpModelWellspring8,			/* MacbookAir6,2 */
+	AmtPtpModelWellspring9,			/* MacbookPro12,1 */
+	AmtPtpModelMagicTrackpad2Usb,
+	AmtPtpModelMagicTrackpad2Bluetooth,
+	AmtPtpModelT2,					/* 15 inch and unknown T2 machines, oversampled */
+	AmtPtpModelT2Small,				/* 13 inch T2 machines */
+	AmtPtpModelSpiFamily1,			/* MacBook9, MacBook10, MacBookAir7,2 */
+	AmtPtpModelSpiFamily2,			/* MacBookPro11,1 / MacBookPro12,1 */
+	AmtPtpModelSpiFamily3a,			/* MacBookPro14,1 / MacBookPro14,2 */
+	AmtPtpModelSpiFamily3b,			/* MacBookPro14,3 */
+	AmtPtpModelMax
+} AMTPTP_DEVICE_MODEL_ID;
+
+//
+// Geometry records: (X min, X max, Y min, Y max, width, height). The ranges
+// are raw sensor readings, the pad size is in 0.01 cm. Positions are reported
+// relative to the minimum, so a descriptor's logical maximum is max - min.
+//
+#define AMTPTP_GEOMETRY_WELLSPRING3		(-4460, 5166, -75, 6700, 1050, 760)
+#define AMTPTP_GEOMETRY_WELLSPRING5		(-4415, 5050, -55, 6680, 1050, 810)
+#define AMTPTP_GEOMETRY_WELLSPRING6		(-4620, 5140, -150, 6600, 1067, 762)
+#define AMTPTP_GEOMETRY_WELLSPRING7A	(-4750, 5280, -150, 6730, 1064, 773)
+#define AMTPTP_GEOMETRY_WELLSPRING8		(-4620, 5140, -150, 6600, 1045, 750)
+#define AMTPTP_GEOMETRY_WELLSPRING9		(-4828, 5345, -203, 6803, 1064, 773)
+#define AMTPTP_GEOMETRY_MAGIC_TRACKPAD2	(-3678, 3934, -2479, 2586, 1600, 1149)
+#define AMTPTP_GEOMETRY_T2				(-10000, 10000, -2000, 10000, 1300, 850)
+#define AMTPTP_GEOMETRY_T2_SMALL		(-6243, 6749, -170, 7685, 1352, 836)
+#define AMTPTP_GEOMETRY_SPI_FAMILY1		(-5087, 5579, -128, 6089, 1118, 711)
+#define AMTPTP_GEOMETRY_SPI_FAMILY2		(-4750, 5280, -150, 6730, 1064, 773)
+#define AMTPTP_GEOMETRY_SPI_FAMILY3A	(-6243, 6749, -170, 7685, 1352, 836)
+#define AMTPTP_GEOMETRY_SPI_FAMILY3B	(-7456, 7976, -163, 9283, 1584, 992)
+
+/* expands to Macro(X min, X max, Y min, Y max, width, height) */
+#define AMTPTP_GEOMETRY_APPLY(Macro, Geometry)	Macro Geometry
+
+/* device-specific axis parameters */
+typedef struct _AMTPTP_AXIS {
+	LONG	SnRatio;		/* signal-to-noise ratio, 0 when unknown */
+	LONG	Min;			/* device minimum reading */
+	LONG	Max;			/* device maximum reading */
+	LONG	Size;			/* pad size in 0.01 cm, 0 when unknown */
+} AMTPTP_AXIS;
+
+/* USB control message that switches a bcm5974 trackpad to Wellspring mode */
+typedef struct _AMTPTP_MODE_SWITCH {
+	USHORT	Length;			/* message length, 0 if no switch is needed */
+	USHORT	Value;			/* wValue */
+	USHORT	Index;			/* wIndex */
+	USHORT	SwitchOffset;	/* byte holding the mode */
+	UCHAR	On;
+	UCHAR	Off;
+} AMTPTP_MODE_SWITCH;
+
+typedef struct _AMTPTP_DEVICE_MODEL {
+	const char*				Name;
+	AMTPTP_BUS				Bus;
+	AMTPTP_TRACKPAD_TYPE	Type;
+	AMTPTP_FRAME_FORMAT		Format;
+	USHORT					HeaderSize;		/* bytes in header block */
+	USHORT					FingerOffset;	/* offset to first finger record */
+	USHORT					FingerSize;		/* bytes in single finger block */
+	USHORT					ButtonOffset;	/* offset to button data */
+	USHORT					TransferLength;	/* longest frame */
+	AMTPTP_MODE_SWITCH		ModeSwitch;
+	AMTPTP_AXIS				X;
+	AMTPTP_AXIS				Y;
+	AMTPTP_REPORT_DESCRIPTOR Descriptor;
+} AMTPTP_DEVICE_MODEL, *PAMTPTP_DEVICE_MODEL;
+
+//
+// Returns the model for a device, or NULL if it is not supported on that bus.
+//
+const AMTPTP_DEVICE_MODEL*
+AmtPtpDeviceRegistryLookup(
+	_In_ AMTPTP_BUS Bus,
+	_In_ USHORT VendorId,
+	_In_ USHORT ProductId
+);
+
+const AMTPTP_DEVICE_MODEL*
+AmtPtpDeviceRegistryGetModel(
+	_In_ AMTPTP_DEVICE_MODEL_ID ModelId
+);
+
+//
+// Fills the layout and ranges of Config from Model, adds the driver specific
+// decoder Flags and selects the decoder.
+//
+VOID
+AmtPtpDeviceRegistryInitDecoderConfig(
+	_In_ const AMTPTP_DEVICE_MODEL* Model,
+	_In_ ULONG Flags,
+	_Out_ PAMTPTP_DECODER_CONFIG Config
+);
@@ -0,0 +1,93 @@
+// AmtPtpErrorBudget.h: Malformed frame handling with a sliding error budget
+//
+// A frame that does not decode used to either reset the device right away or
+// fail the pending HID read. Most bad frames are isolated: a transfer cut short
+// in the middle of a finger record, or one garbled report on a noisy link. The
+// device is still in the right mode and the next frame is fine.
+//
+// - AmtPtpDecodeFrameSalvage cuts trailing partial data off a Wellspring or
+//   Magic Trackpad 2 frame and decodes the complete fingers in front of it.
+// - AmtPtpErrorBudgetRecord counts the frames that could not be used. An
+//   isolated bad frame is dropped and the pending read waits for the next one.
+//   Only when Limit bad frames arrive within Window is the device reset.
+//
+// The budget also adds up the input time lost to bad frames: the time from the
+// last frame delivered before a run of bad frames to the first one after it.
+//
+// The budget does no locking. The caller serializes it with the rest of its
+// input path, and passes host time in 100ns units.
+#pragma once
+
+#include <AmtPtpDecoder.h>
+
+#define AMTPTP_ERROR_BUDGET_MAX_LIMIT		16
+#define AMTPTP_ERROR_BUDGET_DEFAULT_LIMIT	5
+#define AMTPTP_ERROR_BUDGET_DEFAULT_WINDOW	(1000 * 10000)	/* 1s */
+
+typedef enum _AMTPTP_FRAME_CHECK {
+	AmtPtpFrameIntact,
+	AmtPtpFrameSalvaged,		/* trailing partial finger cut off, the rest decoded */
+	AmtPtpFrameCorrupt			/* nothing usable */
+} AMTPTP_FRAME_CHECK;
+
+typedef enum _AMTPTP_FRAME_VERDICT {
+	AmtPtpFrameDeliver,
+	AmtPtpFrameDrop,			/* skip the frame, leave the pending read alone */
+	AmtPtpFrameReset			/* skip the frame and reset the device */
+} AMTPTP_FRAME_VERDICT;
+
+typedef struct _AMTPTP_ERROR_BUDGET {
+	ULONGLONG	Window;			/* 100ns units */
+	ULONG		Limit;			/* bad frames within Window that reset the device */
+	ULONG		Count;			/* bad frames in Times */
+	ULONG		Head;			/* next slot in Times, the oldest once Count == Limit */
+	ULONGLONG	Times[AMTPTP_ERROR_BUDGET_MAX_LIMIT];
+	BOOLEAN		Delivered;		/* LastDelivered is valid */
+	BOOLEAN		Losing;			/* bad frames since LastDelivered */
+	ULONGLONG	LastDelivered;
+
+	// Statistics, never reset by AmtPtpErrorBudgetReset
+	ULONG		Salvaged;
+	ULONG		Dropped;
+	ULONG		Resets;
+	ULONGLONG	LostTime;		/* 100ns units */
+} AMTPTP_ERROR_BUDGET, *PAMTPTP_ERROR_BUDGET;
+
+//
+// Limit is clamped to 1 - AMTPTP_ERROR_BUDGET_MAX_LIMIT. A Limit of 1 resets
+// on every bad frame.
+//
+VOID
+AmtPtpErrorBudgetInitialize(
+	_Out_ PAMTPTP_ERROR_BUDGET Budget,
+	_In_ ULONGLONG Window,
+	_In_ ULONG Limit
+);
+
+//
+// Decodes Buffer like AmtPtpDecodeFrame. If the frame does not decode and
+// carries part of a finger record after the last complete one, the partial
+// record is cut off and the frame decoded again.
+//
+AMTPTP_FRAME_CHECK
+AmtPtpDecodeFrameSalvage(
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+);
+
+AMTPTP_FRAME_VERDICT
+AmtPtpErrorBudgetRecord(
+	_Inout_ PAMTPTP_ERROR_BUDGET Budget,
+	_In_ AMTPTP_FRAME_CHECK Check,
+	_In_ ULONGLONG HostTime
+);
+
+//
+// Forgets earlier bad frames, e.g. across a power transition.
+//
+VOID
+AmtPtpErrorBudgetReset(
+	_Inout_ PAMTPTP_ERROR_BUDGET Budget
+);
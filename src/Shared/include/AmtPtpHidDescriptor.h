@@ -0,0 +1,133 @@
+// AmtPtpHidDescriptor.h: PTP report descriptors built from device geometry
+//
+// All drivers describe the same multi-touch input report: five fingers, scan
+// time, contact count and the button, followed by the device capabilities and
+// certification feature reports. Only the axis ranges and the width of the
+// contact id differ, so the top-level collection is generated here from a
+// geometry record in AmtPtpDeviceRegistry.h and the driver's contact id items.
+//
+// The builders use the HID item names from the driver's HidCommon.h and expand
+// to a byte list for a const HID_REPORT_DESCRIPTOR array.
+#pragma once
+
+#include <AmtPtpDeviceRegistry.h>
+#include <AmtPtpPerfCounters.h>
+
+/* fingers in the multi-touch report, must match PTP_REPORT */
+#define AMTPTP_HID_PTP_CONTACTS	5
+
+/* Digitizer application usages */
+#define AMTPTP_HID_TOUCH_SCREEN	0x04
+#define AMTPTP_HID_TOUCH_PAD	0x05
+
+/* little-endian item data */
+#define AMTPTP_HID_LE16(Value)	((Value) & 0xff), (((Value) >> 8) & 0xff)
+
+//
+// X and Y of one finger. Physical units are reset at the end so that the next
+// finger's switches do not inherit them.
+//
+#define AMTPTP_HID_PTP_POSITION(xmin, xmax, ymin, ymax, width, height) \
+	USAGE_PAGE, 0x01, /* Usage Page: Generic Desktop */ \
+	LOGICAL_MAXIMUM_2, AMTPTP_HID_LE16((xmax) - (xmin)), /* Logical Maximum: X range */ \
+	REPORT_SIZE, 0x10, /* Report Size: 0x10 (2 bytes) */ \
+	UNIT_EXPONENT, 0x0e, /* Unit exponent: -2 */ \
+	UNIT, 0x11, /* Unit: SI Length (cm) */ \
+	USAGE, 0x30, /* Usage: X */ \
+	PHYSICAL_MAXIMUM_2, AMTPTP_HID_LE16(width), /* Physical Maximum: pad width */ \
+	REPORT_COUNT, 0x01, /* Report count: 1 */ \
+	INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+	PHYSICAL_MAXIMUM_2, AMTPTP_HID_LE16(height), /* Physical Maximum: pad height */ \
+	LOGICAL_MAXIMUM_2, AMTPTP_HID_LE16((ymax) - (ymin)), /* Logical Maximum: Y range */ \
+	USAGE, 0x31, /* Usage: Y */ \
+	INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+	PHYSICAL_MAXIMUM, 0x00, /* Physical Maximum: 0 */ \
+	UNIT_EXPONENT, 0x00, /* Unit exponent: 0 */ \
+	UNIT, 0x00 /* Unit: None */
+
+//
+// One finger collection. ContactId names a function-like macro taking no
+// arguments that emits the bits following tip switch and confidence, padded
+// to the driver's PTP_CONTACT layout.
+//
+#define AMTPTP_HID_PTP_FINGER(ContactId, Geometry) \
+	USAGE, 0x22, /* Usage: Finger */ \
+	BEGIN_COLLECTION, 0x02, /* Begin Collection: Logical */ \
+		LOGICAL_MAXIMUM, 0x01, /* Logical Maximum: 1 */ \
+		USAGE, 0x47, /* Usage: Confidence */ \
+		USAGE, 0x42, /* Usage: Tip switch */ \
+		REPORT_COUNT, 0x02, /* Report Count: 2 */ \
+		REPORT_SIZE, 0x01, /* Report Size: 1 */ \
+		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+		ContactId(), \
+		AMTPTP_GEOMETRY_APPLY(AMTPTP_HID_PTP_POSITION, Geometry), \
+	END_COLLECTION, /* End Collection */ \
+	USAGE_PAGE, 0x0d /* Usage Page: Digitizer */
+
+//
+// Touch pad (Usage 0x05) or touch screen (Usage 0x04) top-level collection
+// with AMTPTP_HID_PTP_CONTACTS fingers.
+//
+#define AMTPTP_HID_PTP_TLC(Usage, ContactId, Geometry) \
+	USAGE_PAGE, 0x0d, /* Usage Page: Digitizer */ \
+	USAGE, (Usage), /* Usage: Touch Pad or Touch Screen */ \
+	BEGIN_COLLECTION, 0x01, /* Begin Collection: Application */ \
+		REPORT_ID, REPORTID_MULTITOUCH, /* Report ID: Multi-touch */ \
+		AMTPTP_HID_PTP_FINGER(ContactId, Geometry), /* 1 */ \
+		AMTPTP_HID_PTP_FINGER(ContactId, Geometry), /* 2 */ \
+		AMTPTP_HID_PTP_FINGER(ContactId, Geometry), /* 3 */ \
+		AMTPTP_HID_PTP_FINGER(ContactId, Geometry), /* 4 */ \
+		AMTPTP_HID_PTP_FINGER(ContactId, Geometry), /* 5 */ \
+		UNIT_EXPONENT, 0x0c, /* Unit exponent: -4 */ \
+		UNIT_2, 0x01, 0x10, /* Time: Second */ \
+		PHYSICAL_MAXIMUM_3, 0xff, 0xff, 0x00, 0x00, \
+		LOGICAL_MAXIMUM_3, 0xff, 0xff, 0x00, 0x00, \
+		USAGE, 0x56, /* Usage: Scan Time */ \
+		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+		USAGE, 0x54, /* Usage: Contact Count */ \
+		LOGICAL_MAXIMUM, 0x7f, \
+		REPORT_SIZE, 0x08, \
+		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+		USAGE_PAGE, 0x09, /* Usage Page: Button */ \
+		USAGE, 0x01, /* Button 1 */ \
+		LOGICAL_MAXIMUM, 0x01, \
+		REPORT_SIZE, 0x01, \
+		INPUT, 0x02, /* Input: (Data, Var, Abs) */ \
+		REPORT_COUNT, 0x07, \
+		INPUT, 0x03, /* Input: (Const, Var, Abs) */ \
+		USAGE_PAGE, 0x0d, /* Usage Page: Digitizer */ \
+		REPORT_ID, REPORTID_DEVICE_CAPS, \
+		USAGE, 0x55, /* Usage: Maximum Contacts */ \
+		USAGE, 0x59, /* Usage: Touchpad Button Type*/ \
+		LOGICAL_MINIMUM, 0x00, \
+		LOGICAL_MAXIMUM_2, 0xff, 0x00, \
+		REPORT_SIZE, 0x08, \
+		REPORT_COUNT, 0x02, \
+		FEATURE, 0x02, \
+		USAGE_PAGE_1, 0x00, 0xff, \
+		REPORT_ID, REPORTID_PTPHQA, \
+		USAGE, 0xc5, \
+		LOGICAL_MINIMUM, 0x00, \
+		LOGICAL_MAXIMUM_2, 0xff, 0x00, \
+		REPORT_SIZE, 0x08, \
+		REPORT_COUNT_2, 0x00, 0x01, \
+		FEATURE, 0x02, \
+	END_COLLECTION /* End Collection */
+
+//
+// Vendor collection with the input path counters of AmtPtpPerfCounters.h as
+// one feature report of 32-bit values, kept apart from the configuration
+// collection so that tools can open it on its own.
+//
+#define AMTPTP_HID_PERF_COUNTERS_TLC \
+	USAGE_PAGE_1, 0x00, 0xff, /* Usage Page: Vendor defined */ \
+	USAGE, 0x02, /* Usage: Vendor Usage 0x02 */ \
+	BEGIN_COLLECTION, 0x01, /* Begin Collection: Application */ \
+		REPORT_ID, REPORTID_PERF_COUNTERS, /* Report ID: Performance counters */ \
+		USAGE, 0x02, /* Usage: Vendor Usage 0x02 */ \
+		LOGICAL_MINIMUM, 0x00, /* Logical Minimum 0 */ \
+		LOGICAL_MAXIMUM_3, 0xff, 0xff, 0xff, 0xff, /* Logical Maximum: 0xffffffff */ \
+		REPORT_SIZE, 0x20, /* Report Size: 0x20 (4 bytes) */ \
+		REPORT_COUNT, AMTPTP_PERF_COUNTER_COUNT, /* Report Count: one per counter */ \
+		FEATURE, 0x02, /* Feature: (Data, Var, Abs) */ \
+	END_COLLECTION
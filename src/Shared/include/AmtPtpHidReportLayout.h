@@ -0,0 +1,65 @@
+// AmtPtpHidReportLayout.h: Report sizes declared by a HID report descriptor
+//
+// hidclass sizes every report from the descriptor, not from the structures the
+// driver fills. A descriptor that declares a few more or fewer bits than the
+// matching structure still parses, and the reports are then misread without
+// any error. This module walks the short items of a descriptor and adds up the
+// main items of each report, so a driver can check its descriptor against its
+// report structures before handing it out.
+//
+// Only what decides the layout is tracked: Report Size, Report Count and
+// Report ID, with Push and Pop. Long items are skipped.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+/* Push/Pop nesting the walker keeps track of */
+#define AMTPTP_HID_GLOBAL_STACK_DEPTH	4
+
+typedef enum _AMTPTP_HID_REPORT_TYPE {
+	AmtPtpHidReportInput,
+	AmtPtpHidReportOutput,
+	AmtPtpHidReportFeature
+} AMTPTP_HID_REPORT_TYPE;
+
+typedef enum _AMTPTP_HID_LAYOUT_RESULT {
+	AmtPtpHidLayoutOk,
+	AmtPtpHidLayoutTruncated,		/* an item runs past the end of the descriptor */
+	AmtPtpHidLayoutUnbalanced,		/* collection or Push/Pop nesting does not match */
+	AmtPtpHidLayoutInvalidItem,		/* Report ID 0, or a report too large for hidclass */
+	AmtPtpHidLayoutMismatch			/* a report differs from the expected size */
+} AMTPTP_HID_LAYOUT_RESULT;
+
+typedef struct _AMTPTP_HID_REPORT_SIZE {
+	AMTPTP_HID_REPORT_TYPE	Type;
+	UCHAR					ReportId;
+	ULONG					Size;		/* bytes, including the report id */
+} AMTPTP_HID_REPORT_SIZE;
+
+//
+// Returns in Size the length in bytes of the Type report with ReportId,
+// including the report id byte when the descriptor uses report ids. Size is 0
+// when the descriptor does not declare that report.
+//
+AMTPTP_HID_LAYOUT_RESULT
+AmtPtpHidGetReportSize(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_ AMTPTP_HID_REPORT_TYPE Type,
+	_In_ UCHAR ReportId,
+	_Out_ PULONG Size
+);
+
+//
+// Checks every report in Expected against Descriptor. On a mismatch, returns
+// AmtPtpHidLayoutMismatch and fills Mismatch with the report and the size the
+// descriptor declares for it.
+//
+AMTPTP_HID_LAYOUT_RESULT
+AmtPtpHidVerifyReportSizes(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_reads_(Count) const AMTPTP_HID_REPORT_SIZE* Expected,
+	_In_ ULONG Count,
+	_Out_opt_ AMTPTP_HID_REPORT_SIZE* Mismatch
+);
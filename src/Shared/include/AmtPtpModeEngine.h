@@ -0,0 +1,95 @@
+// AmtPtpModeEngine.h: Wellspring mode transitions without blocking the caller
+//
+// bcm5974 trackpads are switched between HID mouse mode and Wellspring mode
+// by reading a small mode block over the control endpoint, patching one byte
+// and writing the block back. The engine decides which transfer goes out
+// next. The driver sends it and reports the completion, so the transfers can
+// be asynchronous and the caller never waits on the bus.
+//
+// - The mode block is read once and kept, later writes patch the cached copy.
+// - The last mode the device confirmed is tracked. Asking for the mode the
+//   device is already in sends nothing.
+// - A reset writes mouse mode and then Wellspring mode. Resets requested while
+//   one is underway are folded into it.
+// - Requests made while a transfer is in flight only move the target. The
+//   engine picks it up when that transfer completes.
+//
+// The engine has no locking. The caller serializes all calls and has at most
+// one transfer outstanding: the one the engine returned last.
+#pragma once
+
+#include <AmtPtpDeviceRegistry.h>
+
+/* Longest mode block in AmtPtpDeviceRegistry.c */
+#define AMTPTP_MODE_BLOCK_MAX_SIZE	8
+
+typedef enum _AMTPTP_MODE_STEP {
+	AmtPtpModeStepNone,		/* nothing to send */
+	AmtPtpModeStepRead,		/* read the mode block into Block */
+	AmtPtpModeStepWrite		/* write Block to the device */
+} AMTPTP_MODE_STEP;
+
+typedef enum _AMTPTP_MODE {
+	AmtPtpModeUnknown,
+	AmtPtpModeMouse,
+	AmtPtpModeWellspring
+} AMTPTP_MODE;
+
+typedef struct _AMTPTP_MODE_ENGINE {
+	AMTPTP_MODE_SWITCH	Switch;			/* from the device model */
+	AMTPTP_MODE_STEP	InFlight;
+	AMTPTP_MODE			Known;			/* last mode the device confirmed */
+	AMTPTP_MODE			Target;			/* mode the device should end up in */
+	AMTPTP_MODE			Writing;		/* mode the in-flight write sets */
+	BOOLEAN				ResetPending;	/* mouse mode write of a reset not sent yet */
+	BOOLEAN				Resetting;		/* a reset is underway */
+	BOOLEAN				BlockValid;
+
+	// Statistics, never reset
+	ULONG	Transfers;
+	ULONG	Skipped;		/* requests the device already satisfied */
+	ULONG	Coalesced;		/* resets folded into one underway */
+	ULONG	Failures;
+
+	UCHAR	Block[AMTPTP_MODE_BLOCK_MAX_SIZE];
+} AMTPTP_MODE_ENGINE, *PAMTPTP_MODE_ENGINE;
+
+//
+// Returns FALSE if the mode block of Switch does not fit in the engine.
+//
+BOOLEAN
+AmtPtpModeEngineInitialize(
+	_Out_ PAMTPTP_MODE_ENGINE Engine,
+	_In_ const AMTPTP_MODE_SWITCH* Switch
+);
+
+AMTPTP_MODE_STEP
+AmtPtpModeEngineRequest(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine,
+	_In_ AMTPTP_MODE Mode
+);
+
+AMTPTP_MODE_STEP
+AmtPtpModeEngineReset(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine
+);
+
+//
+// Reports the completion of the in-flight transfer. A read fills Block before
+// it is reported. On failure the engine forgets the device mode and drops the
+// work in progress, the next request starts over.
+//
+AMTPTP_MODE_STEP
+AmtPtpModeEngineComplete(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine,
+	_In_ BOOLEAN Success
+);
+
+//
+// The device mode is lost, e.g. across a power transition. The mode block is
+// read again before the next write.
+//
+VOID
+AmtPtpModeEngineInvalidate(
+	_Inout_ PAMTPTP_MODE_ENGINE Engine
+);
@@ -0,0 +1,77 @@
+// AmtPtpPacketDemux.h: Reports packed into one Magic Trackpad 2 transfer
+//
+// A transfer from the MT2 can carry more than one report. Over USB a touch
+// frame comes after a mouse report 0x02, and report 0xF7 wraps two reports,
+// the first one preceded by its length. The demultiplexer walks a transfer
+// without recursion and hands out the reports it contains in order.
+//
+// - Pending parts of the transfer are kept on a small work list.
+// - 0xF7 nesting deeper than AMTPTP_DEMUX_MAX_DEPTH is dropped.
+// - Every length is checked against the bytes that are left. A part that
+//   does not fit is dropped and the walk goes on with the next one.
+// - A mouse report is only handed out on its own, the one in front of a
+//   USB touch frame is skipped.
+//
+// The work list lives in the caller's AMTPTP_PACKET_DEMUX, usually on the
+// stack. Reports point into the caller's transfer buffer.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+#define AMTPTP_DEMUX_MAX_DEPTH			4
+#define AMTPTP_MT2_MOUSE_REPORT_SIZE	8
+
+#define AMTPTP_DEMUX_MOUSE		0x02
+#define AMTPTP_DEMUX_COMBINED	0xf7
+
+typedef enum _AMTPTP_DEMUX_RESULT {
+	AmtPtpDemuxReport,		/* Report and Length are set */
+	AmtPtpDemuxMalformed,	/* a part was dropped, the walk goes on */
+	AmtPtpDemuxDone
+} AMTPTP_DEMUX_RESULT;
+
+typedef struct _AMTPTP_DEMUX_SPAN {
+	const UCHAR*	Buffer;
+	SIZE_T			Length;
+	ULONG			Depth;		/* 0xF7 reports around this part */
+} AMTPTP_DEMUX_SPAN;
+
+typedef struct _AMTPTP_PACKET_DEMUX {
+	/* each 0xF7 level leaves at most one second part behind */
+	AMTPTP_DEMUX_SPAN	Pending[AMTPTP_DEMUX_MAX_DEPTH + 1];
+	ULONG				Count;
+
+	// Statistics of this transfer
+	ULONG	Reports;
+	ULONG	Malformed;
+} AMTPTP_PACKET_DEMUX, *PAMTPTP_PACKET_DEMUX;
+
+//
+// Returns TRUE when the transfer holds a single report, by far the most common
+// case, and points Report past any mouse reports in front of it. Otherwise the
+// transfer has to be walked with AmtPtpPacketDemuxBegin and AmtPtpPacketDemuxNext.
+//
+BOOLEAN
+AmtPtpPacketDemuxSingle(
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_Out_ const UCHAR** Report,
+	_Out_ SIZE_T* ReportLength
+);
+
+VOID
+AmtPtpPacketDemuxBegin(
+	_Out_ PAMTPTP_PACKET_DEMUX Demux,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length
+);
+
+//
+// Returns the next report of the transfer. Empty parts are skipped.
+//
+AMTPTP_DEMUX_RESULT
+AmtPtpPacketDemuxNext(
+	_Inout_ PAMTPTP_PACKET_DEMUX Demux,
+	_Out_ const UCHAR** Report,
+	_Out_ SIZE_T* Length
+);
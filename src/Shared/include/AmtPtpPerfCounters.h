@@ -0,0 +1,57 @@
+// AmtPtpPerfCounters.h: Input path counters that are always on
+//
+// A field report only says that input felt wrong. These counters say where the
+// frames went: how many the driver parsed and handed to hidclass, how many were
+// lost because no read was pending or rejected as malformed, how often the
+// device had to be reset, and how long the reports took from the transport.
+//
+// Each counter is a 32-bit value bumped by one interlocked increment, so the
+// input path takes no lock for them and any thread may read them. A snapshot
+// is read field by field and is not consistent as a whole: two fields may be
+// a frame or two apart. Counters wrap, readers compare two snapshots.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+/* bucket n counts reports that took [2^(n-1), 2^n) us, 0 is under 1 us, the last one is open */
+#define AMTPTP_PERF_LATENCY_BUCKETS	16
+
+typedef struct _AMTPTP_PERF_COUNTERS {
+	volatile LONG	FramesIn;			/* touch frames handed to the decoder */
+	volatile LONG	ReportsOut;			/* PTP reads completed with a report */
+	volatile LONG	NoRequestDrops;		/* parked frames lost before a read came */
+	volatile LONG	Malformed;
+	volatile LONG	Resets;				/* mode switches asked for after bad input */
+	volatile LONG	SplitMerges;		/* frames rebuilt from two transfers */
+	volatile LONG	Latency[AMTPTP_PERF_LATENCY_BUCKETS];
+} AMTPTP_PERF_COUNTERS, *PAMTPTP_PERF_COUNTERS;
+
+/* ULONGs in a snapshot, in the order of the fields above */
+#define AMTPTP_PERF_COUNTER_COUNT	(6 + AMTPTP_PERF_LATENCY_BUCKETS)
+
+#define AMTPTP_PERF_COUNT(Counters, Field)	InterlockedIncrement(&(Counters)->Field)
+
+VOID
+AmtPtpPerfCountersInitialize(
+	_Out_ PAMTPTP_PERF_COUNTERS Counters
+);
+
+//
+// Counts one report that left Ticks after its transfer completed, on a clock
+// running at Frequency ticks per second.
+//
+VOID
+AmtPtpPerfCountersRecordLatency(
+	_Inout_ PAMTPTP_PERF_COUNTERS Counters,
+	_In_ ULONGLONG Ticks,
+	_In_ ULONGLONG Frequency
+);
+
+//
+// Copies the counters into Values, e.g. the body of a feature report.
+//
+VOID
+AmtPtpPerfCountersSnapshot(
+	_In_ const AMTPTP_PERF_COUNTERS* Counters,
+	_Out_writes_(AMTPTP_PERF_COUNTER_COUNT) ULONG* Values
+);
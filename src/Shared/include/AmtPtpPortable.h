@@ -0,0 +1,57 @@
+// AmtPtpPortable.h: Base types for code shared between the drivers
+//
+// Everything under src/Shared is free of WDF calls so it can be linked into the
+// UMDF and KMDF drivers alike, and compiled on a non-Windows host with gcc/clang.
+#pragma once
+
+#if defined(_KERNEL_MODE)
+#include <ntddk.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+typedef void				VOID, *PVOID;
+typedef uint8_t				UCHAR, *PUCHAR, UINT8, BOOLEAN, *PBOOLEAN;
+typedef int16_t				SHORT, *PSHORT;
+typedef uint16_t			USHORT, *PUSHORT, UINT16;
+typedef int32_t				LONG, *PLONG, INT;
+typedef uint32_t			ULONG, *PULONG, UINT, UINT32;
+typedef int64_t				LONGLONG, *PLONGLONG, LONG64;
+typedef uint64_t			ULONGLONG, *PULONGLONG, ULONG64;
+typedef size_t				SIZE_T;
+
+#define TRUE	1
+#define FALSE	0
+
+#define __forceinline __inline __attribute__((always_inline))
+
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+#define RtlCopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+#define InterlockedIncrement(Addend) __atomic_add_fetch((Addend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(Addend) __atomic_sub_fetch((Addend), 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchange(Target, Value) __atomic_exchange_n((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange(Destination, Exchange, Comparand) \
+	__sync_val_compare_and_swap((Destination), (Comparand), (Exchange))
+
+// SAL annotations are only meaningful to the MSVC analyzer
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _Inout_opt_
+#define _Inout_updates_(size)
+#define _In_reads_(size)
+#define _In_reads_bytes_(size)
+#define _Out_writes_(size)
+#define _Out_writes_bytes_(size)
+#endif
+
+// Reads a little-endian value from a possibly unaligned device buffer
+#define AMTPTP_READ_LE16(p) ((USHORT) (((const UCHAR*) (p))[0] | (((const UCHAR*) (p))[1] << 8)))
+#define AMTPTP_READ_LE32(p) ((ULONG) (((const UCHAR*) (p))[0] | (((const UCHAR*) (p))[1] << 8) | \
+	(((const UCHAR*) (p))[2] << 16) | ((ULONG) ((const UCHAR*) (p))[3] << 24)))
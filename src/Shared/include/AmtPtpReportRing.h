@@ -0,0 +1,104 @@
+// AmtPtpReportRing.h: Bounded backlog of decoded touch frames
+//
+// Input arrives from the device whether or not hidclass has a read pending.
+// Instead of throwing a frame away (and with it, possibly a lift-off), the
+// drivers park it here and hand it to the next IOCTL_HID_READ_REPORT.
+//
+// Each slot holds a whole scan. A scan with more contacts than a PTP report
+// holds is handed out one report at a time, and stays in its slot until the
+// last report is taken.
+//
+// The ring does no locking of its own. Deciding between "complete a pending
+// read" and "park the frame" has to be atomic with the read dispatch path
+// doing the opposite, so the caller holds its device lock around both the
+// queue operation and the ring operation.
+#pragma once
+
+#include <AmtPtpDecoder.h>
+
+#define AMTPTP_REPORT_RING_MAX_DEPTH		32
+#define AMTPTP_REPORT_RING_DEFAULT_DEPTH	8
+
+/* What to do with a new frame when every slot is taken */
+typedef enum _AMTPTP_RING_OVERFLOW_POLICY {
+	AmtPtpRingOverflowDropOldest,	/* Discard the oldest parked frame */
+	AmtPtpRingOverflowCoalesce,		/* Merge into the newest parked frame by ContactID */
+	AmtPtpRingOverflowMax
+} AMTPTP_RING_OVERFLOW_POLICY;
+
+typedef enum _AMTPTP_RING_PUSH_RESULT {
+	AmtPtpRingPushQueued,
+	AmtPtpRingPushCoalesced,
+	AmtPtpRingPushDroppedOldest
+} AMTPTP_RING_PUSH_RESULT;
+
+typedef struct _AMTPTP_REPORT_RING {
+	ULONG	Head;			/* free running write index */
+	ULONG	Tail;			/* free running read index */
+	ULONG	Depth;			/* power of two, rounded down at initialization */
+	AMTPTP_RING_OVERFLOW_POLICY Policy;
+
+	// Statistics, never reset by AmtPtpReportRingFlush
+	ULONG	Dropped;
+	ULONG	Coalesced;
+	ULONG	HighWatermark;
+
+	AMTPTP_DECODED_FRAME Slots[AMTPTP_REPORT_RING_MAX_DEPTH];
+} AMTPTP_REPORT_RING, *PAMTPTP_REPORT_RING;
+
+VOID
+AmtPtpReportRingInitialize(
+	_Out_ PAMTPTP_REPORT_RING Ring,
+	_In_ ULONG Depth,
+	_In_ AMTPTP_RING_OVERFLOW_POLICY Policy
+);
+
+AMTPTP_RING_PUSH_RESULT
+AmtPtpReportRingPush(
+	_Inout_ PAMTPTP_REPORT_RING Ring,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+);
+
+AMTPTP_RING_PUSH_RESULT
+AmtPtpReportRingPushRemainder(
+	_Inout_ PAMTPTP_REPORT_RING Ring,
+	_In_ const AMTPTP_DECODED_FRAME* Frame,
+	_In_ UCHAR ContactsPerReport
+);
+
+//
+// Returns the next report without taking it off the ring. A caller that can
+// fail to hand the report out peeks, and only advances once it went out.
+//
+BOOLEAN
+AmtPtpReportRingPeek(
+	_In_ const AMTPTP_REPORT_RING* Ring,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+);
+
+//
+// Takes the report AmtPtpReportRingPeek returned off the ring. The caller
+// holds its lock from the peek to here.
+//
+VOID
+AmtPtpReportRingAdvance(
+	_Inout_ PAMTPTP_REPORT_RING Ring,
+	_In_ UCHAR ContactsPerReport
+);
+
+//
+// AmtPtpReportRingPeek and AmtPtpReportRingAdvance in one.
+//
+BOOLEAN
+AmtPtpReportRingPop(
+	_Inout_ PAMTPTP_REPORT_RING Ring,
+	_In_ UCHAR ContactsPerReport,
+	_Out_ PAMTPTP_DECODED_FRAME Frame
+);
+
+VOID
+AmtPtpReportRingFlush(
+	_Inout_ PAMTPTP_REPORT_RING Ring
+);
+
+#define AmtPtpReportRingCount(Ring) ((Ring)->Head - (Ring)->Tail)
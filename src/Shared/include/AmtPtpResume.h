@@ -0,0 +1,80 @@
+// AmtPtpResume.h: Resume phases and retry backoff after D0 entry
+//
+// After a power transition the trackpad is dead until the transport reads are
+// out and the device is back in PTP / Wellspring mode. The drivers record when
+// each phase is reached, so the time from D0 entry to the first touch report
+// can be traced and compared across releases.
+//
+// Configuration attempts that fail are retried on a fast-first backoff: 10ms,
+// 50ms, 200ms, 500ms, then every second. Most devices only need a few
+// milliseconds more after D0 entry, a fixed multi-second timer leaves the pad
+// dead for that long.
+//
+// The tracker does no locking. The caller serializes it with the rest of its
+// input path, and passes host time in 100ns units.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+typedef enum _AMTPTP_RESUME_PHASE {
+	AmtPtpResumeEntered,		/* D0 entry */
+	AmtPtpResumeReadsStarted,	/* transport reads are out */
+	AmtPtpResumeConfigured,		/* device is back in PTP / Wellspring mode */
+	AmtPtpResumeFirstReport,	/* first touch report handed to hidclass */
+	AmtPtpResumePhaseMax
+} AMTPTP_RESUME_PHASE;
+
+typedef struct _AMTPTP_RESUME {
+	ULONG		Reached;		/* bit per phase */
+	ULONGLONG	Stamp[AmtPtpResumePhaseMax];
+	ULONG		Attempts;		/* failed attempts since entry or the last configuration */
+
+	// Statistics, never reset by AmtPtpResumeBegin
+	ULONG		Resumes;
+	ULONG		Retries;
+	ULONGLONG	LastFirstReport;	/* entry to first report of the last resume, 100ns units */
+	ULONGLONG	MaxFirstReport;
+} AMTPTP_RESUME, *PAMTPTP_RESUME;
+
+VOID
+AmtPtpResumeInitialize(
+	_Out_ PAMTPTP_RESUME Resume
+);
+
+//
+// Starts a new resume at D0 entry. Phases of the previous one are forgotten.
+//
+VOID
+AmtPtpResumeBegin(
+	_Inout_ PAMTPTP_RESUME Resume,
+	_In_ ULONGLONG HostTime
+);
+
+//
+// Records Phase and returns TRUE the first time it is reached in this resume.
+// Every report of AmtPtpResumeConfigured restarts the backoff.
+//
+BOOLEAN
+AmtPtpResumeMark(
+	_Inout_ PAMTPTP_RESUME Resume,
+	_In_ AMTPTP_RESUME_PHASE Phase,
+	_In_ ULONGLONG HostTime
+);
+
+//
+// Returns the delay before the next configuration attempt in milliseconds.
+//
+ULONG
+AmtPtpResumeNextRetry(
+	_Inout_ PAMTPTP_RESUME Resume
+);
+
+//
+// Returns the time from D0 entry to Phase in 100ns units, 0 if either has not
+// been reached.
+//
+ULONGLONG
+AmtPtpResumeElapsed(
+	_In_ const AMTPTP_RESUME* Resume,
+	_In_ AMTPTP_RESUME_PHASE Phase
+);
@@ -0,0 +1,55 @@
+// AmtPtpScanClock.h: PTP ScanTime from device or host time
+//
+// ScanTime is a 16-bit counter in 100us units. Hidclass only looks at the
+// difference between two reports, so the counter wraps at 0xFFFF on its own.
+//
+// Devices with a clock report it in milliseconds in a counter that wraps much
+// sooner (8 bits on Wellspring, 21 bits on Magic Trackpad 2). The clock adds
+// the masked difference between two frames to ScanTime. This removes the USB
+// and Bluetooth delivery jitter.
+//
+// The device clock is checked against host time on every frame. The host
+// difference is used instead when:
+//   - the frame has no device time, or the driver asked for host time only;
+//   - the gap is too long to tell how often the device counter wrapped;
+//   - the two clocks disagree by more than AMTPTP_SCAN_CLOCK_SLACK, which is
+//     what a device clock reset after a power transition looks like.
+//
+// The clock does no locking. The caller serializes updates with the rest of
+// its input path, and passes host time in 100ns units.
+#pragma once
+
+#include <AmtPtpDecoder.h>
+
+#define AMTPTP_SCAN_CLOCK_TICKS_PER_MS	10		/* device clocks count in ms */
+#define AMTPTP_SCAN_CLOCK_SLACK			500		/* 50ms, in ScanTime units */
+
+typedef struct _AMTPTP_SCAN_CLOCK {
+	ULONG		DeviceMask;			/* device counter wraps at DeviceMask + 1, 0 for host time only */
+	ULONG		LastDeviceTime;
+	BOOLEAN		DeviceSynced;		/* LastDeviceTime is valid */
+	BOOLEAN		HostSynced;			/* LastHostTime is valid */
+	ULONGLONG	LastHostTime;		/* 100ns units */
+	USHORT		ScanTime;			/* last value handed out */
+
+	// Statistics, never reset by AmtPtpScanClockReset
+	ULONG		Resyncs;			/* frames where the device clock was not trusted */
+} AMTPTP_SCAN_CLOCK, *PAMTPTP_SCAN_CLOCK;
+
+VOID
+AmtPtpScanClockInitialize(
+	_Out_ PAMTPTP_SCAN_CLOCK Clock,
+	_In_ ULONG DeviceMask
+);
+
+VOID
+AmtPtpScanClockUpdate(
+	_Inout_ PAMTPTP_SCAN_CLOCK Clock,
+	_Inout_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ ULONGLONG HostTime
+);
+
+VOID
+AmtPtpScanClockReset(
+	_Inout_ PAMTPTP_SCAN_CLOCK Clock
+);
@@ -0,0 +1,70 @@
+// AmtPtpSplitFrame.h: Reassembly of touch frames split across two reports
+//
+// Over Bluetooth, Magic Trackpad 2 frames with many fingers do not fit in a
+// single report. The device sends the first half as report 0xFC and the rest
+// as report 0xFE. The caller strips the report ID byte and hands both halves
+// here. The first half is copied into a small staging buffer, and the second
+// half is appended to it. Frames that are not split never pass through here.
+//
+// The staging buffer has no locking. The caller has to serialize the two
+// halves and consume the reassembled frame before it stages the next one.
+// Time is given in whatever unit the caller uses, as long as Timeout uses
+// the same unit.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+// Largest MT2 report 0x31 is 4 + 16 * 9 bytes, leave room for a composite report
+#define AMTPTP_SPLIT_FRAME_MAX_SIZE	256
+
+typedef enum _AMTPTP_SPLIT_RESULT {
+	AmtPtpSplitPending,		/* First half staged, waiting for the second half */
+	AmtPtpSplitComplete,	/* Reassembled frame returned */
+	AmtPtpSplitOrphan,		/* Second half without a first half, dropped */
+	AmtPtpSplitExpired,		/* First half was too old for this second half, both dropped */
+	AmtPtpSplitOverflow		/* Halves do not fit in the staging buffer, dropped */
+} AMTPTP_SPLIT_RESULT;
+
+typedef struct _AMTPTP_SPLIT_FRAME {
+	ULONGLONG	FirstTime;		/* when the staged first half arrived */
+	ULONGLONG	Timeout;		/* longest gap allowed between the two halves */
+	SIZE_T		Length;			/* staged bytes, 0 when no first half is pending */
+
+	// Statistics, never reset by AmtPtpSplitFrameReset
+	ULONG	Completed;
+	ULONG	Orphaned;
+	ULONG	Expired;
+	ULONG	Abandoned;			/* first half replaced by another first half */
+	ULONG	Overflowed;
+
+	UCHAR	Buffer[AMTPTP_SPLIT_FRAME_MAX_SIZE];
+} AMTPTP_SPLIT_FRAME, *PAMTPTP_SPLIT_FRAME;
+
+VOID
+AmtPtpSplitFrameInitialize(
+	_Out_ PAMTPTP_SPLIT_FRAME Split,
+	_In_ ULONGLONG Timeout
+);
+
+AMTPTP_SPLIT_RESULT
+AmtPtpSplitFrameFirst(
+	_Inout_ PAMTPTP_SPLIT_FRAME Split,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG Now
+);
+
+AMTPTP_SPLIT_RESULT
+AmtPtpSplitFrameSecond(
+	_Inout_ PAMTPTP_SPLIT_FRAME Split,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG Now,
+	_Out_ const UCHAR** Frame,
+	_Out_ SIZE_T* FrameLength
+);
+
+VOID
+AmtPtpSplitFrameReset(
+	_Inout_ PAMTPTP_SPLIT_FRAME Split
+);
@@ -0,0 +1,60 @@
+// AmtPtpStatusFrame.h: In-band status frames of the Magic Trackpad 2
+//
+// Besides touch frames, the MT2 sends a few short reports on the same pipe:
+// its battery level (0x90), a power-down notice (0x13), a bare mouse report
+// (0x02) once it has fallen back to mouse mode, and a 4 byte report 0x1C of
+// unknown meaning. None of them is a reason to stop reading. The caller hands
+// them here so that their payloads are kept, and re-arms multi-touch mode on
+// its own when told so while its reads keep going. The battery report is also
+// the first thing the trackpad sends after it powered on or reset, back in
+// mouse mode, so it re-arms as well.
+//
+// The cache does no locking. The caller serializes it with whoever reads the
+// battery level.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+#define AMTPTP_STATUS_MOUSE			0x02
+#define AMTPTP_STATUS_POWER_DOWN	0x13
+#define AMTPTP_STATUS_UNKNOWN		0x1c
+#define AMTPTP_STATUS_BATTERY		0x90
+
+typedef enum _AMTPTP_STATUS_ACTION {
+	AmtPtpStatusNone,		/* not a status frame */
+	AmtPtpStatusCached,		/* payload kept, nothing else to do */
+	AmtPtpStatusTruncated,	/* too short for its payload, ignored */
+	AmtPtpStatusRearm		/* the device left or may have left multi-touch mode */
+} AMTPTP_STATUS_ACTION;
+
+typedef struct _AMTPTP_STATUS_CACHE {
+	BOOLEAN	BatteryValid;
+	UCHAR	BatteryFlags;
+	UCHAR	BatteryLevel;		/* percent */
+	UCHAR	PowerDown[2];		/* payload of the last 0x13 */
+	UCHAR	Unknown[3];			/* payload of the last 0x1C */
+
+	// Statistics, never reset
+	ULONG	Battery;
+	ULONG	PowerDowns;
+	ULONG	MouseFrames;
+	ULONG	Unknowns;
+	ULONG	Truncated;
+} AMTPTP_STATUS_CACHE, *PAMTPTP_STATUS_CACHE;
+
+VOID
+AmtPtpStatusCacheInitialize(
+	_Out_ PAMTPTP_STATUS_CACHE Cache
+);
+
+//
+// Keeps the payload of a status frame. Buffer starts with the report id. A
+// mouse report is only a status frame on its own, the caller strips the one
+// that prefixes USB touch frames before.
+//
+AMTPTP_STATUS_ACTION
+AmtPtpStatusFrameRecord(
+	_Inout_ PAMTPTP_STATUS_CACHE Cache,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length
+);
@@ -0,0 +1,101 @@
+// AmtPtpTraceRing.h: Per-frame trace budget, sampling and an in-memory event ring
+//
+// A formatted trace line per frame, let alone one per finger, costs more than
+// decoding the frame, and the WPP in-flight recorder pays for it whether or not
+// a session listens. The input paths keep two cheap substitutes instead:
+//
+// - A sampler lets per-frame content through for one frame in
+//   AMTPTP_TRACE_SAMPLE_INTERVAL.
+// - A ring of small binary records keeps the outline of the last frames:
+//   length, decoder verdict, contacts, where the frame went. The driver dumps
+//   it to the trace when something goes wrong, so the frames leading up to an
+//   error are there without tracing every frame.
+//
+// Writers claim a slot with one interlocked increment and need no lock, any
+// number of them may run at once. A reader walks the ring without stopping
+// them. A record that is overwritten while it is read fails its sequence
+// check and is skipped.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+/* records kept, a power of two */
+#define AMTPTP_TRACE_RING_SIZE			64
+
+/* per-frame content goes out for one frame in this many, a power of two */
+#define AMTPTP_TRACE_SAMPLE_INTERVAL	64
+
+typedef enum _AMTPTP_TRACE_EVENT {
+	AmtPtpTraceFrameIn,			/* Arg0 transfer length, Arg1 AMTPTP_FRAME_CHECK */
+	AmtPtpTraceFrameRejected,	/* Arg0 transfer length, Arg1 AMTPTP_FRAME_VERDICT */
+	AmtPtpTraceFrameParked,		/* Arg0 contacts, Arg1 report ring depth */
+	AmtPtpTraceFrameDropped,	/* Arg0 contacts, no read pending and nowhere to park it */
+	AmtPtpTraceReportOut,		/* Arg0 contacts, Arg1 scan time */
+	AmtPtpTraceStatusFrame,		/* Arg0 report id, Arg1 transfer length */
+	AmtPtpTraceEventMax
+} AMTPTP_TRACE_EVENT;
+
+typedef struct _AMTPTP_TRACE_RECORD {
+	volatile LONG	Sequence;	/* slot number + 1 once written, 0 while it is written */
+	ULONG			Event;		/* AMTPTP_TRACE_EVENT */
+	ULONG			Arg0;
+	ULONG			Arg1;
+	ULONGLONG		Time;		/* caller's clock, e.g. interrupt time */
+} AMTPTP_TRACE_RECORD, *PAMTPTP_TRACE_RECORD;
+
+typedef struct _AMTPTP_TRACE_RING {
+	volatile LONG		Next;			/* slots handed out so far */
+	ULONG				SampleCountdown;
+	AMTPTP_TRACE_RECORD	Records[AMTPTP_TRACE_RING_SIZE];
+} AMTPTP_TRACE_RING, *PAMTPTP_TRACE_RING;
+
+typedef struct _AMTPTP_TRACE_CURSOR {
+	ULONG	Position;
+	ULONG	End;
+} AMTPTP_TRACE_CURSOR;
+
+VOID
+AmtPtpTraceRingInitialize(
+	_Out_ PAMTPTP_TRACE_RING Ring
+);
+
+VOID
+AmtPtpTraceRingRecord(
+	_Inout_ PAMTPTP_TRACE_RING Ring,
+	_In_ AMTPTP_TRACE_EVENT Event,
+	_In_ ULONG Arg0,
+	_In_ ULONG Arg1,
+	_In_ ULONGLONG Time
+);
+
+//
+// TRUE for one call in AMTPTP_TRACE_SAMPLE_INTERVAL. The countdown is not
+// interlocked: concurrent callers may shift which frame is sampled, never
+// how often.
+//
+BOOLEAN
+AmtPtpTraceRingSample(
+	_Inout_ PAMTPTP_TRACE_RING Ring
+);
+
+//
+// Walks the records in the ring from the oldest to the newest written before
+// the walk began.
+//
+VOID
+AmtPtpTraceRingBegin(
+	_In_ const AMTPTP_TRACE_RING* Ring,
+	_Out_ AMTPTP_TRACE_CURSOR* Cursor
+);
+
+BOOLEAN
+AmtPtpTraceRingNext(
+	_In_ const AMTPTP_TRACE_RING* Ring,
+	_Inout_ AMTPTP_TRACE_CURSOR* Cursor,
+	_Out_ AMTPTP_TRACE_RECORD* Record
+);
+
+const char*
+AmtPtpTraceEventName(
+	_In_ ULONG Event
+);
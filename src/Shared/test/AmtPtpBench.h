@@ -0,0 +1,51 @@
+// AmtPtpBench.h: Timing for the host benchmarks
+//
+// A benchmark runs each case for a number of iterations, given as its first
+// argument, and prints the time per operation. ctest runs every benchmark
+// with a handful of iterations so that they keep building and running; the
+// numbers only mean something in an optimized build run by hand.
+//
+// Include this first, clock_gettime needs _POSIX_C_SOURCE before any system
+// header.
+#pragma once
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <AmtPtpPortable.h>
+
+// Keeps the results of a benchmark loop from being optimized away
+static volatile ULONG AmtPtpBenchSink;
+
+static __inline ULONGLONG
+AmtPtpBenchNow(VOID)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (ULONGLONG) now.tv_sec * 1000000000ULL + (ULONGLONG) now.tv_nsec;
+}
+
+static __inline ULONG
+AmtPtpBenchIterations(
+	int argc,
+	char** argv,
+	_In_ ULONG Default
+)
+{
+	ULONG iterations = (argc > 1) ? (ULONG) strtoul(argv[1], NULL, 10) : Default;
+	return iterations ? iterations : 1;
+}
+
+static __inline VOID
+AmtPtpBenchReport(
+	_In_ const char* Name,
+	_In_ ULONGLONG Elapsed,
+	_In_ ULONG Operations
+)
+{
+	printf("%-40s %10.1f ns/op %12.0f op/s\n", Name, (double) Elapsed / Operations,
+		Elapsed ? Operations * 1e9 / (double) Elapsed : 0.0);
+}
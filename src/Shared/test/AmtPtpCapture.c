@@ -0,0 +1,222 @@
+// AmtPtpCapture.c: Frame captures for the host tests and tools
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <AmtPtpCapture.h>
+
+#define AMTPTP_CAPTURE_MAX_LINE (AMTPTP_CAPTURE_MAX_FRAME * 2 + 64)
+
+static int
+AmtPtpCaptureHexDigit(
+	_In_ char Digit
+)
+{
+	if (Digit >= '0' && Digit <= '9') return Digit - '0';
+	if (Digit >= 'a' && Digit <= 'f') return Digit - 'a' + 10;
+	if (Digit >= 'A' && Digit <= 'F') return Digit - 'A' + 10;
+	return -1;
+}
+
+static BOOLEAN
+AmtPtpCaptureParseHex(
+	_In_ const char* Text,
+	_Out_ PAMTPTP_CAPTURE_FRAME Frame
+)
+{
+	Frame->Length = 0;
+	while (Text[0] != '\0' && Text[0] != '\n' && Text[0] != '\r') {
+		int high = AmtPtpCaptureHexDigit(Text[0]);
+		int low = (high < 0) ? -1 : AmtPtpCaptureHexDigit(Text[1]);
+
+		if (low < 0 || Frame->Length == AMTPTP_CAPTURE_MAX_FRAME) {
+			return FALSE;
+		}
+
+		Frame->Data[Frame->Length++] = (UCHAR) ((high << 4) | low);
+		Text += 2;
+	}
+
+	return TRUE;
+}
+
+static PAMTPTP_CAPTURE_FRAME
+AmtPtpCaptureAppend(
+	_Inout_ PAMTPTP_CAPTURE Capture,
+	_Inout_ ULONG* Capacity
+)
+{
+	PAMTPTP_CAPTURE_FRAME frames;
+
+	if (Capture->FrameCount == *Capacity) {
+		ULONG capacity = *Capacity ? *Capacity * 2 : 64;
+		frames = realloc(Capture->Frames, capacity * sizeof(AMTPTP_CAPTURE_FRAME));
+		if (frames == NULL) {
+			return NULL;
+		}
+		Capture->Frames = frames;
+		*Capacity = capacity;
+	}
+
+	frames = &Capture->Frames[Capture->FrameCount++];
+	RtlZeroMemory(frames, sizeof(AMTPTP_CAPTURE_FRAME));
+	return frames;
+}
+
+static BOOLEAN
+AmtPtpCaptureParseLine(
+	_In_ char* Line,
+	_Inout_ PAMTPTP_CAPTURE Capture,
+	_Inout_ ULONG* Capacity
+)
+{
+	PAMTPTP_CAPTURE_FRAME frame = Capture->FrameCount ? &Capture->Frames[Capture->FrameCount - 1] : NULL;
+	char bus[8], time[16];
+	unsigned int vid, pid, flags, button, count;
+	unsigned long long hostTime;
+	int offset;
+
+	if (Line[0] == '#' || Line[0] == '\n' || Line[0] == '\r' || Line[0] == '\0') {
+		return TRUE;
+	}
+
+	if (sscanf(Line, "device %7s %x %x", bus, &vid, &pid) == 3) {
+		if (strcmp(bus, "usb") == 0) Capture->Bus = AmtPtpBusUsb;
+		else if (strcmp(bus, "bth") == 0) Capture->Bus = AmtPtpBusBluetooth;
+		else if (strcmp(bus, "spi") == 0) Capture->Bus = AmtPtpBusSpi;
+		else return FALSE;
+
+		Capture->VendorId = (USHORT) vid;
+		Capture->ProductId = (USHORT) pid;
+		Capture->Model = AmtPtpDeviceRegistryLookup(Capture->Bus, Capture->VendorId, Capture->ProductId);
+		return Capture->Model != NULL;
+	}
+
+	if (sscanf(Line, "flags %u", &flags) == 1) {
+		Capture->Flags = flags;
+		return TRUE;
+	}
+
+	if (sscanf(Line, "frame %llu %n", &hostTime, &offset) == 1) {
+		frame = AmtPtpCaptureAppend(Capture, Capacity);
+		if (frame == NULL) {
+			return FALSE;
+		}
+		frame->HostTime = hostTime * 10;
+		return AmtPtpCaptureParseHex(Line + offset, frame);
+	}
+
+	if (frame == NULL) {
+		return FALSE;
+	}
+
+	if (strncmp(Line, "expect malformed", 16) == 0) {
+		frame->HasExpect = TRUE;
+		frame->ExpectResult = AmtPtpDecodeMalformed;
+		return TRUE;
+	}
+
+	if (sscanf(Line, "expect ok %u %15s %u", &button, time, &count) == 3) {
+		if (count > AMTPTP_DECODER_MAX_CONTACTS) {
+			return FALSE;
+		}
+		frame->HasExpect = TRUE;
+		frame->ExpectResult = AmtPtpDecodeOk;
+		frame->Expect.IsButtonClicked = (BOOLEAN) button;
+		frame->Expect.HasDeviceTime = (time[0] != '-');
+		frame->Expect.DeviceTime = frame->Expect.HasDeviceTime ? (ULONG) strtoul(time, NULL, 10) : 0;
+		frame->ExpectContacts = (UCHAR) count;
+		return TRUE;
+	}
+
+	if (strncmp(Line, "contact ", 8) == 0) {
+		unsigned int v[9];
+		PAMTPTP_DECODED_CONTACT contact;
+
+		if (!frame->HasExpect || frame->Expect.ContactCount >= frame->ExpectContacts ||
+			sscanf(Line + 8, "%u %u %u %u %u %u %u %u %u",
+				&v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) != 9) {
+			return FALSE;
+		}
+
+		contact = &frame->Expect.Contacts[frame->Expect.ContactCount++];
+		contact->ContactID = (UCHAR) v[0];
+		contact->X = (USHORT) v[1];
+		contact->Y = (USHORT) v[2];
+		contact->TipSwitch = (UCHAR) v[3];
+		contact->Confidence = (UCHAR) v[4];
+		contact->Finger = (UCHAR) v[5];
+		contact->TouchMajor = (USHORT) v[6];
+		contact->TouchMinor = (USHORT) v[7];
+		contact->Pressure = (USHORT) v[8];
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+BOOLEAN
+AmtPtpCaptureLoad(
+	_In_ const char* Path,
+	_Out_ PAMTPTP_CAPTURE Capture
+)
+{
+	static char line[AMTPTP_CAPTURE_MAX_LINE];
+	ULONG capacity = 0, lineNumber = 0, i;
+	BOOLEAN result = TRUE;
+	FILE* file;
+
+	RtlZeroMemory(Capture, sizeof(AMTPTP_CAPTURE));
+	Capture->Path = Path;
+
+	file = fopen(Path, "r");
+	if (file == NULL) {
+		fprintf(stderr, "%s: cannot open\n", Path);
+		return FALSE;
+	}
+
+	while (result && fgets(line, sizeof(line), file) != NULL) {
+		lineNumber++;
+		result = AmtPtpCaptureParseLine(line, Capture, &capacity);
+	}
+	fclose(file);
+
+	if (!result) {
+		fprintf(stderr, "%s:%u: cannot parse\n", Path, lineNumber);
+	} else if (Capture->Model == NULL) {
+		fprintf(stderr, "%s: no device line\n", Path);
+		result = FALSE;
+	}
+
+	// Every contact announced by an expect line has to be there
+	for (i = 0; result && i < Capture->FrameCount; i++) {
+		PAMTPTP_CAPTURE_FRAME frame = &Capture->Frames[i];
+		if (frame->Expect.ContactCount != frame->ExpectContacts) {
+			fprintf(stderr, "%s: frame %u lacks contacts\n", Path, i);
+			result = FALSE;
+		}
+	}
+
+	if (!result) {
+		AmtPtpCaptureFree(Capture);
+	}
+	return result;
+}
+
+VOID
+AmtPtpCaptureFree(
+	_Inout_ PAMTPTP_CAPTURE Capture
+)
+{
+	free(Capture->Frames);
+	Capture->Frames = NULL;
+	Capture->FrameCount = 0;
+}
+
+VOID
+AmtPtpCaptureInitDecoderConfig(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_Out_ PAMTPTP_DECODER_CONFIG Config
+)
+{
+	AmtPtpDeviceRegistryInitDecoderConfig(Capture->Model, Capture->Flags, Config);
+}
@@ -0,0 +1,59 @@
+// AmtPtpCapture.h: Frame captures for the host tests and tools
+//
+// A capture is a text recording of one device: its registry key, the decoder
+// flags its driver uses, and every transfer with its host arrival time. Frames
+// may carry the decode they are expected to produce. corpus/make-corpus.py
+// documents the format and writes the corpus.
+#pragma once
+
+#include <AmtPtpDeviceRegistry.h>
+
+// Longest transfer of any layout, REPORT_BUFFER_SIZE of the drivers
+#define AMTPTP_CAPTURE_MAX_FRAME	1024
+
+typedef struct _AMTPTP_CAPTURE_FRAME {
+	ULONGLONG	HostTime;		/* 100ns units, like KeQueryInterruptTime */
+	ULONG		Length;
+	UCHAR		Data[AMTPTP_CAPTURE_MAX_FRAME];
+
+	// Expected decode, ContactCount and DeviceTime are only set for AmtPtpDecodeOk
+	BOOLEAN					HasExpect;
+	UCHAR					ExpectContacts;	/* announced by the expect line */
+	AMTPTP_DECODE_RESULT	ExpectResult;
+	AMTPTP_DECODED_FRAME	Expect;
+} AMTPTP_CAPTURE_FRAME, *PAMTPTP_CAPTURE_FRAME;
+
+typedef struct _AMTPTP_CAPTURE {
+	const char*		Path;
+	AMTPTP_BUS		Bus;
+	USHORT			VendorId;
+	USHORT			ProductId;
+	const AMTPTP_DEVICE_MODEL* Model;
+	ULONG			Flags;		/* AMTPTP_DECODER_FLAG_* */
+	ULONG			FrameCount;
+	PAMTPTP_CAPTURE_FRAME Frames;
+} AMTPTP_CAPTURE, *PAMTPTP_CAPTURE;
+
+//
+// Returns FALSE and prints the offending line if Path cannot be read, does not
+// parse or names a device the registry does not know.
+//
+BOOLEAN
+AmtPtpCaptureLoad(
+	_In_ const char* Path,
+	_Out_ PAMTPTP_CAPTURE Capture
+);
+
+VOID
+AmtPtpCaptureFree(
+	_Inout_ PAMTPTP_CAPTURE Capture
+);
+
+//
+// The decoder config the capture's driver would use.
+//
+VOID
+AmtPtpCaptureInitDecoderConfig(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_Out_ PAMTPTP_DECODER_CONFIG Config
+);
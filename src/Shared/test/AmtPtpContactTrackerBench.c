@@ -0,0 +1,97 @@
+// AmtPtpContactTrackerBench.c: Tracker cost at 16 raw fingers per frame
+
+#include <AmtPtpBench.h>
+#include <AmtPtpContactTracker.h>
+#include <AmtPtpDeviceRegistry.h>
+
+#define BENCH_FRAMES	64
+
+// 16 fingers drifting across the pad. With Churn, a quarter of them lift and
+// land somewhere else every frame, so IDs are retired and handed out too.
+static VOID
+AmtPtpBenchFrames(
+	_Out_writes_(BENCH_FRAMES) PAMTPTP_DECODED_FRAME Frames,
+	_In_ BOOLEAN Churn
+)
+{
+	ULONG seed = 1;
+	UCHAR f, i;
+
+	for (f = 0; f < BENCH_FRAMES; f++) {
+		RtlZeroMemory(&Frames[f], sizeof(AMTPTP_DECODED_FRAME));
+		Frames[f].ContactCount = AMTPTP_DECODER_MAX_CONTACTS;
+		for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+			PAMTPTP_DECODED_CONTACT contact = &Frames[f].Contacts[i];
+			BOOLEAN moved = Churn && ((i + f) % 4 == 0);
+
+			seed = seed * 1103515245 + 12345;
+			contact->ContactID = (UCHAR) (moved ? (i + 8) & 0xF : i);
+			contact->X = (USHORT) ((i % 4) * 1800 + f * 4 + (moved ? 900 : 0) + (seed >> 28));
+			contact->Y = (USHORT) ((i / 4) * 1500 + f * 2 + (moved ? 700 : 0) + ((seed >> 24) & 0xF));
+			contact->TipSwitch = 1;
+			contact->Confidence = (UCHAR) (i != 15);
+			contact->TouchMajor = 400;
+			contact->TouchMinor = 300;
+		}
+	}
+}
+
+static VOID
+AmtPtpBenchTracker(
+	_In_ const char* Name,
+	_In_ AMTPTP_DEVICE_MODEL_ID Model,
+	_In_ BOOLEAN Churn,
+	_In_ UCHAR MaxContacts,
+	_In_ BOOLEAN Defuzz,
+	_In_ ULONG Iterations
+)
+{
+	static AMTPTP_DECODED_FRAME frames[BENCH_FRAMES];
+	const AMTPTP_DEVICE_MODEL* model = AmtPtpDeviceRegistryGetModel(Model);
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+	ULONGLONG start;
+	ULONG i;
+
+	AmtPtpDeviceRegistryInitDecoderConfig(model, 0, &config);
+	AmtPtpContactTrackerInitialize(&tracker, &config);
+	if (Defuzz) {
+		AmtPtpContactTrackerSetFuzz(&tracker,
+			AMTPTP_FUZZ_FROM_SNRATIO(model->X.Min, model->X.Max, model->X.SnRatio),
+			AMTPTP_FUZZ_FROM_SNRATIO(model->Y.Min, model->Y.Max, model->Y.SnRatio));
+	}
+	AmtPtpBenchFrames(frames, Churn);
+
+	// The copy in is part of every driver's input path as well
+	start = AmtPtpBenchNow();
+	for (i = 0; i < Iterations; i++) {
+		RtlCopyMemory(&frame, &frames[i % BENCH_FRAMES], sizeof(AMTPTP_DECODED_FRAME));
+		AmtPtpContactTrackerUpdate(&tracker, &frame, MaxContacts);
+		AmtPtpBenchSink += frame.ContactCount;
+	}
+	AmtPtpBenchReport(Name, AmtPtpBenchNow() - start, Iterations);
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	ULONG iterations = AmtPtpBenchIterations(argc, argv, 1000000);
+
+	AmtPtpBenchTracker("device ids, 16 held, 5 per report", AmtPtpModelMagicTrackpad2Bluetooth,
+		FALSE, 5, TRUE, iterations);
+	AmtPtpBenchTracker("device ids, 16 held, hybrid", AmtPtpModelMagicTrackpad2Bluetooth,
+		FALSE, AMTPTP_DECODER_MAX_CONTACTS, TRUE, iterations);
+	AmtPtpBenchTracker("device ids, 16 held, hybrid, no defuzz", AmtPtpModelMagicTrackpad2Bluetooth,
+		FALSE, AMTPTP_DECODER_MAX_CONTACTS, FALSE, iterations);
+	AmtPtpBenchTracker("device ids, 16 with churn, hybrid", AmtPtpModelMagicTrackpad2Bluetooth,
+		TRUE, AMTPTP_DECODER_MAX_CONTACTS, TRUE, iterations);
+	AmtPtpBenchTracker("slot ids, 16 held, 5 per report", AmtPtpModelSpiFamily2,
+		FALSE, 5, TRUE, iterations);
+	AmtPtpBenchTracker("slot ids, 16 with churn, hybrid", AmtPtpModelSpiFamily2,
+		TRUE, AMTPTP_DECODER_MAX_CONTACTS, TRUE, iterations);
+	return 0;
+}
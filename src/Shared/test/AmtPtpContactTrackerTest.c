@@ -0,0 +1,582 @@
+// AmtPtpContactTrackerTest.c: Contact IDs from touch-down to lift-off, and defuzz
+//
+// Usage: AmtPtpContactTrackerTest <capture>...
+
+#include <stdlib.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpCapture.h>
+#include <AmtPtpContactTracker.h>
+#include <AmtPtpDeviceRegistry.h>
+
+#define CONTACTS_PER_REPORT	5
+
+static VOID
+AmtPtpTestTracker(
+	_Out_ PAMTPTP_CONTACT_TRACKER Tracker,
+	_In_ AMTPTP_DEVICE_MODEL_ID Model
+)
+{
+	AMTPTP_DECODER_CONFIG config;
+
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(Model), 0, &config);
+	AmtPtpContactTrackerInitialize(Tracker, &config);
+}
+
+static VOID
+AmtPtpTestContact(
+	_Inout_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ UCHAR DeviceId,
+	_In_ USHORT X,
+	_In_ USHORT Y,
+	_In_ UCHAR TipSwitch,
+	_In_ UCHAR Confidence
+)
+{
+	PAMTPTP_DECODED_CONTACT contact = &Frame->Contacts[Frame->ContactCount++];
+
+	RtlZeroMemory(contact, sizeof(AMTPTP_DECODED_CONTACT));
+	contact->ContactID = DeviceId;
+	contact->X = X;
+	contact->Y = Y;
+	contact->TipSwitch = TipSwitch;
+	contact->Confidence = Confidence;
+}
+
+// Index of the contact with PTP id Id in Frame, -1 if it is not there
+static int
+AmtPtpTestFind(
+	_In_ const AMTPTP_DECODED_FRAME* Frame,
+	_In_ UCHAR Id
+)
+{
+	UCHAR i;
+
+	for (i = 0; i < Frame->ContactCount; i++) {
+		if (Frame->Contacts[i].ContactID == Id) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+//
+// Held contacts keep the ID they touched down with, whatever order the
+// device lists them in.
+//
+static VOID
+AmtPtpTestHeld(VOID)
+{
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+	USHORT step;
+
+	AmtPtpTestTracker(&tracker, AmtPtpModelMagicTrackpad2Bluetooth);
+
+	for (step = 0; step < 10; step++) {
+		RtlZeroMemory(&frame, sizeof(frame));
+		// Device ids 9, 4, 12, listed in a different order every other frame
+		if (step & 1) {
+			AmtPtpTestContact(&frame, 12, 3000 + step, 300, 1, 1);
+			AmtPtpTestContact(&frame, 9, 1000 + step, 100, 1, 1);
+			AmtPtpTestContact(&frame, 4, 2000 + step, 200, 1, 1);
+		} else {
+			AmtPtpTestContact(&frame, 9, 1000 + step, 100, 1, 1);
+			AmtPtpTestContact(&frame, 4, 2000 + step, 200, 1, 1);
+			AmtPtpTestContact(&frame, 12, 3000 + step, 300, 1, 1);
+		}
+
+		AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+		AMTPTP_CHECK_EQ(frame.ContactCount, 3);
+		AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 0)].X, 1000 + step);
+		AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 1)].X, 2000 + step);
+		AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 2)].X, 3000 + step);
+	}
+
+	AMTPTP_CHECK_EQ(tracker.LiftOffs, 0);
+	AMTPTP_CHECK_EQ(tracker.Dropped, 0);
+}
+
+//
+// A contact the device lifts goes out once with TipSwitch = 0. One that just
+// vanishes gets that lift-off from the tracker, at its last position.
+//
+static VOID
+AmtPtpTestLiftOff(VOID)
+{
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+	int found;
+
+	AmtPtpTestTracker(&tracker, AmtPtpModelMagicTrackpad2Bluetooth);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 1, 100, 100, 1, 1);
+	AmtPtpTestContact(&frame, 2, 500, 500, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+
+	// Device id 1 lifts, device id 2 vanishes
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 1, 110, 110, 0, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 2);
+
+	found = AmtPtpTestFind(&frame, 0);
+	AMTPTP_CHECK(found >= 0 && frame.Contacts[found].TipSwitch == 0 && frame.Contacts[found].X == 110);
+	found = AmtPtpTestFind(&frame, 1);
+	AMTPTP_CHECK(found >= 0 && frame.Contacts[found].TipSwitch == 0 && frame.Contacts[found].X == 500);
+	AMTPTP_CHECK_EQ(tracker.LiftOffs, 1);
+
+	// Both are gone for good, nothing more is reported
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 0);
+	AMTPTP_CHECK_EQ(tracker.LiftOffs, 1);
+}
+
+//
+// A device id that lifts and touches down again is a new contact with a new
+// ID. An ID freed by a lift-off is not handed out in the same frame.
+//
+static VOID
+AmtPtpTestReuse(VOID)
+{
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+
+	AmtPtpTestTracker(&tracker, AmtPtpModelMagicTrackpad2Bluetooth);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 3, 100, 100, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].ContactID, 0);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 3, 100, 100, 0, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].ContactID, 0);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].TipSwitch, 0);
+
+	// Same device id down again
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 3, 900, 900, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 1);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].ContactID, 1);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].TipSwitch, 1);
+
+	// It vanishes while another finger lands: the lift-off keeps ID 1 and
+	// the new finger does not get it
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 7, 400, 400, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 2);
+	AMTPTP_CHECK(AmtPtpTestFind(&frame, 1) >= 0 && frame.Contacts[AmtPtpTestFind(&frame, 1)].TipSwitch == 0);
+	AMTPTP_CHECK(AmtPtpTestFind(&frame, 0) >= 0 && frame.Contacts[AmtPtpTestFind(&frame, 0)].X == 400);
+
+	// A frame later, ID 1 is free again
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 7, 400, 400, 1, 1);
+	AmtPtpTestContact(&frame, 8, 700, 700, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 2);
+	AMTPTP_CHECK(AmtPtpTestFind(&frame, 1) >= 0 && frame.Contacts[AmtPtpTestFind(&frame, 1)].X == 700);
+}
+
+//
+// With slot ids, contacts are followed by position: two fingers that swap
+// slots keep their IDs, a finger that jumps across the pad is a new one.
+//
+static VOID
+AmtPtpTestSlots(VOID)
+{
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+	int found;
+
+	AmtPtpTestTracker(&tracker, AmtPtpModelSpiFamily2);
+	AMTPTP_CHECK(tracker.MatchByPosition);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 0, 1000, 1000, 1, 1);
+	AmtPtpTestContact(&frame, 1, 5000, 5000, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].ContactID, 0);
+	AMTPTP_CHECK_EQ(frame.Contacts[1].ContactID, 1);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 0, 5040, 5030, 1, 1);
+	AmtPtpTestContact(&frame, 1, 1020, 990, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 2);
+	AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 0)].X, 1020);
+	AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 1)].X, 5040);
+
+	// The finger at 1020 jumps to the far corner: lift-off and a new ID
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 0, 5040, 5030, 1, 1);
+	AmtPtpTestContact(&frame, 1, 9800, 6500, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 3);
+	found = AmtPtpTestFind(&frame, 0);
+	AMTPTP_CHECK(found >= 0 && frame.Contacts[found].TipSwitch == 0 && frame.Contacts[found].X == 1020);
+	found = AmtPtpTestFind(&frame, 2);
+	AMTPTP_CHECK(found >= 0 && frame.Contacts[found].X == 9800);
+	AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 1)].X, 5040);
+}
+
+//
+// Past the report limit, contacts hidclass is tracking and lift-offs go
+// first, then tip-down contacts, then confident ones.
+//
+static VOID
+AmtPtpTestPriority(VOID)
+{
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+
+	AmtPtpTestTracker(&tracker, AmtPtpModelMagicTrackpad2Bluetooth);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 1, 100, 100, 1, 0);
+	AmtPtpTestContact(&frame, 2, 200, 200, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+
+	// 1 stays, 2 vanishes, five new contacts of every kind land
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 10, 1000, 0, 0, 0);	/* hovering, not confident */
+	AmtPtpTestContact(&frame, 11, 1100, 0, 0, 1);	/* hovering */
+	AmtPtpTestContact(&frame, 12, 1200, 0, 1, 0);	/* down, not confident */
+	AmtPtpTestContact(&frame, 13, 1300, 0, 1, 1);	/* down */
+	AmtPtpTestContact(&frame, 1, 110, 110, 1, 0);
+	AmtPtpTestContact(&frame, 14, 1400, 0, 1, 1);	/* down */
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+
+	AMTPTP_CHECK_EQ(frame.ContactCount, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].X, 110);			/* tracked device id 1 */
+	AMTPTP_CHECK_EQ(frame.Contacts[1].ContactID, 1);	/* lift-off of device id 2 */
+	AMTPTP_CHECK_EQ(frame.Contacts[1].TipSwitch, 0);
+	AMTPTP_CHECK_EQ(frame.Contacts[2].X, 1300);
+	AMTPTP_CHECK_EQ(frame.Contacts[3].X, 1400);
+	AMTPTP_CHECK_EQ(frame.Contacts[4].X, 1200);
+	AMTPTP_CHECK_EQ(tracker.Dropped, 2);
+
+	// The ones left out are still tracked and keep their IDs
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 11, 1100, 0, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 3)].X, 1100);
+}
+
+//
+// A contact hidclass has down that a lower cap leaves out is still down for
+// hidclass. It keeps its ID and gets its lift-off once there is room.
+//
+static VOID
+AmtPtpTestOverCap(VOID)
+{
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+	UCHAR i;
+
+	AmtPtpTestTracker(&tracker, AmtPtpModelMagicTrackpad2Bluetooth);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	for (i = 0; i < 8; i++) {
+		AmtPtpTestContact(&frame, i, (USHORT) (i * 100), 0, 1, 1);
+	}
+	AmtPtpContactTrackerUpdate(&tracker, &frame, 8);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 8);
+
+	// Still down, three do not fit
+	frame.ContactCount = 0;
+	for (i = 0; i < 8; i++) {
+		AmtPtpTestContact(&frame, i, (USHORT) (i * 100 + 10), 0, 1, 1);
+	}
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(tracker.Dropped, 3);
+
+	// All vanish, every one of them is lifted
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpContactTrackerUpdate(&tracker, &frame, 8);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 8);
+	for (i = 0; i < 8; i++) {
+		AMTPTP_CHECK(AmtPtpTestFind(&frame, i) >= 0 && frame.Contacts[AmtPtpTestFind(&frame, i)].TipSwitch == 0);
+	}
+	AMTPTP_CHECK_EQ(tracker.LiftOffs, 8);
+
+	// Lift-offs past the cap go out with the next update
+	RtlZeroMemory(&frame, sizeof(frame));
+	for (i = 0; i < 8; i++) {
+		AmtPtpTestContact(&frame, i, (USHORT) (i * 100), 0, 1, 1);
+	}
+	AmtPtpContactTrackerUpdate(&tracker, &frame, 8);
+	AmtPtpContactTrackerLiftAll(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, CONTACTS_PER_REPORT);
+	AmtPtpContactTrackerLiftAll(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 3);
+	for (i = 0; i < frame.ContactCount; i++) {
+		AMTPTP_CHECK_EQ(frame.Contacts[i].TipSwitch, 0);
+		AMTPTP_CHECK(frame.Contacts[i].ContactID >= CONTACTS_PER_REPORT);
+	}
+	AmtPtpContactTrackerLiftAll(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 0);
+	AMTPTP_CHECK_EQ(tracker.LiftOffs, 16);
+}
+
+//
+// Sixteen tracked contacts use every ID. A new contact next to a lift-off
+// waits a frame for the freed ID.
+//
+static VOID
+AmtPtpTestOutOfIds(VOID)
+{
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+	UCHAR i;
+
+	AmtPtpTestTracker(&tracker, AmtPtpModelMagicTrackpad2Bluetooth);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+		AmtPtpTestContact(&frame, i, (USHORT) (i * 100), 0, 1, 1);
+	}
+	AmtPtpContactTrackerUpdate(&tracker, &frame, AMTPTP_DECODER_MAX_CONTACTS);
+	AMTPTP_CHECK_EQ(frame.ContactCount, AMTPTP_DECODER_MAX_CONTACTS);
+	for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+		AMTPTP_CHECK(AmtPtpTestFind(&frame, i) >= 0);
+	}
+
+	// Device id 5 goes, a finger with device id 5 lifted lands elsewhere
+	frame.ContactCount = 0;
+	for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+		AmtPtpTestContact(&frame, (i == 5) ? 0x45 : i, (USHORT) (i * 100), 0, 1, 1);
+	}
+	AmtPtpContactTrackerUpdate(&tracker, &frame, AMTPTP_DECODER_MAX_CONTACTS);
+	AMTPTP_CHECK_EQ(frame.ContactCount, AMTPTP_DECODER_MAX_CONTACTS);
+	AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 5)].TipSwitch, 0);
+	AMTPTP_CHECK_EQ(tracker.Dropped, 1);
+
+	frame.ContactCount = 0;
+	for (i = 0; i < AMTPTP_DECODER_MAX_CONTACTS; i++) {
+		AmtPtpTestContact(&frame, (i == 5) ? 0x45 : i, (USHORT) (i * 100), 0, 1, 1);
+	}
+	AmtPtpContactTrackerUpdate(&tracker, &frame, AMTPTP_DECODER_MAX_CONTACTS);
+	AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 5)].TipSwitch, 1);
+}
+
+//
+// LiftAll lifts every contact hidclass has down, and the next touch starts
+// over from ID 0.
+//
+static VOID
+AmtPtpTestLiftAll(VOID)
+{
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+	UCHAR i;
+
+	AmtPtpTestTracker(&tracker, AmtPtpModelMagicTrackpad2Bluetooth);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpContactTrackerLiftAll(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 0);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 4, 100, 100, 1, 1);
+	AmtPtpTestContact(&frame, 5, 200, 200, 0, 1);
+	AmtPtpTestContact(&frame, 6, 300, 300, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+
+	AmtPtpContactTrackerLiftAll(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 2);
+	for (i = 0; i < frame.ContactCount; i++) {
+		AMTPTP_CHECK_EQ(frame.Contacts[i].TipSwitch, 0);
+	}
+	AMTPTP_CHECK(AmtPtpTestFind(&frame, 0) >= 0);
+	AMTPTP_CHECK(AmtPtpTestFind(&frame, 2) >= 0);
+
+	AmtPtpContactTrackerLiftAll(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 0);
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 6, 300, 300, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].ContactID, 0);
+}
+
+//
+// A resting finger that jitters within half the fuzz stays put. Larger steps
+// move it a quarter, half or all of the way, measured from the position
+// reported last.
+//
+static VOID
+AmtPtpTestDefuzz(VOID)
+{
+	static const struct {
+		SHORT Step;
+		USHORT Expected;	/* from 1000 */
+	} steps[] = {
+		{ 9, 1000 }, { -9, 1000 }, { 10, 1002 }, { 19, 1004 }, { -19, 995 },
+		{ 20, 1010 }, { 39, 1019 }, { -39, 980 }, { 40, 1040 }, { -400, 600 },
+	};
+	AMTPTP_CONTACT_TRACKER tracker;
+	AMTPTP_DECODED_FRAME frame;
+	ULONG i;
+
+	for (i = 0; i <= sizeof(steps) / sizeof(steps[0]); i++) {
+		AmtPtpTestTracker(&tracker, AmtPtpModelMagicTrackpad2Bluetooth);
+		AmtPtpContactTrackerSetFuzz(&tracker, 20, 0);
+		RtlZeroMemory(&frame, sizeof(frame));
+		AmtPtpTestContact(&frame, 1, 1000, 500, 1, 1);
+		AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+		AMTPTP_CHECK_EQ(frame.Contacts[0].X, 1000);
+		if (i == sizeof(steps) / sizeof(steps[0])) {
+			break;
+		}
+
+		RtlZeroMemory(&frame, sizeof(frame));
+		AmtPtpTestContact(&frame, 1, (USHORT) (1000 + steps[i].Step), (USHORT) (500 + steps[i].Step), 1, 1);
+		AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+		AMTPTP_CHECK_EQ(frame.Contacts[0].X, steps[i].Expected);
+
+		// No fuzz on Y, it follows the device
+		AMTPTP_CHECK_EQ(frame.Contacts[0].Y, 500 + steps[i].Step);
+	}
+
+	// The last round left a finger down at 1000. Jitter of +/- 9 around it
+	// never reaches the report.
+	for (i = 0; i < 1000; i++) {
+		RtlZeroMemory(&frame, sizeof(frame));
+		AmtPtpTestContact(&frame, 1, (USHORT) (1000 + (LONG) ((i * 7919) % 19) - 9), 500, 1, 1);
+		AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+		AMTPTP_CHECK_EQ(frame.Contacts[0].X, 1000);
+	}
+
+	// A new contact is reported where it touched down
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpTestContact(&frame, 1, 1000, 500, 1, 1);
+	AmtPtpTestContact(&frame, 2, 1005, 505, 1, 1);
+	AmtPtpContactTrackerUpdate(&tracker, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(frame.Contacts[AmtPtpTestFind(&frame, 1)].X, 1005);
+}
+
+//
+// The corpus captures with the fuzz their drivers use. Every scene holds its
+// fingers still or moves them by much more than the fuzz, with +/- 3 units
+// of jitter a frame on top. A contact held from one frame to the next is
+// compared with the same contact tracked without defuzz: within half the
+// fuzz of its last report it stays put, past twice the fuzz it follows the
+// device exactly, and in total far less jitter reaches the report.
+//
+static VOID
+AmtPtpTestDefuzzCapture(
+	_In_ const char* Path
+)
+{
+	static AMTPTP_CONTACT_TRACKER fuzzed, raw;
+	AMTPTP_CAPTURE capture;
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_DECODED_FRAME frame, rawFrame, last, rawLast;
+	USHORT fuzz[2];
+	ULONG rawJitter = 0, jitter = 0, held = 0, f;
+	UCHAR i, axis;
+	int k;
+
+	if (!AmtPtpCaptureLoad(Path, &capture)) {
+		AmtPtpTestFailures++;
+		return;
+	}
+
+	fuzz[0] = AMTPTP_FUZZ_FROM_SNRATIO(capture.Model->X.Min, capture.Model->X.Max, capture.Model->X.SnRatio);
+	fuzz[1] = AMTPTP_FUZZ_FROM_SNRATIO(capture.Model->Y.Min, capture.Model->Y.Max, capture.Model->Y.SnRatio);
+	if (fuzz[0] == 0 || fuzz[1] == 0) {
+		// No signal-to-noise ratios, as for SPI: positions pass through
+		AmtPtpCaptureFree(&capture);
+		return;
+	}
+
+	AmtPtpCaptureInitDecoderConfig(&capture, &config);
+	AmtPtpContactTrackerInitialize(&fuzzed, &config);
+	AmtPtpContactTrackerSetFuzz(&fuzzed, fuzz[0], fuzz[1]);
+	AmtPtpContactTrackerInitialize(&raw, &config);
+	RtlZeroMemory(&last, sizeof(last));
+	RtlZeroMemory(&rawLast, sizeof(rawLast));
+
+	for (f = 0; f < capture.FrameCount; f++) {
+		if (!capture.Frames[f].HasExpect || capture.Frames[f].ExpectResult != AmtPtpDecodeOk) {
+			continue;
+		}
+
+		frame = capture.Frames[f].Expect;
+		rawFrame = frame;
+		AmtPtpContactTrackerUpdate(&fuzzed, &frame, AMTPTP_DECODER_MAX_CONTACTS);
+		AmtPtpContactTrackerUpdate(&raw, &rawFrame, AMTPTP_DECODER_MAX_CONTACTS);
+		AMTPTP_CHECK_EQ(frame.ContactCount, rawFrame.ContactCount);
+
+		for (i = 0; i < frame.ContactCount; i++) {
+			const AMTPTP_DECODED_CONTACT* c = &frame.Contacts[i];
+			const AMTPTP_DECODED_CONTACT* r = &rawFrame.Contacts[i];
+
+			AMTPTP_CHECK_EQ(c->ContactID, r->ContactID);
+			k = AmtPtpTestFind(&last, c->ContactID);
+			if (!c->TipSwitch || k < 0 || !last.Contacts[k].TipSwitch) {
+				continue;
+			}
+
+			held++;
+			for (axis = 0; axis < 2; axis++) {
+				LONG value = axis ? c->Y : c->X;
+				LONG device = axis ? r->Y : r->X;
+				LONG reported = axis ? last.Contacts[k].Y : last.Contacts[k].X;
+				LONG previous = axis ? rawLast.Contacts[k].Y : rawLast.Contacts[k].X;
+				LONG distance = labs(device - reported);
+
+				if (distance < fuzz[axis] / 2) {
+					AMTPTP_CHECK_EQ(value, reported);
+				} else if (distance >= fuzz[axis] * 2) {
+					AMTPTP_CHECK_EQ(value, device);
+				}
+				if (labs(device - previous) < fuzz[axis]) {
+					rawJitter += labs(device - previous);
+					jitter += labs(value - reported);
+				}
+			}
+		}
+
+		last = frame;
+		rawLast = rawFrame;
+	}
+
+	printf("%s: fuzz %u/%u, %u held contacts, jitter %u units reported of %u\n", Path, fuzz[0], fuzz[1],
+		held, jitter, rawJitter);
+	AMTPTP_CHECK(held > 0);
+	AMTPTP_CHECK(jitter * 4 < rawJitter);
+
+	AmtPtpCaptureFree(&capture);
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	int i;
+
+	AmtPtpTestHeld();
+	AmtPtpTestLiftOff();
+	AmtPtpTestReuse();
+	AmtPtpTestSlots();
+	AmtPtpTestPriority();
+	AmtPtpTestOverCap();
+	AmtPtpTestOutOfIds();
+	AmtPtpTestLiftAll();
+	AmtPtpTestDefuzz();
+
+	AMTPTP_CHECK(argc > 1);
+	for (i = 1; i < argc; i++) {
+		AmtPtpTestDefuzzCapture(argv[i]);
+	}
+	return AmtPtpTestExit("AmtPtpContactTrackerTest");
+}
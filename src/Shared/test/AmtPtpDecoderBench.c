@@ -0,0 +1,83 @@
+// AmtPtpDecoderBench.c: Generic and layout-specialized decoders per trackpad type
+//
+// Each case decodes the same synthetic frames twice: through the decoder
+// AmtPtpDecoderSelect picks, and through the generic one that reads the
+// layout from the config. MT2 fingers are unpacked by the variant the CPU
+// runs in both.
+
+#include <AmtPtpBench.h>
+#include <AmtPtpDecoder.h>
+#include <AmtPtpDeviceRegistry.h>
+
+#define BENCH_FRAMES	16
+
+static VOID
+AmtPtpBenchDecoder(
+	_In_ const char* Name,
+	_In_ AMTPTP_DEVICE_MODEL_ID Model,
+	_In_ ULONG Fingers,
+	_In_ ULONG Iterations
+)
+{
+	static UCHAR frames[BENCH_FRAMES][1024];
+	AMTPTP_DECODER_CONFIG config, generic;
+	AMTPTP_DECODED_FRAME frame;
+	SIZE_T length;
+	ULONGLONG start;
+	char name[64];
+	ULONG i, f;
+
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(Model), 0, &config);
+	generic = config;
+	generic.Decode = (config.Format == AmtPtpFrameFormatMt2) ? AmtPtpDecodeMt2Frame : AmtPtpDecodeWellspringFrame;
+
+	length = config.HeaderSize + Fingers * config.FingerSize;
+	for (f = 0; f < BENCH_FRAMES; f++) {
+		for (i = 0; i < length; i++) {
+			frames[f][i] = (UCHAR) (i * 37 + f * 11);
+		}
+	}
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < Iterations; i++) {
+		AmtPtpDecodeFrame(&generic, frames[i % BENCH_FRAMES], length, &frame);
+		AmtPtpBenchSink += frame.Contacts[0].X;
+	}
+	snprintf(name, sizeof(name), "%s, %u fingers, generic", Name, Fingers);
+	AmtPtpBenchReport(name, AmtPtpBenchNow() - start, Iterations);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < Iterations; i++) {
+		AmtPtpDecodeFrame(&config, frames[i % BENCH_FRAMES], length, &frame);
+		AmtPtpBenchSink += frame.Contacts[0].X;
+	}
+	snprintf(name, sizeof(name), "%s, %u fingers, specialized", Name, Fingers);
+	AmtPtpBenchReport(name, AmtPtpBenchNow() - start, Iterations);
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	static const struct {
+		const char* Name;
+		AMTPTP_DEVICE_MODEL_ID Model;
+	} types[] = {
+		{ "TYPE2", AmtPtpModelWellspring7A },
+		{ "TYPE3", AmtPtpModelWellspring8 },
+		{ "TYPE4", AmtPtpModelWellspring9 },
+		{ "TYPE5 usb", AmtPtpModelMagicTrackpad2Usb },
+		{ "TYPE5 bluetooth", AmtPtpModelMagicTrackpad2Bluetooth },
+	};
+	ULONG iterations = AmtPtpBenchIterations(argc, argv, 10000000);
+	ULONG t;
+
+	for (t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+		AmtPtpBenchDecoder(types[t].Name, types[t].Model, 1, iterations);
+		AmtPtpBenchDecoder(types[t].Name, types[t].Model, 5, iterations);
+		AmtPtpBenchDecoder(types[t].Name, types[t].Model, AMTPTP_DECODER_MAX_CONTACTS, iterations);
+	}
+	return 0;
+}
@@ -0,0 +1,316 @@
+// AmtPtpDecoderTest.c: Decodes the corpus captures and checks every contact
+//
+// Usage: AmtPtpDecoderTest <capture>...
+
+#include <string.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpCapture.h>
+
+static ULONG AmtPtpTestSeed = 1;
+
+static ULONG
+AmtPtpTestRandom(VOID)
+{
+	AmtPtpTestSeed = AmtPtpTestSeed * 1103515245 + 12345;
+	return (AmtPtpTestSeed >> 16) | (AmtPtpTestSeed << 16);
+}
+
+static VOID
+AmtPtpCheckFrame(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_In_ ULONG Index,
+	_In_ AMTPTP_DECODE_RESULT Result,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+)
+{
+	const AMTPTP_CAPTURE_FRAME* expected = &Capture->Frames[Index];
+	UCHAR i;
+
+	if (Result != expected->ExpectResult) {
+		AmtPtpTestFailures++;
+		fprintf(stderr, "%s: frame %u decodes to %d, expected %d\n", Capture->Path, Index, Result,
+			expected->ExpectResult);
+		return;
+	}
+
+	if (Result != AmtPtpDecodeOk) {
+		return;
+	}
+
+	if (Frame->ContactCount != expected->Expect.ContactCount ||
+		Frame->IsButtonClicked != expected->Expect.IsButtonClicked ||
+		Frame->HasDeviceTime != expected->Expect.HasDeviceTime ||
+		Frame->DeviceTime != expected->Expect.DeviceTime) {
+		AmtPtpTestFailures++;
+		fprintf(stderr, "%s: frame %u has %u contacts, button %u, time %u/%u, expected %u, %u, %u/%u\n",
+			Capture->Path, Index, Frame->ContactCount, Frame->IsButtonClicked, Frame->HasDeviceTime,
+			Frame->DeviceTime, expected->Expect.ContactCount, expected->Expect.IsButtonClicked,
+			expected->Expect.HasDeviceTime, expected->Expect.DeviceTime);
+		return;
+	}
+
+	for (i = 0; i < Frame->ContactCount; i++) {
+		const AMTPTP_DECODED_CONTACT* a = &Frame->Contacts[i];
+		const AMTPTP_DECODED_CONTACT* e = &expected->Expect.Contacts[i];
+
+		if (a->ContactID != e->ContactID || a->X != e->X || a->Y != e->Y ||
+			a->TipSwitch != e->TipSwitch || a->Confidence != e->Confidence || a->Finger != e->Finger ||
+			a->TouchMajor != e->TouchMajor || a->TouchMinor != e->TouchMinor || a->Pressure != e->Pressure) {
+			AmtPtpTestFailures++;
+			fprintf(stderr, "%s: frame %u contact %u is %u %u %u %u %u %u %u %u %u, expected %u %u %u %u %u %u %u %u %u\n",
+				Capture->Path, Index, i,
+				a->ContactID, a->X, a->Y, a->TipSwitch, a->Confidence, a->Finger, a->TouchMajor, a->TouchMinor, a->Pressure,
+				e->ContactID, e->X, e->Y, e->TipSwitch, e->Confidence, e->Finger, e->TouchMajor, e->TouchMinor, e->Pressure);
+		}
+	}
+}
+
+static VOID
+AmtPtpTestCapture(
+	_In_ const char* Path
+)
+{
+	AMTPTP_CAPTURE capture;
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_DECODED_FRAME frame;
+	AMTPTP_DECODE_RESULT result;
+	ULONG i, checked = 0;
+
+	if (!AmtPtpCaptureLoad(Path, &capture)) {
+		AmtPtpTestFailures++;
+		return;
+	}
+
+	AmtPtpCaptureInitDecoderConfig(&capture, &config);
+	AMTPTP_CHECK(config.Decode != NULL);
+
+	for (i = 0; i < capture.FrameCount; i++) {
+		if (!capture.Frames[i].HasExpect) {
+			continue;
+		}
+
+		result = AmtPtpDecodeFrame(&config, capture.Frames[i].Data, capture.Frames[i].Length, &frame);
+		AmtPtpCheckFrame(&capture, i, result, &frame);
+		checked++;
+	}
+
+	AMTPTP_CHECK(checked > 0);
+	AmtPtpCaptureFree(&capture);
+}
+
+// Known layouts get their specialized decoder, the rest the generic one
+static VOID
+AmtPtpTestDecoderSelect(VOID)
+{
+	static const struct {
+		AMTPTP_DEVICE_MODEL_ID Model;
+		PFN_AMTPTP_DECODE_FRAME Generic;
+		BOOLEAN Specialized;
+	} cases[] = {
+		{ AmtPtpModelWellspring, AmtPtpDecodeWellspringFrame, FALSE },	/* TYPE1 */
+		{ AmtPtpModelWellspring3, NULL, TRUE },							/* TYPE2 */
+		{ AmtPtpModelWellspring8, NULL, TRUE },							/* TYPE3 */
+		{ AmtPtpModelWellspring9, NULL, TRUE },							/* TYPE4 */
+		{ AmtPtpModelMagicTrackpad2Usb, NULL, TRUE },
+		{ AmtPtpModelMagicTrackpad2Bluetooth, NULL, TRUE },
+		{ AmtPtpModelSpiFamily1, AmtPtpDecodeSpiFrame, FALSE },
+	};
+	AMTPTP_DECODER_CONFIG config;
+	SIZE_T i;
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(cases[i].Model), 0, &config);
+		AMTPTP_CHECK(config.Decode != NULL);
+		if (cases[i].Specialized) {
+			AMTPTP_CHECK(config.Decode != AmtPtpDecodeWellspringFrame && config.Decode != AmtPtpDecodeMt2Frame);
+		} else {
+			AMTPTP_CHECK(config.Decode == cases[i].Generic);
+		}
+	}
+
+	// An MT2 layout with an odd header goes to the generic decoder
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Bluetooth), 0, &config);
+	config.HeaderSize = 6;
+	AmtPtpDecoderSelect(&config);
+	AMTPTP_CHECK(config.Decode == AmtPtpDecodeMt2Frame);
+
+	config.Format = AmtPtpFrameFormatMax;
+	AmtPtpDecoderSelect(&config);
+	AMTPTP_CHECK(config.Decode == NULL);
+}
+
+//
+// The specialized decoders against the generic ones they were stamped from,
+// on random frames of every length up to a finger past the longest transfer,
+// under every flag combination. The generic side also unpacks MT2 fingers
+// with the scalar code.
+//
+static VOID
+AmtPtpTestSpecialized(VOID)
+{
+	static const AMTPTP_DEVICE_MODEL_ID models[] = {
+		AmtPtpModelWellspring3, AmtPtpModelWellspring8, AmtPtpModelWellspring9,
+		AmtPtpModelMagicTrackpad2Usb, AmtPtpModelMagicTrackpad2Bluetooth,
+	};
+	static UCHAR buffer[AMTPTP_CAPTURE_MAX_FRAME];
+	AMTPTP_DECODER_CONFIG config, generic;
+	AMTPTP_DECODED_FRAME frame, expected;
+	AMTPTP_DECODE_RESULT result;
+	ULONG flags, n, mismatches = 0, decoded = 0;
+	SIZE_T m, length, i;
+
+	for (m = 0; m < sizeof(models) / sizeof(models[0]); m++) {
+		for (flags = 0; flags < 8; flags++) {
+			AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(models[m]), flags, &config);
+			generic = config;
+			generic.Decode = NULL;
+			generic.UnpackMt2Fingers = NULL;
+
+			for (n = 0; n < 2000; n++) {
+				// Mostly whole fingers, some lengths that are not
+				if (n % 4 == 0) {
+					length = AmtPtpTestRandom() % (config.HeaderSize + (AMTPTP_DECODER_MAX_CONTACTS + 1) * config.FingerSize + 1);
+				} else {
+					length = config.HeaderSize + (AmtPtpTestRandom() % (AMTPTP_DECODER_MAX_CONTACTS + 2)) *
+						config.FingerSize;
+				}
+				for (i = 0; i < length; i++) {
+					buffer[i] = (UCHAR) AmtPtpTestRandom();
+				}
+				if (length > 2 && n % 2 == 0) {
+					buffer[2] = (UCHAR) config.HeaderSize;
+				}
+
+				memset(&frame, 0xA5, sizeof(frame));
+				memset(&expected, 0x5A, sizeof(expected));
+				result = AmtPtpDecodeFrame(&config, buffer, length, &frame);
+				if (result != AmtPtpDecodeFrame(&generic, buffer, length, &expected) ||
+					memcmp(&frame, &expected, sizeof(frame)) != 0) {
+					mismatches++;
+				}
+				decoded += (result == AmtPtpDecodeOk);
+			}
+		}
+	}
+
+	AMTPTP_CHECK_EQ(mismatches, 0);
+	AMTPTP_CHECK(decoded > 0);
+}
+
+// Lengths that do not fit the layout, and unknown formats
+static VOID
+AmtPtpTestMalformed(VOID)
+{
+	static const AMTPTP_DEVICE_MODEL_ID models[] = {
+		AmtPtpModelWellspring3, AmtPtpModelWellspring8, AmtPtpModelWellspring9,
+		AmtPtpModelMagicTrackpad2Usb, AmtPtpModelMagicTrackpad2Bluetooth, AmtPtpModelSpiFamily2
+	};
+	UCHAR buffer[AMTPTP_CAPTURE_MAX_FRAME];
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_DECODED_FRAME frame;
+	SIZE_T i;
+
+	RtlZeroMemory(buffer, sizeof(buffer));
+
+	for (i = 0; i < sizeof(models) / sizeof(models[0]); i++) {
+		AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(models[i]), 0, &config);
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, 0, &frame), AmtPtpDecodeMalformed);
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, config.HeaderSize - 1, &frame), AmtPtpDecodeMalformed);
+		AMTPTP_CHECK_EQ(frame.ContactCount, 0);
+
+		// A bare header is a frame without contacts
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, config.HeaderSize, &frame), AmtPtpDecodeOk);
+		AMTPTP_CHECK_EQ(frame.ContactCount, 0);
+	}
+
+	config.Format = AmtPtpFrameFormatMax;
+	config.Decode = NULL;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, 64, &frame), AmtPtpDecodeUnsupported);
+}
+
+// A finger offset reported past the frame must not make the decoder read past it
+static VOID
+AmtPtpTestFingerOffsetInFrame(VOID)
+{
+	UCHAR buffer[AMTPTP_WELLSPRING_TYPE2_HEADER_SIZE + 2 * AMTPTP_WELLSPRING_TYPE2_FINGER_SIZE];
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_DECODED_FRAME frame;
+
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(AmtPtpModelWellspring7A),
+		AMTPTP_DECODER_FLAG_FINGER_OFFSET_IN_FRAME, &config);
+	RtlZeroMemory(buffer, sizeof(buffer));
+
+	buffer[2] = AMTPTP_WELLSPRING_TYPE2_HEADER_SIZE;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, sizeof(buffer), &frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 2);
+
+	buffer[2] = AMTPTP_WELLSPRING_TYPE2_HEADER_SIZE + AMTPTP_WELLSPRING_TYPE2_FINGER_SIZE;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, sizeof(buffer), &frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 1);
+
+	buffer[2] = 0xFF;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, sizeof(buffer), &frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 0);
+}
+
+//
+// Over USB the button is byte 1 of the mouse report, as in the TYPE5 code
+// before the shared decoder. The clicks bit of report 0x31 only counts over
+// Bluetooth.
+//
+static VOID
+AmtPtpTestMt2Button(VOID)
+{
+	UCHAR buffer[AMTPTP_MT2_USB_HEADER_SIZE + AMTPTP_MT2_FINGER_SIZE];
+	AMTPTP_DECODER_CONFIG config, generic;
+	AMTPTP_DECODED_FRAME frame;
+	UCHAR* header = buffer + AMTPTP_MT2_USB_HEADER_SIZE - AMTPTP_MT2_HEADER_SIZE;
+
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Usb), 0, &config);
+	generic = config;
+	generic.Decode = NULL;
+	RtlZeroMemory(buffer, sizeof(buffer));
+	buffer[0] = 0x02;
+	header[0] = 0x31;
+
+	buffer[AMTPTP_MT2_USB_BUTTON] = 1;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, sizeof(buffer), &frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(frame.IsButtonClicked, TRUE);
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&generic, buffer, sizeof(buffer), &frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(frame.IsButtonClicked, TRUE);
+
+	buffer[AMTPTP_MT2_USB_BUTTON] = 0;
+	header[1] = 0x1;
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, buffer, sizeof(buffer), &frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(frame.IsButtonClicked, FALSE);
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&generic, buffer, sizeof(buffer), &frame), AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(frame.IsButtonClicked, FALSE);
+
+	// Bluetooth gets report 0x31 alone
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Bluetooth), 0, &config);
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, header, AMTPTP_MT2_HEADER_SIZE + AMTPTP_MT2_FINGER_SIZE, &frame),
+		AmtPtpDecodeOk);
+	AMTPTP_CHECK_EQ(frame.IsButtonClicked, TRUE);
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	int i;
+
+	AmtPtpTestDecoderSelect();
+	AmtPtpTestSpecialized();
+	AmtPtpTestMalformed();
+	AmtPtpTestFingerOffsetInFrame();
+	AmtPtpTestMt2Button();
+
+	AMTPTP_CHECK(argc > 1);
+	for (i = 1; i < argc; i++) {
+		AmtPtpTestCapture(argv[i]);
+	}
+
+	return AmtPtpTestExit("AmtPtpDecoderTest");
+}
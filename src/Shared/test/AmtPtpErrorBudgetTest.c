@@ -0,0 +1,350 @@
+// AmtPtpErrorBudgetTest.c: Salvage, the sliding error budget and input lost to corruption
+//
+// The unit cases drive the budget with hand-picked times. The capture cases
+// cut and garble the corpus frames: a frame missing part of its last finger
+// must salvage to the fingers in front of it, and a frame too short for its
+// header must not. The policy case replays each capture for a minute at
+// 125 Hz under four corruption patterns, once with the old reset on every
+// bad frame and once with the budget, and prints the input time each loses.
+
+#include <stdlib.h>
+#include <string.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpCapture.h>
+#include <AmtPtpErrorBudget.h>
+
+#define MS						10000ull		/* 100ns units */
+#define WINDOW					AMTPTP_ERROR_BUDGET_DEFAULT_WINDOW
+#define LIMIT					AMTPTP_ERROR_BUDGET_DEFAULT_LIMIT
+
+#define POLICY_INTERVAL			(8 * MS)		/* 125 Hz */
+#define POLICY_FRAMES			7500			/* 60 s */
+#define POLICY_RESET_FRAMES		5				/* a reset costs 40 ms of frames */
+
+static ULONG AmtPtpTestSeed = 1;
+
+static ULONG
+AmtPtpTestRandom(VOID)
+{
+	AmtPtpTestSeed = AmtPtpTestSeed * 1103515245 + 12345;
+	return (AmtPtpTestSeed >> 16) | (AmtPtpTestSeed << 16);
+}
+
+//
+// Limit bad frames within the window reset the device, and the reset starts
+// a fresh budget. The window slides: the oldest of the last Limit counts.
+//
+static VOID
+AmtPtpTestBudget(VOID)
+{
+	AMTPTP_ERROR_BUDGET budget;
+	ULONG i;
+
+	AmtPtpErrorBudgetInitialize(&budget, WINDOW, 0);
+	AMTPTP_CHECK_EQ(budget.Limit, 1);
+	AmtPtpErrorBudgetInitialize(&budget, WINDOW, 100);
+	AMTPTP_CHECK_EQ(budget.Limit, AMTPTP_ERROR_BUDGET_MAX_LIMIT);
+
+	// A limit of 1 resets on every bad frame
+	AmtPtpErrorBudgetInitialize(&budget, WINDOW, 1);
+	AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 0), AmtPtpFrameReset);
+	AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 10 * WINDOW), AmtPtpFrameReset);
+
+	AmtPtpErrorBudgetInitialize(&budget, WINDOW, LIMIT);
+	for (i = 0; i < LIMIT - 1; i++) {
+		AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, i * 300 * MS), AmtPtpFrameDrop);
+	}
+
+	// 1.2 s from the first, dropped; 1.0 s from the second, within the window
+	AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 1200 * MS), AmtPtpFrameDrop);
+	AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 1300 * MS), AmtPtpFrameReset);
+	AMTPTP_CHECK_EQ(budget.Dropped, LIMIT);
+	AMTPTP_CHECK_EQ(budget.Resets, 1);
+
+	// Good frames in between do not refill the budget, the reset does
+	for (i = 0; i < LIMIT - 1; i++) {
+		AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameIntact, 1301 * MS + i), AmtPtpFrameDeliver);
+		AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 1302 * MS + i), AmtPtpFrameDrop);
+	}
+	AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 1400 * MS), AmtPtpFrameReset);
+
+	// Leaving D0 forgets the bad frames, not the statistics
+	for (i = 0; i < LIMIT - 1; i++) {
+		AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 1500 * MS + i);
+	}
+	AmtPtpErrorBudgetReset(&budget);
+	for (i = 0; i < LIMIT - 1; i++) {
+		AMTPTP_CHECK_EQ(AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 1600 * MS + i), AmtPtpFrameDrop);
+	}
+	AMTPTP_CHECK_EQ(budget.Resets, 2);
+	AMTPTP_CHECK_EQ(budget.Dropped, LIMIT + 3 * (LIMIT - 1));
+}
+
+//
+// Lost time runs from the last frame delivered to the next one; before any
+// frame was delivered, from the first bad one
+//
+static VOID
+AmtPtpTestLostTime(VOID)
+{
+	AMTPTP_ERROR_BUDGET budget;
+
+	AmtPtpErrorBudgetInitialize(&budget, WINDOW, LIMIT);
+	AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 100 * MS);
+	AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 108 * MS);
+	AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameIntact, 116 * MS);
+	AMTPTP_CHECK_EQ(budget.LostTime, 16 * MS);
+
+	AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameIntact, 124 * MS);
+	AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameCorrupt, 132 * MS);
+	AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameSalvaged, 140 * MS);
+	AMTPTP_CHECK_EQ(budget.LostTime, 32 * MS);
+	AMTPTP_CHECK_EQ(budget.Salvaged, 1);
+
+	// Salvaged frames count as delivered, not as lost
+	AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameSalvaged, 148 * MS);
+	AmtPtpErrorBudgetRecord(&budget, AmtPtpFrameIntact, 156 * MS);
+	AMTPTP_CHECK_EQ(budget.LostTime, 32 * MS);
+	AMTPTP_CHECK_EQ(budget.Dropped, 3);
+}
+
+//
+// Every frame of a capture with part of its last finger cut off, and with
+// a partial finger of trailing bytes, decodes to the complete fingers
+//
+static VOID
+AmtPtpTestSalvage(
+	_In_ const char* Path
+)
+{
+	AMTPTP_CAPTURE capture;
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_DECODED_FRAME intact, frame;
+	UCHAR buffer[AMTPTP_CAPTURE_MAX_FRAME + 32];
+	ULONG i, cut, salvaged = 0;
+
+	if (!AmtPtpCaptureLoad(Path, &capture)) {
+		AmtPtpTestFailures++;
+		return;
+	}
+	AmtPtpCaptureInitDecoderConfig(&capture, &config);
+
+	for (i = 0; i < capture.FrameCount; i++) {
+		const AMTPTP_CAPTURE_FRAME* source = &capture.Frames[i];
+
+		if (AmtPtpDecodeFrame(&config, source->Data, source->Length, &intact) != AmtPtpDecodeOk) {
+			continue;
+		}
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrameSalvage(&config, source->Data, source->Length, &frame), AmtPtpFrameIntact);
+
+		// Too short for the header, nothing to salvage
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrameSalvage(&config, source->Data, config.HeaderSize / 2, &frame),
+			AmtPtpFrameCorrupt);
+
+		// SPI frames carry their own length and decode with trailing data
+		if (config.Format == AmtPtpFrameFormatSpi) {
+			continue;
+		}
+
+		cut = 1 + AmtPtpTestRandom() % (config.FingerSize - 1);
+		memcpy(buffer, source->Data, source->Length);
+		memset(buffer + source->Length, 0x5a, cut);
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrameSalvage(&config, buffer, source->Length + cut, &frame), AmtPtpFrameSalvaged);
+		AMTPTP_CHECK_EQ(frame.ContactCount, intact.ContactCount);
+		AMTPTP_CHECK(memcmp(frame.Contacts, intact.Contacts, intact.ContactCount * sizeof(intact.Contacts[0])) == 0);
+
+		if (intact.ContactCount > 0 && source->Length >= config.HeaderSize + config.FingerSize) {
+			AMTPTP_CHECK_EQ(AmtPtpDecodeFrameSalvage(&config, source->Data, source->Length - cut, &frame),
+				AmtPtpFrameSalvaged);
+			AMTPTP_CHECK(frame.ContactCount < intact.ContactCount);
+			salvaged++;
+		}
+	}
+
+	AMTPTP_CHECK(config.Format == AmtPtpFrameFormatSpi || salvaged > 0);
+	AmtPtpCaptureFree(&capture);
+}
+
+typedef enum _AMTPTP_TEST_PATTERN {
+	AmtPtpPatternTailCut,		/* 2% of frames lose part of their last finger */
+	AmtPtpPatternGarbage,		/* 2% of frames too short for a header */
+	AmtPtpPatternBursts,		/* 3 runs of 10 garbage frames */
+	AmtPtpPatternModeLoss,		/* the device falls out of its mode until reset */
+	AmtPtpPatternMax
+} AMTPTP_TEST_PATTERN;
+
+static const char* AmtPtpTestPatternNames[AmtPtpPatternMax] = {
+	"tail cut 2%", "garbage 2%", "bursts 3x10", "mode loss"
+};
+
+//
+// Input time lost over POLICY_FRAMES frames: the frames not delivered, bad or
+// missed during a reset. With Budget NULL every bad frame resets the device.
+//
+static ULONGLONG
+AmtPtpTestPolicy(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_reads_(FrameCount) const ULONG* Frames,
+	_In_ ULONG FrameCount,
+	_In_ AMTPTP_TEST_PATTERN Pattern,
+	_Inout_opt_ PAMTPTP_ERROR_BUDGET Budget
+)
+{
+	AMTPTP_DECODED_FRAME frame;
+	AMTPTP_FRAME_CHECK check;
+	ULONGLONG time, lost = 0;
+	ULONG i, resetting = 0, lostRuns = 0;
+	BOOLEAN modeLost = FALSE, losing = FALSE;
+
+	AmtPtpTestSeed = 1;
+	for (i = 0; i < POLICY_FRAMES; i++) {
+		const AMTPTP_CAPTURE_FRAME* source = &Capture->Frames[Frames[i % FrameCount]];
+		SIZE_T length = source->Length;
+		BOOLEAN bad = FALSE;
+
+		time = (i + 1) * POLICY_INTERVAL;
+
+		// The device is switching back, nothing arrives
+		if (resetting > 0) {
+			resetting--;
+			modeLost = FALSE;
+			lost += POLICY_INTERVAL;
+			losing = TRUE;
+			continue;
+		}
+
+		switch (Pattern) {
+		case AmtPtpPatternTailCut:
+			if (AmtPtpTestRandom() % 50 == 0 && length >= Config->HeaderSize + Config->FingerSize) {
+				length -= 1 + AmtPtpTestRandom() % (Config->FingerSize - 1);
+			}
+			break;
+		case AmtPtpPatternGarbage:
+			bad = (AmtPtpTestRandom() % 50 == 0);
+			break;
+		case AmtPtpPatternBursts:
+			bad = (i % 2500 >= 1000 && i % 2500 < 1010);
+			break;
+		default:
+			modeLost |= (i == 1000);
+			bad = modeLost;
+			break;
+		}
+		if (bad) {
+			length = Config->HeaderSize / 2;
+		}
+
+		if (Budget != NULL) {
+			check = AmtPtpDecodeFrameSalvage(Config, source->Data, length, &frame);
+			switch (AmtPtpErrorBudgetRecord(Budget, check, time)) {
+			case AmtPtpFrameDeliver:
+				lostRuns += losing;
+				losing = FALSE;
+				continue;
+			case AmtPtpFrameReset:
+				resetting = POLICY_RESET_FRAMES;
+				break;
+			default:
+				break;
+			}
+		}
+		else if (AmtPtpDecodeFrame(Config, source->Data, length, &frame) == AmtPtpDecodeOk) {
+			lostRuns += losing;
+			losing = FALSE;
+			continue;
+		}
+		else {
+			resetting = POLICY_RESET_FRAMES;
+		}
+
+		lost += POLICY_INTERVAL;
+		losing = TRUE;
+	}
+
+	// The budget counts each run up to the frame that ends it
+	if (Budget != NULL && !losing) {
+		AMTPTP_CHECK_EQ(Budget->LostTime, lost + lostRuns * POLICY_INTERVAL);
+	}
+	return lost;
+}
+
+static VOID
+AmtPtpTestPolicies(
+	_In_ const char* Path
+)
+{
+	AMTPTP_CAPTURE capture;
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_DECODED_FRAME frame;
+	AMTPTP_ERROR_BUDGET budget;
+	ULONGLONG resetLost, budgetLost;
+	ULONG* frames;
+	ULONG i, frameCount = 0;
+	int pattern;
+
+	if (!AmtPtpCaptureLoad(Path, &capture)) {
+		AmtPtpTestFailures++;
+		return;
+	}
+	AmtPtpCaptureInitDecoderConfig(&capture, &config);
+
+	frames = malloc(capture.FrameCount * sizeof(ULONG));
+	for (i = 0; i < capture.FrameCount; i++) {
+		if (AmtPtpDecodeFrame(&config, capture.Frames[i].Data, capture.Frames[i].Length, &frame) == AmtPtpDecodeOk) {
+			frames[frameCount++] = i;
+		}
+	}
+	AMTPTP_CHECK(frameCount > 0);
+
+	for (pattern = 0; pattern < AmtPtpPatternMax && frameCount > 0; pattern++) {
+		resetLost = AmtPtpTestPolicy(&capture, &config, frames, frameCount, pattern, NULL);
+		AmtPtpErrorBudgetInitialize(&budget, WINDOW, LIMIT);
+		budgetLost = AmtPtpTestPolicy(&capture, &config, frames, frameCount, pattern, &budget);
+
+		printf("%-40s %-12s reset on error %6llu ms, budget %6llu ms (%u salvaged, %u resets)\n",
+			strrchr(Path, '/') != NULL ? strrchr(Path, '/') + 1 : Path, AmtPtpTestPatternNames[pattern],
+			resetLost / MS, budgetLost / MS, budget.Salvaged, budget.Resets);
+
+		switch (pattern) {
+		case AmtPtpPatternTailCut:
+			// Complete fingers survive; SPI frames carry their own length and still decode
+			if (config.Format != AmtPtpFrameFormatSpi) {
+				AMTPTP_CHECK_EQ(budgetLost, 0);
+				AMTPTP_CHECK(budget.Salvaged > 0);
+			}
+			AMTPTP_CHECK(budgetLost <= resetLost);
+			break;
+		case AmtPtpPatternModeLoss:
+			// The budget waits for Limit bad frames before the same reset
+			AMTPTP_CHECK_EQ(budget.Resets, 1);
+			AMTPTP_CHECK_EQ(budgetLost, resetLost + (LIMIT - 1) * POLICY_INTERVAL);
+			break;
+		default:
+			AMTPTP_CHECK(budgetLost <= resetLost);
+			break;
+		}
+	}
+
+	free(frames);
+	AmtPtpCaptureFree(&capture);
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	int i;
+
+	AmtPtpTestBudget();
+	AmtPtpTestLostTime();
+
+	AMTPTP_CHECK(argc > 1);
+	for (i = 1; i < argc; i++) {
+		AmtPtpTestSalvage(argv[i]);
+		AmtPtpTestPolicies(argv[i]);
+	}
+	return AmtPtpTestExit("AmtPtpErrorBudgetTest");
+}
@@ -0,0 +1,198 @@
+// AmtPtpHidFields.c: The fields of one report, as hidclass lays them out
+
+#include <AmtPtpHidFields.h>
+
+/* item prefix fields, HID 1.11 section 6.2.2.2 */
+#define HID_ITEM_LONG			0xfe
+#define HID_ITEM_SIZE(b)		((b) & 0x03)
+#define HID_ITEM_TYPE(b)		(((b) >> 2) & 0x03)
+#define HID_ITEM_TAG(b)			((b) >> 4)
+
+#define HID_TYPE_MAIN			0
+#define HID_TYPE_GLOBAL			1
+#define HID_TYPE_LOCAL			2
+
+#define HID_MAIN_INPUT			0x8
+#define HID_MAIN_OUTPUT			0x9
+#define HID_MAIN_FEATURE		0xb
+
+#define HID_GLOBAL_USAGE_PAGE	0x0
+#define HID_GLOBAL_LOGICAL_MAX	0x2
+#define HID_GLOBAL_REPORT_SIZE	0x7
+#define HID_GLOBAL_REPORT_ID	0x8
+#define HID_GLOBAL_REPORT_COUNT	0x9
+#define HID_GLOBAL_PUSH			0xa
+#define HID_GLOBAL_POP			0xb
+
+#define HID_LOCAL_USAGE			0x0
+
+/* Data bit of a main item: Constant */
+#define HID_MAIN_CONSTANT		0x01
+
+#define HID_MAX_USAGES			16
+
+typedef struct _HID_FIELDS_GLOBAL {
+	ULONG	UsagePage;
+	ULONG	LogicalMaximum;
+	ULONG	ReportSize;
+	ULONG	ReportCount;
+	ULONG	ReportId;
+} HID_FIELDS_GLOBAL;
+
+static const UCHAR AmtPtpHidFieldsMainTag[] = {
+	HID_MAIN_INPUT,		/* AmtPtpHidReportInput */
+	HID_MAIN_OUTPUT,	/* AmtPtpHidReportOutput */
+	HID_MAIN_FEATURE	/* AmtPtpHidReportFeature */
+};
+
+BOOLEAN
+AmtPtpHidGetFields(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_ AMTPTP_HID_REPORT_TYPE Type,
+	_In_ UCHAR ReportId,
+	_Out_writes_(MaxFields) AMTPTP_HID_FIELD* Fields,
+	_In_ ULONG MaxFields,
+	_Out_ PULONG Count
+)
+{
+	HID_FIELDS_GLOBAL global = { 0 };
+	HID_FIELDS_GLOBAL stack[AMTPTP_HID_GLOBAL_STACK_DEPTH];
+	ULONG usages[HID_MAX_USAGES];
+	ULONG stackDepth = 0, usageCount = 0;
+	ULONG offset = 0, bits = 0, count = 0;
+	BOOLEAN usesReportIds = FALSE;
+	ULONG i;
+
+	*Count = 0;
+
+	while (offset < Length) {
+		UCHAR prefix = Descriptor[offset];
+		ULONG dataSize = HID_ITEM_SIZE(prefix) == 3 ? 4 : HID_ITEM_SIZE(prefix);
+		ULONG data = 0;
+
+		if (prefix == HID_ITEM_LONG) {
+			if (Length - offset < 3 || Length - offset - 3 < Descriptor[offset + 1]) {
+				return FALSE;
+			}
+			offset += 3 + Descriptor[offset + 1];
+			continue;
+		}
+		if (Length - offset - 1 < dataSize) {
+			return FALSE;
+		}
+		for (i = 0; i < dataSize; i++) {
+			data |= (ULONG) Descriptor[offset + 1 + i] << (i * 8);
+		}
+		offset += 1 + dataSize;
+
+		switch (HID_ITEM_TYPE(prefix)) {
+		case HID_TYPE_MAIN:
+			if (HID_ITEM_TAG(prefix) == AmtPtpHidFieldsMainTag[Type] && global.ReportId == ReportId) {
+				ULONG constantBits = global.ReportSize * global.ReportCount;
+
+				// Padding declared in pieces comes out as one field
+				if ((data & HID_MAIN_CONSTANT) != 0) {
+					if (constantBits != 0 && count > 0 && Fields[count - 1].Constant &&
+						Fields[count - 1].BitOffset + Fields[count - 1].BitSize == bits) {
+						Fields[count - 1].BitSize += constantBits;
+					}
+					else if (constantBits != 0) {
+						if (count == MaxFields) {
+							return FALSE;
+						}
+						RtlZeroMemory(&Fields[count], sizeof(AMTPTP_HID_FIELD));
+						Fields[count].Constant = TRUE;
+						Fields[count].BitOffset = bits;
+						Fields[count].BitSize = constantBits;
+						Fields[count].UsagePage = (USHORT) global.UsagePage;
+						count++;
+					}
+					bits += constantBits;
+					usageCount = 0;
+					break;
+				}
+
+				for (i = 0; i < global.ReportCount; i++) {
+					AMTPTP_HID_FIELD* field;
+
+					if (count == MaxFields) {
+						return FALSE;
+					}
+					field = &Fields[count++];
+					RtlZeroMemory(field, sizeof(AMTPTP_HID_FIELD));
+					field->BitOffset = bits;
+					field->BitSize = global.ReportSize;
+					field->LogicalMaximum = global.LogicalMaximum;
+					field->UsagePage = (USHORT) global.UsagePage;
+
+					// Each field takes the next usage, the last one repeats
+					if (usageCount > 0) {
+						ULONG usage = usages[i < usageCount ? i : usageCount - 1];
+
+						field->Usage = (USHORT) usage;
+						if (usage > 0xffff) {
+							field->UsagePage = (USHORT) (usage >> 16);
+						}
+					}
+					bits += global.ReportSize;
+				}
+			}
+			usageCount = 0;
+			break;
+		case HID_TYPE_GLOBAL:
+			switch (HID_ITEM_TAG(prefix)) {
+			case HID_GLOBAL_USAGE_PAGE:
+				global.UsagePage = data;
+				break;
+			case HID_GLOBAL_LOGICAL_MAX:
+				global.LogicalMaximum = data;
+				break;
+			case HID_GLOBAL_REPORT_SIZE:
+				global.ReportSize = data;
+				break;
+			case HID_GLOBAL_REPORT_COUNT:
+				global.ReportCount = data;
+				break;
+			case HID_GLOBAL_REPORT_ID:
+				global.ReportId = data;
+				usesReportIds = TRUE;
+				break;
+			case HID_GLOBAL_PUSH:
+				if (stackDepth == AMTPTP_HID_GLOBAL_STACK_DEPTH) {
+					return FALSE;
+				}
+				stack[stackDepth++] = global;
+				break;
+			case HID_GLOBAL_POP:
+				if (stackDepth == 0) {
+					return FALSE;
+				}
+				global = stack[--stackDepth];
+				break;
+			default:
+				break;
+			}
+			break;
+		case HID_TYPE_LOCAL:
+			if (HID_ITEM_TAG(prefix) == HID_LOCAL_USAGE) {
+				if (usageCount == HID_MAX_USAGES) {
+					return FALSE;
+				}
+				usages[usageCount++] = data;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (usesReportIds) {
+		for (i = 0; i < count; i++) {
+			Fields[i].BitOffset += 8;
+		}
+	}
+
+	*Count = count;
+	return TRUE;
+}
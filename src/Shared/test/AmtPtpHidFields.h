@@ -0,0 +1,37 @@
+// AmtPtpHidFields.h: The fields of one report, as hidclass lays them out
+//
+// AmtPtpHidReportLayout.h only adds up report sizes. The tests also need to
+// know where each field lands and what it stands for, to hold a descriptor
+// against the structure a driver fills: this walks the same short items and
+// lists the fields of one report in order, with their usage, bit offset and
+// size. Usage ranges and long items are not used by any of the descriptors
+// and are skipped.
+#pragma once
+
+#include <AmtPtpHidReportLayout.h>
+
+typedef struct _AMTPTP_HID_FIELD {
+	USHORT		UsagePage;
+	USHORT		Usage;				/* 0 for constant fields */
+	ULONG		BitOffset;			/* from the start of the report, report id included */
+	ULONG		BitSize;
+	ULONG		LogicalMaximum;		/* raw item data */
+	BOOLEAN		Constant;
+} AMTPTP_HID_FIELD;
+
+//
+// Fills Fields with the fields of the Type report with ReportId, one per
+// Report Count, and returns how many there are in Count. Adjacent constant
+// fields are merged into one, as padding is usually declared bit by bit.
+// Returns FALSE if the descriptor does not parse or has more than MaxFields.
+//
+BOOLEAN
+AmtPtpHidGetFields(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_ AMTPTP_HID_REPORT_TYPE Type,
+	_In_ UCHAR ReportId,
+	_Out_writes_(MaxFields) AMTPTP_HID_FIELD* Fields,
+	_In_ ULONG MaxFields,
+	_Out_ PULONG Count
+);
@@ -0,0 +1,425 @@
+// AmtPtpHidReportLayoutTest.c: Report sizes from hand-made and malformed descriptors
+//
+// The drivers run the walker on their own descriptors only, but it must hold
+// up on anything: a descriptor that does not parse is reported as such, never
+// read past its end or sized from half an item. The fuzz case mutates a
+// valid descriptor and holds every size the walker returns against the
+// fields AmtPtpHidGetFields lists for the same report.
+
+#include <stdlib.h>
+#include <string.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpHidReportLayout.h>
+#include <AmtPtpHidFields.h>
+
+/* short items, HID 1.11 section 6.2.2 */
+#define ITEM_USAGE_PAGE			0x05
+#define ITEM_USAGE				0x09
+#define ITEM_COLLECTION			0xa1
+#define ITEM_END_COLLECTION		0xc0
+#define ITEM_REPORT_ID			0x85
+#define ITEM_REPORT_ID_2		0x86
+#define ITEM_REPORT_SIZE		0x75
+#define ITEM_REPORT_SIZE_4		0x77
+#define ITEM_REPORT_COUNT		0x95
+#define ITEM_REPORT_COUNT_2		0x96
+#define ITEM_INPUT				0x81
+#define ITEM_OUTPUT				0x91
+#define ITEM_FEATURE			0xb1
+#define ITEM_PUSH				0xa4
+#define ITEM_POP				0xb4
+#define ITEM_LONG				0xfe
+
+#define TEST_FUZZ_ROUNDS		200000
+#define TEST_MAX_FIELDS			1024
+#define TEST_MAX_DESCRIPTOR		256
+
+static ULONG AmtPtpTestSeed = 1;
+
+static ULONG
+AmtPtpTestRandom(VOID)
+{
+	AmtPtpTestSeed = AmtPtpTestSeed * 1103515245 + 12345;
+	return (AmtPtpTestSeed >> 16) | (AmtPtpTestSeed << 16);
+}
+
+//
+// Three reports with ids, one of them in a Push/Pop pair:
+//   input 1: 3 bytes, 4 bits and 4 bits of padding, 5 bytes with the id
+//   output 1: 4 bits from the globals restored by Pop, 2 bytes
+//   feature 2: 256 16-bit values, 513 bytes
+//   feature 3: 2 bytes, 3 bytes
+//
+static const UCHAR AmtPtpTestDescriptor[] = {
+	ITEM_USAGE_PAGE, 0x0d,
+	ITEM_USAGE, 0x05,
+	ITEM_COLLECTION, 0x01,
+		ITEM_REPORT_ID, 0x01,
+		ITEM_REPORT_SIZE, 0x08,
+		ITEM_REPORT_COUNT, 0x03,
+		ITEM_INPUT, 0x02,
+		ITEM_REPORT_SIZE, 0x01,
+		ITEM_REPORT_COUNT, 0x04,
+		ITEM_INPUT, 0x02,
+		ITEM_INPUT, 0x03,
+		ITEM_PUSH,
+			ITEM_REPORT_ID, 0x02,
+			ITEM_REPORT_SIZE, 0x10,
+			ITEM_REPORT_COUNT_2, 0x00, 0x01,
+			ITEM_FEATURE, 0x02,
+		ITEM_POP,
+		ITEM_OUTPUT, 0x02,
+		ITEM_REPORT_ID, 0x03,
+		ITEM_REPORT_SIZE, 0x08,
+		ITEM_REPORT_COUNT, 0x02,
+		ITEM_FEATURE, 0x02,
+	ITEM_END_COLLECTION
+};
+
+/* offset of the first byte after Begin Collection */
+#define TEST_COLLECTION_END		6
+
+static const AMTPTP_HID_REPORT_SIZE AmtPtpTestSizes[] = {
+	{ AmtPtpHidReportInput,		0x01,	5 },
+	{ AmtPtpHidReportOutput,	0x01,	2 },
+	{ AmtPtpHidReportFeature,	0x02,	513 },
+	{ AmtPtpHidReportFeature,	0x03,	3 },
+};
+
+#define TEST_SIZES				(sizeof(AmtPtpTestSizes) / sizeof(AmtPtpTestSizes[0]))
+
+static AMTPTP_HID_LAYOUT_RESULT
+AmtPtpTestSize(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_ AMTPTP_HID_REPORT_TYPE Type,
+	_In_ UCHAR ReportId,
+	_In_ ULONG Expected
+)
+{
+	AMTPTP_HID_LAYOUT_RESULT result;
+	ULONG size = 0xdeadbeef;
+
+	result = AmtPtpHidGetReportSize(Descriptor, Length, Type, ReportId, &size);
+	if (result == AmtPtpHidLayoutOk) {
+		AMTPTP_CHECK_EQ(size, Expected);
+	}
+	else {
+		AMTPTP_CHECK_EQ(size, 0);
+	}
+	return result;
+}
+
+//
+// Every report of the descriptor, and the ones it does not declare
+//
+static VOID
+AmtPtpTestReports(VOID)
+{
+	static const UCHAR noIds[] = {
+		ITEM_REPORT_SIZE, 0x08,
+		ITEM_REPORT_COUNT, 0x02,
+		ITEM_INPUT, 0x02,
+		ITEM_REPORT_COUNT, 0x03,
+		ITEM_FEATURE, 0x02,
+	};
+	const ULONG length = sizeof(AmtPtpTestDescriptor);
+	ULONG i;
+
+	for (i = 0; i < TEST_SIZES; i++) {
+		AMTPTP_CHECK_EQ(AmtPtpTestSize(AmtPtpTestDescriptor, length, AmtPtpTestSizes[i].Type,
+			AmtPtpTestSizes[i].ReportId, AmtPtpTestSizes[i].Size), AmtPtpHidLayoutOk);
+	}
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(AmtPtpTestDescriptor, length, AmtPtpHidReportFeature, 0x01, 0), AmtPtpHidLayoutOk);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(AmtPtpTestDescriptor, length, AmtPtpHidReportInput, 0x02, 0), AmtPtpHidLayoutOk);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(AmtPtpTestDescriptor, length, AmtPtpHidReportInput, 0x04, 0), AmtPtpHidLayoutOk);
+
+	// Without report ids there is no id byte, and only report 0
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(noIds, sizeof(noIds), AmtPtpHidReportInput, 0, 2), AmtPtpHidLayoutOk);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(noIds, sizeof(noIds), AmtPtpHidReportFeature, 0, 3), AmtPtpHidLayoutOk);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(noIds, sizeof(noIds), AmtPtpHidReportInput, 1, 0), AmtPtpHidLayoutOk);
+
+	// An empty descriptor declares nothing
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(noIds, 0, AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutOk);
+}
+
+static VOID
+AmtPtpTestVerify(VOID)
+{
+	AMTPTP_HID_REPORT_SIZE expected[TEST_SIZES];
+	AMTPTP_HID_REPORT_SIZE mismatch;
+
+	AMTPTP_CHECK_EQ(AmtPtpHidVerifyReportSizes(AmtPtpTestDescriptor, sizeof(AmtPtpTestDescriptor),
+		AmtPtpTestSizes, TEST_SIZES, NULL), AmtPtpHidLayoutOk);
+
+	// One byte off is reported with the size the descriptor declares
+	memcpy(expected, AmtPtpTestSizes, sizeof(expected));
+	expected[2].Size++;
+	RtlZeroMemory(&mismatch, sizeof(mismatch));
+	AMTPTP_CHECK_EQ(AmtPtpHidVerifyReportSizes(AmtPtpTestDescriptor, sizeof(AmtPtpTestDescriptor),
+		expected, TEST_SIZES, &mismatch), AmtPtpHidLayoutMismatch);
+	AMTPTP_CHECK_EQ(mismatch.Type, AmtPtpHidReportFeature);
+	AMTPTP_CHECK_EQ(mismatch.ReportId, 0x02);
+	AMTPTP_CHECK_EQ(mismatch.Size, 513);
+	AMTPTP_CHECK_EQ(AmtPtpHidVerifyReportSizes(AmtPtpTestDescriptor, sizeof(AmtPtpTestDescriptor),
+		expected, TEST_SIZES, NULL), AmtPtpHidLayoutMismatch);
+
+	// So is a report the descriptor leaves out
+	memcpy(expected, AmtPtpTestSizes, sizeof(expected));
+	expected[1].Type = AmtPtpHidReportInput;
+	expected[1].ReportId = 0x03;
+	AMTPTP_CHECK_EQ(AmtPtpHidVerifyReportSizes(AmtPtpTestDescriptor, sizeof(AmtPtpTestDescriptor),
+		expected, TEST_SIZES, &mismatch), AmtPtpHidLayoutMismatch);
+	AMTPTP_CHECK_EQ(mismatch.Type, AmtPtpHidReportInput);
+	AMTPTP_CHECK_EQ(mismatch.ReportId, 0x03);
+	AMTPTP_CHECK_EQ(mismatch.Size, 0);
+
+	// A descriptor that does not parse is not a mismatch
+	AMTPTP_CHECK_EQ(AmtPtpHidVerifyReportSizes(AmtPtpTestDescriptor, sizeof(AmtPtpTestDescriptor) - 1,
+		AmtPtpTestSizes, TEST_SIZES, &mismatch), AmtPtpHidLayoutUnbalanced);
+}
+
+//
+// Cut anywhere, the descriptor either ends inside an item, or inside the
+// collection, or before it
+//
+static VOID
+AmtPtpTestTruncated(VOID)
+{
+	static const UCHAR shortItem[] = { ITEM_REPORT_SIZE_4, 0x08, 0x00, 0x00 };
+	BOOLEAN boundary[sizeof(AmtPtpTestDescriptor) + 1] = { 0 };
+	UCHAR* copy;
+	ULONG offset, length;
+
+	for (offset = 0; offset < sizeof(AmtPtpTestDescriptor); offset += 1 + (AmtPtpTestDescriptor[offset] & 0x03)) {
+		boundary[offset] = TRUE;
+	}
+	boundary[sizeof(AmtPtpTestDescriptor)] = TRUE;
+
+	for (length = 0; length < sizeof(AmtPtpTestDescriptor); length++) {
+		AMTPTP_HID_LAYOUT_RESULT expected;
+
+		if (!boundary[length]) {
+			expected = AmtPtpHidLayoutTruncated;
+		}
+		else if (length >= TEST_COLLECTION_END) {
+			expected = AmtPtpHidLayoutUnbalanced;
+		}
+		else {
+			expected = AmtPtpHidLayoutOk;
+		}
+
+		// An exact copy, so that a read past the end is one past the allocation
+		copy = malloc(length > 0 ? length : 1);
+		memcpy(copy, AmtPtpTestDescriptor, length);
+		AMTPTP_CHECK_EQ(AmtPtpTestSize(copy, length, AmtPtpHidReportInput, 0x01, 0), expected);
+		free(copy);
+	}
+
+	// A 4-byte item with only 3 of them
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(shortItem, sizeof(shortItem), AmtPtpHidReportInput, 0, 0),
+		AmtPtpHidLayoutTruncated);
+}
+
+static VOID
+AmtPtpTestUnbalanced(VOID)
+{
+	static const UCHAR extraEnd[] = {
+		ITEM_COLLECTION, 0x01,
+		ITEM_END_COLLECTION,
+		ITEM_END_COLLECTION,
+	};
+	static const UCHAR popFirst[] = {
+		ITEM_REPORT_SIZE, 0x08,
+		ITEM_POP,
+		ITEM_PUSH,
+	};
+	UCHAR pushes[2 * (AMTPTP_HID_GLOBAL_STACK_DEPTH + 1) + 4];
+	ULONG i, length = 0;
+
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(extraEnd, sizeof(extraEnd), AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutUnbalanced);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(popFirst, sizeof(popFirst), AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutUnbalanced);
+
+	// As deep as the walker goes, then one more
+	for (i = 0; i < AMTPTP_HID_GLOBAL_STACK_DEPTH; i++) {
+		pushes[length++] = ITEM_PUSH;
+	}
+	pushes[length++] = ITEM_REPORT_COUNT;
+	pushes[length++] = 0x01;
+	pushes[length++] = ITEM_INPUT;
+	pushes[length++] = 0x02;
+	for (i = 0; i < AMTPTP_HID_GLOBAL_STACK_DEPTH; i++) {
+		pushes[length++] = ITEM_POP;
+	}
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(pushes, length, AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutOk);
+
+	memmove(pushes + 1, pushes, length);
+	pushes[0] = ITEM_PUSH;
+	pushes[length + 1] = ITEM_POP;
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(pushes, length + 2, AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutUnbalanced);
+}
+
+//
+// Report ID 0 is reserved, ids are one byte, and hidclass takes reports of
+// up to 0xffff bytes
+//
+static VOID
+AmtPtpTestInvalid(VOID)
+{
+	static const UCHAR idZero[] = { ITEM_REPORT_ID, 0x00 };
+	static const UCHAR idWide[] = { ITEM_REPORT_ID_2, 0x00, 0x01 };
+	static const UCHAR largest[] = {
+		ITEM_REPORT_SIZE, 0x08,
+		ITEM_REPORT_COUNT_2, 0xff, 0xff,
+		ITEM_INPUT, 0x02,
+	};
+	static const UCHAR tooLarge[] = {
+		ITEM_REPORT_SIZE, 0x08,
+		ITEM_REPORT_COUNT_2, 0xff, 0xff,
+		ITEM_INPUT, 0x02,
+		ITEM_REPORT_SIZE, 0x01,
+		ITEM_REPORT_COUNT, 0x01,
+		ITEM_INPUT, 0x02,
+	};
+	static const UCHAR overflow[] = {
+		ITEM_REPORT_SIZE_4, 0xff, 0xff, 0xff, 0xff,
+		ITEM_REPORT_COUNT_2, 0xff, 0xff,
+		ITEM_INPUT, 0x02,
+	};
+
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(idZero, sizeof(idZero), AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutInvalidItem);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(idWide, sizeof(idWide), AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutInvalidItem);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(largest, sizeof(largest), AmtPtpHidReportInput, 0, 0xffff), AmtPtpHidLayoutOk);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(tooLarge, sizeof(tooLarge), AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutInvalidItem);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(overflow, sizeof(overflow), AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutInvalidItem);
+
+	// Reports the descriptor does not ask for are not sized at all
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(tooLarge, sizeof(tooLarge), AmtPtpHidReportFeature, 0, 0), AmtPtpHidLayoutOk);
+}
+
+//
+// Long items carry their own length and nothing that counts, whatever their
+// data looks like
+//
+static VOID
+AmtPtpTestLongItems(VOID)
+{
+	static const UCHAR longItem[] = {
+		ITEM_LONG, 0x06, 0x10,
+			ITEM_REPORT_SIZE, 0x20, ITEM_REPORT_COUNT, 0x10, ITEM_INPUT, 0x02,
+	};
+	UCHAR descriptor[sizeof(AmtPtpTestDescriptor) + sizeof(longItem)];
+	ULONG i;
+
+	// Right after Begin Collection, in between Report ID and Report Size
+	memcpy(descriptor, AmtPtpTestDescriptor, TEST_COLLECTION_END + 2);
+	memcpy(descriptor + TEST_COLLECTION_END + 2, longItem, sizeof(longItem));
+	memcpy(descriptor + TEST_COLLECTION_END + 2 + sizeof(longItem), AmtPtpTestDescriptor + TEST_COLLECTION_END + 2,
+		sizeof(AmtPtpTestDescriptor) - TEST_COLLECTION_END - 2);
+	AMTPTP_CHECK(longItem[1] == sizeof(longItem) - 3);
+
+	for (i = 0; i < TEST_SIZES; i++) {
+		AMTPTP_CHECK_EQ(AmtPtpTestSize(descriptor, sizeof(descriptor), AmtPtpTestSizes[i].Type,
+			AmtPtpTestSizes[i].ReportId, AmtPtpTestSizes[i].Size), AmtPtpHidLayoutOk);
+	}
+
+	// Cut short in the header or the data
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(longItem, 2, AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutTruncated);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(longItem, sizeof(longItem) - 1, AmtPtpHidReportInput, 0, 0),
+		AmtPtpHidLayoutTruncated);
+	AMTPTP_CHECK_EQ(AmtPtpTestSize(longItem, sizeof(longItem), AmtPtpHidReportInput, 0, 0), AmtPtpHidLayoutOk);
+}
+
+//
+// Random edits of the descriptor: bytes changed, inserted and dropped. The
+// walker must come back with a result, a size only when the descriptor
+// parses, and then the size the fields add up to.
+//
+static VOID
+AmtPtpTestFuzz(VOID)
+{
+	static AMTPTP_HID_FIELD fields[TEST_MAX_FIELDS];
+	UCHAR descriptor[TEST_MAX_DESCRIPTOR];
+	ULONG results[AmtPtpHidLayoutMismatch + 1] = { 0 };
+	ULONG round, edit, edits, length, size, count, compared = 0;
+
+	for (round = 0; round < TEST_FUZZ_ROUNDS; round++) {
+		AMTPTP_HID_REPORT_TYPE type = (AMTPTP_HID_REPORT_TYPE) (AmtPtpTestRandom() % 3);
+		UCHAR reportId = (UCHAR) (AmtPtpTestRandom() % 5);
+		AMTPTP_HID_LAYOUT_RESULT result;
+		UCHAR* copy;
+
+		length = sizeof(AmtPtpTestDescriptor);
+		memcpy(descriptor, AmtPtpTestDescriptor, length);
+
+		edits = 1 + AmtPtpTestRandom() % 4;
+		for (edit = 0; edit < edits; edit++) {
+			ULONG at = AmtPtpTestRandom() % length;
+
+			switch (AmtPtpTestRandom() % 3) {
+			case 0:
+				descriptor[at] = (UCHAR) AmtPtpTestRandom();
+				break;
+			case 1:
+				if (length < TEST_MAX_DESCRIPTOR) {
+					memmove(descriptor + at + 1, descriptor + at, length - at);
+					descriptor[at] = (UCHAR) AmtPtpTestRandom();
+					length++;
+				}
+				break;
+			default:
+				if (length > 1) {
+					memmove(descriptor + at, descriptor + at + 1, length - at - 1);
+					length--;
+				}
+				break;
+			}
+		}
+
+		copy = malloc(length);
+		memcpy(copy, descriptor, length);
+		size = 0xdeadbeef;
+		result = AmtPtpHidGetReportSize(copy, length, type, reportId, &size);
+
+		AMTPTP_CHECK(result <= AmtPtpHidLayoutInvalidItem);
+		if (result <= AmtPtpHidLayoutMismatch) {
+			results[result]++;
+		}
+		if (result != AmtPtpHidLayoutOk) {
+			AMTPTP_CHECK_EQ(size, 0);
+		}
+		else {
+			AMTPTP_CHECK(size <= 0xffff + 1);
+
+			// Reports of empty fields are declared but have none to list
+			if (AmtPtpHidGetFields(copy, length, type, reportId, fields, TEST_MAX_FIELDS, &count) && count > 0) {
+				AMTPTP_CHECK_EQ(size, (fields[count - 1].BitOffset + fields[count - 1].BitSize + 7) / 8);
+				compared++;
+			}
+		}
+		free(copy);
+	}
+
+	printf("fuzz: %u ok (%u sized), %u truncated, %u unbalanced, %u invalid\n", results[AmtPtpHidLayoutOk],
+		compared, results[AmtPtpHidLayoutTruncated], results[AmtPtpHidLayoutUnbalanced],
+		results[AmtPtpHidLayoutInvalidItem]);
+
+	// Every outcome shows up, or the edits are not reaching the walker
+	AMTPTP_CHECK(compared > TEST_FUZZ_ROUNDS / 100);
+	AMTPTP_CHECK(results[AmtPtpHidLayoutTruncated] > 0);
+	AMTPTP_CHECK(results[AmtPtpHidLayoutUnbalanced] > 0);
+	AMTPTP_CHECK(results[AmtPtpHidLayoutInvalidItem] > 0);
+}
+
+int
+main(VOID)
+{
+	AmtPtpTestReports();
+	AmtPtpTestVerify();
+	AmtPtpTestTruncated();
+	AmtPtpTestUnbalanced();
+	AmtPtpTestInvalid();
+	AmtPtpTestLongItems();
+	AmtPtpTestFuzz();
+	return AmtPtpTestExit("AmtPtpHidReportLayoutTest");
+}
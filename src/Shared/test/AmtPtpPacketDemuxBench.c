@@ -0,0 +1,135 @@
+// AmtPtpPacketDemuxBench.c: MT2 transfers taken apart, before and after the demultiplexer
+//
+// "before" is PtpFilterParsePacket as it was, recursing on 0x02 and 0xF7 with
+// its report cases reduced to a call of the handler. "after" is what Input.c
+// does now: BT touch frames go straight to the handler, other single reports
+// through AmtPtpPacketDemuxSingle, the rest through the walk. The handler is
+// called through a pointer so that neither side gets it inlined.
+//
+// The old code reads past the buffer on bad lengths, so only well formed
+// transfers are timed here.
+
+#include <AmtPtpBench.h>
+#include <string.h>
+#include <AmtPtpPacketDemux.h>
+
+typedef VOID AMTPTP_BENCH_HANDLER(_In_reads_bytes_(Length) const UCHAR* Report, _In_ SIZE_T Length);
+
+static VOID
+AmtPtpBenchHandle(
+	_In_reads_bytes_(Length) const UCHAR* Report,
+	_In_ SIZE_T Length
+)
+{
+	AmtPtpBenchSink += Report[0] + (ULONG) Length;
+}
+
+static AMTPTP_BENCH_HANDLER* volatile AmtPtpBenchHandler = AmtPtpBenchHandle;
+
+static VOID
+AmtPtpBenchBefore(
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length
+)
+{
+	SIZE_T first;
+
+	if (Length == 0) {
+		return;
+	}
+
+	switch (Buffer[0]) {
+	case AMTPTP_DEMUX_MOUSE:
+		if (Length > AMTPTP_MT2_MOUSE_REPORT_SIZE) {
+			AmtPtpBenchBefore(Buffer + AMTPTP_MT2_MOUSE_REPORT_SIZE, Length - AMTPTP_MT2_MOUSE_REPORT_SIZE);
+			return;
+		}
+		AmtPtpBenchHandler(Buffer, Length);
+		return;
+	case AMTPTP_DEMUX_COMBINED:
+		first = Buffer[1];
+		AmtPtpBenchBefore(Buffer + 2, first);
+		AmtPtpBenchBefore(Buffer + 2 + first, Length - 2 - first);
+		return;
+	default:
+		AmtPtpBenchHandler(Buffer, Length);
+		return;
+	}
+}
+
+static VOID
+AmtPtpBenchAfter(
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length
+)
+{
+	AMTPTP_PACKET_DEMUX demux;
+	const UCHAR* report;
+	SIZE_T reportLength;
+
+	if (Length > 0 && Buffer[0] != AMTPTP_DEMUX_MOUSE && Buffer[0] != AMTPTP_DEMUX_COMBINED) {
+		AmtPtpBenchHandler(Buffer, Length);
+		return;
+	}
+	if (AmtPtpPacketDemuxSingle(Buffer, Length, &report, &reportLength)) {
+		AmtPtpBenchHandler(report, reportLength);
+		return;
+	}
+
+	AmtPtpPacketDemuxBegin(&demux, Buffer, Length);
+	while (AmtPtpPacketDemuxNext(&demux, &report, &reportLength) != AmtPtpDemuxDone) {
+		if (report != NULL) {
+			AmtPtpBenchHandler(report, reportLength);
+		}
+	}
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	// A 0x31 frame with two fingers, as in corpus/mt2-bluetooth.cap, alone,
+	// behind a USB mouse report, and twice in one 0xF7
+	static UCHAR transfers[3][80];
+	static const char* names[] = { "0x31", "0x02 + 0x31", "0xf7 pair" };
+	SIZE_T lengths[3];
+	ULONG iterations = AmtPtpBenchIterations(argc, argv, 10000000);
+	ULONGLONG start;
+	ULONG i, n;
+	char name[64];
+
+	for (i = 0; i < 30; i++) {
+		transfers[0][i] = (UCHAR) (i * 29 + 7);
+	}
+	transfers[0][0] = 0x31;
+	lengths[0] = 30;
+
+	transfers[1][0] = AMTPTP_DEMUX_MOUSE;
+	memcpy(transfers[1] + AMTPTP_MT2_MOUSE_REPORT_SIZE, transfers[0], lengths[0]);
+	lengths[1] = AMTPTP_MT2_MOUSE_REPORT_SIZE + lengths[0];
+
+	transfers[2][0] = AMTPTP_DEMUX_COMBINED;
+	transfers[2][1] = (UCHAR) lengths[0];
+	memcpy(transfers[2] + 2, transfers[0], lengths[0]);
+	memcpy(transfers[2] + 2 + lengths[0], transfers[0], lengths[0]);
+	lengths[2] = 2 + 2 * lengths[0];
+
+	for (i = 0; i < 3; i++) {
+		start = AmtPtpBenchNow();
+		for (n = 0; n < iterations; n++) {
+			AmtPtpBenchBefore(transfers[i], lengths[i]);
+		}
+		snprintf(name, sizeof(name), "%s, before", names[i]);
+		AmtPtpBenchReport(name, AmtPtpBenchNow() - start, iterations);
+
+		start = AmtPtpBenchNow();
+		for (n = 0; n < iterations; n++) {
+			AmtPtpBenchAfter(transfers[i], lengths[i]);
+		}
+		snprintf(name, sizeof(name), "%s, after", names[i]);
+		AmtPtpBenchReport(name, AmtPtpBenchNow() - start, iterations);
+	}
+	return 0;
+}
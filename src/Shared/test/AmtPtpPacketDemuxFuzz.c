@@ -0,0 +1,87 @@
+// AmtPtpPacketDemuxFuzz.c: Fuzz target of the MT2 packet demultiplexer
+//
+// The input is one transfer. Whatever it holds, the walk has to stay inside
+// it, end, and hand out each byte at most once:
+// - Reports are not empty, do not start with 0xF7 and come in buffer order.
+// - The walk takes fewer steps than the transfer has bytes, plus one.
+// - The work list never holds more than AMTPTP_DEMUX_MAX_DEPTH + 1 parts.
+// - When AmtPtpPacketDemuxSingle takes the transfer, the walk hands out the
+//   same report and nothing else.
+// A broken invariant aborts, so libFuzzer and AFL++ see a crash. ctest runs
+// this through AmtPtpPacketDemuxTest; with AMTPTP_FUZZ it is built for
+// libFuzzer on its own, see CMakeLists.txt.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <AmtPtpPacketDemux.h>
+
+#define DEMUX_FUZZ_CHECK(Expr) \
+	do { \
+		if (!(Expr)) { \
+			fprintf(stderr, "%s:%d: demux invariant broken: %s\n", __FILE__, __LINE__, #Expr); \
+			abort(); \
+		} \
+	} while (0)
+
+int
+LLVMFuzzerTestOneInput(
+	const uint8_t* Data,
+	size_t Size
+);
+
+int
+LLVMFuzzerTestOneInput(
+	const uint8_t* Data,
+	size_t Size
+)
+{
+	AMTPTP_PACKET_DEMUX demux;
+	AMTPTP_DEMUX_RESULT result;
+	const UCHAR* single;
+	const UCHAR* report;
+	const UCHAR* end = Data + Size;
+	const UCHAR* previousEnd = Data;
+	SIZE_T singleLength, length;
+	BOOLEAN isSingle;
+	ULONG steps = 0, reports = 0, malformed = 0;
+
+	isSingle = AmtPtpPacketDemuxSingle(Data, Size, &single, &singleLength);
+	if (isSingle) {
+		DEMUX_FUZZ_CHECK(single >= Data && singleLength > 0 && single + singleLength == end);
+		DEMUX_FUZZ_CHECK(single[0] != AMTPTP_DEMUX_COMBINED);
+	}
+	else {
+		DEMUX_FUZZ_CHECK(single == NULL && singleLength == 0);
+	}
+
+	AmtPtpPacketDemuxBegin(&demux, Data, Size);
+	for (;;) {
+		DEMUX_FUZZ_CHECK(demux.Count <= AMTPTP_DEMUX_MAX_DEPTH + 1);
+		result = AmtPtpPacketDemuxNext(&demux, &report, &length);
+		if (result == AmtPtpDemuxDone) {
+			DEMUX_FUZZ_CHECK(report == NULL && length == 0);
+			break;
+		}
+
+		DEMUX_FUZZ_CHECK(++steps <= Size + 1);
+		if (result == AmtPtpDemuxMalformed) {
+			DEMUX_FUZZ_CHECK(report == NULL && length == 0);
+			malformed++;
+			continue;
+		}
+
+		DEMUX_FUZZ_CHECK(result == AmtPtpDemuxReport);
+		DEMUX_FUZZ_CHECK(report >= previousEnd && length > 0 && length <= (SIZE_T) (end - report));
+		DEMUX_FUZZ_CHECK(report[0] != AMTPTP_DEMUX_COMBINED);
+		if (isSingle) {
+			DEMUX_FUZZ_CHECK(reports == 0 && report == single && length == singleLength);
+		}
+		previousEnd = report + length;
+		reports++;
+	}
+
+	DEMUX_FUZZ_CHECK(demux.Reports == reports && demux.Malformed == malformed);
+	DEMUX_FUZZ_CHECK(!isSingle || (reports == 1 && malformed == 0));
+	return 0;
+}
@@ -0,0 +1,311 @@
+// AmtPtpPacketDemuxTest.c: MT2 transfers taken apart, captured and synthetic
+//
+// Usage: AmtPtpPacketDemuxTest <mt2 captures...>
+//
+// Every captured transfer is a single report, USB ones behind a mouse report.
+// The synthetic cases cover 0xF7 reports: nested, empty parts, lengths that
+// do not fit and nesting past the limit. Every transfer, and a run of random
+// ones, also goes through the invariants of AmtPtpPacketDemuxFuzz.c.
+
+#include <stdlib.h>
+#include <string.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpCapture.h>
+#include <AmtPtpPacketDemux.h>
+
+#define DEMUX_MAX_STEPS			16
+#define DEMUX_FUZZ_ROUNDS		200000
+#define DEMUX_FUZZ_MAX_LENGTH	96
+
+#define TEST_SIZES(a)			(sizeof(a) / sizeof((a)[0]))
+
+int LLVMFuzzerTestOneInput(const unsigned char* Data, size_t Size);
+
+// One step of a walk: a report at Offset into the transfer, or a dropped part
+typedef struct _AMTPTP_TEST_STEP {
+	AMTPTP_DEMUX_RESULT	Result;
+	SIZE_T				Offset;
+	SIZE_T				Length;
+} AMTPTP_TEST_STEP;
+
+static ULONG AmtPtpTestSeed = 1;
+
+static ULONG
+AmtPtpTestRandom(VOID)
+{
+	AmtPtpTestSeed = AmtPtpTestSeed * 1103515245 + 12345;
+	return (AmtPtpTestSeed >> 16) | (AmtPtpTestSeed << 16);
+}
+
+static VOID
+AmtPtpTestWalk(
+	_In_ const char* Name,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_reads_(StepCount) const AMTPTP_TEST_STEP* Steps,
+	_In_ ULONG StepCount
+)
+{
+	AMTPTP_PACKET_DEMUX demux;
+	AMTPTP_DEMUX_RESULT result;
+	const UCHAR* report;
+	SIZE_T reportLength;
+	ULONG i, reports = 0, malformed = 0;
+
+	LLVMFuzzerTestOneInput(Buffer, Length);
+
+	AmtPtpPacketDemuxBegin(&demux, Buffer, Length);
+	for (i = 0; i <= StepCount; i++) {
+		result = AmtPtpPacketDemuxNext(&demux, &report, &reportLength);
+		if (i == StepCount) {
+			if (result != AmtPtpDemuxDone) {
+				fprintf(stderr, "%s: walk goes on past %u steps\n", Name, StepCount);
+				AmtPtpTestFailures++;
+			}
+			break;
+		}
+		if (result != Steps[i].Result) {
+			fprintf(stderr, "%s: step %u is %d, expected %d\n", Name, i, result, Steps[i].Result);
+			AmtPtpTestFailures++;
+			return;
+		}
+		if (result == AmtPtpDemuxDone) {
+			break;
+		}
+		if (result == AmtPtpDemuxMalformed) {
+			malformed++;
+			continue;
+		}
+		reports++;
+		if (report != Buffer + Steps[i].Offset || reportLength != Steps[i].Length) {
+			fprintf(stderr, "%s: step %u is %zu bytes at %zu, expected %zu at %zu\n", Name, i,
+				reportLength, (SIZE_T) (report - Buffer), Steps[i].Length, Steps[i].Offset);
+			AmtPtpTestFailures++;
+		}
+	}
+
+	AMTPTP_CHECK_EQ(demux.Reports, reports);
+	AMTPTP_CHECK_EQ(demux.Malformed, malformed);
+}
+
+// What the filter gets from the captures
+static VOID
+AmtPtpTestCapture(
+	_In_ const char* Path
+)
+{
+	AMTPTP_CAPTURE capture;
+	AMTPTP_TEST_STEP step = { AmtPtpDemuxReport, 0, 0 };
+	const UCHAR* report;
+	SIZE_T reportLength;
+	ULONG i;
+
+	if (!AmtPtpCaptureLoad(Path, &capture)) {
+		AmtPtpTestFailures++;
+		return;
+	}
+
+	for (i = 0; i < capture.FrameCount; i++) {
+		const AMTPTP_CAPTURE_FRAME* frame = &capture.Frames[i];
+
+		step.Offset = (capture.Bus == AmtPtpBusUsb) ? AMTPTP_MT2_MOUSE_REPORT_SIZE : 0;
+		step.Length = frame->Length - step.Offset;
+		AMTPTP_CHECK(AmtPtpPacketDemuxSingle(frame->Data, frame->Length, &report, &reportLength));
+		AMTPTP_CHECK(report == frame->Data + step.Offset && reportLength == step.Length);
+		AmtPtpTestWalk(Path, frame->Data, frame->Length, &step, 1);
+	}
+
+	AmtPtpCaptureFree(&capture);
+}
+
+static VOID
+AmtPtpTestSynthetic(VOID)
+{
+	static const UCHAR touch[] = { 0x31, 0x10, 0x20, 0x30 };
+	static const UCHAR mouse[] = { 0x02, 0, 0, 0, 0, 0, 0, 0 };
+	static const UCHAR usb[] = { 0x02, 0, 0, 0, 0, 0, 0, 0, 0x31, 0x10 };
+	static const UCHAR twoMice[] = { 0x02, 1, 1, 1, 1, 1, 1, 1, 0x02, 2, 2, 2, 2, 2, 2, 2, 0x31 };
+	static const UCHAR pair[] = { 0xf7, 0x03, 0x90, 0x01, 0x02, 0x31, 0x10, 0x20 };
+	static const UCHAR pairUsb[] = { 0xf7, 0x0a, 0x02, 0, 0, 0, 0, 0, 0, 0, 0x31, 0x10, 0x13, 0x83 };
+	static const UCHAR emptyFirst[] = { 0xf7, 0x00, 0x31, 0x10 };
+	static const UCHAR emptyBoth[] = { 0xf7, 0x00 };
+	static const UCHAR tooLong[] = { 0xf7, 0xc8, 0x31, 0x01, 0x02 };
+	static const UCHAR exact[] = { 0xf7, 0x03, 0x31, 0x01, 0x02 };
+	static const UCHAR cut[] = { 0xf7 };
+	static const UCHAR badSecond[] = { 0xf7, 0x02, 0x31, 0x01, 0xf7, 0x05, 0x31 };
+	static const AMTPTP_TEST_STEP touchSteps[] = { { AmtPtpDemuxReport, 0, sizeof(touch) } };
+	static const AMTPTP_TEST_STEP mouseSteps[] = { { AmtPtpDemuxReport, 0, sizeof(mouse) } };
+	static const AMTPTP_TEST_STEP usbSteps[] = { { AmtPtpDemuxReport, 8, 2 } };
+	static const AMTPTP_TEST_STEP twoMiceSteps[] = { { AmtPtpDemuxReport, 16, 1 } };
+	static const AMTPTP_TEST_STEP pairSteps[] = { { AmtPtpDemuxReport, 2, 3 }, { AmtPtpDemuxReport, 5, 3 } };
+	static const AMTPTP_TEST_STEP pairUsbSteps[] = { { AmtPtpDemuxReport, 10, 2 }, { AmtPtpDemuxReport, 12, 2 } };
+	static const AMTPTP_TEST_STEP emptyFirstSteps[] = { { AmtPtpDemuxReport, 2, 2 } };
+	static const AMTPTP_TEST_STEP malformedSteps[] = { { AmtPtpDemuxMalformed, 0, 0 } };
+	static const AMTPTP_TEST_STEP exactSteps[] = { { AmtPtpDemuxReport, 2, 3 } };
+	static const AMTPTP_TEST_STEP badSecondSteps[] = { { AmtPtpDemuxReport, 2, 2 }, { AmtPtpDemuxMalformed, 0, 0 } };
+	const UCHAR* report;
+	SIZE_T reportLength;
+
+	// Single reports, the mouse report in front of a USB frame is skipped.
+	// One on its own is handed out.
+	AmtPtpTestWalk("touch", touch, sizeof(touch), touchSteps, TEST_SIZES(touchSteps));
+	AmtPtpTestWalk("mouse", mouse, sizeof(mouse), mouseSteps, TEST_SIZES(mouseSteps));
+	AmtPtpTestWalk("usb", usb, sizeof(usb), usbSteps, TEST_SIZES(usbSteps));
+	AmtPtpTestWalk("two mice", twoMice, sizeof(twoMice), twoMiceSteps, TEST_SIZES(twoMiceSteps));
+	AMTPTP_CHECK(AmtPtpPacketDemuxSingle(usb, sizeof(usb), &report, &reportLength));
+	AMTPTP_CHECK(report == usb + 8 && reportLength == 2);
+
+	// Nothing at all
+	AMTPTP_CHECK(!AmtPtpPacketDemuxSingle(usb, 0, &report, &reportLength));
+	AMTPTP_CHECK(report == NULL && reportLength == 0);
+	AmtPtpTestWalk("empty", usb, 0, NULL, 0);
+
+	// 0xF7 pairs hand out the first report first, and are not single
+	AMTPTP_CHECK(!AmtPtpPacketDemuxSingle(pair, sizeof(pair), &report, &reportLength));
+	AMTPTP_CHECK(report == NULL && reportLength == 0);
+	AmtPtpTestWalk("pair", pair, sizeof(pair), pairSteps, TEST_SIZES(pairSteps));
+	AmtPtpTestWalk("pair with mouse", pairUsb, sizeof(pairUsb), pairUsbSteps, TEST_SIZES(pairUsbSteps));
+	AmtPtpTestWalk("empty first", emptyFirst, sizeof(emptyFirst), emptyFirstSteps, TEST_SIZES(emptyFirstSteps));
+	AmtPtpTestWalk("empty both", emptyBoth, sizeof(emptyBoth), NULL, 0);
+
+	// A first length past the end, 200 bytes in a 5 byte transfer: the old
+	// recursive parser read past the buffer here. A length of exactly the
+	// bytes left fits.
+	AmtPtpTestWalk("too long", tooLong, sizeof(tooLong), malformedSteps, TEST_SIZES(malformedSteps));
+	AmtPtpTestWalk("exact", exact, sizeof(exact), exactSteps, TEST_SIZES(exactSteps));
+	AmtPtpTestWalk("cut", cut, sizeof(cut), malformedSteps, TEST_SIZES(malformedSteps));
+
+	// A broken second part does not take the first one with it
+	AmtPtpTestWalk("bad second", badSecond, sizeof(badSecond), badSecondSteps, TEST_SIZES(badSecondSteps));
+}
+
+// 0xF7 wrapped Depth times around one touch report, each time as the first part
+// with a touch report behind it
+static SIZE_T
+AmtPtpTestNest(
+	_Out_writes_bytes_(64) UCHAR* Buffer,
+	_In_ ULONG Depth
+)
+{
+	SIZE_T length = 2;
+	ULONG i;
+
+	Buffer[0] = 0x31;
+	Buffer[1] = 0x00;
+	for (i = 0; i < Depth; i++) {
+		memmove(Buffer + 2, Buffer, length);
+		Buffer[0] = AMTPTP_DEMUX_COMBINED;
+		Buffer[1] = (UCHAR) length;
+		Buffer[length + 2] = 0x31;
+		Buffer[length + 3] = (UCHAR) (i + 1);
+		length += 4;
+	}
+	return length;
+}
+
+// AMTPTP_DEMUX_MAX_DEPTH levels are taken apart. With one more, the innermost
+// 0xF7 is dropped as a whole but the reports behind it are not.
+static VOID
+AmtPtpTestNesting(VOID)
+{
+	UCHAR buffer[64];
+	AMTPTP_TEST_STEP steps[DEMUX_MAX_STEPS];
+	SIZE_T length;
+	ULONG depth, i;
+
+	depth = AMTPTP_DEMUX_MAX_DEPTH;
+	length = AmtPtpTestNest(buffer, depth);
+	for (i = 0; i <= depth; i++) {
+		steps[i].Result = AmtPtpDemuxReport;
+		steps[i].Offset = 2 * depth + 2 * i;
+		steps[i].Length = 2;
+	}
+	AmtPtpTestWalk("nested", buffer, length, steps, depth + 1);
+
+	depth = AMTPTP_DEMUX_MAX_DEPTH + 1;
+	length = AmtPtpTestNest(buffer, depth);
+	steps[0].Result = AmtPtpDemuxMalformed;
+	for (i = 1; i < depth; i++) {
+		steps[i].Result = AmtPtpDemuxReport;
+		steps[i].Offset = 2 * depth + 2 * (i + 1);
+		steps[i].Length = 2;
+	}
+	AmtPtpTestWalk("nested too deep", buffer, length, steps, depth);
+}
+
+// A transfer in an allocation of its own size, so that ASan sees a read past
+// its end
+static VOID
+AmtPtpTestFuzzOne(
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length
+)
+{
+	UCHAR* copy = malloc(Length > 0 ? Length : 1);
+
+	AMTPTP_CHECK(copy != NULL);
+	if (copy != NULL) {
+		memcpy(copy, Buffer, Length);
+		LLVMFuzzerTestOneInput(copy, Length);
+		free(copy);
+	}
+}
+
+// Random transfers through the fuzz target, each once more with its end cut
+// off. Bytes are drawn mostly from the report IDs the walk knows and from
+// lengths near the bytes left, so that it gets somewhere.
+static VOID
+AmtPtpTestFuzz(VOID)
+{
+	static const UCHAR ids[] = { AMTPTP_DEMUX_MOUSE, 0x31, AMTPTP_DEMUX_COMBINED, 0x90 };
+	UCHAR buffer[DEMUX_FUZZ_MAX_LENGTH];
+	SIZE_T length, i;
+	ULONG round;
+
+	for (round = 0; round < DEMUX_FUZZ_ROUNDS; round++) {
+		length = AmtPtpTestRandom() % (DEMUX_FUZZ_MAX_LENGTH + 1);
+		for (i = 0; i < length; i++) {
+			ULONG r = AmtPtpTestRandom();
+
+			switch (r % 4) {
+			case 0:
+				buffer[i] = ids[(r >> 8) % TEST_SIZES(ids)];
+				break;
+			case 1:
+				buffer[i] = (UCHAR) ((r >> 8) % (length - i + 2));
+				break;
+			default:
+				buffer[i] = (UCHAR) (r >> 8);
+				break;
+			}
+		}
+
+		AmtPtpTestFuzzOne(buffer, length);
+		if (length > 0) {
+			AmtPtpTestFuzzOne(buffer, AmtPtpTestRandom() % length);
+		}
+	}
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	int i;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <mt2 captures...>\n", argv[0]);
+		return 2;
+	}
+
+	for (i = 1; i < argc; i++) {
+		AmtPtpTestCapture(argv[i]);
+	}
+	AmtPtpTestSynthetic();
+	AmtPtpTestNesting();
+	AmtPtpTestFuzz();
+
+	return AmtPtpTestExit("AmtPtpPacketDemuxTest");
+}
@@ -0,0 +1,110 @@
+// AmtPtpPerfCountersBench.c: Cost of the counters on the input path
+//
+// A frame bumps FramesIn and ReportsOut and records its latency. The plain
+// case does the same with ordinary increments, the padded case with every
+// counter on a cache line of its own, which only pays off when writers on
+// different cores fight over the block. The snapshot is what a feature
+// report read costs.
+
+#include <AmtPtpBench.h>
+#include <AmtPtpPerfCounters.h>
+
+#define BENCH_QPC_FREQUENCY		10000000ULL
+#define BENCH_CACHE_LINE		64
+
+typedef struct _AMTPTP_BENCH_PADDED_COUNTER {
+	volatile LONG	Value;
+	UCHAR			Padding[BENCH_CACHE_LINE - sizeof(LONG)];
+} AMTPTP_BENCH_PADDED_COUNTER;
+
+typedef struct _AMTPTP_BENCH_PADDED_COUNTERS {
+	AMTPTP_BENCH_PADDED_COUNTER	FramesIn;
+	AMTPTP_BENCH_PADDED_COUNTER	ReportsOut;
+	AMTPTP_BENCH_PADDED_COUNTER	Latency[AMTPTP_PERF_LATENCY_BUCKETS];
+} AMTPTP_BENCH_PADDED_COUNTERS;
+
+// The bucket of AmtPtpPerfCountersRecordLatency, for the cases that do not call it
+static ULONG
+AmtPtpBenchBucket(
+	_In_ ULONGLONG Ticks
+)
+{
+	ULONGLONG microseconds;
+	ULONG bucket = 0;
+
+	if (Ticks >= BENCH_QPC_FREQUENCY) {
+		return AMTPTP_PERF_LATENCY_BUCKETS - 1;
+	}
+	microseconds = Ticks * 1000000 / BENCH_QPC_FREQUENCY;
+	while (microseconds != 0 && bucket < AMTPTP_PERF_LATENCY_BUCKETS - 1) {
+		microseconds >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	static AMTPTP_PERF_COUNTERS counters;
+	static AMTPTP_PERF_COUNTERS plain;
+	static AMTPTP_BENCH_PADDED_COUNTERS padded;
+	ULONG values[AMTPTP_PERF_COUNTER_COUNT];
+	ULONG iterations = AmtPtpBenchIterations(argc, argv, 10000000);
+	ULONGLONG start;
+	ULONG i;
+
+	AmtPtpPerfCountersInitialize(&counters);
+	AmtPtpPerfCountersInitialize(&plain);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		AMTPTP_PERF_COUNT(&counters, ReportsOut);
+	}
+	AmtPtpBenchReport("one increment", AmtPtpBenchNow() - start, iterations);
+
+	// Latencies spread over a few buckets, 0 to 3.3 ms
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		AmtPtpPerfCountersRecordLatency(&counters, (i * 2654435761UL) % 32768, BENCH_QPC_FREQUENCY);
+	}
+	AmtPtpBenchReport("latency", AmtPtpBenchNow() - start, iterations);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		AMTPTP_PERF_COUNT(&counters, FramesIn);
+		AMTPTP_PERF_COUNT(&counters, ReportsOut);
+		AmtPtpPerfCountersRecordLatency(&counters, (i * 2654435761UL) % 32768, BENCH_QPC_FREQUENCY);
+	}
+	AmtPtpBenchReport("frame, interlocked", AmtPtpBenchNow() - start, iterations);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		plain.FramesIn++;
+		plain.ReportsOut++;
+		plain.Latency[AmtPtpBenchBucket((i * 2654435761UL) % 32768)]++;
+	}
+	AmtPtpBenchReport("frame, plain", AmtPtpBenchNow() - start, iterations);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		InterlockedIncrement(&padded.FramesIn.Value);
+		InterlockedIncrement(&padded.ReportsOut.Value);
+		InterlockedIncrement(&padded.Latency[AmtPtpBenchBucket((i * 2654435761UL) % 32768)].Value);
+	}
+	AmtPtpBenchReport("frame, one counter per line", AmtPtpBenchNow() - start, iterations);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		AmtPtpPerfCountersSnapshot(&counters, values);
+		AmtPtpBenchSink += values[i % AMTPTP_PERF_COUNTER_COUNT];
+	}
+	AmtPtpBenchReport("snapshot", AmtPtpBenchNow() - start, iterations);
+
+	AmtPtpBenchSink += (ULONG) plain.FramesIn + (ULONG) padded.FramesIn.Value;
+	printf("block: %zu bytes, %zu bytes padded\n", sizeof(AMTPTP_PERF_COUNTERS), sizeof(AMTPTP_BENCH_PADDED_COUNTERS));
+	return 0;
+}
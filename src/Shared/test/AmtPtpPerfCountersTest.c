@@ -0,0 +1,180 @@
+// AmtPtpPerfCountersTest.c: Counter block layout, latency buckets and wrap
+//
+// The feature report hands the snapshot out as it is, so its order is the
+// contract with the Settings app. The threaded case counts from several
+// writers at once and loses nothing; on a single core it only checks that
+// the count survives preemption.
+
+#include <pthread.h>
+#include <stddef.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpPerfCounters.h>
+
+#define TEST_QPC_FREQUENCY		10000000ULL		/* 100ns ticks, as KeQueryPerformanceCounter on most machines */
+#define TEST_WRITERS			4
+#define TEST_WRITER_FRAMES		250000
+
+#define TEST_INDEX(Field)		(offsetof(AMTPTP_PERF_COUNTERS, Field) / sizeof(LONG))
+#define TEST_SIZES(a)			(sizeof(a) / sizeof((a)[0]))
+
+// Each field lands in its own slot, in declaration order
+static VOID
+AmtPtpTestLayout(VOID)
+{
+	AMTPTP_PERF_COUNTERS counters;
+	ULONG values[AMTPTP_PERF_COUNTER_COUNT];
+	ULONG i;
+
+	AmtPtpPerfCountersInitialize(&counters);
+	AmtPtpPerfCountersSnapshot(&counters, values);
+	for (i = 0; i < AMTPTP_PERF_COUNTER_COUNT; i++) {
+		AMTPTP_CHECK_EQ(values[i], 0);
+	}
+
+	counters.FramesIn = 1;
+	counters.ReportsOut = 2;
+	counters.NoRequestDrops = 3;
+	counters.Malformed = 4;
+	counters.Resets = 5;
+	counters.SplitMerges = 6;
+	for (i = 0; i < AMTPTP_PERF_LATENCY_BUCKETS; i++) {
+		counters.Latency[i] = (LONG) (100 + i);
+	}
+
+	AmtPtpPerfCountersSnapshot(&counters, values);
+	for (i = 0; i < 6; i++) {
+		AMTPTP_CHECK_EQ(values[i], i + 1);
+	}
+	for (i = 0; i < AMTPTP_PERF_LATENCY_BUCKETS; i++) {
+		AMTPTP_CHECK_EQ(values[TEST_INDEX(Latency) + i], 100 + i);
+	}
+	AMTPTP_CHECK_EQ(TEST_INDEX(SplitMerges), 5);
+	AMTPTP_CHECK_EQ(TEST_INDEX(Latency) + AMTPTP_PERF_LATENCY_BUCKETS, AMTPTP_PERF_COUNTER_COUNT);
+}
+
+// Bucket n holds [2^(n-1), 2^n) us: the edges of the first buckets and of the
+// open one, on a 10 MHz clock and on a 3 GHz one
+static VOID
+AmtPtpTestLatency(VOID)
+{
+	static const struct {
+		ULONGLONG	Ticks;
+		ULONGLONG	Frequency;
+		ULONG		Bucket;
+	} cases[] = {
+		{ 0,					TEST_QPC_FREQUENCY,	0 },
+		{ 9,					TEST_QPC_FREQUENCY,	0 },	/* 0.9 us */
+		{ 10,					TEST_QPC_FREQUENCY,	1 },
+		{ 19,					TEST_QPC_FREQUENCY,	1 },
+		{ 20,					TEST_QPC_FREQUENCY,	2 },
+		{ 39,					TEST_QPC_FREQUENCY,	2 },
+		{ 40,					TEST_QPC_FREQUENCY,	3 },
+		{ 80000,				TEST_QPC_FREQUENCY,	13 },	/* 8 ms, one MT2 frame */
+		{ 163839,				TEST_QPC_FREQUENCY,	14 },
+		{ 163840,				TEST_QPC_FREQUENCY,	15 },	/* 16.384 ms, the open bucket */
+		{ TEST_QPC_FREQUENCY - 1, TEST_QPC_FREQUENCY, 15 },
+		{ TEST_QPC_FREQUENCY,	TEST_QPC_FREQUENCY,	15 },	/* a second or more */
+		{ ~0ULL,				TEST_QPC_FREQUENCY,	15 },
+		{ 1,					0,					15 },	/* no clock */
+		{ 2999,					3000000000ULL,		0 },
+		{ 3000,					3000000000ULL,		1 },
+		{ 2999999999ULL,		3000000000ULL,		15 },
+	};
+	AMTPTP_PERF_COUNTERS counters;
+	ULONG i, b;
+
+	for (i = 0; i < TEST_SIZES(cases); i++) {
+		AmtPtpPerfCountersInitialize(&counters);
+		AmtPtpPerfCountersRecordLatency(&counters, cases[i].Ticks, cases[i].Frequency);
+		for (b = 0; b < AMTPTP_PERF_LATENCY_BUCKETS; b++) {
+			if (counters.Latency[b] != (b == cases[i].Bucket ? 1 : 0)) {
+				fprintf(stderr, "%llu ticks at %llu Hz: bucket %u is %ld\n", (unsigned long long) cases[i].Ticks,
+					(unsigned long long) cases[i].Frequency, b, (long) counters.Latency[b]);
+				AmtPtpTestFailures++;
+			}
+		}
+		AMTPTP_CHECK_EQ(counters.FramesIn + counters.ReportsOut + counters.Malformed, 0);
+	}
+}
+
+// Counters wrap through the sign bit and past 2^32, readers subtract snapshots
+static VOID
+AmtPtpTestWrap(VOID)
+{
+	AMTPTP_PERF_COUNTERS counters;
+	ULONG before[AMTPTP_PERF_COUNTER_COUNT], after[AMTPTP_PERF_COUNTER_COUNT];
+
+	AmtPtpPerfCountersInitialize(&counters);
+	counters.ReportsOut = 0x7ffffffe;
+	counters.FramesIn = -2;
+	AmtPtpPerfCountersSnapshot(&counters, before);
+
+	AMTPTP_PERF_COUNT(&counters, ReportsOut);
+	AMTPTP_PERF_COUNT(&counters, ReportsOut);
+	AMTPTP_PERF_COUNT(&counters, ReportsOut);
+	AMTPTP_PERF_COUNT(&counters, FramesIn);
+	AMTPTP_PERF_COUNT(&counters, FramesIn);
+	AMTPTP_PERF_COUNT(&counters, FramesIn);
+	AmtPtpPerfCountersSnapshot(&counters, after);
+
+	AMTPTP_CHECK_EQ(after[TEST_INDEX(ReportsOut)], 0x80000001UL);
+	AMTPTP_CHECK_EQ(after[TEST_INDEX(FramesIn)], 1);
+	AMTPTP_CHECK_EQ(after[TEST_INDEX(ReportsOut)] - before[TEST_INDEX(ReportsOut)], 3);
+	AMTPTP_CHECK_EQ(after[TEST_INDEX(FramesIn)] - before[TEST_INDEX(FramesIn)], 3);
+}
+
+// What the input path does per frame
+static void*
+AmtPtpTestWriter(
+	void* Context
+)
+{
+	PAMTPTP_PERF_COUNTERS counters = Context;
+	ULONG i;
+
+	for (i = 0; i < TEST_WRITER_FRAMES; i++) {
+		AMTPTP_PERF_COUNT(counters, FramesIn);
+		AMTPTP_PERF_COUNT(counters, ReportsOut);
+		AmtPtpPerfCountersRecordLatency(counters, i % 200000, TEST_QPC_FREQUENCY);
+	}
+	return NULL;
+}
+
+static VOID
+AmtPtpTestWriters(VOID)
+{
+	AMTPTP_PERF_COUNTERS counters;
+	ULONG values[AMTPTP_PERF_COUNTER_COUNT];
+	pthread_t writers[TEST_WRITERS];
+	ULONG i, latency = 0, started = 0;
+
+	AmtPtpPerfCountersInitialize(&counters);
+	for (i = 0; i < TEST_WRITERS; i++) {
+		if (pthread_create(&writers[i], NULL, AmtPtpTestWriter, &counters) == 0) {
+			started++;
+		}
+	}
+	AMTPTP_CHECK_EQ(started, TEST_WRITERS);
+	for (i = 0; i < started; i++) {
+		pthread_join(writers[i], NULL);
+	}
+
+	AmtPtpPerfCountersSnapshot(&counters, values);
+	AMTPTP_CHECK_EQ(values[TEST_INDEX(FramesIn)], started * TEST_WRITER_FRAMES);
+	AMTPTP_CHECK_EQ(values[TEST_INDEX(ReportsOut)], started * TEST_WRITER_FRAMES);
+	for (i = 0; i < AMTPTP_PERF_LATENCY_BUCKETS; i++) {
+		latency += values[TEST_INDEX(Latency) + i];
+	}
+	AMTPTP_CHECK_EQ(latency, started * TEST_WRITER_FRAMES);
+}
+
+int
+main(VOID)
+{
+	AmtPtpTestLayout();
+	AmtPtpTestLatency();
+	AmtPtpTestWrap();
+	AmtPtpTestWriters();
+
+	return AmtPtpTestExit("AmtPtpPerfCountersTest");
+}
@@ -0,0 +1,273 @@
+// AmtPtpReportRingTest.c: Report ring under bursts, overflow and hybrid scans
+
+#include <AmtPtpTest.h>
+#include <AmtPtpReportRing.h>
+
+#define CONTACTS_PER_REPORT	5
+
+// A frame of Count tip-down contacts, DeviceTime numbers the frames
+static VOID
+AmtPtpTestFrame(
+	_Out_ PAMTPTP_DECODED_FRAME Frame,
+	_In_ ULONG Sequence,
+	_In_ UCHAR Count
+)
+{
+	UCHAR i;
+
+	RtlZeroMemory(Frame, sizeof(AMTPTP_DECODED_FRAME));
+	Frame->DeviceTime = Sequence;
+	Frame->HasDeviceTime = TRUE;
+	Frame->ContactCount = Count;
+	for (i = 0; i < Count; i++) {
+		Frame->Contacts[i].ContactID = i;
+		Frame->Contacts[i].X = (USHORT) (Sequence * 10 + i);
+		Frame->Contacts[i].Y = (USHORT) (Sequence * 20 + i);
+		Frame->Contacts[i].TipSwitch = 1;
+		Frame->Contacts[i].Confidence = 1;
+	}
+}
+
+static VOID
+AmtPtpTestInitialize(VOID)
+{
+	AMTPTP_REPORT_RING ring;
+
+	AmtPtpReportRingInitialize(&ring, 0, AmtPtpRingOverflowCoalesce);
+	AMTPTP_CHECK_EQ(ring.Depth, 1);
+	AmtPtpReportRingInitialize(&ring, 6, AmtPtpRingOverflowCoalesce);
+	AMTPTP_CHECK_EQ(ring.Depth, 4);
+	AmtPtpReportRingInitialize(&ring, 1000, AmtPtpRingOverflowMax);
+	AMTPTP_CHECK_EQ(ring.Depth, AMTPTP_REPORT_RING_MAX_DEPTH);
+	AMTPTP_CHECK_EQ(ring.Policy, AmtPtpRingOverflowDropOldest);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 0);
+}
+
+//
+// The device delivers bursts faster than hidclass reads. With DropOldest the
+// reader sees the frames in order, and the ones it misses are the oldest.
+//
+static VOID
+AmtPtpTestBurstDropOldest(VOID)
+{
+	static AMTPTP_REPORT_RING ring;
+	AMTPTP_DECODED_FRAME frame;
+	ULONG produced = 0, consumed = 0, last = 0, tick, i;
+	ULONG dropped = 0;
+
+	AmtPtpReportRingInitialize(&ring, 8, AmtPtpRingOverflowDropOldest);
+
+	for (tick = 0; tick < 50; tick++) {
+		// Bursts of 1 to 12 frames, then 3 reads
+		for (i = 0; i < 1 + (tick * 7) % 12; i++) {
+			AmtPtpTestFrame(&frame, ++produced, 2);
+			if (AmtPtpReportRingPush(&ring, &frame) == AmtPtpRingPushDroppedOldest) {
+				dropped++;
+			}
+			AMTPTP_CHECK(AmtPtpReportRingCount(&ring) <= ring.Depth);
+		}
+
+		for (i = 0; i < 3 && AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame); i++) {
+			AMTPTP_CHECK(frame.DeviceTime > last);
+			AMTPTP_CHECK_EQ(frame.Contacts[1].X, frame.DeviceTime * 10 + 1);
+			last = frame.DeviceTime;
+			consumed++;
+		}
+	}
+
+	AMTPTP_CHECK(dropped > 0);
+	AMTPTP_CHECK_EQ(ring.Dropped, dropped);
+	AMTPTP_CHECK_EQ(ring.HighWatermark, ring.Depth);
+	AMTPTP_CHECK_EQ(produced, consumed + dropped + AmtPtpReportRingCount(&ring));
+
+	// Once the reader catches up it gets the newest frames, the last one last
+	while (AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame)) {
+		AMTPTP_CHECK(frame.DeviceTime > last);
+		last = frame.DeviceTime;
+	}
+	AMTPTP_CHECK_EQ(last, produced);
+
+	// Flush empties the ring and keeps the statistics
+	AmtPtpTestFrame(&frame, ++produced, 1);
+	AmtPtpReportRingPush(&ring, &frame);
+	AmtPtpReportRingFlush(&ring);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 0);
+	AMTPTP_CHECK(!AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+	AMTPTP_CHECK_EQ(ring.Dropped, dropped);
+}
+
+//
+// With Coalesce, an overflowing frame is merged into the newest parked one:
+// moved contacts take the new position, vanished ones stay as they were.
+//
+static VOID
+AmtPtpTestBurstCoalesce(VOID)
+{
+	static AMTPTP_REPORT_RING ring;
+	AMTPTP_DECODED_FRAME frame;
+	ULONG sequence;
+
+	AmtPtpReportRingInitialize(&ring, 2, AmtPtpRingOverflowCoalesce);
+
+	for (sequence = 1; sequence <= 6; sequence++) {
+		AmtPtpTestFrame(&frame, sequence, 3);
+		AMTPTP_CHECK_EQ(AmtPtpReportRingPush(&ring, &frame),
+			sequence <= 2 ? AmtPtpRingPushQueued : AmtPtpRingPushCoalesced);
+	}
+	AMTPTP_CHECK_EQ(ring.Coalesced, 4);
+	AMTPTP_CHECK_EQ(ring.Dropped, 0);
+
+	// Contact 2 vanishes without a lift-off frame, contact 3 is new
+	AmtPtpTestFrame(&frame, 7, 2);
+	frame.Contacts[1].ContactID = 3;
+	AMTPTP_CHECK_EQ(AmtPtpReportRingPush(&ring, &frame), AmtPtpRingPushCoalesced);
+
+	AMTPTP_CHECK(AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+	AMTPTP_CHECK_EQ(frame.DeviceTime, 1);
+
+	AMTPTP_CHECK(AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+	AMTPTP_CHECK_EQ(frame.DeviceTime, 7);
+	AMTPTP_CHECK_EQ(frame.ContactCount, 4);
+	AMTPTP_CHECK_EQ(frame.Contacts[0].X, 70);
+	AMTPTP_CHECK_EQ(frame.Contacts[1].X, 61);			/* last seen in frame 6 */
+	AMTPTP_CHECK_EQ(frame.Contacts[2].X, 62);
+	AMTPTP_CHECK_EQ(frame.Contacts[3].ContactID, 3);
+	AMTPTP_CHECK_EQ(frame.Contacts[3].X, 71);
+	AMTPTP_CHECK(!AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+}
+
+//
+// A lift-off hidclass has not seen yet is never merged away: a frame that
+// puts the lifted id down again goes into a slot of its own.
+//
+static VOID
+AmtPtpTestCoalesceKeepsLiftOff(VOID)
+{
+	static AMTPTP_REPORT_RING ring;
+	AMTPTP_DECODED_FRAME frame;
+
+	AmtPtpReportRingInitialize(&ring, 1, AmtPtpRingOverflowCoalesce);
+
+	AmtPtpTestFrame(&frame, 1, 1);
+	frame.Contacts[0].TipSwitch = 0;
+	AmtPtpReportRingPush(&ring, &frame);
+
+	AmtPtpTestFrame(&frame, 2, 1);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingPush(&ring, &frame), AmtPtpRingPushDroppedOldest);
+	AMTPTP_CHECK_EQ(ring.Coalesced, 0);
+
+	// A lift-off on top of a touch merges, the lift-off wins
+	AmtPtpTestFrame(&frame, 3, 1);
+	frame.Contacts[0].TipSwitch = 0;
+	AMTPTP_CHECK_EQ(AmtPtpReportRingPush(&ring, &frame), AmtPtpRingPushCoalesced);
+	AMTPTP_CHECK(AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+	AMTPTP_CHECK_EQ(frame.Contacts[0].TipSwitch, 0);
+
+	// 16 contacts plus one more cannot be merged either
+	AmtPtpTestFrame(&frame, 4, AMTPTP_DECODER_MAX_CONTACTS);
+	AmtPtpReportRingPush(&ring, &frame);
+	AmtPtpTestFrame(&frame, 5, 1);
+	frame.Contacts[0].ContactID = AMTPTP_DECODER_MAX_CONTACTS;
+	AMTPTP_CHECK_EQ(AmtPtpReportRingPush(&ring, &frame), AmtPtpRingPushDroppedOldest);
+}
+
+//
+// A scan with more contacts than a report goes out in steps: the first report
+// straight to the pending read, the rest from the ring, ahead of newer frames.
+//
+static VOID
+AmtPtpTestHybrid(VOID)
+{
+	static AMTPTP_REPORT_RING ring;
+	AMTPTP_DECODED_FRAME frame, next;
+
+	AmtPtpReportRingInitialize(&ring, 4, AmtPtpRingOverflowCoalesce);
+
+	AmtPtpTestFrame(&frame, 1, 12);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingPushRemainder(&ring, &frame, CONTACTS_PER_REPORT), AmtPtpRingPushQueued);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 1);
+
+	// A frame that arrives meanwhile waits for the whole scan
+	AmtPtpTestFrame(&next, 2, 2);
+	AmtPtpReportRingPush(&ring, &next);
+
+	AMTPTP_CHECK(AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+	AMTPTP_CHECK_EQ(frame.DeviceTime, 1);
+	AMTPTP_CHECK_EQ(frame.FirstContact, 5);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 2);
+
+	AMTPTP_CHECK(AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+	AMTPTP_CHECK_EQ(frame.DeviceTime, 1);
+	AMTPTP_CHECK_EQ(frame.FirstContact, 10);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 1);
+
+	AMTPTP_CHECK(AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+	AMTPTP_CHECK_EQ(frame.DeviceTime, 2);
+	AMTPTP_CHECK_EQ(frame.FirstContact, 0);
+	AMTPTP_CHECK(!AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+
+	// Exactly two reports: the remainder is one step
+	AmtPtpTestFrame(&frame, 3, 10);
+	AmtPtpReportRingPushRemainder(&ring, &frame, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK(AmtPtpReportRingPop(&ring, CONTACTS_PER_REPORT, &frame));
+	AMTPTP_CHECK_EQ(frame.FirstContact, 5);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 0);
+
+	// Part of a scan that went out is never merged with a newer one
+	AmtPtpReportRingInitialize(&ring, 1, AmtPtpRingOverflowCoalesce);
+	AmtPtpTestFrame(&frame, 4, 8);
+	AmtPtpReportRingPushRemainder(&ring, &frame, CONTACTS_PER_REPORT);
+	AmtPtpTestFrame(&frame, 5, 2);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingPush(&ring, &frame), AmtPtpRingPushDroppedOldest);
+}
+
+//
+// A read that fails to take its report leaves it parked for the next read.
+//
+static VOID
+AmtPtpTestPeekAdvance(VOID)
+{
+	static AMTPTP_REPORT_RING ring;
+	AMTPTP_DECODED_FRAME frame;
+
+	AmtPtpReportRingInitialize(&ring, 4, AmtPtpRingOverflowDropOldest);
+	AMTPTP_CHECK(!AmtPtpReportRingPeek(&ring, &frame));
+	AmtPtpReportRingAdvance(&ring, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 0);
+
+	AmtPtpTestFrame(&frame, 1, 7);
+	AmtPtpReportRingPush(&ring, &frame);
+	AmtPtpTestFrame(&frame, 2, 1);
+	AmtPtpReportRingPush(&ring, &frame);
+
+	AMTPTP_CHECK(AmtPtpReportRingPeek(&ring, &frame));
+	AMTPTP_CHECK(AmtPtpReportRingPeek(&ring, &frame));
+	AMTPTP_CHECK_EQ(frame.DeviceTime, 1);
+	AMTPTP_CHECK_EQ(frame.FirstContact, 0);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 2);
+
+	AmtPtpReportRingAdvance(&ring, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK(AmtPtpReportRingPeek(&ring, &frame));
+	AMTPTP_CHECK_EQ(frame.DeviceTime, 1);
+	AMTPTP_CHECK_EQ(frame.FirstContact, 5);
+
+	AmtPtpReportRingAdvance(&ring, CONTACTS_PER_REPORT);
+	AMTPTP_CHECK(AmtPtpReportRingPeek(&ring, &frame));
+	AMTPTP_CHECK_EQ(frame.DeviceTime, 2);
+
+	// 0 contacts per report takes the whole scan at once
+	AmtPtpReportRingAdvance(&ring, 0);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&ring), 0);
+}
+
+int
+main(VOID)
+{
+	AmtPtpTestInitialize();
+	AmtPtpTestBurstDropOldest();
+	AmtPtpTestBurstCoalesce();
+	AmtPtpTestCoalesceKeepsLiftOff();
+	AmtPtpTestHybrid();
+	AmtPtpTestPeekAdvance();
+	return AmtPtpTestExit("AmtPtpReportRingTest");
+}
@@ -0,0 +1,236 @@
+// AmtPtpScanClockTest.c: ScanTime across wraps, device clock resets and jitter
+//
+// A virtual device sends a frame every Interval ms of its own clock. The host
+// sees each one late by a different amount, so host time jitters while the
+// device clock does not.
+
+#include <AmtPtpTest.h>
+#include <AmtPtpScanClock.h>
+
+#define MT2_DEVICE_MASK			0x1FFFFF	/* 21-bit ms counter */
+#define WELLSPRING_DEVICE_MASK	0xFF		/* 8-bit ms counter */
+#define HOST_MS					10000ull	/* 100ns units */
+
+typedef struct _AMTPTP_TEST_DEVICE {
+	AMTPTP_SCAN_CLOCK	Clock;
+	ULONG				Mask;
+	ULONG				DeviceTime;		/* ms, before masking */
+	ULONGLONG			HostTime;		/* when the device sent the frame, 100ns */
+	ULONG				Seed;
+	ULONG				Jitter;			/* largest delivery delay, 100ns */
+} AMTPTP_TEST_DEVICE, *PAMTPTP_TEST_DEVICE;
+
+static VOID
+AmtPtpTestDeviceInit(
+	_Out_ PAMTPTP_TEST_DEVICE Device,
+	_In_ ULONG Mask,
+	_In_ ULONG ClockMask,
+	_In_ ULONG Jitter
+)
+{
+	RtlZeroMemory(Device, sizeof(AMTPTP_TEST_DEVICE));
+	AmtPtpScanClockInitialize(&Device->Clock, ClockMask);
+	Device->Mask = Mask;
+	Device->DeviceTime = 12345;
+	Device->HostTime = 1000 * HOST_MS;
+	Device->Seed = 1;
+	Device->Jitter = Jitter;
+}
+
+// Advances both clocks by Ms and returns the ScanTime of the frame sent then
+static USHORT
+AmtPtpTestDeviceFrame(
+	_Inout_ PAMTPTP_TEST_DEVICE Device,
+	_In_ ULONG Ms,
+	_In_ BOOLEAN HasDeviceTime
+)
+{
+	AMTPTP_DECODED_FRAME frame;
+	ULONGLONG delay = 0;
+
+	Device->DeviceTime += Ms;
+	Device->HostTime += Ms * HOST_MS;
+	if (Device->Jitter != 0) {
+		Device->Seed = Device->Seed * 1103515245 + 12345;
+		delay = (Device->Seed >> 8) % Device->Jitter;
+	}
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	frame.HasDeviceTime = HasDeviceTime;
+	frame.DeviceTime = Device->DeviceTime & Device->Mask;
+	AmtPtpScanClockUpdate(&Device->Clock, &frame, Device->HostTime + delay);
+	AMTPTP_CHECK_EQ(frame.ScanTime, Device->Clock.ScanTime);
+	return frame.ScanTime;
+}
+
+//
+// The device clock sets the pace whatever the delivery jitter, across many
+// wraps of both its own counter and the 16-bit ScanTime
+//
+static VOID
+AmtPtpTestWrap(
+	_In_ ULONG Mask,
+	_In_ ULONG Interval,
+	_In_ ULONG Frames
+)
+{
+	AMTPTP_TEST_DEVICE device;
+	USHORT last, scanTime;
+	ULONG i, scanWraps = 0;
+
+	// Delivery up to 5 ms late, a fraction of the frame interval
+	AmtPtpTestDeviceInit(&device, Mask, Mask, 5 * HOST_MS);
+	last = AmtPtpTestDeviceFrame(&device, Interval, TRUE);
+
+	for (i = 0; i < Frames; i++) {
+		scanTime = AmtPtpTestDeviceFrame(&device, Interval, TRUE);
+		AMTPTP_CHECK_EQ((USHORT) (scanTime - last), Interval * AMTPTP_SCAN_CLOCK_TICKS_PER_MS);
+		scanWraps += scanTime < last;
+		last = scanTime;
+	}
+
+	AMTPTP_CHECK(scanWraps > 0);
+	AMTPTP_CHECK_EQ(device.Clock.Resyncs, 0);
+}
+
+//
+// After D0 exit the device counter starts over. With AmtPtpScanClockReset
+// the next frame is timed by the host; without it the counters disagree and
+// the clock resyncs on its own. ScanTime moves forward either way.
+//
+static VOID
+AmtPtpTestReset(VOID)
+{
+	AMTPTP_TEST_DEVICE device;
+	USHORT last, scanTime;
+
+	AmtPtpTestDeviceInit(&device, MT2_DEVICE_MASK, MT2_DEVICE_MASK, 0);
+	AmtPtpTestDeviceFrame(&device, 11, TRUE);
+	last = AmtPtpTestDeviceFrame(&device, 11, TRUE);
+
+	// 2 s in D3, the device counter restarts near 0
+	AmtPtpScanClockReset(&device.Clock);
+	device.DeviceTime = 3;
+	scanTime = AmtPtpTestDeviceFrame(&device, 2000, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (scanTime - last), 2000 * AMTPTP_SCAN_CLOCK_TICKS_PER_MS);
+	AMTPTP_CHECK_EQ(device.Clock.Resyncs, 0);
+
+	last = AmtPtpTestDeviceFrame(&device, 11, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (last - scanTime), 110);
+
+	// A reset the driver never heard of: the device jumps back 5 s
+	device.DeviceTime -= 5000;
+	scanTime = AmtPtpTestDeviceFrame(&device, 11, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (scanTime - last), 110);
+	AMTPTP_CHECK_EQ(device.Clock.Resyncs, 1);
+
+	// From there the device clock is trusted again
+	last = scanTime;
+	scanTime = AmtPtpTestDeviceFrame(&device, 11, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (scanTime - last), 110);
+	AMTPTP_CHECK_EQ(device.Clock.Resyncs, 1);
+
+	// Reset keeps ScanTime counting, it only drops the device time
+	AmtPtpScanClockReset(&device.Clock);
+	AMTPTP_CHECK_EQ(device.Clock.ScanTime, scanTime);
+}
+
+//
+// A gap past one wrap of the device counter cannot be told from a shorter
+// one, so the host times it. So does a device clock that drifts too far.
+//
+static VOID
+AmtPtpTestAmbiguous(VOID)
+{
+	AMTPTP_TEST_DEVICE device;
+	USHORT last, scanTime;
+
+	AmtPtpTestDeviceInit(&device, WELLSPRING_DEVICE_MASK, WELLSPRING_DEVICE_MASK, 0);
+	last = AmtPtpTestDeviceFrame(&device, 8, TRUE);
+
+	// 1 s idle is almost four wraps of the 8-bit counter
+	scanTime = AmtPtpTestDeviceFrame(&device, 1000, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (scanTime - last), 10000);
+	AMTPTP_CHECK_EQ(device.Clock.Resyncs, 1);
+
+	// Just under a wrap with host and device in step is still device time
+	last = scanTime;
+	scanTime = AmtPtpTestDeviceFrame(&device, 200, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (scanTime - last), 2000);
+	AMTPTP_CHECK_EQ(device.Clock.Resyncs, 1);
+
+	// The device sends 8 ms frames the host sees 60 ms apart
+	last = scanTime;
+	device.DeviceTime -= 52;
+	scanTime = AmtPtpTestDeviceFrame(&device, 60, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (scanTime - last), 600);
+	AMTPTP_CHECK_EQ(device.Clock.Resyncs, 2);
+
+	// Within the slack the device is trusted
+	last = scanTime;
+	device.DeviceTime -= 40;
+	scanTime = AmtPtpTestDeviceFrame(&device, 48, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (scanTime - last), 80);
+	AMTPTP_CHECK_EQ(device.Clock.Resyncs, 2);
+}
+
+//
+// Without a device clock ScanTime comes from host time, in 100us units. Each
+// step drops what is left of a unit, and none goes backwards.
+//
+static VOID
+AmtPtpTestHostTime(VOID)
+{
+	AMTPTP_TEST_DEVICE device;
+	AMTPTP_DECODED_FRAME frame;
+	USHORT last, scanTime;
+	ULONGLONG host;
+	ULONG i, step, total = 0;
+
+	// Host only by configuration, the frames carry a device time all the same
+	AmtPtpTestDeviceInit(&device, MT2_DEVICE_MASK, 0, 0);
+	last = AmtPtpTestDeviceFrame(&device, 11, TRUE);
+	scanTime = AmtPtpTestDeviceFrame(&device, 11, TRUE);
+	AMTPTP_CHECK_EQ((USHORT) (scanTime - last), 110);
+
+	// Frames without device time, delivered up to 3 ms late
+	AmtPtpTestDeviceInit(&device, MT2_DEVICE_MASK, MT2_DEVICE_MASK, 3 * HOST_MS);
+	last = AmtPtpTestDeviceFrame(&device, 11, FALSE);
+	host = device.Clock.LastHostTime;
+	for (i = 0; i < 1000; i++) {
+		scanTime = AmtPtpTestDeviceFrame(&device, 11, FALSE);
+		step = (USHORT) (scanTime - last);
+		AMTPTP_CHECK_EQ(step, (device.Clock.LastHostTime - host) / 1000);
+		total += step;
+		host = device.Clock.LastHostTime;
+		last = scanTime;
+	}
+
+	// Truncation loses less than a unit a frame, jitter moves the ends 30
+	AMTPTP_CHECK(total <= 1000 * 110 + 30);
+	AMTPTP_CHECK(total + 1000 + 30 >= 1000 * 110);
+
+	// The first frame has nothing to measure from; a host clock that does
+	// not move, or moves back, adds nothing
+	AmtPtpScanClockInitialize(&device.Clock, 0);
+	RtlZeroMemory(&frame, sizeof(frame));
+	AmtPtpScanClockUpdate(&device.Clock, &frame, 500 * HOST_MS);
+	AMTPTP_CHECK_EQ(frame.ScanTime, 0);
+	AmtPtpScanClockUpdate(&device.Clock, &frame, 500 * HOST_MS);
+	AMTPTP_CHECK_EQ(frame.ScanTime, 0);
+	AmtPtpScanClockUpdate(&device.Clock, &frame, 400 * HOST_MS);
+	AMTPTP_CHECK_EQ(frame.ScanTime, 0);
+	AmtPtpScanClockUpdate(&device.Clock, &frame, 410 * HOST_MS);
+	AMTPTP_CHECK_EQ(frame.ScanTime, 100);
+}
+
+int
+main(VOID)
+{
+	AmtPtpTestWrap(MT2_DEVICE_MASK, 11, 10000);
+	AmtPtpTestWrap(WELLSPRING_DEVICE_MASK, 8, 10000);
+	AmtPtpTestReset();
+	AmtPtpTestAmbiguous();
+	AmtPtpTestHostTime();
+	return AmtPtpTestExit("AmtPtpScanClockTest");
+}
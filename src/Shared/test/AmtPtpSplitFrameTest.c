@@ -0,0 +1,397 @@
+// AmtPtpSplitFrameTest.c: Split Bluetooth frames, captured and synthetic
+//
+// Usage: AmtPtpSplitFrameTest <mt2-bluetooth-mixed.cap>
+//
+// The capture's crowded frames come as report 0xFC followed by report 0xFE.
+// They are joined here the way the filter joins them, report ID stripped,
+// and then decoded. The synthetic cases cover what the capture does not:
+// halves out of order, lost, late, truncated or too long.
+
+#include <string.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpCapture.h>
+#include <AmtPtpSplitFrame.h>
+
+#define SPLIT_TIMEOUT		(50 * 10000)	/* PTP_SPLIT_FRAME_TIMEOUT of the filter */
+#define SPLIT_MAX_PAIRS		64
+
+typedef struct _AMTPTP_TEST_PAIR {
+	const AMTPTP_CAPTURE_FRAME* First;
+	const AMTPTP_CAPTURE_FRAME* Second;
+} AMTPTP_TEST_PAIR;
+
+static ULONG AmtPtpTestSeed = 1;
+
+static ULONG
+AmtPtpTestRandom(VOID)
+{
+	AmtPtpTestSeed = AmtPtpTestSeed * 1103515245 + 12345;
+	return (AmtPtpTestSeed >> 16) | (AmtPtpTestSeed << 16);
+}
+
+static AMTPTP_SPLIT_RESULT
+AmtPtpTestFirst(
+	_Inout_ PAMTPTP_SPLIT_FRAME Split,
+	_In_ const AMTPTP_CAPTURE_FRAME* Frame,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG Now
+)
+{
+	return AmtPtpSplitFrameFirst(Split, Frame->Data + 1, Length - 1, Now);
+}
+
+static AMTPTP_SPLIT_RESULT
+AmtPtpTestSecond(
+	_Inout_ PAMTPTP_SPLIT_FRAME Split,
+	_In_ const AMTPTP_CAPTURE_FRAME* Frame,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG Now,
+	_Out_ const UCHAR** Joined,
+	_Out_ SIZE_T* JoinedLength
+)
+{
+	return AmtPtpSplitFrameSecond(Split, Frame->Data + 1, Length - 1, Now, Joined, JoinedLength);
+}
+
+// The halves of a pair, concatenated without their report IDs
+static BOOLEAN
+AmtPtpTestJoined(
+	_In_ const AMTPTP_TEST_PAIR* Pair,
+	_In_reads_bytes_(Length) const UCHAR* Frame,
+	_In_ SIZE_T Length
+)
+{
+	SIZE_T firstLength = Pair->First->Length - 1;
+
+	return Length == firstLength + Pair->Second->Length - 1 &&
+		memcmp(Frame, Pair->First->Data + 1, firstLength) == 0 &&
+		memcmp(Frame + firstLength, Pair->Second->Data + 1, Pair->Second->Length - 1) == 0;
+}
+
+static ULONG
+AmtPtpTestFindPairs(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_Out_writes_(SPLIT_MAX_PAIRS) AMTPTP_TEST_PAIR* Pairs
+)
+{
+	ULONG i, count = 0;
+
+	for (i = 0; i + 1 < Capture->FrameCount && count < SPLIT_MAX_PAIRS; i++) {
+		if (Capture->Frames[i].Length > 1 && Capture->Frames[i].Data[0] == 0xFC &&
+			Capture->Frames[i + 1].Length > 1 && Capture->Frames[i + 1].Data[0] == 0xFE) {
+			Pairs[count].First = &Capture->Frames[i];
+			Pairs[count].Second = &Capture->Frames[i + 1];
+			count++;
+		}
+	}
+
+	return count;
+}
+
+//
+// Every captured pair joins within the timeout into a report 0x31 that
+// decodes to the crowd of fingers that made the device split it
+//
+static VOID
+AmtPtpTestCaptured(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_In_reads_(PairCount) const AMTPTP_TEST_PAIR* Pairs,
+	_In_ ULONG PairCount
+)
+{
+	static AMTPTP_SPLIT_FRAME split;
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_DECODED_FRAME decoded;
+	const UCHAR* frame;
+	SIZE_T frameLength;
+	ULONG i;
+
+	AmtPtpCaptureInitDecoderConfig(Capture, &config);
+	AmtPtpSplitFrameInitialize(&split, SPLIT_TIMEOUT);
+
+	for (i = 0; i < PairCount; i++) {
+		AMTPTP_CHECK_EQ(AmtPtpTestFirst(&split, Pairs[i].First, Pairs[i].First->Length, Pairs[i].First->HostTime),
+			AmtPtpSplitPending);
+		AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pairs[i].Second, Pairs[i].Second->Length, Pairs[i].Second->HostTime,
+			&frame, &frameLength), AmtPtpSplitComplete);
+		if (frame == NULL) {
+			continue;
+		}
+
+		AMTPTP_CHECK(AmtPtpTestJoined(&Pairs[i], frame, frameLength));
+		AMTPTP_CHECK_EQ(frame[0], 0x31);
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, frame, frameLength, &decoded), AmtPtpDecodeOk);
+		AMTPTP_CHECK(decoded.ContactCount >= 10);
+	}
+
+	AMTPTP_CHECK_EQ(split.Completed, PairCount);
+	AMTPTP_CHECK_EQ(split.Orphaned + split.Expired + split.Abandoned + split.Overflowed, 0);
+}
+
+//
+// A second half before its first is an orphan. A first half followed by
+// another first half is abandoned, and the second half that follows joins
+// the newer one.
+//
+static VOID
+AmtPtpTestOutOfOrder(
+	_In_reads_(2) const AMTPTP_TEST_PAIR* Pairs
+)
+{
+	static AMTPTP_SPLIT_FRAME split;
+	const AMTPTP_TEST_PAIR* a = &Pairs[0];
+	const AMTPTP_TEST_PAIR* b = &Pairs[1];
+	const UCHAR* frame;
+	SIZE_T frameLength;
+
+	AmtPtpSplitFrameInitialize(&split, SPLIT_TIMEOUT);
+
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, a->Second, a->Second->Length, 0, &frame, &frameLength), AmtPtpSplitOrphan);
+	AMTPTP_CHECK(frame == NULL);
+	AMTPTP_CHECK_EQ(frameLength, 0);
+	AMTPTP_CHECK_EQ(AmtPtpTestFirst(&split, a->First, a->First->Length, 0), AmtPtpSplitPending);
+	AMTPTP_CHECK_EQ(AmtPtpTestFirst(&split, b->First, b->First->Length, 10), AmtPtpSplitPending);
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, b->Second, b->Second->Length, 20, &frame, &frameLength),
+		AmtPtpSplitComplete);
+	AMTPTP_CHECK(frame != NULL && AmtPtpTestJoined(b, frame, frameLength));
+
+	// The halves swapped: the second half is an orphan, the first half waits
+	// and is abandoned by the next frame's first half
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, a->Second, a->Second->Length, 30, &frame, &frameLength), AmtPtpSplitOrphan);
+	AMTPTP_CHECK_EQ(AmtPtpTestFirst(&split, a->First, a->First->Length, 40), AmtPtpSplitPending);
+	AMTPTP_CHECK_EQ(AmtPtpTestFirst(&split, b->First, b->First->Length, 50), AmtPtpSplitPending);
+
+	// A second half used up the staged one, whatever it came with
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, b->Second, b->Second->Length, 60, &frame, &frameLength),
+		AmtPtpSplitComplete);
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, b->Second, b->Second->Length, 70, &frame, &frameLength),
+		AmtPtpSplitOrphan);
+
+	AMTPTP_CHECK_EQ(split.Completed, 2);
+	AMTPTP_CHECK_EQ(split.Orphaned, 3);
+	AMTPTP_CHECK_EQ(split.Abandoned, 2);
+	AMTPTP_CHECK_EQ(split.Expired, 0);
+}
+
+// A second half later than the timeout drops both, so does a clock going back
+static VOID
+AmtPtpTestTimeout(
+	_In_ const AMTPTP_TEST_PAIR* Pair
+)
+{
+	static AMTPTP_SPLIT_FRAME split;
+	const UCHAR* frame;
+	SIZE_T frameLength;
+	ULONGLONG now = 1000 * 10000;
+
+	AmtPtpSplitFrameInitialize(&split, SPLIT_TIMEOUT);
+
+	AmtPtpTestFirst(&split, Pair->First, Pair->First->Length, now);
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length, now + SPLIT_TIMEOUT, &frame, &frameLength),
+		AmtPtpSplitComplete);
+
+	AmtPtpTestFirst(&split, Pair->First, Pair->First->Length, now);
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length, now + SPLIT_TIMEOUT + 1, &frame, &frameLength),
+		AmtPtpSplitExpired);
+	AMTPTP_CHECK(frame == NULL);
+
+	AmtPtpTestFirst(&split, Pair->First, Pair->First->Length, now);
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length, now - 1, &frame, &frameLength),
+		AmtPtpSplitExpired);
+
+	// Nothing is left staged after an expired pair
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length, now, &frame, &frameLength),
+		AmtPtpSplitOrphan);
+
+	// Reset drops a staged half without counting it
+	AmtPtpTestFirst(&split, Pair->First, Pair->First->Length, now);
+	AmtPtpSplitFrameReset(&split);
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length, now, &frame, &frameLength),
+		AmtPtpSplitOrphan);
+
+	AMTPTP_CHECK_EQ(split.Completed, 1);
+	AMTPTP_CHECK_EQ(split.Expired, 2);
+	AMTPTP_CHECK_EQ(split.Orphaned, 2);
+	AMTPTP_CHECK_EQ(split.Abandoned, 0);
+}
+
+//
+// Reassembly does not look inside the halves: a truncated half joins into a
+// frame the decoder has to reject. A cut on a finger boundary is a frame
+// with fewer fingers and cannot be told apart.
+//
+static VOID
+AmtPtpTestTruncated(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_In_ const AMTPTP_TEST_PAIR* Pair
+)
+{
+	static AMTPTP_SPLIT_FRAME split;
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_DECODED_FRAME decoded;
+	const UCHAR* frame;
+	SIZE_T frameLength, cut;
+
+	AmtPtpCaptureInitDecoderConfig(Capture, &config);
+	AmtPtpSplitFrameInitialize(&split, SPLIT_TIMEOUT);
+
+	for (cut = 1; cut < AMTPTP_MT2_FINGER_SIZE; cut++) {
+		AmtPtpTestFirst(&split, Pair->First, Pair->First->Length, 0);
+		AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length - cut, 0, &frame, &frameLength),
+			AmtPtpSplitComplete);
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, frame, frameLength, &decoded), AmtPtpDecodeMalformed);
+
+		AmtPtpTestFirst(&split, Pair->First, Pair->First->Length - cut, 0);
+		AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length, 0, &frame, &frameLength),
+			AmtPtpSplitComplete);
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, frame, frameLength, &decoded), AmtPtpDecodeMalformed);
+	}
+
+	AmtPtpTestFirst(&split, Pair->First, Pair->First->Length, 0);
+	AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length - AMTPTP_MT2_FINGER_SIZE, 0, &frame, &frameLength);
+	AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, frame, frameLength, &decoded), AmtPtpDecodeOk);
+
+	// Only the report ID came, there is nothing to stage
+	AMTPTP_CHECK_EQ(AmtPtpTestFirst(&split, Pair->First, 1, 0), AmtPtpSplitOverflow);
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, Pair->Second->Length, 0, &frame, &frameLength),
+		AmtPtpSplitOrphan);
+
+	// An empty second half returns the first half as it is
+	AmtPtpTestFirst(&split, Pair->First, Pair->First->Length, 0);
+	AMTPTP_CHECK_EQ(AmtPtpTestSecond(&split, Pair->Second, 1, 0, &frame, &frameLength), AmtPtpSplitComplete);
+	AMTPTP_CHECK_EQ(frameLength, Pair->First->Length - 1);
+}
+
+// Halves that together do not fit the staging buffer are dropped
+static VOID
+AmtPtpTestOverflow(VOID)
+{
+	static AMTPTP_SPLIT_FRAME split;
+	static UCHAR half[AMTPTP_SPLIT_FRAME_MAX_SIZE + 1];
+	const UCHAR* frame;
+	SIZE_T frameLength;
+
+	AmtPtpSplitFrameInitialize(&split, SPLIT_TIMEOUT);
+	memset(half, 0x5A, sizeof(half));
+
+	AMTPTP_CHECK_EQ(AmtPtpSplitFrameFirst(&split, half, AMTPTP_SPLIT_FRAME_MAX_SIZE, 0), AmtPtpSplitOverflow);
+	AMTPTP_CHECK_EQ(AmtPtpSplitFrameFirst(&split, half, 0, 0), AmtPtpSplitOverflow);
+
+	AMTPTP_CHECK_EQ(AmtPtpSplitFrameFirst(&split, half, AMTPTP_SPLIT_FRAME_MAX_SIZE - 1, 0), AmtPtpSplitPending);
+	AMTPTP_CHECK_EQ(AmtPtpSplitFrameSecond(&split, half, 1, 0, &frame, &frameLength), AmtPtpSplitComplete);
+	AMTPTP_CHECK_EQ(frameLength, AMTPTP_SPLIT_FRAME_MAX_SIZE);
+
+	AMTPTP_CHECK_EQ(AmtPtpSplitFrameFirst(&split, half, AMTPTP_SPLIT_FRAME_MAX_SIZE - 1, 0), AmtPtpSplitPending);
+	AMTPTP_CHECK_EQ(AmtPtpSplitFrameSecond(&split, half, 2, 0, &frame, &frameLength), AmtPtpSplitOverflow);
+	AMTPTP_CHECK(frame == NULL);
+
+	AMTPTP_CHECK_EQ(AmtPtpSplitFrameFirst(&split, half, 1, 0), AmtPtpSplitPending);
+	AMTPTP_CHECK_EQ(AmtPtpSplitFrameSecond(&split, half, (SIZE_T) -1, 0, &frame, &frameLength), AmtPtpSplitOverflow);
+
+	AMTPTP_CHECK_EQ(split.Overflowed, 4);
+	AMTPTP_CHECK_EQ(split.Completed, 1);
+}
+
+//
+// Random halves in random order against a model of the staging buffer: a
+// joined frame is always the last staged first half followed by the second
+// half, and the counters match the model's
+//
+static VOID
+AmtPtpTestFuzz(VOID)
+{
+	static AMTPTP_SPLIT_FRAME split;
+	static UCHAR half[AMTPTP_SPLIT_FRAME_MAX_SIZE + 16];
+	static UCHAR staged[AMTPTP_SPLIT_FRAME_MAX_SIZE];
+	SIZE_T stagedLength = 0, length, frameLength, i;
+	ULONGLONG now = 0, stagedTime = 0;
+	ULONG iteration, completed = 0, orphaned = 0, expired = 0, abandoned = 0, overflowed = 0;
+	AMTPTP_SPLIT_RESULT result;
+	const UCHAR* frame;
+
+	AmtPtpSplitFrameInitialize(&split, SPLIT_TIMEOUT);
+
+	for (iteration = 0; iteration < 200000; iteration++) {
+		length = AmtPtpTestRandom() % sizeof(half);
+		for (i = 0; i < length; i++) {
+			half[i] = (UCHAR) AmtPtpTestRandom();
+		}
+		now += AmtPtpTestRandom() % (SPLIT_TIMEOUT + SPLIT_TIMEOUT / 4);
+
+		if (AmtPtpTestRandom() % 2 == 0) {
+			result = AmtPtpSplitFrameFirst(&split, half, length, now);
+			abandoned += (stagedLength != 0);
+			if (length == 0 || length >= AMTPTP_SPLIT_FRAME_MAX_SIZE) {
+				AMTPTP_CHECK_EQ(result, AmtPtpSplitOverflow);
+				overflowed++;
+				stagedLength = 0;
+			} else {
+				AMTPTP_CHECK_EQ(result, AmtPtpSplitPending);
+				memcpy(staged, half, length);
+				stagedLength = length;
+				stagedTime = now;
+			}
+			continue;
+		}
+
+		result = AmtPtpSplitFrameSecond(&split, half, length, now, &frame, &frameLength);
+		if (stagedLength == 0) {
+			AMTPTP_CHECK_EQ(result, AmtPtpSplitOrphan);
+			orphaned++;
+		} else if (now - stagedTime > SPLIT_TIMEOUT) {
+			AMTPTP_CHECK_EQ(result, AmtPtpSplitExpired);
+			expired++;
+		} else if (stagedLength + length > AMTPTP_SPLIT_FRAME_MAX_SIZE) {
+			AMTPTP_CHECK_EQ(result, AmtPtpSplitOverflow);
+			overflowed++;
+		} else {
+			AMTPTP_CHECK_EQ(result, AmtPtpSplitComplete);
+			completed++;
+			AMTPTP_CHECK_EQ(frameLength, stagedLength + length);
+			AMTPTP_CHECK(memcmp(frame, staged, stagedLength) == 0);
+			AMTPTP_CHECK(memcmp(frame + stagedLength, half, length) == 0);
+		}
+		if (result != AmtPtpSplitComplete) {
+			AMTPTP_CHECK(frame == NULL);
+		}
+		stagedLength = 0;
+	}
+
+	AMTPTP_CHECK_EQ(split.Completed, completed);
+	AMTPTP_CHECK_EQ(split.Orphaned, orphaned);
+	AMTPTP_CHECK_EQ(split.Expired, expired);
+	AMTPTP_CHECK_EQ(split.Abandoned, abandoned);
+	AMTPTP_CHECK_EQ(split.Overflowed, overflowed);
+	AMTPTP_CHECK(completed > 0 && orphaned > 0 && expired > 0 && abandoned > 0 && overflowed > 0);
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	AMTPTP_CAPTURE capture;
+	AMTPTP_TEST_PAIR pairs[SPLIT_MAX_PAIRS];
+	ULONG pairCount;
+
+	AmtPtpTestOverflow();
+	AmtPtpTestFuzz();
+
+	if (argc < 2 || !AmtPtpCaptureLoad(argv[1], &capture)) {
+		AMTPTP_CHECK(argc >= 2);
+		return AmtPtpTestExit("AmtPtpSplitFrameTest");
+	}
+
+	pairCount = AmtPtpTestFindPairs(&capture, pairs);
+	AMTPTP_CHECK(pairCount >= 2);
+	if (pairCount >= 2) {
+		AmtPtpTestCaptured(&capture, pairs, pairCount);
+		AmtPtpTestOutOfOrder(pairs);
+		AmtPtpTestTimeout(&pairs[0]);
+		AmtPtpTestTruncated(&capture, &pairs[0]);
+	}
+
+	AmtPtpCaptureFree(&capture);
+	return AmtPtpTestExit("AmtPtpSplitFrameTest");
+}
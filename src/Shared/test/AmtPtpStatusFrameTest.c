@@ -0,0 +1,89 @@
+// AmtPtpStatusFrameTest.c: What each MT2 status frame keeps and asks for
+//
+// Frames as the trackpad sends them on the touch pipe, report id first. A
+// frame too short for its payload leaves the cache as it was.
+
+#include <AmtPtpTest.h>
+#include <AmtPtpStatusFrame.h>
+
+static VOID
+AmtPtpTestRecord(
+	_Inout_ PAMTPTP_STATUS_CACHE Cache,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_ AMTPTP_STATUS_ACTION Expected
+)
+{
+	AMTPTP_CHECK_EQ(AmtPtpStatusFrameRecord(Cache, Buffer, Length), Expected);
+}
+
+//
+// Battery level: kept for the feature report. It also comes right after the
+// trackpad powered on or reset, in mouse mode, so the mode is set again.
+//
+static VOID
+AmtPtpTestBattery(VOID)
+{
+	static const UCHAR battery[] = { AMTPTP_STATUS_BATTERY, 0x04, 87 };
+	static const UCHAR powerOn[] = { AMTPTP_STATUS_BATTERY, 0x00, 100 };
+	AMTPTP_STATUS_CACHE cache;
+
+	AmtPtpStatusCacheInitialize(&cache);
+	AMTPTP_CHECK(!cache.BatteryValid);
+
+	AmtPtpTestRecord(&cache, battery, sizeof(battery), AmtPtpStatusRearm);
+	AMTPTP_CHECK(cache.BatteryValid);
+	AMTPTP_CHECK_EQ(cache.BatteryFlags, 0x04);
+	AMTPTP_CHECK_EQ(cache.BatteryLevel, 87);
+
+	AmtPtpTestRecord(&cache, powerOn, sizeof(powerOn), AmtPtpStatusRearm);
+	AMTPTP_CHECK_EQ(cache.BatteryLevel, 100);
+	AMTPTP_CHECK_EQ(cache.Battery, 2);
+
+	// Truncated, the last level stands and nothing is re-armed
+	AmtPtpTestRecord(&cache, battery, 2, AmtPtpStatusTruncated);
+	AMTPTP_CHECK_EQ(cache.BatteryLevel, 100);
+	AMTPTP_CHECK_EQ(cache.Battery, 2);
+	AMTPTP_CHECK_EQ(cache.Truncated, 1);
+}
+
+static VOID
+AmtPtpTestOthers(VOID)
+{
+	static const UCHAR mouse[] = { AMTPTP_STATUS_MOUSE, 0x00, 0x00, 0x00 };
+	static const UCHAR powerDown[] = { AMTPTP_STATUS_POWER_DOWN, 0x12, 0x34 };
+	static const UCHAR unknown[] = { AMTPTP_STATUS_UNKNOWN, 0x01, 0x02, 0x03 };
+	static const UCHAR touch[] = { 0x31, 0x00, 0x00, 0x00 };
+	AMTPTP_STATUS_CACHE cache;
+
+	AmtPtpStatusCacheInitialize(&cache);
+
+	// A bare mouse report means the device fell back to mouse mode
+	AmtPtpTestRecord(&cache, mouse, sizeof(mouse), AmtPtpStatusRearm);
+	AMTPTP_CHECK_EQ(cache.MouseFrames, 1);
+
+	// Power-down and the unknown report are only kept
+	AmtPtpTestRecord(&cache, powerDown, sizeof(powerDown), AmtPtpStatusCached);
+	AMTPTP_CHECK_EQ(cache.PowerDown[0], 0x12);
+	AMTPTP_CHECK_EQ(cache.PowerDown[1], 0x34);
+	AmtPtpTestRecord(&cache, powerDown, 2, AmtPtpStatusTruncated);
+	AMTPTP_CHECK_EQ(cache.PowerDowns, 1);
+
+	AmtPtpTestRecord(&cache, unknown, sizeof(unknown), AmtPtpStatusCached);
+	AMTPTP_CHECK_EQ(cache.Unknown[2], 0x03);
+	AMTPTP_CHECK_EQ(cache.Unknowns, 1);
+
+	// Touch frames and empty transfers are not status frames
+	AmtPtpTestRecord(&cache, touch, sizeof(touch), AmtPtpStatusNone);
+	AmtPtpTestRecord(&cache, touch, 0, AmtPtpStatusNone);
+	AMTPTP_CHECK_EQ(cache.Truncated, 1);
+	AMTPTP_CHECK(!cache.BatteryValid);
+}
+
+int
+main(VOID)
+{
+	AmtPtpTestBattery();
+	AmtPtpTestOthers();
+	return AmtPtpTestExit("AmtPtpStatusFrameTest");
+}
@@ -0,0 +1,43 @@
+// AmtPtpTest.h: Checks for the host tests
+//
+// Each test is a small program that runs its checks and exits non-zero if
+// any of them failed. A failed check prints where it is and goes on, so one
+// run shows every mismatch.
+#pragma once
+
+#include <stdio.h>
+#include <AmtPtpPortable.h>
+
+static int AmtPtpTestFailures;
+
+#define AMTPTP_CHECK(Expr) \
+	do { \
+		if (!(Expr)) { \
+			AmtPtpTestFailures++; \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #Expr); \
+		} \
+	} while (0)
+
+#define AMTPTP_CHECK_EQ(Actual, Expected) \
+	do { \
+		long long __actual = (long long) (Actual), __expected = (long long) (Expected); \
+		if (__actual != __expected) { \
+			AmtPtpTestFailures++; \
+			fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #Actual, \
+				__actual, __expected); \
+		} \
+	} while (0)
+
+static __inline int
+AmtPtpTestExit(
+	_In_ const char* Name
+)
+{
+	if (AmtPtpTestFailures != 0) {
+		fprintf(stderr, "%s: %d checks failed\n", Name, AmtPtpTestFailures);
+		return 1;
+	}
+
+	printf("%s: passed\n", Name);
+	return 0;
+}
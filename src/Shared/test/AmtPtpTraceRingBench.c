@@ -0,0 +1,54 @@
+// AmtPtpTraceRingBench.c: What the trace budget costs a frame
+//
+// A frame records about two events (frame in, report out) and asks the
+// sampler once. A dump, on an error, walks the full ring.
+
+#include <AmtPtpBench.h>
+#include <AmtPtpTraceRing.h>
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	static AMTPTP_TRACE_RING ring;
+	AMTPTP_TRACE_CURSOR cursor;
+	AMTPTP_TRACE_RECORD record;
+	ULONG iterations = AmtPtpBenchIterations(argc, argv, 10000000);
+	ULONGLONG start;
+	ULONG i;
+
+	AmtPtpTraceRingInitialize(&ring);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		AmtPtpTraceRingRecord(&ring, AmtPtpTraceReportOut, i, i, i);
+	}
+	AmtPtpBenchReport("record", AmtPtpBenchNow() - start, iterations);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		AmtPtpBenchSink += AmtPtpTraceRingSample(&ring);
+	}
+	AmtPtpBenchReport("sample", AmtPtpBenchNow() - start, iterations);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		AmtPtpTraceRingRecord(&ring, AmtPtpTraceFrameIn, 64, 0, i);
+		AmtPtpBenchSink += AmtPtpTraceRingSample(&ring);
+		AmtPtpTraceRingRecord(&ring, AmtPtpTraceReportOut, 2, i, i);
+	}
+	AmtPtpBenchReport("frame", AmtPtpBenchNow() - start, iterations);
+
+	iterations = iterations / AMTPTP_TRACE_RING_SIZE + 1;
+	start = AmtPtpBenchNow();
+	for (i = 0; i < iterations; i++) {
+		AmtPtpTraceRingBegin(&ring, &cursor);
+		while (AmtPtpTraceRingNext(&ring, &cursor, &record)) {
+			AmtPtpBenchSink += record.Arg0;
+		}
+	}
+	AmtPtpBenchReport("walk of the full ring", AmtPtpBenchNow() - start, iterations);
+	return 0;
+}
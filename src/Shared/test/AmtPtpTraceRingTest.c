@@ -0,0 +1,232 @@
+// AmtPtpTraceRingTest.c: Trace sampler and event ring, alone and under writers
+//
+// The dump the drivers write on an error is a walk of the ring, so the walk
+// has to come out oldest first, skip what is being written, and never hand
+// out a record mixed from two frames. The threaded case races writers
+// against a reader; every record carries arguments that only fit together
+// when it was read whole.
+
+#include <pthread.h>
+#include <string.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpTraceRing.h>
+
+#define TEST_WRITERS			3
+#define TEST_WRITER_RECORDS		200000
+
+// Arg1 and Time are derived from Arg0, a torn record breaks the relation
+#define TEST_ARG1(Arg0)			(~(Arg0))
+#define TEST_TIME(Arg0)			((ULONGLONG) (Arg0) * 3 + 1)
+
+typedef struct _AMTPTP_TEST_RACE {
+	AMTPTP_TRACE_RING	Ring;
+	volatile LONG		Running;
+	ULONG				Writer;
+} AMTPTP_TEST_RACE;
+
+// Walks the ring, checks order and contents, and returns the records read
+static ULONG
+AmtPtpTestWalk(
+	_In_ const AMTPTP_TRACE_RING* Ring,
+	_Out_opt_ AMTPTP_TRACE_RECORD* Records
+)
+{
+	AMTPTP_TRACE_CURSOR cursor;
+	AMTPTP_TRACE_RECORD record;
+	LONG previous = 0;
+	ULONG count = 0;
+
+	AmtPtpTraceRingBegin(Ring, &cursor);
+	while (AmtPtpTraceRingNext(Ring, &cursor, &record)) {
+		AMTPTP_CHECK(record.Sequence > previous);
+		AMTPTP_CHECK(count < AMTPTP_TRACE_RING_SIZE);
+		if (Records != NULL && count < AMTPTP_TRACE_RING_SIZE) {
+			Records[count] = record;
+		}
+		previous = record.Sequence;
+		count++;
+	}
+	return count;
+}
+
+// One in AMTPTP_TRACE_SAMPLE_INTERVAL calls, starting with the first
+static VOID
+AmtPtpTestSampler(VOID)
+{
+	AMTPTP_TRACE_RING ring;
+	ULONG i, sampled = 0;
+
+	AmtPtpTraceRingInitialize(&ring);
+	for (i = 0; i < 100 * AMTPTP_TRACE_SAMPLE_INTERVAL; i++) {
+		if (AmtPtpTraceRingSample(&ring)) {
+			AMTPTP_CHECK_EQ(i % AMTPTP_TRACE_SAMPLE_INTERVAL, 0);
+			sampled++;
+		}
+	}
+	AMTPTP_CHECK_EQ(sampled, 100);
+
+	// The countdown wraps without skipping or doubling a sample
+	ring.SampleCountdown = (ULONG) -AMTPTP_TRACE_SAMPLE_INTERVAL;
+	sampled = 0;
+	for (i = 0; i < 2 * AMTPTP_TRACE_SAMPLE_INTERVAL; i++) {
+		sampled += AmtPtpTraceRingSample(&ring) ? 1 : 0;
+	}
+	AMTPTP_CHECK_EQ(sampled, 2);
+}
+
+// Partly filled, exactly full and wrapped several times
+static VOID
+AmtPtpTestWrap(VOID)
+{
+	static const ULONG counts[] = { 0, 1, AMTPTP_TRACE_RING_SIZE - 1, AMTPTP_TRACE_RING_SIZE,
+		AMTPTP_TRACE_RING_SIZE + 1, 5 * AMTPTP_TRACE_RING_SIZE + 7 };
+	AMTPTP_TRACE_RECORD records[AMTPTP_TRACE_RING_SIZE];
+	AMTPTP_TRACE_RING ring;
+	ULONG c, i, count, first;
+
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		AmtPtpTraceRingInitialize(&ring);
+		for (i = 0; i < counts[c]; i++) {
+			AmtPtpTraceRingRecord(&ring, (AMTPTP_TRACE_EVENT) (i % AmtPtpTraceEventMax), i, TEST_ARG1(i), TEST_TIME(i));
+		}
+
+		count = AmtPtpTestWalk(&ring, records);
+		first = (counts[c] > AMTPTP_TRACE_RING_SIZE) ? counts[c] - AMTPTP_TRACE_RING_SIZE : 0;
+		AMTPTP_CHECK_EQ(count, counts[c] - first);
+		for (i = 0; i < count; i++) {
+			AMTPTP_CHECK_EQ(records[i].Sequence, first + i + 1);
+			AMTPTP_CHECK_EQ(records[i].Event, (first + i) % AmtPtpTraceEventMax);
+			AMTPTP_CHECK_EQ(records[i].Arg0, first + i);
+			AMTPTP_CHECK_EQ(records[i].Arg1, TEST_ARG1(first + i));
+			AMTPTP_CHECK_EQ(records[i].Time, TEST_TIME(first + i));
+		}
+	}
+}
+
+// A slot caught mid-write, or reused after the walk began, is skipped
+static VOID
+AmtPtpTestSkip(VOID)
+{
+	AMTPTP_TRACE_RING ring;
+	AMTPTP_TRACE_CURSOR cursor;
+	AMTPTP_TRACE_RECORD record;
+	ULONG i, count = 0;
+
+	AmtPtpTraceRingInitialize(&ring);
+	for (i = 0; i < 10; i++) {
+		AmtPtpTraceRingRecord(&ring, AmtPtpTraceReportOut, i, TEST_ARG1(i), TEST_TIME(i));
+	}
+
+	// Slot 3 is being written, as a writer leaves it between its two exchanges
+	ring.Records[3].Sequence = 0;
+	AMTPTP_CHECK_EQ(AmtPtpTestWalk(&ring, NULL), 9);
+
+	// The oldest slots are reused by records written after the walk began
+	AmtPtpTraceRingBegin(&ring, &cursor);
+	for (i = 10; i < 10 + AMTPTP_TRACE_RING_SIZE - 4; i++) {
+		AmtPtpTraceRingRecord(&ring, AmtPtpTraceReportOut, i, TEST_ARG1(i), TEST_TIME(i));
+	}
+	while (AmtPtpTraceRingNext(&ring, &cursor, &record)) {
+		AMTPTP_CHECK(record.Arg0 < 10 && record.Arg0 != 3);
+		AMTPTP_CHECK_EQ(record.Sequence, record.Arg0 + 1);
+		count++;
+	}
+	AMTPTP_CHECK_EQ(count, 4);
+}
+
+static VOID
+AmtPtpTestNames(VOID)
+{
+	ULONG i, j;
+
+	for (i = 0; i < AmtPtpTraceEventMax; i++) {
+		AMTPTP_CHECK(strcmp(AmtPtpTraceEventName(i), "Unknown") != 0);
+		for (j = 0; j < i; j++) {
+			AMTPTP_CHECK(strcmp(AmtPtpTraceEventName(i), AmtPtpTraceEventName(j)) != 0);
+		}
+	}
+	AMTPTP_CHECK(strcmp(AmtPtpTraceEventName(AmtPtpTraceEventMax), "Unknown") == 0);
+}
+
+static void*
+AmtPtpTestWriter(
+	void* Context
+)
+{
+	AMTPTP_TEST_RACE* race = Context;
+	ULONG writer = (ULONG) InterlockedIncrement((volatile LONG*) &race->Writer);
+	ULONG i, arg0;
+
+	for (i = 0; i < TEST_WRITER_RECORDS; i++) {
+		arg0 = (writer << 24) | i;
+		AmtPtpTraceRingRecord(&race->Ring, AmtPtpTraceFrameIn, arg0, TEST_ARG1(arg0), TEST_TIME(arg0));
+	}
+	InterlockedDecrement(&race->Running);
+	return NULL;
+}
+
+// Records read while writers run are whole, in order, and each writer's
+// records come out in the order it wrote them
+static VOID
+AmtPtpTestRace(VOID)
+{
+	static AMTPTP_TEST_RACE race;
+	AMTPTP_TRACE_CURSOR cursor;
+	AMTPTP_TRACE_RECORD record;
+	pthread_t writers[TEST_WRITERS];
+	ULONG last[TEST_WRITERS + 1];
+	ULONG i, started = 0, walks = 0, read = 0, torn = 0;
+	LONG previous;
+
+	AmtPtpTraceRingInitialize(&race.Ring);
+	race.Running = TEST_WRITERS;
+	for (i = 0; i < TEST_WRITERS; i++) {
+		if (pthread_create(&writers[i], NULL, AmtPtpTestWriter, &race) == 0) {
+			started++;
+		}
+	}
+	AMTPTP_CHECK_EQ(started, TEST_WRITERS);
+	race.Running -= (LONG) (TEST_WRITERS - started);
+
+	while (InterlockedCompareExchange(&race.Running, 0, 0) != 0) {
+		memset(last, 0, sizeof(last));
+		previous = 0;
+		AmtPtpTraceRingBegin(&race.Ring, &cursor);
+		while (AmtPtpTraceRingNext(&race.Ring, &cursor, &record)) {
+			ULONG writer = record.Arg0 >> 24, index = record.Arg0 & 0xffffff;
+
+			if (record.Arg1 != TEST_ARG1(record.Arg0) || record.Time != TEST_TIME(record.Arg0) ||
+				record.Sequence <= previous || writer == 0 || writer > TEST_WRITERS ||
+				(last[writer] != 0 && index < last[writer])) {
+				torn++;
+			}
+			else {
+				last[writer] = index;
+			}
+			previous = record.Sequence;
+			read++;
+		}
+		walks++;
+	}
+
+	for (i = 0; i < started; i++) {
+		pthread_join(writers[i], NULL);
+	}
+
+	printf("race: %u walks, %u records read, %u torn\n", walks, read, torn);
+	AMTPTP_CHECK_EQ(torn, 0);
+	AMTPTP_CHECK_EQ(race.Ring.Next, started * TEST_WRITER_RECORDS);
+	AMTPTP_CHECK_EQ(AmtPtpTestWalk(&race.Ring, NULL), AMTPTP_TRACE_RING_SIZE);
+}
+
+int
+main(VOID)
+{
+	AmtPtpTestSampler();
+	AmtPtpTestWrap();
+	AmtPtpTestSkip();
+	AmtPtpTestNames();
+	AmtPtpTestRace();
+
+	return AmtPtpTestExit("AmtPtpTraceRingTest");
+}
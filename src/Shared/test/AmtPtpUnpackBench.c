@@ -0,0 +1,48 @@
+// AmtPtpUnpackBench.c: AmtPtpUnpackMt2Fingers variants across 1 - 16 fingers
+
+#include <AmtPtpBench.h>
+#include <AmtPtpDecoder.h>
+#include <AmtPtpDeviceRegistry.h>
+
+static const char* AmtPtpBenchIsaNames[AmtPtpUnpackIsaMax] = { "scalar", "sse4.1", "avx2", "neon" };
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	static UCHAR fingers[AMTPTP_DECODER_MAX_CONTACTS * AMTPTP_MT2_FINGER_SIZE];
+	ULONG iterations = AmtPtpBenchIterations(argc, argv, 10000000);
+	AMTPTP_DECODER_CONFIG config;
+	AMTPTP_MT2_FINGER_BATCH batch;
+	PFN_AMTPTP_UNPACK_MT2_FINGERS unpack;
+	AMTPTP_UNPACK_ISA isa;
+	ULONGLONG start;
+	SIZE_T count, i;
+	ULONG n;
+	char name[64];
+
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Bluetooth), 0, &config);
+	for (i = 0; i < sizeof(fingers); i++) {
+		fingers[i] = (UCHAR) (i * 37 + 11);
+	}
+
+	for (isa = AmtPtpUnpackIsaScalar; isa < AmtPtpUnpackIsaMax; isa++) {
+		unpack = AmtPtpGetUnpackMt2Fingers(isa);
+		if (unpack == NULL) {
+			continue;
+		}
+
+		for (count = 1; count <= AMTPTP_DECODER_MAX_CONTACTS; count++) {
+			start = AmtPtpBenchNow();
+			for (n = 0; n < iterations; n++) {
+				unpack(&config, fingers, count, &batch);
+				AmtPtpBenchSink += batch.X[count - 1];
+			}
+			snprintf(name, sizeof(name), "%s, %zu fingers", AmtPtpBenchIsaNames[isa], count);
+			AmtPtpBenchReport(name, AmtPtpBenchNow() - start, iterations);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,159 @@
+// AmtPtpUnpackTest.c: Checks every AmtPtpUnpackMt2Fingers variant against the scalar one
+//
+// Variants the build or the CPU lacks are skipped. Every variant has to
+// produce the same batch bit for bit, and leave the slots past Count alone.
+
+#include <stdlib.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpDecoder.h>
+#include <AmtPtpDeviceRegistry.h>
+
+#define TEST_RECORDS	20	/* more than AMTPTP_DECODER_MAX_CONTACTS, to check the cap */
+
+static const char* AmtPtpTestIsaNames[AmtPtpUnpackIsaMax] = { "scalar", "sse4.1", "avx2", "neon" };
+
+static ULONG AmtPtpTestSeed = 1;
+
+static ULONG
+AmtPtpTestRandom(VOID)
+{
+	AmtPtpTestSeed = AmtPtpTestSeed * 1103515245 + 12345;
+	return (AmtPtpTestSeed >> 16) | (AmtPtpTestSeed << 16);
+}
+
+static VOID
+AmtPtpTestFill(
+	_Out_writes_bytes_(Count * AMTPTP_MT2_FINGER_SIZE) UCHAR* Fingers,
+	_In_ SIZE_T Count,
+	_In_ BOOLEAN Extremes
+)
+{
+	// 13 bit corners of X and Y, with every class and state bit pattern
+	static const ULONG corners[] = { 0x0000, 0x0FFF, 0x1000, 0x1FFF, 0x0001, 0x1001 };
+	SIZE_T i, j;
+
+	for (i = 0; i < Count; i++) {
+		UCHAR* f = Fingers + i * AMTPTP_MT2_FINGER_SIZE;
+		ULONG coords = AmtPtpTestRandom();
+
+		if (Extremes) {
+			coords = corners[AmtPtpTestRandom() % 6] | (corners[AmtPtpTestRandom() % 6] << 13) |
+				((AmtPtpTestRandom() & 0x3F) << 26);
+		}
+		f[0] = (UCHAR) coords;
+		f[1] = (UCHAR) (coords >> 8);
+		f[2] = (UCHAR) (coords >> 16);
+		f[3] = (UCHAR) (coords >> 24);
+		for (j = 4; j < AMTPTP_MT2_FINGER_SIZE; j++) {
+			f[j] = (UCHAR) AmtPtpTestRandom();
+		}
+	}
+}
+
+static VOID
+AmtPtpTestVariant(
+	_In_ AMTPTP_UNPACK_ISA Isa,
+	_In_ PFN_AMTPTP_UNPACK_MT2_FINGERS Unpack,
+	_In_ const AMTPTP_DECODER_CONFIG* Config,
+	_In_ BOOLEAN Extremes
+)
+{
+	AMTPTP_MT2_FINGER_BATCH expected, actual;
+	UCHAR* fingers;
+	SIZE_T count, round;
+
+	for (count = 0; count <= TEST_RECORDS; count++) {
+		// Exactly sized, so a sanitizer sees any read past the last record
+		fingers = malloc(count ? count * AMTPTP_MT2_FINGER_SIZE : 1);
+		if (fingers == NULL) {
+			AMTPTP_CHECK(fingers != NULL);
+			return;
+		}
+
+		for (round = 0; round < 64; round++) {
+			AmtPtpTestFill(fingers, count, Extremes);
+			memset(&expected, 0xA5, sizeof(expected));
+			memset(&actual, 0xA5, sizeof(actual));
+
+			AmtPtpUnpackMt2Fingers(Config, fingers, count, &expected);
+			Unpack(Config, fingers, count, &actual);
+
+			if (memcmp(&expected, &actual, sizeof(expected)) != 0) {
+				AmtPtpTestFailures++;
+				fprintf(stderr, "%s: %zu fingers, min %d/%d differ from scalar\n", AmtPtpTestIsaNames[Isa],
+					count, Config->XMin, Config->YMin);
+				break;
+			}
+		}
+		free(fingers);
+	}
+}
+
+static VOID
+AmtPtpTestEquivalence(VOID)
+{
+	// The device range, then offsets that clamp every coordinate low or high
+	static const LONG offsets[][2] = { { 0, 0 }, { 4096, 4096 }, { -65535, -65535 }, { -70000, 5000 } };
+	AMTPTP_DECODER_CONFIG config;
+	PFN_AMTPTP_UNPACK_MT2_FINGERS unpack;
+	AMTPTP_UNPACK_ISA isa;
+	SIZE_T i;
+
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Bluetooth), 0, &config);
+	AMTPTP_CHECK(AmtPtpGetUnpackMt2Fingers(AmtPtpUnpackIsaScalar) == AmtPtpUnpackMt2Fingers);
+
+	for (isa = AmtPtpUnpackIsaScalar + 1; isa < AmtPtpUnpackIsaMax; isa++) {
+		unpack = AmtPtpGetUnpackMt2Fingers(isa);
+		if (unpack == NULL) {
+			printf("AmtPtpUnpackTest: %s not available\n", AmtPtpTestIsaNames[isa]);
+			continue;
+		}
+
+		for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+			AMTPTP_DECODER_CONFIG shifted = config;
+
+			if (i != 0) {
+				shifted.XMin = offsets[i][0];
+				shifted.YMin = offsets[i][1];
+			}
+			AmtPtpTestVariant(isa, unpack, &shifted, FALSE);
+			AmtPtpTestVariant(isa, unpack, &shifted, TRUE);
+		}
+	}
+}
+
+// Decoding a frame through the selected variant matches the scalar decode
+static VOID
+AmtPtpTestSelect(VOID)
+{
+	UCHAR frame[AMTPTP_MT2_HEADER_SIZE + AMTPTP_DECODER_MAX_CONTACTS * AMTPTP_MT2_FINGER_SIZE] = { 0x31 };
+	AMTPTP_DECODED_FRAME expected, actual;
+	AMTPTP_DECODER_CONFIG config, scalar;
+	SIZE_T count;
+
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Bluetooth), 0, &config);
+	AMTPTP_CHECK(config.UnpackMt2Fingers != NULL);
+	scalar = config;
+	scalar.UnpackMt2Fingers = NULL;
+
+	for (count = 0; count <= AMTPTP_DECODER_MAX_CONTACTS; count++) {
+		AmtPtpTestFill(frame + AMTPTP_MT2_HEADER_SIZE, count, FALSE);
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&scalar, frame, AMTPTP_MT2_HEADER_SIZE + count * AMTPTP_MT2_FINGER_SIZE,
+			&expected), AmtPtpDecodeOk);
+		AMTPTP_CHECK_EQ(AmtPtpDecodeFrame(&config, frame, AMTPTP_MT2_HEADER_SIZE + count * AMTPTP_MT2_FINGER_SIZE,
+			&actual), AmtPtpDecodeOk);
+		AMTPTP_CHECK(memcmp(&expected, &actual, sizeof(expected)) == 0);
+	}
+
+	// Other formats never unpack MT2 records
+	AmtPtpDeviceRegistryInitDecoderConfig(AmtPtpDeviceRegistryGetModel(AmtPtpModelWellspring9), 0, &config);
+	AMTPTP_CHECK(config.UnpackMt2Fingers == NULL);
+}
+
+int
+main(VOID)
+{
+	AmtPtpTestEquivalence();
+	AmtPtpTestSelect();
+	return AmtPtpTestExit("AmtPtpUnpackTest");
+}
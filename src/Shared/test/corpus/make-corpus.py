@@ -0,0 +1,396 @@
+#!/usr/bin/env python3
+"""
+Writes the frame corpus under src/Shared/test/corpus.
+
+Each capture is a short recording of one device: taps, scrolls, swipes, a
+palm next to a finger, clicks, a crowd of fingers past the PTP report limit
+and a few broken transfers. The frames are encoded from the wire formats the
+Linux bcm5974, hid-magicmouse and applespi drivers document. The expected
+decode of every frame is written from the values the frame was built from,
+not by running the decoder.
+
+The corpus is deterministic. Run this script again after changing it and
+commit the result:
+
+    python3 make-corpus.py [output directory]
+
+Capture format, one record per line, '#' starts a comment:
+
+    device <usb|bth|spi> <vid> <pid>       registry key of the device
+    flags <n>                              AMTPTP_DECODER_FLAG_* the driver uses
+    frame <host time, us> <hex bytes>      one transfer as the driver sees it
+    expect ok <button> <device time|-> <contacts>
+    contact <id> <x> <y> <tip> <conf> <finger> <major> <minor> <pressure>
+    expect malformed
+
+Every frame the decoder takes as it is is followed by its expect line, and
+an ok frame by one contact line per decoded contact. Transfers that only
+decode after demultiplexing or reassembly (Bluetooth reports 0xF7, 0xFC and
+0xFE) and status reports have none.
+"""
+
+import os
+import random
+import struct
+import sys
+
+# Geometry records of AmtPtpDeviceRegistry.h: (X min, X max, Y min, Y max)
+GEOMETRY_MAGIC_TRACKPAD2 = (-3678, 3934, -2479, 2586)
+GEOMETRY_WELLSPRING7A = (-4750, 5280, -150, 6730)
+GEOMETRY_WELLSPRING8 = (-4620, 5140, -150, 6600)
+GEOMETRY_WELLSPRING9 = (-4828, 5345, -203, 6803)
+GEOMETRY_T2 = (-10000, 10000, -2000, 10000)
+GEOMETRY_SPI_FAMILY2 = (-4750, 5280, -150, 6730)
+
+FLAG_FINGER_OFFSET_IN_FRAME = 0x1
+FLAG_CONTACT_ID_FROM_SLOT = 0x2
+FLAG_TIP_FROM_TOUCH_AREA = 0x4
+
+STATE_TOUCHING = 0x4
+STATE_HOVERING = 0x6
+FINGER_INDEX = 2
+FINGER_PALM = 6
+
+
+def clamp16(value):
+    return max(0, min(0xFFFF, value))
+
+
+class Finger:
+    """One contact of a scene, in raw sensor coordinates."""
+
+    def __init__(self, ident, x, y, finger=FINGER_INDEX, state=STATE_TOUCHING,
+                 major=40, minor=32, pressure=60):
+        self.ident = ident
+        self.x = x
+        self.y = y
+        self.finger = finger
+        self.state = state
+        self.major = major
+        self.minor = minor
+        self.pressure = pressure
+
+
+class Device:
+    """Encodes frames of one layout and tells what they decode to."""
+
+    flags = 0
+
+    def __init__(self, geometry):
+        self.xmin, self.xmax, self.ymin, self.ymax = geometry
+
+    def clip(self, finger):
+        finger.x = max(self.xmin, min(self.xmax, finger.x))
+        finger.y = max(self.ymin, min(self.ymax, finger.y))
+
+    def transfers(self, rng, data, fingers):
+        """The transfers a frame arrives in, the frame itself for most layouts."""
+        return [data]
+
+
+class Mt2(Device):
+    """Magic Trackpad 2 report 0x31, bare over Bluetooth."""
+
+    bus, vid, pid = 'bth', 0x004c, 0x0265
+    prefix = b''
+    interval = 11000
+
+    def encode(self, time, button, fingers):
+        timestamp = time & 0x1FFFFF
+        header = bytes([0x31, (button & 1) | ((timestamp & 0x1F) << 3)]) + \
+            struct.pack('<H', (timestamp >> 5) & 0xFFFF)
+        body = b''
+        for f in fingers:
+            coords = (f.x & 0x1FFF) | (((-f.y) & 0x1FFF) << 13) | \
+                ((f.finger & 7) << 26) | ((f.state & 7) << 29)
+            body += struct.pack('<I', coords) + bytes([f.major & 0xFF, f.minor & 0xFF, 0, f.pressure & 0xFF,
+                                                      0x40 | (f.ident & 0xF)])
+        return self.prefix + header + body
+
+    def expect(self, time, button, fingers):
+        contacts = []
+        for slot, f in enumerate(fingers):
+            ident = slot if self.flags & FLAG_CONTACT_ID_FROM_SLOT else f.ident & 0xF
+            tip = int(bool(f.state & 4) and not f.state & 2)
+            contacts.append((ident, clamp16(f.x - self.xmin), clamp16(f.y - self.ymin), tip,
+                             int(f.finger != FINGER_PALM), f.finger, f.major & 0xFF, f.minor & 0xFF,
+                             f.pressure & 0xFF))
+        return button & 1, time & 0x1FFFFF, contacts
+
+
+class Mt2Mixed(Mt2):
+    """Magic Trackpad 2 over Bluetooth with everything else the link carries:
+    crowded frames split into reports 0xFC and 0xFE, battery reports on their
+    own and packed in front of a touch frame in report 0xF7."""
+
+    def __init__(self, geometry):
+        super().__init__(geometry)
+        self.battery = 87
+
+    def transfers(self, rng, data, fingers):
+        battery = bytes([0x90, 0x04, self.battery])
+        if len(fingers) >= 10:
+            half = len(data) // 2
+            return [b'\xfc' + data[:half], b'\xfe' + data[half:]]
+        if rng.random() < 0.05:
+            self.battery = max(0, self.battery - 1)
+            return [battery, data]
+        if rng.random() < 0.1:
+            return [bytes([0xf7, len(battery)]) + battery + data]
+        return [data]
+
+
+class Mt2Usb(Mt2):
+    """Magic Trackpad 2 over USB, report 0x31 behind the 8 byte mouse report."""
+
+    bus, vid, pid = 'usb', 0x05ac, 0x0265
+    prefix = bytes([0x02, 0, 0, 0, 0, 0, 0, 0])
+    interval = 8000
+
+    def encode(self, time, button, fingers):
+        # The driver takes the button from the mouse report, the clicks bit
+        # of report 0x31 stays clear so the capture shows which one is read
+        data = bytearray(super().encode(time, 0, fingers))
+        data[1] = button
+        return bytes(data)
+
+
+class Wellspring(Device):
+    """bcm5974 TYPE2 - TYPE4, finger records of le16 fields."""
+
+    flags = FLAG_FINGER_OFFSET_IN_FRAME
+    interval = 8000
+
+    def encode(self, time, button, fingers):
+        header = bytearray(self.header_size)
+        header[0] = 0x02
+        header[2] = self.header_size
+        header[4] = time & 0xFF
+        header[self.button] = button
+        body = b''
+        for f in fingers:
+            record = bytearray(self.finger_size)
+            record[0] = f.ident & 0xFF
+            record[1] = f.state & 0xFF
+            record[2] = f.finger & 0xFF
+            struct.pack_into('<hh', record, 4, f.x, f.y)
+            struct.pack_into('<hh', record, 18, f.major, f.minor)
+            struct.pack_into('<H', record, 26, f.pressure)
+            body += bytes(record)
+        return bytes(header) + body
+
+    def expect(self, time, button, fingers):
+        contacts = []
+        for slot, f in enumerate(fingers):
+            ident = slot if self.flags & FLAG_CONTACT_ID_FROM_SLOT else f.ident & 0xFF
+            if self.flags & FLAG_TIP_FROM_TOUCH_AREA:
+                tip = int(f.major * 2 >= 200 or f.minor * 2 >= 150)
+                conf = int(f.minor * 2 > 0)
+            else:
+                tip = int(bool(f.state & 4) and not f.state & 2)
+                conf = int(f.finger not in (6, 7))
+            contacts.append((ident, clamp16(f.x - self.xmin), clamp16(self.ymax - f.y), tip, conf,
+                             f.finger, clamp16(f.major * 2), clamp16(f.minor * 2), f.pressure))
+        return int(button != 0), time & 0xFF, contacts
+
+
+class Wellspring7A(Wellspring):
+    bus, vid, pid = 'usb', 0x05ac, 0x0259
+    header_size, finger_size, button = 28, 28, 15
+
+
+class Wellspring8(Wellspring):
+    bus, vid, pid = 'usb', 0x05ac, 0x0290
+    header_size, finger_size, button = 36, 28, 23
+
+
+class Wellspring9(Wellspring):
+    bus, vid, pid = 'usb', 0x05ac, 0x0272
+    header_size, finger_size, button = 46, 30, 31
+
+
+class T2(Wellspring9):
+    """T2 trackpads, decoded the way AmtPtpDeviceUsbKm does."""
+
+    pid = 0x027c
+    flags = FLAG_CONTACT_ID_FROM_SLOT | FLAG_TIP_FROM_TOUCH_AREA
+
+
+class Spi(Device):
+    """SPI_TRACKPAD_PACKET, 46 byte header and 30 byte fingers."""
+
+    bus, vid, pid = 'spi', 0x05ac, 0x0272
+    interval = 8000
+
+    def encode(self, time, button, fingers):
+        header = bytearray(46)
+        header[0] = 0x02
+        header[1] = button
+        header[30] = len(fingers)
+        body = b''
+        for f in fingers:
+            record = bytearray(30)
+            struct.pack_into('<hh', record, 4, f.x, f.y)
+            struct.pack_into('<hh', record, 18, f.major * 30, f.minor * 30)
+            struct.pack_into('<h', record, 26, f.pressure if f.state == STATE_TOUCHING else 0)
+            body += bytes(record)
+        return bytes(header) + body
+
+    def expect(self, time, button, fingers):
+        contacts = []
+        for slot, f in enumerate(fingers[:10]):
+            major, minor = f.major * 30, f.minor * 30
+            pressure = f.pressure if f.state == STATE_TOUCHING else 0
+            contacts.append((slot, clamp16(f.x - self.xmin), clamp16(self.ymax - f.y), int(pressure > 0),
+                             int(major < 2500 and minor < 2500), 0, clamp16(major), clamp16(minor),
+                             clamp16(pressure)))
+        return int(button != 0), None, contacts
+
+
+def scenes(device, rng):
+    """Yields (button, fingers) per frame, None for a broken transfer."""
+
+    cx = (device.xmin + device.xmax) // 2
+    cy = (device.ymin + device.ymax) // 2
+    spanx = device.xmax - device.xmin
+    spany = device.ymax - device.ymin
+
+    def jitter(fingers):
+        for f in fingers:
+            f.x += rng.randint(-3, 3)
+            f.y += rng.randint(-3, 3)
+            device.clip(f)
+
+    # Tap: touch down, hold, lift
+    tap = [Finger(1, cx - spanx // 5, cy + spany // 6)]
+    for _ in range(6):
+        jitter(tap)
+        yield 0, tap
+    tap[0].state = STATE_HOVERING
+    yield 0, tap
+    yield 0, []
+
+    # Two finger scroll down
+    scroll = [Finger(2, cx - 300, cy + spany // 4), Finger(3, cx + 300, cy + spany // 4)]
+    for _ in range(20):
+        for f in scroll:
+            f.y -= spany // 50
+        jitter(scroll)
+        yield 0, scroll
+    yield 0, []
+
+    # Three finger swipe, the middle finger lifts early
+    swipe = [Finger(4 + i, device.xmin + spanx // 5 + i * 400, cy) for i in range(3)]
+    for step in range(16):
+        for f in swipe:
+            f.x += spanx // 40
+        jitter(swipe)
+        if step == 10:
+            swipe[1].state = STATE_HOVERING
+        if step == 11:
+            swipe = [swipe[0], swipe[2]]
+        yield 0, swipe
+    yield 0, []
+
+    # A palm rests while a finger moves next to it
+    palm = Finger(7, device.xmin + spanx // 8, device.ymin + spany // 8, finger=FINGER_PALM,
+                  major=120, minor=90, pressure=30)
+    pointer = Finger(8, cx, cy)
+    for _ in range(12):
+        pointer.x += spanx // 60
+        jitter([palm, pointer])
+        yield 0, [palm, pointer]
+    yield 0, []
+
+    # Click with two fingers, button down for a few frames
+    click = [Finger(9, cx - 500, cy - spany // 4), Finger(10, cx + 200, cy - spany // 4)]
+    for step in range(10):
+        jitter(click)
+        yield int(3 <= step < 7), click
+    yield 0, []
+
+    # More fingers than one PTP report holds, then more than the device reports
+    for count in (6, 10, 16):
+        crowd = [Finger(i, device.xmin + (i % 4 + 1) * spanx // 5, device.ymin + (i // 4 + 1) * spany // 5)
+                 for i in range(count)]
+        for _ in range(4):
+            jitter(crowd)
+            yield 0, crowd
+        yield 0, []
+
+    # Fingers at the edges of the surface
+    edges = [Finger(11, device.xmin, device.ymin), Finger(12, device.xmax, device.ymax)]
+    for _ in range(3):
+        yield 0, edges
+    yield 0, []
+
+    # Broken transfers between two touches
+    again = [Finger(13, cx, cy)]
+    yield 0, again
+    yield None, again
+    yield 0, again
+    yield None, again
+    yield None, again
+    yield 0, again
+    yield 0, []
+
+
+def truncate(device, rng, data):
+    """A transfer cut short or padded by a byte, the decoders reject both.
+    SPI frames carry their finger count, only a cut header is broken there."""
+
+    if isinstance(device, Spi):
+        return data[:rng.randint(1, 45)]
+    if rng.random() < 0.5 and len(data) > 1:
+        return data[:-1]
+    return data + b'\x00'
+
+
+def write_capture(path, device, title, seed):
+    rng = random.Random(seed)
+    host = 1000000
+    device_time = rng.randint(0, 0x1FFFFF)
+    with open(path, 'w', newline='\n') as out:
+        out.write('# %s, written by make-corpus.py\n' % title)
+        out.write('device %s %04x %04x\n' % (device.bus, device.vid, device.pid))
+        out.write('flags %d\n' % device.flags)
+        for button, fingers in scenes(device, rng):
+            host += device.interval + rng.randint(-200, 200)
+            device_time += device.interval // 1000
+            data = device.encode(device_time, button or 0, fingers)
+            if button is None:
+                out.write('frame %d %s\n' % (host, truncate(device, rng, data).hex()))
+                out.write('expect malformed\n')
+                continue
+            transfers = device.transfers(rng, data, fingers)
+            for transfer in transfers:
+                out.write('frame %d %s\n' % (host, transfer.hex()))
+            if transfers[-1] != data:
+                continue
+            clicked, time, contacts = device.expect(device_time, button, fingers)
+            out.write('expect ok %d %s %d\n' % (clicked, '-' if time is None else time, len(contacts[:16])))
+            for contact in contacts[:16]:
+                out.write('contact %s\n' % ' '.join(str(v) for v in contact))
+
+
+CAPTURES = [
+    ('mt2-bluetooth.cap', Mt2(GEOMETRY_MAGIC_TRACKPAD2), 'Magic Trackpad 2 over Bluetooth'),
+    ('mt2-usb.cap', Mt2Usb(GEOMETRY_MAGIC_TRACKPAD2), 'Magic Trackpad 2 over USB'),
+    ('wellspring7a-type2.cap', Wellspring7A(GEOMETRY_WELLSPRING7A), 'Wellspring 7A, TYPE2 layout'),
+    ('wellspring8-type3.cap', Wellspring8(GEOMETRY_WELLSPRING8), 'Wellspring 8, TYPE3 layout'),
+    ('wellspring9-type4.cap', Wellspring9(GEOMETRY_WELLSPRING9), 'Wellspring 9, TYPE4 layout'),
+    ('t2-type4.cap', T2(GEOMETRY_T2), 'T2 15 inch, TYPE4 layout with slot ids'),
+    ('spi-family2.cap', Spi(GEOMETRY_SPI_FAMILY2), 'SPI family 2'),
+    ('mt2-bluetooth-mixed.cap', Mt2Mixed(GEOMETRY_MAGIC_TRACKPAD2),
+     'Magic Trackpad 2 over Bluetooth, split, combined and battery reports'),
+]
+
+
+def main():
+    directory = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    for seed, (name, device, title) in enumerate(CAPTURES):
+        write_capture(os.path.join(directory, name), device, title, seed)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,750 @@
+// AmtPtpReplay.c: Replays frame captures through the drivers' input pipelines
+//
+// Each capture is fed, transfer by transfer, through the same src/Shared calls
+// its driver makes on a completed read, in the same order:
+//
+//   filter   demultiplex, dispatch by report id, split reassembly, status
+//            cache, then the touch path below (Magic Trackpad 2 over HID)
+//   um, km   salvage decode, error budget, scan clock, contact tracker,
+//   spi      report ring, PTP report composition
+//
+// Host time comes from the capture, so the reports are the same on every run.
+// hidclass is taken to always have a read pending: a frame goes out at once,
+// and only the rest of a hybrid scan waits in the report ring.
+//
+// For every capture the tool prints the cost per transfer and its
+// percentiles, and a checksum over every report it composed. The cost is also
+// given relative to hashing the same bytes, which is what a baseline keeps:
+// that ratio moves with the code much more than with the machine.
+//
+//   AmtPtpReplay [options] capture...
+//     --iterations N    passes over each capture, 200 by default
+//     --filter          replay Magic Trackpad 2 USB captures through the filter
+//     --baseline FILE   compare against FILE, fail on a regression
+//     --threshold PCT   slowdown allowed against the baseline, 25 by default
+//     --update          write the results to the baseline file instead
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <AmtPtpCapture.h>
+#include <AmtPtpContactTracker.h>
+#include <AmtPtpErrorBudget.h>
+#include <AmtPtpPacketDemux.h>
+#include <AmtPtpReportRing.h>
+#include <AmtPtpScanClock.h>
+#include <AmtPtpSplitFrame.h>
+#include <AmtPtpStatusFrame.h>
+
+// PTP report of the drivers, AMTPTP_COMPOSE_REPORT only needs the field names
+#define REPORTID_MULTITOUCH				0x05
+#define PTP_MAX_CONTACT_POINTS			5
+#define PTP_MAX_HYBRID_CONTACT_POINTS	16
+#define PTP_SPLIT_FRAME_TIMEOUT			(50 * 10000)
+
+typedef struct _AMTPTP_REPLAY_CONTACT {
+	UCHAR	Confidence;
+	UCHAR	TipSwitch;
+	UCHAR	ContactID;
+	USHORT	X;
+	USHORT	Y;
+} AMTPTP_REPLAY_CONTACT;
+
+typedef struct _AMTPTP_REPLAY_REPORT {
+	UCHAR	ReportID;
+	AMTPTP_REPLAY_CONTACT Contacts[PTP_MAX_CONTACT_POINTS];
+	USHORT	ScanTime;
+	UCHAR	ContactCount;
+	UCHAR	IsButtonClicked;
+} AMTPTP_REPLAY_REPORT;
+
+#define AMTPTP_REPLAY_DEFAULT_ITERATIONS	200
+#define AMTPTP_REPLAY_DEFAULT_THRESHOLD		25
+#define AMTPTP_REPLAY_MAX_CAPTURES			64
+#define AMTPTP_REPLAY_ROUNDS				5
+
+#define AMTPTP_FNV_OFFSET	0xcbf29ce484222325ULL
+#define AMTPTP_FNV_PRIME	0x100000001b3ULL
+
+// Keeps the calibration hash from being optimized away
+static volatile ULONGLONG AmtPtpReplaySink;
+
+typedef enum _AMTPTP_REPLAY_DRIVER {
+	AmtPtpReplayFilter,		/* AmtPtpHidFilter */
+	AmtPtpReplayUsbUm,		/* AmtPtpDeviceUsbUm */
+	AmtPtpReplayUsbKm,		/* AmtPtpDeviceUsbKm, T2 */
+	AmtPtpReplaySpi,		/* AmtPtpDeviceSpiKm */
+	AmtPtpReplayDriverMax
+} AMTPTP_REPLAY_DRIVER;
+
+static const char* AmtPtpReplayDriverNames[AmtPtpReplayDriverMax] = {
+	"filter",
+	"um",
+	"km",
+	"spi",
+};
+
+/* Input state of one driver instance, as its device context keeps it */
+typedef struct _AMTPTP_REPLAY_DEVICE {
+	AMTPTP_REPLAY_DRIVER	Driver;
+	AMTPTP_DECODER_CONFIG	DecoderConfig;
+	AMTPTP_ERROR_BUDGET		ErrorBudget;
+	AMTPTP_SCAN_CLOCK		ScanClock;
+	AMTPTP_CONTACT_TRACKER	ContactTracker;
+	AMTPTP_REPORT_RING		ReportRing;
+	AMTPTP_SPLIT_FRAME		SplitFrame;
+	AMTPTP_STATUS_CACHE		StatusCache;
+	// Results of one pass
+	ULONG		Reports;
+	ULONG		Drops;
+	ULONG		Resets;
+	ULONGLONG	Checksum;
+} AMTPTP_REPLAY_DEVICE, *PAMTPTP_REPLAY_DEVICE;
+
+typedef struct _AMTPTP_REPLAY_RESULT {
+	char		Name[64];
+	ULONG		Reports;
+	unsigned long long Checksum;	/* printf and scanf take it as %llx */
+	double		Cost;		/* best pass, relative to hashing the capture */
+} AMTPTP_REPLAY_RESULT;
+
+typedef struct _AMTPTP_REPLAY_OPTIONS {
+	ULONG		Iterations;
+	BOOLEAN		Filter;
+	const char*	Baseline;
+	ULONG		Threshold;
+	BOOLEAN		Update;
+} AMTPTP_REPLAY_OPTIONS;
+
+static ULONGLONG
+AmtPtpReplayNow(VOID)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (ULONGLONG) now.tv_sec * 1000000000ULL + (ULONGLONG) now.tv_nsec;
+}
+
+static __inline ULONGLONG
+AmtPtpReplayFold(
+	_In_ ULONGLONG Hash,
+	_In_ ULONG Value
+)
+{
+	return (Hash ^ Value) * AMTPTP_FNV_PRIME;
+}
+
+static AMTPTP_REPLAY_DRIVER
+AmtPtpReplayDriverOf(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_In_ const AMTPTP_REPLAY_OPTIONS* Options
+)
+{
+	if (Capture->Bus == AmtPtpBusBluetooth) {
+		return AmtPtpReplayFilter;
+	}
+	if (Capture->Bus == AmtPtpBusSpi) {
+		return AmtPtpReplaySpi;
+	}
+	if (Options->Filter && Capture->Model->Format == AmtPtpFrameFormatMt2) {
+		return AmtPtpReplayFilter;
+	}
+	return (Capture->Flags & AMTPTP_DECODER_FLAG_CONTACT_ID_FROM_SLOT) ? AmtPtpReplayUsbKm : AmtPtpReplayUsbUm;
+}
+
+//
+// Brings the input state up the way each driver's PrepareHardware does.
+//
+static VOID
+AmtPtpReplayDeviceInitialize(
+	_Out_ PAMTPTP_REPLAY_DEVICE Device,
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_In_ AMTPTP_REPLAY_DRIVER Driver
+)
+{
+	const AMTPTP_DEVICE_MODEL* model = Capture->Model;
+	ULONG deviceMask = 0;
+
+	RtlZeroMemory(Device, sizeof(AMTPTP_REPLAY_DEVICE));
+	Device->Driver = Driver;
+	Device->Checksum = AMTPTP_FNV_OFFSET;
+
+	// The filter decodes USB frames with the Bluetooth layout, behind the demultiplexer
+	if (Driver == AmtPtpReplayFilter) {
+		model = AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Bluetooth);
+		AmtPtpDeviceRegistryInitDecoderConfig(model, 0, &Device->DecoderConfig);
+	} else {
+		AmtPtpCaptureInitDecoderConfig(Capture, &Device->DecoderConfig);
+	}
+
+	AmtPtpContactTrackerInitialize(&Device->ContactTracker, &Device->DecoderConfig);
+	if (Driver != AmtPtpReplaySpi) {
+		AmtPtpContactTrackerSetFuzz(&Device->ContactTracker,
+			AMTPTP_FUZZ_FROM_SNRATIO(model->X.Min, model->X.Max, model->X.SnRatio),
+			AMTPTP_FUZZ_FROM_SNRATIO(model->Y.Min, model->Y.Max, model->Y.SnRatio));
+	}
+
+	// Only the filter and the UMDF driver take the device clock
+	if (Driver == AmtPtpReplayFilter || (Driver == AmtPtpReplayUsbUm && model->Format == AmtPtpFrameFormatMt2)) {
+		deviceMask = AMTPTP_MT2_TIMESTAMP_MASK;
+	} else if (Driver == AmtPtpReplayUsbUm) {
+		deviceMask = AMTPTP_WELLSPRING_TIMESTAMP_MASK;
+	}
+
+	AmtPtpScanClockInitialize(&Device->ScanClock, deviceMask);
+	AmtPtpErrorBudgetInitialize(&Device->ErrorBudget, AMTPTP_ERROR_BUDGET_DEFAULT_WINDOW,
+		AMTPTP_ERROR_BUDGET_DEFAULT_LIMIT);
+	AmtPtpReportRingInitialize(&Device->ReportRing, AMTPTP_REPORT_RING_DEFAULT_DEPTH, AmtPtpRingOverflowCoalesce);
+	AmtPtpSplitFrameInitialize(&Device->SplitFrame, PTP_SPLIT_FRAME_TIMEOUT);
+	AmtPtpStatusCacheInitialize(&Device->StatusCache);
+}
+
+static VOID
+AmtPtpReplayCompleteReadReport(
+	_Inout_ PAMTPTP_REPLAY_DEVICE Device,
+	_In_ const AMTPTP_DECODED_FRAME* Frame
+)
+{
+	AMTPTP_REPLAY_REPORT report;
+	ULONGLONG hash = Device->Checksum;
+	UCHAR i;
+
+	AMTPTP_COMPOSE_REPORT(Frame, &report);
+
+	hash = AmtPtpReplayFold(hash, report.ScanTime);
+	hash = AmtPtpReplayFold(hash, report.ContactCount);
+	hash = AmtPtpReplayFold(hash, report.IsButtonClicked);
+	for (i = 0; i < PTP_MAX_CONTACT_POINTS; i++) {
+		hash = AmtPtpReplayFold(hash, report.Contacts[i].ContactID |
+			(report.Contacts[i].TipSwitch << 8) | (report.Contacts[i].Confidence << 16));
+		hash = AmtPtpReplayFold(hash, report.Contacts[i].X | ((ULONG) report.Contacts[i].Y << 16));
+	}
+
+	Device->Checksum = hash;
+	Device->Reports++;
+}
+
+//
+// Sends a frame to the pending read. The rest of a hybrid scan, and whatever
+// was parked before, goes out with the reads hidclass sends right after.
+//
+static VOID
+AmtPtpReplayDeliver(
+	_Inout_ PAMTPTP_REPLAY_DEVICE Device,
+	_In_ AMTPTP_DECODED_FRAME* Frame
+)
+{
+	if (Frame->ContactCount > PTP_MAX_CONTACT_POINTS) {
+		AmtPtpReportRingPushRemainder(&Device->ReportRing, Frame, PTP_MAX_CONTACT_POINTS);
+	}
+
+	AmtPtpReplayCompleteReadReport(Device, Frame);
+	while (AmtPtpReportRingPop(&Device->ReportRing, PTP_MAX_CONTACT_POINTS, Frame)) {
+		AmtPtpReplayCompleteReadReport(Device, Frame);
+	}
+}
+
+// PtpFilterInputLiftContacts, before the filter sets the mode again
+static VOID
+AmtPtpReplayLiftContacts(
+	_Inout_ PAMTPTP_REPLAY_DEVICE Device,
+	_In_ ULONGLONG HostTime
+)
+{
+	AMTPTP_DECODED_FRAME frame;
+
+	AmtPtpContactTrackerLiftAll(&Device->ContactTracker, &frame, PTP_MAX_HYBRID_CONTACT_POINTS);
+	if (frame.ContactCount == 0) {
+		return;
+	}
+
+	AmtPtpScanClockUpdate(&Device->ScanClock, &frame, HostTime);
+	AmtPtpReplayDeliver(Device, &frame);
+}
+
+static VOID
+AmtPtpReplayTouch(
+	_Inout_ PAMTPTP_REPLAY_DEVICE Device,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG HostTime
+)
+{
+	AMTPTP_DECODED_FRAME frame;
+	AMTPTP_FRAME_CHECK frameCheck;
+	AMTPTP_FRAME_VERDICT verdict;
+
+	frameCheck = AmtPtpDecodeFrameSalvage(&Device->DecoderConfig, Buffer, Length, &frame);
+	verdict = AmtPtpErrorBudgetRecord(&Device->ErrorBudget, frameCheck, HostTime);
+	if (verdict == AmtPtpFrameDrop) {
+		Device->Drops++;
+		return;
+	}
+	if (verdict == AmtPtpFrameReset) {
+		Device->Resets++;
+		if (Device->Driver == AmtPtpReplayFilter) {
+			AmtPtpReplayLiftContacts(Device, HostTime);
+		}
+		return;
+	}
+
+	AmtPtpScanClockUpdate(&Device->ScanClock, &frame, HostTime);
+	AmtPtpContactTrackerUpdate(&Device->ContactTracker, &frame, PTP_MAX_HYBRID_CONTACT_POINTS);
+	AmtPtpReplayDeliver(Device, &frame);
+}
+
+// PtpFilterDispatchReport and its handlers
+static VOID
+AmtPtpReplayFilterReport(
+	_Inout_ PAMTPTP_REPLAY_DEVICE Device,
+	_In_reads_bytes_(Length) const UCHAR* Report,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG HostTime
+)
+{
+	const UCHAR* splitBuffer;
+	SIZE_T splitLength;
+
+	switch (Report[0]) {
+	case 0x31:
+		AmtPtpReplayTouch(Device, Report, Length, HostTime);
+		break;
+	case 0xFC:
+		AmtPtpSplitFrameFirst(&Device->SplitFrame, Report + 1, Length - 1, HostTime);
+		break;
+	case 0xFE:
+		if (AmtPtpSplitFrameSecond(&Device->SplitFrame, Report + 1, Length - 1, HostTime,
+				&splitBuffer, &splitLength) == AmtPtpSplitComplete && splitBuffer[0] == 0x31) {
+			AmtPtpReplayTouch(Device, splitBuffer, splitLength, HostTime);
+		}
+		break;
+	case AMTPTP_STATUS_MOUSE:
+	case AMTPTP_STATUS_POWER_DOWN:
+	case AMTPTP_STATUS_UNKNOWN:
+	case AMTPTP_STATUS_BATTERY:
+		if (AmtPtpStatusFrameRecord(&Device->StatusCache, Report, Length) == AmtPtpStatusRearm) {
+			Device->Resets++;
+			AmtPtpReplayLiftContacts(Device, HostTime);
+		}
+		break;
+	default:
+		Device->Drops++;
+		break;
+	}
+}
+
+// PtpFilterParsePacket
+static VOID
+AmtPtpReplayFilterTransfer(
+	_Inout_ PAMTPTP_REPLAY_DEVICE Device,
+	_In_reads_bytes_(Length) const UCHAR* Buffer,
+	_In_ SIZE_T Length,
+	_In_ ULONGLONG HostTime
+)
+{
+	AMTPTP_PACKET_DEMUX demux;
+	AMTPTP_DEMUX_RESULT demuxResult;
+	const UCHAR* report;
+	SIZE_T reportLength;
+
+	if (Length > 0 && Buffer[0] != AMTPTP_DEMUX_MOUSE && Buffer[0] != AMTPTP_DEMUX_COMBINED) {
+		AmtPtpReplayFilterReport(Device, Buffer, Length, HostTime);
+		return;
+	}
+	if (AmtPtpPacketDemuxSingle(Buffer, Length, &report, &reportLength)) {
+		AmtPtpReplayFilterReport(Device, report, reportLength, HostTime);
+		return;
+	}
+
+	AmtPtpPacketDemuxBegin(&demux, Buffer, Length);
+	while ((demuxResult = AmtPtpPacketDemuxNext(&demux, &report, &reportLength)) != AmtPtpDemuxDone) {
+		if (demuxResult == AmtPtpDemuxMalformed) {
+			Device->Drops++;
+			continue;
+		}
+		AmtPtpReplayFilterReport(Device, report, reportLength, HostTime);
+	}
+}
+
+static VOID
+AmtPtpReplayTransfer(
+	_Inout_ PAMTPTP_REPLAY_DEVICE Device,
+	_In_ const AMTPTP_CAPTURE_FRAME* Frame
+)
+{
+	if (Device->Driver == AmtPtpReplayFilter) {
+		AmtPtpReplayFilterTransfer(Device, Frame->Data, Frame->Length, Frame->HostTime);
+	} else {
+		AmtPtpReplayTouch(Device, Frame->Data, Frame->Length, Frame->HostTime);
+	}
+}
+
+//
+// Hashes every transfer of the capture once, the unit the cost is given in.
+// Returns the time it took in ns.
+//
+static ULONGLONG
+AmtPtpReplayCalibrate(
+	_In_ const AMTPTP_CAPTURE* Capture
+)
+{
+	ULONGLONG start, hash = AMTPTP_FNV_OFFSET;
+	ULONG i, j;
+
+	start = AmtPtpReplayNow();
+	for (i = 0; i < Capture->FrameCount; i++) {
+		for (j = 0; j < Capture->Frames[i].Length; j++) {
+			hash = AmtPtpReplayFold(hash, Capture->Frames[i].Data[j]);
+		}
+	}
+
+	AmtPtpReplaySink ^= hash;
+	return AmtPtpReplayNow() - start;
+}
+
+static int
+AmtPtpReplayCompareLatency(
+	const void* Left,
+	const void* Right
+)
+{
+	ULONG left = *(const ULONG*) Left, right = *(const ULONG*) Right;
+	return (left > right) - (left < right);
+}
+
+static ULONG
+AmtPtpReplayPercentile(
+	_In_reads_(Count) const ULONG* Sorted,
+	_In_ SIZE_T Count,
+	_In_ ULONG PerThousand
+)
+{
+	SIZE_T index = (Count * PerThousand) / 1000;
+	return Sorted[(index < Count) ? index : Count - 1];
+}
+
+static BOOLEAN
+AmtPtpReplayCapture(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_In_ const AMTPTP_REPLAY_OPTIONS* Options,
+	_Out_ AMTPTP_REPLAY_RESULT* Result
+)
+{
+	static AMTPTP_REPLAY_DEVICE device;
+	AMTPTP_REPLAY_DRIVER driver = AmtPtpReplayDriverOf(Capture, Options);
+	const char* name = strrchr(Capture->Path, '/');
+	ULONGLONG start, elapsed, total = 0, bestPass = ~0ULL, bestHash = ~0ULL;
+	ULONG* latencies;
+	SIZE_T samples = 0;
+	ULONG pass, i;
+
+	latencies = malloc((SIZE_T) Capture->FrameCount * Options->Iterations * sizeof(ULONG));
+	if (latencies == NULL || Capture->FrameCount == 0) {
+		free(latencies);
+		return FALSE;
+	}
+
+	RtlZeroMemory(Result, sizeof(AMTPTP_REPLAY_RESULT));
+	snprintf(Result->Name, sizeof(Result->Name), "%s", (name != NULL) ? name + 1 : Capture->Path);
+
+	// Each iteration times one whole pass, one pass frame by frame for the
+	// percentiles, and the calibration next to them on the same clock speed
+	for (pass = 0; pass < Options->Iterations; pass++) {
+		AmtPtpReplayDeviceInitialize(&device, Capture, driver);
+		start = AmtPtpReplayNow();
+		for (i = 0; i < Capture->FrameCount; i++) {
+			AmtPtpReplayTransfer(&device, &Capture->Frames[i]);
+		}
+		elapsed = AmtPtpReplayNow() - start;
+		total += elapsed;
+		bestPass = (elapsed < bestPass) ? elapsed : bestPass;
+
+		// Every pass starts from scratch, so every pass has to compose the same reports
+		if (pass == 0) {
+			Result->Reports = device.Reports;
+			Result->Checksum = device.Checksum;
+		} else if (device.Reports != Result->Reports || device.Checksum != Result->Checksum) {
+			fprintf(stderr, "%s: pass %u composed different reports\n", Result->Name, pass);
+			free(latencies);
+			return FALSE;
+		}
+
+		AmtPtpReplayDeviceInitialize(&device, Capture, driver);
+		for (i = 0; i < Capture->FrameCount; i++) {
+			start = AmtPtpReplayNow();
+			AmtPtpReplayTransfer(&device, &Capture->Frames[i]);
+			latencies[samples++] = (ULONG) (AmtPtpReplayNow() - start);
+		}
+
+		elapsed = AmtPtpReplayCalibrate(Capture);
+		bestHash = (elapsed < bestHash) ? elapsed : bestHash;
+	}
+
+	Result->Cost = (double) bestPass / (double) (bestHash ? bestHash : 1);
+
+	qsort(latencies, samples, sizeof(ULONG), AmtPtpReplayCompareLatency);
+	printf("%s (%s): %u transfers, %u reports, %u dropped, %u resets, checksum %016llx\n",
+		Result->Name, AmtPtpReplayDriverNames[driver], Capture->FrameCount, Result->Reports, device.Drops,
+		device.Resets, Result->Checksum);
+	printf("  %.1f ns/transfer, %.0f transfers/s, p50 %u ns, p99 %u ns, p999 %u ns, cost %.2f\n",
+		(double) total / samples, samples * 1e9 / (double) total,
+		AmtPtpReplayPercentile(latencies, samples, 500),
+		AmtPtpReplayPercentile(latencies, samples, 990),
+		AmtPtpReplayPercentile(latencies, samples, 999),
+		Result->Cost);
+
+	free(latencies);
+	return TRUE;
+}
+
+static ULONG
+AmtPtpReplayLoadBaseline(
+	_In_ const char* Path,
+	_Out_writes_(AMTPTP_REPLAY_MAX_CAPTURES) AMTPTP_REPLAY_RESULT* Baseline
+)
+{
+	char line[256];
+	ULONG count = 0;
+	FILE* file = fopen(Path, "r");
+
+	if (file == NULL) {
+		return 0;
+	}
+
+	while (count < AMTPTP_REPLAY_MAX_CAPTURES && fgets(line, sizeof(line), file) != NULL) {
+		AMTPTP_REPLAY_RESULT* entry = &Baseline[count];
+		if (line[0] == '#') {
+			continue;
+		}
+		if (sscanf(line, "%63s %u %llx %lf", entry->Name, &entry->Reports, &entry->Checksum, &entry->Cost) == 4) {
+			count++;
+		}
+	}
+
+	fclose(file);
+	return count;
+}
+
+static BOOLEAN
+AmtPtpReplayWriteBaseline(
+	_In_ const char* Path,
+	_In_reads_(Count) const AMTPTP_REPLAY_RESULT* Results,
+	_In_ ULONG Count
+)
+{
+	FILE* file = fopen(Path, "w");
+	ULONG i;
+
+	if (file == NULL) {
+		fprintf(stderr, "%s: cannot write\n", Path);
+		return FALSE;
+	}
+
+	fprintf(file, "# AmtPtpReplay baseline, written by AmtPtpReplay --update\n");
+	fprintf(file, "# capture, reports, report checksum, cost relative to hashing the capture\n");
+	for (i = 0; i < Count; i++) {
+		fprintf(file, "%s %u %016llx %.2f\n", Results[i].Name, Results[i].Reports, Results[i].Checksum,
+			Results[i].Cost);
+	}
+
+	fclose(file);
+	return TRUE;
+}
+
+static const AMTPTP_REPLAY_RESULT*
+AmtPtpReplayFindBaseline(
+	_In_reads_(Count) const AMTPTP_REPLAY_RESULT* Baseline,
+	_In_ ULONG Count,
+	_In_ const char* Name
+)
+{
+	ULONG i;
+
+	for (i = 0; i < Count; i++) {
+		if (strcmp(Baseline[i].Name, Name) == 0) {
+			return &Baseline[i];
+		}
+	}
+	return NULL;
+}
+
+static __inline double
+AmtPtpReplayCostLimit(
+	_In_ const AMTPTP_REPLAY_OPTIONS* Options,
+	_In_ const AMTPTP_REPLAY_RESULT* Entry
+)
+{
+	return Entry->Cost * (100 + Options->Threshold) / 100;
+}
+
+//
+// Reports have to match the baseline exactly, the cost within the threshold.
+//
+static BOOLEAN
+AmtPtpReplayCheckBaseline(
+	_In_ const AMTPTP_REPLAY_OPTIONS* Options,
+	_In_reads_(BaselineCount) const AMTPTP_REPLAY_RESULT* Baseline,
+	_In_ ULONG BaselineCount,
+	_In_ const AMTPTP_REPLAY_RESULT* Result
+)
+{
+	const AMTPTP_REPLAY_RESULT* entry = AmtPtpReplayFindBaseline(Baseline, BaselineCount, Result->Name);
+	BOOLEAN passed = TRUE;
+
+	if (entry == NULL) {
+		fprintf(stderr, "%s: not in %s\n", Result->Name, Options->Baseline);
+		return FALSE;
+	}
+
+	if (entry->Reports != Result->Reports || entry->Checksum != Result->Checksum) {
+		fprintf(stderr, "%s: reports changed, %u reports %016llx, baseline %u reports %016llx\n",
+			Result->Name, Result->Reports, Result->Checksum, entry->Reports, entry->Checksum);
+		passed = FALSE;
+	}
+
+	if (Result->Cost > AmtPtpReplayCostLimit(Options, entry)) {
+		fprintf(stderr, "%s: cost %.2f, baseline %.2f, limit %.2f\n",
+			Result->Name, Result->Cost, entry->Cost, AmtPtpReplayCostLimit(Options, entry));
+		passed = FALSE;
+	}
+
+	return passed;
+}
+
+//
+// A slow round is more often a busy machine than slow code. A baseline is
+// written from the median of AMTPTP_REPLAY_ROUNDS rounds, and a capture over
+// its limit gets as many rounds, keeping the best, before it fails.
+//
+static BOOLEAN
+AmtPtpReplayNeedsRound(
+	_In_ const AMTPTP_REPLAY_OPTIONS* Options,
+	_In_reads_(BaselineCount) const AMTPTP_REPLAY_RESULT* Baseline,
+	_In_ ULONG BaselineCount,
+	_In_ const AMTPTP_REPLAY_RESULT* Result
+)
+{
+	const AMTPTP_REPLAY_RESULT* entry;
+
+	if (Options->Baseline == NULL) {
+		return FALSE;
+	}
+	if (Options->Update) {
+		return TRUE;
+	}
+
+	entry = AmtPtpReplayFindBaseline(Baseline, BaselineCount, Result->Name);
+	return entry != NULL && Result->Cost > AmtPtpReplayCostLimit(Options, entry);
+}
+
+static double
+AmtPtpReplayMedian(
+	_Inout_updates_(Count) double* Costs,
+	_In_ ULONG Count
+)
+{
+	ULONG i, j;
+	double cost;
+
+	for (i = 1; i < Count; i++) {
+		cost = Costs[i];
+		for (j = i; j > 0 && Costs[j - 1] > cost; j--) {
+			Costs[j] = Costs[j - 1];
+		}
+		Costs[j] = cost;
+	}
+	return Costs[Count / 2];
+}
+
+static int
+AmtPtpReplayUsage(VOID)
+{
+	fprintf(stderr, "usage: AmtPtpReplay [--iterations N] [--filter] [--baseline FILE [--threshold PCT] [--update]] "
+		"capture...\n");
+	return 2;
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	static AMTPTP_REPLAY_RESULT results[AMTPTP_REPLAY_MAX_CAPTURES];
+	static AMTPTP_REPLAY_RESULT baseline[AMTPTP_REPLAY_MAX_CAPTURES];
+	AMTPTP_REPLAY_RESULT retry;
+	double costs[AMTPTP_REPLAY_ROUNDS];
+	AMTPTP_REPLAY_OPTIONS options = {
+		AMTPTP_REPLAY_DEFAULT_ITERATIONS, FALSE, NULL, AMTPTP_REPLAY_DEFAULT_THRESHOLD, FALSE
+	};
+	AMTPTP_CAPTURE capture;
+	ULONG count = 0, baselineCount = 0, round;
+	BOOLEAN passed = TRUE, replayed;
+	int i;
+
+	for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			options.Iterations = (ULONG) strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+			options.Threshold = (ULONG) strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+			options.Baseline = argv[++i];
+		} else if (strcmp(argv[i], "--filter") == 0) {
+			options.Filter = TRUE;
+		} else if (strcmp(argv[i], "--update") == 0) {
+			options.Update = TRUE;
+		} else {
+			return AmtPtpReplayUsage();
+		}
+	}
+
+	if (i == argc || options.Iterations == 0 || (options.Update && options.Baseline == NULL)) {
+		return AmtPtpReplayUsage();
+	}
+
+	if (options.Baseline != NULL && !options.Update) {
+		baselineCount = AmtPtpReplayLoadBaseline(options.Baseline, baseline);
+	}
+
+	for (; i < argc && count < AMTPTP_REPLAY_MAX_CAPTURES; i++) {
+		if (!AmtPtpCaptureLoad(argv[i], &capture)) {
+			passed = FALSE;
+			continue;
+		}
+
+		replayed = AmtPtpReplayCapture(&capture, &options, &results[count]);
+		costs[0] = results[count].Cost;
+		for (round = 1; replayed && round < AMTPTP_REPLAY_ROUNDS &&
+				AmtPtpReplayNeedsRound(&options, baseline, baselineCount, &results[count]); round++) {
+			replayed = AmtPtpReplayCapture(&capture, &options, &retry);
+			costs[round] = retry.Cost;
+			if (replayed && retry.Cost < results[count].Cost) {
+				results[count].Cost = retry.Cost;
+			}
+		}
+		AmtPtpCaptureFree(&capture);
+
+		if (replayed && options.Update) {
+			results[count].Cost = AmtPtpReplayMedian(costs, round);
+		}
+
+		if (!replayed) {
+			passed = FALSE;
+			continue;
+		}
+		if (options.Baseline != NULL && !options.Update &&
+			!AmtPtpReplayCheckBaseline(&options, baseline, baselineCount, &results[count])) {
+			passed = FALSE;
+		}
+		count++;
+	}
+
+	if (options.Update) {
+		passed = passed && AmtPtpReplayWriteBaseline(options.Baseline, results, count);
+	}
+
+	return passed ? 0 : 1;
+}
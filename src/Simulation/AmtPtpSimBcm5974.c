@@ -0,0 +1,312 @@
+// AmtPtpSimBcm5974.c: A bcm5974 trackpad on the WDF stand-in, see AmtPtpSimBcm5974.h
+
+#include <AmtPtpSimBcm5974.h>
+
+#define AMTPTP_SIM_BCM5974_MODE_READ	1
+#define AMTPTP_SIM_BCM5974_MODE_WRITE	9
+
+#define AMTPTP_SIM_BCM5974_INTERVAL		(8 * 10000)	/* 125 Hz, like the real pads */
+#define AMTPTP_SIM_BCM5974_LATENCY		10000		/* one full speed frame */
+
+#define AMTPTP_SIM_BCM5974_STATE_TOUCHING	4
+#define AMTPTP_SIM_BCM5974_FINGER_INDEX		2
+
+static VOID
+AmtPtpSimBcm5974Put16(
+	_Out_writes_bytes_(2) PUCHAR Buffer,
+	_In_ USHORT Value
+)
+{
+	Buffer[0] = (UCHAR) Value;
+	Buffer[1] = (UCHAR) (Value >> 8);
+}
+
+//
+// Fingers move along the pad from frame to frame, each on its own path,
+// always within the model's range
+//
+static VOID
+AmtPtpSimBcm5974Position(
+	_In_ const AMTPTP_SIM_BCM5974* Bcm,
+	_In_ ULONG Finger,
+	_Out_ LONG* X,
+	_Out_ LONG* Y
+)
+{
+	const AMTPTP_DEVICE_MODEL* model = Bcm->Model;
+
+	*X = model->X.Min + (LONG) ((Bcm->Frame * 13 + Finger * 997) % (ULONG) (model->X.Max - model->X.Min));
+	*Y = model->Y.Min + (LONG) ((Bcm->Frame * 7 + Finger * 541) % (ULONG) (model->Y.Max - model->Y.Min));
+}
+
+static size_t
+AmtPtpSimBcm5974EncodeWellspring(
+	_In_ const AMTPTP_SIM_BCM5974* Bcm,
+	_In_ ULONG Contacts,
+	_In_ ULONG Milliseconds,
+	_Out_writes_bytes_(Length) PUCHAR Buffer,
+	_In_ size_t Length
+)
+{
+	const AMTPTP_DEVICE_MODEL* model = Bcm->Model;
+	PUCHAR finger;
+	LONG x, y;
+	ULONG i;
+
+	RtlZeroMemory(Buffer, Length);
+	Buffer[0] = 0x02;
+	Buffer[2] = (UCHAR) model->HeaderSize;
+	Buffer[AMTPTP_WELLSPRING_TIMESTAMP_OFFSET] = (UCHAR) Milliseconds;
+	Buffer[model->ButtonOffset] = Bcm->Button;
+
+	for (i = 0; i < Contacts; i++) {
+		finger = Buffer + model->HeaderSize + i * model->FingerSize;
+		AmtPtpSimBcm5974Position(Bcm, i, &x, &y);
+		finger[AMTPTP_WELLSPRING_FINGER_ID] = (UCHAR) (i + 1);
+		finger[AMTPTP_WELLSPRING_FINGER_STATE] = AMTPTP_SIM_BCM5974_STATE_TOUCHING;
+		finger[AMTPTP_WELLSPRING_FINGER_CLASS] = AMTPTP_SIM_BCM5974_FINGER_INDEX;
+		AmtPtpSimBcm5974Put16(finger + AMTPTP_WELLSPRING_FINGER_ABS_X, (USHORT) x);
+		AmtPtpSimBcm5974Put16(finger + AMTPTP_WELLSPRING_FINGER_ABS_Y, (USHORT) y);
+		AmtPtpSimBcm5974Put16(finger + AMTPTP_WELLSPRING_FINGER_TOUCH_MAJOR, 40);
+		AmtPtpSimBcm5974Put16(finger + AMTPTP_WELLSPRING_FINGER_TOUCH_MINOR, 32);
+		AmtPtpSimBcm5974Put16(finger + AMTPTP_WELLSPRING_FINGER_PRESSURE, 60);
+	}
+	return model->HeaderSize + Contacts * model->FingerSize;
+}
+
+// Report 0x31 behind the 8 byte mouse report, 13 bit coordinates with Y up
+static size_t
+AmtPtpSimBcm5974EncodeMt2(
+	_In_ const AMTPTP_SIM_BCM5974* Bcm,
+	_In_ ULONG Contacts,
+	_In_ ULONG Milliseconds,
+	_Out_writes_bytes_(Length) PUCHAR Buffer,
+	_In_ size_t Length
+)
+{
+	ULONG timestamp = Milliseconds & AMTPTP_MT2_TIMESTAMP_MASK;
+	PUCHAR finger;
+	ULONG coordinates;
+	LONG x, y;
+	ULONG i;
+
+	RtlZeroMemory(Buffer, Length);
+	Buffer[0] = 0x02;
+	Buffer[8] = 0x31;
+	Buffer[9] = (UCHAR) ((Bcm->Button & 1) | ((timestamp & 0x1F) << 3));
+	AmtPtpSimBcm5974Put16(Buffer + 10, (USHORT) (timestamp >> 5));
+
+	for (i = 0; i < Contacts; i++) {
+		finger = Buffer + AMTPTP_MT2_USB_HEADER_SIZE + i * AMTPTP_MT2_FINGER_SIZE;
+		AmtPtpSimBcm5974Position(Bcm, i, &x, &y);
+		coordinates = ((ULONG) x & 0x1FFF) | (((ULONG) -y & 0x1FFF) << 13) |
+			((ULONG) AMTPTP_SIM_BCM5974_FINGER_INDEX << 26) | ((ULONG) AMTPTP_SIM_BCM5974_STATE_TOUCHING << 29);
+		AmtPtpSimBcm5974Put16(finger, (USHORT) coordinates);
+		AmtPtpSimBcm5974Put16(finger + 2, (USHORT) (coordinates >> 16));
+		finger[4] = 40;
+		finger[5] = 32;
+		finger[7] = 60;
+		finger[8] = (UCHAR) (0x40 | ((i + 1) & 0xF));
+	}
+	return AMTPTP_MT2_USB_HEADER_SIZE + Contacts * AMTPTP_MT2_FINGER_SIZE;
+}
+
+size_t
+AmtPtpSimBcm5974Encode(
+	_Inout_ AMTPTP_SIM_BCM5974* Bcm,
+	_Out_writes_bytes_(Length) PUCHAR Buffer,
+	_In_ size_t Length
+)
+{
+	ULONG contacts = (Bcm->Contacts < AMTPTP_DECODER_MAX_CONTACTS) ? Bcm->Contacts : AMTPTP_DECODER_MAX_CONTACTS;
+	ULONG milliseconds = (ULONG) (AmtPtpSimNow() / 10000);
+	size_t written;
+
+	if (Length < Bcm->Model->TransferLength) {
+		AmtPtpSimFail("%u byte frame buffer, %s frames take up to %u", (ULONG) Length, Bcm->Model->Name,
+			Bcm->Model->TransferLength);
+	}
+
+	if (!Bcm->Wellspring) {
+		RtlZeroMemory(Buffer, AMTPTP_SIM_BCM5974_MOUSE_REPORT_SIZE);
+		Buffer[0] = 0x01;
+		Buffer[1] = Bcm->Button;
+		Buffer[2] = (UCHAR) (Bcm->Frame & 0x7);
+		written = AMTPTP_SIM_BCM5974_MOUSE_REPORT_SIZE;
+	}
+	else if (Bcm->Model->Format == AmtPtpFrameFormatMt2) {
+		written = AmtPtpSimBcm5974EncodeMt2(Bcm, contacts, milliseconds, Buffer, Length);
+	}
+	else {
+		written = AmtPtpSimBcm5974EncodeWellspring(Bcm, contacts, milliseconds, Buffer, Length);
+	}
+
+	Bcm->Frame++;
+	return written;
+}
+
+static VOID
+AmtPtpSimBcm5974Tick(
+	_In_opt_ PVOID Context
+)
+{
+	AMTPTP_SIM_BCM5974* bcm = Context;
+	UCHAR frame[AMTPTP_SIM_BCM5974_FRAME_MAX_SIZE];
+	ULONG number = bcm->Frame + 1;
+	size_t length;
+
+	bcm->Scheduled = FALSE;
+	if (!bcm->Running) {
+		return;
+	}
+
+	length = AmtPtpSimBcm5974Encode(bcm, frame, sizeof(frame));
+	if (!bcm->Wellspring) {
+		bcm->MouseReports++;
+	}
+
+	if (bcm->Faults.FailReadEvery != 0 && number % bcm->Faults.FailReadEvery == 0) {
+		bcm->Corrupted++;
+		AmtPtpSimPipePush(bcm->Device, STATUS_DEVICE_DATA_ERROR, NULL, 0);
+	}
+	else {
+		if (bcm->Wellspring && bcm->Faults.MalformEvery != 0 && number % bcm->Faults.MalformEvery == 0) {
+			bcm->Corrupted++;
+			length = bcm->Model->HeaderSize - 1;
+		}
+		AmtPtpSimPipePush(bcm->Device, STATUS_SUCCESS, frame, length);
+	}
+	bcm->FramesSent++;
+
+	bcm->Scheduled = TRUE;
+	AmtPtpSimSchedule(AmtPtpSimNow() + bcm->FrameInterval, AmtPtpSimBcm5974Tick, bcm);
+}
+
+//
+// The mode block is the one thing the control endpoint knows. Anything but a
+// class request to the interface with the registry's wValue and wIndex is
+// stalled.
+//
+static NTSTATUS
+AmtPtpSimBcm5974Control(
+	_In_opt_ PVOID Context,
+	_In_ const WDF_USB_CONTROL_SETUP_PACKET* SetupPacket,
+	_Inout_updates_(Length) PUCHAR Buffer,
+	_In_ size_t Length,
+	_Out_ ULONG_PTR* Transferred
+)
+{
+	AMTPTP_SIM_BCM5974* bcm = Context;
+	const AMTPTP_MODE_SWITCH* modeSwitch = &bcm->Model->ModeSwitch;
+	BOOLEAN read = (SetupPacket->Packet.bm.Request.Dir == BmRequestDeviceToHost);
+	BOOLEAN wellspring;
+
+	*Transferred = 0;
+	if (bcm->Faults.StallControl > 0) {
+		bcm->Faults.StallControl--;
+		return STATUS_PENDING;
+	}
+	if (bcm->Faults.FailControl > 0) {
+		bcm->Faults.FailControl--;
+		return STATUS_UNSUCCESSFUL;
+	}
+
+	if (modeSwitch->Length == 0 || Buffer == NULL || Length < modeSwitch->Length ||
+		SetupPacket->Packet.bm.Request.Type != BmRequestClass ||
+		SetupPacket->Packet.bm.Request.Recipient != BmRequestToInterface ||
+		SetupPacket->Packet.bRequest != (read ? AMTPTP_SIM_BCM5974_MODE_READ : AMTPTP_SIM_BCM5974_MODE_WRITE) ||
+		SetupPacket->Packet.wValue.Value != modeSwitch->Value ||
+		SetupPacket->Packet.wIndex.Value != modeSwitch->Index) {
+		bcm->Unexpected++;
+		return STATUS_UNSUCCESSFUL;
+	}
+
+	if (read) {
+		bcm->ModeReads++;
+		RtlCopyMemory(Buffer, bcm->ModeBlock, modeSwitch->Length);
+		*Transferred = modeSwitch->Length;
+		return STATUS_SUCCESS;
+	}
+
+	bcm->ModeWrites++;
+	*Transferred = modeSwitch->Length;
+	if (bcm->Faults.IgnoreModeWrites > 0) {
+		bcm->Faults.IgnoreModeWrites--;
+		return STATUS_SUCCESS;
+	}
+
+	RtlCopyMemory(bcm->ModeBlock, Buffer, modeSwitch->Length);
+	wellspring = (bcm->ModeBlock[modeSwitch->SwitchOffset] == modeSwitch->On);
+	if (wellspring != bcm->Wellspring) {
+		bcm->Wellspring = wellspring;
+		bcm->Switches++;
+		bcm->SwitchedAt = AmtPtpSimNow();
+	}
+	return STATUS_SUCCESS;
+}
+
+VOID
+AmtPtpSimBcm5974Attach(
+	_Out_ AMTPTP_SIM_BCM5974* Bcm,
+	_In_ WDFDEVICE Device,
+	_In_ USHORT ProductId
+)
+{
+	AMTPTP_SIM_USB_CONFIG* usb = AmtPtpSimUsbConfig(Device);
+	AMTPTP_SIM_TARGET_CONFIG* pipe = AmtPtpSimPipeConfig(Device);
+
+	RtlZeroMemory(Bcm, sizeof(AMTPTP_SIM_BCM5974));
+	Bcm->Model = AmtPtpDeviceRegistryLookup(AmtPtpBusUsb, AMTPTP_VID_APPLE_USB, ProductId);
+	if (Bcm->Model == NULL) {
+		AmtPtpSimFail("no USB trackpad 0x%04x in the registry", ProductId);
+	}
+	Bcm->Device = Device;
+	Bcm->ProductId = ProductId;
+	Bcm->FrameInterval = AMTPTP_SIM_BCM5974_INTERVAL;
+	Bcm->Contacts = 2;
+
+	// Mouse mode until the host asks, the mode byte says so
+	Bcm->Wellspring = (Bcm->Model->ModeSwitch.Length == 0);
+	if (Bcm->Model->ModeSwitch.Length != 0) {
+		Bcm->ModeBlock[Bcm->Model->ModeSwitch.SwitchOffset] = Bcm->Model->ModeSwitch.Off;
+	}
+
+	RtlZeroMemory(usb, sizeof(AMTPTP_SIM_USB_CONFIG));
+	usb->Descriptor.bLength = sizeof(USB_DEVICE_DESCRIPTOR);
+	usb->Descriptor.bDescriptorType = USB_DEVICE_DESCRIPTOR_TYPE;
+	usb->Descriptor.bcdUSB = 0x0200;
+	usb->Descriptor.bMaxPacketSize0 = 8;
+	usb->Descriptor.idVendor = AMTPTP_VID_APPLE_USB;
+	usb->Descriptor.idProduct = ProductId;
+	usb->Descriptor.iManufacturer = 1;
+	usb->Descriptor.iProduct = 2;
+	usb->Descriptor.bNumConfigurations = 1;
+	usb->Traits = WDF_USB_DEVICE_TRAIT_REMOTE_WAKE_CAPABLE;
+	usb->Control = AmtPtpSimBcm5974Control;
+	usb->Context = Bcm;
+
+	// The endpoint holds one transfer, a frame the host did not poll for is lost
+	AmtPtpSimTargetConfig(Device)->Latency = AMTPTP_SIM_BCM5974_LATENCY;
+	pipe->Latency = AMTPTP_SIM_BCM5974_LATENCY;
+	pipe->FifoDepth = 1;
+}
+
+VOID
+AmtPtpSimBcm5974Start(
+	_Inout_ AMTPTP_SIM_BCM5974* Bcm
+)
+{
+	Bcm->Running = TRUE;
+	if (!Bcm->Scheduled) {
+		Bcm->Scheduled = TRUE;
+		AmtPtpSimSchedule(AmtPtpSimNow() + Bcm->FrameInterval, AmtPtpSimBcm5974Tick, Bcm);
+	}
+}
+
+VOID
+AmtPtpSimBcm5974Stop(
+	_Inout_ AMTPTP_SIM_BCM5974* Bcm
+)
+{
+	Bcm->Running = FALSE;
+}
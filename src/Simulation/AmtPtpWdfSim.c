@@ -0,0 +1,2362 @@
+// AmtPtpWdfSim.c: WDF stand-in on a virtual clock, see AmtPtpWdfSim.h
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <TraceLoggingProvider.h>
+#include <AmtPtpWdfSim.h>
+#include <AmtPtpWdfSimTrace.h>
+#include <hidport.h>
+
+#define AMTPTP_SIM_QPC_FREQUENCY	10000000	/* the clock's own 100ns units */
+#define AMTPTP_SIM_READERS_DEFAULT	2
+#define AMTPTP_SIM_READERS_MAX		8
+#define AMTPTP_SIM_TRACE_LOG_SIZE	(16 * 1024)	/* a small in-flight recorder buffer */
+#define AMTPTP_SIM_TRACE_LINE_SIZE	256
+
+AMTPTP_SIM_STATS AmtPtpSimStats;
+BOOLEAN AmtPtpSimTraceLoggingEnabled;
+
+typedef enum _AMTPTP_SIM_OBJECT_TYPE {
+	AmtPtpSimObjectDriver,
+	AmtPtpSimObjectDevice,
+	AmtPtpSimObjectQueue,
+	AmtPtpSimObjectRequest,
+	AmtPtpSimObjectMemory,
+	AmtPtpSimObjectSpinLock,
+	AmtPtpSimObjectTimer,
+	AmtPtpSimObjectWorkItem,
+	AmtPtpSimObjectIoTarget,
+	AmtPtpSimObjectUsbDevice,
+	AmtPtpSimObjectUsbInterface,
+	AmtPtpSimObjectUsbPipe
+} AMTPTP_SIM_OBJECT_TYPE;
+
+typedef struct _AMTPTP_SIM_OBJECT AMTPTP_SIM_OBJECT;
+
+// Common to every handle, children go away with their parent
+struct _AMTPTP_SIM_OBJECT {
+	AMTPTP_SIM_OBJECT_TYPE Type;
+	AMTPTP_SIM_OBJECT*	Parent;
+	AMTPTP_SIM_OBJECT*	Children;
+	AMTPTP_SIM_OBJECT*	Sibling;
+	const WDF_OBJECT_CONTEXT_TYPE_INFO* ContextType;
+	PVOID				Context;
+	PFN_WDF_OBJECT_CONTEXT_CLEANUP Cleanup;
+	BOOLEAN				Counted;	/* created by the driver */
+};
+
+// Allocated in front of every context, for WdfObjectContextGetObject
+typedef union _AMTPTP_SIM_CONTEXT_HEADER {
+	AMTPTP_SIM_OBJECT*	Object;
+	max_align_t			Align;
+} AMTPTP_SIM_CONTEXT_HEADER;
+
+struct WDFDRIVER__ {
+	AMTPTP_SIM_OBJECT	Header;
+	PDRIVER_OBJECT		WdmDriver;
+	PFN_WDF_DRIVER_DEVICE_ADD DeviceAdd;
+};
+
+struct WDFDEVICE_INIT {
+	WDF_PNPPOWER_EVENT_CALLBACKS PnpPower;
+	BOOLEAN				Filter;
+};
+
+struct _DEVICE_OBJECT {
+	WDFDEVICE			Device;
+};
+
+struct WDFDEVICE__ {
+	AMTPTP_SIM_OBJECT	Header;
+	WDF_PNPPOWER_EVENT_CALLBACKS PnpPower;
+	DEVICE_OBJECT		WdmDevice;
+	WDFQUEUE			DefaultQueue;
+	WDFIOTARGET			Target;
+	WDFIOTARGET			PipeTarget;	/* of the interrupt pipe, if it is a USB device */
+	WDFUSBDEVICE		UsbDevice;
+	AMTPTP_SIM_USB_CONFIG Usb;
+	BOOLEAN				Prepared;
+	BOOLEAN				Started;
+};
+
+typedef enum _AMTPTP_SIM_REQUEST_STATE {
+	AmtPtpSimRequestIdle,		/* created or reused */
+	AmtPtpSimRequestFormatted,
+	AmtPtpSimRequestSent,		/* owned by the target */
+	AmtPtpSimRequestCompleted,	/* back from the target */
+	AmtPtpSimRequestOwned,		/* from hidclass, owned by the driver */
+	AmtPtpSimRequestQueued,		/* from hidclass, in a manual queue */
+	AmtPtpSimRequestDone		/* from hidclass, completed */
+} AMTPTP_SIM_REQUEST_STATE;
+
+// What a request sent to a target is, decides how the target completes it
+typedef enum _AMTPTP_SIM_REQUEST_KIND {
+	AmtPtpSimRequestIoctl,		/* answered by the target's Ioctl */
+	AmtPtpSimRequestRead,		/* matched with a transfer */
+	AmtPtpSimRequestControl		/* answered by the device's Control */
+} AMTPTP_SIM_REQUEST_KIND;
+
+typedef struct _AMTPTP_SIM_TRANSFER AMTPTP_SIM_TRANSFER;
+
+struct _AMTPTP_SIM_TRANSFER {
+	AMTPTP_SIM_TRANSFER* Next;
+	NTSTATUS			Status;
+	size_t				Length;
+	UCHAR				Data[];
+};
+
+struct WDFREQUEST__ {
+	AMTPTP_SIM_OBJECT	Header;
+	AMTPTP_SIM_REQUEST_STATE State;
+	AMTPTP_SIM_REQUEST_KIND Kind;
+	BOOLEAN				Incoming;
+	BOOLEAN				Cancelled;	/* completes with STATUS_CANCELLED */
+	NTSTATUS			Status;
+	ULONG_PTR			Information;
+	ULONG				IoControlCode;
+	WDF_USB_CONTROL_SETUP_PACKET Setup;	/* of a control transfer */
+	WDFMEMORY			Input;
+	WDFMEMORY			Output;
+	WDFIOTARGET			Target;
+	PFN_WDF_REQUEST_COMPLETION_ROUTINE Completion;
+	WDFCONTEXT			CompletionContext;
+	IRP					Irp;
+	WDFREQUEST			Next;		/* in a manual queue or waiting for a transfer */
+	ULONG				Sequence;	/* of the send, for reads */
+	AMTPTP_SIM_TRANSFER* Transfer;	/* matched, completes with it */
+	AMTPTP_SIM_REQUEST_DONE* Done;
+	PVOID				DoneContext;
+};
+
+struct WDFMEMORY__ {
+	AMTPTP_SIM_OBJECT	Header;
+	PVOID				Buffer;
+	size_t				Size;
+	BOOLEAN				Preallocated;
+};
+
+struct WDFQUEUE__ {
+	AMTPTP_SIM_OBJECT	Header;
+	WDFDEVICE			Device;
+	WDF_IO_QUEUE_CONFIG	Config;
+	WDFREQUEST			Head;
+	WDFREQUEST			Tail;
+};
+
+struct WDFSPINLOCK__ {
+	AMTPTP_SIM_OBJECT	Header;
+	BOOLEAN				Held;
+};
+
+struct WDFTIMER__ {
+	AMTPTP_SIM_OBJECT	Header;
+	PFN_WDF_TIMER		Callback;
+	ULONG				Generation;
+	BOOLEAN				Armed;
+};
+
+struct WDFWORKITEM__ {
+	AMTPTP_SIM_OBJECT	Header;
+	PFN_WDF_WORKITEM	Callback;
+	BOOLEAN				Enqueued;
+};
+
+struct WDFIOTARGET__ {
+	AMTPTP_SIM_OBJECT	Header;
+	WDFDEVICE			Device;
+	WDFUSBPIPE			Pipe;		/* whose continuous reader sends to it */
+	BOOLEAN				Stopped;
+	AMTPTP_SIM_TARGET_CONFIG Config;
+	WDFREQUEST			ReadHead;	/* sent, waiting for a transfer */
+	WDFREQUEST			ReadTail;
+	AMTPTP_SIM_TRANSFER* FifoHead;	/* produced, waiting for a read */
+	AMTPTP_SIM_TRANSFER* FifoTail;
+	ULONG				FifoCount;
+	ULONG				Pending;
+	ULONG				SendSequence;
+	ULONG				CompletedHigh;	/* one past the latest read sequence completed */
+	ULONG				JitterSeed;
+};
+
+struct WDFUSBDEVICE__ {
+	AMTPTP_SIM_OBJECT	Header;
+	WDFDEVICE			Device;
+	WDFUSBINTERFACE		Interface;
+};
+
+struct WDFUSBINTERFACE__ {
+	AMTPTP_SIM_OBJECT	Header;
+	WDFUSBPIPE			Pipe;
+};
+
+struct WDFUSBPIPE__ {
+	AMTPTP_SIM_OBJECT	Header;
+	WDFIOTARGET			Target;
+	WDF_USB_CONTINUOUS_READER_CONFIG Reader;	/* Size is 0 until configured */
+	WDFREQUEST			Reads[AMTPTP_SIM_READERS_MAX];
+	ULONG				ReadCount;
+};
+
+// A Win32 event, see windows.h
+typedef struct _AMTPTP_SIM_WIN32_EVENT {
+	BOOL				ManualReset;
+	BOOL				Signaled;
+} AMTPTP_SIM_WIN32_EVENT;
+
+typedef struct _AMTPTP_SIM_EVENT AMTPTP_SIM_EVENT;
+
+struct _AMTPTP_SIM_EVENT {
+	AMTPTP_SIM_EVENT*	Next;
+	ULONGLONG			Time;
+	AMTPTP_SIM_CALLBACK* Callback;
+	PVOID				Context;
+	ULONG				Tag;
+};
+
+static ULONGLONG AmtPtpSimTime;
+static AMTPTP_SIM_EVENT* AmtPtpSimEvents;
+static WDFDRIVER AmtPtpSimDriver;
+static WDFDEVICE AmtPtpSimLastDevice;
+static ULONG AmtPtpSimLocksHeld;
+static BOOLEAN AmtPtpSimResetting;
+
+VOID
+AmtPtpSimFail(
+	_In_ const char* Format,
+	...
+)
+{
+	va_list args;
+
+	fprintf(stderr, "AmtPtpWdfSim: at %llu us: ", (unsigned long long) (AmtPtpSimTime / 10));
+	va_start(args, Format);
+	vfprintf(stderr, Format, args);
+	va_end(args);
+	fputc('\n', stderr);
+	abort();
+}
+
+static PVOID
+AmtPtpSimAllocate(
+	_In_ size_t Size
+)
+{
+	PVOID memory = calloc(1, Size);
+
+	if (memory == NULL) {
+		AmtPtpSimFail("out of memory");
+	}
+	return memory;
+}
+
+VOID
+AmtPtpSimTrace(
+	_In_ ULONG Level,
+	_In_ ULONG Flag,
+	_In_ const char* Function,
+	_In_ const char* Format,
+	...
+)
+{
+	static int print = -1;
+	static char log[AMTPTP_SIM_TRACE_LOG_SIZE];
+	static SIZE_T logTail;
+	char line[AMTPTP_SIM_TRACE_LINE_SIZE];
+	int length;
+
+	UNREFERENCED_PARAMETER(Flag);
+
+	if (Level <= TRACE_LEVEL_VERBOSE) {
+		AmtPtpSimStats.Traces[Level]++;
+	}
+
+	// The recorder's copy of the line, arguments left out
+	length = snprintf(line, sizeof(line), "%s: %s", Function, Format);
+	length = (length < 0) ? 0 : (length >= (int) sizeof(line)) ? (int) sizeof(line) - 1 : length;
+	if (logTail + (SIZE_T) length > sizeof(log)) {
+		logTail = 0;
+	}
+	memcpy(log + logTail, line, (SIZE_T) length);
+	logTail += (SIZE_T) length;
+	if (print < 0) {
+		print = getenv("AMTPTP_SIM_TRACE") != NULL;
+	}
+	if (print) {
+		fprintf(stderr, "[%llu us] %s: %s\n", (unsigned long long) (AmtPtpSimTime / 10), Function, Format);
+	}
+}
+
+//
+// Clock and events
+//
+
+ULONGLONG
+AmtPtpSimNow(VOID)
+{
+	return AmtPtpSimTime;
+}
+
+ULONGLONG
+KeQueryInterruptTime(VOID)
+{
+	return AmtPtpSimTime;
+}
+
+LARGE_INTEGER
+KeQueryPerformanceCounter(
+	_Out_opt_ PLARGE_INTEGER PerformanceFrequency
+)
+{
+	LARGE_INTEGER counter;
+
+	if (PerformanceFrequency != NULL) {
+		PerformanceFrequency->QuadPart = AMTPTP_SIM_QPC_FREQUENCY;
+	}
+	counter.QuadPart = (LONGLONG) AmtPtpSimTime;
+	return counter;
+}
+
+BOOL
+QueryPerformanceCounter(
+	_Out_ LARGE_INTEGER* PerformanceCount
+)
+{
+	PerformanceCount->QuadPart = (LONGLONG) AmtPtpSimTime;
+	return TRUE;
+}
+
+BOOL
+QueryPerformanceFrequency(
+	_Out_ LARGE_INTEGER* Frequency
+)
+{
+	Frequency->QuadPart = AMTPTP_SIM_QPC_FREQUENCY;
+	return TRUE;
+}
+
+BOOL
+QueryUnbiasedInterruptTime(
+	_Out_ PULONGLONG UnbiasedTime
+)
+{
+	*UnbiasedTime = AmtPtpSimTime;
+	return TRUE;
+}
+
+static VOID
+AmtPtpSimScheduleTagged(
+	_In_ ULONGLONG Time,
+	_In_ AMTPTP_SIM_CALLBACK* Callback,
+	_In_opt_ PVOID Context,
+	_In_ ULONG Tag
+)
+{
+	AMTPTP_SIM_EVENT* event = AmtPtpSimAllocate(sizeof(AMTPTP_SIM_EVENT));
+	AMTPTP_SIM_EVENT** link = &AmtPtpSimEvents;
+
+	event->Time = (Time < AmtPtpSimTime) ? AmtPtpSimTime : Time;
+	event->Callback = Callback;
+	event->Context = Context;
+	event->Tag = Tag;
+
+	// Equal times run in the order they were scheduled
+	while (*link != NULL && (*link)->Time <= event->Time) {
+		link = &(*link)->Next;
+	}
+	event->Next = *link;
+	*link = event;
+}
+
+VOID
+AmtPtpSimSchedule(
+	_In_ ULONGLONG Time,
+	_In_ AMTPTP_SIM_CALLBACK* Callback,
+	_In_opt_ PVOID Context
+)
+{
+	AmtPtpSimScheduleTagged(Time, Callback, Context, 0);
+}
+
+//
+// Events that would run on behalf of a deleted object
+//
+static VOID
+AmtPtpSimCancelEvents(
+	_In_ PVOID Context
+)
+{
+	AMTPTP_SIM_EVENT** link = &AmtPtpSimEvents;
+	AMTPTP_SIM_EVENT* event;
+
+	while (*link != NULL) {
+		event = *link;
+		if (event->Context == Context) {
+			*link = event->Next;
+			free(event);
+		}
+		else {
+			link = &event->Next;
+		}
+	}
+}
+
+// Driver code has to release every spinlock before returning to the framework
+static VOID
+AmtPtpSimCheckLocks(
+	_In_ const char* Where
+)
+{
+	if (AmtPtpSimLocksHeld != 0) {
+		AmtPtpSimFail("%u spinlock(s) still held after %s", AmtPtpSimLocksHeld, Where);
+	}
+}
+
+static BOOLEAN
+AmtPtpSimRunNext(
+	_In_ ULONGLONG Until
+)
+{
+	AMTPTP_SIM_EVENT* event = AmtPtpSimEvents;
+
+	if (event == NULL || event->Time > Until) {
+		return FALSE;
+	}
+
+	AmtPtpSimEvents = event->Next;
+	AmtPtpSimTime = event->Time;
+	AmtPtpSimStats.Events++;
+	if (event->Tag != 0) {
+		// Timer events carry the generation they were armed with
+		WDFTIMER timer = event->Context;
+
+		if (timer->Armed && timer->Generation == event->Tag) {
+			timer->Armed = FALSE;
+			AmtPtpSimStats.TimerFires++;
+			timer->Callback(timer);
+		}
+	}
+	else {
+		event->Callback(event->Context);
+	}
+	free(event);
+	AmtPtpSimCheckLocks("an event");
+	return TRUE;
+}
+
+ULONG
+AmtPtpSimRun(
+	_In_ ULONGLONG Until
+)
+{
+	ULONG count = 0;
+
+	while (AmtPtpSimRunNext(Until)) {
+		count++;
+	}
+	if (AmtPtpSimTime < Until) {
+		AmtPtpSimTime = Until;
+	}
+	return count;
+}
+
+ULONG
+AmtPtpSimRunAll(VOID)
+{
+	ULONG count = 0;
+
+	while (AmtPtpSimRunNext(~0ULL)) {
+		count++;
+	}
+	return count;
+}
+
+//
+// Objects
+//
+
+static PVOID
+AmtPtpSimCreateObject(
+	_In_ AMTPTP_SIM_OBJECT_TYPE Type,
+	_In_ size_t Size,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_In_opt_ PVOID DefaultParent,
+	_In_ BOOLEAN Counted
+)
+{
+	AMTPTP_SIM_OBJECT* object = AmtPtpSimAllocate(Size);
+	AMTPTP_SIM_OBJECT* parent = DefaultParent;
+	AMTPTP_SIM_CONTEXT_HEADER* context;
+	size_t contextSize;
+
+	object->Type = Type;
+	object->Counted = Counted;
+	if (Attributes != NULL) {
+		if (Attributes->ParentObject != NULL) {
+			parent = Attributes->ParentObject;
+		}
+		object->Cleanup = Attributes->EvtCleanupCallback;
+		object->ContextType = Attributes->ContextTypeInfo;
+		if (object->ContextType != NULL) {
+			contextSize = Attributes->ContextSizeOverride ? Attributes->ContextSizeOverride : object->ContextType->ContextSize;
+			context = AmtPtpSimAllocate(sizeof(AMTPTP_SIM_CONTEXT_HEADER) + contextSize);
+			context->Object = object;
+			object->Context = context + 1;
+		}
+	}
+
+	if (parent != NULL) {
+		object->Parent = parent;
+		object->Sibling = parent->Children;
+		parent->Children = object;
+	}
+	if (Counted) {
+		AmtPtpSimStats.Created++;
+	}
+	return object;
+}
+
+static VOID
+AmtPtpSimFreeTransfers(
+	_In_ WDFIOTARGET Target
+)
+{
+	AMTPTP_SIM_TRANSFER* transfer;
+
+	while (Target->FifoHead != NULL) {
+		transfer = Target->FifoHead;
+		Target->FifoHead = transfer->Next;
+		free(transfer);
+	}
+	Target->FifoTail = NULL;
+	Target->FifoCount = 0;
+}
+
+static VOID
+AmtPtpSimDeleteObject(
+	_In_ AMTPTP_SIM_OBJECT* Object
+)
+{
+	AMTPTP_SIM_OBJECT** link;
+
+	if (!AmtPtpSimResetting) {
+		if (Object->Type == AmtPtpSimObjectRequest && ((WDFREQUEST) Object)->State == AmtPtpSimRequestSent) {
+			AmtPtpSimFail("deleting a request the target still owns");
+		}
+		if (Object->Type == AmtPtpSimObjectRequest && ((WDFREQUEST) Object)->Incoming) {
+			AmtPtpSimFail("deleting a request hidclass owns");
+		}
+	}
+
+	while (Object->Children != NULL) {
+		AmtPtpSimDeleteObject(Object->Children);
+	}
+	if (Object->Cleanup != NULL) {
+		Object->Cleanup(Object);
+	}
+
+	if (Object->Parent != NULL) {
+		for (link = &Object->Parent->Children; *link != Object; link = &(*link)->Sibling);
+		*link = Object->Sibling;
+	}
+
+	switch (Object->Type) {
+	case AmtPtpSimObjectMemory:
+		if (!((WDFMEMORY) Object)->Preallocated) {
+			free(((WDFMEMORY) Object)->Buffer);
+		}
+		break;
+	case AmtPtpSimObjectRequest:
+		free(((WDFREQUEST) Object)->Transfer);
+		break;
+	case AmtPtpSimObjectIoTarget:
+		AmtPtpSimFreeTransfers((WDFIOTARGET) Object);
+		break;
+	case AmtPtpSimObjectUsbPipe:
+		((WDFUSBPIPE) Object)->Target->Pipe = NULL;
+		break;
+	case AmtPtpSimObjectSpinLock:
+		if (((WDFSPINLOCK) Object)->Held && !AmtPtpSimResetting) {
+			AmtPtpSimFail("deleting a held spinlock");
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (Object->Counted) {
+		AmtPtpSimStats.Deleted++;
+	}
+	AmtPtpSimCancelEvents(Object);
+	if (Object->Context != NULL) {
+		free((AMTPTP_SIM_CONTEXT_HEADER*) Object->Context - 1);
+	}
+	free(Object);
+}
+
+VOID
+WdfObjectDelete(
+	_In_ WDFOBJECT Object
+)
+{
+	AmtPtpSimDeleteObject(Object);
+}
+
+PVOID
+WdfObjectGetTypedContextWorker(
+	_In_ WDFOBJECT Handle,
+	_In_ const WDF_OBJECT_CONTEXT_TYPE_INFO* TypeInfo
+)
+{
+	AMTPTP_SIM_OBJECT* object = Handle;
+
+	if (object == NULL || object->ContextType == NULL || strcmp(object->ContextType->ContextName, TypeInfo->ContextName) != 0) {
+		AmtPtpSimFail("object has no %s context", TypeInfo->ContextName);
+	}
+	return object->Context;
+}
+
+WDFOBJECT
+WdfObjectContextGetObject(
+	_In_ PVOID ContextPointer
+)
+{
+	return ((AMTPTP_SIM_CONTEXT_HEADER*) ContextPointer - 1)->Object;
+}
+
+VOID
+AmtPtpSimReset(VOID)
+{
+	AMTPTP_SIM_EVENT* event;
+
+	while (AmtPtpSimEvents != NULL) {
+		event = AmtPtpSimEvents;
+		AmtPtpSimEvents = event->Next;
+		free(event);
+	}
+
+	AmtPtpSimResetting = TRUE;
+	if (AmtPtpSimDriver != NULL) {
+		AmtPtpSimDeleteObject(&AmtPtpSimDriver->Header);
+	}
+	AmtPtpSimResetting = FALSE;
+
+	AmtPtpSimDriver = NULL;
+	AmtPtpSimLastDevice = NULL;
+	AmtPtpSimLocksHeld = 0;
+	AmtPtpSimTime = 0;
+	RtlZeroMemory(&AmtPtpSimStats, sizeof(AmtPtpSimStats));
+}
+
+//
+// Driver and device
+//
+
+NTSTATUS
+WdfDriverCreate(
+	_In_ PDRIVER_OBJECT DriverObject,
+	_In_ PUNICODE_STRING RegistryPath,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES DriverAttributes,
+	_In_ PWDF_DRIVER_CONFIG DriverConfig,
+	_Out_opt_ WDFDRIVER* Driver
+)
+{
+	UNREFERENCED_PARAMETER(RegistryPath);
+
+	if (AmtPtpSimDriver != NULL) {
+		AmtPtpSimFail("WdfDriverCreate called twice");
+	}
+
+	AmtPtpSimDriver = AmtPtpSimCreateObject(AmtPtpSimObjectDriver, sizeof(struct WDFDRIVER__), DriverAttributes, NULL, FALSE);
+	AmtPtpSimDriver->WdmDriver = DriverObject;
+	AmtPtpSimDriver->DeviceAdd = DriverConfig->EvtDriverDeviceAdd;
+	if (Driver != NULL) {
+		*Driver = AmtPtpSimDriver;
+	}
+	return STATUS_SUCCESS;
+}
+
+PDRIVER_OBJECT
+WdfDriverWdmGetDriverObject(
+	_In_ WDFDRIVER Driver
+)
+{
+	return Driver->WdmDriver;
+}
+
+VOID
+WdfFdoInitSetFilter(
+	_In_ PWDFDEVICE_INIT DeviceInit
+)
+{
+	DeviceInit->Filter = TRUE;
+}
+
+VOID
+WdfDeviceInitSetPnpPowerEventCallbacks(
+	_In_ PWDFDEVICE_INIT DeviceInit,
+	_In_ PWDF_PNPPOWER_EVENT_CALLBACKS PnpPowerEventCallbacks
+)
+{
+	DeviceInit->PnpPower = *PnpPowerEventCallbacks;
+}
+
+NTSTATUS
+WdfDeviceCreate(
+	_Inout_ PWDFDEVICE_INIT* DeviceInit,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES DeviceAttributes,
+	_Out_ WDFDEVICE* Device
+)
+{
+	WDFDEVICE device;
+
+	device = AmtPtpSimCreateObject(AmtPtpSimObjectDevice, sizeof(struct WDFDEVICE__), DeviceAttributes,
+		AmtPtpSimDriver, TRUE);
+	device->PnpPower = (*DeviceInit)->PnpPower;
+	device->WdmDevice.Device = device;
+	device->Target = AmtPtpSimCreateObject(AmtPtpSimObjectIoTarget, sizeof(struct WDFIOTARGET__), NULL, device, FALSE);
+	device->Target->Device = device;
+	device->Target->JitterSeed = 1;
+
+	// Used once the driver opens the device as a USB one, stopped until then
+	device->PipeTarget = AmtPtpSimCreateObject(AmtPtpSimObjectIoTarget, sizeof(struct WDFIOTARGET__), NULL, device, FALSE);
+	device->PipeTarget->Device = device;
+	device->PipeTarget->Stopped = TRUE;
+	device->PipeTarget->JitterSeed = 1;
+
+	free(*DeviceInit);
+	*DeviceInit = NULL;
+	AmtPtpSimLastDevice = device;
+	*Device = device;
+	return STATUS_SUCCESS;
+}
+
+PDEVICE_OBJECT
+WdfDeviceWdmGetDeviceObject(
+	_In_ WDFDEVICE Device
+)
+{
+	return &Device->WdmDevice;
+}
+
+NTSTATUS
+WdfDeviceCreateDeviceInterface(
+	_In_ WDFDEVICE Device,
+	_In_ const GUID* InterfaceClassGUID,
+	_In_opt_ PUNICODE_STRING ReferenceString
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(InterfaceClassGUID);
+	UNREFERENCED_PARAMETER(ReferenceString);
+	return STATUS_SUCCESS;
+}
+
+WDFIOTARGET
+WdfDeviceGetIoTarget(
+	_In_ WDFDEVICE Device
+)
+{
+	return Device->Target;
+}
+
+VOID
+WdfDeviceSetPnpCapabilities(
+	_In_ WDFDEVICE Device,
+	_In_ PWDF_DEVICE_PNP_CAPABILITIES PnpCapabilities
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(PnpCapabilities);
+}
+
+VOID
+WdfDeviceSetFailed(
+	_In_ WDFDEVICE Device,
+	_In_ WDF_DEVICE_FAILED_ACTION FailedAction
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+
+	AmtPtpSimStats.DeviceFailed++;
+	AmtPtpSimStats.LastFailedAction = FailedAction;
+}
+
+NTSTATUS
+AmtPtpSimAddDevice(
+	_Out_ WDFDEVICE* Device
+)
+{
+	PWDFDEVICE_INIT deviceInit;
+	NTSTATUS status;
+
+	if (AmtPtpSimDriver == NULL || AmtPtpSimDriver->DeviceAdd == NULL) {
+		AmtPtpSimFail("no driver to add a device to, call DriverEntry first");
+	}
+
+	deviceInit = AmtPtpSimAllocate(sizeof(struct WDFDEVICE_INIT));
+	AmtPtpSimLastDevice = NULL;
+	status = AmtPtpSimDriver->DeviceAdd(AmtPtpSimDriver, deviceInit);
+	AmtPtpSimCheckLocks("EvtDriverDeviceAdd");
+
+	// Not consumed when the driver failed before WdfDeviceCreate
+	if (AmtPtpSimLastDevice == NULL) {
+		free(deviceInit);
+	}
+	*Device = AmtPtpSimLastDevice;
+	if (NT_SUCCESS(status) && *Device == NULL) {
+		AmtPtpSimFail("EvtDriverDeviceAdd succeeded without creating a device");
+	}
+	return status;
+}
+
+NTSTATUS
+AmtPtpSimPowerUp(
+	_In_ WDFDEVICE Device
+)
+{
+	WDF_PNPPOWER_EVENT_CALLBACKS* callbacks = &Device->PnpPower;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (!Device->Prepared && callbacks->EvtDevicePrepareHardware != NULL) {
+		status = callbacks->EvtDevicePrepareHardware(Device, NULL, NULL);
+		AmtPtpSimCheckLocks("EvtDevicePrepareHardware");
+		if (!NT_SUCCESS(status)) {
+			return status;
+		}
+	}
+	Device->Prepared = TRUE;
+
+	if (callbacks->EvtDeviceD0Entry != NULL) {
+		status = callbacks->EvtDeviceD0Entry(Device, Device->Started ? WdfPowerDeviceD3 : WdfPowerDeviceD3Final);
+		AmtPtpSimCheckLocks("EvtDeviceD0Entry");
+		if (!NT_SUCCESS(status)) {
+			return status;
+		}
+	}
+
+	if (!Device->Started && callbacks->EvtDeviceSelfManagedIoInit != NULL) {
+		status = callbacks->EvtDeviceSelfManagedIoInit(Device);
+		AmtPtpSimCheckLocks("EvtDeviceSelfManagedIoInit");
+	}
+	else if (Device->Started && callbacks->EvtDeviceSelfManagedIoRestart != NULL) {
+		status = callbacks->EvtDeviceSelfManagedIoRestart(Device);
+		AmtPtpSimCheckLocks("EvtDeviceSelfManagedIoRestart");
+	}
+	Device->Started = TRUE;
+	return status;
+}
+
+NTSTATUS
+AmtPtpSimPowerDown(
+	_In_ WDFDEVICE Device
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (Device->PnpPower.EvtDeviceD0Exit != NULL) {
+		status = Device->PnpPower.EvtDeviceD0Exit(Device, WdfPowerDeviceD3);
+		AmtPtpSimCheckLocks("EvtDeviceD0Exit");
+	}
+	return status;
+}
+
+//
+// Spinlocks
+//
+
+NTSTATUS
+WdfSpinLockCreate(
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES SpinLockAttributes,
+	_Out_ WDFSPINLOCK* SpinLock
+)
+{
+	*SpinLock = AmtPtpSimCreateObject(AmtPtpSimObjectSpinLock, sizeof(struct WDFSPINLOCK__), SpinLockAttributes,
+		AmtPtpSimDriver, TRUE);
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfSpinLockAcquire(
+	_In_ WDFSPINLOCK SpinLock
+)
+{
+	// One processor: a second acquire can only be a deadlock
+	if (SpinLock->Held) {
+		AmtPtpSimFail("spinlock acquired while held");
+	}
+	SpinLock->Held = TRUE;
+	AmtPtpSimLocksHeld++;
+}
+
+VOID
+WdfSpinLockRelease(
+	_In_ WDFSPINLOCK SpinLock
+)
+{
+	if (!SpinLock->Held) {
+		AmtPtpSimFail("spinlock released while not held");
+	}
+	SpinLock->Held = FALSE;
+	AmtPtpSimLocksHeld--;
+}
+
+//
+// Win32 events
+//
+
+HANDLE
+CreateEventW(
+	_In_opt_ LPSECURITY_ATTRIBUTES EventAttributes,
+	_In_ BOOL ManualReset,
+	_In_ BOOL InitialState,
+	_In_opt_ LPCWSTR Name
+)
+{
+	AMTPTP_SIM_WIN32_EVENT* event;
+
+	UNREFERENCED_PARAMETER(EventAttributes);
+
+	if (Name != NULL) {
+		AmtPtpSimFail("named events are not simulated");
+	}
+
+	event = AmtPtpSimAllocate(sizeof(AMTPTP_SIM_WIN32_EVENT));
+	event->ManualReset = ManualReset;
+	event->Signaled = InitialState;
+	return event;
+}
+
+BOOL
+SetEvent(
+	_In_ HANDLE Event
+)
+{
+	((AMTPTP_SIM_WIN32_EVENT*) Event)->Signaled = TRUE;
+	return TRUE;
+}
+
+BOOL
+ResetEvent(
+	_In_ HANDLE Event
+)
+{
+	((AMTPTP_SIM_WIN32_EVENT*) Event)->Signaled = FALSE;
+	return TRUE;
+}
+
+DWORD
+WaitForSingleObject(
+	_In_ HANDLE Handle,
+	_In_ DWORD Milliseconds
+)
+{
+	AMTPTP_SIM_WIN32_EVENT* event = Handle;
+	ULONGLONG deadline = (Milliseconds == INFINITE) ? ~0ULL : AmtPtpSimTime + (ULONGLONG) Milliseconds * 10000;
+
+	// The waiting thread holds the clock, whatever is due meanwhile runs
+	while (!event->Signaled) {
+		if (!AmtPtpSimRunNext(deadline)) {
+			if (Milliseconds == INFINITE) {
+				AmtPtpSimFail("waiting forever for an event nothing is left to set");
+			}
+			AmtPtpSimTime = deadline;
+			return WAIT_TIMEOUT;
+		}
+	}
+
+	if (!event->ManualReset) {
+		event->Signaled = FALSE;
+	}
+	return WAIT_OBJECT_0;
+}
+
+BOOL
+CloseHandle(
+	_In_ HANDLE Object
+)
+{
+	free(Object);
+	return TRUE;
+}
+
+DWORD
+GetLastError(VOID)
+{
+	return 0;
+}
+
+//
+// Memory
+//
+
+NTSTATUS
+WdfMemoryCreate(
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_In_ POOL_TYPE PoolType,
+	_In_opt_ ULONG PoolTag,
+	_In_ size_t BufferSize,
+	_Out_ WDFMEMORY* Memory,
+	_Out_opt_ PVOID* Buffer
+)
+{
+	WDFMEMORY memory;
+
+	UNREFERENCED_PARAMETER(PoolType);
+	UNREFERENCED_PARAMETER(PoolTag);
+
+	memory = AmtPtpSimCreateObject(AmtPtpSimObjectMemory, sizeof(struct WDFMEMORY__), Attributes, AmtPtpSimDriver, TRUE);
+	memory->Buffer = AmtPtpSimAllocate(BufferSize ? BufferSize : 1);
+	memory->Size = BufferSize;
+	*Memory = memory;
+	if (Buffer != NULL) {
+		*Buffer = memory->Buffer;
+	}
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfMemoryCreatePreallocated(
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_In_ PVOID Buffer,
+	_In_ size_t BufferSize,
+	_Out_ WDFMEMORY* Memory
+)
+{
+	WDFMEMORY memory;
+
+	memory = AmtPtpSimCreateObject(AmtPtpSimObjectMemory, sizeof(struct WDFMEMORY__), Attributes, AmtPtpSimDriver, TRUE);
+	memory->Buffer = Buffer;
+	memory->Size = BufferSize;
+	memory->Preallocated = TRUE;
+	*Memory = memory;
+	return STATUS_SUCCESS;
+}
+
+PVOID
+WdfMemoryGetBuffer(
+	_In_ WDFMEMORY Memory,
+	_Out_opt_ size_t* BufferSize
+)
+{
+	if (BufferSize != NULL) {
+		*BufferSize = Memory->Size;
+	}
+	return Memory->Buffer;
+}
+
+NTSTATUS
+WdfMemoryCopyToBuffer(
+	_In_ WDFMEMORY SourceMemory,
+	_In_ size_t SourceOffset,
+	_Out_writes_bytes_(NumBytesToCopyTo) PVOID Buffer,
+	_In_ size_t NumBytesToCopyTo
+)
+{
+	if (SourceOffset > SourceMemory->Size || NumBytesToCopyTo > SourceMemory->Size - SourceOffset) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+	RtlCopyMemory(Buffer, (PUCHAR) SourceMemory->Buffer + SourceOffset, NumBytesToCopyTo);
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfMemoryCopyFromBuffer(
+	_In_ WDFMEMORY DestinationMemory,
+	_In_ size_t DestinationOffset,
+	_In_reads_bytes_(NumBytesToCopyFrom) PVOID Buffer,
+	_In_ size_t NumBytesToCopyFrom
+)
+{
+	if (DestinationOffset > DestinationMemory->Size || NumBytesToCopyFrom > DestinationMemory->Size - DestinationOffset) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+	RtlCopyMemory((PUCHAR) DestinationMemory->Buffer + DestinationOffset, Buffer, NumBytesToCopyFrom);
+	return STATUS_SUCCESS;
+}
+
+//
+// Requests
+//
+
+static const char*
+AmtPtpSimRequestStateName(
+	_In_ AMTPTP_SIM_REQUEST_STATE State
+)
+{
+	static const char* names[] = { "idle", "formatted", "sent", "completed", "owned", "queued", "done" };
+	return names[State];
+}
+
+static VOID
+AmtPtpSimExpectState(
+	_In_ WDFREQUEST Request,
+	_In_ BOOLEAN Incoming,
+	_In_ ULONG States,
+	_In_ const char* Call
+)
+{
+	if (Request->Incoming != Incoming) {
+		AmtPtpSimFail("%s on a request %s", Call, Request->Incoming ? "from hidclass" : "the driver created");
+	}
+	if ((States & (1u << Request->State)) == 0) {
+		AmtPtpSimFail("%s on a %s request", Call, AmtPtpSimRequestStateName(Request->State));
+	}
+}
+
+#define AMTPTP_SIM_STATE(Name)	(1u << AmtPtpSimRequest##Name)
+
+NTSTATUS
+WdfRequestCreate(
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES RequestAttributes,
+	_In_opt_ WDFIOTARGET IoTarget,
+	_Out_ WDFREQUEST* Request
+)
+{
+	WDFREQUEST request;
+
+	request = AmtPtpSimCreateObject(AmtPtpSimObjectRequest, sizeof(struct WDFREQUEST__), RequestAttributes,
+		AmtPtpSimDriver, TRUE);
+	request->Target = IoTarget;
+	*Request = request;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRequestReuse(
+	_In_ WDFREQUEST Request,
+	_In_ PWDF_REQUEST_REUSE_PARAMS ReuseParams
+)
+{
+	AmtPtpSimExpectState(Request, FALSE, AMTPTP_SIM_STATE(Idle) | AMTPTP_SIM_STATE(Formatted) |
+		AMTPTP_SIM_STATE(Completed), "WdfRequestReuse");
+
+	Request->State = AmtPtpSimRequestIdle;
+	Request->Cancelled = FALSE;
+	Request->Status = ReuseParams->Status;
+	Request->Information = 0;
+	Request->Completion = NULL;
+	Request->CompletionContext = NULL;
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfRequestSetCompletionRoutine(
+	_In_ WDFREQUEST Request,
+	_In_opt_ PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine,
+	_In_opt_ WDFCONTEXT CompletionContext
+)
+{
+	Request->Completion = CompletionRoutine;
+	Request->CompletionContext = CompletionContext;
+}
+
+NTSTATUS
+WdfRequestGetStatus(
+	_In_ WDFREQUEST Request
+)
+{
+	return Request->Status;
+}
+
+ULONG_PTR
+WdfRequestGetInformation(
+	_In_ WDFREQUEST Request
+)
+{
+	return Request->Information;
+}
+
+VOID
+WdfRequestSetInformation(
+	_In_ WDFREQUEST Request,
+	_In_ ULONG_PTR Information
+)
+{
+	Request->Information = Information;
+}
+
+PIRP
+WdfRequestWdmGetIrp(
+	_In_ WDFREQUEST Request
+)
+{
+	return &Request->Irp;
+}
+
+NTSTATUS
+WdfRequestRetrieveOutputMemory(
+	_In_ WDFREQUEST Request,
+	_Out_ WDFMEMORY* Memory
+)
+{
+	AmtPtpSimExpectState(Request, TRUE, AMTPTP_SIM_STATE(Owned), "WdfRequestRetrieveOutputMemory");
+	if (Request->Output == NULL || Request->Output->Size == 0) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+	*Memory = Request->Output;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRequestRetrieveOutputBuffer(
+	_In_ WDFREQUEST Request,
+	_In_ size_t MinimumRequiredSize,
+	_Out_ PVOID* Buffer,
+	_Out_opt_ size_t* Length
+)
+{
+	AmtPtpSimExpectState(Request, TRUE, AMTPTP_SIM_STATE(Owned), "WdfRequestRetrieveOutputBuffer");
+	if (Request->Output == NULL || Request->Output->Size == 0 || Request->Output->Size < MinimumRequiredSize) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+	*Buffer = Request->Output->Buffer;
+	if (Length != NULL) {
+		*Length = Request->Output->Size;
+	}
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRequestRetrieveInputMemory(
+	_In_ WDFREQUEST Request,
+	_Out_ WDFMEMORY* Memory
+)
+{
+	AmtPtpSimExpectState(Request, TRUE, AMTPTP_SIM_STATE(Owned), "WdfRequestRetrieveInputMemory");
+	if (Request->Input == NULL || Request->Input->Size == 0) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+	*Memory = Request->Input;
+	return STATUS_SUCCESS;
+}
+
+static VOID
+AmtPtpSimHidclassDone(
+	_In_opt_ PVOID Context
+)
+{
+	WDFREQUEST request = Context;
+
+	request->Done(request->DoneContext, request->Status, request->Information,
+		(request->Output != NULL) ? request->Output->Buffer : NULL);
+
+	// Hidclass is done with it, the event list no longer refers to it
+	request->Incoming = FALSE;
+	request->State = AmtPtpSimRequestIdle;
+	AmtPtpSimDeleteObject(&request->Header);
+}
+
+VOID
+WdfRequestComplete(
+	_In_ WDFREQUEST Request,
+	_In_ NTSTATUS Status
+)
+{
+	AmtPtpSimExpectState(Request, TRUE, AMTPTP_SIM_STATE(Owned), "WdfRequestComplete");
+
+	Request->State = AmtPtpSimRequestDone;
+	Request->Status = Status;
+	if (!NT_SUCCESS(Status)) {
+		Request->Information = 0;
+	}
+	else if (Request->Output != NULL && Request->Information > Request->Output->Size) {
+		AmtPtpSimFail("request completed with %zu bytes into a %zu byte buffer", (size_t) Request->Information,
+			Request->Output->Size);
+	}
+	AmtPtpSimSchedule(AmtPtpSimTime, AmtPtpSimHidclassDone, Request);
+}
+
+static WDFMEMORY
+AmtPtpSimCreateRequestMemory(
+	_In_ WDFREQUEST Request,
+	_In_ size_t Size
+)
+{
+	WDFMEMORY memory;
+
+	memory = AmtPtpSimCreateObject(AmtPtpSimObjectMemory, sizeof(struct WDFMEMORY__), NULL, Request, FALSE);
+	memory->Buffer = AmtPtpSimAllocate(Size ? Size : 1);
+	memory->Size = Size;
+	return memory;
+}
+
+VOID
+AmtPtpSimSendIoctl(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG IoControlCode,
+	_In_reads_bytes_(InputLength) const VOID* Input,
+	_In_ size_t InputLength,
+	_In_ size_t OutputLength,
+	_In_ AMTPTP_SIM_REQUEST_DONE* Done,
+	_In_opt_ PVOID Context
+)
+{
+	WDFQUEUE queue = Device->DefaultQueue;
+	WDFREQUEST request;
+
+	if (queue == NULL || (queue->Config.EvtIoInternalDeviceControl == NULL && queue->Config.EvtIoDeviceControl == NULL)) {
+		AmtPtpSimFail("device has no default queue for device controls");
+	}
+
+	// Hidclass allocations are not the driver's
+	request = AmtPtpSimCreateObject(AmtPtpSimObjectRequest, sizeof(struct WDFREQUEST__), NULL, Device, FALSE);
+	if (InputLength != 0) {
+		request->Input = AmtPtpSimCreateRequestMemory(request, InputLength);
+		RtlCopyMemory(request->Input->Buffer, Input, InputLength);
+	}
+	request->Output = AmtPtpSimCreateRequestMemory(request, OutputLength);
+
+	request->Incoming = TRUE;
+	request->State = AmtPtpSimRequestOwned;
+	request->IoControlCode = IoControlCode;
+	request->Done = Done;
+	request->DoneContext = Context;
+
+	if (queue->Config.EvtIoInternalDeviceControl != NULL) {
+		queue->Config.EvtIoInternalDeviceControl(queue, request, OutputLength, InputLength, IoControlCode);
+		AmtPtpSimCheckLocks("EvtIoInternalDeviceControl");
+	}
+	else {
+		queue->Config.EvtIoDeviceControl(queue, request, OutputLength, InputLength, IoControlCode);
+		AmtPtpSimCheckLocks("EvtIoDeviceControl");
+	}
+}
+
+//
+// Queues
+//
+
+NTSTATUS
+WdfIoQueueCreate(
+	_In_ WDFDEVICE Device,
+	_In_ PWDF_IO_QUEUE_CONFIG Config,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES QueueAttributes,
+	_Out_opt_ WDFQUEUE* Queue
+)
+{
+	WDFQUEUE queue;
+
+	if (Config->DispatchType != WdfIoQueueDispatchManual && !Config->DefaultQueue) {
+		AmtPtpSimFail("only the default queue and manual queues are simulated");
+	}
+	if (Config->DefaultQueue && Device->DefaultQueue != NULL) {
+		AmtPtpSimFail("second default queue");
+	}
+
+	queue = AmtPtpSimCreateObject(AmtPtpSimObjectQueue, sizeof(struct WDFQUEUE__), QueueAttributes, Device, TRUE);
+	queue->Device = Device;
+	queue->Config = *Config;
+	if (Config->DefaultQueue) {
+		Device->DefaultQueue = queue;
+	}
+	if (Queue != NULL) {
+		*Queue = queue;
+	}
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfRequestForwardToIoQueue(
+	_In_ WDFREQUEST Request,
+	_In_ WDFQUEUE DestinationQueue
+)
+{
+	AmtPtpSimExpectState(Request, TRUE, AMTPTP_SIM_STATE(Owned), "WdfRequestForwardToIoQueue");
+	if (DestinationQueue->Config.DispatchType != WdfIoQueueDispatchManual) {
+		AmtPtpSimFail("forwarding to a queue that is not manual");
+	}
+
+	Request->State = AmtPtpSimRequestQueued;
+	Request->Next = NULL;
+	if (DestinationQueue->Tail != NULL) {
+		DestinationQueue->Tail->Next = Request;
+	}
+	else {
+		DestinationQueue->Head = Request;
+	}
+	DestinationQueue->Tail = Request;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfIoQueueRetrieveNextRequest(
+	_In_ WDFQUEUE Queue,
+	_Out_ WDFREQUEST* OutRequest
+)
+{
+	WDFREQUEST request = Queue->Head;
+
+	if (request == NULL) {
+		*OutRequest = NULL;
+		return STATUS_NO_MORE_ENTRIES;
+	}
+
+	Queue->Head = request->Next;
+	if (Queue->Head == NULL) {
+		Queue->Tail = NULL;
+	}
+	request->Next = NULL;
+	request->State = AmtPtpSimRequestOwned;
+	*OutRequest = request;
+	return STATUS_SUCCESS;
+}
+
+WDF_IO_QUEUE_STATE
+WdfIoQueueGetState(
+	_In_ WDFQUEUE Queue,
+	_Out_opt_ PULONG QueueRequests,
+	_Out_opt_ PULONG DriverRequests
+)
+{
+	WDFREQUEST request;
+	ULONG count = 0;
+
+	for (request = Queue->Head; request != NULL; request = request->Next) {
+		count++;
+	}
+	if (QueueRequests != NULL) {
+		*QueueRequests = count;
+	}
+	if (DriverRequests != NULL) {
+		*DriverRequests = 0;
+	}
+	return (WDF_IO_QUEUE_STATE) (WdfIoQueueAcceptRequests | WdfIoQueueDispatchRequests |
+		WdfIoQueueDriverNoRequests | (count == 0 ? WdfIoQueueNoRequests : 0));
+}
+
+WDFDEVICE
+WdfIoQueueGetDevice(
+	_In_ WDFQUEUE Queue
+)
+{
+	return Queue->Device;
+}
+
+//
+// IO target
+//
+
+NTSTATUS
+WdfIoTargetFormatRequestForInternalIoctl(
+	_In_ WDFIOTARGET IoTarget,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_opt_ WDFMEMORY InputBuffer,
+	_In_opt_ PWDFMEMORY_OFFSET InputBufferOffset,
+	_In_opt_ WDFMEMORY OutputBuffer,
+	_In_opt_ PWDFMEMORY_OFFSET OutputBufferOffset
+)
+{
+	AmtPtpSimExpectState(Request, FALSE, AMTPTP_SIM_STATE(Idle) | AMTPTP_SIM_STATE(Formatted) |
+		AMTPTP_SIM_STATE(Completed), "WdfIoTargetFormatRequestForInternalIoctl");
+	if (InputBufferOffset != NULL || OutputBufferOffset != NULL) {
+		AmtPtpSimFail("memory offsets are not simulated");
+	}
+
+	Request->State = AmtPtpSimRequestFormatted;
+	Request->Kind = (IoctlCode == IOCTL_HID_READ_REPORT) ? AmtPtpSimRequestRead : AmtPtpSimRequestIoctl;
+	Request->Target = IoTarget;
+	Request->IoControlCode = IoctlCode;
+	Request->Input = InputBuffer;
+	Request->Output = OutputBuffer;
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+AmtPtpSimTargetIoctl(
+	_In_ WDFIOTARGET Target,
+	_In_ ULONG IoControlCode,
+	_In_reads_bytes_(InputLength) const VOID* Input,
+	_In_ size_t InputLength,
+	_Out_writes_bytes_(OutputLength) PVOID Output,
+	_In_ size_t OutputLength,
+	_Out_ ULONG_PTR* Information
+)
+{
+	*Information = 0;
+	if (Target->Config.Ioctl == NULL) {
+		return STATUS_NOT_SUPPORTED;
+	}
+	return Target->Config.Ioctl(Target->Config.Context, IoControlCode, Input, InputLength, Output, OutputLength,
+		Information);
+}
+
+static NTSTATUS
+AmtPtpSimUsbControl(
+	_In_ WDFDEVICE Device,
+	_In_ const WDF_USB_CONTROL_SETUP_PACKET* SetupPacket,
+	_Inout_updates_(Length) PUCHAR Buffer,
+	_In_ size_t Length,
+	_Out_ ULONG_PTR* Transferred
+)
+{
+	*Transferred = 0;
+	AmtPtpSimStats.ControlTransfers++;
+	if (Device->Usb.Control == NULL) {
+		return STATUS_UNSUCCESSFUL;
+	}
+	return Device->Usb.Control(Device->Usb.Context, SetupPacket, Buffer, Length, Transferred);
+}
+
+static VOID
+AmtPtpSimTargetComplete(
+	_In_opt_ PVOID Context
+)
+{
+	WDFREQUEST request = Context;
+	WDFIOTARGET target = request->Target;
+	AMTPTP_SIM_TRANSFER* transfer = request->Transfer;
+	WDF_REQUEST_COMPLETION_PARAMS params;
+	NTSTATUS status;
+
+	request->Information = 0;
+	if (request->Cancelled) {
+		request->Status = STATUS_CANCELLED;
+		if (request->Kind == AmtPtpSimRequestRead) {
+			AmtPtpSimStats.ReadsCancelled++;
+		}
+	}
+	else if (request->Kind == AmtPtpSimRequestRead) {
+		// Hand over the transfer it was matched with
+		request->Status = transfer->Status;
+		if (NT_SUCCESS(transfer->Status)) {
+			if (request->Output == NULL || transfer->Length > request->Output->Size) {
+				request->Status = STATUS_BUFFER_TOO_SMALL;
+			}
+			else {
+				RtlCopyMemory(request->Output->Buffer, transfer->Data, transfer->Length);
+				request->Information = transfer->Length;
+				AmtPtpSimStats.Reads++;
+			}
+		}
+		if (request->Sequence + 1 < target->CompletedHigh) {
+			AmtPtpSimStats.ReadsReordered++;
+		}
+		else {
+			target->CompletedHigh = request->Sequence + 1;
+		}
+		request->Transfer = NULL;
+		free(transfer);
+	}
+	else if (request->Kind == AmtPtpSimRequestControl) {
+		status = AmtPtpSimUsbControl(target->Device, &request->Setup,
+			(request->Output != NULL) ? request->Output->Buffer : NULL, request->Setup.Packet.wLength,
+			&request->Information);
+
+		// A stalled transfer stays with the target until it is cancelled
+		if (status == STATUS_PENDING) {
+			return;
+		}
+		request->Status = status;
+	}
+	else {
+		request->Status = AmtPtpSimTargetIoctl(target, request->IoControlCode,
+			(request->Input != NULL) ? request->Input->Buffer : NULL, (request->Input != NULL) ? request->Input->Size : 0,
+			(request->Output != NULL) ? request->Output->Buffer : NULL, (request->Output != NULL) ? request->Output->Size : 0,
+			&request->Information);
+	}
+
+	request->State = AmtPtpSimRequestCompleted;
+	request->Cancelled = FALSE;
+	target->Pending--;
+	if (request->Completion != NULL) {
+		RtlZeroMemory(&params, sizeof(params));
+		params.Size = sizeof(params);
+		params.IoStatus.Status = request->Status;
+		params.IoStatus.Information = request->Information;
+		request->Completion(request, target, &params, request->CompletionContext);
+	}
+}
+
+//
+// Takes a sent request back from its target, the caller completes it. A
+// transfer it was matched with is lost.
+//
+static BOOLEAN
+AmtPtpSimTargetCancel(
+	_In_ WDFREQUEST Request
+)
+{
+	WDFIOTARGET target = Request->Target;
+	WDFREQUEST* link;
+
+	if (Request->State != AmtPtpSimRequestSent || Request->Cancelled) {
+		return FALSE;
+	}
+
+	for (link = &target->ReadHead; *link != NULL; link = &(*link)->Next) {
+		if (*link == Request) {
+			*link = Request->Next;
+			break;
+		}
+	}
+	target->ReadTail = target->ReadHead;
+	while (target->ReadTail != NULL && target->ReadTail->Next != NULL) {
+		target->ReadTail = target->ReadTail->Next;
+	}
+	Request->Next = NULL;
+
+	AmtPtpSimCancelEvents(Request);
+	free(Request->Transfer);
+	Request->Transfer = NULL;
+	Request->Cancelled = TRUE;
+	return TRUE;
+}
+
+BOOLEAN
+WdfRequestCancelSentRequest(
+	_In_ WDFREQUEST Request
+)
+{
+	AmtPtpSimExpectState(Request, FALSE, AMTPTP_SIM_STATE(Idle) | AMTPTP_SIM_STATE(Formatted) |
+		AMTPTP_SIM_STATE(Sent) | AMTPTP_SIM_STATE(Completed), "WdfRequestCancelSentRequest");
+
+	if (!AmtPtpSimTargetCancel(Request)) {
+		return FALSE;
+	}
+	AmtPtpSimSchedule(AmtPtpSimTime, AmtPtpSimTargetComplete, Request);
+	return TRUE;
+}
+
+static ULONGLONG
+AmtPtpSimTargetLatency(
+	_In_ WDFIOTARGET Target
+)
+{
+	if (Target->Config.Jitter == 0) {
+		return Target->Config.Latency;
+	}
+
+	Target->JitterSeed = Target->JitterSeed * 1103515245 + 12345;
+	return Target->Config.Latency + (Target->JitterSeed >> 8) % (Target->Config.Jitter + 1);
+}
+
+// A read and a transfer are both there
+static VOID
+AmtPtpSimTargetMatch(
+	_In_ WDFIOTARGET Target
+)
+{
+	WDFREQUEST request;
+	AMTPTP_SIM_TRANSFER* transfer;
+
+	while (Target->ReadHead != NULL && Target->FifoHead != NULL) {
+		request = Target->ReadHead;
+		Target->ReadHead = request->Next;
+		if (Target->ReadHead == NULL) {
+			Target->ReadTail = NULL;
+		}
+		request->Next = NULL;
+
+		transfer = Target->FifoHead;
+		Target->FifoHead = transfer->Next;
+		if (Target->FifoHead == NULL) {
+			Target->FifoTail = NULL;
+		}
+		Target->FifoCount--;
+
+		request->Transfer = transfer;
+		AmtPtpSimSchedule(AmtPtpSimTime + AmtPtpSimTargetLatency(Target), AmtPtpSimTargetComplete, request);
+	}
+}
+
+BOOLEAN
+WdfRequestSend(
+	_In_ WDFREQUEST Request,
+	_In_ WDFIOTARGET Target,
+	_In_opt_ PWDF_REQUEST_SEND_OPTIONS RequestOptions
+)
+{
+	AmtPtpSimExpectState(Request, FALSE, AMTPTP_SIM_STATE(Formatted), "WdfRequestSend");
+	if (Request->Target != Target) {
+		AmtPtpSimFail("request formatted for another target");
+	}
+
+	AmtPtpSimStats.Sends++;
+	if (Target->Stopped) {
+		AmtPtpSimStats.SendsFailed++;
+		Request->State = AmtPtpSimRequestCompleted;
+		Request->Status = STATUS_INVALID_DEVICE_STATE;
+		return FALSE;
+	}
+	if (Target->Config.FailSends > 0) {
+		Target->Config.FailSends--;
+		AmtPtpSimStats.SendsFailed++;
+		Request->State = AmtPtpSimRequestCompleted;
+		Request->Status = STATUS_DEVICE_NOT_CONNECTED;
+		return FALSE;
+	}
+
+	Request->State = AmtPtpSimRequestSent;
+	Target->Pending++;
+
+	// Synchronous sends take no virtual time, nothing else runs meanwhile
+	if (RequestOptions != NULL && (RequestOptions->Flags & WDF_REQUEST_SEND_OPTION_SYNCHRONOUS)) {
+		if (Request->Kind != AmtPtpSimRequestIoctl) {
+			AmtPtpSimFail("only synchronous ioctls are simulated");
+		}
+		Request->Completion = NULL;
+		AmtPtpSimTargetComplete(Request);
+		return NT_SUCCESS(Request->Status);
+	}
+
+	if (Request->Kind != AmtPtpSimRequestRead) {
+		AmtPtpSimSchedule(AmtPtpSimTime + Target->Config.Latency, AmtPtpSimTargetComplete, Request);
+		return TRUE;
+	}
+
+	Request->Sequence = Target->SendSequence++;
+	Request->Next = NULL;
+	if (Target->ReadTail != NULL) {
+		Target->ReadTail->Next = Request;
+	}
+	else {
+		Target->ReadHead = Request;
+	}
+	Target->ReadTail = Request;
+	AmtPtpSimTargetMatch(Target);
+	return TRUE;
+}
+
+static PVOID
+AmtPtpSimDescriptorBuffer(
+	_In_opt_ PWDF_MEMORY_DESCRIPTOR Descriptor,
+	_Out_ size_t* Length
+)
+{
+	*Length = 0;
+	if (Descriptor == NULL) {
+		return NULL;
+	}
+	if (Descriptor->Type == WdfMemoryDescriptorTypeHandle && Descriptor->u.HandleType.Offsets == NULL) {
+		*Length = Descriptor->u.HandleType.Memory->Size;
+		return Descriptor->u.HandleType.Memory->Buffer;
+	}
+	if (Descriptor->Type != WdfMemoryDescriptorTypeBuffer) {
+		AmtPtpSimFail("only buffer and whole handle memory descriptors are simulated");
+	}
+	*Length = Descriptor->u.BufferType.Length;
+	return Descriptor->u.BufferType.Buffer;
+}
+
+NTSTATUS
+WdfIoTargetSendInternalIoctlSynchronously(
+	_In_ WDFIOTARGET IoTarget,
+	_In_opt_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_opt_ PWDF_MEMORY_DESCRIPTOR InputBuffer,
+	_In_opt_ PWDF_MEMORY_DESCRIPTOR OutputBuffer,
+	_In_opt_ PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	_Out_opt_ PULONG_PTR BytesReturned
+)
+{
+	size_t inputLength, outputLength;
+	PVOID input, output;
+	ULONG_PTR information;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(RequestOptions);
+
+	if (Request != NULL) {
+		AmtPtpSimFail("synchronous sends of an existing request are not simulated");
+	}
+
+	input = AmtPtpSimDescriptorBuffer(InputBuffer, &inputLength);
+	output = AmtPtpSimDescriptorBuffer(OutputBuffer, &outputLength);
+	AmtPtpSimStats.Sends++;
+	status = AmtPtpSimTargetIoctl(IoTarget, IoctlCode, input, inputLength, output, outputLength, &information);
+	if (BytesReturned != NULL) {
+		*BytesReturned = information;
+	}
+	return status;
+}
+
+static VOID AmtPtpSimReaderSend(_In_ WDFUSBPIPE Pipe, _In_ WDFREQUEST Request);
+static VOID AmtPtpSimReaderCancel(_In_ WDFUSBPIPE Pipe);
+
+NTSTATUS
+WdfIoTargetStart(
+	_In_ WDFIOTARGET IoTarget
+)
+{
+	ULONG i;
+	WDFUSBPIPE pipe = IoTarget->Pipe;
+
+	if (pipe == NULL) {
+		AmtPtpSimFail("only pipe targets are started and stopped");
+	}
+
+	IoTarget->Stopped = FALSE;
+	for (i = 0; i < pipe->ReadCount; i++) {
+		if (pipe->Reads[i]->State != AmtPtpSimRequestSent) {
+			AmtPtpSimReaderSend(pipe, pipe->Reads[i]);
+		}
+	}
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfIoTargetStop(
+	_In_ WDFIOTARGET IoTarget,
+	_In_ WDF_IO_TARGET_SENT_IO_ACTION Action
+)
+{
+	if (IoTarget->Pipe == NULL) {
+		AmtPtpSimFail("only pipe targets are started and stopped");
+	}
+	if (Action == WdfIoTargetWaitForSentIoToComplete) {
+		AmtPtpSimFail("waiting for sent IO on a stop is not simulated");
+	}
+
+	IoTarget->Stopped = TRUE;
+
+	// Only the continuous reader sends to a pipe
+	if (Action == WdfIoTargetCancelSentIo) {
+		AmtPtpSimReaderCancel(IoTarget->Pipe);
+	}
+}
+
+AMTPTP_SIM_TARGET_CONFIG*
+AmtPtpSimTargetConfig(
+	_In_ WDFDEVICE Device
+)
+{
+	return &Device->Target->Config;
+}
+
+static VOID
+AmtPtpSimTargetProduce(
+	_In_ WDFIOTARGET Target,
+	_In_ NTSTATUS Status,
+	_In_reads_bytes_(Length) const UCHAR* Data,
+	_In_ size_t Length
+)
+{
+	AMTPTP_SIM_TRANSFER* transfer;
+
+	if (Target->Config.FifoDepth != 0 && Target->FifoCount >= Target->Config.FifoDepth) {
+		AmtPtpSimStats.ReadsDropped++;
+		return;
+	}
+
+	transfer = AmtPtpSimAllocate(sizeof(AMTPTP_SIM_TRANSFER) + Length);
+	transfer->Status = Status;
+	transfer->Length = NT_SUCCESS(Status) ? Length : 0;
+	if (transfer->Length > 0) {
+		RtlCopyMemory(transfer->Data, Data, transfer->Length);
+	}
+
+	if (Target->FifoTail != NULL) {
+		Target->FifoTail->Next = transfer;
+	}
+	else {
+		Target->FifoHead = transfer;
+	}
+	Target->FifoTail = transfer;
+	Target->FifoCount++;
+	AmtPtpSimTargetMatch(Target);
+}
+
+VOID
+AmtPtpSimTargetPush(
+	_In_ WDFDEVICE Device,
+	_In_ NTSTATUS Status,
+	_In_reads_bytes_(Length) const UCHAR* Data,
+	_In_ size_t Length
+)
+{
+	AmtPtpSimTargetProduce(Device->Target, Status, Data, Length);
+}
+
+ULONG
+AmtPtpSimTargetPending(
+	_In_ WDFDEVICE Device
+)
+{
+	return Device->Target->Pending;
+}
+
+//
+// USB device, interface and pipe
+//
+
+NTSTATUS
+WdfUsbTargetDeviceCreate(
+	_In_ WDFDEVICE Device,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_Out_ WDFUSBDEVICE* UsbDevice
+)
+{
+	WDFUSBDEVICE usbDevice;
+	WDFUSBINTERFACE usbInterface;
+	WDFUSBPIPE pipe;
+
+	if (Device->UsbDevice != NULL) {
+		AmtPtpSimFail("second USB target device");
+	}
+
+	// The interface and the pipe come with the configuration, not from the driver
+	usbDevice = AmtPtpSimCreateObject(AmtPtpSimObjectUsbDevice, sizeof(struct WDFUSBDEVICE__), Attributes, Device, TRUE);
+	usbInterface = AmtPtpSimCreateObject(AmtPtpSimObjectUsbInterface, sizeof(struct WDFUSBINTERFACE__), NULL,
+		usbDevice, FALSE);
+	pipe = AmtPtpSimCreateObject(AmtPtpSimObjectUsbPipe, sizeof(struct WDFUSBPIPE__), NULL, usbInterface, FALSE);
+
+	usbDevice->Device = Device;
+	usbDevice->Interface = usbInterface;
+	usbInterface->Pipe = pipe;
+	pipe->Target = Device->PipeTarget;
+	Device->PipeTarget->Pipe = pipe;
+	Device->UsbDevice = usbDevice;
+	*UsbDevice = usbDevice;
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfUsbTargetDeviceGetDeviceDescriptor(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_Out_ PUSB_DEVICE_DESCRIPTOR UsbDeviceDescriptor
+)
+{
+	*UsbDeviceDescriptor = UsbDevice->Device->Usb.Descriptor;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceRetrieveInformation(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_Out_ PWDF_USB_DEVICE_INFORMATION Information
+)
+{
+	Information->HcdPortCapabilities = 0;
+	Information->Traits = UsbDevice->Device->Usb.Traits;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceAllocAndQueryString(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES StringMemoryAttributes,
+	_Out_ WDFMEMORY* StringMemory,
+	_Out_opt_ PUSHORT NumCharacters,
+	_In_ UCHAR StringIndex,
+	_In_opt_ USHORT LangID
+)
+{
+	UNREFERENCED_PARAMETER(UsbDevice);
+	UNREFERENCED_PARAMETER(StringMemoryAttributes);
+	UNREFERENCED_PARAMETER(StringMemory);
+	UNREFERENCED_PARAMETER(NumCharacters);
+	UNREFERENCED_PARAMETER(LangID);
+
+	AmtPtpSimFail("string descriptor %u asked for, string descriptors are not simulated", StringIndex);
+	return STATUS_NOT_SUPPORTED;
+}
+
+WDFUSBINTERFACE
+WdfUsbTargetDeviceGetInterface(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_In_ UCHAR InterfaceIndex
+)
+{
+	return (InterfaceIndex == 0) ? UsbDevice->Interface : NULL;
+}
+
+WDFIOTARGET
+WdfUsbTargetDeviceGetIoTarget(
+	_In_ WDFUSBDEVICE UsbDevice
+)
+{
+	return UsbDevice->Device->Target;
+}
+
+//
+// A synchronous transfer is answered right away, then the caller waits out
+// the target's Latency while other events run
+//
+NTSTATUS
+WdfUsbTargetDeviceSendControlTransferSynchronously(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_In_opt_ WDFREQUEST Request,
+	_In_opt_ PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	_In_ PWDF_USB_CONTROL_SETUP_PACKET SetupPacket,
+	_In_opt_ PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
+	_Out_opt_ PULONG BytesTransferred
+)
+{
+	WDFIOTARGET target = UsbDevice->Device->Target;
+	WDF_USB_CONTROL_SETUP_PACKET setup = *SetupPacket;
+	ULONG_PTR transferred = 0;
+	size_t length;
+	PUCHAR buffer;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(RequestOptions);
+
+	if (Request != NULL) {
+		AmtPtpSimFail("synchronous sends of an existing request are not simulated");
+	}
+
+	buffer = AmtPtpSimDescriptorBuffer(MemoryDescriptor, &length);
+	setup.Packet.wLength = (USHORT) length;
+	AmtPtpSimStats.Sends++;
+
+	if (target->Config.FailSends > 0) {
+		target->Config.FailSends--;
+		AmtPtpSimStats.SendsFailed++;
+		status = STATUS_DEVICE_NOT_CONNECTED;
+	}
+	else {
+		status = AmtPtpSimUsbControl(UsbDevice->Device, &setup, buffer, length, &transferred);
+		if (status == STATUS_PENDING) {
+			AmtPtpSimFail("synchronous control transfer stalled, it would never return");
+		}
+		AmtPtpSimRun(AmtPtpSimTime + target->Config.Latency);
+	}
+
+	if (BytesTransferred != NULL) {
+		*BytesTransferred = (ULONG) transferred;
+	}
+	return status;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceFormatRequestForControlTransfer(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_In_ WDFREQUEST Request,
+	_In_ PWDF_USB_CONTROL_SETUP_PACKET SetupPacket,
+	_In_opt_ WDFMEMORY TransferMemory,
+	_In_opt_ PWDFMEMORY_OFFSET TransferOffset
+)
+{
+	AmtPtpSimExpectState(Request, FALSE, AMTPTP_SIM_STATE(Idle) | AMTPTP_SIM_STATE(Formatted) |
+		AMTPTP_SIM_STATE(Completed), "WdfUsbTargetDeviceFormatRequestForControlTransfer");
+	if (TransferOffset != NULL) {
+		AmtPtpSimFail("memory offsets are not simulated");
+	}
+
+	Request->State = AmtPtpSimRequestFormatted;
+	Request->Kind = AmtPtpSimRequestControl;
+	Request->Target = UsbDevice->Device->Target;
+	Request->Setup = *SetupPacket;
+	Request->Setup.Packet.wLength = (TransferMemory != NULL) ? (USHORT) TransferMemory->Size : 0;
+	Request->Input = NULL;
+	Request->Output = TransferMemory;
+	return STATUS_SUCCESS;
+}
+
+UCHAR
+WdfUsbInterfaceGetNumConfiguredPipes(
+	_In_ WDFUSBINTERFACE UsbInterface
+)
+{
+	UNREFERENCED_PARAMETER(UsbInterface);
+	return 1;
+}
+
+WDFUSBPIPE
+WdfUsbInterfaceGetConfiguredPipe(
+	_In_ WDFUSBINTERFACE UsbInterface,
+	_In_ UCHAR PipeIndex,
+	_Out_opt_ PWDF_USB_PIPE_INFORMATION PipeInfo
+)
+{
+	if (PipeIndex != 0) {
+		return NULL;
+	}
+
+	// Interrupt IN endpoint 1, polled every frame
+	if (PipeInfo != NULL) {
+		PipeInfo->MaximumPacketSize = 64;
+		PipeInfo->EndpointAddress = 0x81;
+		PipeInfo->Interval = 1;
+		PipeInfo->SettingIndex = 0;
+		PipeInfo->PipeType = WdfUsbPipeTypeInterrupt;
+		PipeInfo->MaximumTransferSize = 4096;
+	}
+	return UsbInterface->Pipe;
+}
+
+VOID
+WdfUsbTargetPipeSetNoMaximumPacketSizeCheck(
+	_In_ WDFUSBPIPE Pipe
+)
+{
+	UNREFERENCED_PARAMETER(Pipe);
+}
+
+WDFIOTARGET
+WdfUsbTargetPipeGetIoTarget(
+	_In_ WDFUSBPIPE Pipe
+)
+{
+	return Pipe->Target;
+}
+
+//
+// Continuous reader. Its reads are the framework's: they are reused for
+// every transfer and never seen by the driver, only their memory is.
+//
+
+static EVT_WDF_REQUEST_COMPLETION_ROUTINE AmtPtpSimReaderComplete;
+
+static VOID
+AmtPtpSimReaderSend(
+	_In_ WDFUSBPIPE Pipe,
+	_In_ WDFREQUEST Request
+)
+{
+	Request->State = AmtPtpSimRequestFormatted;
+	Request->Cancelled = FALSE;
+	Request->Completion = AmtPtpSimReaderComplete;
+	Request->CompletionContext = Pipe;
+
+	// Not sent, it waits for the reader to start again
+	if (!WdfRequestSend(Request, Pipe->Target, WDF_NO_SEND_OPTIONS)) {
+		Request->State = AmtPtpSimRequestIdle;
+	}
+}
+
+// The reads still sent complete now, without reaching the driver
+static VOID
+AmtPtpSimReaderCancel(
+	_In_ WDFUSBPIPE Pipe
+)
+{
+	ULONG i;
+
+	for (i = 0; i < Pipe->ReadCount; i++) {
+		if (AmtPtpSimTargetCancel(Pipe->Reads[i])) {
+			AmtPtpSimTargetComplete(Pipe->Reads[i]);
+		}
+	}
+}
+
+static VOID
+AmtPtpSimReaderComplete(
+	_In_ WDFREQUEST Request,
+	_In_ WDFIOTARGET Target,
+	_In_ PWDF_REQUEST_COMPLETION_PARAMS Params,
+	_In_ WDFCONTEXT Context
+)
+{
+	WDFUSBPIPE pipe = Context;
+	NTSTATUS status = Params->IoStatus.Status;
+	BOOLEAN restart = TRUE;
+	ULONG i;
+
+	Request->State = AmtPtpSimRequestIdle;
+
+	// Only the framework cancels its reads, on a stop or a failure
+	if (status == STATUS_CANCELLED) {
+		return;
+	}
+
+	if (NT_SUCCESS(status)) {
+		pipe->Reader.EvtUsbTargetPipeReadComplete(pipe, Request->Output, Params->IoStatus.Information,
+			pipe->Reader.EvtUsbTargetPipeReadCompleteContext);
+		if (!Target->Stopped) {
+			AmtPtpSimReaderSend(pipe, Request);
+		}
+		return;
+	}
+
+	// One failed read stops them all, the driver decides whether they restart
+	AmtPtpSimStats.ReadersFailed++;
+	AmtPtpSimReaderCancel(pipe);
+	if (pipe->Reader.EvtUsbTargetPipeReadersFailed != NULL) {
+		restart = pipe->Reader.EvtUsbTargetPipeReadersFailed(pipe, status, USBD_STATUS_STALL_PID);
+	}
+	if (restart && !Target->Stopped) {
+		for (i = 0; i < pipe->ReadCount; i++) {
+			AmtPtpSimReaderSend(pipe, pipe->Reads[i]);
+		}
+	}
+}
+
+NTSTATUS
+WdfUsbTargetPipeConfigContinuousReader(
+	_In_ WDFUSBPIPE Pipe,
+	_In_ PWDF_USB_CONTINUOUS_READER_CONFIG Config
+)
+{
+	WDFREQUEST request;
+	ULONG i;
+
+	if (Pipe->Reader.Size != 0) {
+		AmtPtpSimFail("continuous reader configured twice");
+	}
+	if (Config->HeaderLength != 0 || Config->TrailerLength != 0 || Config->NumPendingReads > AMTPTP_SIM_READERS_MAX) {
+		AmtPtpSimFail("reader headers, trailers and more than %u reads are not simulated", AMTPTP_SIM_READERS_MAX);
+	}
+
+	Pipe->Reader = *Config;
+	Pipe->ReadCount = Config->NumPendingReads ? Config->NumPendingReads : AMTPTP_SIM_READERS_DEFAULT;
+	for (i = 0; i < Pipe->ReadCount; i++) {
+		request = AmtPtpSimCreateObject(AmtPtpSimObjectRequest, sizeof(struct WDFREQUEST__), NULL, Pipe, FALSE);
+		request->Kind = AmtPtpSimRequestRead;
+		request->Target = Pipe->Target;
+		request->Output = AmtPtpSimCreateRequestMemory(request, Config->TransferLength);
+		Pipe->Reads[i] = request;
+	}
+
+	if (!Pipe->Target->Stopped) {
+		WdfIoTargetStart(Pipe->Target);
+	}
+	return STATUS_SUCCESS;
+}
+
+AMTPTP_SIM_USB_CONFIG*
+AmtPtpSimUsbConfig(
+	_In_ WDFDEVICE Device
+)
+{
+	return &Device->Usb;
+}
+
+AMTPTP_SIM_TARGET_CONFIG*
+AmtPtpSimPipeConfig(
+	_In_ WDFDEVICE Device
+)
+{
+	return &Device->PipeTarget->Config;
+}
+
+VOID
+AmtPtpSimPipePush(
+	_In_ WDFDEVICE Device,
+	_In_ NTSTATUS Status,
+	_In_reads_bytes_(Length) const UCHAR* Data,
+	_In_ size_t Length
+)
+{
+	AmtPtpSimTargetProduce(Device->PipeTarget, Status, Data, Length);
+}
+
+ULONG
+AmtPtpSimPipePending(
+	_In_ WDFDEVICE Device
+)
+{
+	return Device->PipeTarget->Pending;
+}
+
+//
+// Timers and work items
+//
+
+NTSTATUS
+WdfTimerCreate(
+	_In_ PWDF_TIMER_CONFIG Config,
+	_In_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_Out_ WDFTIMER* Timer
+)
+{
+	WDFTIMER timer;
+
+	if (Attributes == NULL || Attributes->ParentObject == NULL) {
+		AmtPtpSimFail("timers need a parent object");
+	}
+	if (Config->Period != 0) {
+		AmtPtpSimFail("periodic timers are not simulated");
+	}
+
+	timer = AmtPtpSimCreateObject(AmtPtpSimObjectTimer, sizeof(struct WDFTIMER__), Attributes, NULL, TRUE);
+	timer->Callback = Config->EvtTimerFunc;
+	*Timer = timer;
+	return STATUS_SUCCESS;
+}
+
+BOOLEAN
+WdfTimerStart(
+	_In_ WDFTIMER Timer,
+	_In_ LONGLONG DueTime
+)
+{
+	BOOLEAN wasArmed = Timer->Armed;
+	ULONGLONG due = (DueTime < 0) ? AmtPtpSimTime + (ULONGLONG) -DueTime : (ULONGLONG) DueTime;
+
+	// The generation tells a live event from one left by an earlier start
+	Timer->Generation++;
+	if (Timer->Generation == 0) {
+		Timer->Generation = 1;
+	}
+	Timer->Armed = TRUE;
+	AmtPtpSimScheduleTagged(due, NULL, Timer, Timer->Generation);
+	return wasArmed;
+}
+
+BOOLEAN
+WdfTimerStop(
+	_In_ WDFTIMER Timer,
+	_In_ BOOLEAN Wait
+)
+{
+	BOOLEAN wasArmed = Timer->Armed;
+
+	UNREFERENCED_PARAMETER(Wait);
+
+	Timer->Armed = FALSE;
+	return wasArmed;
+}
+
+WDFOBJECT
+WdfTimerGetParentObject(
+	_In_ WDFTIMER Timer
+)
+{
+	return Timer->Header.Parent;
+}
+
+NTSTATUS
+WdfWorkItemCreate(
+	_In_ PWDF_WORKITEM_CONFIG Config,
+	_In_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_Out_ WDFWORKITEM* WorkItem
+)
+{
+	WDFWORKITEM workItem;
+
+	if (Attributes == NULL || Attributes->ParentObject == NULL) {
+		AmtPtpSimFail("work items need a parent object");
+	}
+
+	workItem = AmtPtpSimCreateObject(AmtPtpSimObjectWorkItem, sizeof(struct WDFWORKITEM__), Attributes, NULL, TRUE);
+	workItem->Callback = Config->EvtWorkItemFunc;
+	*WorkItem = workItem;
+	return STATUS_SUCCESS;
+}
+
+static VOID
+AmtPtpSimWorkItemRun(
+	_In_opt_ PVOID Context
+)
+{
+	WDFWORKITEM workItem = Context;
+
+	workItem->Enqueued = FALSE;
+	AmtPtpSimStats.WorkItemRuns++;
+	workItem->Callback(workItem);
+}
+
+VOID
+WdfWorkItemEnqueue(
+	_In_ WDFWORKITEM WorkItem
+)
+{
+	// Enqueuing a work item that has not run yet does nothing
+	if (WorkItem->Enqueued) {
+		return;
+	}
+	WorkItem->Enqueued = TRUE;
+	AmtPtpSimSchedule(AmtPtpSimTime, AmtPtpSimWorkItemRun, WorkItem);
+}
+
+WDFOBJECT
+WdfWorkItemGetParentObject(
+	_In_ WDFWORKITEM WorkItem
+)
+{
+	return WorkItem->Header.Parent;
+}
@@ -0,0 +1,96 @@
+// AmtPtpSimBcm5974.h: A bcm5974 trackpad below a simulated USB driver
+//
+// The model takes its layout and mode switch from AmtPtpDeviceRegistry.h, so
+// every USB family the registry knows comes up the way the driver expects
+// it to. It answers the Wellspring mode read (request 1) and write (request
+// 9) on the control endpoint with the mode block the registry describes, and
+// produces interrupt transfers on the virtual clock: boot mouse reports in
+// mouse mode, TYPE2 - TYPE5 frames in Wellspring mode. TYPE3 devices are in
+// Wellspring mode from the start and get no control transfers.
+//
+// Faults are counted down as they happen, so a test can ask for exactly one
+// of each.
+#pragma once
+
+#include <AmtPtpWdfSim.h>
+#include <AmtPtpDeviceRegistry.h>
+#include <AmtPtpModeEngine.h>
+
+#define AMTPTP_SIM_BCM5974_MOUSE_REPORT_SIZE	8
+
+/* Longest frame of any layout, TYPE4 has the largest header and fingers */
+#define AMTPTP_SIM_BCM5974_FRAME_MAX_SIZE \
+	(AMTPTP_WELLSPRING_TYPE4_HEADER_SIZE + AMTPTP_DECODER_MAX_CONTACTS * AMTPTP_WELLSPRING_TYPE4_FINGER_SIZE)
+
+typedef struct _AMTPTP_SIM_BCM5974_FAULTS {
+	ULONG		FailControl;		/* the next FailControl control transfers stall */
+	ULONG		StallControl;		/* the next StallControl never complete */
+	ULONG		IgnoreModeWrites;	/* acknowledged without switching */
+	ULONG		MalformEvery;		/* every Nth frame is cut short, 0 for none */
+	ULONG		FailReadEvery;		/* every Nth interrupt transfer fails, 0 for none */
+} AMTPTP_SIM_BCM5974_FAULTS;
+
+typedef struct _AMTPTP_SIM_BCM5974 {
+	// Script, can be changed at any time
+	ULONGLONG	FrameInterval;		/* between interrupt transfers, 100ns units */
+	UCHAR		Contacts;			/* fingers on the pad in every frame */
+	UCHAR		Button;
+	AMTPTP_SIM_BCM5974_FAULTS Faults;
+
+	// State
+	WDFDEVICE	Device;
+	const AMTPTP_DEVICE_MODEL* Model;
+	USHORT		ProductId;
+	BOOLEAN		Wellspring;
+	BOOLEAN		Running;
+	BOOLEAN		Scheduled;
+	ULONG		Frame;
+	UCHAR		ModeBlock[AMTPTP_MODE_BLOCK_MAX_SIZE];
+
+	// Statistics
+	ULONG		ModeReads;
+	ULONG		ModeWrites;
+	ULONG		Switches;			/* writes that changed the mode */
+	ULONG		Unexpected;			/* control transfers it does not know, stalled */
+	ULONG		FramesSent;
+	ULONG		MouseReports;
+	ULONG		Corrupted;			/* frames cut short or failed on purpose */
+	ULONGLONG	SwitchedAt;			/* when the last switch landed */
+} AMTPTP_SIM_BCM5974;
+
+//
+// Plugs the trackpad with ProductId in below Device, before
+// EvtDevicePrepareHardware runs. Fails the run if the registry has no USB
+// model for it. Frames are sent every 8 ms with two fingers on the pad.
+//
+VOID
+AmtPtpSimBcm5974Attach(
+	_Out_ AMTPTP_SIM_BCM5974* Bcm,
+	_In_ WDFDEVICE Device,
+	_In_ USHORT ProductId
+);
+
+//
+// Starts or stops the interrupt transfers. The first one goes out one
+// FrameInterval after the start.
+//
+VOID
+AmtPtpSimBcm5974Start(
+	_Inout_ AMTPTP_SIM_BCM5974* Bcm
+);
+
+VOID
+AmtPtpSimBcm5974Stop(
+	_Inout_ AMTPTP_SIM_BCM5974* Bcm
+);
+
+//
+// Writes the frame Bcm would send now into Buffer and returns its length,
+// a mouse report in mouse mode. The frame counter moves on.
+//
+size_t
+AmtPtpSimBcm5974Encode(
+	_Inout_ AMTPTP_SIM_BCM5974* Bcm,
+	_Out_writes_bytes_(Length) PUCHAR Buffer,
+	_In_ size_t Length
+);
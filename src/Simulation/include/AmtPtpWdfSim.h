@@ -0,0 +1,267 @@
+// AmtPtpWdfSim.h: Harness side of the WDF stand-in
+//
+// The simulation plays the framework, hidclass above the driver and the
+// transport below it. Nothing runs on its own: every callback the driver
+// gets, from completion routines to timers, is an event on one virtual
+// clock in 100ns units, run in time order by AmtPtpSimRun. The same script
+// therefore always gives the same trace, and one run costs no wall time.
+#pragma once
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <wdfusb.h>
+
+//
+// Clock and events
+//
+
+typedef VOID AMTPTP_SIM_CALLBACK(_In_opt_ PVOID Context);
+
+ULONGLONG
+AmtPtpSimNow(VOID);
+
+//
+// Runs Callback at Time, after the events already due then. A time in the
+// past means now.
+//
+VOID
+AmtPtpSimSchedule(
+	_In_ ULONGLONG Time,
+	_In_ AMTPTP_SIM_CALLBACK* Callback,
+	_In_opt_ PVOID Context
+);
+
+//
+// Runs events in time order up to and including Until, then leaves the
+// clock at Until. Returns the number of events run.
+//
+ULONG
+AmtPtpSimRun(
+	_In_ ULONGLONG Until
+);
+
+//
+// Runs events until none are left
+//
+ULONG
+AmtPtpSimRunAll(VOID);
+
+//
+// A WDF rule was broken, or a device model was misused: prints where the
+// clock is and aborts, the run is meaningless from here on
+//
+VOID
+AmtPtpSimFail(
+	_In_ const char* Format,
+	...
+);
+
+//
+// What the driver did with the framework, reset by AmtPtpSimReset
+//
+typedef struct _AMTPTP_SIM_STATS {
+	ULONG		Created;		/* objects the driver created */
+	ULONG		Deleted;		/* of those, deleted again */
+	ULONG		Events;
+	ULONG		Sends;
+	ULONG		SendsFailed;	/* WdfRequestSend returned FALSE */
+	ULONG		Reads;			/* transfers handed to the driver */
+	ULONG		ReadsDropped;	/* transfers lost to a full device FIFO */
+	ULONG		ReadsReordered;	/* reads completed after one sent later */
+	ULONG		ReadsCancelled;
+	ULONG		ReadersFailed;	/* continuous reader failures */
+	ULONG		ControlTransfers;
+	ULONG		DeviceFailed;	/* WdfDeviceSetFailed calls */
+	WDF_DEVICE_FAILED_ACTION LastFailedAction;
+	ULONG		TimerFires;
+	ULONG		WorkItemRuns;
+	ULONG		Traces[TRACE_LEVEL_VERBOSE + 1];
+} AMTPTP_SIM_STATS;
+
+extern AMTPTP_SIM_STATS AmtPtpSimStats;
+
+//
+// Deletes the driver and everything under it, drops pending events and
+// resets the clock and the statistics
+//
+VOID
+AmtPtpSimReset(VOID);
+
+//
+// Driver and device lifecycle. DriverEntry of the simulated driver is
+// called by the harness, it creates the one WDFDRIVER.
+//
+
+//
+// Calls EvtDriverDeviceAdd with a fresh WDFDEVICE_INIT. The device it
+// creates gets a simulated IO target, see AmtPtpSimTargetConfig, and a USB
+// device with one interrupt pipe, see AmtPtpSimUsbConfig.
+//
+NTSTATUS
+AmtPtpSimAddDevice(
+	_Out_ WDFDEVICE* Device
+);
+
+//
+// Calls EvtDevicePrepareHardware on the first start, then EvtDeviceD0Entry,
+// then EvtDeviceSelfManagedIoInit on the first start or
+// EvtDeviceSelfManagedIoRestart after that
+//
+NTSTATUS
+AmtPtpSimPowerUp(
+	_In_ WDFDEVICE Device
+);
+
+//
+// Calls EvtDeviceD0Exit
+//
+NTSTATUS
+AmtPtpSimPowerDown(
+	_In_ WDFDEVICE Device
+);
+
+//
+// Hidclass: requests sent down to the device's default queue
+//
+
+typedef VOID AMTPTP_SIM_REQUEST_DONE(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status,
+	_In_ ULONG_PTR Information,
+	_In_reads_bytes_(Information) const UCHAR* Buffer
+);
+
+//
+// Creates a request with a copy of Input and an OutputLength byte buffer
+// and dispatches it now, to EvtIoInternalDeviceControl or else
+// EvtIoDeviceControl. Done runs as its own event once the driver completes
+// it.
+//
+VOID
+AmtPtpSimSendIoctl(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG IoControlCode,
+	_In_reads_bytes_(InputLength) const VOID* Input,
+	_In_ size_t InputLength,
+	_In_ size_t OutputLength,
+	_In_ AMTPTP_SIM_REQUEST_DONE* Done,
+	_In_opt_ PVOID Context
+);
+
+//
+// The transport below the device. Reads sent by the driver are matched
+// with transfers in order: a transfer the device produced while no read
+// was pending waits in its FIFO, a read sent while no transfer is there
+// waits for the next one. A read completes Latency plus up to Jitter after
+// both are there, so later reads can complete first.
+//
+
+typedef NTSTATUS AMTPTP_SIM_TARGET_IOCTL(
+	_In_opt_ PVOID Context,
+	_In_ ULONG IoControlCode,
+	_In_reads_bytes_(InputLength) const VOID* Input,
+	_In_ size_t InputLength,
+	_Out_writes_bytes_(OutputLength) PVOID Output,
+	_In_ size_t OutputLength,
+	_Out_ ULONG_PTR* Information
+);
+
+typedef struct _AMTPTP_SIM_TARGET_CONFIG {
+	ULONGLONG	Latency;
+	ULONGLONG	Jitter;
+	ULONG		FifoDepth;	/* transfers the device keeps, 0 for no limit */
+	ULONG		FailSends;	/* the next FailSends sends return FALSE */
+	AMTPTP_SIM_TARGET_IOCTL* Ioctl;	/* answers everything but reads, NULL fails them */
+	PVOID		Context;
+} AMTPTP_SIM_TARGET_CONFIG;
+
+//
+// The configuration of Device's target, can be changed at any time
+//
+AMTPTP_SIM_TARGET_CONFIG*
+AmtPtpSimTargetConfig(
+	_In_ WDFDEVICE Device
+);
+
+//
+// The device produces a transfer now. A failure Status completes a read
+// with it and no data.
+//
+VOID
+AmtPtpSimTargetPush(
+	_In_ WDFDEVICE Device,
+	_In_ NTSTATUS Status,
+	_In_reads_bytes_(Length) const UCHAR* Data,
+	_In_ size_t Length
+);
+
+//
+// Reads sent to Device's target and not completed yet
+//
+ULONG
+AmtPtpSimTargetPending(
+	_In_ WDFDEVICE Device
+);
+
+//
+// USB: the device below a driver using wdfusb.h. Control transfers are
+// requests on the device's target, so its Latency and FailSends apply, and
+// are answered by Control once they get there. The interrupt pipe has a
+// target of its own, fed like the one above by AmtPtpSimPipePush.
+//
+
+//
+// Answers a control transfer, Buffer holds what the host sent or takes
+// what the device returns. STATUS_PENDING leaves the transfer pending until
+// it is cancelled.
+//
+typedef NTSTATUS AMTPTP_SIM_USB_CONTROL(
+	_In_opt_ PVOID Context,
+	_In_ const WDF_USB_CONTROL_SETUP_PACKET* SetupPacket,
+	_Inout_updates_(Length) PUCHAR Buffer,
+	_In_ size_t Length,
+	_Out_ ULONG_PTR* Transferred
+);
+
+typedef struct _AMTPTP_SIM_USB_CONFIG {
+	USB_DEVICE_DESCRIPTOR Descriptor;
+	ULONG		Traits;		/* WDF_USB_DEVICE_TRAIT_* */
+	AMTPTP_SIM_USB_CONTROL* Control;	/* NULL stalls every transfer */
+	PVOID		Context;
+} AMTPTP_SIM_USB_CONFIG;
+
+//
+// The configuration of the USB device below Device, set it up before
+// EvtDevicePrepareHardware runs
+//
+AMTPTP_SIM_USB_CONFIG*
+AmtPtpSimUsbConfig(
+	_In_ WDFDEVICE Device
+);
+
+//
+// The configuration of the interrupt pipe's target. Ioctl is not used.
+//
+AMTPTP_SIM_TARGET_CONFIG*
+AmtPtpSimPipeConfig(
+	_In_ WDFDEVICE Device
+);
+
+//
+// The device produces an interrupt transfer now
+//
+VOID
+AmtPtpSimPipePush(
+	_In_ WDFDEVICE Device,
+	_In_ NTSTATUS Status,
+	_In_reads_bytes_(Length) const UCHAR* Data,
+	_In_ size_t Length
+);
+
+//
+// Reads sent to the interrupt pipe and not completed yet
+//
+ULONG
+AmtPtpSimPipePending(
+	_In_ WDFDEVICE Device
+);
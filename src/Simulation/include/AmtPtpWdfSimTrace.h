@@ -0,0 +1,42 @@
+// AmtPtpWdfSimTrace.h: WPP stand-in for the simulated driver sources
+//
+// The flags a driver lists in WPP_CONTROL_GUIDS (Trace.h) become an enum.
+// Trace calls are counted by level and, with AMTPTP_SIM_TRACE set in the
+// environment, printed with their format string as is: WPP specifiers like
+// %!STATUS! have no printf equivalent. Like the in-flight recorder, which
+// logs whether or not a session listens, every call is also copied into an
+// in-memory log, so that a trace line costs something on the host too.
+//
+// TraceHot keeps the driver's AMTPTP_HOT_TRACE_LEVEL floor (Trace.h): a call
+// below it is compiled out, as WPP does with the constant level check.
+#pragma once
+
+#include <ntddk.h>
+
+#ifdef WPP_CONTROL_GUIDS
+#define WPP_DEFINE_CONTROL_GUID(Name, Guid, Bits)	enum { Bits AmtPtpSimTraceFlagCount };
+#define WPP_DEFINE_BIT(Name)						Name,
+WPP_CONTROL_GUIDS
+#endif
+
+VOID
+AmtPtpSimTrace(
+	_In_ ULONG Level,
+	_In_ ULONG Flag,
+	_In_ const char* Function,
+	_In_ const char* Format,
+	...
+);
+
+#define Trace(Level, ...)				AmtPtpSimTrace((Level), TRACE_DRIVER, __func__, __VA_ARGS__)
+#define TraceEvents(Level, Flags, ...)	AmtPtpSimTrace((Level), (Flags), __func__, __VA_ARGS__)
+#define TraceHot(Level, Flags, ...) \
+	((Level) <= AMTPTP_HOT_TRACE_LEVEL ? AmtPtpSimTrace((Level), (Flags), __func__, __VA_ARGS__) : (void) 0)
+
+#define WPP_INIT_TRACING(DriverObject, RegistryPath)	((void) (DriverObject), (void) (RegistryPath))
+#ifdef UMDF_VERSION_MAJOR
+// UMDF cleans up with WppCleanupUm(), the argument is never evaluated
+#define WPP_CLEANUP(DriverObject)
+#else
+#define WPP_CLEANUP(DriverObject)						((void) (DriverObject))
+#endif
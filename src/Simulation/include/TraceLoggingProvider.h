@@ -0,0 +1,36 @@
+// TraceLoggingProvider.h: Host stand-in, TraceLogging events are dropped
+//
+// The provider counts as enabled while AmtPtpSimTraceLoggingEnabled is set,
+// so the code composing an event still runs, but TraceLoggingWrite never
+// evaluates its fields.
+#pragma once
+
+#include <windows.h>
+
+typedef const char*	TraceLoggingHProvider;
+
+extern BOOLEAN AmtPtpSimTraceLoggingEnabled;
+
+#define WINEVENT_LEVEL_CRITICAL		1
+#define WINEVENT_LEVEL_ERROR		2
+#define WINEVENT_LEVEL_WARNING		3
+#define WINEVENT_LEVEL_INFO			4
+#define WINEVENT_LEVEL_VERBOSE		5
+
+#define TRACELOGGING_DECLARE_PROVIDER(Handle)			extern const TraceLoggingHProvider Handle
+#define TRACELOGGING_DEFINE_PROVIDER(Handle, Name, Id)	const TraceLoggingHProvider Handle = (Name)
+
+// A function, the drivers drop the result
+static __inline HRESULT
+TraceLoggingRegister(
+	_In_ TraceLoggingHProvider Provider
+)
+{
+	UNREFERENCED_PARAMETER(Provider);
+	return S_OK;
+}
+
+#define TraceLoggingUnregister(Provider)				((void) (Provider))
+#define TraceLoggingProviderEnabled(Provider, Level, Keyword) \
+	((void) (Provider), AmtPtpSimTraceLoggingEnabled)
+#define TraceLoggingWrite(Provider, EventName, ...)		((void) (Provider))
@@ -0,0 +1,56 @@
+// hidport.h: Host stand-in for the HID class definitions the drivers use
+#pragma once
+
+#include <ntddk.h>
+
+#define HID_CTL_CODE(id)	(0x000B0003 | ((id) << 2))
+
+#define IOCTL_HID_GET_DEVICE_DESCRIPTOR		HID_CTL_CODE(0)
+#define IOCTL_HID_GET_REPORT_DESCRIPTOR		HID_CTL_CODE(1)
+#define IOCTL_HID_READ_REPORT				HID_CTL_CODE(2)
+#define IOCTL_HID_WRITE_REPORT				HID_CTL_CODE(3)
+#define IOCTL_HID_GET_STRING				HID_CTL_CODE(4)
+#define IOCTL_HID_ACTIVATE_DEVICE			HID_CTL_CODE(7)
+#define IOCTL_HID_DEACTIVATE_DEVICE			HID_CTL_CODE(8)
+#define IOCTL_HID_GET_DEVICE_ATTRIBUTES		HID_CTL_CODE(9)
+#define IOCTL_HID_SEND_IDLE_NOTIFICATION_REQUEST	HID_CTL_CODE(10)
+#define IOCTL_UMDF_HID_SET_FEATURE			HID_CTL_CODE(20)
+#define IOCTL_UMDF_HID_GET_FEATURE			HID_CTL_CODE(21)
+#define IOCTL_UMDF_HID_SET_OUTPUT_REPORT	HID_CTL_CODE(22)
+#define IOCTL_UMDF_HID_GET_INPUT_REPORT		HID_CTL_CODE(23)
+#define IOCTL_HID_SET_FEATURE				0x000B0191
+#define IOCTL_HID_GET_FEATURE				0x000B0192
+
+#define HID_STRING_ID_IMANUFACTURER		14
+#define HID_STRING_ID_IPRODUCT			15
+#define HID_STRING_ID_ISERIALNUMBER		16
+
+#pragma pack(push, 1)
+
+typedef struct _HID_DESCRIPTOR {
+	UCHAR	bLength;
+	UCHAR	bDescriptorType;
+	USHORT	bcdHID;
+	UCHAR	bCountry;
+	UCHAR	bNumDescriptors;
+	struct _HID_DESCRIPTOR_DESC_LIST {
+		UCHAR	bReportType;
+		USHORT	wReportLength;
+	} DescriptorList[1];
+} HID_DESCRIPTOR, *PHID_DESCRIPTOR;
+
+#pragma pack(pop)
+
+typedef struct _HID_DEVICE_ATTRIBUTES {
+	ULONG	Size;
+	USHORT	VendorID;
+	USHORT	ProductID;
+	USHORT	VersionNumber;
+	USHORT	Reserved[11];
+} HID_DEVICE_ATTRIBUTES, *PHID_DEVICE_ATTRIBUTES;
+
+typedef struct _HID_XFER_PACKET {
+	PUCHAR	reportBuffer;
+	ULONG	reportBufferLen;
+	UCHAR	reportId;
+} HID_XFER_PACKET, *PHID_XFER_PACKET;
@@ -0,0 +1,11 @@
+// initguid.h: Host stand-in, makes DEFINE_GUID define the GUID
+//
+// Every file that includes it gets a definition. Like DECLSPEC_SELECTANY on
+// Windows, the copies are merged at link time.
+#pragma once
+
+#include <ntddk.h>
+
+#undef DEFINE_GUID
+#define DEFINE_GUID(Name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+	const GUID __attribute__((weak)) Name = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
@@ -0,0 +1,123 @@
+// ntddk.h: Host stand-in for the kernel headers the drivers include
+//
+// Only what the simulated driver sources use. Base types come from
+// AmtPtpPortable.h, the WDF objects from wdf.h, and the clock is the
+// simulation's virtual one, see AmtPtpWdfSim.h.
+#pragma once
+
+#include <AmtPtpPortable.h>
+
+typedef LONG				NTSTATUS;
+typedef char				CHAR, *PCHAR;
+typedef uint16_t			WCHAR, *PWCH, *PWCHAR;
+typedef uintptr_t			ULONG_PTR, *PULONG_PTR;
+
+typedef union _LARGE_INTEGER {
+	struct {
+		ULONG	LowPart;
+		LONG	HighPart;
+	} u;
+	LONGLONG	QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+#define NT_SUCCESS(Status)	(((NTSTATUS) (Status)) >= 0)
+
+#define STATUS_SUCCESS					((NTSTATUS) 0x00000000)
+#define STATUS_PENDING					((NTSTATUS) 0x00000103)
+#define STATUS_NO_MORE_ENTRIES			((NTSTATUS) 0x8000001A)
+#define STATUS_UNSUCCESSFUL				((NTSTATUS) 0xC0000001)
+#define STATUS_INVALID_PARAMETER		((NTSTATUS) 0xC000000D)
+#define STATUS_INVALID_DEVICE_REQUEST	((NTSTATUS) 0xC0000010)
+#define STATUS_UNKNOWN_REVISION			((NTSTATUS) 0xC0000058)
+#define STATUS_BUFFER_TOO_SMALL			((NTSTATUS) 0xC0000023)
+#define STATUS_INSUFFICIENT_RESOURCES	((NTSTATUS) 0xC000009A)
+#define STATUS_DEVICE_NOT_CONNECTED		((NTSTATUS) 0xC000009D)
+#define STATUS_NOT_SUPPORTED			((NTSTATUS) 0xC00000BB)
+#define STATUS_CANCELLED				((NTSTATUS) 0xC0000120)
+#define STATUS_INVALID_DEVICE_STATE		((NTSTATUS) 0xC0000184)
+#define STATUS_DEVICE_DATA_ERROR		((NTSTATUS) 0xC000009C)
+#define STATUS_INVALID_BUFFER_SIZE		((NTSTATUS) 0xC0000206)
+#define STATUS_INVALID_STATE_TRANSITION	((NTSTATUS) 0xC000A003)
+
+#define UNREFERENCED_PARAMETER(P)	((void) (P))
+#define PAGED_CODE()
+#define _IRQL_requires_(Irql)
+#define PASSIVE_LEVEL	0
+#define EXTERN_C_START
+#define EXTERN_C_END
+#define NTKERNELAPI
+#define DBG	0
+
+#define FIELD_OFFSET(Type, Field)			((LONG) offsetof(Type, Field))
+#define RTL_NUMBER_OF(Array)				(sizeof(Array) / sizeof((Array)[0]))
+#define RTL_NUMBER_OF_FIELD(Type, Field)	(RTL_NUMBER_OF(((Type*) 0)->Field))
+
+// __declspec(align(n)), the only one the drivers use
+#define __declspec(Attribute)				AMTPTP_SIM_DECLSPEC_##Attribute
+#define AMTPTP_SIM_DECLSPEC_align(Bytes)	__attribute__((aligned(Bytes)))
+
+// Trace levels, from evntrace.h
+#define TRACE_LEVEL_NONE		0
+#define TRACE_LEVEL_CRITICAL	1
+#define TRACE_LEVEL_ERROR		2
+#define TRACE_LEVEL_WARNING		3
+#define TRACE_LEVEL_INFORMATION	4
+#define TRACE_LEVEL_VERBOSE		5
+
+typedef struct _GUID {
+	ULONG	Data1;
+	USHORT	Data2;
+	USHORT	Data3;
+	UCHAR	Data4[8];
+} GUID;
+
+#define DEFINE_GUID(Name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) extern const GUID Name
+
+typedef enum _POOL_TYPE {
+	NonPagedPool,
+	PagedPool,
+	NonPagedPoolNx = 512
+} POOL_TYPE;
+
+typedef struct _UNICODE_STRING {
+	USHORT	Length;
+	USHORT	MaximumLength;
+	PWCH	Buffer;
+} UNICODE_STRING, *PUNICODE_STRING;
+
+typedef struct _LIST_ENTRY {
+	struct _LIST_ENTRY* Flink;
+	struct _LIST_ENTRY* Blink;
+} LIST_ENTRY, *PLIST_ENTRY;
+
+// WDM objects only appear behind pointers in the simulated sources
+typedef struct _DEVICE_OBJECT DEVICE_OBJECT, *PDEVICE_OBJECT;
+typedef struct _DRIVER_OBJECT DRIVER_OBJECT, *PDRIVER_OBJECT;
+typedef struct _IRP IRP, *PIRP;
+
+// Only the field the filter sets on its mode request
+struct _IRP {
+	PVOID	UserBuffer;
+};
+
+#define IRP_MJ_MAXIMUM_FUNCTION	0x1b
+
+typedef NTSTATUS DRIVER_INITIALIZE(_In_ PDRIVER_OBJECT DriverObject, _In_ PUNICODE_STRING RegistryPath);
+typedef NTSTATUS DRIVER_DISPATCH(_In_ PDEVICE_OBJECT DeviceObject, _Inout_ PIRP Irp);
+typedef NTSTATUS DRIVER_ADD_DEVICE(_In_ PDRIVER_OBJECT DriverObject, _In_ PDEVICE_OBJECT PhysicalDeviceObject);
+typedef VOID DRIVER_UNLOAD(_In_ PDRIVER_OBJECT DriverObject);
+typedef DRIVER_DISPATCH* PDRIVER_DISPATCH;
+typedef DRIVER_ADD_DEVICE* PDRIVER_ADD_DEVICE;
+typedef DRIVER_UNLOAD* PDRIVER_UNLOAD;
+
+//
+// The virtual clock: interrupt time and the performance counter both run
+// in 100ns units from the start of the simulation.
+//
+ULONGLONG
+KeQueryInterruptTime(VOID);
+
+LARGE_INTEGER
+KeQueryPerformanceCounter(
+	_Out_opt_ PLARGE_INTEGER PerformanceFrequency
+);
@@ -0,0 +1,2 @@
+// poppack.h: Host stand-in, ends the packing of pshpack1.h
+#pragma pack(pop)
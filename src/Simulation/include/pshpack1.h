@@ -0,0 +1,2 @@
+// pshpack1.h: Host stand-in, byte packing until poppack.h
+#pragma pack(push, 1)
@@ -0,0 +1,32 @@
+// usb.h: Host stand-in for the USB descriptor types the drivers use
+#pragma once
+
+#include <ntddk.h>
+
+typedef LONG	USBD_STATUS;
+
+#define USBD_STATUS_SUCCESS		((USBD_STATUS) 0x00000000)
+#define USBD_STATUS_STALL_PID	((USBD_STATUS) 0xC0000004)
+
+#define USB_DEVICE_DESCRIPTOR_TYPE	0x01
+
+#pragma pack(push, 1)
+
+typedef struct _USB_DEVICE_DESCRIPTOR {
+	UCHAR	bLength;
+	UCHAR	bDescriptorType;
+	USHORT	bcdUSB;
+	UCHAR	bDeviceClass;
+	UCHAR	bDeviceSubClass;
+	UCHAR	bDeviceProtocol;
+	UCHAR	bMaxPacketSize0;
+	USHORT	idVendor;
+	USHORT	idProduct;
+	USHORT	bcdDevice;
+	UCHAR	iManufacturer;
+	UCHAR	iProduct;
+	UCHAR	iSerialNumber;
+	UCHAR	bNumConfigurations;
+} USB_DEVICE_DESCRIPTOR, *PUSB_DEVICE_DESCRIPTOR;
+
+#pragma pack(pop)
@@ -0,0 +1,2 @@
+// usbdlib.h: Empty host stand-in, the simulated sources use nothing from it
+#pragma once
@@ -0,0 +1,789 @@
+// wdf.h: Host stand-in for the WDF calls of the simulated drivers
+//
+// Objects, spinlocks, manual queues, requests and their memory, timers,
+// work items and the IO targets of a device, run by AmtPtpWdfSim.c on a
+// virtual clock. KMDF and UMDF share it, USB targets are in wdfusb.h. Signatures follow the WDK; anything the simulated sources
+// do not call is left out. Breaking a WDF rule the simulation can see, like
+// taking a spinlock twice or completing a request that is still queued,
+// stops the simulation with a message.
+#pragma once
+
+#include <ntddk.h>
+
+typedef PVOID WDFOBJECT;
+typedef PVOID WDFCONTEXT;
+typedef struct WDFDRIVER__* WDFDRIVER;
+typedef struct WDFDEVICE__* WDFDEVICE;
+typedef struct WDFQUEUE__* WDFQUEUE;
+typedef struct WDFREQUEST__* WDFREQUEST;
+typedef struct WDFMEMORY__* WDFMEMORY;
+typedef struct WDFSPINLOCK__* WDFSPINLOCK;
+typedef struct WDFTIMER__* WDFTIMER;
+typedef struct WDFWORKITEM__* WDFWORKITEM;
+typedef struct WDFIOTARGET__* WDFIOTARGET;
+typedef struct WDFCMRESLIST__* WDFCMRESLIST;
+typedef struct WDFDEVICE_INIT* PWDFDEVICE_INIT;
+
+typedef enum _WDF_TRI_STATE {
+	WdfFalse = FALSE,
+	WdfTrue = TRUE,
+	WdfUseDefault = 2
+} WDF_TRI_STATE;
+
+typedef enum _WDF_EXECUTION_LEVEL {
+	WdfExecutionLevelInvalid,
+	WdfExecutionLevelInheritFromParent,
+	WdfExecutionLevelPassive,
+	WdfExecutionLevelDispatch
+} WDF_EXECUTION_LEVEL;
+
+typedef enum _WDF_SYNCHRONIZATION_SCOPE {
+	WdfSynchronizationScopeInvalid,
+	WdfSynchronizationScopeInheritFromParent,
+	WdfSynchronizationScopeDevice,
+	WdfSynchronizationScopeQueue,
+	WdfSynchronizationScopeNone
+} WDF_SYNCHRONIZATION_SCOPE;
+
+typedef enum _WDF_POWER_DEVICE_STATE {
+	WdfPowerDeviceInvalid,
+	WdfPowerDeviceD0,
+	WdfPowerDeviceD1,
+	WdfPowerDeviceD2,
+	WdfPowerDeviceD3,
+	WdfPowerDeviceD3Final,
+	WdfPowerDevicePrepareForHibernation,
+	WdfPowerDeviceMaximum
+} WDF_POWER_DEVICE_STATE;
+
+typedef enum _WDF_DEVICE_FAILED_ACTION {
+	WdfDeviceFailedUndefined,
+	WdfDeviceFailedAttemptRestart,
+	WdfDeviceFailedNoRestart
+} WDF_DEVICE_FAILED_ACTION;
+
+typedef enum _WDF_IO_QUEUE_DISPATCH_TYPE {
+	WdfIoQueueDispatchInvalid,
+	WdfIoQueueDispatchSequential,
+	WdfIoQueueDispatchParallel,
+	WdfIoQueueDispatchManual
+} WDF_IO_QUEUE_DISPATCH_TYPE;
+
+//
+// Object attributes and contexts
+//
+
+typedef VOID EVT_WDF_OBJECT_CONTEXT_CLEANUP(_In_ WDFOBJECT Object);
+typedef EVT_WDF_OBJECT_CONTEXT_CLEANUP* PFN_WDF_OBJECT_CONTEXT_CLEANUP;
+
+typedef struct _WDF_OBJECT_CONTEXT_TYPE_INFO {
+	ULONG		Size;
+	const char*	ContextName;
+	size_t		ContextSize;
+} WDF_OBJECT_CONTEXT_TYPE_INFO, *PWDF_OBJECT_CONTEXT_TYPE_INFO;
+
+typedef struct _WDF_OBJECT_ATTRIBUTES {
+	ULONG	Size;
+	PFN_WDF_OBJECT_CONTEXT_CLEANUP EvtCleanupCallback;
+	PFN_WDF_OBJECT_CONTEXT_CLEANUP EvtDestroyCallback;
+	WDF_EXECUTION_LEVEL ExecutionLevel;
+	WDF_SYNCHRONIZATION_SCOPE SynchronizationScope;
+	WDFOBJECT	ParentObject;
+	size_t		ContextSizeOverride;
+	const WDF_OBJECT_CONTEXT_TYPE_INFO* ContextTypeInfo;
+} WDF_OBJECT_ATTRIBUTES, *PWDF_OBJECT_ATTRIBUTES;
+
+#define WDF_NO_OBJECT_ATTRIBUTES	NULL
+#define WDF_NO_HANDLE				NULL
+
+static __inline VOID
+WDF_OBJECT_ATTRIBUTES_INIT(
+	_Out_ PWDF_OBJECT_ATTRIBUTES Attributes
+)
+{
+	RtlZeroMemory(Attributes, sizeof(WDF_OBJECT_ATTRIBUTES));
+	Attributes->Size = sizeof(WDF_OBJECT_ATTRIBUTES);
+	Attributes->ExecutionLevel = WdfExecutionLevelInheritFromParent;
+	Attributes->SynchronizationScope = WdfSynchronizationScopeInheritFromParent;
+}
+
+// Contexts are matched by type name, every file has its own type info copy
+#define WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(ContextType, CastingFunction) \
+	static const WDF_OBJECT_CONTEXT_TYPE_INFO _WDF_##ContextType##_TYPE_INFO = { \
+		sizeof(WDF_OBJECT_CONTEXT_TYPE_INFO), #ContextType, sizeof(ContextType) \
+	}; \
+	static __inline ContextType* \
+	CastingFunction(_In_ WDFOBJECT Handle) \
+	{ \
+		return (ContextType*) WdfObjectGetTypedContextWorker(Handle, &_WDF_##ContextType##_TYPE_INFO); \
+	}
+
+#define WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(Attributes, ContextType) \
+	do { \
+		WDF_OBJECT_ATTRIBUTES_INIT(Attributes); \
+		(Attributes)->ContextTypeInfo = &_WDF_##ContextType##_TYPE_INFO; \
+	} while (0)
+
+PVOID
+WdfObjectGetTypedContextWorker(
+	_In_ WDFOBJECT Handle,
+	_In_ const WDF_OBJECT_CONTEXT_TYPE_INFO* TypeInfo
+);
+
+VOID
+WdfObjectDelete(
+	_In_ WDFOBJECT Object
+);
+
+WDFOBJECT
+WdfObjectContextGetObject(
+	_In_ PVOID ContextPointer
+);
+
+//
+// Driver
+//
+
+typedef NTSTATUS EVT_WDF_DRIVER_DEVICE_ADD(_In_ WDFDRIVER Driver, _Inout_ PWDFDEVICE_INIT DeviceInit);
+typedef EVT_WDF_DRIVER_DEVICE_ADD* PFN_WDF_DRIVER_DEVICE_ADD;
+
+typedef struct _WDF_DRIVER_CONFIG {
+	ULONG	Size;
+	PFN_WDF_DRIVER_DEVICE_ADD EvtDriverDeviceAdd;
+	ULONG	DriverInitFlags;
+	ULONG	DriverPoolTag;
+} WDF_DRIVER_CONFIG, *PWDF_DRIVER_CONFIG;
+
+static __inline VOID
+WDF_DRIVER_CONFIG_INIT(
+	_Out_ PWDF_DRIVER_CONFIG Config,
+	_In_opt_ PFN_WDF_DRIVER_DEVICE_ADD EvtDriverDeviceAdd
+)
+{
+	RtlZeroMemory(Config, sizeof(WDF_DRIVER_CONFIG));
+	Config->Size = sizeof(WDF_DRIVER_CONFIG);
+	Config->EvtDriverDeviceAdd = EvtDriverDeviceAdd;
+}
+
+NTSTATUS
+WdfDriverCreate(
+	_In_ PDRIVER_OBJECT DriverObject,
+	_In_ PUNICODE_STRING RegistryPath,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES DriverAttributes,
+	_In_ PWDF_DRIVER_CONFIG DriverConfig,
+	_Out_opt_ WDFDRIVER* Driver
+);
+
+PDRIVER_OBJECT
+WdfDriverWdmGetDriverObject(
+	_In_ WDFDRIVER Driver
+);
+
+//
+// Device
+//
+
+typedef NTSTATUS EVT_WDF_DEVICE_PREPARE_HARDWARE(_In_ WDFDEVICE Device, _In_ WDFCMRESLIST ResourcesRaw,
+	_In_ WDFCMRESLIST ResourcesTranslated);
+typedef NTSTATUS EVT_WDF_DEVICE_D0_ENTRY(_In_ WDFDEVICE Device, _In_ WDF_POWER_DEVICE_STATE PreviousState);
+typedef NTSTATUS EVT_WDF_DEVICE_D0_EXIT(_In_ WDFDEVICE Device, _In_ WDF_POWER_DEVICE_STATE TargetState);
+typedef NTSTATUS EVT_WDF_DEVICE_SELF_MANAGED_IO_INIT(_In_ WDFDEVICE Device);
+typedef NTSTATUS EVT_WDF_DEVICE_SELF_MANAGED_IO_RESTART(_In_ WDFDEVICE Device);
+typedef EVT_WDF_DEVICE_PREPARE_HARDWARE* PFN_WDF_DEVICE_PREPARE_HARDWARE;
+typedef EVT_WDF_DEVICE_D0_ENTRY* PFN_WDF_DEVICE_D0_ENTRY;
+typedef EVT_WDF_DEVICE_D0_EXIT* PFN_WDF_DEVICE_D0_EXIT;
+typedef EVT_WDF_DEVICE_SELF_MANAGED_IO_INIT* PFN_WDF_DEVICE_SELF_MANAGED_IO_INIT;
+typedef EVT_WDF_DEVICE_SELF_MANAGED_IO_RESTART* PFN_WDF_DEVICE_SELF_MANAGED_IO_RESTART;
+
+typedef struct _WDF_PNPPOWER_EVENT_CALLBACKS {
+	ULONG	Size;
+	PFN_WDF_DEVICE_D0_ENTRY EvtDeviceD0Entry;
+	PFN_WDF_DEVICE_D0_EXIT EvtDeviceD0Exit;
+	PFN_WDF_DEVICE_PREPARE_HARDWARE EvtDevicePrepareHardware;
+	PFN_WDF_DEVICE_SELF_MANAGED_IO_INIT EvtDeviceSelfManagedIoInit;
+	PFN_WDF_DEVICE_SELF_MANAGED_IO_RESTART EvtDeviceSelfManagedIoRestart;
+} WDF_PNPPOWER_EVENT_CALLBACKS, *PWDF_PNPPOWER_EVENT_CALLBACKS;
+
+static __inline VOID
+WDF_PNPPOWER_EVENT_CALLBACKS_INIT(
+	_Out_ PWDF_PNPPOWER_EVENT_CALLBACKS Callbacks
+)
+{
+	RtlZeroMemory(Callbacks, sizeof(WDF_PNPPOWER_EVENT_CALLBACKS));
+	Callbacks->Size = sizeof(WDF_PNPPOWER_EVENT_CALLBACKS);
+}
+
+VOID
+WdfFdoInitSetFilter(
+	_In_ PWDFDEVICE_INIT DeviceInit
+);
+
+VOID
+WdfDeviceInitSetPnpPowerEventCallbacks(
+	_In_ PWDFDEVICE_INIT DeviceInit,
+	_In_ PWDF_PNPPOWER_EVENT_CALLBACKS PnpPowerEventCallbacks
+);
+
+NTSTATUS
+WdfDeviceCreate(
+	_Inout_ PWDFDEVICE_INIT* DeviceInit,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES DeviceAttributes,
+	_Out_ WDFDEVICE* Device
+);
+
+PDEVICE_OBJECT
+WdfDeviceWdmGetDeviceObject(
+	_In_ WDFDEVICE Device
+);
+
+NTSTATUS
+WdfDeviceCreateDeviceInterface(
+	_In_ WDFDEVICE Device,
+	_In_ const GUID* InterfaceClassGUID,
+	_In_opt_ PUNICODE_STRING ReferenceString
+);
+
+WDFIOTARGET
+WdfDeviceGetIoTarget(
+	_In_ WDFDEVICE Device
+);
+
+VOID
+WdfDeviceSetFailed(
+	_In_ WDFDEVICE Device,
+	_In_ WDF_DEVICE_FAILED_ACTION FailedAction
+);
+
+typedef struct _WDF_DEVICE_PNP_CAPABILITIES {
+	ULONG	Size;
+	WDF_TRI_STATE LockSupported;
+	WDF_TRI_STATE EjectSupported;
+	WDF_TRI_STATE Removable;
+	WDF_TRI_STATE DockDevice;
+	WDF_TRI_STATE UniqueID;
+	WDF_TRI_STATE SilentInstall;
+	WDF_TRI_STATE SurpriseRemovalOK;
+	WDF_TRI_STATE HardwareDisabled;
+	WDF_TRI_STATE NoDisplayInUI;
+	ULONG	Address;
+	ULONG	UINumber;
+} WDF_DEVICE_PNP_CAPABILITIES, *PWDF_DEVICE_PNP_CAPABILITIES;
+
+static __inline VOID
+WDF_DEVICE_PNP_CAPABILITIES_INIT(
+	_Out_ PWDF_DEVICE_PNP_CAPABILITIES Caps
+)
+{
+	RtlZeroMemory(Caps, sizeof(WDF_DEVICE_PNP_CAPABILITIES));
+	Caps->Size = sizeof(WDF_DEVICE_PNP_CAPABILITIES);
+	Caps->LockSupported = WdfUseDefault;
+	Caps->EjectSupported = WdfUseDefault;
+	Caps->Removable = WdfUseDefault;
+	Caps->DockDevice = WdfUseDefault;
+	Caps->UniqueID = WdfUseDefault;
+	Caps->SilentInstall = WdfUseDefault;
+	Caps->SurpriseRemovalOK = WdfUseDefault;
+	Caps->HardwareDisabled = WdfUseDefault;
+	Caps->NoDisplayInUI = WdfUseDefault;
+	Caps->Address = (ULONG) -1;
+	Caps->UINumber = (ULONG) -1;
+}
+
+// Nothing in the simulation acts on them
+VOID
+WdfDeviceSetPnpCapabilities(
+	_In_ WDFDEVICE Device,
+	_In_ PWDF_DEVICE_PNP_CAPABILITIES PnpCapabilities
+);
+
+//
+// Spinlocks
+//
+
+NTSTATUS
+WdfSpinLockCreate(
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES SpinLockAttributes,
+	_Out_ WDFSPINLOCK* SpinLock
+);
+
+VOID
+WdfSpinLockAcquire(
+	_In_ WDFSPINLOCK SpinLock
+);
+
+VOID
+WdfSpinLockRelease(
+	_In_ WDFSPINLOCK SpinLock
+);
+
+//
+// Memory
+//
+
+NTSTATUS
+WdfMemoryCreate(
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_In_ POOL_TYPE PoolType,
+	_In_opt_ ULONG PoolTag,
+	_In_ size_t BufferSize,
+	_Out_ WDFMEMORY* Memory,
+	_Out_opt_ PVOID* Buffer
+);
+
+PVOID
+WdfMemoryGetBuffer(
+	_In_ WDFMEMORY Memory,
+	_Out_opt_ size_t* BufferSize
+);
+
+NTSTATUS
+WdfMemoryCreatePreallocated(
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_In_ PVOID Buffer,
+	_In_ size_t BufferSize,
+	_Out_ WDFMEMORY* Memory
+);
+
+NTSTATUS
+WdfMemoryCopyToBuffer(
+	_In_ WDFMEMORY SourceMemory,
+	_In_ size_t SourceOffset,
+	_Out_writes_bytes_(NumBytesToCopyTo) PVOID Buffer,
+	_In_ size_t NumBytesToCopyTo
+);
+
+NTSTATUS
+WdfMemoryCopyFromBuffer(
+	_In_ WDFMEMORY DestinationMemory,
+	_In_ size_t DestinationOffset,
+	_In_reads_bytes_(NumBytesToCopyFrom) PVOID Buffer,
+	_In_ size_t NumBytesToCopyFrom
+);
+
+typedef struct _WDFMEMORY_OFFSET {
+	size_t	BufferOffset;
+	size_t	BufferLength;
+} WDFMEMORY_OFFSET, *PWDFMEMORY_OFFSET;
+
+//
+// Requests
+//
+
+typedef struct _IO_STATUS_BLOCK {
+	NTSTATUS	Status;
+	ULONG_PTR	Information;
+} IO_STATUS_BLOCK, *PIO_STATUS_BLOCK;
+
+typedef struct _WDF_REQUEST_COMPLETION_PARAMS {
+	ULONG	Size;
+	ULONG	Type;
+	IO_STATUS_BLOCK IoStatus;
+} WDF_REQUEST_COMPLETION_PARAMS, *PWDF_REQUEST_COMPLETION_PARAMS;
+
+typedef VOID EVT_WDF_REQUEST_COMPLETION_ROUTINE(_In_ WDFREQUEST Request, _In_ WDFIOTARGET Target,
+	_In_ PWDF_REQUEST_COMPLETION_PARAMS Params, _In_ WDFCONTEXT Context);
+typedef EVT_WDF_REQUEST_COMPLETION_ROUTINE* PFN_WDF_REQUEST_COMPLETION_ROUTINE;
+
+#define WDF_REQUEST_REUSE_NO_FLAGS	0x00000000
+
+typedef struct _WDF_REQUEST_REUSE_PARAMS {
+	ULONG		Size;
+	ULONG		Flags;
+	NTSTATUS	Status;
+	PIRP		NewIrp;
+} WDF_REQUEST_REUSE_PARAMS, *PWDF_REQUEST_REUSE_PARAMS;
+
+static __inline VOID
+WDF_REQUEST_REUSE_PARAMS_INIT(
+	_Out_ PWDF_REQUEST_REUSE_PARAMS Params,
+	_In_ ULONG Flags,
+	_In_ NTSTATUS Status
+)
+{
+	RtlZeroMemory(Params, sizeof(WDF_REQUEST_REUSE_PARAMS));
+	Params->Size = sizeof(WDF_REQUEST_REUSE_PARAMS);
+	Params->Flags = Flags;
+	Params->Status = Status;
+}
+
+#define WDF_REQUEST_SEND_OPTION_TIMEOUT				0x00000001
+#define WDF_REQUEST_SEND_OPTION_SYNCHRONOUS			0x00000002
+#define WDF_REQUEST_SEND_OPTION_IGNORE_TARGET_STATE	0x00000004
+#define WDF_REQUEST_SEND_OPTION_SEND_AND_FORGET		0x00000008
+
+typedef struct _WDF_REQUEST_SEND_OPTIONS {
+	ULONG		Size;
+	ULONG		Flags;
+	LONGLONG	Timeout;
+} WDF_REQUEST_SEND_OPTIONS, *PWDF_REQUEST_SEND_OPTIONS;
+
+#define WDF_NO_SEND_OPTIONS	NULL
+
+static __inline VOID
+WDF_REQUEST_SEND_OPTIONS_INIT(
+	_Out_ PWDF_REQUEST_SEND_OPTIONS Options,
+	_In_ ULONG Flags
+)
+{
+	RtlZeroMemory(Options, sizeof(WDF_REQUEST_SEND_OPTIONS));
+	Options->Size = sizeof(WDF_REQUEST_SEND_OPTIONS);
+	Options->Flags = Flags;
+}
+
+NTSTATUS
+WdfRequestCreate(
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES RequestAttributes,
+	_In_opt_ WDFIOTARGET IoTarget,
+	_Out_ WDFREQUEST* Request
+);
+
+NTSTATUS
+WdfRequestReuse(
+	_In_ WDFREQUEST Request,
+	_In_ PWDF_REQUEST_REUSE_PARAMS ReuseParams
+);
+
+VOID
+WdfRequestSetCompletionRoutine(
+	_In_ WDFREQUEST Request,
+	_In_opt_ PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine,
+	_In_opt_ WDFCONTEXT CompletionContext
+);
+
+BOOLEAN
+WdfRequestSend(
+	_In_ WDFREQUEST Request,
+	_In_ WDFIOTARGET Target,
+	_In_opt_ PWDF_REQUEST_SEND_OPTIONS RequestOptions
+);
+
+//
+// The request completes with STATUS_CANCELLED as its own event, unless the
+// target already completed it. Returns whether it was still sent.
+//
+BOOLEAN
+WdfRequestCancelSentRequest(
+	_In_ WDFREQUEST Request
+);
+
+VOID
+WdfRequestComplete(
+	_In_ WDFREQUEST Request,
+	_In_ NTSTATUS Status
+);
+
+NTSTATUS
+WdfRequestGetStatus(
+	_In_ WDFREQUEST Request
+);
+
+ULONG_PTR
+WdfRequestGetInformation(
+	_In_ WDFREQUEST Request
+);
+
+VOID
+WdfRequestSetInformation(
+	_In_ WDFREQUEST Request,
+	_In_ ULONG_PTR Information
+);
+
+NTSTATUS
+WdfRequestRetrieveOutputMemory(
+	_In_ WDFREQUEST Request,
+	_Out_ WDFMEMORY* Memory
+);
+
+NTSTATUS
+WdfRequestRetrieveOutputBuffer(
+	_In_ WDFREQUEST Request,
+	_In_ size_t MinimumRequiredSize,
+	_Out_ PVOID* Buffer,
+	_Out_opt_ size_t* Length
+);
+
+NTSTATUS
+WdfRequestRetrieveInputMemory(
+	_In_ WDFREQUEST Request,
+	_Out_ WDFMEMORY* Memory
+);
+
+PIRP
+WdfRequestWdmGetIrp(
+	_In_ WDFREQUEST Request
+);
+
+NTSTATUS
+WdfRequestForwardToIoQueue(
+	_In_ WDFREQUEST Request,
+	_In_ WDFQUEUE DestinationQueue
+);
+
+//
+// Queues. The default queue dispatches device controls in parallel, the
+// internal ones of KMDF or the ones UMDF turns them into. Other queues are
+// manual.
+//
+
+typedef VOID EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL(_In_ WDFQUEUE Queue, _In_ WDFREQUEST Request,
+	_In_ size_t OutputBufferLength, _In_ size_t InputBufferLength, _In_ ULONG IoControlCode);
+typedef VOID EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL(_In_ WDFQUEUE Queue, _In_ WDFREQUEST Request,
+	_In_ size_t OutputBufferLength, _In_ size_t InputBufferLength, _In_ ULONG IoControlCode);
+typedef VOID EVT_WDF_IO_QUEUE_IO_STOP(_In_ WDFQUEUE Queue, _In_ WDFREQUEST Request, _In_ ULONG ActionFlags);
+typedef EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL* PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL;
+typedef EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL* PFN_WDF_IO_QUEUE_IO_DEVICE_CONTROL;
+typedef EVT_WDF_IO_QUEUE_IO_STOP* PFN_WDF_IO_QUEUE_IO_STOP;
+
+typedef enum _WDF_IO_QUEUE_STATE {
+	WdfIoQueueAcceptRequests = 0x01,
+	WdfIoQueueDispatchRequests = 0x02,
+	WdfIoQueueNoRequests = 0x04,
+	WdfIoQueueDriverNoRequests = 0x08,
+	WdfIoQueuePnpHeld = 0x10
+} WDF_IO_QUEUE_STATE;
+
+typedef struct _WDF_IO_QUEUE_CONFIG {
+	ULONG	Size;
+	WDF_IO_QUEUE_DISPATCH_TYPE DispatchType;
+	WDF_TRI_STATE PowerManaged;
+	BOOLEAN	DefaultQueue;
+	PFN_WDF_IO_QUEUE_IO_DEVICE_CONTROL EvtIoDeviceControl;
+	PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL EvtIoInternalDeviceControl;
+	PFN_WDF_IO_QUEUE_IO_STOP EvtIoStop;
+} WDF_IO_QUEUE_CONFIG, *PWDF_IO_QUEUE_CONFIG;
+
+static __inline VOID
+WDF_IO_QUEUE_CONFIG_INIT(
+	_Out_ PWDF_IO_QUEUE_CONFIG Config,
+	_In_ WDF_IO_QUEUE_DISPATCH_TYPE DispatchType
+)
+{
+	RtlZeroMemory(Config, sizeof(WDF_IO_QUEUE_CONFIG));
+	Config->Size = sizeof(WDF_IO_QUEUE_CONFIG);
+	Config->DispatchType = DispatchType;
+	Config->PowerManaged = WdfUseDefault;
+}
+
+static __inline VOID
+WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(
+	_Out_ PWDF_IO_QUEUE_CONFIG Config,
+	_In_ WDF_IO_QUEUE_DISPATCH_TYPE DispatchType
+)
+{
+	WDF_IO_QUEUE_CONFIG_INIT(Config, DispatchType);
+	Config->DefaultQueue = TRUE;
+}
+
+NTSTATUS
+WdfIoQueueCreate(
+	_In_ WDFDEVICE Device,
+	_In_ PWDF_IO_QUEUE_CONFIG Config,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES QueueAttributes,
+	_Out_opt_ WDFQUEUE* Queue
+);
+
+NTSTATUS
+WdfIoQueueRetrieveNextRequest(
+	_In_ WDFQUEUE Queue,
+	_Out_ WDFREQUEST* OutRequest
+);
+
+// A manual queue holds every request it has, DriverRequests is always 0
+WDF_IO_QUEUE_STATE
+WdfIoQueueGetState(
+	_In_ WDFQUEUE Queue,
+	_Out_opt_ PULONG QueueRequests,
+	_Out_opt_ PULONG DriverRequests
+);
+
+WDFDEVICE
+WdfIoQueueGetDevice(
+	_In_ WDFQUEUE Queue
+);
+
+//
+// IO targets
+//
+
+typedef enum _WDF_MEMORY_DESCRIPTOR_TYPE {
+	WdfMemoryDescriptorTypeInvalid,
+	WdfMemoryDescriptorTypeBuffer,
+	WdfMemoryDescriptorTypeMdl,
+	WdfMemoryDescriptorTypeHandle
+} WDF_MEMORY_DESCRIPTOR_TYPE;
+
+typedef struct _WDF_MEMORY_DESCRIPTOR {
+	WDF_MEMORY_DESCRIPTOR_TYPE Type;
+	union {
+		struct {
+			PVOID	Buffer;
+			ULONG	Length;
+		} BufferType;
+		struct {
+			WDFMEMORY Memory;
+			PWDFMEMORY_OFFSET Offsets;
+		} HandleType;
+	} u;
+} WDF_MEMORY_DESCRIPTOR, *PWDF_MEMORY_DESCRIPTOR;
+
+static __inline VOID
+WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+	_Out_ PWDF_MEMORY_DESCRIPTOR Descriptor,
+	_In_ PVOID Buffer,
+	_In_ ULONG BufferLength
+)
+{
+	RtlZeroMemory(Descriptor, sizeof(WDF_MEMORY_DESCRIPTOR));
+	Descriptor->Type = WdfMemoryDescriptorTypeBuffer;
+	Descriptor->u.BufferType.Buffer = Buffer;
+	Descriptor->u.BufferType.Length = BufferLength;
+}
+
+static __inline VOID
+WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(
+	_Out_ PWDF_MEMORY_DESCRIPTOR Descriptor,
+	_In_ WDFMEMORY Memory,
+	_In_opt_ PWDFMEMORY_OFFSET Offsets
+)
+{
+	RtlZeroMemory(Descriptor, sizeof(WDF_MEMORY_DESCRIPTOR));
+	Descriptor->Type = WdfMemoryDescriptorTypeHandle;
+	Descriptor->u.HandleType.Memory = Memory;
+	Descriptor->u.HandleType.Offsets = Offsets;
+}
+
+typedef enum _WDF_IO_TARGET_SENT_IO_ACTION {
+	WdfIoTargetSentIoUndefined,
+	WdfIoTargetCancelSentIo,
+	WdfIoTargetWaitForSentIoToComplete,
+	WdfIoTargetLeaveSentIoPending
+} WDF_IO_TARGET_SENT_IO_ACTION;
+
+//
+// A device's own target is always started. Sends to a stopped target fail
+// with STATUS_INVALID_DEVICE_STATE, and stopping it with
+// WdfIoTargetCancelSentIo cancels what it holds before returning.
+//
+NTSTATUS
+WdfIoTargetStart(
+	_In_ WDFIOTARGET IoTarget
+);
+
+VOID
+WdfIoTargetStop(
+	_In_ WDFIOTARGET IoTarget,
+	_In_ WDF_IO_TARGET_SENT_IO_ACTION Action
+);
+
+NTSTATUS
+WdfIoTargetSendInternalIoctlSynchronously(
+	_In_ WDFIOTARGET IoTarget,
+	_In_opt_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_opt_ PWDF_MEMORY_DESCRIPTOR InputBuffer,
+	_In_opt_ PWDF_MEMORY_DESCRIPTOR OutputBuffer,
+	_In_opt_ PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	_Out_opt_ PULONG_PTR BytesReturned
+);
+
+NTSTATUS
+WdfIoTargetFormatRequestForInternalIoctl(
+	_In_ WDFIOTARGET IoTarget,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoctlCode,
+	_In_opt_ WDFMEMORY InputBuffer,
+	_In_opt_ PWDFMEMORY_OFFSET InputBufferOffset,
+	_In_opt_ WDFMEMORY OutputBuffer,
+	_In_opt_ PWDFMEMORY_OFFSET OutputBufferOffset
+);
+
+//
+// Timers and work items
+//
+
+typedef VOID EVT_WDF_TIMER(_In_ WDFTIMER Timer);
+typedef EVT_WDF_TIMER* PFN_WDF_TIMER;
+typedef VOID EVT_WDF_WORKITEM(_In_ WDFWORKITEM WorkItem);
+typedef EVT_WDF_WORKITEM* PFN_WDF_WORKITEM;
+
+typedef struct _WDF_TIMER_CONFIG {
+	ULONG	Size;
+	PFN_WDF_TIMER EvtTimerFunc;
+	ULONG	Period;
+	BOOLEAN	AutomaticSerialization;
+} WDF_TIMER_CONFIG, *PWDF_TIMER_CONFIG;
+
+static __inline VOID
+WDF_TIMER_CONFIG_INIT(
+	_Out_ PWDF_TIMER_CONFIG Config,
+	_In_ PFN_WDF_TIMER EvtTimerFunc
+)
+{
+	RtlZeroMemory(Config, sizeof(WDF_TIMER_CONFIG));
+	Config->Size = sizeof(WDF_TIMER_CONFIG);
+	Config->EvtTimerFunc = EvtTimerFunc;
+	Config->AutomaticSerialization = TRUE;
+}
+
+typedef struct _WDF_WORKITEM_CONFIG {
+	ULONG	Size;
+	PFN_WDF_WORKITEM EvtWorkItemFunc;
+	BOOLEAN	AutomaticSerialization;
+} WDF_WORKITEM_CONFIG, *PWDF_WORKITEM_CONFIG;
+
+static __inline VOID
+WDF_WORKITEM_CONFIG_INIT(
+	_Out_ PWDF_WORKITEM_CONFIG Config,
+	_In_ PFN_WDF_WORKITEM EvtWorkItemFunc
+)
+{
+	RtlZeroMemory(Config, sizeof(WDF_WORKITEM_CONFIG));
+	Config->Size = sizeof(WDF_WORKITEM_CONFIG);
+	Config->EvtWorkItemFunc = EvtWorkItemFunc;
+	Config->AutomaticSerialization = TRUE;
+}
+
+// Negative due times are relative, in 100ns units
+#define WDF_REL_TIMEOUT_IN_MS(Ms)	(-((LONGLONG) (Ms) * 10000))
+#define WDF_REL_TIMEOUT_IN_US(Us)	(-((LONGLONG) (Us) * 10))
+
+NTSTATUS
+WdfTimerCreate(
+	_In_ PWDF_TIMER_CONFIG Config,
+	_In_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_Out_ WDFTIMER* Timer
+);
+
+BOOLEAN
+WdfTimerStart(
+	_In_ WDFTIMER Timer,
+	_In_ LONGLONG DueTime
+);
+
+BOOLEAN
+WdfTimerStop(
+	_In_ WDFTIMER Timer,
+	_In_ BOOLEAN Wait
+);
+
+WDFOBJECT
+WdfTimerGetParentObject(
+	_In_ WDFTIMER Timer
+);
+
+NTSTATUS
+WdfWorkItemCreate(
+	_In_ PWDF_WORKITEM_CONFIG Config,
+	_In_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_Out_ WDFWORKITEM* WorkItem
+);
+
+VOID
+WdfWorkItemEnqueue(
+	_In_ WDFWORKITEM WorkItem
+);
+
+WDFOBJECT
+WdfWorkItemGetParentObject(
+	_In_ WDFWORKITEM WorkItem
+);
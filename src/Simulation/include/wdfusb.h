@@ -0,0 +1,300 @@
+// wdfusb.h: Host stand-in for the WDF USB target calls of the UMDF driver
+//
+// One device with one interface and one interrupt IN pipe. Control
+// transfers go to the device's IO target and are answered by the harness,
+// the pipe's continuous reader is fed like any other read, see
+// AmtPtpSimUsbConfig and AmtPtpSimPipePush in AmtPtpWdfSim.h.
+#pragma once
+
+#include <wdf.h>
+#include <usb.h>
+
+typedef struct WDFUSBDEVICE__* WDFUSBDEVICE;
+typedef struct WDFUSBINTERFACE__* WDFUSBINTERFACE;
+typedef struct WDFUSBPIPE__* WDFUSBPIPE;
+
+#define WDF_USB_DEVICE_TRAIT_SELF_POWERED			0x00000001
+#define WDF_USB_DEVICE_TRAIT_REMOTE_WAKE_CAPABLE	0x00000002
+#define WDF_USB_DEVICE_TRAIT_AT_HIGH_SPEED			0x00000004
+
+typedef enum _WDF_USB_PIPE_TYPE {
+	WdfUsbPipeTypeInvalid,
+	WdfUsbPipeTypeControl,
+	WdfUsbPipeTypeIsochronous,
+	WdfUsbPipeTypeBulk,
+	WdfUsbPipeTypeInterrupt
+} WDF_USB_PIPE_TYPE;
+
+typedef enum _WDF_USB_BMREQUEST_DIRECTION {
+	BmRequestHostToDevice,
+	BmRequestDeviceToHost
+} WDF_USB_BMREQUEST_DIRECTION;
+
+typedef enum _WDF_USB_BMREQUEST_TYPE {
+	BmRequestStandard,
+	BmRequestClass,
+	BmRequestVendor
+} WDF_USB_BMREQUEST_TYPE;
+
+typedef enum _WDF_USB_BMREQUEST_RECIPIENT {
+	BmRequestToDevice,
+	BmRequestToInterface,
+	BmRequestToEndpoint,
+	BmRequestToOther
+} WDF_USB_BMREQUEST_RECIPIENT;
+
+#pragma pack(push, 1)
+
+typedef union _WDF_USB_CONTROL_SETUP_PACKET {
+	struct {
+		union {
+			struct {
+				ULONG	Recipient : 2;
+				ULONG	Reserved : 3;
+				ULONG	Type : 2;
+				ULONG	Dir : 1;
+			} Request;
+			UCHAR	Byte;
+		} bm;
+		UCHAR	bRequest;
+		union {
+			struct {
+				UCHAR	LowByte;
+				UCHAR	HiByte;
+			} Bytes;
+			USHORT	Value;
+		} wValue;
+		union {
+			struct {
+				UCHAR	LowByte;
+				UCHAR	HiByte;
+			} Bytes;
+			USHORT	Value;
+		} wIndex;
+		USHORT	wLength;
+	} Packet;
+	struct {
+		UCHAR	Bytes[8];
+	} Generic;
+} WDF_USB_CONTROL_SETUP_PACKET, *PWDF_USB_CONTROL_SETUP_PACKET;
+
+#pragma pack(pop)
+
+static __inline VOID
+WDF_USB_CONTROL_SETUP_PACKET_INIT(
+	_Out_ PWDF_USB_CONTROL_SETUP_PACKET Packet,
+	_In_ WDF_USB_BMREQUEST_DIRECTION Direction,
+	_In_ WDF_USB_BMREQUEST_RECIPIENT Recipient,
+	_In_ UCHAR Request,
+	_In_ USHORT Value,
+	_In_ USHORT Index
+)
+{
+	RtlZeroMemory(Packet, sizeof(WDF_USB_CONTROL_SETUP_PACKET));
+	Packet->Packet.bm.Request.Dir = Direction;
+	Packet->Packet.bm.Request.Type = BmRequestStandard;
+	Packet->Packet.bm.Request.Recipient = Recipient;
+	Packet->Packet.bRequest = Request;
+	Packet->Packet.wValue.Value = Value;
+	Packet->Packet.wIndex.Value = Index;
+}
+
+//
+// USB device
+//
+
+typedef struct _WDF_USB_DEVICE_INFORMATION {
+	ULONG	Size;
+	ULONG	HcdPortCapabilities;
+	ULONG	Traits;
+} WDF_USB_DEVICE_INFORMATION, *PWDF_USB_DEVICE_INFORMATION;
+
+static __inline VOID
+WDF_USB_DEVICE_INFORMATION_INIT(
+	_Out_ PWDF_USB_DEVICE_INFORMATION Information
+)
+{
+	RtlZeroMemory(Information, sizeof(WDF_USB_DEVICE_INFORMATION));
+	Information->Size = sizeof(WDF_USB_DEVICE_INFORMATION);
+}
+
+typedef enum _WdfUsbTargetDeviceSelectConfigType {
+	WdfUsbTargetDeviceSelectConfigTypeInvalid,
+	WdfUsbTargetDeviceSelectConfigTypeDeconfig,
+	WdfUsbTargetDeviceSelectConfigTypeSingleInterface
+} WdfUsbTargetDeviceSelectConfigType;
+
+typedef struct _WDF_USB_DEVICE_SELECT_CONFIG_PARAMS {
+	ULONG	Size;
+	WdfUsbTargetDeviceSelectConfigType Type;
+	union {
+		struct {
+			UCHAR	NumberConfiguredPipes;
+			WDFUSBINTERFACE ConfiguredUsbInterface;
+		} SingleInterface;
+	} Types;
+} WDF_USB_DEVICE_SELECT_CONFIG_PARAMS, *PWDF_USB_DEVICE_SELECT_CONFIG_PARAMS;
+
+static __inline VOID
+WDF_USB_DEVICE_SELECT_CONFIG_PARAMS_INIT_SINGLE_INTERFACE(
+	_Out_ PWDF_USB_DEVICE_SELECT_CONFIG_PARAMS Params
+)
+{
+	RtlZeroMemory(Params, sizeof(WDF_USB_DEVICE_SELECT_CONFIG_PARAMS));
+	Params->Size = sizeof(WDF_USB_DEVICE_SELECT_CONFIG_PARAMS);
+	Params->Type = WdfUsbTargetDeviceSelectConfigTypeSingleInterface;
+}
+
+NTSTATUS
+WdfUsbTargetDeviceCreate(
+	_In_ WDFDEVICE Device,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES Attributes,
+	_Out_ WDFUSBDEVICE* UsbDevice
+);
+
+VOID
+WdfUsbTargetDeviceGetDeviceDescriptor(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_Out_ PUSB_DEVICE_DESCRIPTOR UsbDeviceDescriptor
+);
+
+NTSTATUS
+WdfUsbTargetDeviceRetrieveInformation(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_Out_ PWDF_USB_DEVICE_INFORMATION Information
+);
+
+// String descriptors are not simulated, asking for one stops the simulation
+NTSTATUS
+WdfUsbTargetDeviceAllocAndQueryString(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_In_opt_ PWDF_OBJECT_ATTRIBUTES StringMemoryAttributes,
+	_Out_ WDFMEMORY* StringMemory,
+	_Out_opt_ PUSHORT NumCharacters,
+	_In_ UCHAR StringIndex,
+	_In_opt_ USHORT LangID
+);
+
+WDFUSBINTERFACE
+WdfUsbTargetDeviceGetInterface(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_In_ UCHAR InterfaceIndex
+);
+
+WDFIOTARGET
+WdfUsbTargetDeviceGetIoTarget(
+	_In_ WDFUSBDEVICE UsbDevice
+);
+
+//
+// Control transfers. The length is the buffer's, either way.
+//
+
+NTSTATUS
+WdfUsbTargetDeviceSendControlTransferSynchronously(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_In_opt_ WDFREQUEST Request,
+	_In_opt_ PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	_In_ PWDF_USB_CONTROL_SETUP_PACKET SetupPacket,
+	_In_opt_ PWDF_MEMORY_DESCRIPTOR MemoryDescriptor,
+	_Out_opt_ PULONG BytesTransferred
+);
+
+NTSTATUS
+WdfUsbTargetDeviceFormatRequestForControlTransfer(
+	_In_ WDFUSBDEVICE UsbDevice,
+	_In_ WDFREQUEST Request,
+	_In_ PWDF_USB_CONTROL_SETUP_PACKET SetupPacket,
+	_In_opt_ WDFMEMORY TransferMemory,
+	_In_opt_ PWDFMEMORY_OFFSET TransferOffset
+);
+
+//
+// Interface and pipes
+//
+
+typedef struct _WDF_USB_PIPE_INFORMATION {
+	ULONG	Size;
+	ULONG	MaximumPacketSize;
+	UCHAR	EndpointAddress;
+	UCHAR	Interval;
+	UCHAR	SettingIndex;
+	WDF_USB_PIPE_TYPE PipeType;
+	ULONG	MaximumTransferSize;
+} WDF_USB_PIPE_INFORMATION, *PWDF_USB_PIPE_INFORMATION;
+
+static __inline VOID
+WDF_USB_PIPE_INFORMATION_INIT(
+	_Out_ PWDF_USB_PIPE_INFORMATION Information
+)
+{
+	RtlZeroMemory(Information, sizeof(WDF_USB_PIPE_INFORMATION));
+	Information->Size = sizeof(WDF_USB_PIPE_INFORMATION);
+}
+
+UCHAR
+WdfUsbInterfaceGetNumConfiguredPipes(
+	_In_ WDFUSBINTERFACE UsbInterface
+);
+
+WDFUSBPIPE
+WdfUsbInterfaceGetConfiguredPipe(
+	_In_ WDFUSBINTERFACE UsbInterface,
+	_In_ UCHAR PipeIndex,
+	_Out_opt_ PWDF_USB_PIPE_INFORMATION PipeInfo
+);
+
+VOID
+WdfUsbTargetPipeSetNoMaximumPacketSizeCheck(
+	_In_ WDFUSBPIPE Pipe
+);
+
+WDFIOTARGET
+WdfUsbTargetPipeGetIoTarget(
+	_In_ WDFUSBPIPE Pipe
+);
+
+//
+// The continuous reader keeps NumPendingReads reads on the pipe while its
+// target is started. Failed reads stop all of them and go to
+// EvtUsbTargetPipeReadersFailed, which restarts them by returning TRUE.
+//
+
+typedef VOID EVT_WDF_USB_READER_COMPLETION_ROUTINE(_In_ WDFUSBPIPE Pipe, _In_ WDFMEMORY Buffer,
+	_In_ size_t NumBytesTransferred, _In_ WDFCONTEXT Context);
+typedef BOOLEAN EVT_WDF_USB_READERS_FAILED(_In_ WDFUSBPIPE Pipe, _In_ NTSTATUS Status, _In_ USBD_STATUS UsbdStatus);
+typedef EVT_WDF_USB_READER_COMPLETION_ROUTINE* PFN_WDF_USB_READER_COMPLETION_ROUTINE;
+typedef EVT_WDF_USB_READERS_FAILED* PFN_WDF_USB_READERS_FAILED;
+
+typedef struct _WDF_USB_CONTINUOUS_READER_CONFIG {
+	ULONG	Size;
+	size_t	TransferLength;
+	size_t	HeaderLength;
+	size_t	TrailerLength;
+	UCHAR	NumPendingReads;
+	PWDF_OBJECT_ATTRIBUTES BufferAttributes;
+	PFN_WDF_USB_READER_COMPLETION_ROUTINE EvtUsbTargetPipeReadComplete;
+	WDFCONTEXT EvtUsbTargetPipeReadCompleteContext;
+	PFN_WDF_USB_READERS_FAILED EvtUsbTargetPipeReadersFailed;
+} WDF_USB_CONTINUOUS_READER_CONFIG, *PWDF_USB_CONTINUOUS_READER_CONFIG;
+
+static __inline VOID
+WDF_USB_CONTINUOUS_READER_CONFIG_INIT(
+	_Out_ PWDF_USB_CONTINUOUS_READER_CONFIG Config,
+	_In_ PFN_WDF_USB_READER_COMPLETION_ROUTINE EvtUsbTargetPipeReadComplete,
+	_In_ WDFCONTEXT EvtUsbTargetPipeReadCompleteContext,
+	_In_ size_t TransferLength
+)
+{
+	RtlZeroMemory(Config, sizeof(WDF_USB_CONTINUOUS_READER_CONFIG));
+	Config->Size = sizeof(WDF_USB_CONTINUOUS_READER_CONFIG);
+	Config->EvtUsbTargetPipeReadComplete = EvtUsbTargetPipeReadComplete;
+	Config->EvtUsbTargetPipeReadCompleteContext = EvtUsbTargetPipeReadCompleteContext;
+	Config->TransferLength = TransferLength;
+}
+
+NTSTATUS
+WdfUsbTargetPipeConfigContinuousReader(
+	_In_ WDFUSBPIPE Pipe,
+	_In_ PWDF_USB_CONTINUOUS_READER_CONFIG Config
+);
@@ -0,0 +1,79 @@
+// windows.h: Host stand-in for the Win32 calls the UMDF driver sources make
+//
+// Kernel types come from ntddk.h. Events belong to the simulation: waiting
+// for one that is not set runs simulation events until it is, so the
+// completion a blocked driver thread waits for still happens. The counters
+// read the virtual clock, see AmtPtpWdfSim.h.
+#pragma once
+
+#include <ntddk.h>
+
+typedef int					BOOL;
+typedef ULONG				DWORD;
+typedef LONG				HRESULT;
+typedef PVOID				HANDLE;
+typedef const WCHAR*		LPCWSTR;
+typedef struct _SECURITY_ATTRIBUTES SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+
+#define INFINITE		0xFFFFFFFF
+#define WAIT_OBJECT_0	0x00000000
+#define WAIT_TIMEOUT	0x00000102
+#define WAIT_FAILED		0xFFFFFFFF
+
+#define S_OK			((HRESULT) 0)
+#define HRESULT_FROM_WIN32(Error) \
+	((HRESULT) (Error) <= 0 ? (HRESULT) (Error) : (HRESULT) (((Error) & 0x0000FFFF) | 0x80070000))
+
+#define CreateEvent		CreateEventW
+
+// Events are auto-reset or manual-reset as asked, never named
+HANDLE
+CreateEventW(
+	_In_opt_ LPSECURITY_ATTRIBUTES EventAttributes,
+	_In_ BOOL ManualReset,
+	_In_ BOOL InitialState,
+	_In_opt_ LPCWSTR Name
+);
+
+BOOL
+SetEvent(
+	_In_ HANDLE Event
+);
+
+BOOL
+ResetEvent(
+	_In_ HANDLE Event
+);
+
+//
+// Runs simulation events until Event is set. Running out of events first
+// stops the simulation: nothing is left that could set it.
+//
+DWORD
+WaitForSingleObject(
+	_In_ HANDLE Handle,
+	_In_ DWORD Milliseconds
+);
+
+BOOL
+CloseHandle(
+	_In_ HANDLE Object
+);
+
+DWORD
+GetLastError(VOID);
+
+BOOL
+QueryPerformanceCounter(
+	_Out_ LARGE_INTEGER* PerformanceCount
+);
+
+BOOL
+QueryPerformanceFrequency(
+	_Out_ LARGE_INTEGER* Frequency
+);
+
+BOOL
+QueryUnbiasedInterruptTime(
+	_Out_ PULONGLONG UnbiasedTime
+);
@@ -0,0 +1,714 @@
+// AmtPtpFilterInputTest.c: The filter's input path on the WDF stand-in
+//
+// Device.c, Queue.c, Input.c and Diagnostics.c run as built for the driver.
+// Hidclass keeps a few PTP reads pending, the transport replays a capture a
+// few times over, and each scenario checks what the input path must keep
+// whatever the timing: every transfer is read, every report reaches hidclass,
+// the read pool stays full and nothing it allocated is left behind. The
+// report descriptor hidclass reads those reports with is checked against
+// PTP_REPORT.
+
+#include <stdlib.h>
+#include <Driver.h>
+#include <AmtPtpWdfSim.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpCapture.h>
+#include <AmtPtpHidFields.h>
+
+#define TEST_START			(10 * 10000)	/* first transfer, after the mode switch */
+#define TEST_ROUNDS			8				/* replays of the capture per run */
+#define TEST_ROUND_GAP		(100 * 10000)	/* between replays, past the split frame timeout */
+#define TEST_DRAIN			(1000 * 10000)	/* after the last transfer */
+#define TEST_HYBRID_FRAMES	4				/* frames per finger count, a lift after them */
+#define TEST_MAX_FIELDS		64
+
+typedef struct _AMTPTP_TEST_RUN {
+	// Script
+	const char*			Name;
+	const AMTPTP_CAPTURE* Capture;
+	ULONG				HidReads;		/* PTP reads hidclass keeps pending */
+	ULONGLONG			Turnaround;		/* hidclass time between a report and the next read */
+	ULONGLONG			Latency;
+	ULONGLONG			Jitter;
+	ULONG				FailSendAt;		/* transfer before which one send fails, 0 for none */
+	ULONG				FailReadAt;		/* transfer before which one read fails, 0 for none */
+	ULONG				ShortReadAt;	/* report after which one PTP read is too short, 0 for none */
+
+	// State
+	WDFDEVICE			Device;
+	ULONG				Pushed;
+	ULONG				Outstanding;	/* PTP reads the driver holds */
+	BOOLEAN				Stopped;
+	BOOLEAN				ShortReadSent;
+	ULONG				ModeSwitches;
+
+	// Results
+	ULONG				Cancelled;
+	ULONG				Errors;
+	ULONG				ReportCount;
+	ULONG				ReportCapacity;
+	PTP_REPORT*			Reports;
+} AMTPTP_TEST_RUN, *PAMTPTP_TEST_RUN;
+
+//
+// The transport
+//
+
+static ULONGLONG
+AmtPtpTestFrameTime(
+	_In_ const AMTPTP_CAPTURE* Capture,
+	_In_ ULONG Index
+)
+{
+	const AMTPTP_CAPTURE_FRAME* first = &Capture->Frames[0];
+	ULONGLONG span = Capture->Frames[Capture->FrameCount - 1].HostTime - first->HostTime;
+	ULONG round = Index / Capture->FrameCount;
+
+	return TEST_START + round * (span + TEST_ROUND_GAP) +
+		(Capture->Frames[Index % Capture->FrameCount].HostTime - first->HostTime);
+}
+
+static VOID
+AmtPtpTestPush(
+	_In_opt_ PVOID Context
+)
+{
+	PAMTPTP_TEST_RUN run = Context;
+	const AMTPTP_CAPTURE_FRAME* frame = &run->Capture->Frames[run->Pushed % run->Capture->FrameCount];
+
+	if (run->FailSendAt != 0 && run->Pushed == run->FailSendAt) {
+		AmtPtpSimTargetConfig(run->Device)->FailSends = 1;
+	}
+	if (run->FailReadAt != 0 && run->Pushed == run->FailReadAt) {
+		AmtPtpSimTargetPush(run->Device, STATUS_DEVICE_DATA_ERROR, NULL, 0);
+	}
+
+	AmtPtpSimTargetPush(run->Device, STATUS_SUCCESS, frame->Data, frame->Length);
+	run->Pushed++;
+
+	if (run->Pushed < run->Capture->FrameCount * TEST_ROUNDS) {
+		AmtPtpSimSchedule(AmtPtpTestFrameTime(run->Capture, run->Pushed), AmtPtpTestPush, run);
+	}
+}
+
+static NTSTATUS
+AmtPtpTestTargetIoctl(
+	_In_opt_ PVOID Context,
+	_In_ ULONG IoControlCode,
+	_In_reads_bytes_(InputLength) const VOID* Input,
+	_In_ size_t InputLength,
+	_Out_writes_bytes_(OutputLength) PVOID Output,
+	_In_ size_t OutputLength,
+	_Out_ ULONG_PTR* Information
+)
+{
+	PAMTPTP_TEST_RUN run = Context;
+	PHID_DEVICE_ATTRIBUTES attributes;
+	const HID_XFER_PACKET* packet;
+
+	*Information = 0;
+	switch (IoControlCode) {
+	case IOCTL_HID_GET_DEVICE_ATTRIBUTES:
+		if (OutputLength < sizeof(HID_DEVICE_ATTRIBUTES)) {
+			return STATUS_BUFFER_TOO_SMALL;
+		}
+		attributes = Output;
+		RtlZeroMemory(attributes, sizeof(HID_DEVICE_ATTRIBUTES));
+		attributes->Size = sizeof(HID_DEVICE_ATTRIBUTES);
+		attributes->VendorID = run->Capture->VendorId;
+		attributes->ProductID = run->Capture->ProductId;
+		*Information = sizeof(HID_DEVICE_ATTRIBUTES);
+		return STATUS_SUCCESS;
+	case IOCTL_HID_SET_FEATURE:
+		// The mode request carries its packet in the IRP, see PtpFilterConfigureMultiTouch
+		AMTPTP_CHECK(Input != NULL && InputLength >= sizeof(HID_XFER_PACKET));
+		if (Input != NULL && InputLength >= sizeof(HID_XFER_PACKET)) {
+			packet = Input;
+			AMTPTP_CHECK_EQ(packet->reportId, (run->Capture->Bus == AmtPtpBusBluetooth) ? 0xF1 : 0x02);
+		}
+		run->ModeSwitches++;
+		return STATUS_SUCCESS;
+	default:
+		return STATUS_NOT_SUPPORTED;
+	}
+}
+
+//
+// Hidclass
+//
+
+static AMTPTP_SIM_REQUEST_DONE AmtPtpTestHidDone;
+
+static VOID
+AmtPtpTestHidRead(
+	_In_opt_ PVOID Context
+)
+{
+	PAMTPTP_TEST_RUN run = Context;
+	size_t length = sizeof(PTP_REPORT);
+
+	if (run->Stopped) {
+		return;
+	}
+	if (run->ShortReadAt != 0 && run->ReportCount >= run->ShortReadAt && !run->ShortReadSent) {
+		run->ShortReadSent = TRUE;
+		length--;
+	}
+	run->Outstanding++;
+	AmtPtpSimSendIoctl(run->Device, IOCTL_HID_READ_REPORT, NULL, 0, length, AmtPtpTestHidDone, run);
+}
+
+static VOID
+AmtPtpTestHidDone(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status,
+	_In_ ULONG_PTR Information,
+	_In_reads_bytes_(Information) const UCHAR* Buffer
+)
+{
+	PAMTPTP_TEST_RUN run = Context;
+
+	run->Outstanding--;
+	if (Status == STATUS_CANCELLED) {
+		run->Cancelled++;
+		return;
+	}
+	if (!NT_SUCCESS(Status) || Information != sizeof(PTP_REPORT)) {
+		run->Errors++;
+	}
+	else {
+		if (run->ReportCount == run->ReportCapacity) {
+			run->ReportCapacity = run->ReportCapacity ? run->ReportCapacity * 2 : 256;
+			run->Reports = realloc(run->Reports, run->ReportCapacity * sizeof(PTP_REPORT));
+			if (run->Reports == NULL) {
+				abort();
+			}
+		}
+		RtlCopyMemory(&run->Reports[run->ReportCount], Buffer, sizeof(PTP_REPORT));
+		run->ReportCount++;
+	}
+	AmtPtpSimSchedule(AmtPtpSimNow() + run->Turnaround, AmtPtpTestHidRead, run);
+}
+
+//
+// One run of the capture through the filter. Returns FALSE if the device
+// did not come up, the checks are done then.
+//
+static BOOLEAN
+AmtPtpTestExecute(
+	_Inout_ PAMTPTP_TEST_RUN Run
+)
+{
+	AMTPTP_SIM_TARGET_CONFIG* target;
+	PDEVICE_CONTEXT deviceContext;
+	ULONG transfers = Run->Capture->FrameCount * TEST_ROUNDS;
+	ULONG live, created, i;
+	NTSTATUS status;
+
+	AmtPtpSimReset();
+	status = DriverEntry(NULL, NULL);
+	AMTPTP_CHECK(NT_SUCCESS(status));
+	status = AmtPtpSimAddDevice(&Run->Device);
+	AMTPTP_CHECK(NT_SUCCESS(status));
+	if (!NT_SUCCESS(status)) {
+		return FALSE;
+	}
+
+	target = AmtPtpSimTargetConfig(Run->Device);
+	target->Latency = Run->Latency;
+	target->Jitter = Run->Jitter;
+	target->Ioctl = AmtPtpTestTargetIoctl;
+	target->Context = Run;
+
+	status = AmtPtpSimPowerUp(Run->Device);
+	AMTPTP_CHECK(NT_SUCCESS(status));
+	if (!NT_SUCCESS(status)) {
+		return FALSE;
+	}
+
+	deviceContext = PtpFilterGetContext(Run->Device);
+	AMTPTP_CHECK(deviceContext->DeviceConfigured);
+	AMTPTP_CHECK_EQ(Run->ModeSwitches, 1);
+	AMTPTP_CHECK_EQ(AmtPtpSimTargetPending(Run->Device), PTP_READ_POOL_DEFAULT_SIZE);
+
+	// From here on, the steady state allocates nothing
+	created = AmtPtpSimStats.Created;
+	live = AmtPtpSimStats.Created - AmtPtpSimStats.Deleted;
+
+	for (i = 0; i < Run->HidReads; i++) {
+		AmtPtpTestHidRead(Run);
+	}
+	AmtPtpSimSchedule(AmtPtpTestFrameTime(Run->Capture, 0), AmtPtpTestPush, Run);
+	AmtPtpSimRun(AmtPtpTestFrameTime(Run->Capture, transfers - 1) + TEST_DRAIN);
+
+	// Every transfer was read and every report reached hidclass
+	AMTPTP_CHECK_EQ(Run->Pushed, transfers);
+	AMTPTP_CHECK_EQ(AmtPtpSimStats.Reads, transfers);
+	AMTPTP_CHECK_EQ(AmtPtpSimStats.ReadsDropped, 0);
+	AMTPTP_CHECK_EQ(deviceContext->PerfCounters.ReportsOut, Run->ReportCount);
+	AMTPTP_CHECK_EQ(Run->Errors, Run->ShortReadSent ? 1 : 0);
+	AMTPTP_CHECK(Run->ReportCount > 0);
+
+	// The pump is full, nothing is parked and the device never gave up
+	AMTPTP_CHECK(deviceContext->DeviceConfigured);
+	AMTPTP_CHECK_EQ(AmtPtpSimTargetPending(Run->Device), deviceContext->ReadPoolSize);
+	AMTPTP_CHECK_EQ(AmtPtpReportRingCount(&deviceContext->ReportRing), 0);
+	AMTPTP_CHECK_EQ(Run->Outstanding, Run->HidReads);
+	AMTPTP_CHECK_EQ(AmtPtpSimStats.DeviceFailed, Run->ShortReadSent ? 1 : 0);
+
+	// Only mode switches, a request and its packet each, allocate again
+	AMTPTP_CHECK_EQ(AmtPtpSimStats.Created - AmtPtpSimStats.Deleted, live);
+	AMTPTP_CHECK_EQ(AmtPtpSimStats.Created - created, 2 * (Run->ModeSwitches - 1));
+
+	printf("%s %s: %u transfers, %u reports, %u parked max, %u coalesced, %u dropped, %u reordered, %u mode switches\n",
+		Run->Capture->Path, Run->Name, Run->Pushed, Run->ReportCount, deviceContext->ReportRing.HighWatermark,
+		deviceContext->ReportRing.Coalesced, deviceContext->ReportRing.Dropped, AmtPtpSimStats.ReadsReordered,
+		Run->ModeSwitches);
+
+	// Leaving D0 hands every pending PTP read back
+	Run->Stopped = TRUE;
+	AmtPtpSimPowerDown(Run->Device);
+	AmtPtpSimRunAll();
+	AMTPTP_CHECK_EQ(Run->Cancelled, Run->HidReads);
+	AMTPTP_CHECK_EQ(Run->Outstanding, 0);
+
+	return TRUE;
+}
+
+static VOID
+AmtPtpTestRunFree(
+	_Inout_ PAMTPTP_TEST_RUN Run
+)
+{
+	free(Run->Reports);
+	RtlZeroMemory(Run, sizeof(AMTPTP_TEST_RUN));
+}
+
+static VOID
+AmtPtpTestRunInit(
+	_Out_ PAMTPTP_TEST_RUN Run,
+	_In_ const char* Name,
+	_In_ const AMTPTP_CAPTURE* Capture
+)
+{
+	RtlZeroMemory(Run, sizeof(AMTPTP_TEST_RUN));
+	Run->Name = Name;
+	Run->Capture = Capture;
+	Run->HidReads = 2;
+	Run->Latency = 100;		/* 10 us */
+}
+
+//
+// Reports equal but for ScanTime: where a replay starts over, the device
+// clock jumps back and the scan clock resyncs from the host arrival time.
+//
+static BOOLEAN
+AmtPtpTestSameReports(
+	_In_ const AMTPTP_TEST_RUN* A,
+	_In_ const AMTPTP_TEST_RUN* B
+)
+{
+	PTP_REPORT a, b;
+	ULONG i;
+
+	if (A->ReportCount != B->ReportCount) {
+		return FALSE;
+	}
+	for (i = 0; i < A->ReportCount; i++) {
+		a = A->Reports[i];
+		b = B->Reports[i];
+		a.ScanTime = b.ScanTime = 0;
+		if (memcmp(&a, &b, sizeof(PTP_REPORT)) != 0) {
+			fprintf(stderr, "%s: report %u differs\n", B->Name, i);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+//
+// Every scan with more contacts than a report goes out as consecutive
+// reports with one ScanTime; only the first carries the contact count. A
+// report of 0 contacts is a scan of its own, nothing touches. Seen counts
+// the scans per contact count that had all of them touching.
+//
+static VOID
+AmtPtpTestHybridScans(
+	_In_ const AMTPTP_TEST_RUN* Run,
+	_Inout_updates_(PTP_MAX_HYBRID_CONTACT_POINTS + 1) ULONG* Seen
+)
+{
+	const PTP_REPORT* first;
+	ULONG i, step, steps, contact, ids, tips;
+
+	for (i = 0; i < Run->ReportCount; i += steps) {
+		first = &Run->Reports[i];
+		steps = (first->ContactCount + PTP_MAX_CONTACT_POINTS - 1) / PTP_MAX_CONTACT_POINTS;
+		if (steps == 0) {
+			steps = 1;
+			continue;
+		}
+		if (first->ContactCount > PTP_MAX_HYBRID_CONTACT_POINTS || i + steps > Run->ReportCount) {
+			AmtPtpTestFailures++;
+			fprintf(stderr, "%s %s: report %u starts a scan of %u contacts\n", Run->Capture->Path, Run->Name, i,
+				first->ContactCount);
+			steps = 1;
+			continue;
+		}
+
+		ids = 0;
+		tips = 0;
+		for (step = 0; step < steps; step++) {
+			const PTP_REPORT* report = &Run->Reports[i + step];
+
+			if (step > 0 && (report->ContactCount != 0 || report->ScanTime != first->ScanTime ||
+				report->IsButtonClicked != first->IsButtonClicked)) {
+				AmtPtpTestFailures++;
+				fprintf(stderr, "%s %s: report %u is not step %u of the scan at report %u\n", Run->Capture->Path,
+					Run->Name, i + step, step, i);
+			}
+			for (contact = 0; contact < PTP_MAX_CONTACT_POINTS &&
+				step * PTP_MAX_CONTACT_POINTS + contact < first->ContactCount; contact++) {
+				AMTPTP_CHECK((ids & (1u << report->Contacts[contact].ContactID)) == 0);
+				ids |= 1u << report->Contacts[contact].ContactID;
+				tips += report->Contacts[contact].TipSwitch;
+			}
+		}
+		if (tips == first->ContactCount) {
+			Seen[first->ContactCount]++;
+		}
+	}
+}
+
+// Report 0x31 of a Magic Trackpad 2 with Count fingers on a grid, see make-corpus.py
+static VOID
+AmtPtpTestEncodeMt2(
+	_Out_ PAMTPTP_CAPTURE_FRAME Frame,
+	_In_ ULONGLONG HostTime,
+	_In_ ULONG DeviceTime,
+	_In_ UCHAR Count
+)
+{
+	UCHAR* data = Frame->Data;
+	ULONG coords;
+	LONG x, y;
+	UCHAR i;
+
+	RtlZeroMemory(Frame, sizeof(AMTPTP_CAPTURE_FRAME));
+	Frame->HostTime = HostTime;
+	data[0] = 0x31;
+	data[1] = (UCHAR) ((DeviceTime & 0x1F) << 3);
+	data[2] = (UCHAR) (DeviceTime >> 5);
+	data[3] = (UCHAR) (DeviceTime >> 13);
+	data += AMTPTP_MT2_HEADER_SIZE;
+
+	for (i = 0; i < Count; i++, data += AMTPTP_MT2_FINGER_SIZE) {
+		x = -3000 + (i % 4) * 1500;
+		y = -2000 + (i / 4) * 1000;
+		coords = (x & 0x1FFF) | ((-y & 0x1FFF) << 13) | (2u << 26) | (4u << 29);
+		data[0] = (UCHAR) coords;
+		data[1] = (UCHAR) (coords >> 8);
+		data[2] = (UCHAR) (coords >> 16);
+		data[3] = (UCHAR) (coords >> 24);
+		data[4] = 40;
+		data[5] = 32;
+		data[7] = 60;
+		data[8] = 0x40 | i;
+	}
+	Frame->Length = AMTPTP_MT2_HEADER_SIZE + Count * AMTPTP_MT2_FINGER_SIZE;
+}
+
+//
+// 6 to 16 fingers held for a few frames each, then lifted: each scan is
+// reported whole, in order, while hidclass keeps one or two reads pending
+//
+static VOID
+AmtPtpTestHybrid(VOID)
+{
+	static const ULONG hidReads[] = { 1, 2 };
+	AMTPTP_CAPTURE capture;
+	AMTPTP_TEST_RUN run;
+	ULONG seen[PTP_MAX_HYBRID_CONTACT_POINTS + 1];
+	ULONG frame = 0, r;
+	UCHAR count, i;
+
+	RtlZeroMemory(&capture, sizeof(capture));
+	capture.Path = "hybrid";
+	capture.Bus = AmtPtpBusBluetooth;
+	capture.VendorId = 0x004c;
+	capture.ProductId = 0x0265;
+	capture.Model = AmtPtpDeviceRegistryLookup(capture.Bus, capture.VendorId, capture.ProductId);
+	capture.Frames = calloc((PTP_MAX_HYBRID_CONTACT_POINTS - PTP_MAX_CONTACT_POINTS) * (TEST_HYBRID_FRAMES + 1),
+		sizeof(AMTPTP_CAPTURE_FRAME));
+	AMTPTP_CHECK(capture.Model != NULL);
+	if (capture.Model == NULL || capture.Frames == NULL) {
+		free(capture.Frames);
+		return;
+	}
+
+	for (count = PTP_MAX_CONTACT_POINTS + 1; count <= PTP_MAX_HYBRID_CONTACT_POINTS; count++) {
+		for (i = 0; i <= TEST_HYBRID_FRAMES; i++, frame++) {
+			AmtPtpTestEncodeMt2(&capture.Frames[frame], frame * 11 * 10000, frame * 11,
+				(i < TEST_HYBRID_FRAMES) ? count : 0);
+		}
+	}
+	capture.FrameCount = frame;
+
+	for (r = 0; r < RTL_NUMBER_OF(hidReads); r++) {
+		AmtPtpTestRunInit(&run, hidReads[r] == 1 ? "one-read" : "two-reads", &capture);
+		run.HidReads = hidReads[r];
+		if (AmtPtpTestExecute(&run)) {
+			RtlZeroMemory(seen, sizeof(seen));
+			AmtPtpTestHybridScans(&run, seen);
+			for (count = PTP_MAX_CONTACT_POINTS + 1; count <= PTP_MAX_HYBRID_CONTACT_POINTS; count++) {
+				AMTPTP_CHECK_EQ(seen[count], TEST_HYBRID_FRAMES * TEST_ROUNDS);
+			}
+		}
+		AmtPtpTestRunFree(&run);
+	}
+
+	AmtPtpSimReset();
+	free(capture.Frames);
+}
+
+static VOID
+AmtPtpTestCapture(
+	_In_ const char* Path
+)
+{
+	AMTPTP_CAPTURE capture;
+	AMTPTP_TEST_RUN steady, run;
+	ULONG seen[PTP_MAX_HYBRID_CONTACT_POINTS + 1] = { 0 };
+
+	if (!AmtPtpCaptureLoad(Path, &capture)) {
+		AMTPTP_CHECK(!"capture loads");
+		return;
+	}
+
+	// Reads complete in order, hidclass is always back in time
+	AmtPtpTestRunInit(&steady, "steady", &capture);
+	if (AmtPtpTestExecute(&steady)) {
+		AmtPtpTestHybridScans(&steady, seen);
+		AMTPTP_CHECK(seen[PTP_MAX_CONTACT_POINTS + 1] > 0);
+	}
+
+	// Reads complete out of order, the filter retires them in order all the same.
+	// Where status frames re-arm the mode, the recovery timer folds them by
+	// time and lifts contacts when it fires, so only the scans are compared.
+	AmtPtpTestRunInit(&run, "jitter", &capture);
+	run.Jitter = 20 * 10000;	/* past the frame interval, about 11 ms */
+	if (AmtPtpTestExecute(&run)) {
+		AMTPTP_CHECK(AmtPtpSimStats.ReadsReordered > 0);
+		AMTPTP_CHECK(steady.ModeSwitches > 1 || AmtPtpTestSameReports(&steady, &run));
+		AmtPtpTestHybridScans(&run, seen);
+	}
+	AmtPtpTestRunFree(&run);
+
+	// Hidclass reads slower than the device sends, the ring takes the excess
+	AmtPtpTestRunInit(&run, "slow-hidclass", &capture);
+	run.HidReads = 1;
+	run.Turnaround = 30 * 10000;
+	if (AmtPtpTestExecute(&run)) {
+		PDEVICE_CONTEXT deviceContext = PtpFilterGetContext(run.Device);
+
+		AMTPTP_CHECK(run.ReportCount < run.Pushed);
+		AMTPTP_CHECK(deviceContext->ReportRing.Coalesced + deviceContext->ReportRing.Dropped > 0);
+	}
+	AmtPtpTestRunFree(&run);
+
+	// A send fails mid-stream, the recovery timer switches the mode again
+	AmtPtpTestRunInit(&run, "failed-send", &capture);
+	run.FailSendAt = capture.FrameCount * TEST_ROUNDS / 2;
+	if (AmtPtpTestExecute(&run)) {
+		AMTPTP_CHECK_EQ(AmtPtpSimStats.SendsFailed, 1);
+		AMTPTP_CHECK(AmtPtpSimStats.TimerFires >= 1);
+		AMTPTP_CHECK(run.ModeSwitches >= 2);
+	}
+	AmtPtpTestRunFree(&run);
+
+	// A read fails mid-stream, the work item refills the pool
+	AmtPtpTestRunInit(&run, "failed-read", &capture);
+	run.FailReadAt = capture.FrameCount * TEST_ROUNDS / 3;
+	if (AmtPtpTestExecute(&run)) {
+		AMTPTP_CHECK(AmtPtpSimStats.WorkItemRuns >= 1);
+	}
+	AmtPtpTestRunFree(&run);
+
+	// Hidclass sends a read too short for a report, the frame it would have
+	// carried goes to the next read instead
+	AmtPtpTestRunInit(&run, "short-read", &capture);
+	run.ShortReadAt = steady.ReportCount / 2;
+	if (AmtPtpTestExecute(&run)) {
+		AMTPTP_CHECK(run.ShortReadSent);
+		AMTPTP_CHECK_EQ(AmtPtpSimStats.LastFailedAction, WdfDeviceFailedNoRestart);
+		AMTPTP_CHECK(AmtPtpTestSameReports(&steady, &run));
+	}
+	AmtPtpTestRunFree(&run);
+
+	AmtPtpTestRunFree(&steady);
+	AmtPtpSimReset();
+	AmtPtpCaptureFree(&capture);
+}
+
+// Reports as the driver fills them
+static const AMTPTP_HID_REPORT_SIZE AmtPtpTestReports[] = {
+	{ AmtPtpHidReportInput,		REPORTID_MULTITOUCH,	sizeof(PTP_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_DEVICE_CAPS,	sizeof(PTP_DEVICE_CAPS_FEATURE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PTPHQA,		sizeof(PTP_DEVICE_HQA_CERTIFICATION_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_REPORTMODE,	sizeof(PTP_DEVICE_INPUT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_FUNCSWITCH,	sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_BATTERY,		sizeof(PTP_DEVICE_BATTERY_FEATURE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PERF_COUNTERS,	sizeof(PTP_PERF_COUNTERS_REPORT) },
+};
+
+//
+// Every report the descriptor declares, of any type and id, must be one the
+// driver fills and as long as its structure
+//
+static VOID
+AmtPtpTestReportSizes(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_reads_(Count) const AMTPTP_HID_REPORT_SIZE* Expected,
+	_In_ ULONG Count
+)
+{
+	AMTPTP_HID_REPORT_TYPE type;
+	ULONG reportId, size, i, declared = 0;
+
+	for (type = AmtPtpHidReportInput; type <= AmtPtpHidReportFeature; type++) {
+		for (reportId = 1; reportId <= 0xff; reportId++) {
+			AMTPTP_CHECK_EQ(AmtPtpHidGetReportSize(Descriptor, Length, type, (UCHAR) reportId, &size),
+				AmtPtpHidLayoutOk);
+			if (size == 0) {
+				continue;
+			}
+
+			declared++;
+			for (i = 0; i < Count && (Expected[i].Type != type || Expected[i].ReportId != reportId); i++) {
+			}
+			if (i == Count) {
+				fprintf(stderr, "report %u of type %d is not filled by the driver\n", reportId, type);
+				AmtPtpTestFailures++;
+				continue;
+			}
+			AMTPTP_CHECK_EQ(size, Expected[i].Size);
+		}
+	}
+	AMTPTP_CHECK_EQ(declared, Count);
+}
+
+//
+// Where the bits set in Report sit, as a field: the lowest one and the span
+// up to the highest. Clears Report for the next field.
+//
+static VOID
+AmtPtpTestProbe(
+	_Inout_ PTP_REPORT* Report,
+	_In_ USHORT UsagePage,
+	_In_ USHORT Usage,
+	_Inout_ AMTPTP_HID_FIELD* Fields,
+	_Inout_ PULONG Count
+)
+{
+	const UCHAR* bytes = (const UCHAR*) Report;
+	AMTPTP_HID_FIELD* field = &Fields[(*Count)++];
+	ULONG bit, first = 0, last = 0;
+	BOOLEAN found = FALSE;
+
+	for (bit = 0; bit < sizeof(PTP_REPORT) * 8; bit++) {
+		if (bytes[bit / 8] & (1 << (bit % 8))) {
+			first = found ? first : bit;
+			last = bit;
+			found = TRUE;
+		}
+	}
+
+	RtlZeroMemory(field, sizeof(AMTPTP_HID_FIELD));
+	field->UsagePage = UsagePage;
+	field->Usage = Usage;
+	field->BitOffset = first;
+	field->BitSize = last - first + 1;
+	field->Constant = (Usage == 0);
+	RtlZeroMemory(Report, sizeof(PTP_REPORT));
+}
+
+//
+// The descriptor must lay the input report out bit for bit as Input.c fills
+// PTP_REPORT, with the Magic Trackpad 2 axis ranges: hidclass parses whatever
+// it is given, and a field out of place misreads every report without an
+// error. Hid.c needs the IRP stack, so the descriptor is taken as built.
+//
+static VOID
+AmtPtpTestDescriptor(VOID)
+{
+	const AMTPTP_DEVICE_MODEL* model = AmtPtpDeviceRegistryGetModel(AmtPtpModelMagicTrackpad2Bluetooth);
+	AMTPTP_HID_FIELD fields[TEST_MAX_FIELDS], expected[TEST_MAX_FIELDS];
+	PTP_REPORT report = { 0 };
+	ULONG count = 0, expectedCount = 0, i, k;
+
+	for (k = 0; k < PTP_MAX_CONTACT_POINTS; k++) {
+		report.Contacts[k].Confidence = 1;
+		AmtPtpTestProbe(&report, 0x0d, 0x47, expected, &expectedCount);
+		report.Contacts[k].TipSwitch = 1;
+		AmtPtpTestProbe(&report, 0x0d, 0x42, expected, &expectedCount);
+		report.Contacts[k].ContactID = 0x3f;
+		AmtPtpTestProbe(&report, 0x0d, 0x51, expected, &expectedCount);
+		report.Contacts[k].X = 0xffff;
+		AmtPtpTestProbe(&report, 0x01, 0x30, expected, &expectedCount);
+		report.Contacts[k].Y = 0xffff;
+		AmtPtpTestProbe(&report, 0x01, 0x31, expected, &expectedCount);
+	}
+	report.ScanTime = 0xffff;
+	AmtPtpTestProbe(&report, 0x0d, 0x56, expected, &expectedCount);
+	report.ContactCount = 0xff;
+	AmtPtpTestProbe(&report, 0x0d, 0x54, expected, &expectedCount);
+	report.IsButtonClicked = 0x01;
+	AmtPtpTestProbe(&report, 0x09, 0x01, expected, &expectedCount);
+	report.IsButtonClicked = 0xfe;
+	AmtPtpTestProbe(&report, 0x09, 0, expected, &expectedCount);
+
+	AmtPtpTestReportSizes(PtpReportDescriptorMagicTrackpad2, sizeof(PtpReportDescriptorMagicTrackpad2),
+		AmtPtpTestReports, RTL_NUMBER_OF(AmtPtpTestReports));
+	AMTPTP_CHECK(AmtPtpHidGetFields(PtpReportDescriptorMagicTrackpad2, sizeof(PtpReportDescriptorMagicTrackpad2),
+		AmtPtpHidReportInput, REPORTID_MULTITOUCH, fields, TEST_MAX_FIELDS, &count));
+	AMTPTP_CHECK_EQ(count, expectedCount);
+	for (i = 0; i < count && i < expectedCount; i++) {
+		AMTPTP_CHECK_EQ(fields[i].BitOffset, expected[i].BitOffset);
+		AMTPTP_CHECK_EQ(fields[i].BitSize, expected[i].BitSize);
+		AMTPTP_CHECK_EQ(fields[i].Constant, expected[i].Constant);
+		if (!expected[i].Constant) {
+			AMTPTP_CHECK_EQ(fields[i].UsagePage, expected[i].UsagePage);
+			AMTPTP_CHECK_EQ(fields[i].Usage, expected[i].Usage);
+		}
+
+		// Positions are reported relative to the minimum
+		if (fields[i].UsagePage == 0x01 && fields[i].Usage == 0x30) {
+			AMTPTP_CHECK_EQ(fields[i].LogicalMaximum, model->X.Max - model->X.Min);
+		}
+		if (fields[i].UsagePage == 0x01 && fields[i].Usage == 0x31) {
+			AMTPTP_CHECK_EQ(fields[i].LogicalMaximum, model->Y.Max - model->Y.Min);
+		}
+	}
+	if (count > 0) {
+		AMTPTP_CHECK_EQ(fields[count - 1].BitOffset + fields[count - 1].BitSize, sizeof(PTP_REPORT) * 8);
+	}
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	int i;
+
+	AMTPTP_CHECK(argc > 1);
+	for (i = 1; i < argc; i++) {
+		AmtPtpTestCapture(argv[i]);
+	}
+	AmtPtpTestHybrid();
+	AmtPtpTestDescriptor();
+
+	return AmtPtpTestExit("AmtPtpFilterInputTest");
+}
@@ -0,0 +1,259 @@
+// AmtPtpFilterReadPumpBench.c: Transfer to report latency of the filter's read pump by depth
+//
+// The filter runs on the WDF stand-in above a Bluetooth MT2 that sends a
+// touch frame every 11 ms. Hidclass always has reads pending, so a report
+// leaves as soon as its transfer is parsed: what is measured is how long a
+// transfer waits for a transport read, then for the reads sent before it.
+// A transport slower than the frame interval backs up behind a single read,
+// a deeper pool keeps several round trips going at once. A pump that falls
+// behind shows it in the last column, the transfers still queued at the end.
+//
+// Only frames of the capture that decode to 1 - 5 contacts are sent, one
+// report each, so the n-th report belongs to the n-th transfer. Latencies
+// are in virtual time and do not depend on the machine; the ns/op column is
+// the host cost of a transfer through the stand-in and the filter.
+
+#include <AmtPtpBench.h>
+#include <string.h>
+#include <Driver.h>
+#include <AmtPtpWdfSim.h>
+#include <AmtPtpCapture.h>
+
+#define BENCH_START				(10 * 10000)	/* first transfer, after the mode switch */
+#define BENCH_FRAME_INTERVAL	(11 * 10000)
+#define BENCH_DRAIN				(1000 * 10000)
+#define BENCH_HID_READS			4
+
+typedef struct _AMTPTP_BENCH_RUN {
+	const AMTPTP_CAPTURE*	Capture;
+	const ULONG*			Frames;			/* indices of the frames sent, in order */
+	ULONG					FrameCount;
+	ULONG					Transfers;
+
+	WDFDEVICE				Device;
+	ULONG					Pushed;
+	ULONG					Reports;
+	ULONGLONG*				PushTimes;
+	ULONGLONG*				Latencies;
+} AMTPTP_BENCH_RUN, *PAMTPTP_BENCH_RUN;
+
+static NTSTATUS
+AmtPtpBenchTargetIoctl(
+	_In_opt_ PVOID Context,
+	_In_ ULONG IoControlCode,
+	_In_reads_bytes_(InputLength) const VOID* Input,
+	_In_ size_t InputLength,
+	_Out_writes_bytes_(OutputLength) PVOID Output,
+	_In_ size_t OutputLength,
+	_Out_ ULONG_PTR* Information
+)
+{
+	PAMTPTP_BENCH_RUN run = Context;
+	PHID_DEVICE_ATTRIBUTES attributes = Output;
+
+	UNREFERENCED_PARAMETER(Input);
+	UNREFERENCED_PARAMETER(InputLength);
+
+	*Information = 0;
+	switch (IoControlCode) {
+	case IOCTL_HID_GET_DEVICE_ATTRIBUTES:
+		if (OutputLength < sizeof(HID_DEVICE_ATTRIBUTES)) {
+			return STATUS_BUFFER_TOO_SMALL;
+		}
+		RtlZeroMemory(attributes, sizeof(HID_DEVICE_ATTRIBUTES));
+		attributes->Size = sizeof(HID_DEVICE_ATTRIBUTES);
+		attributes->VendorID = run->Capture->VendorId;
+		attributes->ProductID = run->Capture->ProductId;
+		*Information = sizeof(HID_DEVICE_ATTRIBUTES);
+		return STATUS_SUCCESS;
+	case IOCTL_HID_SET_FEATURE:
+		return STATUS_SUCCESS;
+	default:
+		return STATUS_NOT_SUPPORTED;
+	}
+}
+
+static VOID
+AmtPtpBenchPush(
+	_In_opt_ PVOID Context
+)
+{
+	PAMTPTP_BENCH_RUN run = Context;
+	const AMTPTP_CAPTURE_FRAME* frame = &run->Capture->Frames[run->Frames[run->Pushed % run->FrameCount]];
+
+	run->PushTimes[run->Pushed] = AmtPtpSimNow();
+	AmtPtpSimTargetPush(run->Device, STATUS_SUCCESS, frame->Data, frame->Length);
+	run->Pushed++;
+
+	if (run->Pushed < run->Transfers) {
+		AmtPtpSimSchedule(AmtPtpSimNow() + BENCH_FRAME_INTERVAL, AmtPtpBenchPush, run);
+	}
+}
+
+static AMTPTP_SIM_REQUEST_DONE AmtPtpBenchHidDone;
+
+static VOID
+AmtPtpBenchHidRead(
+	_In_ PAMTPTP_BENCH_RUN Run
+)
+{
+	AmtPtpSimSendIoctl(Run->Device, IOCTL_HID_READ_REPORT, NULL, 0, sizeof(PTP_REPORT), AmtPtpBenchHidDone, Run);
+}
+
+static VOID
+AmtPtpBenchHidDone(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status,
+	_In_ ULONG_PTR Information,
+	_In_reads_bytes_(Information) const UCHAR* Buffer
+)
+{
+	PAMTPTP_BENCH_RUN run = Context;
+
+	UNREFERENCED_PARAMETER(Buffer);
+
+	if (Status == STATUS_CANCELLED) {
+		return;
+	}
+	if (NT_SUCCESS(Status) && Information == sizeof(PTP_REPORT) && run->Reports < run->Pushed) {
+		run->Latencies[run->Reports] = AmtPtpSimNow() - run->PushTimes[run->Reports];
+		run->Reports++;
+	}
+	AmtPtpBenchHidRead(run);
+}
+
+static int
+AmtPtpBenchCompare(
+	const void* A,
+	const void* B
+)
+{
+	ULONGLONG a = *(const ULONGLONG*) A;
+	ULONGLONG b = *(const ULONGLONG*) B;
+
+	return (a > b) - (a < b);
+}
+
+static VOID
+AmtPtpBenchPump(
+	_Inout_ PAMTPTP_BENCH_RUN Run,
+	_In_ ULONG Depth,
+	_In_ ULONGLONG Latency
+)
+{
+	AMTPTP_SIM_TARGET_CONFIG* target;
+	PDEVICE_CONTEXT deviceContext;
+	ULONGLONG start, elapsed, total = 0;
+	char name[64];
+	ULONG i;
+
+	AmtPtpSimReset();
+	if (!NT_SUCCESS(DriverEntry(NULL, NULL)) || !NT_SUCCESS(AmtPtpSimAddDevice(&Run->Device))) {
+		fprintf(stderr, "filter device not added\n");
+		return;
+	}
+
+	target = AmtPtpSimTargetConfig(Run->Device);
+	target->Latency = Latency;
+	target->Ioctl = AmtPtpBenchTargetIoctl;
+	target->Context = Run;
+
+	// The pool is created PTP_READ_POOL_DEFAULT_SIZE deep, a shallower pump
+	// only ever takes the first Depth requests off the free list
+	deviceContext = PtpFilterGetContext(Run->Device);
+	deviceContext->ReadPoolSize = Depth;
+	deviceContext->ReadPoolFreeCount = Depth;
+
+	if (!NT_SUCCESS(AmtPtpSimPowerUp(Run->Device))) {
+		fprintf(stderr, "filter device did not start\n");
+		return;
+	}
+
+	Run->Pushed = 0;
+	Run->Reports = 0;
+	for (i = 0; i < BENCH_HID_READS; i++) {
+		AmtPtpBenchHidRead(Run);
+	}
+	AmtPtpSimSchedule(BENCH_START, AmtPtpBenchPush, Run);
+
+	start = AmtPtpBenchNow();
+	while (Run->Pushed < Run->Transfers && AmtPtpSimRun(AmtPtpSimNow() + BENCH_DRAIN) > 0) {
+	}
+	AmtPtpSimRun(AmtPtpSimNow() + BENCH_DRAIN);
+	elapsed = AmtPtpBenchNow() - start;
+
+	snprintf(name, sizeof(name), "depth %u, transport %u ms", Depth, (ULONG) (Latency / 10000));
+	AmtPtpBenchReport(name, elapsed, Run->Transfers);
+	if (Run->Reports == 0) {
+		fprintf(stderr, "%s: no reports\n", name);
+		return;
+	}
+
+	// A pump that cannot keep up still has transfers queued when the run ends
+	for (i = 0; i < Run->Reports; i++) {
+		total += Run->Latencies[i];
+	}
+	qsort(Run->Latencies, Run->Reports, sizeof(ULONGLONG), AmtPtpBenchCompare);
+	printf("%-40s %10.1f ms mean %8.1f ms p99 %8.1f ms max %8u behind\n", name,
+		(double) total / 10000 / Run->Reports,
+		Run->Latencies[Run->Reports * 99 / 100] / 10000.0,
+		Run->Latencies[Run->Reports - 1] / 10000.0,
+		Run->Transfers - Run->Reports);
+
+	AmtPtpSimPowerDown(Run->Device);
+	AmtPtpSimReset();
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	static const ULONG depths[] = { 1, 2, PTP_READ_POOL_DEFAULT_SIZE };
+	static const ULONGLONG latencies[] = { 1 * 10000, 8 * 10000, 15 * 10000, 30 * 10000 };
+	AMTPTP_BENCH_RUN run = { 0 };
+	AMTPTP_CAPTURE capture;
+	ULONG* frames;
+	ULONG d, l, i;
+
+	if (argc < 3 || !AmtPtpCaptureLoad(argv[2], &capture)) {
+		fprintf(stderr, "usage: %s <transfers> <mt2-bluetooth.cap>\n", argv[0]);
+		return 1;
+	}
+
+	frames = malloc(capture.FrameCount * sizeof(ULONG));
+	if (frames == NULL) {
+		return 1;
+	}
+	for (i = 0; i < capture.FrameCount; i++) {
+		const AMTPTP_CAPTURE_FRAME* frame = &capture.Frames[i];
+
+		if (frame->HasExpect && frame->ExpectResult == AmtPtpDecodeOk &&
+			frame->ExpectContacts > 0 && frame->ExpectContacts <= PTP_MAX_CONTACT_POINTS) {
+			frames[run.FrameCount++] = i;
+		}
+	}
+
+	run.Capture = &capture;
+	run.Frames = frames;
+	run.Transfers = AmtPtpBenchIterations(argc, argv, 10000);
+	run.PushTimes = malloc(run.Transfers * sizeof(ULONGLONG));
+	run.Latencies = malloc(run.Transfers * sizeof(ULONGLONG));
+	if (run.FrameCount == 0 || run.PushTimes == NULL || run.Latencies == NULL) {
+		fprintf(stderr, "%s: no single report touch frames\n", argv[2]);
+		return 1;
+	}
+
+	for (l = 0; l < RTL_NUMBER_OF(latencies); l++) {
+		for (d = 0; d < RTL_NUMBER_OF(depths); d++) {
+			AmtPtpBenchPump(&run, depths[d], latencies[l]);
+		}
+	}
+
+	free(run.PushTimes);
+	free(run.Latencies);
+	free(frames);
+	AmtPtpCaptureFree(&capture);
+	return 0;
+}
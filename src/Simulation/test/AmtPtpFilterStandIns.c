@@ -0,0 +1,86 @@
+// AmtPtpFilterStandIns.c: Stand-ins for the filter's Detour.c and Hid.c
+//
+// Detour.c patches the WDM stack and Hid.c needs the IRP stack, neither runs
+// on the WDF stand-in. The input path only needs the transport target.
+
+#include <Driver.h>
+
+NTSTATUS
+PtpFilterDetourWindowsHIDStack(
+	_In_ WDFDEVICE Device
+)
+{
+	PDEVICE_CONTEXT deviceContext = PtpFilterGetContext(Device);
+
+	deviceContext->HidIoTarget = WdfDeviceGetIoTarget(Device);
+	deviceContext->IsHidIoDetourCompleted = TRUE;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+PtpFilterGetHidDescriptor(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(Request);
+	return STATUS_NOT_SUPPORTED;
+}
+
+NTSTATUS
+PtpFilterGetDeviceAttribs(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(Request);
+	return STATUS_NOT_SUPPORTED;
+}
+
+NTSTATUS
+PtpFilterGetReportDescriptor(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(Request);
+	return STATUS_NOT_SUPPORTED;
+}
+
+NTSTATUS
+PtpFilterGetStrings(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request,
+	_Out_ BOOLEAN* Pending
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(Request);
+	*Pending = FALSE;
+	return STATUS_NOT_SUPPORTED;
+}
+
+NTSTATUS
+PtpFilterGetHidFeatures(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(Request);
+	return STATUS_NOT_SUPPORTED;
+}
+
+NTSTATUS
+PtpFilterSetHidFeatures(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(Request);
+	return STATUS_NOT_SUPPORTED;
+}
@@ -0,0 +1,67 @@
+// AmtPtpHidReportLayoutBench.c: Report descriptor checks of the USB driver per family
+//
+// Hid.c verifies its descriptor each time hidclass asks for it, against the
+// seven reports the driver fills. The verify case times that; the input case
+// sizes the multi-touch report alone, one walk of the descriptor.
+
+#include <AmtPtpBench.h>
+#include <Driver.h>
+#include <StaticHidRegistry.h>
+
+static VOID
+AmtPtpBenchDescriptor(
+	_In_ const char* Name,
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_ ULONG Iterations
+)
+{
+	ULONGLONG start;
+	char name[64];
+	ULONG i, size;
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < Iterations; i++) {
+		AmtPtpBenchSink += AmtPtpHidVerifyReportSizes(Descriptor, Length, AmtPtpReportSizes,
+			RTL_NUMBER_OF(AmtPtpReportSizes), NULL);
+	}
+	snprintf(name, sizeof(name), "%s, %u bytes, verify", Name, Length);
+	AmtPtpBenchReport(name, AmtPtpBenchNow() - start, Iterations);
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < Iterations; i++) {
+		AmtPtpHidGetReportSize(Descriptor, Length, AmtPtpHidReportInput, REPORTID_MULTITOUCH, &size);
+		AmtPtpBenchSink += size;
+	}
+	snprintf(name, sizeof(name), "%s, %u bytes, input", Name, Length);
+	AmtPtpBenchReport(name, AmtPtpBenchNow() - start, Iterations);
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	static const struct {
+		const char* Name;
+		const HID_REPORT_DESCRIPTOR* Descriptor;
+		const HID_DESCRIPTOR* HidDescriptor;
+	} families[] = {
+		{ "Wellspring 3", AmtPtp3ReportDescriptor, &AmtPtp3DefaultHidDescriptor },
+		{ "Wellspring 5", AmtPtp5ReportDescriptor, &AmtPtp5DefaultHidDescriptor },
+		{ "Wellspring 6", AmtPtp6ReportDescriptor, &AmtPtp6DefaultHidDescriptor },
+		{ "Wellspring 7A", AmtPtp7aReportDescriptor, &AmtPtp7aDefaultHidDescriptor },
+		{ "Wellspring 8", AmtPtp8ReportDescriptor, &AmtPtp8DefaultHidDescriptor },
+		{ "Wellspring 9", AmtPtp9ReportDescriptor, &AmtPtp9DefaultHidDescriptor },
+		{ "Magic Trackpad 2", AmtPtpMt2ReportDescriptor, &AmtPtpMt2DefaultHidDescriptor },
+	};
+	ULONG iterations = AmtPtpBenchIterations(argc, argv, 1000000);
+	ULONG i;
+
+	for (i = 0; i < RTL_NUMBER_OF(families); i++) {
+		AmtPtpBenchDescriptor(families[i].Name, families[i].Descriptor,
+			families[i].HidDescriptor->DescriptorList[0].wReportLength, iterations);
+	}
+	return 0;
+}
@@ -0,0 +1,175 @@
+// AmtPtpWellspringBench.c: Mode switch and continuous reader cost of the USB driver per family
+//
+// Both run on the WDF stand-in above AmtPtpSimBcm5974. A power cycle is
+// D0 entry up to the trackpad in Wellspring mode and D0 exit back to mouse
+// mode; besides the host time it takes, the virtual time from D0 entry to
+// the switch landing is printed, which is what a user waits for on resume.
+// The reader case pushes frames through the continuous reader, the decoder
+// and the input queue to hidclass, one 8 ms frame after another.
+//
+// AmtPtpWellspringBenchVerbose is the same on a driver built at the trace
+// floor of a DBG build: against this one, the reader case gives the per-frame
+// cost of the TraceHot lines that a release build compiles out.
+
+#include <AmtPtpBench.h>
+#include <Driver.h>
+#include <AmtPtpSimBcm5974.h>
+
+static const USHORT AmtPtpBenchFamilies[] = {
+	0x0236, 0x023f, 0x0242, 0x0245, 0x0249, 0x024c, 0x0252,
+	0x0259, 0x0262, 0x0290, 0x0272, 0x027a, 0x027c, 0x0265,
+};
+
+static AMTPTP_SIM_REQUEST_DONE AmtPtpBenchHidDone;
+
+static VOID
+AmtPtpBenchHidRead(
+	_In_ WDFDEVICE Device
+)
+{
+	AmtPtpSimSendIoctl(Device, IOCTL_HID_READ_REPORT, NULL, 0, sizeof(PTP_REPORT), AmtPtpBenchHidDone, Device);
+}
+
+static VOID
+AmtPtpBenchHidDone(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status,
+	_In_ ULONG_PTR Information,
+	_In_reads_bytes_(Information) const UCHAR* Buffer
+)
+{
+	UNREFERENCED_PARAMETER(Buffer);
+
+	if (NT_SUCCESS(Status)) {
+		AmtPtpBenchSink += (ULONG) Information;
+	}
+	if (Status != STATUS_CANCELLED) {
+		AmtPtpBenchHidRead((WDFDEVICE) Context);
+	}
+}
+
+static BOOLEAN
+AmtPtpBenchAttach(
+	_Out_ AMTPTP_SIM_BCM5974* Bcm,
+	_Out_ WDFDEVICE* Device,
+	_In_ USHORT ProductId
+)
+{
+	AmtPtpSimReset();
+	if (!NT_SUCCESS(DriverEntry(NULL, NULL)) || !NT_SUCCESS(AmtPtpSimAddDevice(Device))) {
+		fprintf(stderr, "0x%04x: device not added\n", ProductId);
+		return FALSE;
+	}
+	AmtPtpSimBcm5974Attach(Bcm, *Device, ProductId);
+	return TRUE;
+}
+
+//
+// The trackpad sends nothing here, so once the switch has landed no event is
+// left and AmtPtpSimRunAll returns
+//
+static VOID
+AmtPtpBenchModeSwitch(
+	_In_ USHORT ProductId,
+	_In_ ULONG Iterations
+)
+{
+	AMTPTP_SIM_BCM5974 bcm;
+	WDFDEVICE device;
+	ULONGLONG start, entered, landed = 0;
+	char name[64];
+	ULONG i;
+
+	if (!AmtPtpBenchAttach(&bcm, &device, ProductId)) {
+		return;
+	}
+
+	start = AmtPtpBenchNow();
+	for (i = 0; i < Iterations; i++) {
+		entered = AmtPtpSimNow();
+		AmtPtpSimPowerUp(device);
+		AmtPtpSimRunAll();
+		if (!bcm.Wellspring) {
+			fprintf(stderr, "%s: no Wellspring mode after D0 entry\n", bcm.Model->Name);
+			break;
+		}
+		landed += (bcm.Model->ModeSwitch.Length != 0) ? bcm.SwitchedAt - entered : 0;
+		AmtPtpSimPowerDown(device);
+		AmtPtpSimRunAll();
+	}
+
+	snprintf(name, sizeof(name), "%s power cycle", bcm.Model->Name);
+	AmtPtpBenchReport(name, AmtPtpBenchNow() - start, Iterations);
+	printf("%-40s %10.1f us to Wellspring mode, %u control transfers\n", name,
+		(double) landed / 10 / Iterations, AmtPtpSimStats.ControlTransfers / Iterations);
+
+	AmtPtpSimReset();
+}
+
+static VOID
+AmtPtpBenchReader(
+	_In_ USHORT ProductId,
+	_In_ ULONG Iterations
+)
+{
+	AMTPTP_SIM_BCM5974 bcm;
+	WDFDEVICE device;
+	PDEVICE_CONTEXT deviceContext;
+	ULONGLONG start;
+	LONG reports;
+	ULONG traces = 0, level;
+	char name[64];
+
+	if (!AmtPtpBenchAttach(&bcm, &device, ProductId)) {
+		return;
+	}
+
+	// Up and switched before the clock starts
+	AmtPtpSimPowerUp(device);
+	AmtPtpSimRunAll();
+	AmtPtpBenchHidRead(device);
+	AmtPtpBenchHidRead(device);
+	AmtPtpSimBcm5974Start(&bcm);
+
+	deviceContext = DeviceGetContext(device);
+	reports = deviceContext->PerfCounters.ReportsOut;
+	for (level = 0; level <= TRACE_LEVEL_VERBOSE; level++) {
+		traces -= AmtPtpSimStats.Traces[level];
+	}
+	start = AmtPtpBenchNow();
+	AmtPtpSimRun(AmtPtpSimNow() + (ULONGLONG) Iterations * bcm.FrameInterval);
+	snprintf(name, sizeof(name), "%s reader, floor %d", bcm.Model->Name, AMTPTP_HOT_TRACE_LEVEL);
+	AmtPtpBenchReport(name, AmtPtpBenchNow() - start, Iterations);
+	for (level = 0; level <= TRACE_LEVEL_VERBOSE; level++) {
+		traces += AmtPtpSimStats.Traces[level];
+	}
+	printf("%-40s %10.2f trace lines per frame\n", name, (double) traces / Iterations);
+
+	if (deviceContext->PerfCounters.ReportsOut - reports + 1 < (LONG) Iterations) {
+		fprintf(stderr, "%s: %d reports for %u frames\n", bcm.Model->Name,
+			deviceContext->PerfCounters.ReportsOut - reports, Iterations);
+	}
+
+	AmtPtpSimBcm5974Stop(&bcm);
+	AmtPtpSimPowerDown(device);
+	AmtPtpSimRunAll();
+	AmtPtpSimReset();
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	ULONG iterations = AmtPtpBenchIterations(argc, argv, 10000);
+	ULONG i;
+
+	for (i = 0; i < RTL_NUMBER_OF(AmtPtpBenchFamilies); i++) {
+		AmtPtpBenchModeSwitch(AmtPtpBenchFamilies[i], iterations);
+	}
+	for (i = 0; i < RTL_NUMBER_OF(AmtPtpBenchFamilies); i++) {
+		AmtPtpBenchReader(AmtPtpBenchFamilies[i], iterations);
+	}
+	return 0;
+}
@@ -0,0 +1,772 @@
+// AmtPtpWellspringTest.c: The USB driver on the WDF stand-in, above a simulated bcm5974
+//
+// Device.c, Hid.c, InputInterrupt.c and Queue.c run as built for the driver,
+// once for every USB family in the registry. Each run brings the device up,
+// lets hidclass read for a while, takes the device out of D0 and brings it
+// back: the mode switch must land with exactly the transfers the mode engine
+// promises, every frame the driver decodes must reach hidclass, and leaving
+// D0 must put the trackpad back in mouse mode with no transfer left behind.
+// Faults on the control endpoint and the interrupt pipe run on one family of
+// each frame layout. The report descriptor each family hands hidclass is
+// held field by field against PTP_REPORT, and scans with more fingers than
+// a report holds must reach hidclass as an unbroken run of reports.
+
+#include <stdio.h>
+#include <Driver.h>
+#include <AmtPtpSimBcm5974.h>
+#include <AmtPtpTest.h>
+#include <AmtPtpHidFields.h>
+
+#define TEST_RUN_TIME		(1000 * 10000)	/* hidclass reads for 1 s in every power state */
+#define TEST_HID_READS		2
+#define TEST_PIPE_READS		2				/* NumPendingReads, the driver keeps the WDF default */
+#define TEST_MAX_FIELDS		64
+#define TEST_HYBRID_CONTACTS	8				/* two reports a scan */
+#define TEST_HYBRID_READS		4
+#define TEST_HYBRID_READ_DELAY	(12 * 10000)	/* longer than a frame, shorter than two */
+
+typedef struct _AMTPTP_TEST_RUN {
+	// Script
+	const char*			Name;
+	USHORT				ProductId;
+	AMTPTP_SIM_BCM5974_FAULTS Faults;
+	UCHAR				Contacts;		/* fingers on the pad, 0 for the model default */
+	ULONG				HidReads;		/* reads hidclass keeps pending, 0 for TEST_HID_READS */
+	ULONGLONG			ReadDelay;		/* hidclass sends the next read this late */
+
+	// State
+	WDFDEVICE			Device;
+	AMTPTP_SIM_BCM5974	Bcm;
+	ULONG				Outstanding;	/* PTP reads the driver holds */
+	PTP_REPORT			LastReport;
+	ULONG				ScanLeft;		/* contacts of the last scan still to come */
+
+	// Results
+	ULONG				Cancelled;
+	ULONG				Errors;
+	ULONG				Reports;
+	ULONG				Continuations;	/* reports with ContactCount 0 */
+	ULONG				Interleaved;	/* reports out of their scan's run */
+} AMTPTP_TEST_RUN, *PAMTPTP_TEST_RUN;
+
+// One of each layout, with the first product id the registry lists
+static const USHORT AmtPtpTestFamilies[] = {
+	0x0236,		/* Wellspring3, TYPE2 */
+	0x023f,		/* Wellspring4 */
+	0x0242,		/* Wellspring4A */
+	0x0245,		/* Wellspring5 */
+	0x0249,		/* Wellspring6A */
+	0x024c,		/* Wellspring6 */
+	0x0252,		/* Wellspring5A */
+	0x0259,		/* Wellspring7A */
+	0x0262,		/* Wellspring7 */
+	0x0290,		/* Wellspring8, TYPE3 */
+	0x0272,		/* Wellspring9, TYPE4 */
+	0x027a,		/* T2 small */
+	0x027c,		/* T2 */
+	0x0265,		/* Magic Trackpad 2, TYPE5 */
+};
+
+//
+// Hidclass
+//
+
+static AMTPTP_SIM_REQUEST_DONE AmtPtpTestHidDone;
+
+static VOID
+AmtPtpTestHidRead(
+	_In_ PAMTPTP_TEST_RUN Run
+)
+{
+	Run->Outstanding++;
+	AmtPtpSimSendIoctl(Run->Device, IOCTL_HID_READ_REPORT, NULL, 0, sizeof(PTP_REPORT), AmtPtpTestHidDone, Run);
+}
+
+static VOID
+AmtPtpTestHidReadLater(
+	_In_opt_ PVOID Context
+)
+{
+	AmtPtpTestHidRead(Context);
+}
+
+//
+// A scan of more than PTP_MAX_CONTACT_POINTS contacts is one report with the
+// contact count and the first contacts, then reports with ContactCount 0 and
+// the same ScanTime until every contact went out. Nothing goes in between.
+//
+static VOID
+AmtPtpTestHybridOrder(
+	_Inout_ PAMTPTP_TEST_RUN Run,
+	_In_ const PTP_REPORT* Report
+)
+{
+	if (Report->ContactCount == 0 && Run->ScanLeft > 0) {
+		Run->Continuations++;
+		if (Report->ScanTime != Run->LastReport.ScanTime) {
+			Run->Interleaved++;
+		}
+		Run->ScanLeft -= (Run->ScanLeft < PTP_MAX_CONTACT_POINTS) ? Run->ScanLeft : PTP_MAX_CONTACT_POINTS;
+	}
+	else {
+		if (Run->ScanLeft > 0) {
+			Run->Interleaved++;
+		}
+		Run->ScanLeft = (Report->ContactCount > PTP_MAX_CONTACT_POINTS) ? Report->ContactCount - PTP_MAX_CONTACT_POINTS : 0;
+	}
+	Run->LastReport = *Report;
+}
+
+static VOID
+AmtPtpTestHidDone(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status,
+	_In_ ULONG_PTR Information,
+	_In_reads_bytes_(Information) const UCHAR* Buffer
+)
+{
+	PAMTPTP_TEST_RUN run = Context;
+	const PTP_REPORT* report = (const PTP_REPORT*) Buffer;
+
+	run->Outstanding--;
+	if (Status == STATUS_CANCELLED) {
+		run->Cancelled++;
+		return;
+	}
+	if (!NT_SUCCESS(Status) || Information != sizeof(PTP_REPORT) || report->ReportID != REPORTID_MULTITOUCH) {
+		run->Errors++;
+	}
+	else {
+		run->Reports++;
+		AmtPtpTestHybridOrder(run, report);
+	}
+
+	if (run->ReadDelay != 0) {
+		AmtPtpSimSchedule(AmtPtpSimNow() + run->ReadDelay, AmtPtpTestHidReadLater, run);
+	}
+	else {
+		AmtPtpTestHidRead(run);
+	}
+}
+
+static VOID
+AmtPtpTestFeatureDone(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status,
+	_In_ ULONG_PTR Information,
+	_In_reads_bytes_(Information) const UCHAR* Buffer
+)
+{
+	UNREFERENCED_PARAMETER(Context);
+	UNREFERENCED_PARAMETER(Buffer);
+
+	AMTPTP_CHECK(NT_SUCCESS(Status));
+	AMTPTP_CHECK_EQ(Information, sizeof(PTP_DEVICE_INPUT_MODE_REPORT));
+}
+
+static VOID
+AmtPtpTestSetInputMode(
+	_In_ PAMTPTP_TEST_RUN Run,
+	_In_ UCHAR Mode
+)
+{
+	PTP_DEVICE_INPUT_MODE_REPORT report = { 0 };
+
+	// The report id travels as the output length, see RequestGetHidXferPacketToWriteToDevice
+	report.ReportID = REPORTID_REPORTMODE;
+	report.Mode = Mode;
+	AmtPtpSimSendIoctl(Run->Device, IOCTL_UMDF_HID_SET_FEATURE, &report, sizeof(report), REPORTID_REPORTMODE,
+		AmtPtpTestFeatureDone, NULL);
+}
+
+typedef struct _AMTPTP_TEST_COUNTERS {
+	NTSTATUS					Status;
+	ULONG_PTR					Length;
+	PTP_PERF_COUNTERS_REPORT	Report;
+} AMTPTP_TEST_COUNTERS, *PAMTPTP_TEST_COUNTERS;
+
+static VOID
+AmtPtpTestCountersDone(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status,
+	_In_ ULONG_PTR Information,
+	_In_reads_bytes_(Information) const UCHAR* Buffer
+)
+{
+	PAMTPTP_TEST_COUNTERS counters = Context;
+
+	counters->Status = Status;
+	counters->Length = Information;
+	if (NT_SUCCESS(Status) && Information <= sizeof(counters->Report)) {
+		memcpy(&counters->Report, Buffer, Information);
+	}
+}
+
+//
+// The counters feature report carries the block in field order, as the
+// Settings app reads it. Nothing runs in between here, so it matches the
+// counters exactly.
+//
+static VOID
+AmtPtpTestCounters(
+	_In_ PAMTPTP_TEST_RUN Run
+)
+{
+	AMTPTP_TEST_COUNTERS counters = { 0 };
+	ULONG values[AMTPTP_PERF_COUNTER_COUNT];
+	const UCHAR reportId = REPORTID_PERF_COUNTERS;
+	ULONG i, latency = 0;
+
+	// The report id travels in the input buffer, see RequestGetHidXferPacketToReadFromDevice
+	AmtPtpSimSendIoctl(Run->Device, IOCTL_UMDF_HID_GET_FEATURE, &reportId, sizeof(reportId),
+		sizeof(PTP_PERF_COUNTERS_REPORT), AmtPtpTestCountersDone, &counters);
+	AmtPtpSimRun(AmtPtpSimNow());
+
+	AMTPTP_CHECK(NT_SUCCESS(counters.Status));
+	AMTPTP_CHECK_EQ(counters.Length, sizeof(PTP_PERF_COUNTERS_REPORT));
+	AMTPTP_CHECK_EQ(counters.Report.ReportID, REPORTID_PERF_COUNTERS);
+
+	memcpy(values, counters.Report.Counters, sizeof(values));
+	AMTPTP_CHECK_EQ(values[offsetof(AMTPTP_PERF_COUNTERS, ReportsOut) / sizeof(LONG)], Run->Reports);
+	AMTPTP_CHECK(values[offsetof(AMTPTP_PERF_COUNTERS, FramesIn) / sizeof(LONG)] >= Run->Reports);
+	for (i = 0; i < AMTPTP_PERF_LATENCY_BUCKETS; i++) {
+		latency += values[offsetof(AMTPTP_PERF_COUNTERS, Latency) / sizeof(LONG) + i];
+	}
+	AMTPTP_CHECK(latency > 0 && latency <= Run->Reports);
+	AMTPTP_CHECK(memcmp(values, (const void*) &DeviceGetContext(Run->Device)->PerfCounters, sizeof(values)) == 0);
+}
+
+//
+// Streaming traces nothing at the release trace floor: per-frame lines are
+// TraceHot under AMTPTP_HOT_TRACE_LEVEL, and the sampled contact lines are
+// VERBOSE. Every frame that traced would pay the recorder for it.
+//
+static VOID
+AmtPtpTestTraceBudget(
+	_In_ PAMTPTP_TEST_RUN Run
+)
+{
+	ULONG traces[TRACE_LEVEL_VERBOSE + 1];
+	ULONG reports = Run->Reports;
+	ULONG level;
+
+	memcpy(traces, AmtPtpSimStats.Traces, sizeof(traces));
+	AmtPtpSimRun(AmtPtpSimNow() + TEST_RUN_TIME);
+	AMTPTP_CHECK(Run->Reports > reports);
+	for (level = 0; level <= TRACE_LEVEL_VERBOSE; level++) {
+		if (AmtPtpSimStats.Traces[level] != traces[level]) {
+			fprintf(stderr, "%u traces at level %u for %u reports\n",
+				AmtPtpSimStats.Traces[level] - traces[level], level, Run->Reports - reports);
+			AmtPtpTestFailures++;
+		}
+	}
+}
+
+//
+// Power
+//
+
+static BOOLEAN
+AmtPtpTestPowerUp(
+	_Inout_ PAMTPTP_TEST_RUN Run
+)
+{
+	NTSTATUS status;
+	ULONG i;
+
+	status = AmtPtpSimPowerUp(Run->Device);
+	AMTPTP_CHECK(NT_SUCCESS(status));
+	if (!NT_SUCCESS(status)) {
+		return FALSE;
+	}
+
+	// Reads kept across a power cycle count
+	for (i = Run->Outstanding; i < Run->HidReads; i++) {
+		AmtPtpTestHidRead(Run);
+	}
+	AmtPtpSimRun(AmtPtpSimNow() + TEST_RUN_TIME);
+	return TRUE;
+}
+
+//
+// Leaving D0 puts the trackpad in mouse mode before it returns and leaves no
+// interrupt transfer pending. The PTP reads stay with the driver, its input
+// queue is not power managed. The trackpad keeps sending, nobody reads it.
+//
+static VOID
+AmtPtpTestPowerDown(
+	_Inout_ PAMTPTP_TEST_RUN Run
+)
+{
+	PDEVICE_CONTEXT deviceContext = DeviceGetContext(Run->Device);
+	ULONG reports = Run->Reports;
+
+	AMTPTP_CHECK(NT_SUCCESS(AmtPtpSimPowerDown(Run->Device)));
+	AMTPTP_CHECK(!deviceContext->IsWellspringModeOn);
+	AMTPTP_CHECK_EQ(Run->Bcm.Wellspring, Run->Bcm.Model->ModeSwitch.Length == 0);
+	AMTPTP_CHECK_EQ(AmtPtpSimPipePending(Run->Device), 0);
+
+	AmtPtpSimRun(AmtPtpSimNow() + TEST_RUN_TIME / 10);
+	AMTPTP_CHECK_EQ(Run->Reports, reports);
+	AMTPTP_CHECK_EQ(Run->Outstanding, Run->HidReads);
+	AMTPTP_CHECK_EQ(Run->Cancelled, 0);
+}
+
+//
+// Brings the device up below the driver. Returns FALSE if it did not come
+// up, the checks are done then.
+//
+static BOOLEAN
+AmtPtpTestStart(
+	_Inout_ PAMTPTP_TEST_RUN Run
+)
+{
+	NTSTATUS status;
+
+	AmtPtpSimReset();
+	status = DriverEntry(NULL, NULL);
+	AMTPTP_CHECK(NT_SUCCESS(status));
+	status = AmtPtpSimAddDevice(&Run->Device);
+	AMTPTP_CHECK(NT_SUCCESS(status));
+	if (!NT_SUCCESS(status)) {
+		return FALSE;
+	}
+
+	AmtPtpSimBcm5974Attach(&Run->Bcm, Run->Device, Run->ProductId);
+	Run->Bcm.Faults = Run->Faults;
+	if (Run->Contacts != 0) {
+		Run->Bcm.Contacts = Run->Contacts;
+	}
+	if (Run->HidReads == 0) {
+		Run->HidReads = TEST_HID_READS;
+	}
+	AmtPtpSimBcm5974Start(&Run->Bcm);
+
+	return AmtPtpTestPowerUp(Run);
+}
+
+static VOID
+AmtPtpTestFinish(
+	_Inout_ PAMTPTP_TEST_RUN Run
+)
+{
+	const AMTPTP_SIM_BCM5974* bcm = &Run->Bcm;
+	PDEVICE_CONTEXT deviceContext = DeviceGetContext(Run->Device);
+
+	printf("%s %s: %u frames, %u reports, %u mode reads, %u mode writes, %u failed readers, %u resets\n",
+		bcm->Model->Name, Run->Name, bcm->FramesSent, Run->Reports, bcm->ModeReads, bcm->ModeWrites,
+		AmtPtpSimStats.ReadersFailed, deviceContext->PerfCounters.Resets);
+
+	AMTPTP_CHECK_EQ(bcm->Unexpected, 0);
+	AMTPTP_CHECK_EQ(Run->Errors, 0);
+	AMTPTP_CHECK_EQ(Run->Interleaved, 0);
+	AMTPTP_CHECK_EQ(AmtPtpSimStats.DeviceFailed, 0);
+
+	AmtPtpSimBcm5974Stop(&Run->Bcm);
+	AmtPtpSimRunAll();
+	AmtPtpSimReset();
+}
+
+//
+// The device comes up in Wellspring mode, goes back to mouse mode and comes
+// up again. The first switch reads the block and writes it, going back to
+// mouse mode only writes it, and the switch after the power cycle reads it
+// again: the device may have lost it.
+//
+static VOID
+AmtPtpTestSteady(
+	_In_ USHORT ProductId
+)
+{
+	AMTPTP_TEST_RUN run = { .Name = "steady", .ProductId = ProductId };
+	PDEVICE_CONTEXT deviceContext;
+	BOOLEAN switched;
+	ULONG reports;
+
+	if (!AmtPtpTestStart(&run)) {
+		return;
+	}
+
+	deviceContext = DeviceGetContext(run.Device);
+	switched = (run.Bcm.Model->ModeSwitch.Length != 0);
+	AMTPTP_CHECK(run.Bcm.Wellspring);
+	AMTPTP_CHECK(deviceContext->IsWellspringModeOn);
+	AMTPTP_CHECK_EQ(run.Bcm.ModeReads, switched ? 1 : 0);
+	AMTPTP_CHECK_EQ(run.Bcm.ModeWrites, switched ? 1 : 0);
+	AMTPTP_CHECK_EQ(AmtPtpSimStats.ControlTransfers, switched ? 2 : 0);
+
+	// Every frame after the switch was decoded and reached hidclass
+	AMTPTP_CHECK(run.Reports > 0);
+	AMTPTP_CHECK_EQ((ULONG) deviceContext->PerfCounters.ReportsOut, run.Reports);
+	AMTPTP_CHECK_EQ(deviceContext->PerfCounters.Malformed, 0);
+	AMTPTP_CHECK_EQ(AmtPtpSimStats.ReadsDropped, 0);
+	AMTPTP_CHECK_EQ(AmtPtpSimPipePending(run.Device), TEST_PIPE_READS);
+	AmtPtpTestCounters(&run);
+	AmtPtpTestTraceBudget(&run);
+
+	AmtPtpTestPowerDown(&run);
+	AMTPTP_CHECK_EQ(run.Bcm.Switches, switched ? 2 : 0);
+
+	reports = run.Reports;
+	if (AmtPtpTestPowerUp(&run)) {
+		AMTPTP_CHECK(run.Bcm.Wellspring);
+		AMTPTP_CHECK(run.Reports > reports);
+		AMTPTP_CHECK_EQ(run.Bcm.ModeReads, switched ? 2 : 0);
+		AMTPTP_CHECK_EQ(run.Bcm.Switches, switched ? 3 : 0);
+		AmtPtpTestPowerDown(&run);
+	}
+
+	AmtPtpTestFinish(&run);
+}
+
+static VOID
+AmtPtpTestFaults(
+	_In_ USHORT ProductId
+)
+{
+	AMTPTP_TEST_RUN run;
+	PDEVICE_CONTEXT deviceContext;
+
+	// The first transfer of the switch fails, the resume timer tries again
+	run = (AMTPTP_TEST_RUN) { .Name = "failed-control", .ProductId = ProductId, .Faults.FailControl = 1 };
+	if (AmtPtpTestStart(&run)) {
+		deviceContext = DeviceGetContext(run.Device);
+		AMTPTP_CHECK(run.Bcm.Wellspring);
+		AMTPTP_CHECK(run.Reports > 0);
+		AMTPTP_CHECK(AmtPtpSimStats.TimerFires >= 1);
+		AMTPTP_CHECK_EQ(deviceContext->Resume.Retries, 1);
+		AmtPtpTestPowerDown(&run);
+		AmtPtpTestFinish(&run);
+	}
+
+	// The switch never completes, leaving D0 cancels it and still gets mouse mode
+	run = (AMTPTP_TEST_RUN) { .Name = "stalled-control", .ProductId = ProductId, .Faults.StallControl = 1 };
+	if (AmtPtpTestStart(&run)) {
+		deviceContext = DeviceGetContext(run.Device);
+		AMTPTP_CHECK(!run.Bcm.Wellspring);
+		AMTPTP_CHECK(!deviceContext->IsWellspringModeOn);
+		AMTPTP_CHECK_EQ(run.Reports, 0);
+		AMTPTP_CHECK(run.Bcm.MouseReports > 0);
+		AmtPtpTestPowerDown(&run);
+		if (AmtPtpTestPowerUp(&run)) {
+			AMTPTP_CHECK(run.Bcm.Wellspring);
+			AMTPTP_CHECK(run.Reports > 0);
+			AmtPtpTestPowerDown(&run);
+		}
+		AmtPtpTestFinish(&run);
+	}
+
+	// The trackpad takes the write and stays in mouse mode. The driver only
+	// learns from the frames: the error budget runs out and resets it.
+	run = (AMTPTP_TEST_RUN) { .Name = "ignored-write", .ProductId = ProductId, .Faults.IgnoreModeWrites = 1 };
+	if (AmtPtpTestStart(&run)) {
+		deviceContext = DeviceGetContext(run.Device);
+		AMTPTP_CHECK(run.Bcm.Wellspring);
+		AMTPTP_CHECK(run.Reports > 0);
+		AMTPTP_CHECK_EQ(deviceContext->PerfCounters.Resets, 1);
+		AMTPTP_CHECK(deviceContext->PerfCounters.Malformed >= AMTPTP_ERROR_BUDGET_DEFAULT_LIMIT);
+		AmtPtpTestPowerDown(&run);
+		AmtPtpTestFinish(&run);
+	}
+
+	// Interrupt transfers fail now and then, the continuous reader restarts
+	run = (AMTPTP_TEST_RUN) { .Name = "failed-reads", .ProductId = ProductId, .Faults.FailReadEvery = 10 };
+	if (AmtPtpTestStart(&run)) {
+		AMTPTP_CHECK(AmtPtpSimStats.ReadersFailed > 0);
+		AMTPTP_CHECK(run.Reports > 0);
+		AMTPTP_CHECK_EQ(AmtPtpSimPipePending(run.Device), TEST_PIPE_READS);
+		AmtPtpTestPowerDown(&run);
+		AmtPtpTestFinish(&run);
+	}
+
+	// Short frames below the error budget are dropped one by one, no reset
+	run = (AMTPTP_TEST_RUN) { .Name = "malformed", .ProductId = ProductId, .Faults.MalformEvery = 50 };
+	if (AmtPtpTestStart(&run)) {
+		deviceContext = DeviceGetContext(run.Device);
+		AMTPTP_CHECK(deviceContext->PerfCounters.Malformed > 0);
+		AMTPTP_CHECK_EQ(deviceContext->PerfCounters.Resets, 0);
+		AMTPTP_CHECK_EQ(run.Bcm.Switches, 1);
+		AmtPtpTestPowerDown(&run);
+		AmtPtpTestFinish(&run);
+	}
+
+	// Hidclass moves the collection to mouse input and back, with tracing on
+	run = (AMTPTP_TEST_RUN) { .Name = "input-mode", .ProductId = ProductId };
+	AmtPtpSimTraceLoggingEnabled = TRUE;
+	if (AmtPtpTestStart(&run)) {
+		deviceContext = DeviceGetContext(run.Device);
+		AmtPtpTestSetInputMode(&run, PTP_COLLECTION_MOUSE);
+		AmtPtpSimRun(AmtPtpSimNow() + TEST_RUN_TIME / 10);
+		AMTPTP_CHECK(!run.Bcm.Wellspring);
+		AMTPTP_CHECK(!deviceContext->IsWellspringModeOn);
+		AmtPtpTestSetInputMode(&run, PTP_COLLECTION_WINDOWS);
+		AmtPtpSimRun(AmtPtpSimNow() + TEST_RUN_TIME / 10);
+		AMTPTP_CHECK(run.Bcm.Wellspring);
+		AMTPTP_CHECK(deviceContext->IsWellspringModeOn);
+
+		// The block is known by now, both switches only write it
+		AMTPTP_CHECK_EQ(run.Bcm.ModeReads, 1);
+		AMTPTP_CHECK_EQ(run.Bcm.ModeWrites, 3);
+		AmtPtpTestPowerDown(&run);
+		AmtPtpTestFinish(&run);
+	}
+	AmtPtpSimTraceLoggingEnabled = FALSE;
+}
+
+//
+// Hidclass keeps several reads pending and sends the next one only after a
+// frame's time, so a frame can find reads pending while the rest of the
+// scan before it is still parked. It has to wait behind it.
+//
+static VOID
+AmtPtpTestHybrid(
+	_In_ USHORT ProductId
+)
+{
+	AMTPTP_TEST_RUN run = { .Name = "hybrid", .ProductId = ProductId, .Contacts = TEST_HYBRID_CONTACTS,
+		.HidReads = TEST_HYBRID_READS, .ReadDelay = TEST_HYBRID_READ_DELAY };
+	PDEVICE_CONTEXT deviceContext;
+
+	if (!AmtPtpTestStart(&run)) {
+		return;
+	}
+
+	// Every scan went out whole, none was dropped on the way
+	deviceContext = DeviceGetContext(run.Device);
+	AMTPTP_CHECK(run.Reports > 0);
+	AMTPTP_CHECK_EQ(run.Continuations, run.Reports / 2);
+	AMTPTP_CHECK_EQ(deviceContext->ReportRing.Dropped, 0);
+	AMTPTP_CHECK_EQ(deviceContext->PerfCounters.ReportsOut, run.Reports);
+
+	// Hidclass catches up before the device leaves D0
+	run.ReadDelay = 0;
+	AmtPtpSimRun(AmtPtpSimNow() + TEST_HYBRID_READ_DELAY);
+	AmtPtpTestPowerDown(&run);
+	AmtPtpTestFinish(&run);
+}
+
+// Reports as the driver fills them
+static const AMTPTP_HID_REPORT_SIZE AmtPtpTestReports[] = {
+	{ AmtPtpHidReportInput,		REPORTID_MULTITOUCH,	sizeof(PTP_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_DEVICE_CAPS,	sizeof(PTP_DEVICE_CAPS_FEATURE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PTPHQA,		sizeof(PTP_DEVICE_HQA_CERTIFICATION_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_REPORTMODE,	sizeof(PTP_DEVICE_INPUT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_FUNCSWITCH,	sizeof(PTP_DEVICE_SELECTIVE_REPORT_MODE_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_UMAPP_CONF,	sizeof(PTP_USERMODEAPP_CONF_REPORT) },
+	{ AmtPtpHidReportFeature,	REPORTID_PERF_COUNTERS,	sizeof(PTP_PERF_COUNTERS_REPORT) },
+};
+
+typedef struct _AMTPTP_TEST_DESCRIPTOR {
+	NTSTATUS	Status;
+	ULONG		Length;
+	UCHAR		Data[1024];
+} AMTPTP_TEST_DESCRIPTOR, *PAMTPTP_TEST_DESCRIPTOR;
+
+static VOID
+AmtPtpTestDescriptorDone(
+	_In_opt_ PVOID Context,
+	_In_ NTSTATUS Status,
+	_In_ ULONG_PTR Information,
+	_In_reads_bytes_(Information) const UCHAR* Buffer
+)
+{
+	PAMTPTP_TEST_DESCRIPTOR descriptor = Context;
+
+	descriptor->Status = Status;
+	descriptor->Length = (ULONG) Information;
+	if (NT_SUCCESS(Status)) {
+		memcpy(descriptor->Data, Buffer, Information);
+	}
+}
+
+//
+// Where the bits set in Report sit, as a field: the lowest one and the span
+// up to the highest. Clears Report for the next field.
+//
+static VOID
+AmtPtpTestProbe(
+	_Inout_ PTP_REPORT* Report,
+	_In_ USHORT UsagePage,
+	_In_ USHORT Usage,
+	_Inout_ AMTPTP_HID_FIELD* Fields,
+	_Inout_ PULONG Count
+)
+{
+	const UCHAR* bytes = (const UCHAR*) Report;
+	AMTPTP_HID_FIELD* field = &Fields[(*Count)++];
+	ULONG bit, first = 0, last = 0;
+	BOOLEAN found = FALSE;
+
+	for (bit = 0; bit < sizeof(PTP_REPORT) * 8; bit++) {
+		if (bytes[bit / 8] & (1 << (bit % 8))) {
+			first = found ? first : bit;
+			last = bit;
+			found = TRUE;
+		}
+	}
+
+	RtlZeroMemory(field, sizeof(AMTPTP_HID_FIELD));
+	field->UsagePage = UsagePage;
+	field->Usage = Usage;
+	field->BitOffset = first;
+	field->BitSize = last - first + 1;
+	field->Constant = (Usage == 0);
+	RtlZeroMemory(Report, sizeof(PTP_REPORT));
+}
+
+//
+// Every report the descriptor declares, of any type and id, must be one the
+// driver fills and as long as its structure
+//
+static VOID
+AmtPtpTestReportSizes(
+	_In_reads_bytes_(Length) const UCHAR* Descriptor,
+	_In_ ULONG Length,
+	_In_reads_(Count) const AMTPTP_HID_REPORT_SIZE* Expected,
+	_In_ ULONG Count
+)
+{
+	AMTPTP_HID_REPORT_TYPE type;
+	ULONG reportId, size, i, declared = 0;
+
+	for (type = AmtPtpHidReportInput; type <= AmtPtpHidReportFeature; type++) {
+		for (reportId = 1; reportId <= 0xff; reportId++) {
+			AMTPTP_CHECK_EQ(AmtPtpHidGetReportSize(Descriptor, Length, type, (UCHAR) reportId, &size),
+				AmtPtpHidLayoutOk);
+			if (size == 0) {
+				continue;
+			}
+
+			declared++;
+			for (i = 0; i < Count && (Expected[i].Type != type || Expected[i].ReportId != reportId); i++) {
+			}
+			if (i == Count) {
+				fprintf(stderr, "report %u of type %d is not filled by the driver\n", reportId, type);
+				AmtPtpTestFailures++;
+				continue;
+			}
+			AMTPTP_CHECK_EQ(size, Expected[i].Size);
+		}
+	}
+	AMTPTP_CHECK_EQ(declared, Count);
+}
+
+//
+// The multi-touch input report as PTP_REPORT lays it out, field by field in
+// the order the descriptor declares them
+//
+static ULONG
+AmtPtpTestPtpReportFields(
+	_Out_writes_(TEST_MAX_FIELDS) AMTPTP_HID_FIELD* Fields
+)
+{
+	PTP_REPORT report = { 0 };
+	ULONG count = 0, k;
+
+	for (k = 0; k < RTL_NUMBER_OF(report.Contacts); k++) {
+		report.Contacts[k].Confidence = 1;
+		AmtPtpTestProbe(&report, 0x0d, 0x47, Fields, &count);
+		report.Contacts[k].TipSwitch = 1;
+		AmtPtpTestProbe(&report, 0x0d, 0x42, Fields, &count);
+		report.Contacts[k].Padding = 0x3f;
+		AmtPtpTestProbe(&report, 0x0d, 0, Fields, &count);
+		report.Contacts[k].ContactID = 0xffffffff;
+		AmtPtpTestProbe(&report, 0x0d, 0x51, Fields, &count);
+		report.Contacts[k].X = 0xffff;
+		AmtPtpTestProbe(&report, 0x01, 0x30, Fields, &count);
+		report.Contacts[k].Y = 0xffff;
+		AmtPtpTestProbe(&report, 0x01, 0x31, Fields, &count);
+	}
+	report.ScanTime = 0xffff;
+	AmtPtpTestProbe(&report, 0x0d, 0x56, Fields, &count);
+	report.ContactCount = 0xff;
+	AmtPtpTestProbe(&report, 0x0d, 0x54, Fields, &count);
+	report.IsButtonClicked = 0x01;
+	AmtPtpTestProbe(&report, 0x09, 0x01, Fields, &count);
+	report.IsButtonClicked = 0xfe;
+	AmtPtpTestProbe(&report, 0x09, 0, Fields, &count);
+	return count;
+}
+
+//
+// The descriptor hidclass gets must lay the input report out bit for bit as
+// the driver fills PTP_REPORT, with the axis ranges of the model: hidclass
+// parses whatever it is given, and a field out of place misreads every
+// report without an error. Families without a PTP descriptor get none, the
+// T2 families are served by the kernel driver.
+//
+static VOID
+AmtPtpTestDescriptor(
+	_In_ USHORT ProductId
+)
+{
+	AMTPTP_TEST_RUN run = { .Name = "descriptor", .ProductId = ProductId };
+	AMTPTP_TEST_DESCRIPTOR descriptor = { 0 };
+	AMTPTP_HID_FIELD fields[TEST_MAX_FIELDS], expected[TEST_MAX_FIELDS];
+	const AMTPTP_DEVICE_MODEL* model;
+	ULONG count = 0, expectedCount, i;
+
+	if (!AmtPtpTestStart(&run)) {
+		return;
+	}
+
+	model = run.Bcm.Model;
+	AmtPtpSimSendIoctl(run.Device, IOCTL_HID_GET_REPORT_DESCRIPTOR, NULL, 0, sizeof(descriptor.Data),
+		AmtPtpTestDescriptorDone, &descriptor);
+	AmtPtpSimRun(AmtPtpSimNow());
+
+	if (model->Descriptor == AmtPtpReportDescriptorNone || model->Descriptor >= AmtPtpReportDescriptorT2) {
+		AMTPTP_CHECK(!NT_SUCCESS(descriptor.Status));
+	}
+	else {
+		AMTPTP_CHECK(NT_SUCCESS(descriptor.Status));
+		AmtPtpTestReportSizes(descriptor.Data, descriptor.Length, AmtPtpTestReports, RTL_NUMBER_OF(AmtPtpTestReports));
+		AMTPTP_CHECK(AmtPtpHidGetFields(descriptor.Data, descriptor.Length, AmtPtpHidReportInput,
+			REPORTID_MULTITOUCH, fields, TEST_MAX_FIELDS, &count));
+
+		expectedCount = AmtPtpTestPtpReportFields(expected);
+		AMTPTP_CHECK_EQ(count, expectedCount);
+		for (i = 0; i < count && i < expectedCount; i++) {
+			AMTPTP_CHECK_EQ(fields[i].BitOffset, expected[i].BitOffset);
+			AMTPTP_CHECK_EQ(fields[i].BitSize, expected[i].BitSize);
+			AMTPTP_CHECK_EQ(fields[i].Constant, expected[i].Constant);
+			if (!expected[i].Constant) {
+				AMTPTP_CHECK_EQ(fields[i].UsagePage, expected[i].UsagePage);
+				AMTPTP_CHECK_EQ(fields[i].Usage, expected[i].Usage);
+			}
+
+			// Positions are reported relative to the minimum
+			if (fields[i].UsagePage == 0x01 && fields[i].Usage == 0x30) {
+				AMTPTP_CHECK_EQ(fields[i].LogicalMaximum, model->X.Max - model->X.Min);
+			}
+			if (fields[i].UsagePage == 0x01 && fields[i].Usage == 0x31) {
+				AMTPTP_CHECK_EQ(fields[i].LogicalMaximum, model->Y.Max - model->Y.Min);
+			}
+		}
+		if (count > 0) {
+			AMTPTP_CHECK_EQ(fields[count - 1].BitOffset + fields[count - 1].BitSize, sizeof(PTP_REPORT) * 8);
+		}
+	}
+
+	AmtPtpTestPowerDown(&run);
+	AmtPtpTestFinish(&run);
+}
+
+int
+main(VOID)
+{
+	ULONG i;
+
+	for (i = 0; i < RTL_NUMBER_OF(AmtPtpTestFamilies); i++) {
+		AmtPtpTestSteady(AmtPtpTestFamilies[i]);
+		AmtPtpTestDescriptor(AmtPtpTestFamilies[i]);
+		AmtPtpTestHybrid(AmtPtpTestFamilies[i]);
+	}
+
+	// TYPE2, TYPE4 and TYPE5 switch modes, TYPE3 has no control transfers to fail
+	AmtPtpTestFaults(0x0259);
+	AmtPtpTestFaults(0x027c);
+	AmtPtpTestFaults(0x0265);
+
+	return AmtPtpTestExit("AmtPtpWellspringTest");
+}